@@ -20,57 +20,76 @@
 #include "adc.h"
 #include "terminal.h"
 #include "commands.h"
+#include "utils.h"
+#include "samp_stats.h"
 #include "esp_idf_version.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 #include <math.h>
 
+#if HW_HAS_ADC
+
 // ESP32-C6 uses newer ADC APIs
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 #include "esp_adc/adc_oneshot.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
 
-// Private variables
-static bool cal_ok = false;
-static adc_oneshot_unit_handle_t adc1_handle;
-static adc_cali_handle_t adc1_cali_handle;
-#else
-#include "esp_adc_cal.h"
+// Settings
+#define ADC_CH_MAX				8
+#define ADC_FRAME_SAMPLES		64
 
 // Private variables
 static bool cal_ok = false;
-static esp_adc_cal_characteristics_t adc1_chars;
-#endif
-
-void adc_init(void) {
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-	// New ADC API for ESP-IDF 5.0+
-	adc_oneshot_unit_init_cfg_t init_config1 = {
-		.unit_id = ADC_UNIT_1,
-	};
-	ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config1, &adc1_handle));
+static adc_oneshot_unit_handle_t adc1_handle = NULL;
+static adc_cali_handle_t adc1_cali_handle;
 
-	adc_oneshot_chan_cfg_t config = {
-		.bitwidth = ADC_BITWIDTH_DEFAULT,
-		.atten = ADC_ATTEN_DB_12,
-	};
+static adc_continuous_handle_t m_cont_handle = NULL;
+static volatile bool m_cont_running = false;
+static volatile bool m_cont_should_stop = false;
+static volatile bool m_cont_task_running = false;
+static int m_oversample = 1;
+static volatile float m_raw_instant[ADC_CH_MAX] = {0};
+static volatile float m_raw_filter[ADC_CH_MAX] = {0};
 
+static const adc_channel_t m_cont_channels[] = {
 #ifdef HW_ADC_CH0
-	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH0, &config));
+		HW_ADC_CH0,
 #endif
 #ifdef HW_ADC_CH1
-	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH1, &config));
+		HW_ADC_CH1,
 #endif
 #ifdef HW_ADC_CH2
-	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH2, &config));
+		HW_ADC_CH2,
 #endif
 #ifdef HW_ADC_CH3
-	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH3, &config));
+		HW_ADC_CH3,
 #endif
 #ifdef HW_ADC_CH4
-	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH4, &config));
+		HW_ADC_CH4,
+#endif
+};
+
+#define ADC_CONT_CH_NUM ((int)(sizeof(m_cont_channels) / sizeof(m_cont_channels[0])))
+
+// Private functions
+static void oneshot_init(void);
+static void cont_task(void *arg);
+#else
+#include "esp_adc_cal.h"
+
+// Private variables
+static bool cal_ok = false;
+static esp_adc_cal_characteristics_t adc1_chars;
 #endif
 
+void adc_init(void) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	oneshot_init();
+
 	// ADC calibration init
 	adc_cali_curve_fitting_config_t cali_config = {
 		.unit_id = ADC_UNIT_1,
@@ -107,9 +126,210 @@ void adc_init(void) {
 #endif
 }
 
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+static void oneshot_init(void) {
+	// New ADC API for ESP-IDF 5.0+
+	adc_oneshot_unit_init_cfg_t init_config1 = {
+		.unit_id = ADC_UNIT_1,
+	};
+	ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config1, &adc1_handle));
+
+	adc_oneshot_chan_cfg_t config = {
+		.bitwidth = ADC_BITWIDTH_DEFAULT,
+		.atten = ADC_ATTEN_DB_12,
+	};
+
+#ifdef HW_ADC_CH0
+	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH0, &config));
+#endif
+#ifdef HW_ADC_CH1
+	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH1, &config));
+#endif
+#ifdef HW_ADC_CH2
+	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH2, &config));
+#endif
+#ifdef HW_ADC_CH3
+	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH3, &config));
+#endif
+#ifdef HW_ADC_CH4
+	ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, HW_ADC_CH4, &config));
+#endif
+}
+
+static float raw_to_voltage(float raw) {
+	float res = -1.0;
+
+	if (cal_ok) {
+		int voltage;
+		if (adc_cali_raw_to_voltage(adc1_cali_handle, (int)raw, &voltage) == ESP_OK) {
+			res = (float)voltage / 1000.0;
+		}
+	}
+
+	return res;
+}
+
+/*
+ * Drains the DMA conversion buffers and folds the samples into per-channel
+ * decimating accumulators. Every m_oversample samples the accumulator
+ * average becomes the cached instant value and feeds the low-pass filtered
+ * value, so readers never touch the driver at all.
+ */
+static void cont_task(void *arg) {
+	(void)arg;
+
+	uint8_t buf[ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+	uint32_t acc[ADC_CH_MAX] = {0};
+	int acc_n[ADC_CH_MAX] = {0};
+
+	while (!m_cont_should_stop) {
+		uint32_t len = 0;
+		esp_err_t res = adc_continuous_read(m_cont_handle, buf, sizeof(buf), &len, 100);
+
+		if (res == ESP_OK) {
+			for (uint32_t i = 0;i < len;i += SOC_ADC_DIGI_RESULT_BYTES) {
+				adc_digi_output_data_t *p = (adc_digi_output_data_t*)(buf + i);
+				int ch = p->type2.channel;
+
+				if (ch >= ADC_CH_MAX) {
+					continue;
+				}
+
+				acc[ch] += p->type2.data;
+				acc_n[ch]++;
+
+				if (acc_n[ch] >= m_oversample) {
+					float raw = (float)acc[ch] / (float)acc_n[ch];
+					m_raw_instant[ch] = raw;
+					UTILS_LP_FAST(m_raw_filter[ch], raw, 0.05);
+					acc[ch] = 0;
+					acc_n[ch] = 0;
+
+					// One jitter sample per published value, tracked on
+					// the first configured channel only so the interval
+					// reflects the effective per-channel sample rate.
+					if (ADC_CONT_CH_NUM > 0 && ch == (int)m_cont_channels[0]) {
+						samp_stats_add(SAMP_SRC_ADC);
+					}
+				}
+			}
+		}
+	}
+
+	m_cont_task_running = false;
+	vTaskDelete(NULL);
+}
+#endif
+
+bool adc_start_continuous(int rate_hz, int oversample) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	if (m_cont_running || ADC_CONT_CH_NUM == 0) {
+		return false;
+	}
+
+	if (oversample < 1) {
+		oversample = 1;
+	}
+	m_oversample = oversample;
+
+	// The continuous driver cannot share the unit with the oneshot driver
+	if (adc1_handle) {
+		adc_oneshot_del_unit(adc1_handle);
+		adc1_handle = NULL;
+	}
+
+	adc_continuous_handle_cfg_t handle_cfg = {
+		.max_store_buf_size = 4 * ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES,
+		.conv_frame_size = ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES,
+	};
+
+	if (adc_continuous_new_handle(&handle_cfg, &m_cont_handle) != ESP_OK) {
+		m_cont_handle = NULL;
+		oneshot_init();
+		return false;
+	}
+
+	adc_digi_pattern_config_t pattern[ADC_CONT_CH_NUM];
+	for (int i = 0;i < ADC_CONT_CH_NUM;i++) {
+		pattern[i].atten = ADC_ATTEN_DB_12;
+		pattern[i].channel = m_cont_channels[i];
+		pattern[i].unit = ADC_UNIT_1;
+		pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+	}
+
+	uint32_t freq = (uint32_t)rate_hz * (uint32_t)oversample * (uint32_t)ADC_CONT_CH_NUM;
+	if (freq < SOC_ADC_SAMPLE_FREQ_THRES_LOW) {
+		freq = SOC_ADC_SAMPLE_FREQ_THRES_LOW;
+	}
+	if (freq > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+		freq = SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+	}
+
+	adc_continuous_config_t dig_cfg = {
+		.sample_freq_hz = freq,
+		.conv_mode = ADC_CONV_SINGLE_UNIT_1,
+		.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+		.pattern_num = ADC_CONT_CH_NUM,
+		.adc_pattern = pattern,
+	};
+
+	if (adc_continuous_config(m_cont_handle, &dig_cfg) != ESP_OK ||
+			adc_continuous_start(m_cont_handle) != ESP_OK) {
+		adc_continuous_deinit(m_cont_handle);
+		m_cont_handle = NULL;
+		oneshot_init();
+		return false;
+	}
+
+	m_cont_should_stop = false;
+	m_cont_task_running = true;
+	m_cont_running = true;
+	xTaskCreatePinnedToCore(cont_task, "adc_cont", 2048, NULL, 7, NULL, tskNO_AFFINITY);
+
+	return true;
+#else
+	(void)rate_hz; (void)oversample;
+	return false;
+#endif
+}
+
+void adc_stop_continuous(void) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	if (!m_cont_running) {
+		return;
+	}
+
+	m_cont_should_stop = true;
+	while (m_cont_task_running) {
+		vTaskDelay(1);
+	}
+
+	adc_continuous_stop(m_cont_handle);
+	adc_continuous_deinit(m_cont_handle);
+	m_cont_handle = NULL;
+	m_cont_running = false;
+
+	oneshot_init();
+#endif
+}
+
+bool adc_is_continuous_running(void) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	return m_cont_running;
+#else
+	return false;
+#endif
+}
+
 float adc_get_voltage(adc_channel_t ch) {
 	float res = -1.0;
 
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	if (m_cont_running) {
+		return ch < ADC_CH_MAX ? raw_to_voltage(m_raw_instant[ch]) : -1.0;
+	}
+#endif
+
 	if (cal_ok) {
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 		// New ADC API for ESP-IDF 5.0+
@@ -128,3 +348,41 @@ float adc_get_voltage(adc_channel_t ch) {
 
 	return res;
 }
+
+float adc_get_voltage_filtered(adc_channel_t ch) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+	if (m_cont_running) {
+		return ch < ADC_CH_MAX ? raw_to_voltage(m_raw_filter[ch]) : -1.0;
+	}
+#endif
+
+	return adc_get_voltage(ch);
+}
+
+#else
+// Boards that set HW_HAS_ADC to 0 compile the ADC driver out entirely.
+void adc_init(void) {
+}
+
+bool adc_start_continuous(int rate_hz, int oversample) {
+	(void)rate_hz; (void)oversample;
+	return false;
+}
+
+void adc_stop_continuous(void) {
+}
+
+bool adc_is_continuous_running(void) {
+	return false;
+}
+
+float adc_get_voltage(adc_channel_t ch) {
+	(void)ch;
+	return -1.0;
+}
+
+float adc_get_voltage_filtered(adc_channel_t ch) {
+	(void)ch;
+	return -1.0;
+}
+#endif
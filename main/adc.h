@@ -29,4 +29,13 @@
 void adc_init(void);
 float adc_get_voltage(adc_channel_t ch);
 
+// Continuous DMA sampling. While running, adc_get_voltage returns the
+// cached instant value instead of performing a oneshot conversion. Each
+// instant value is the average of oversample raw samples taken at
+// rate_hz * oversample per channel.
+bool adc_start_continuous(int rate_hz, int oversample);
+void adc_stop_continuous(void);
+bool adc_is_continuous_running(void);
+float adc_get_voltage_filtered(adc_channel_t ch);
+
 #endif /* MAIN_ADC_H_ */
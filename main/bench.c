@@ -0,0 +1,291 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+/*
+ * On-target micro-benchmarks for the kernels the optimization work
+ * keeps touching: crc16, packet framing and parsing, buffer
+ * serialization, framebuffer-style copies, the fixed-point math
+ * routines and LispBM evaluation. Results come out as one CSV line per
+ * kernel so they can be scraped off the terminal and diffed between
+ * builds.
+ */
+
+#include "bench.h"
+#include "commands.h"
+#include "crc.h"
+#include "packet.h"
+#include "buffer.h"
+#include "fixmath.h"
+#include "lispif.h"
+
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#define BENCH_DATA_LEN			1024
+#define BENCH_BLIT_LEN			4096
+
+// Accumulator that keeps the compiler from discarding kernel results.
+static volatile uint32_t bench_sink = 0;
+
+static uint8_t bench_data[BENCH_DATA_LEN];
+
+// Capture buffer for the framed packet used by the decode benchmark.
+static uint8_t bench_framed[BENCH_DATA_LEN + 8];
+static unsigned int bench_framed_len = 0;
+
+static void bench_fill_data(void) {
+	uint32_t seed = 0x12345678;
+	for (int i = 0;i < BENCH_DATA_LEN;i++) {
+		seed = seed * 1664525 + 1013904223;
+		bench_data[i] = seed >> 24;
+	}
+}
+
+static void bench_send_null(unsigned char *data, unsigned int len) {
+	(void)data; (void)len;
+}
+
+static void bench_send_capture(unsigned char *data, unsigned int len) {
+	if (len <= sizeof(bench_framed)) {
+		memcpy(bench_framed, data, len);
+		bench_framed_len = len;
+	}
+}
+
+static void bench_process_null(unsigned char *data, unsigned int len) {
+	(void)len;
+	bench_sink += data[0];
+}
+
+static void bench_report(const char *name, uint32_t iters,
+		uint32_t bytes_per_iter, uint32_t cycles, uint32_t time_us) {
+	float mb_s = 0.0;
+	if (time_us > 0 && bytes_per_iter > 0) {
+		// bytes per microsecond is MB/s
+		mb_s = ((float)bytes_per_iter * (float)iters) / (float)time_us;
+	}
+
+	commands_printf("bench,%s,iters=%u,bytes=%u,cycles_tot=%u,cycles_iter=%u,us=%u,mb_s=%.2f",
+			name, iters, bytes_per_iter, cycles,
+			iters > 0 ? cycles / iters : 0, time_us, (double)mb_s);
+}
+
+static void bench_crc16(void) {
+	const uint32_t iters = 200;
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	for (uint32_t i = 0;i < iters;i++) {
+		bench_sink += crc16(bench_data, BENCH_DATA_LEN);
+	}
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	bench_report("crc16", iters, BENCH_DATA_LEN, cycles, us);
+}
+
+static void bench_packet(void) {
+	const uint32_t iters = 200;
+	const unsigned int pl_len = 256;
+
+	PACKET_STATE_t *st = calloc(1, sizeof(PACKET_STATE_t));
+	if (!st) {
+		commands_printf("bench,packet,error=no_mem");
+		return;
+	}
+
+	// Encode: crc + framing + send callback
+	packet_init(bench_send_null, bench_process_null, st);
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	for (uint32_t i = 0;i < iters;i++) {
+		packet_send_packet(bench_data, pl_len, st);
+	}
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	bench_report("packet_encode", iters, pl_len, cycles, us);
+
+	// Decode: frame one packet, then push it through the parser
+	packet_init(bench_send_capture, bench_process_null, st);
+	bench_framed_len = 0;
+	packet_send_packet(bench_data, pl_len, st);
+
+	if (bench_framed_len > 0) {
+		c_start = esp_cpu_get_cycle_count();
+		t_start = esp_timer_get_time();
+		for (uint32_t i = 0;i < iters;i++) {
+			packet_process_buffer(bench_framed, bench_framed_len, st);
+		}
+		cycles = esp_cpu_get_cycle_count() - c_start;
+		us = (uint32_t)(esp_timer_get_time() - t_start);
+
+		bench_report("packet_decode", iters, bench_framed_len, cycles, us);
+	}
+
+	packet_release_buffers(st);
+	free(st);
+}
+
+static void bench_buffer(void) {
+	const uint32_t iters = 500;
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	for (uint32_t i = 0;i < iters;i++) {
+		int32_t ind = 0;
+		while (ind < (BENCH_DATA_LEN - 16)) {
+			buffer_append_int32(bench_data, (int32_t)i, &ind);
+			buffer_append_float32(bench_data, 123.456, 1e3, &ind);
+			buffer_append_float32_auto(bench_data, 123.456, &ind);
+			buffer_append_float16(bench_data, 12.34, 1e2, &ind);
+		}
+		ind = 0;
+		while (ind < (BENCH_DATA_LEN - 16)) {
+			bench_sink += (uint32_t)buffer_get_int32(bench_data, &ind);
+			bench_sink += (uint32_t)buffer_get_float32(bench_data, 1e3, &ind);
+			bench_sink += (uint32_t)buffer_get_float32_auto(bench_data, &ind);
+			bench_sink += (uint32_t)buffer_get_float16(bench_data, 1e2, &ind);
+		}
+	}
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	bench_report("buffer", iters, 2 * BENCH_DATA_LEN, cycles, us);
+	bench_fill_data();
+}
+
+/*
+ * Stand-in for the display blit path. The SPI transfer dominates real
+ * panel updates, so what regressions here catch is the RAM-side
+ * copy/packing cost that the drivers add on top of it.
+ */
+static void bench_blit(void) {
+	const uint32_t iters = 500;
+
+	uint8_t *src = malloc(BENCH_BLIT_LEN);
+	uint8_t *dst = malloc(BENCH_BLIT_LEN);
+	if (!src || !dst) {
+		free(src); free(dst);
+		commands_printf("bench,blit,error=no_mem");
+		return;
+	}
+
+	memset(src, 0x5A, BENCH_BLIT_LEN);
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	for (uint32_t i = 0;i < iters;i++) {
+		memcpy(dst, src, BENCH_BLIT_LEN);
+		bench_sink += dst[i % BENCH_BLIT_LEN];
+	}
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	bench_report("blit", iters, BENCH_BLIT_LEN, cycles, us);
+
+	free(src);
+	free(dst);
+}
+
+static void bench_q16(void) {
+	const uint32_t iters = 10000;
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	q16_t a = 0;
+	for (uint32_t i = 0;i < iters;i++) {
+		a += 123;
+		bench_sink += (uint32_t)q16_sin(a);
+		bench_sink += (uint32_t)q16_atan2(a, Q16_ONE);
+	}
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	bench_report("q16", iters, 0, cycles, us);
+}
+
+static void bench_lbm(void) {
+	// Core-only program so it runs regardless of which dynamic
+	// libraries the image was started with.
+	const char *prog =
+			"(define bench-f (lambda (n acc) "
+			"(if (= n 0) acc (bench-f (- n 1) (+ acc n))))) "
+			"(bench-f 10000 0)";
+
+	uint32_t c_start = esp_cpu_get_cycle_count();
+	int64_t t_start = esp_timer_get_time();
+	bool ok = lispif_eval_sync(prog, 10000);
+	uint32_t cycles = esp_cpu_get_cycle_count() - c_start;
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+	if (ok) {
+		// Wall time including scheduling; the evaluator runs in its
+		// own task.
+		bench_report("lbm", 10000, 0, cycles, us);
+	} else {
+		commands_printf("bench,lbm,skipped=not_running");
+	}
+}
+
+void bench_run(int argc, const char **argv) {
+	const char *sel = argc >= 2 ? argv[1] : "all";
+	bool all = strcmp(sel, "all") == 0;
+	bool any = false;
+
+	bench_fill_data();
+
+	if (all || strcmp(sel, "crc16") == 0) {
+		bench_crc16();
+		any = true;
+	}
+
+	if (all || strcmp(sel, "packet") == 0) {
+		bench_packet();
+		any = true;
+	}
+
+	if (all || strcmp(sel, "buffer") == 0) {
+		bench_buffer();
+		any = true;
+	}
+
+	if (all || strcmp(sel, "blit") == 0) {
+		bench_blit();
+		any = true;
+	}
+
+	if (all || strcmp(sel, "q16") == 0) {
+		bench_q16();
+		any = true;
+	}
+
+	if (all || strcmp(sel, "lbm") == 0) {
+		bench_lbm();
+		any = true;
+	}
+
+	if (!any) {
+		commands_printf("Unknown kernel %s. Available: crc16 packet buffer blit q16 lbm all", sel);
+	}
+}
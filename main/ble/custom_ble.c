@@ -328,11 +328,123 @@ static bool initialize_service_with_handles(
 	return true;
 }
 
+/*
+ * Ask the peer for a fast link once connected. Bluedroid does not
+ * expose an LE L2CAP channel, so the notification transport is made as
+ * fast as the link allows instead: full-size LL data PDUs, 2M PHY on
+ * BLE 5 phones and a short connection interval. Peers that do not
+ * support a feature simply reject that request.
+ */
+static void boost_link_params(uint8_t *remote_bda) {
+	esp_ble_gap_set_pkt_data_len(remote_bda, 251);
+
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	esp_ble_gap_set_preferred_phy(
+		remote_bda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+		ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF
+	);
+#endif
+
+	// 20-40 ms is within what both Android and iOS accept.
+	esp_ble_conn_update_params_t conn_params = {0};
+	memcpy(conn_params.bda, remote_bda, sizeof(esp_bd_addr_t));
+	conn_params.min_int = 0x10; // 20 ms
+	conn_params.max_int = 0x20; // 40 ms
+	conn_params.latency = 0;
+	conn_params.timeout = 400; // 4 s
+	esp_ble_gap_update_conn_params(&conn_params);
+}
+
+// Background scanning. The result callback runs in the BT host task.
+static scan_result_cb_t scan_cb = NULL;
+static volatile bool scan_should_run = false;
+static esp_ble_scan_params_t ble_scan_params = {
+	.scan_type          = BLE_SCAN_TYPE_PASSIVE,
+	.own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
+	.scan_filter_policy = BLE_SCAN_FILTER_ALLOW_ALL,
+	.scan_interval      = 160, // Unit: 0.625 ms
+	.scan_window        = 48,
+	.scan_duplicate     = BLE_SCAN_DUPLICATE_DISABLE,
+};
+
+void custom_ble_scan_handle_gap_event(
+	esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param
+) {
+	switch (event) {
+		case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
+			if (scan_should_run) {
+				// 0 keeps scanning until explicitly stopped.
+				esp_ble_gap_start_scanning(0);
+			}
+			break;
+		}
+		case ESP_GAP_BLE_SCAN_RESULT_EVT: {
+			if (param->scan_rst.search_evt == ESP_GAP_SEARCH_INQ_RES_EVT
+				&& scan_cb != NULL) {
+				scan_cb(
+					param->scan_rst.bda, param->scan_rst.rssi,
+					param->scan_rst.ble_adv,
+					param->scan_rst.adv_data_len + param->scan_rst.scan_rsp_len
+				);
+			}
+			break;
+		}
+		default: {
+			break;
+		}
+	}
+}
+
+custom_ble_result_t custom_ble_scan_start(
+	uint16_t interval_ms, uint16_t window_ms, scan_result_cb_t cb
+) {
+	if (cb == NULL || window_ms == 0 || window_ms > interval_ms) {
+		return CUSTOM_BLE_ERROR;
+	}
+
+	scan_cb         = cb;
+	scan_should_run = true;
+
+	ble_scan_params.scan_interval = (uint16_t)((uint32_t)interval_ms * 16 / 10);
+	ble_scan_params.scan_window   = (uint16_t)((uint32_t)window_ms * 16 / 10);
+
+	// The start command is issued from the GAP callback once the
+	// parameters have been applied.
+	if (esp_ble_gap_set_scan_params(&ble_scan_params) != ESP_OK) {
+		scan_should_run = false;
+		scan_cb         = NULL;
+		return CUSTOM_BLE_ESP_ERROR;
+	}
+
+	return CUSTOM_BLE_OK;
+}
+
+custom_ble_result_t custom_ble_scan_stop(void) {
+	if (!scan_should_run) {
+		return CUSTOM_BLE_OK;
+	}
+
+	scan_should_run = false;
+	scan_cb         = NULL;
+
+	if (esp_ble_gap_stop_scanning() != ESP_OK) {
+		return CUSTOM_BLE_ESP_ERROR;
+	}
+
+	return CUSTOM_BLE_OK;
+}
+
+bool custom_ble_scan_active(void) {
+	return scan_should_run;
+}
+
 static void gap_event_handler(
 	esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param
 ) {
 	STORED_LOGF("gap event %d", event);
 
+	custom_ble_scan_handle_gap_event(event, param);
+
 	switch (event) {
 		case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
 		case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT: {
@@ -465,20 +577,7 @@ static void gatts_event_handler(
 			esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_SCAN, ESP_PWR_LVL_P18);
 			esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT, ESP_PWR_LVL_P18);
 
-			// TODO: Should investigate if this is necessary for IOS.
-			// esp_ble_conn_update_params_t conn_params = {0};
-			// memcpy(
-			// 	conn_params.bda, param->connect.remote_bda,
-			// 	sizeof(esp_bd_addr_t)
-			// );
-			// /* For the iOS system, please refer to Apple official documents
-			//  * about the BLE connection parameters restrictions. */
-			// conn_params.latency = 0;
-			// conn_params.max_int = 0x20; // max_int = 0x20*1.25ms = 40ms
-			// conn_params.min_int = 0x10; // min_int = 0x10*1.25ms = 20ms
-			// conn_params.timeout = 400;	// timeout = 400*10ms = 4000ms
-			// // start sent the update connection parameters to the peer
-			// device. esp_ble_gap_update_conn_params(&conn_params);
+			boost_link_params(param->connect.remote_bda);
 
 			break;
 		}
@@ -1171,6 +1270,9 @@ uint16_t custom_ble_service_count() { return 0; }
 uint16_t custom_ble_get_services(uint16_t capacity, uint16_t service_handles[capacity]) { return 0; }
 int16_t custom_ble_attr_count(uint16_t service_handle) { return -1; }
 custom_ble_result_t custom_ble_get_attrs(uint16_t service_handle, uint16_t capacity, uint16_t service_handles[capacity], uint16_t *written_count) { return CUSTOM_BLE_NOT_STARTED; }
+custom_ble_result_t custom_ble_scan_start(uint16_t interval_ms, uint16_t window_ms, scan_result_cb_t cb) { return CUSTOM_BLE_NOT_STARTED; }
+custom_ble_result_t custom_ble_scan_stop(void) { return CUSTOM_BLE_NOT_STARTED; }
+bool custom_ble_scan_active(void) { return false; }
 custom_ble_result_t custom_ble_start() { return CUSTOM_BLE_NOT_STARTED; }
 bool custom_ble_started() { return false; }
 void custom_ble_init() { }
@@ -165,6 +165,54 @@ custom_ble_result_t custom_ble_update_adv(
 	size_t scan_rsp_len, const uint8_t scan_rsp_data_raw[scan_rsp_len]
 );
 
+typedef void (*scan_result_cb_t)(
+	const uint8_t addr[6], int rssi, const uint8_t *data, uint8_t len
+);
+
+/**
+ * Start background BLE scanning.
+ *
+ * The callback is invoked from the BT host task for every received
+ * advertisement, so it must be fast and non-blocking; heavier filtering
+ * and buffering belongs in the callback owner.
+ *
+ * Scanning runs alongside advertising and connections. The BLE stack
+ * has to be up, meaning either the normal BLE interface or the custom
+ * BLE server must have been started.
+ *
+ * @param interval_ms How often a scan window is scheduled.
+ * @param window_ms How long the receiver listens each interval. Must be
+ * larger than 0 and at most interval_ms.
+ * @param cb The function called with the advertiser address, RSSI and
+ * raw advertisement data of every result.
+ * @return
+ * - CUSTOM_BLE_OK
+ * - CUSTOM_BLE_ERROR:     Invalid parameters.
+ * - CUSTOM_BLE_ESP_ERROR: Setting the scan parameters failed, most
+ *   likely because the BLE stack is not running.
+ */
+custom_ble_result_t custom_ble_scan_start(
+	uint16_t interval_ms, uint16_t window_ms, scan_result_cb_t cb
+);
+
+/**
+ * Stop background scanning. Safe to call when not scanning.
+ */
+custom_ble_result_t custom_ble_scan_stop(void);
+
+bool custom_ble_scan_active(void);
+
+#ifdef CONFIG_BT_ENABLED
+/**
+ * Forward scan-related GAP events. The active GAP callback belongs to
+ * whichever BLE mode is running, so both comm_ble and the custom BLE
+ * server pass their events through here.
+ */
+void custom_ble_scan_handle_gap_event(
+	esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param
+);
+#endif
+
 /**
  * Configure a function that will be called whenever the value of a
  * characteristic or descriptor is written to by a client.
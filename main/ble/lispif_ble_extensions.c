@@ -21,6 +21,8 @@
 
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+
 #ifdef CONFIG_BT_ENABLED
 #include "esp_bt_defs.h"
 #endif
@@ -273,7 +275,7 @@ static uint8_t default_zero = 0;
 static void attr_write_handler(
 	uint16_t attr_handle, uint16_t len, uint8_t value[len]
 ) {
-	if (!event_ble_rx_en) {
+	if (!event_ble_rx_en || !lispif_events_allow(EVENT_RATE_BLE_RX)) {
 		return;
 	}
 	// This produces the lbm list ('event-ble-rx handle value).
@@ -1269,6 +1271,252 @@ static lbm_value ext_ble_get_attrs(lbm_value *args, lbm_uint argn) {
 	return list;
 }
 
+/*
+ * Background scanning. Dense RF environments deliver hundreds of
+ * advertisements per second, so results are filtered here in the BT
+ * host task and accumulated in a ring which scripts drain in batches
+ * with ble-scan-results, instead of one evaluator event per
+ * advertisement.
+ */
+
+#define SCAN_RING_LEN 16
+// Advertisement plus scan response.
+#define SCAN_ADV_MAX  62
+
+typedef struct {
+	uint8_t addr[6];
+	int8_t rssi;
+	uint8_t len;
+	uint8_t data[SCAN_ADV_MAX];
+} scan_ring_entry_t;
+
+static scan_ring_entry_t scan_ring[SCAN_RING_LEN];
+static volatile int scan_ring_read       = 0;
+static volatile int scan_ring_write      = 0;
+static volatile uint32_t scan_dropped    = 0;
+
+static int scan_filter_rssi      = -128;
+static uint8_t scan_filter_addr[6];
+static int scan_filter_addr_len  = 0;
+static uint16_t scan_filter_uuid = 0;
+static bool scan_filter_uuid_en  = false;
+
+// Guards the ring against the BT host task; held only for short copies.
+static portMUX_TYPE scan_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Check if the raw advertisement data contains the given 16-bit service
+ * uuid, by walking the AD structures of type 0x02 and 0x03 (incomplete
+ * and complete list of 16-bit uuids).
+ */
+static bool scan_adv_has_uuid16(const uint8_t *data, uint8_t len, uint16_t uuid) {
+	int i = 0;
+	while (i < len) {
+		int field_len = data[i];
+		if (field_len == 0 || i + 1 + field_len > len) {
+			break;
+		}
+
+		uint8_t type = data[i + 1];
+		if (type == 0x02 || type == 0x03) {
+			for (int j = i + 2; j + 1 <= i + field_len; j += 2) {
+				if ((uint16_t)(data[j] | (data[j + 1] << 8)) == uuid) {
+					return true;
+				}
+			}
+		}
+
+		i += field_len + 1;
+	}
+	return false;
+}
+
+static void scan_result_handler(
+	const uint8_t addr[6], int rssi, const uint8_t *data, uint8_t len
+) {
+	if (rssi < scan_filter_rssi) {
+		return;
+	}
+	if (scan_filter_addr_len > 0
+		&& memcmp(addr, scan_filter_addr, scan_filter_addr_len) != 0) {
+		return;
+	}
+	if (scan_filter_uuid_en && !scan_adv_has_uuid16(data, len, scan_filter_uuid)) {
+		return;
+	}
+
+	if (len > SCAN_ADV_MAX) {
+		len = SCAN_ADV_MAX;
+	}
+
+	portENTER_CRITICAL(&scan_mux);
+	int next = (scan_ring_write + 1) % SCAN_RING_LEN;
+	if (next == scan_ring_read) {
+		// Full rings drop the newest result; the consumer sees the
+		// loss through ble-scan-dropped.
+		scan_dropped++;
+	} else {
+		scan_ring_entry_t *entry = &scan_ring[scan_ring_write];
+		memcpy(entry->addr, addr, 6);
+		entry->rssi = (int8_t)rssi;
+		entry->len  = len;
+		memcpy(entry->data, data, len);
+		scan_ring_write = next;
+	}
+	portEXIT_CRITICAL(&scan_mux);
+}
+
+/**
+ * signature: (ble-scan-start optRssiMin optAddrPrefix optUuid16) -> bool
+ *
+ * Start background scanning with a C-side result filter. Every argument
+ * is optional and may be passed as nil to disable that part of the
+ * filter.
+ *
+ * @param optRssiMin Results weaker than this RSSI (in dBm) are
+ * discarded.
+ * @param optAddrPrefix Byte array of 1 to 6 bytes that the advertiser
+ * address must start with.
+ * @param optUuid16 A 16-bit service uuid that must be present in the
+ * advertisement data.
+ * @return True on success, or an eval_error if scanning could not be
+ * started, such as when the BLE stack is not running.
+ */
+static lbm_value ext_ble_scan_start(lbm_value *args, lbm_uint argn) {
+	if (argn > 3) {
+		return ENC_SYM_TERROR;
+	}
+
+	int rssi_min = -128;
+	if (argn >= 1 && !lbm_is_symbol_nil(args[0])) {
+		if (!lbm_is_number(args[0])) {
+			return ENC_SYM_TERROR;
+		}
+		rssi_min = lbm_dec_as_i32(args[0]);
+	}
+
+	uint8_t addr[6] = {0};
+	int addr_len    = 0;
+	if (argn >= 2 && !lbm_is_symbol_nil(args[1])) {
+		lbm_array_header_t *array = lbm_dec_array_header(args[1]);
+		if (array == NULL || array->size < 1 || array->size > 6) {
+			return ENC_SYM_TERROR;
+		}
+		memcpy(addr, array->data, array->size);
+		addr_len = array->size;
+	}
+
+	uint16_t uuid = 0;
+	bool uuid_en  = false;
+	if (argn >= 3 && !lbm_is_symbol_nil(args[2])) {
+		if (!lbm_is_number(args[2])) {
+			return ENC_SYM_TERROR;
+		}
+		uuid    = (uint16_t)lbm_dec_as_u32(args[2]);
+		uuid_en = true;
+	}
+
+	// Configure the filter and empty the ring before results can start
+	// arriving.
+	scan_filter_rssi = rssi_min;
+	memcpy(scan_filter_addr, addr, 6);
+	scan_filter_addr_len = addr_len;
+	scan_filter_uuid     = uuid;
+	scan_filter_uuid_en  = uuid_en;
+
+	portENTER_CRITICAL(&scan_mux);
+	scan_ring_read  = 0;
+	scan_ring_write = 0;
+	scan_dropped    = 0;
+	portEXIT_CRITICAL(&scan_mux);
+
+	if (custom_ble_scan_start(100, 30, scan_result_handler) != CUSTOM_BLE_OK) {
+		return ENC_SYM_EERROR;
+	}
+
+	return ENC_SYM_TRUE;
+}
+
+/**
+ * signature: (ble-scan-stop) -> bool
+ */
+static lbm_value ext_ble_scan_stop(lbm_value *args, lbm_uint argn) {
+	(void)args;
+	(void)argn;
+
+	if (custom_ble_scan_stop() != CUSTOM_BLE_OK) {
+		return ENC_SYM_EERROR;
+	}
+
+	return ENC_SYM_TRUE;
+}
+
+/**
+ * signature: (ble-scan-results) -> list
+ *
+ * Drain the accumulated scan results. Each result is a list
+ * (addr:byte-array rssi:number data:byte-array), with the most recent
+ * result first. Returns nil when no results have accumulated.
+ */
+static lbm_value ext_ble_scan_results(lbm_value *args, lbm_uint argn) {
+	(void)args;
+	(void)argn;
+
+	lbm_value list = ENC_SYM_NIL;
+
+	for (;;) {
+		scan_ring_entry_t entry;
+
+		portENTER_CRITICAL(&scan_mux);
+		if (scan_ring_read == scan_ring_write) {
+			portEXIT_CRITICAL(&scan_mux);
+			break;
+		}
+		entry          = scan_ring[scan_ring_read];
+		scan_ring_read = (scan_ring_read + 1) % SCAN_RING_LEN;
+		portEXIT_CRITICAL(&scan_mux);
+
+		lbm_value addr_val;
+		if (!lbm_heap_allocate_array(&addr_val, 6)) {
+			return ENC_SYM_MERROR;
+		}
+		memcpy(((lbm_array_header_t *)lbm_car(addr_val))->data, entry.addr, 6);
+
+		lbm_value data_val;
+		if (!lbm_heap_allocate_array(&data_val, entry.len)) {
+			return ENC_SYM_MERROR;
+		}
+		memcpy(
+			((lbm_array_header_t *)lbm_car(data_val))->data, entry.data,
+			entry.len
+		);
+
+		lbm_value result = lbm_cons(
+			addr_val,
+			lbm_cons(lbm_enc_i(entry.rssi), lbm_cons(data_val, ENC_SYM_NIL))
+		);
+		list = lbm_cons(result, list);
+		if (list == ENC_SYM_MERROR) {
+			return list;
+		}
+	}
+
+	return list;
+}
+
+/**
+ * signature: (ble-scan-dropped) -> number
+ *
+ * How many matching results have been discarded because the ring was
+ * full since scanning was last started.
+ */
+static lbm_value ext_ble_scan_dropped(lbm_value *args, lbm_uint argn) {
+	(void)args;
+	(void)argn;
+
+	return lbm_enc_u32(scan_dropped);
+}
+
 void lispif_load_ble_extensions(void) {
 	register_symbols();
 
@@ -1284,6 +1532,11 @@ void lispif_load_ble_extensions(void) {
 	lbm_add_extension("ble-attr-set-value", ext_ble_attr_set_value);
 	lbm_add_extension("ble-get-services", ext_ble_get_services);
 	lbm_add_extension("ble-get-attrs", ext_ble_get_attrs);
+
+	lbm_add_extension("ble-scan-start", ext_ble_scan_start);
+	lbm_add_extension("ble-scan-stop", ext_ble_scan_stop);
+	lbm_add_extension("ble-scan-results", ext_ble_scan_results);
+	lbm_add_extension("ble-scan-dropped", ext_ble_scan_dropped);
 }
 
 #else
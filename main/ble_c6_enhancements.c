@@ -31,11 +31,100 @@
 #include "esp_bt_device.h"
 #include "esp_err.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include <string.h>
 
 static const char *TAG = "BLE_C6";
 static ble_c6_config_t current_config = BLE_C6_CONFIG_DEFAULT();
 
+// Per-connection link negotiation results and achieved-throughput counters.
+// The GAP handler in comm_ble.c feeds PHY/DLE completion events and the
+// TX/RX paths account payload bytes here; the rates are recomputed over
+// roughly one-second windows so the terminal shows recent throughput.
+static volatile uint8_t link_tx_phy = 1;
+static volatile uint8_t link_rx_phy = 1;
+static volatile uint16_t link_tx_data_len = 27;
+static int64_t link_window_start = 0;
+static uint32_t link_tx_bytes_window = 0;
+static uint32_t link_rx_bytes_window = 0;
+static volatile uint32_t link_tx_bps = 0;
+static volatile uint32_t link_rx_bps = 0;
+
+static const char *phy_to_str(uint8_t phy) {
+    switch (phy) {
+        case 1: return "1M";
+        case 2: return "2M";
+        case 3: return "Coded";
+        default: return "?";
+    }
+}
+
+static void link_rate_update(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - link_window_start;
+    if (elapsed >= 1000000) {
+        link_tx_bps = (uint32_t)(((uint64_t)link_tx_bytes_window * 8 * 1000000) / elapsed);
+        link_rx_bps = (uint32_t)(((uint64_t)link_rx_bytes_window * 8 * 1000000) / elapsed);
+        link_tx_bytes_window = 0;
+        link_rx_bytes_window = 0;
+        link_window_start = now;
+    }
+}
+
+void ble_c6_link_reset(void) {
+    link_tx_phy = 1;
+    link_rx_phy = 1;
+    link_tx_data_len = 27;
+    link_tx_bytes_window = 0;
+    link_rx_bytes_window = 0;
+    link_tx_bps = 0;
+    link_rx_bps = 0;
+    link_window_start = esp_timer_get_time();
+}
+
+void ble_c6_link_phy_updated(uint8_t tx_phy, uint8_t rx_phy) {
+    link_tx_phy = tx_phy;
+    link_rx_phy = rx_phy;
+    ESP_LOGI(TAG, "Negotiated PHY: TX %s, RX %s", phy_to_str(tx_phy), phy_to_str(rx_phy));
+}
+
+void ble_c6_link_data_len_updated(uint16_t tx_len, uint16_t rx_len) {
+    link_tx_data_len = tx_len;
+    ESP_LOGI(TAG, "Negotiated data length: TX %d, RX %d bytes", tx_len, rx_len);
+}
+
+void ble_c6_link_note_tx(uint32_t bytes) {
+    link_tx_bytes_window += bytes;
+    link_rate_update();
+}
+
+void ble_c6_link_note_rx(uint32_t bytes) {
+    link_rx_bytes_window += bytes;
+    link_rate_update();
+}
+
+uint8_t ble_c6_link_get_tx_phy(void) {
+    return link_tx_phy;
+}
+
+uint8_t ble_c6_link_get_rx_phy(void) {
+    return link_rx_phy;
+}
+
+uint16_t ble_c6_link_get_tx_data_len(void) {
+    return link_tx_data_len;
+}
+
+uint32_t ble_c6_link_get_tx_bps(void) {
+    link_rate_update();
+    return link_tx_bps;
+}
+
+uint32_t ble_c6_link_get_rx_bps(void) {
+    link_rate_update();
+    return link_rx_bps;
+}
+
 void ble_c6_init_enhancements(void) {
     ESP_LOGI(TAG, "Initializing ESP32-C6 Bluetooth 5.3 enhancements (Research-Based)");
     
@@ -97,6 +97,18 @@ void ble_c6_configure_advanced_security_features(void);   // Enhanced security p
 void ble_c6_enable_multi_connection_optimization(void);   // Multi-connection optimization
 void ble_c6_enable_high_performance_mode(void);          // Maximum performance configuration
 
+// Per-connection link negotiation results and achieved throughput
+void ble_c6_link_reset(void);                            // Call on connect
+void ble_c6_link_phy_updated(uint8_t tx_phy, uint8_t rx_phy);
+void ble_c6_link_data_len_updated(uint16_t tx_len, uint16_t rx_len);
+void ble_c6_link_note_tx(uint32_t bytes);                // Account sent payload bytes
+void ble_c6_link_note_rx(uint32_t bytes);                // Account received payload bytes
+uint8_t ble_c6_link_get_tx_phy(void);                    // 1=1M, 2=2M, 3=Coded
+uint8_t ble_c6_link_get_rx_phy(void);
+uint16_t ble_c6_link_get_tx_data_len(void);              // Negotiated TX PDU payload
+uint32_t ble_c6_link_get_tx_bps(void);                   // Achieved throughput, bits/s
+uint32_t ble_c6_link_get_rx_bps(void);
+
 #else
 // Stub functions for non-C6 targets
 static inline void ble_c6_init_enhancements(void) {}
@@ -114,6 +126,16 @@ static inline void ble_c6_enable_all_phy_modes(void) {}
 static inline void ble_c6_configure_advanced_security_features(void) {}
 static inline void ble_c6_enable_multi_connection_optimization(void) {}
 static inline void ble_c6_enable_high_performance_mode(void) {}
+static inline void ble_c6_link_reset(void) {}
+static inline void ble_c6_link_phy_updated(uint8_t tx_phy, uint8_t rx_phy) {}
+static inline void ble_c6_link_data_len_updated(uint16_t tx_len, uint16_t rx_len) {}
+static inline void ble_c6_link_note_tx(uint32_t bytes) {}
+static inline void ble_c6_link_note_rx(uint32_t bytes) {}
+static inline uint8_t ble_c6_link_get_tx_phy(void) { return 0; }
+static inline uint8_t ble_c6_link_get_rx_phy(void) { return 0; }
+static inline uint16_t ble_c6_link_get_tx_data_len(void) { return 0; }
+static inline uint32_t ble_c6_link_get_tx_bps(void) { return 0; }
+static inline uint32_t ble_c6_link_get_rx_bps(void) { return 0; }
 #endif
 
 #else
@@ -133,6 +155,16 @@ static inline void ble_c6_enable_all_phy_modes(void) {}
 static inline void ble_c6_configure_advanced_security_features(void) {}
 static inline void ble_c6_enable_multi_connection_optimization(void) {}
 static inline void ble_c6_enable_high_performance_mode(void) {}
+static inline void ble_c6_link_reset(void) {}
+static inline void ble_c6_link_phy_updated(uint8_t tx_phy, uint8_t rx_phy) {}
+static inline void ble_c6_link_data_len_updated(uint16_t tx_len, uint16_t rx_len) {}
+static inline void ble_c6_link_note_tx(uint32_t bytes) {}
+static inline void ble_c6_link_note_rx(uint32_t bytes) {}
+static inline uint8_t ble_c6_link_get_tx_phy(void) { return 0; }
+static inline uint8_t ble_c6_link_get_rx_phy(void) { return 0; }
+static inline uint16_t ble_c6_link_get_tx_data_len(void) { return 0; }
+static inline uint32_t ble_c6_link_get_tx_bps(void) { return 0; }
+static inline uint32_t ble_c6_link_get_rx_bps(void) { return 0; }
 #endif
 
 #endif /* BLE_C6_ENHANCEMENTS_H_ */
\ No newline at end of file
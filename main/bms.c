@@ -34,6 +34,52 @@
 
 // Settings
 #define MAX_CAN_AGE_SEC				2.0
+#define BMS_FRAME_RESEND_SEC		5.0
+
+/*
+ * Change-triggered CAN emission. Each outgoing frame slot keeps a hash
+ * of the payload it last put on the bus plus a send timestamp.
+ * bms_send_status_can serializes as before but only transmits frames
+ * whose payload actually changed, so a quiescent pack generates almost
+ * no bus traffic and the send timer can run fast enough that a real
+ * change goes out within one detection interval. Every frame is still
+ * re-sent at least once per BMS_FRAME_RESEND_SEC so nodes joining the
+ * bus late and receiver age checks converge.
+ */
+enum {
+	BMS_FR_V_TOT = 0,
+	BMS_FR_I,
+	BMS_FR_AH_WH,
+	BMS_FR_BAL,
+	BMS_FR_HUM,
+	BMS_FR_SOC_STAT,
+	BMS_FR_AH_WH_CHG,
+	BMS_FR_AH_WH_DIS,
+	BMS_FR_STATUS_FIRST, // 5 status frames
+	BMS_FR_CELL_FIRST = BMS_FR_STATUS_FIRST + 5,
+	BMS_FR_TEMP_FIRST = BMS_FR_CELL_FIRST + (BMS_MAX_CELLS + 2) / 3,
+	BMS_FR_NUM = BMS_FR_TEMP_FIRST + (BMS_MAX_TEMPS + 2) / 3,
+};
+
+static uint32_t frame_hash[BMS_FR_NUM];
+static uint32_t frame_send_time[BMS_FR_NUM];
+
+static bool frame_changed(int slot, const uint8_t *data, int len) {
+	// FNV-1a, cheap enough to run over every frame payload.
+	uint32_t hash = 2166136261u;
+	for (int i = 0;i < len;i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+
+	if (hash == frame_hash[slot] &&
+			UTILS_AGE_S(frame_send_time[slot]) < BMS_FRAME_RESEND_SEC) {
+		return false;
+	}
+
+	frame_hash[slot] = hash;
+	frame_send_time[slot] = xTaskGetTickCount();
+	return true;
+}
 
 // Private variables
 static volatile bms_values m_values;
@@ -297,7 +343,10 @@ void bms_process_cmd(unsigned char *data, unsigned int len,
 	switch (packet_id) {
 	case COMM_BMS_GET_VALUES: {
 		int32_t ind = 0;
-		uint8_t send_buffer[256];
+		// Worst case with BMS_MAX_CELLS/BMS_MAX_TEMPS populated is ~356
+		// bytes (header, floats, 50 cells + balance states, 50 temps,
+		// counters and the status string), so 256 would overflow.
+		uint8_t send_buffer[512];
 
 		send_buffer[ind++] = packet_id;
 
@@ -359,6 +408,118 @@ void bms_process_cmd(unsigned char *data, unsigned int len,
 		reply_func(send_buffer, ind);
 	} break;
 
+	case COMM_BMS_GET_VALUES_SELECTIVE: {
+		/*
+		 * Mask-based variant of COMM_BMS_GET_VALUES for high-rate polling.
+		 * The request carries a uint32 field-group mask and the reply echoes
+		 * the mask followed by only the selected groups, in the same order
+		 * and encoding as the full packet. This keeps the hot poll path down
+		 * to the few fields a client actually displays.
+		 */
+		int32_t ind2 = 0;
+		uint32_t mask = buffer_get_uint32(data, &ind2);
+
+		int32_t ind = 0;
+		// Same worst case as the full packet above plus the echoed mask.
+		uint8_t send_buffer[512];
+
+		send_buffer[ind++] = packet_id;
+		buffer_append_uint32(send_buffer, mask, &ind);
+
+		if (mask & ((uint32_t)1 << 0)) {
+			buffer_append_float32(send_buffer, m_values.v_tot, 1e6, &ind);
+		}
+		if (mask & ((uint32_t)1 << 1)) {
+			buffer_append_float32(send_buffer, m_values.v_charge, 1e6, &ind);
+		}
+		if (mask & ((uint32_t)1 << 2)) {
+			buffer_append_float32(send_buffer, m_values.i_in, 1e6, &ind);
+		}
+		if (mask & ((uint32_t)1 << 3)) {
+			buffer_append_float32(send_buffer, m_values.i_in_ic, 1e6, &ind);
+		}
+		if (mask & ((uint32_t)1 << 4)) {
+			buffer_append_float32(send_buffer, m_values.ah_cnt, 1e3, &ind);
+		}
+		if (mask & ((uint32_t)1 << 5)) {
+			buffer_append_float32(send_buffer, m_values.wh_cnt, 1e3, &ind);
+		}
+
+		// Cell voltages
+		if (mask & ((uint32_t)1 << 6)) {
+			send_buffer[ind++] = m_values.cell_num;
+			for (int i = 0;i < m_values.cell_num;i++) {
+				buffer_append_float16(send_buffer, m_values.v_cell[i], 1e3, &ind);
+			}
+		}
+
+		// Balancing state. The cell count is repeated so that this group can
+		// be requested without the voltages.
+		if (mask & ((uint32_t)1 << 7)) {
+			send_buffer[ind++] = m_values.cell_num;
+			for (int i = 0;i < m_values.cell_num;i++) {
+				send_buffer[ind++] = m_values.bal_state[i];
+			}
+		}
+
+		// Temperatures
+		if (mask & ((uint32_t)1 << 8)) {
+			send_buffer[ind++] = m_values.temp_adc_num;
+			for (int i = 0;i < m_values.temp_adc_num;i++) {
+				buffer_append_float16(send_buffer, m_values.temps_adc[i], 1e2, &ind);
+			}
+			buffer_append_float16(send_buffer, m_values.temp_ic, 1e2, &ind);
+		}
+
+		// Humidity
+		if (mask & ((uint32_t)1 << 9)) {
+			buffer_append_float16(send_buffer, m_values.temp_hum, 1e2, &ind);
+			buffer_append_float16(send_buffer, m_values.hum, 1e2, &ind);
+		}
+
+		// Highest cell temperature
+		if (mask & ((uint32_t)1 << 10)) {
+			buffer_append_float16(send_buffer, m_values.temp_max_cell, 1e2, &ind);
+		}
+
+		// State of charge and state of health
+		if (mask & ((uint32_t)1 << 11)) {
+			buffer_append_float16(send_buffer, m_values.soc, 1e3, &ind);
+			buffer_append_float16(send_buffer, m_values.soh, 1e3, &ind);
+		}
+
+		// CAN ID
+		if (mask & ((uint32_t)1 << 12)) {
+			send_buffer[ind++] = m_values.can_id;
+		}
+
+		// Total charge and discharge counters
+		if (mask & ((uint32_t)1 << 13)) {
+			buffer_append_float32_auto(send_buffer, m_values.ah_cnt_chg_total, &ind);
+			buffer_append_float32_auto(send_buffer, m_values.wh_cnt_chg_total, &ind);
+			buffer_append_float32_auto(send_buffer, m_values.ah_cnt_dis_total, &ind);
+			buffer_append_float32_auto(send_buffer, m_values.wh_cnt_dis_total, &ind);
+		}
+
+		// Pressure
+		if (mask & ((uint32_t)1 << 14)) {
+			buffer_append_float16(send_buffer, m_values.pressure, 1e-1, &ind);
+		}
+
+		// Data version
+		if (mask & ((uint32_t)1 << 15)) {
+			send_buffer[ind++] = m_values.data_version;
+		}
+
+		// Status string
+		if (mask & ((uint32_t)1 << 16)) {
+			strcpy((char*)(send_buffer + ind), (char*)m_values.status);
+			ind += strlen((char*)m_values.status) + 1;
+		}
+
+		reply_func(send_buffer, ind);
+	} break;
+
 	default:
 		break;
 	}
@@ -410,17 +571,23 @@ void bms_send_status_can(void) {
 
 	buffer_append_float32_auto(buffer, m_values.v_tot, &send_index);
 	buffer_append_float32_auto(buffer, m_values.v_charge, &send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_V_TOT << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_V_TOT, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_V_TOT << 8), buffer, send_index);
+	}
 
 	send_index = 0;
 	buffer_append_float32_auto(buffer, m_values.i_in, &send_index);
 	buffer_append_float32_auto(buffer, m_values.i_in_ic, &send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_I << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_I, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_I << 8), buffer, send_index);
+	}
 
 	send_index = 0;
 	buffer_append_float32_auto(buffer, m_values.ah_cnt, &send_index);
 	buffer_append_float32_auto(buffer, m_values.wh_cnt, &send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_AH_WH, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH << 8), buffer, send_index);
+	}
 
 	int cell_now = 0;
 	int cell_max = m_values.cell_num;
@@ -428,6 +595,7 @@ void bms_send_status_can(void) {
 		cell_max = BMS_MAX_CELLS;
 	}
 
+	int cell_frame = 0;
 	while (cell_now < cell_max) {
 		send_index = 0;
 		buffer[send_index++] = cell_now;
@@ -441,7 +609,9 @@ void bms_send_status_can(void) {
 		if (cell_now < cell_max) {
 			buffer_append_float16(buffer, m_values.v_cell[cell_now++], 1e3, &send_index);
 		}
-		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_V_CELL << 8), buffer, send_index);
+		if (frame_changed(BMS_FR_CELL_FIRST + cell_frame++, buffer, send_index)) {
+			comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_V_CELL << 8), buffer, send_index);
+		}
 	}
 
 	send_index = 0;
@@ -457,7 +627,9 @@ void bms_send_status_can(void) {
 	buffer[send_index++] = (bal_state >> 16) & 0xFF;
 	buffer[send_index++] = (bal_state >> 8) & 0xFF;
 	buffer[send_index++] = (bal_state >> 0) & 0xFF;
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_BAL << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_BAL, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_BAL << 8), buffer, send_index);
+	}
 
 	int temp_now = 0;
 	int temp_max = m_values.temp_adc_num;
@@ -465,6 +637,7 @@ void bms_send_status_can(void) {
 		temp_max = BMS_MAX_TEMPS;
 	}
 
+	int temp_frame = 0;
 	while (temp_now < temp_max) {
 		send_index = 0;
 		buffer[send_index++] = temp_now;
@@ -478,14 +651,18 @@ void bms_send_status_can(void) {
 		if (temp_now < temp_max) {
 			buffer_append_float16(buffer, m_values.temps_adc[temp_now++], 1e2, &send_index);
 		}
-		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_TEMPS << 8), buffer, send_index);
+		if (frame_changed(BMS_FR_TEMP_FIRST + temp_frame++, buffer, send_index)) {
+			comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_TEMPS << 8), buffer, send_index);
+		}
 	}
 
 	send_index = 0;
 	buffer_append_float16(buffer, m_values.temp_hum, 1e2, &send_index);
 	buffer_append_float16(buffer, m_values.hum, 1e2, &send_index);
 	buffer_append_float16(buffer, m_values.temp_ic, 1e2, &send_index); // Put IC temp here instead of making mew msg
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_HUM << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_HUM, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_HUM << 8), buffer, send_index);
+	}
 
 	/*
 	 * CAN_PACKET_BMS_SOC_SOH_TEMP_STAT
@@ -510,21 +687,28 @@ void bms_send_status_can(void) {
 			((m_values.is_balancing ? 1 : 0) << 1) |
 			((m_values.is_charge_allowed ? 1 : 0) << 2) |
 			(m_values.data_version << 4);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_SOC_SOH_TEMP_STAT << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_SOC_STAT, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_SOC_SOH_TEMP_STAT << 8), buffer, send_index);
+	}
 
 	send_index = 0;
 	buffer_append_float32_auto(buffer, m_values.ah_cnt_chg_total, &send_index);
 	buffer_append_float32_auto(buffer, m_values.wh_cnt_chg_total, &send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH_CHG_TOTAL << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_AH_WH_CHG, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH_CHG_TOTAL << 8), buffer, send_index);
+	}
 
 	send_index = 0;
 	buffer_append_float32_auto(buffer, m_values.ah_cnt_dis_total, &send_index);
 	buffer_append_float32_auto(buffer, m_values.wh_cnt_dis_total, &send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH_DIS_TOTAL << 8), buffer, send_index);
+	if (frame_changed(BMS_FR_AH_WH_DIS, buffer, send_index)) {
+		comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_AH_WH_DIS_TOTAL << 8), buffer, send_index);
+	}
 
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_STATUS_1 << 8), (uint8_t*)m_values.status, send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_STATUS_2 << 8), (uint8_t*)m_values.status + 8, send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_STATUS_3 << 8), (uint8_t*)m_values.status + 16, send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_STATUS_4 << 8), (uint8_t*)m_values.status + 24, send_index);
-	comm_can_transmit_eid(id | ((uint32_t)CAN_PACKET_BMS_STATUS_5 << 8), (uint8_t*)m_values.status + 32, send_index);
+	for (int i = 0;i < 5;i++) {
+		if (frame_changed(BMS_FR_STATUS_FIRST + i, (uint8_t*)m_values.status + i * 8, send_index)) {
+			comm_can_transmit_eid(id | ((uint32_t)(CAN_PACKET_BMS_STATUS_1 + i) << 8),
+					(uint8_t*)m_values.status + i * 8, send_index);
+		}
+	}
 }
@@ -247,3 +247,78 @@ double buffer_get_float64_auto(const uint8_t *buffer, int32_t *index) {
 	double err = buffer_get_float32_auto(buffer, index);
 	return n + err;
 }
+
+/**
+ * Serialize an array of field descriptors into buffer in one pass. This
+ * replaces long runs of individual buffer_append-calls in telemetry hot
+ * paths; the index is kept in a local and written back once at the end.
+ *
+ * @param buffer
+ * The buffer to append to.
+ *
+ * @param fields
+ * Array of (type, scale, pointer) descriptors. The scale is only used
+ * by the scaled fixed-point types.
+ *
+ * @param field_num
+ * Number of entries in fields.
+ *
+ * @param index
+ * Position in buffer to start appending at. Will be incremented by the
+ * total serialized size.
+ */
+void buffer_append_fields(uint8_t *buffer, const buffer_field_t *fields,
+		int field_num, int32_t *index) {
+	int32_t ind = *index;
+
+	for (int i = 0;i < field_num;i++) {
+		const buffer_field_t *f = &fields[i];
+
+		switch (f->type) {
+		case BUFFER_FIELD_INT8:
+			buffer[ind++] = *(const int8_t*)f->value;
+			break;
+
+		case BUFFER_FIELD_UINT8:
+			buffer[ind++] = *(const uint8_t*)f->value;
+			break;
+
+		case BUFFER_FIELD_INT16:
+			buffer_append_int16(buffer, *(const int16_t*)f->value, &ind);
+			break;
+
+		case BUFFER_FIELD_UINT16:
+			buffer_append_uint16(buffer, *(const uint16_t*)f->value, &ind);
+			break;
+
+		case BUFFER_FIELD_INT32:
+			buffer_append_int32(buffer, *(const int32_t*)f->value, &ind);
+			break;
+
+		case BUFFER_FIELD_UINT32:
+			buffer_append_uint32(buffer, *(const uint32_t*)f->value, &ind);
+			break;
+
+		case BUFFER_FIELD_FLOAT16:
+			buffer_append_float16(buffer, *(const float*)f->value, f->scale, &ind);
+			break;
+
+		case BUFFER_FIELD_FLOAT32:
+			buffer_append_float32(buffer, *(const float*)f->value, f->scale, &ind);
+			break;
+
+		case BUFFER_FIELD_FLOAT32_AUTO:
+			buffer_append_float32_auto(buffer, *(const float*)f->value, &ind);
+			break;
+
+		case BUFFER_FIELD_DOUBLE64:
+			buffer_append_double64(buffer, *(const double*)f->value, f->scale, &ind);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	*index = ind;
+}
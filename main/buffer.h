@@ -22,6 +22,26 @@
 
 #include <stdint.h>
 
+// Field descriptor types for buffer_append_fields.
+typedef enum {
+	BUFFER_FIELD_INT8 = 0,
+	BUFFER_FIELD_UINT8,
+	BUFFER_FIELD_INT16,
+	BUFFER_FIELD_UINT16,
+	BUFFER_FIELD_INT32,
+	BUFFER_FIELD_UINT32,
+	BUFFER_FIELD_FLOAT16,
+	BUFFER_FIELD_FLOAT32,
+	BUFFER_FIELD_FLOAT32_AUTO,
+	BUFFER_FIELD_DOUBLE64,
+} BUFFER_FIELD_TYPE;
+
+typedef struct {
+	BUFFER_FIELD_TYPE type;
+	float scale;
+	const void *value;
+} buffer_field_t;
+
 void buffer_append_int16(uint8_t* buffer, int16_t number, int32_t *index);
 void buffer_append_uint16(uint8_t* buffer, uint16_t number, int32_t *index);
 void buffer_append_int32(uint8_t* buffer, int32_t number, int32_t *index);
@@ -33,6 +53,8 @@ void buffer_append_float32(uint8_t* buffer, float number, float scale, int32_t *
 void buffer_append_double64(uint8_t* buffer, double number, double scale, int32_t *index);
 void buffer_append_float32_auto(uint8_t* buffer, float number, int32_t *index);
 void buffer_append_float64_auto(uint8_t* buffer, double number, int32_t *index);
+void buffer_append_fields(uint8_t *buffer, const buffer_field_t *fields,
+		int field_num, int32_t *index);
 
 int16_t buffer_get_int16(const uint8_t *buffer, int32_t *index);
 uint16_t buffer_get_uint16(const uint8_t *buffer, int32_t *index);
@@ -0,0 +1,87 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include "coex_stats.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+/*
+ * The coexistence arbiter on the C6 is not observable directly, so the
+ * transmit paths in comm_wifi.c and comm_ble.c report what they see
+ * instead: a transmit that went through is a grant, one that was
+ * rejected or had to wait for the stack is a denial, and any transmit
+ * stalled longer than COEX_SPIKE_THRESHOLD_MS lands in the spike log
+ * with a timestamp. The counters are plain increments from the
+ * respective transmit tasks; only the spike ring index is shared, and
+ * a torn entry there is acceptable for a diagnostics surface.
+ */
+
+static volatile uint32_t stats_grants[COEX_RADIO_NUM] = {0};
+static volatile uint32_t stats_denials[COEX_RADIO_NUM] = {0};
+static volatile uint32_t stats_spike_cnt = 0;
+static coex_spike_t stats_spikes[COEX_SPIKE_LOG_LEN] = {0};
+static volatile int stats_spike_next = 0;
+
+void coex_stats_note_grant(COEX_RADIO radio) {
+	if (radio < COEX_RADIO_NUM) {
+		stats_grants[radio]++;
+	}
+}
+
+void coex_stats_note_denial(COEX_RADIO radio) {
+	if (radio < COEX_RADIO_NUM) {
+		stats_denials[radio]++;
+	}
+}
+
+void coex_stats_note_tx_time(COEX_RADIO radio, uint32_t dur_ms) {
+	if (radio >= COEX_RADIO_NUM || dur_ms < COEX_SPIKE_THRESHOLD_MS) {
+		return;
+	}
+
+	int ind = stats_spike_next;
+	stats_spike_next = (ind + 1) % COEX_SPIKE_LOG_LEN;
+
+	stats_spikes[ind].t_ms = (uint32_t)(esp_timer_get_time() / 1000);
+	stats_spikes[ind].dur_ms = dur_ms > 0xFFFF ? 0xFFFF : dur_ms;
+	stats_spikes[ind].radio = radio;
+
+	stats_spike_cnt++;
+}
+
+void coex_stats_get(coex_stats_t *stats) {
+	for (int i = 0;i < COEX_RADIO_NUM;i++) {
+		stats->grants[i] = stats_grants[i];
+		stats->denials[i] = stats_denials[i];
+	}
+	stats->spike_cnt = stats_spike_cnt;
+	memcpy(stats->spikes, stats_spikes, sizeof(stats_spikes));
+}
+
+void coex_stats_reset(void) {
+	for (int i = 0;i < COEX_RADIO_NUM;i++) {
+		stats_grants[i] = 0;
+		stats_denials[i] = 0;
+	}
+	stats_spike_cnt = 0;
+	stats_spike_next = 0;
+	memset(stats_spikes, 0, sizeof(stats_spikes));
+}
@@ -0,0 +1,56 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#ifndef MAIN_COEX_STATS_H_
+#define MAIN_COEX_STATS_H_
+
+#include <stdint.h>
+
+// Number of latency spikes kept in the log
+#define COEX_SPIKE_LOG_LEN			8
+// A transmit taking longer than this is logged as a spike
+#define COEX_SPIKE_THRESHOLD_MS		50
+
+typedef enum {
+	COEX_RADIO_WIFI = 0,
+	COEX_RADIO_BLE,
+	COEX_RADIO_NUM
+} COEX_RADIO;
+
+typedef struct {
+	uint32_t t_ms;    // Milliseconds since boot when the spike happened
+	uint16_t dur_ms;  // How long the transmit was stalled
+	uint8_t radio;    // COEX_RADIO the spike was seen on
+} coex_spike_t;
+
+typedef struct {
+	uint32_t grants[COEX_RADIO_NUM];   // Transmits that went through
+	uint32_t denials[COEX_RADIO_NUM];  // Transmits rejected or stalled
+	uint32_t spike_cnt;                // Total spikes since reset
+	coex_spike_t spikes[COEX_SPIKE_LOG_LEN]; // Most recent spikes
+} coex_stats_t;
+
+// Functions
+void coex_stats_note_grant(COEX_RADIO radio);
+void coex_stats_note_denial(COEX_RADIO radio);
+void coex_stats_note_tx_time(COEX_RADIO radio, uint32_t dur_ms);
+void coex_stats_get(coex_stats_t *stats);
+void coex_stats_reset(void);
+
+#endif /* MAIN_COEX_STATS_H_ */
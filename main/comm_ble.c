@@ -25,6 +25,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #ifdef CONFIG_BT_ENABLED
@@ -38,11 +39,18 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
 #include "packet.h"
+#include "pkt_trace.h"
 #include "commands.h"
+#include "mempools.h"
 #include "conf_general.h"
 #include "main.h"
+#include "ble_c6_enhancements.h"
+#include "coex_stats.h"
+#include "comm_service.h"
+#include "custom_ble.h"
 
 #ifdef CONFIG_BT_ENABLED
 
@@ -65,6 +73,16 @@ static uint16_t ble_current_mtu = DEFAULT_BLE_MTU;
 static uint16_t notify_conn_id = 0;
 static esp_gatt_if_t notify_gatts_if;
 
+// Session profile for the connection parameters. Bulk transfers want a
+// minimal connection interval so every event carries data; idle
+// telemetry relaxes back so the radio (and the phone battery) is not
+// kept busy between packets. Bulk is entered on demand and left after
+// BLE_SESSION_BULK_HOLD_MS without bulk activity.
+#define BLE_SESSION_BULK_HOLD_MS	3000
+static esp_bd_addr_t peer_bda = {0};
+static ble_session_profile_t session_profile = BLE_SESSION_PROFILE_IDLE;
+static int64_t session_bulk_time = 0;
+
 static uint8_t adv_config_done = 0;
 
 static uint8_t char1_str[GATTS_CHAR_VAL_LEN_MAX] = {0};
@@ -168,12 +186,73 @@ static esp_ble_adv_params_t ble_adv_params = {
 	.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
 };
 
+/*
+ * Two-phase advertising schedule. Right after boot we advertise with
+ * aggressive 20-30 ms intervals so the first connection after a
+ * power-cycle is established almost instantly, then fall back to the
+ * battery-friendly steady-state intervals above once someone has
+ * connected or the fast-attach window has passed.
+ */
+#define ADV_FAST_ATTACH_TIME_S		30
+
+static esp_ble_adv_params_t ble_adv_params_fast = {
+	.adv_int_min = 0x20,        // 20ms for fast discovery after boot
+	.adv_int_max = 0x30,        // 30ms
+	.adv_type = ADV_TYPE_IND,
+	.own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+	.channel_map = ADV_CHNL_ALL,
+	.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+static volatile bool adv_fast_done = false;
+static esp_timer_handle_t adv_fast_timer = NULL;
+
+static void start_advertising(void) {
+	esp_ble_gap_start_advertising(
+		adv_fast_done ? &ble_adv_params : &ble_adv_params_fast
+	);
+}
+
+static void adv_fast_timeout_cb(void *arg) {
+	(void)arg;
+	adv_fast_done = true;
+	// Restarting with the steady-state parameters continues from
+	// ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT.
+	esp_ble_gap_stop_advertising();
+}
+
 static gatts_profile_instance_t gatts_profile = {
 	.gatts_if = ESP_GATT_IF_NONE,
 };
 
 static PACKET_STATE_t *packet_state;
 
+/*
+ * Outgoing notifications go through a queue drained by a dedicated
+ * task, so the Android stack applying flow control
+ * (ESP_GATTS_CONGEST_EVT) pauses only the drain task and never blocks
+ * whoever called the send function. Each record is one framed packet
+ * in a mempools buffer; the drain task cuts it into MTU-sized chunks
+ * by pointer arithmetic over that one buffer, so a packet is copied
+ * once when queued and never again. When the queue is full the oldest
+ * packets are dropped, which sheds stale telemetry first while fresh
+ * replies still get through.
+ */
+#define BLE_TX_QUEUE_LEN	8
+
+typedef struct {
+	uint8_t *buf;
+	uint16_t len;
+} ble_tx_rec_t;
+
+static ble_tx_rec_t tx_queue[BLE_TX_QUEUE_LEN];
+static volatile int tx_queue_read = 0;
+static volatile int tx_queue_write = 0;
+static SemaphoreHandle_t tx_queue_mutex;
+static SemaphoreHandle_t tx_queue_sem;
+static volatile bool is_congested = false;
+static volatile uint32_t tx_drop_cnt = 0;
+
 static void char1_read_handler(
 	esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
 	esp_ble_gatts_cb_param_t *param
@@ -332,9 +411,11 @@ static void char1_write_handler(
 	write_attr(ble_chars[0].char_val, param);
 
 	if (ble_chars[0].char_val != NULL) {
+		pkt_trace_stage(PKT_TRACE_RX);
 		for (int i = 0; i < param->write.len; ++i) {
 			packet_process_byte(param->write.value[i], packet_state);
 		}
+		ble_c6_link_note_rx(param->write.len);
 	}
 
 	notify_gatts_if = gatts_if;
@@ -431,21 +512,72 @@ static void gatts_check_callback(
 	}
 }
 
+/*
+ * Ask the peer for a fast link once connected: full-size LL data PDUs,
+ * 2M PHY on BLE 5 phones and a short connection interval. Peers that
+ * do not support a feature simply reject that request. This is what
+ * large script uploads and log pulls ride on, so the link should run
+ * as fast as the phone allows.
+ */
+static void apply_session_profile(ble_session_profile_t profile) {
+	esp_ble_conn_update_params_t conn_params = {0};
+	memcpy(conn_params.bda, peer_bda, sizeof(esp_bd_addr_t));
+	conn_params.latency = 0;
+	conn_params.timeout = 400; // 4 s
+
+	if (profile == BLE_SESSION_PROFILE_BULK) {
+		// As short as the spec allows. Android grants 7.5 ms, iOS
+		// rounds up to its 15 ms floor; either way every connection
+		// event is spent moving data.
+		conn_params.min_int = 0x06; // 7.5 ms
+		conn_params.max_int = 0x0C; // 15 ms
+	} else {
+		// 20-40 ms is within what both Android and iOS accept.
+		conn_params.min_int = 0x10; // 20 ms
+		conn_params.max_int = 0x20; // 40 ms
+	}
+
+	esp_ble_gap_update_conn_params(&conn_params);
+}
+
+static void boost_link_params(uint8_t *remote_bda) {
+	esp_ble_gap_set_pkt_data_len(remote_bda, 251);
+
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+	esp_ble_gap_set_preferred_phy(
+		remote_bda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+		ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF
+	);
+#endif
+
+	apply_session_profile(session_profile);
+}
+
 static void gap_event_handler(
 	esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param
 ) {
+	// Scanning is owned by custom_ble, but the GAP callback belongs to
+	// whichever BLE mode is running, so forward scan events from here too.
+	custom_ble_scan_handle_gap_event(event, param);
+
 	switch (event) {
 		case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
 			adv_config_done &= (~ADV_CFG_FLAG);
 			if (adv_config_done == 0) {
-				esp_ble_gap_start_advertising(&ble_adv_params);
+				start_advertising();
 			}
 			break;
 
 		case ESP_GAP_BLE_SCAN_RSP_DATA_SET_COMPLETE_EVT:
 			adv_config_done &= (~SCAN_RSP_CFG_FLAG);
 			if (adv_config_done == 0) {
-				esp_ble_gap_start_advertising(&ble_adv_params);
+				start_advertising();
+			}
+			break;
+
+		case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+			if (!is_connected) {
+				start_advertising();
 			}
 			break;
 
@@ -453,6 +585,23 @@ static void gap_event_handler(
 			esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
 			break;
 
+		case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+			if (param->phy_update.status == ESP_BT_STATUS_SUCCESS) {
+				ble_c6_link_phy_updated(
+					param->phy_update.tx_phy, param->phy_update.rx_phy
+				);
+			}
+			break;
+
+		case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+			if (param->pkt_data_length_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+				ble_c6_link_data_len_updated(
+					param->pkt_data_length_cmpl.params.tx_len,
+					param->pkt_data_length_cmpl.params.rx_len
+				);
+			}
+			break;
+
 		default:
 			break;
 	}
@@ -613,19 +762,48 @@ static void gatts_event_handler(
 			esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, ESP_PWR_LVL_P18);
 			esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_SCAN, ESP_PWR_LVL_P18);
 			esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT, ESP_PWR_LVL_P18);
+
+			ble_c6_link_reset();
+			memcpy(peer_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+			session_profile = BLE_SESSION_PROFILE_IDLE;
+			boost_link_params(param->connect.remote_bda);
+
+			// First connection ends the fast-attach window early.
+			if (!adv_fast_done) {
+				adv_fast_done = true;
+				if (adv_fast_timer != NULL) {
+					esp_timer_stop(adv_fast_timer);
+				}
+			}
 			break;
 
 		case ESP_GATTS_DISCONNECT_EVT:
 			is_connected = false;
+			is_congested = false;
+			// Flush queued notifications, they have no receiver anymore.
+			if (tx_queue_mutex != NULL) {
+				xSemaphoreTake(tx_queue_mutex, portMAX_DELAY);
+				while (tx_queue_read != tx_queue_write) {
+					mempools_free_any(tx_queue[tx_queue_read].buf);
+					tx_queue_read = (tx_queue_read + 1) % BLE_TX_QUEUE_LEN;
+				}
+				xSemaphoreGive(tx_queue_mutex);
+			}
 			LED_BLUE_OFF();
-			esp_ble_gap_start_advertising(&ble_adv_params);
+			start_advertising();
+			break;
+
+		case ESP_GATTS_CONGEST_EVT:
+			is_congested = param->congest.congested;
+			if (!is_congested && tx_queue_sem != NULL) {
+				xSemaphoreGive(tx_queue_sem);
+			}
 			break;
 
 		case ESP_GATTS_OPEN_EVT:
 		case ESP_GATTS_CANCEL_OPEN_EVT:
 		case ESP_GATTS_CLOSE_EVT:
 		case ESP_GATTS_LISTEN_EVT:
-		case ESP_GATTS_CONGEST_EVT:
 
 		default:
 			break;
@@ -636,27 +814,134 @@ static void process_packet(unsigned char *data, unsigned int len) {
 	commands_process_packet(data, len, comm_ble_send_packet);
 }
 
+static int tx_queue_used(void) {
+	int used = tx_queue_write - tx_queue_read;
+	if (used < 0) {
+		used += BLE_TX_QUEUE_LEN;
+	}
+
+	return used;
+}
+
+// Must be called with tx_queue_mutex held and the queue non-empty.
+static void tx_queue_drop_oldest(void) {
+	mempools_free_any(tx_queue[tx_queue_read].buf);
+	tx_queue_read = (tx_queue_read + 1) % BLE_TX_QUEUE_LEN;
+	tx_drop_cnt++;
+}
+
 static void send_packet_raw(unsigned char *buffer, unsigned int len) {
-	if (!is_connected) {
+	if (!is_connected || len == 0 || len > PACKET_BUFFER_LEN) {
 		return;
 	}
 
-	uint16_t bytes_sent = 0;
+	uint8_t *buf = mempools_alloc_any(len);
+	if (!buf) {
+		tx_drop_cnt++;
+		return;
+	}
 
-	while (bytes_sent < len) {
-		uint8_t length = 0;
-		if (len - bytes_sent > ble_current_mtu) {
-			length = ble_current_mtu;
-		} else {
-			length = len - bytes_sent;
+	memcpy(buf, buffer, len);
+
+	xSemaphoreTake(tx_queue_mutex, portMAX_DELAY);
+
+	while (tx_queue_used() >= (BLE_TX_QUEUE_LEN - 1)) {
+		tx_queue_drop_oldest();
+	}
+
+	tx_queue[tx_queue_write].buf = buf;
+	tx_queue[tx_queue_write].len = len;
+	tx_queue_write = (tx_queue_write + 1) % BLE_TX_QUEUE_LEN;
+
+	xSemaphoreGive(tx_queue_mutex);
+	xSemaphoreGive(tx_queue_sem);
+}
+
+// In-flight record being chunked out. Kept across calls so a congested
+// stack suspends the transfer instead of blocking the shared comm
+// service task; the next wakeup resumes at the same chunk.
+static ble_tx_rec_t tx_cur_rec;
+static unsigned int tx_cur_sent = 0;
+static bool tx_cur_valid = false;
+static int64_t tx_cur_start = 0;
+
+static void ble_tx_fn(void *arg) {
+	(void)arg;
+	xSemaphoreTake(tx_queue_sem, 0);
+
+	// Relax the connection parameters once the bulk session has been
+	// quiet for a while. This runs on every service wakeup, so the
+	// check doubles as the bulk-session timeout.
+	if (is_connected && session_profile == BLE_SESSION_PROFILE_BULK &&
+			(esp_timer_get_time() - session_bulk_time) >
+			(int64_t)BLE_SESSION_BULK_HOLD_MS * 1000) {
+		comm_ble_set_session_profile(BLE_SESSION_PROFILE_IDLE);
+	}
+
+	for (;;) {
+		if (!tx_cur_valid) {
+			xSemaphoreTake(tx_queue_mutex, portMAX_DELAY);
+
+			if (tx_queue_read == tx_queue_write) {
+				xSemaphoreGive(tx_queue_mutex);
+				return;
+			}
+
+			tx_cur_rec = tx_queue[tx_queue_read];
+			tx_queue_read = (tx_queue_read + 1) % BLE_TX_QUEUE_LEN;
+
+			xSemaphoreGive(tx_queue_mutex);
+
+			tx_cur_valid = true;
+			tx_cur_sent = 0;
+			tx_cur_start = esp_timer_get_time();
 		}
 
-		esp_ble_gatts_send_indicate(
-			notify_gatts_if, notify_conn_id, ble_chars[1].char_handle, length,
-			buffer + bytes_sent, false
-		);
+		if (!is_connected) {
+			// No receiver anymore. The disconnect flush only frees
+			// still-queued buffers; this one was already dequeued.
+			mempools_free_any(tx_cur_rec.buf);
+			tx_cur_valid = false;
+			continue;
+		}
+
+		// Chunking is pointer arithmetic over the one queued buffer;
+		// the payload was copied exactly once, when it was queued.
+		while (tx_cur_sent < tx_cur_rec.len) {
+			if (is_congested) {
+				return;
+			}
 
-		bytes_sent += length;
+			unsigned int length = tx_cur_rec.len - tx_cur_sent;
+			if (length > ble_current_mtu) {
+				length = ble_current_mtu;
+			}
+
+			esp_err_t res = esp_ble_gatts_send_indicate(
+				notify_gatts_if, notify_conn_id,
+				ble_chars[1].char_handle, length,
+				tx_cur_rec.buf + tx_cur_sent, false
+			);
+
+			if (res != ESP_OK) {
+				// The stack is out of buffers. Resume this same chunk on
+				// the next wakeup; dropping here would corrupt the
+				// framing mid-packet.
+				coex_stats_note_denial(COEX_RADIO_BLE);
+				return;
+			}
+
+			tx_cur_sent += length;
+			ble_c6_link_note_tx(length);
+			coex_stats_note_grant(COEX_RADIO_BLE);
+		}
+
+		mempools_free_any(tx_cur_rec.buf);
+		tx_cur_valid = false;
+
+		coex_stats_note_tx_time(
+			COEX_RADIO_BLE, (esp_timer_get_time() - tx_cur_start) / 1000
+		);
 	}
 }
 
@@ -664,6 +949,23 @@ void comm_ble_init(void) {
 	packet_state = calloc(1, sizeof(PACKET_STATE_t));
 	packet_init(send_packet_raw, process_packet, packet_state);
 
+	tx_queue_mutex = xSemaphoreCreateMutex();
+	tx_queue_sem = xSemaphoreCreateBinary();
+
+	// The semaphore wakes the service task as soon as a packet is
+	// queued; the poll registration retries suspended transfers after
+	// congestion without a dedicated wakeup. The handler is idempotent,
+	// so the double registration is safe.
+	comm_service_register_queue(tx_queue_sem, ble_tx_fn, NULL);
+	comm_service_register_poll(ble_tx_fn, NULL);
+
+	const esp_timer_create_args_t adv_fast_timer_args = {
+		.callback = adv_fast_timeout_cb,
+		.name = "ble_adv_fast",
+	};
+	esp_timer_create(&adv_fast_timer_args, &adv_fast_timer);
+	esp_timer_start_once(adv_fast_timer, (uint64_t)ADV_FAST_ATTACH_TIME_S * 1000000);
+
 	if (backup.config.ble_mode == BLE_MODE_ENCRYPTED) {
 		ble_chars[0].char_perm =
 			(ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_WRITE_ENCRYPTED);
@@ -762,10 +1064,39 @@ void comm_ble_send_packet(unsigned char *data, unsigned int len) {
 	packet_send_packet(data, len, packet_state);
 }
 
+uint32_t comm_ble_get_tx_drops(void) {
+	return tx_drop_cnt;
+}
+
+void comm_ble_set_session_profile(ble_session_profile_t profile) {
+	if (profile == session_profile) {
+		return;
+	}
+
+	session_profile = profile;
+
+	if (is_connected) {
+		apply_session_profile(profile);
+	}
+}
+
+ble_session_profile_t comm_ble_get_session_profile(void) {
+	return session_profile;
+}
+
+void comm_ble_note_bulk_transfer(void) {
+	session_bulk_time = esp_timer_get_time();
+	comm_ble_set_session_profile(BLE_SESSION_PROFILE_BULK);
+}
+
 #else
 // Stub implementations when Bluetooth is disabled
 void comm_ble_init(void) { }
 bool comm_ble_is_connected() { return false; }
 int comm_ble_mtu_now(void) { return 0; }
 void comm_ble_send_packet(unsigned char *data, unsigned int len) { (void)data; (void)len; }
+uint32_t comm_ble_get_tx_drops(void) { return 0; }
+void comm_ble_set_session_profile(ble_session_profile_t profile) { (void)profile; }
+ble_session_profile_t comm_ble_get_session_profile(void) { return BLE_SESSION_PROFILE_IDLE; }
+void comm_ble_note_bulk_transfer(void) {}
 #endif
@@ -23,9 +23,23 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Connection-parameter profile for the current session. Bulk asks the
+// peer for a minimal connection interval so sustained transfers (log
+// pulls, script uploads) get the most radio time; idle relaxes the
+// interval again. Bulk falls back to idle automatically after a few
+// seconds without bulk activity.
+typedef enum {
+	BLE_SESSION_PROFILE_IDLE = 0,
+	BLE_SESSION_PROFILE_BULK,
+} ble_session_profile_t;
+
 void comm_ble_init(void);
 bool comm_ble_is_connected();
 int comm_ble_mtu_now(void);
 void comm_ble_send_packet(unsigned char *data, unsigned int len);
+uint32_t comm_ble_get_tx_drops(void);
+void comm_ble_set_session_profile(ble_session_profile_t profile);
+ble_session_profile_t comm_ble_get_session_profile(void);
+void comm_ble_note_bulk_transfer(void);
 
 #endif /* MAIN_COMM_BLE_H_ */
@@ -35,6 +35,10 @@
 #include "lispif.h"
 #include "bms.h"
 #include "utils.h"
+#include "mempools.h"
+#include "perf.h"
+#include "rb.h"
+#include "esp_timer.h"
 #include "soc/gpio_sig_map.h"
 
 #include <string.h>
@@ -58,10 +62,13 @@ static psw_status psw_stat[CAN_STATUS_MSGS_TO_STORE];
 #define RXBUF_LEN					128       // Larger receive buffer for ESP32-C6 capabilities
 #else
 #define RX_BUFFER_NUM				3
-#define RX_BUFFER_SIZE				PACKET_MAX_PL_LEN  
+#define RX_BUFFER_SIZE				PACKET_MAX_PL_LEN
 #define RXBUF_LEN					50
 #endif
 
+// Frames drained from the TWAI queue per RX task wakeup.
+#define RX_BATCH_MAX				16
+
 // ESP32-C6 Enhanced CAN/TWAI Configuration for Motor Control
 #ifdef CONFIG_IDF_TARGET_ESP32C6
 static twai_timing_config_t t_config = {
@@ -72,7 +79,7 @@ static twai_timing_config_t t_config = {
 	.triple_sampling = true      // Triple sampling for reliable motor control data
 };
 
-static const twai_filter_config_t f_config = {
+static twai_filter_config_t f_config = {
 	.acceptance_code = 0x00000000,
 	.acceptance_mask = 0xFFFFFFFF,
 	.single_filter = true        // Single filter mode for ESP32-C6 optimization
@@ -94,7 +101,7 @@ static twai_general_config_t g_config = {
 #else
 // Legacy ESP32 configuration
 static twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-static const twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+static twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
 static twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(0, 0, TWAI_MODE_NORMAL);
 #endif
 
@@ -109,19 +116,226 @@ static SemaphoreHandle_t ping_sem;
 static SemaphoreHandle_t proc_sem;
 static SemaphoreHandle_t status_sem;
 static SemaphoreHandle_t send_mutex;
+// Counting semaphore given by the rx and status tasks when they exit,
+// so the stop paths block on it instead of polling the running flags.
+static SemaphoreHandle_t thd_stop_sem;
 static volatile HW_TYPE ping_hw_last = HW_TYPE_VESC;
-static uint8_t rx_buffer[RX_BUFFER_NUM][RX_BUFFER_SIZE];
-static int rx_buffer_offset[RX_BUFFER_NUM];
+
+/*
+ * Reassembly slots for fragmented commands. The backing buffers are
+ * drawn from mempools while a transfer is in flight and returned when
+ * it completes, so idle slots cost almost no memory. When all slots are
+ * busy the one that has been idle the longest is evicted instead of
+ * silently dropping the new transfer.
+ */
+typedef struct {
+	uint8_t *data;
+	int offset;
+	uint32_t fill_time;
+} rx_slot_t;
+
+static rx_slot_t rx_slots[RX_BUFFER_NUM];
+static uint32_t rx_slot_evictions = 0;
+static uint32_t rx_slot_drops = 0;
+
+// Bus statistics, sampled once per second by the RX task
+static volatile uint32_t stats_rx_cnt = 0;
+static volatile uint32_t stats_tx_cnt = 0;
+static volatile uint32_t stats_bits = 0;
+static volatile uint32_t stats_rx_sec = 0;
+static volatile uint32_t stats_tx_sec = 0;
+static volatile float stats_bus_load = 0.0;
+static volatile uint32_t stats_tx_queue_max = 0;
+static uint32_t stats_ping_hist[CAN_PING_HIST_LEN];
+static uint16_t stats_ping_last[256]; // Last ping latency per node in us, 0 when never pinged
+static uint32_t stats_sample_time = 0;
 static volatile unsigned int rx_buffer_last_id;
 static volatile unsigned int rx_buffer_response_type = 1;
 
+/*
+ * Frames go from the RX drain task to the process task through a
+ * lock-free SPSC ring, with full-ring drops counted instead of frames
+ * silently overwritten. Driver-level losses (internal queue misses and
+ * hardware FIFO overruns) are accounted separately from the status
+ * info.
+ */
 static twai_message_t rx_buf[RXBUF_LEN];
-static volatile int rx_write = 0;
-static volatile int rx_read = 0;
+static rb_spsc_t rx_rb = { rx_buf, 0, 0, sizeof(twai_message_t), RXBUF_LEN };
+static volatile uint32_t rx_ring_drops = 0;
+static volatile uint32_t rx_driver_missed = 0;
+static uint32_t rx_missed_prev = 0;
 static volatile bool use_vesc_decoder = true;
 
 static volatile int rx_recovery_cnt = 0;
 
+/*
+ * Direct-mapped id-to-slot tables for the status caches above. They are
+ * updated when a message is stored, making all comm_can_get_*_id
+ * lookups O(1) regardless of bus size. Every cached struct starts with
+ * an int id, which the generic helpers below rely on.
+ */
+typedef enum {
+	CAN_IDX_STATUS = 0,
+	CAN_IDX_STATUS_2,
+	CAN_IDX_STATUS_3,
+	CAN_IDX_STATUS_4,
+	CAN_IDX_STATUS_5,
+	CAN_IDX_STATUS_6,
+	CAN_IDX_IO_ADC_1_4,
+	CAN_IDX_IO_ADC_5_8,
+	CAN_IDX_IO_DIGITAL,
+	CAN_IDX_PSW,
+	CAN_IDX_NUM
+} CAN_IDX_CACHE;
+
+#define CAN_IDX_UNUSED				0xFF
+
+static uint8_t stat_idx[CAN_IDX_NUM][256];
+
+// Find or allocate the cache slot for id, updating the index table.
+static void *status_slot_get(CAN_IDX_CACHE cache, uint8_t id, void *array, size_t item_size) {
+	uint8_t slot = stat_idx[cache][id];
+	if (slot != CAN_IDX_UNUSED && slot < CAN_STATUS_MSGS_TO_STORE) {
+		return (char*)array + slot * item_size;
+	}
+
+	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
+		int *id_ptr = (int*)((char*)array + i * item_size);
+		if (*id_ptr == id || *id_ptr == -1) {
+			stat_idx[cache][id] = i;
+			return id_ptr;
+		}
+	}
+
+	return 0;
+}
+
+// O(1) lookup of the cache slot for id, or 0 when never seen.
+static void *status_slot_lookup(CAN_IDX_CACHE cache, int id, void *array, size_t item_size) {
+	if (id < 0 || id > 255) {
+		return 0;
+	}
+
+	uint8_t slot = stat_idx[cache][id];
+	if (slot == CAN_IDX_UNUSED || slot >= CAN_STATUS_MSGS_TO_STORE) {
+		return 0;
+	}
+
+	void *res = (char*)array + slot * item_size;
+	return *(int*)res == id ? res : 0;
+}
+
+// Return the slot expecting a fragment at the given offset, or -1.
+static int rx_slot_find(int offset) {
+	for (int i = 0;i < RX_BUFFER_NUM;i++) {
+		if (rx_slots[i].data && rx_slots[i].offset == offset) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Return the backing buffer of a slot to mempools and mark it idle.
+static void rx_slot_release(int ind) {
+	if (rx_slots[ind].data) {
+		mempools_free_any(rx_slots[ind].data - PACKET_HEADROOM);
+		rx_slots[ind].data = 0;
+	}
+	rx_slots[ind].offset = 0;
+}
+
+/**
+ * Claim a slot for a new transfer. An idle slot is used when available,
+ * otherwise the transfer that has been silent the longest is evicted.
+ *
+ * @return
+ * The slot index, or -1 if no buffer could be allocated.
+ */
+static int rx_slot_start(void) {
+	int ind = -1;
+	for (int i = 0;i < RX_BUFFER_NUM;i++) {
+		if (rx_slots[i].data == 0) {
+			ind = i;
+			break;
+		}
+	}
+
+	if (ind < 0) {
+		uint32_t now = xTaskGetTickCount();
+		uint32_t age_max = 0;
+		ind = 0;
+		for (int i = 0;i < RX_BUFFER_NUM;i++) {
+			uint32_t age = now - rx_slots[i].fill_time;
+			if (age >= age_max) {
+				age_max = age;
+				ind = i;
+			}
+		}
+		rx_slot_evictions++;
+	}
+
+	if (rx_slots[ind].data == 0) {
+		// Keep packet headroom and tailroom around the payload so a
+		// forwarded reply can be framed in place for the transport.
+		uint8_t *buf = mempools_alloc_any(RX_BUFFER_SIZE +
+				PACKET_HEADROOM + PACKET_TAILROOM);
+		rx_slots[ind].data = buf ? buf + PACKET_HEADROOM : 0;
+	}
+
+	if (rx_slots[ind].data == 0) {
+		rx_slot_drops++;
+		return -1;
+	}
+
+	rx_slots[ind].offset = 0;
+	rx_slots[ind].fill_time = xTaskGetTickCount();
+	return ind;
+}
+
+// Approximate wire bits of a frame, including stuffing overhead.
+static uint32_t frame_bits(const twai_message_t *msg) {
+	uint32_t bits = (msg->extd ? 67 : 47) + 8 * msg->data_length_code;
+	return bits + bits / 5;
+}
+
+static int baud_to_bps(CAN_BAUD baud) {
+	switch (baud) {
+	case CAN_BAUD_125K: return 125000;
+	case CAN_BAUD_250K: return 250000;
+	case CAN_BAUD_500K: return 500000;
+	case CAN_BAUD_1M: return 1000000;
+	case CAN_BAUD_10K: return 10000;
+	case CAN_BAUD_20K: return 20000;
+	case CAN_BAUD_50K: return 50000;
+	case CAN_BAUD_75K: return 75000;
+	case CAN_BAUD_100K: return 100000;
+	default: return 500000;
+	}
+}
+
+// Fold the counters of the last sample window into the per-second stats.
+static void stats_sample(void) {
+	uint32_t now = xTaskGetTickCount();
+	uint32_t elapsed = now - stats_sample_time;
+
+	if (elapsed < configTICK_RATE_HZ) {
+		return;
+	}
+
+	stats_rx_sec = stats_rx_cnt;
+	stats_tx_sec = stats_tx_cnt;
+	stats_rx_cnt = 0;
+	stats_tx_cnt = 0;
+
+	float secs = (float)elapsed / (float)configTICK_RATE_HZ;
+	stats_bus_load = 100.0 * (float)stats_bits / secs /
+			(float)baud_to_bps(backup.config.can_baud_rate);
+	stats_bits = 0;
+
+	stats_sample_time = now;
+}
+
 // Private functions
 static void update_baud(CAN_BAUD baudrate);
 
@@ -141,55 +355,41 @@ static void decode_msg(uint32_t eid, uint8_t *data8, int len, bool is_replaced)
 	if (id == 255 || id == backup.config.controller_id) {
 		switch (cmd) {
 		case CAN_PACKET_FILL_RX_BUFFER: {
-			int buf_ind = -1;
 			int offset = data8[0];
 			data8++;
 			len--;
 
-			for (int i = 0; i < RX_BUFFER_NUM;i++) {
-				if ((rx_buffer_offset[i]) == offset ) {
-					buf_ind = i;
-					break;
-				}
-			}
-
+			int buf_ind = offset == 0 ? rx_slot_start() : rx_slot_find(offset);
 			if (buf_ind < 0) {
-				if (offset == 0) {
-					buf_ind = 0;
-				} else {
-					break;
+				if (offset != 0) {
+					rx_slot_drops++;
 				}
+				break;
 			}
 
-			memcpy(rx_buffer[buf_ind] + offset, data8, len);
-			rx_buffer_offset[buf_ind] = offset + len;
+			memcpy(rx_slots[buf_ind].data + offset, data8, len);
+			rx_slots[buf_ind].offset = offset + len;
+			rx_slots[buf_ind].fill_time = xTaskGetTickCount();
 		} break;
 
 		case CAN_PACKET_FILL_RX_BUFFER_LONG: {
-			int buf_ind = -1;
 			int offset = (int)data8[0] << 8;
 			offset |= data8[1];
 			data8 += 2;
 			len -= 2;
 
-			for (int i = 0; i < RX_BUFFER_NUM;i++) {
-				if ((rx_buffer_offset[i]) == offset ) {
-					buf_ind = i;
-					break;
-				}
-			}
-
+			int buf_ind = offset == 0 ? rx_slot_start() : rx_slot_find(offset);
 			if (buf_ind < 0) {
-				if (offset == 0) {
-					buf_ind = 0;
-				} else {
-					break;
+				if (offset != 0) {
+					rx_slot_drops++;
 				}
+				break;
 			}
 
 			if ((offset + len) <= RX_BUFFER_SIZE) {
-				memcpy(rx_buffer[buf_ind] + offset, data8, len);
-				rx_buffer_offset[buf_ind] = offset + len;
+				memcpy(rx_slots[buf_ind].data + offset, data8, len);
+				rx_slots[buf_ind].offset = offset + len;
+				rx_slots[buf_ind].fill_time = xTaskGetTickCount();
 			}
 		} break;
 
@@ -215,56 +415,58 @@ static void decode_msg(uint32_t eid, uint8_t *data8, int len, bool is_replaced)
 				break;
 			}
 
-			int buf_ind = -1;
-			for (int i = 0; i < RX_BUFFER_NUM;i++) {
-				if ((rx_buffer_offset[i]) == rxbuf_len ) {
-					buf_ind = i;
-					break;
-				}
-			}
+			int buf_ind = rx_slot_find(rxbuf_len);
 
-			// Something is wrong, reset all buffers
+			// Something is wrong, reset all transfers
 			if (buf_ind < 0) {
 				for (int i = 0; i < RX_BUFFER_NUM;i++) {
-					rx_buffer_offset[i] = 0;
+					if (rx_slots[i].data) {
+						rx_slot_drops++;
+					}
+					rx_slot_release(i);
 				}
 				break;
 			}
 
-			rx_buffer_offset[buf_ind] = 0;
+			uint8_t *rxbuf = rx_slots[buf_ind].data;
 
 			crc_high = data8[ind++];
 			crc_low = data8[ind++];
 
-			if (crc16(rx_buffer[buf_ind], rxbuf_len)
+			if (crc16(rxbuf, rxbuf_len)
 					== ((unsigned short) crc_high << 8
 							| (unsigned short) crc_low)) {
 
+				bool blocked = false;
 				if (is_replaced) {
-					if (rx_buffer[buf_ind][0] == COMM_JUMP_TO_BOOTLOADER ||
-							rx_buffer[buf_ind][0] == COMM_ERASE_NEW_APP ||
-							rx_buffer[buf_ind][0] == COMM_WRITE_NEW_APP_DATA ||
-							rx_buffer[buf_ind][0] == COMM_WRITE_NEW_APP_DATA_LZO ||
-							rx_buffer[buf_ind][0] == COMM_ERASE_BOOTLOADER) {
-						break;
+					if (rxbuf[0] == COMM_JUMP_TO_BOOTLOADER ||
+							rxbuf[0] == COMM_ERASE_NEW_APP ||
+							rxbuf[0] == COMM_WRITE_NEW_APP_DATA ||
+							rxbuf[0] == COMM_WRITE_NEW_APP_DATA_LZO ||
+							rxbuf[0] == COMM_ERASE_BOOTLOADER) {
+						blocked = true;
 					}
 				}
 
-				switch (commands_send) {
-				case 0:
-				case 3:
-					commands_process_packet(rx_buffer[buf_ind], rxbuf_len, send_packet_wrapper);
-					break;
-				case 1:
-					commands_send_packet_can_last(rx_buffer[buf_ind], rxbuf_len);
-					break;
-				case 2:
-					commands_process_packet(rx_buffer[buf_ind], rxbuf_len, 0);
-					break;
-				default:
-					break;
+				if (!blocked) {
+					switch (commands_send) {
+					case 0:
+					case 3:
+						commands_process_packet(rxbuf, rxbuf_len, send_packet_wrapper);
+						break;
+					case 1:
+						commands_send_packet_can_last_headroom(rxbuf, rxbuf_len);
+						break;
+					case 2:
+						commands_process_packet(rxbuf, rxbuf_len, 0);
+						break;
+					default:
+						break;
+					}
 				}
 			}
+
+			rx_slot_release(buf_ind);
 		} break;
 
 		case CAN_PACKET_PROCESS_SHORT_BUFFER:
@@ -333,164 +535,141 @@ static void decode_msg(uint32_t eid, uint8_t *data8, int len, bool is_replaced)
 	// The packets below are addressed to all devices, mainly containing status information.
 
 	switch (cmd) {
-	case CAN_PACKET_STATUS:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg *stat_tmp = &stat_msgs[i];
-			if (stat_tmp->id == id || stat_tmp->id == -1) {
-				ind = 0;
-				stat_tmp->id = id;
-				stat_tmp->rx_time = xTaskGetTickCount();
-				stat_tmp->rpm = (float)buffer_get_int32(data8, &ind);
-				stat_tmp->current = (float)buffer_get_int16(data8, &ind) / 10.0;
-				stat_tmp->duty = (float)buffer_get_int16(data8, &ind) / 1000.0;
-				break;
-			}
+	case CAN_PACKET_STATUS: {
+		can_status_msg *stat_tmp = status_slot_get(CAN_IDX_STATUS, id,
+				stat_msgs, sizeof(can_status_msg));
+		if (stat_tmp) {
+			ind = 0;
+			stat_tmp->id = id;
+			stat_tmp->rx_time = xTaskGetTickCount();
+			stat_tmp->rpm = (float)buffer_get_int32(data8, &ind);
+			stat_tmp->current = (float)buffer_get_int16(data8, &ind) / 10.0;
+			stat_tmp->duty = (float)buffer_get_int16(data8, &ind) / 1000.0;
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_STATUS_2:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg_2 *stat_tmp_2 = &stat_msgs_2[i];
-			if (stat_tmp_2->id == id || stat_tmp_2->id == -1) {
-				ind = 0;
-				stat_tmp_2->id = id;
-				stat_tmp_2->rx_time = xTaskGetTickCount();
-				stat_tmp_2->amp_hours = (float)buffer_get_int32(data8, &ind) / 1e4;
-				stat_tmp_2->amp_hours_charged = (float)buffer_get_int32(data8, &ind) / 1e4;
-				break;
-			}
+	case CAN_PACKET_STATUS_2: {
+		can_status_msg_2 *stat_tmp_2 = status_slot_get(CAN_IDX_STATUS_2, id,
+				stat_msgs_2, sizeof(can_status_msg_2));
+		if (stat_tmp_2) {
+			ind = 0;
+			stat_tmp_2->id = id;
+			stat_tmp_2->rx_time = xTaskGetTickCount();
+			stat_tmp_2->amp_hours = (float)buffer_get_int32(data8, &ind) / 1e4;
+			stat_tmp_2->amp_hours_charged = (float)buffer_get_int32(data8, &ind) / 1e4;
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_STATUS_3:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg_3 *stat_tmp_3 = &stat_msgs_3[i];
-			if (stat_tmp_3->id == id || stat_tmp_3->id == -1) {
-				ind = 0;
-				stat_tmp_3->id = id;
-				stat_tmp_3->rx_time = xTaskGetTickCount();
-				stat_tmp_3->watt_hours = (float)buffer_get_int32(data8, &ind) / 1e4;
-				stat_tmp_3->watt_hours_charged = (float)buffer_get_int32(data8, &ind) / 1e4;
-				break;
-			}
+	case CAN_PACKET_STATUS_3: {
+		can_status_msg_3 *stat_tmp_3 = status_slot_get(CAN_IDX_STATUS_3, id,
+				stat_msgs_3, sizeof(can_status_msg_3));
+		if (stat_tmp_3) {
+			ind = 0;
+			stat_tmp_3->id = id;
+			stat_tmp_3->rx_time = xTaskGetTickCount();
+			stat_tmp_3->watt_hours = (float)buffer_get_int32(data8, &ind) / 1e4;
+			stat_tmp_3->watt_hours_charged = (float)buffer_get_int32(data8, &ind) / 1e4;
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_STATUS_4:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg_4 *stat_tmp_4 = &stat_msgs_4[i];
-			if (stat_tmp_4->id == id || stat_tmp_4->id == -1) {
-				ind = 0;
-				stat_tmp_4->id = id;
-				stat_tmp_4->rx_time = xTaskGetTickCount();
-				stat_tmp_4->temp_fet = (float)buffer_get_int16(data8, &ind) / 10.0;
-				stat_tmp_4->temp_motor = (float)buffer_get_int16(data8, &ind) / 10.0;
-				stat_tmp_4->current_in = (float)buffer_get_int16(data8, &ind) / 10.0;
-				stat_tmp_4->pid_pos_now = (float)buffer_get_int16(data8, &ind) / 50.0;
-				break;
-			}
+	case CAN_PACKET_STATUS_4: {
+		can_status_msg_4 *stat_tmp_4 = status_slot_get(CAN_IDX_STATUS_4, id,
+				stat_msgs_4, sizeof(can_status_msg_4));
+		if (stat_tmp_4) {
+			ind = 0;
+			stat_tmp_4->id = id;
+			stat_tmp_4->rx_time = xTaskGetTickCount();
+			stat_tmp_4->temp_fet = (float)buffer_get_int16(data8, &ind) / 10.0;
+			stat_tmp_4->temp_motor = (float)buffer_get_int16(data8, &ind) / 10.0;
+			stat_tmp_4->current_in = (float)buffer_get_int16(data8, &ind) / 10.0;
+			stat_tmp_4->pid_pos_now = (float)buffer_get_int16(data8, &ind) / 50.0;
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_STATUS_5:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg_5 *stat_tmp_5 = &stat_msgs_5[i];
-			if (stat_tmp_5->id == id || stat_tmp_5->id == -1) {
-				ind = 0;
-				stat_tmp_5->id = id;
-				stat_tmp_5->rx_time = xTaskGetTickCount();
-				stat_tmp_5->tacho_value = buffer_get_int32(data8, &ind);
-				stat_tmp_5->v_in = (float)buffer_get_int16(data8, &ind) / 1e1;
-				break;
-			}
+	case CAN_PACKET_STATUS_5: {
+		can_status_msg_5 *stat_tmp_5 = status_slot_get(CAN_IDX_STATUS_5, id,
+				stat_msgs_5, sizeof(can_status_msg_5));
+		if (stat_tmp_5) {
+			ind = 0;
+			stat_tmp_5->id = id;
+			stat_tmp_5->rx_time = xTaskGetTickCount();
+			stat_tmp_5->tacho_value = buffer_get_int32(data8, &ind);
+			stat_tmp_5->v_in = (float)buffer_get_int16(data8, &ind) / 1e1;
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_STATUS_6:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			can_status_msg_6 *stat_tmp_6 = &stat_msgs_6[i];
-			if (stat_tmp_6->id == id || stat_tmp_6->id == -1) {
-				ind = 0;
-				stat_tmp_6->id = id;
-				stat_tmp_6->rx_time = xTaskGetTickCount();
-				stat_tmp_6->adc_1 = buffer_get_float16(data8, 1e3, &ind);
-				stat_tmp_6->adc_2 = buffer_get_float16(data8, 1e3, &ind);
-				stat_tmp_6->adc_3 = buffer_get_float16(data8, 1e3, &ind);
-				stat_tmp_6->ppm = buffer_get_float16(data8, 1e3, &ind);
-				break;
-			}
+	case CAN_PACKET_STATUS_6: {
+		can_status_msg_6 *stat_tmp_6 = status_slot_get(CAN_IDX_STATUS_6, id,
+				stat_msgs_6, sizeof(can_status_msg_6));
+		if (stat_tmp_6) {
+			ind = 0;
+			stat_tmp_6->id = id;
+			stat_tmp_6->rx_time = xTaskGetTickCount();
+			stat_tmp_6->adc_1 = buffer_get_float16(data8, 1e3, &ind);
+			stat_tmp_6->adc_2 = buffer_get_float16(data8, 1e3, &ind);
+			stat_tmp_6->adc_3 = buffer_get_float16(data8, 1e3, &ind);
+			stat_tmp_6->ppm = buffer_get_float16(data8, 1e3, &ind);
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_IO_BOARD_ADC_1_TO_4:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			io_board_adc_values *msg = &io_board_adc_1_4[i];
-			if (msg->id == id || msg->id == -1) {
-				ind = 0;
-				msg->id = id;
-				msg->rx_time = xTaskGetTickCount();
-				ind = 0;
-				int j = 0;
-				while (ind < len) {
-					msg->adc_voltages[j++] = buffer_get_float16(data8, 1e2, &ind);
-				}
-				break;
+	case CAN_PACKET_IO_BOARD_ADC_1_TO_4: {
+		io_board_adc_values *msg = status_slot_get(CAN_IDX_IO_ADC_1_4, id,
+				io_board_adc_1_4, sizeof(io_board_adc_values));
+		if (msg) {
+			msg->id = id;
+			msg->rx_time = xTaskGetTickCount();
+			ind = 0;
+			int j = 0;
+			while (ind < len) {
+				msg->adc_voltages[j++] = buffer_get_float16(data8, 1e2, &ind);
 			}
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_IO_BOARD_ADC_5_TO_8:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			io_board_adc_values *msg = &io_board_adc_5_8[i];
-			if (msg->id == id || msg->id == -1) {
-				ind = 0;
-				msg->id = id;
-				msg->rx_time = xTaskGetTickCount();
-				ind = 0;
-				int j = 0;
-				while (ind < len) {
-					msg->adc_voltages[j++] = buffer_get_float16(data8, 1e2, &ind);
-				}
-				break;
+	case CAN_PACKET_IO_BOARD_ADC_5_TO_8: {
+		io_board_adc_values *msg = status_slot_get(CAN_IDX_IO_ADC_5_8, id,
+				io_board_adc_5_8, sizeof(io_board_adc_values));
+		if (msg) {
+			msg->id = id;
+			msg->rx_time = xTaskGetTickCount();
+			ind = 0;
+			int j = 0;
+			while (ind < len) {
+				msg->adc_voltages[j++] = buffer_get_float16(data8, 1e2, &ind);
 			}
 		}
-		break;
+	} break;
 
-	case CAN_PACKET_IO_BOARD_DIGITAL_IN:
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			io_board_digial_inputs *msg = &io_board_digital_in[i];
-			if (msg->id == id || msg->id == -1) {
-				ind = 0;
-				msg->id = id;
-				msg->rx_time = xTaskGetTickCount();
-				msg->inputs = 0;
-				ind = 0;
-				while (ind < len) {
-					msg->inputs |= (uint64_t)data8[ind] << (ind * 8);
-					ind++;
-				}
-				break;
+	case CAN_PACKET_IO_BOARD_DIGITAL_IN: {
+		io_board_digial_inputs *msg = status_slot_get(CAN_IDX_IO_DIGITAL, id,
+				io_board_digital_in, sizeof(io_board_digial_inputs));
+		if (msg) {
+			msg->id = id;
+			msg->rx_time = xTaskGetTickCount();
+			msg->inputs = 0;
+			ind = 0;
+			while (ind < len) {
+				msg->inputs |= (uint64_t)data8[ind] << (ind * 8);
+				ind++;
 			}
 		}
-		break;
+	} break;
 
 	case CAN_PACKET_PSW_STAT: {
-		for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-			psw_status *msg = &psw_stat[i];
-			if (msg->id == id || msg->id == -1) {
-				ind = 0;
-				msg->id = id;
-				msg->rx_time = xTaskGetTickCount();
-
-				msg->v_in = buffer_get_float16(data8, 10.0, &ind);
-				msg->v_out = buffer_get_float16(data8, 10.0, &ind);
-				msg->temp = buffer_get_float16(data8, 10.0, &ind);
-				msg->is_out_on = (data8[ind] >> 0) & 1;
-				msg->is_pch_on = (data8[ind] >> 1) & 1;
-				msg->is_dsc_on = (data8[ind] >> 2) & 1;
-				ind++;
-				break;
-			}
+		psw_status *msg = status_slot_get(CAN_IDX_PSW, id,
+				psw_stat, sizeof(psw_status));
+		if (msg) {
+			ind = 0;
+			msg->id = id;
+			msg->rx_time = xTaskGetTickCount();
+
+			msg->v_in = buffer_get_float16(data8, 10.0, &ind);
+			msg->v_out = buffer_get_float16(data8, 10.0, &ind);
+			msg->temp = buffer_get_float16(data8, 10.0, &ind);
+			msg->is_out_on = (data8[ind] >> 0) & 1;
+			msg->is_pch_on = (data8[ind] >> 1) & 1;
+			msg->is_dsc_on = (data8[ind] >> 2) & 1;
+			ind++;
 		}
 	} break;
 
@@ -520,6 +699,8 @@ static void decode_msg(uint32_t eid, uint8_t *data8, int len, bool is_replaced)
 		s->rmc_cnt++;
 		s->gga.update_time = xTaskGetTickCount();
 		s->rmc.update_time = xTaskGetTickCount();
+
+		nmea_update_derived();
 	} break;
 
 	case CAN_PACKET_GNSS_LAT: {
@@ -556,6 +737,8 @@ static void decode_msg(uint32_t eid, uint8_t *data8, int len, bool is_replaced)
 
 		s->gga_cnt++;
 		s->gga.update_time = xTaskGetTickCount();
+
+		nmea_update_derived();
 	} break;
 
 	case CAN_PACKET_GNSS_ALT_SPEED_HDOP: {
@@ -600,17 +783,39 @@ static void rx_task(void *arg) {
 		esp_err_t res = twai_receive(&rx_message, 2);
 
 		if (res == ESP_OK) {
-			rx_buf[rx_write] = rx_message;
-			rx_write++;
-			if (rx_write >= RXBUF_LEN) {
-				rx_write = 0;
-			}
+			// Drain the driver queue in a batch after the first blocking
+			// receive, so a loaded bus costs one task wakeup and one
+			// semaphore give per batch instead of per frame.
+			int drained = 0;
+
+			do {
+				if (!rb_spsc_insert(&rx_rb, &rx_message)) {
+					rx_ring_drops++;
+				}
+
+				stats_rx_cnt++;
+				stats_bits += frame_bits(&rx_message);
+
+				drained++;
+			} while (drained < RX_BATCH_MAX && twai_receive(&rx_message, 0) == ESP_OK);
 
 			xSemaphoreGive(proc_sem);
 		}
 
+		stats_sample();
+
 		twai_status_info_t status;
 		twai_get_status_info(&status);
+
+		// Driver-level losses. The counters reset when the driver is
+		// reinstalled (e.g. on a baud change), so track the delta.
+		uint32_t missed = status.rx_missed_count + status.rx_overrun_count;
+		if (missed < rx_missed_prev) {
+			rx_missed_prev = 0;
+		}
+		rx_driver_missed += missed - rx_missed_prev;
+		rx_missed_prev = missed;
+
 		if (status.state == TWAI_STATE_BUS_OFF || status.state == TWAI_STATE_RECOVERING) {
 			twai_initiate_recovery();
 
@@ -634,18 +839,35 @@ static void rx_task(void *arg) {
 	}
 
 	rx_running = false;
+	xSemaphoreGive(thd_stop_sem);
 	vTaskDelete(NULL);
 }
 
 static void process_task(void *arg) {
+	can_frame_tap_t frame_batch[RX_BATCH_MAX];
+	twai_message_t msg_buf;
+
 	for (;;) {
 		xSemaphoreTake(proc_sem, 10 / portTICK_PERIOD_MS);
 
-		while (rx_read != rx_write) {
-			twai_message_t *msg = &rx_buf[rx_read];
-			rx_read++;
-			if (rx_read >= RXBUF_LEN) {
-				rx_read = 0;
+		int batch_cnt = 0;
+
+		while (rb_spsc_pop(&rx_rb, &msg_buf)) {
+			twai_message_t *msg = &msg_buf;
+
+			// Collect frames for one event per burst instead of one
+			// flat value allocation per frame.
+			if (lispif_can_batch_enabled()) {
+				if (batch_cnt == RX_BATCH_MAX) {
+					lispif_process_can_batch(frame_batch, batch_cnt);
+					batch_cnt = 0;
+				}
+
+				can_frame_tap_t *f = &frame_batch[batch_cnt++];
+				f->id = msg->identifier;
+				f->len = msg->data_length_code;
+				f->ext = msg->extd;
+				memcpy(f->data, msg->data, f->len);
 			}
 
 			lispif_process_can(msg->identifier, msg->data, msg->data_length_code, msg->extd);
@@ -653,28 +875,66 @@ static void process_task(void *arg) {
 			if (use_vesc_decoder) {
 				if (!bms_process_can_frame(msg->identifier, msg->data, msg->data_length_code, msg->extd)) {
 					if (msg->extd) {
+						PERF_ENTER(can_decode);
 						decode_msg(msg->identifier, msg->data, msg->data_length_code, false);
+						PERF_EXIT(can_decode);
 					}
 				}
 			}
 		}
+
+		if (batch_cnt > 0) {
+			lispif_process_can_batch(frame_batch, batch_cnt);
+		}
 	}
 
 	vTaskDelete(NULL);
 }
 
+/*
+ * Gap inserted between the status frames of one period so they spread
+ * over the period instead of going out back-to-back. Expressed as a
+ * fraction of the period.
+ */
+#define STATUS_SLOT_DIV				8
+
 static void status_task(void *arg) {
 	int gga_cnt_last = 0;
 	int rmc_cnt_last = 0;
+	bool phase_applied = false;
 
 	while (!stop_threads) {
 		int rate = backup.config.can_status_rate_hz;
 
 		if (rate < 1) {
 			xSemaphoreTake(status_sem, 10);
+			phase_applied = false;
 			continue;
 		}
 
+		uint32_t period = configTICK_RATE_HZ / rate;
+		if (period < 1) {
+			period = 1;
+		}
+
+		/*
+		 * Offset this node's broadcasts within the common period by a
+		 * controller-id-derived phase, so nodes powered up together do
+		 * not burst in lockstep and lose arbitration to each other
+		 * every period.
+		 */
+		if (!phase_applied) {
+			uint32_t phase = ((uint32_t)backup.config.controller_id *
+					2654435761u) % period;
+			if (phase > 0) {
+				vTaskDelay(phase);
+			}
+			phase_applied = true;
+		}
+
+		uint32_t period_start = xTaskGetTickCount();
+		uint32_t slot_gap = period / STATUS_SLOT_DIV;
+
 #ifdef HW_CAN_STATUS_ADC0
 		{
 			int32_t send_index = 0;
@@ -685,6 +945,10 @@ static void status_task(void *arg) {
 			buffer_append_float16(buffer, HW_CAN_STATUS_ADC2, 1e2, &send_index);
 			buffer_append_float16(buffer, HW_CAN_STATUS_ADC3, 1e2, &send_index);
 			comm_can_transmit_eid(backup.config.controller_id | ((uint32_t)CAN_PACKET_IO_BOARD_ADC_1_TO_4 << 8), buffer, send_index);
+
+			if (slot_gap > 0) {
+				vTaskDelay(slot_gap);
+			}
 		}
 #endif
 
@@ -717,6 +981,10 @@ static void status_task(void *arg) {
 				buffer[send_index++] = s->rmc.mo;
 				buffer[send_index++] = s->rmc.dd;
 				comm_can_transmit_eid(backup.config.controller_id | ((uint32_t)CAN_PACKET_GNSS_TIME << 8), buffer, send_index);
+
+				if (slot_gap > 0) {
+					vTaskDelay(slot_gap);
+				}
 			}
 
 			if (gga_updated) {
@@ -726,11 +994,19 @@ static void status_task(void *arg) {
 				buffer_append_double64(buffer, s->gga.lat, D(1e16), &send_index);
 				comm_can_transmit_eid(backup.config.controller_id | ((uint32_t)CAN_PACKET_GNSS_LAT << 8), buffer, send_index);
 
+				if (slot_gap > 0) {
+					vTaskDelay(slot_gap);
+				}
+
 				// Lon
 				send_index = 0;
 				buffer_append_double64(buffer, s->gga.lon, D(1e16), &send_index);
 				comm_can_transmit_eid(backup.config.controller_id | ((uint32_t)CAN_PACKET_GNSS_LON << 8), buffer, send_index);
 
+				if (slot_gap > 0) {
+					vTaskDelay(slot_gap);
+				}
+
 				// Alt, speed, hdop
 				send_index = 0;
 				buffer_append_float32_auto(buffer, s->gga.height, &send_index);
@@ -740,10 +1016,14 @@ static void status_task(void *arg) {
 			}
 		}
 
-		xSemaphoreTake(status_sem, configTICK_RATE_HZ / rate);
+		// Wait out the remainder of the period, so the gaps above do
+		// not lower the configured rate.
+		uint32_t elapsed = xTaskGetTickCount() - period_start;
+		xSemaphoreTake(status_sem, elapsed < period ? period - elapsed : 1);
 	}
 
 	status_running = false;
+	xSemaphoreGive(thd_stop_sem);
 	vTaskDelete(NULL);
 }
 
@@ -811,7 +1091,9 @@ static void start_rx_thd(void) {
 static void stop_rx_thd(void) {
 	stop_rx = true;
 	while (rx_running) {
-		vTaskDelay(1);
+		// Timed take in case a stale token from an earlier stop is
+		// consumed before the flag is re-checked.
+		xSemaphoreTake(thd_stop_sem, 10);
 	}
 }
 
@@ -836,11 +1118,14 @@ void comm_can_start(int pin_tx, int pin_rx) {
 		psw_stat[i].id = -1;
 	}
 
+	memset(stat_idx, CAN_IDX_UNUSED, sizeof(stat_idx));
+
 	if (!sem_init_done) {
 		ping_sem = xSemaphoreCreateBinary();
 		proc_sem = xSemaphoreCreateBinary();
 		status_sem = xSemaphoreCreateBinary();
 		send_mutex = xSemaphoreCreateMutex();
+		thd_stop_sem = xSemaphoreCreateCounting(2, 0);
 
 		// The process-task is left running after the first init in case comm_can_stop
 		// is called from it.
@@ -880,7 +1165,7 @@ void comm_can_stop(void) {
 	stop_threads = true;
 	xSemaphoreGive(status_sem);
 	while (status_running || rx_running) {
-		vTaskDelay(2);
+		xSemaphoreTake(thd_stop_sem, 10);
 	}
 
 	twai_stop();
@@ -891,6 +1176,73 @@ int comm_can_get_rx_recovery_cnt(void) {
 	return rx_recovery_cnt;
 }
 
+uint32_t comm_can_get_rx_slot_evictions(void) {
+	return rx_slot_evictions;
+}
+
+uint32_t comm_can_get_rx_slot_drops(void) {
+	return rx_slot_drops;
+}
+
+void comm_can_stats_get(can_stats_t *stats) {
+	stats->rx_frames_sec = stats_rx_sec;
+	stats->tx_frames_sec = stats_tx_sec;
+	stats->bus_load = stats_bus_load;
+	stats->tx_queue_max = stats_tx_queue_max;
+	memcpy(stats->ping_hist, stats_ping_hist, sizeof(stats_ping_hist));
+	stats->rx_ring_drops = rx_ring_drops;
+	stats->rx_missed = rx_driver_missed;
+}
+
+/*
+ * Time the RX decode path on synthetic status frames and return how
+ * many it handles per second, which bounds the bus rate the receiver
+ * can keep up with. Used by the perf_report terminal command. The
+ * frames carry node id 254 so at most one status slot is disturbed.
+ */
+uint32_t comm_can_decode_bench(uint32_t iters) {
+	uint8_t data[8];
+	int32_t ind = 0;
+	buffer_append_int32(data, 12345, &ind);
+	buffer_append_int16(data, 100, &ind);
+	buffer_append_int16(data, 500, &ind);
+
+	uint32_t eid = 254 | ((uint32_t)CAN_PACKET_STATUS << 8);
+
+	int64_t t_start = esp_timer_get_time();
+	for (uint32_t i = 0;i < iters;i++) {
+		decode_msg(eid, data, 8, false);
+	}
+	int64_t us = esp_timer_get_time() - t_start;
+
+	if (us <= 0) {
+		return 0;
+	}
+
+	return (uint32_t)(((uint64_t)iters * 1000000) / (uint64_t)us);
+}
+
+void comm_can_stats_reset(void) {
+	stats_tx_queue_max = 0;
+	rx_ring_drops = 0;
+	rx_driver_missed = 0;
+	memset(stats_ping_hist, 0, sizeof(stats_ping_hist));
+	memset((void*)stats_ping_last, 0, sizeof(stats_ping_last));
+}
+
+/**
+ * Last measured ping round trip for a node.
+ *
+ * @param controller_id
+ * The node to look up.
+ *
+ * @return
+ * The latency in microseconds, or 0 if the node was never pinged.
+ */
+uint16_t comm_can_ping_time_last(uint8_t controller_id) {
+	return stats_ping_last[controller_id];
+}
+
 void comm_can_use_vesc_decoder(bool use_vesc_dec) {
 	use_vesc_decoder = use_vesc_dec;
 }
@@ -912,12 +1264,25 @@ CAN_BAUD comm_can_kbits_to_baud(int kbits) {
 	return new_baud;
 }
 
+// Wait until the driver TX queue is empty, at most max_ms, so queued
+// frames still go out at the old bitrate before a reconfiguration.
+static void tx_queue_drain(int max_ms) {
+	twai_status_info_t status;
+	int timeout = max_ms / portTICK_PERIOD_MS + 1;
+
+	while (timeout-- > 0 && twai_get_status_info(&status) == ESP_OK &&
+			status.msgs_to_tx > 0) {
+		vTaskDelay(1);
+	}
+}
+
 void comm_can_update_baudrate(int delay_msec) {
 	if (!init_done) {
 		return;
 	}
 
 	xSemaphoreTake(send_mutex, portMAX_DELAY);
+	tx_queue_drain(50);
 	stop_rx_thd();
 
 	twai_stop();
@@ -935,6 +1300,145 @@ void comm_can_update_baudrate(int delay_msec) {
 	xSemaphoreGive(send_mutex);
 }
 
+int comm_can_baud_to_kbits(CAN_BAUD baud) {
+	return baud_to_bps(baud) / 1000;
+}
+
+/**
+ * Probe the bus bitrate in listen-only mode. Each candidate rate is
+ * tried for probe_ms; the first one that sees traffic without bus
+ * errors wins. The node never transmits (not even error frames) while
+ * probing, so a wrong guess cannot disturb the bus. The driver is
+ * restored to the configured bitrate afterwards - pass the result to
+ * comm_can_update_baudrate after updating the config to apply it.
+ *
+ * @param probe_ms
+ * Listen time per candidate bitrate.
+ *
+ * @return
+ * The detected bitrate, or CAN_BAUD_INVALID if no traffic was seen.
+ */
+CAN_BAUD comm_can_probe_baud(int probe_ms) {
+	if (!init_done) {
+		return CAN_BAUD_INVALID;
+	}
+
+	static const CAN_BAUD bauds[] = {
+			CAN_BAUD_500K, CAN_BAUD_250K, CAN_BAUD_125K, CAN_BAUD_1M,
+			CAN_BAUD_100K, CAN_BAUD_50K, CAN_BAUD_20K, CAN_BAUD_10K
+	};
+
+	CAN_BAUD found = CAN_BAUD_INVALID;
+
+	xSemaphoreTake(send_mutex, portMAX_DELAY);
+	tx_queue_drain(50);
+	stop_rx_thd();
+
+	twai_stop();
+	twai_driver_uninstall();
+
+	twai_mode_t mode_old = g_config.mode;
+	g_config.mode = TWAI_MODE_LISTEN_ONLY;
+
+	for (unsigned int i = 0;i < sizeof(bauds) / sizeof(bauds[0]);i++) {
+		update_baud(bauds[i]);
+
+		if (twai_driver_install(&g_config, &t_config, &f_config) != ESP_OK) {
+			continue;
+		}
+		twai_start();
+
+		vTaskDelay(probe_ms / portTICK_PERIOD_MS);
+
+		twai_status_info_t status;
+		bool ok = twai_get_status_info(&status) == ESP_OK &&
+				status.msgs_to_rx > 0 && status.bus_error_count == 0;
+
+		twai_stop();
+		twai_driver_uninstall();
+
+		if (ok) {
+			found = bauds[i];
+			break;
+		}
+	}
+
+	g_config.mode = mode_old;
+	update_baud(backup.config.can_baud_rate);
+	twai_driver_install(&g_config, &t_config, &f_config);
+	twai_start();
+
+	start_rx_thd();
+	xSemaphoreGive(send_mutex);
+
+	return found;
+}
+
+/**
+ * Program the hardware acceptance filter. Frames that do not match are
+ * dropped by the peripheral and never wake the RX task. The filter is
+ * applied to the 29-bit extended id; bits set in mask are ignored in
+ * the comparison. An accept-all filter is code 0, mask 0x1FFFFFFF.
+ *
+ * Note that the filter is approximate: software decoding still checks
+ * the destination exactly, so a loose filter is safe while a too
+ * strict one silently drops traffic such as status broadcasts from
+ * other nodes.
+ *
+ * @param code
+ * 29-bit id bit pattern to accept.
+ *
+ * @param mask
+ * Bits set here are don't care.
+ */
+void comm_can_set_filter(uint32_t code, uint32_t mask) {
+	// Single-filter extended-frame layout: id in bits 31..3, RTR in
+	// bit 2, the lowest two bits unused.
+	f_config.acceptance_code = code << 3;
+	f_config.acceptance_mask = (mask << 3) | 0x7;
+	f_config.single_filter = true;
+
+	if (!init_done) {
+		return;
+	}
+
+	xSemaphoreTake(send_mutex, portMAX_DELAY);
+	stop_rx_thd();
+
+	twai_stop();
+	twai_driver_uninstall();
+
+	twai_driver_install(&g_config, &t_config, &f_config);
+	twai_start();
+
+	start_rx_thd();
+	xSemaphoreGive(send_mutex);
+}
+
+/**
+ * Derive and apply an acceptance filter from the local controller id.
+ * Only the destination byte of the extended id is compared; the
+ * command bits stay don't care so all packet types addressed to this
+ * node pass.
+ *
+ * @param controller_id
+ * The local controller id to accept frames for.
+ *
+ * @param accept_broadcast
+ * Also accept broadcast (id 255) frames. This widens the filter to a
+ * superset that includes ids sharing the bits set in controller_id,
+ * which is as close as the single hardware filter can get.
+ */
+void comm_can_filter_local(uint8_t controller_id, bool accept_broadcast) {
+	uint32_t mask = 0x1FFFFF00;
+
+	if (accept_broadcast) {
+		mask |= controller_id ^ 0xFF;
+	}
+
+	comm_can_set_filter(controller_id, mask);
+}
+
 void comm_can_change_pins(int tx, int rx) {
 	if (!init_done) {
 		return;
@@ -973,7 +1477,56 @@ void comm_can_change_pins(int tx, int rx) {
 	xSemaphoreGive(send_mutex);
 }
 
-void comm_can_transmit_eid(uint32_t id, const uint8_t *data, uint8_t len) {
+/*
+ * TX tiers. Control frames (setpoints, pings, status) go straight to
+ * the driver, while bulk fragment traffic from comm_can_send_buffer
+ * yields to waiting control frames and keeps the driver TX queue
+ * shallow, so a control frame is never stuck behind a long firmware
+ * forward on the same bus.
+ */
+#define TX_BULK_QUEUE_MAX			8
+
+static volatile int tx_ctrl_waiting = 0;
+
+static void transmit_msg(twai_message_t *tx_msg, bool bulk) {
+	if (bulk) {
+		int timeout = 100;
+		twai_status_info_t status;
+		while (timeout-- > 0 && (tx_ctrl_waiting > 0 ||
+				(twai_get_status_info(&status) == ESP_OK &&
+						status.msgs_to_tx >= TX_BULK_QUEUE_MAX))) {
+			vTaskDelay(1);
+		}
+	} else {
+		__atomic_add_fetch(&tx_ctrl_waiting, 1, __ATOMIC_RELAXED);
+	}
+
+	xSemaphoreTake(send_mutex, portMAX_DELAY);
+
+	if (init_done) {
+		twai_transmit(tx_msg, bulk ? 20 : 5);
+
+		stats_tx_cnt++;
+		stats_bits += frame_bits(tx_msg);
+
+		// Sample the queue depth high-water mark now and then
+		if ((stats_tx_cnt & 0x0F) == 0) {
+			twai_status_info_t status;
+			if (twai_get_status_info(&status) == ESP_OK &&
+					status.msgs_to_tx > stats_tx_queue_max) {
+				stats_tx_queue_max = status.msgs_to_tx;
+			}
+		}
+	}
+
+	xSemaphoreGive(send_mutex);
+
+	if (!bulk) {
+		__atomic_sub_fetch(&tx_ctrl_waiting, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void transmit_eid_tier(uint32_t id, const uint8_t *data, uint8_t len, bool bulk) {
 	if (!init_done) {
 		return;
 	}
@@ -989,16 +1542,11 @@ void comm_can_transmit_eid(uint32_t id, const uint8_t *data, uint8_t len) {
 	memcpy(tx_msg.data, data, len);
 	tx_msg.data_length_code = len;
 
-	xSemaphoreTake(send_mutex, portMAX_DELAY);
-
-	if (!init_done) {
-		xSemaphoreGive(send_mutex);
-		return;
-	}
-
-	twai_transmit(&tx_msg, 5);
+	transmit_msg(&tx_msg, bulk);
+}
 
-	xSemaphoreGive(send_mutex);
+void comm_can_transmit_eid(uint32_t id, const uint8_t *data, uint8_t len) {
+	transmit_eid_tier(id, data, len, false);
 }
 
 void comm_can_transmit_sid(uint32_t id, const uint8_t *data, uint8_t len) {
@@ -1017,16 +1565,40 @@ void comm_can_transmit_sid(uint32_t id, const uint8_t *data, uint8_t len) {
 	memcpy(tx_msg.data, data, len);
 	tx_msg.data_length_code = len;
 
-	xSemaphoreTake(send_mutex, portMAX_DELAY);
+	transmit_msg(&tx_msg, false);
+}
 
-	if (!init_done) {
-		xSemaphoreGive(send_mutex);
+/*
+ * Submit a burst of frames under one send-mutex acquisition. The
+ * per-frame cost drops to a single twai_transmit call and the burst
+ * stays together on the bus instead of interleaving with frames from
+ * other tasks between mutex handovers.
+ */
+void comm_can_transmit_batch(const can_batch_frame_t *frames, int num) {
+	if (!init_done || num <= 0) {
 		return;
 	}
 
-	twai_transmit(&tx_msg, 5);
+	__atomic_add_fetch(&tx_ctrl_waiting, 1, __ATOMIC_RELAXED);
+	xSemaphoreTake(send_mutex, portMAX_DELAY);
+
+	for (int i = 0;i < num;i++) {
+		twai_message_t tx_msg = {0};
+		tx_msg.extd = frames[i].ext ? 1 : 0;
+		tx_msg.identifier = frames[i].id;
+
+		int len = frames[i].len > 8 ? 8 : frames[i].len;
+		memcpy(tx_msg.data, frames[i].data, len);
+		tx_msg.data_length_code = len;
+
+		twai_transmit(&tx_msg, 5);
+
+		stats_tx_cnt++;
+		stats_bits += frame_bits(&tx_msg);
+	}
 
 	xSemaphoreGive(send_mutex);
+	__atomic_sub_fetch(&tx_ctrl_waiting, 1, __ATOMIC_RELAXED);
 }
 
 /**
@@ -1080,8 +1652,8 @@ void comm_can_send_buffer(uint8_t controller_id, uint8_t *data, unsigned int len
 				memcpy(send_buffer + 1, data + i, send_len);
 			}
 
-			comm_can_transmit_eid(controller_id |
-					((uint32_t)CAN_PACKET_FILL_RX_BUFFER << 8), send_buffer, send_len + 1);
+			transmit_eid_tier(controller_id |
+					((uint32_t)CAN_PACKET_FILL_RX_BUFFER << 8), send_buffer, send_len + 1, true);
 		}
 
 		for (unsigned int i = end_a;i < len;i += 6) {
@@ -1096,8 +1668,8 @@ void comm_can_send_buffer(uint8_t controller_id, uint8_t *data, unsigned int len
 				memcpy(send_buffer + 2, data + i, send_len);
 			}
 
-			comm_can_transmit_eid(controller_id |
-					((uint32_t)CAN_PACKET_FILL_RX_BUFFER_LONG << 8), send_buffer, send_len + 2);
+			transmit_eid_tier(controller_id |
+					((uint32_t)CAN_PACKET_FILL_RX_BUFFER_LONG << 8), send_buffer, send_len + 2, true);
 		}
 
 		uint32_t ind = 0;
@@ -1109,8 +1681,8 @@ void comm_can_send_buffer(uint8_t controller_id, uint8_t *data, unsigned int len
 		send_buffer[ind++] = (uint8_t)(crc >> 8);
 		send_buffer[ind++] = (uint8_t)(crc & 0xFF);
 
-		comm_can_transmit_eid(controller_id |
-				((uint32_t)CAN_PACKET_PROCESS_RX_BUFFER << 8), send_buffer, ind++);
+		transmit_eid_tier(controller_id |
+				((uint32_t)CAN_PACKET_PROCESS_RX_BUFFER << 8), send_buffer, ind++, true);
 	}
 }
 
@@ -1133,14 +1705,34 @@ bool comm_can_ping(uint8_t controller_id, HW_TYPE *hw_type) {
 
 	uint8_t buffer[1];
 	buffer[0] = backup.config.controller_id;
+
+	int64_t time_start = esp_timer_get_time();
 	comm_can_transmit_eid(controller_id | ((uint32_t)CAN_PACKET_PING << 8), buffer, 1);
 
 	bool ret = xSemaphoreTake(ping_sem, 10 / portTICK_PERIOD_MS) == pdTRUE;
 
 	if (ret) {
+		int64_t lat = esp_timer_get_time() - time_start;
+
+		if (lat < 500) {
+			stats_ping_hist[0]++;
+		} else if (lat < 1000) {
+			stats_ping_hist[1]++;
+		} else if (lat < 2000) {
+			stats_ping_hist[2]++;
+		} else if (lat < 5000) {
+			stats_ping_hist[3]++;
+		} else {
+			stats_ping_hist[4]++;
+		}
+
+		stats_ping_last[controller_id] = lat > 65535 ? 65535 : (uint16_t)lat;
+
 		if (hw_type) {
 			*hw_type = ping_hw_last;
 		}
+	} else {
+		stats_ping_hist[5]++;
 	}
 
 	return ret;
@@ -1254,13 +1846,7 @@ can_status_msg *comm_can_get_status_msg_index(int index) {
 }
 
 can_status_msg *comm_can_get_status_msg_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs[i].id == id) {
-			return &stat_msgs[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS, id, stat_msgs, sizeof(can_status_msg));
 }
 
 can_status_msg_2 *comm_can_get_status_msg_2_index(int index) {
@@ -1272,13 +1858,7 @@ can_status_msg_2 *comm_can_get_status_msg_2_index(int index) {
 }
 
 can_status_msg_2 *comm_can_get_status_msg_2_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs_2[i].id == id) {
-			return &stat_msgs_2[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS_2, id, stat_msgs_2, sizeof(can_status_msg_2));
 }
 
 can_status_msg_3 *comm_can_get_status_msg_3_index(int index) {
@@ -1290,13 +1870,7 @@ can_status_msg_3 *comm_can_get_status_msg_3_index(int index) {
 }
 
 can_status_msg_3 *comm_can_get_status_msg_3_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs_3[i].id == id) {
-			return &stat_msgs_3[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS_3, id, stat_msgs_3, sizeof(can_status_msg_3));
 }
 
 can_status_msg_4 *comm_can_get_status_msg_4_index(int index) {
@@ -1308,13 +1882,7 @@ can_status_msg_4 *comm_can_get_status_msg_4_index(int index) {
 }
 
 can_status_msg_4 *comm_can_get_status_msg_4_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs_4[i].id == id) {
-			return &stat_msgs_4[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS_4, id, stat_msgs_4, sizeof(can_status_msg_4));
 }
 
 can_status_msg_5 *comm_can_get_status_msg_5_index(int index) {
@@ -1326,13 +1894,7 @@ can_status_msg_5 *comm_can_get_status_msg_5_index(int index) {
 }
 
 can_status_msg_5 *comm_can_get_status_msg_5_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs_5[i].id == id) {
-			return &stat_msgs_5[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS_5, id, stat_msgs_5, sizeof(can_status_msg_5));
 }
 
 can_status_msg_6 *comm_can_get_status_msg_6_index(int index) {
@@ -1344,13 +1906,7 @@ can_status_msg_6 *comm_can_get_status_msg_6_index(int index) {
 }
 
 can_status_msg_6 *comm_can_get_status_msg_6_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (stat_msgs_6[i].id == id) {
-			return &stat_msgs_6[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_STATUS_6, id, stat_msgs_6, sizeof(can_status_msg_6));
 }
 
 io_board_adc_values *comm_can_get_io_board_adc_1_4_index(int index) {
@@ -1366,13 +1922,7 @@ io_board_adc_values *comm_can_get_io_board_adc_1_4_id(int id) {
 		return &io_board_adc_1_4[0];
 	}
 
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (io_board_adc_1_4[i].id == id) {
-			return &io_board_adc_1_4[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_IO_ADC_1_4, id, io_board_adc_1_4, sizeof(io_board_adc_values));
 }
 
 io_board_adc_values *comm_can_get_io_board_adc_5_8_index(int index) {
@@ -1388,13 +1938,7 @@ io_board_adc_values *comm_can_get_io_board_adc_5_8_id(int id) {
 		return &io_board_adc_5_8[0];
 	}
 
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (io_board_adc_5_8[i].id == id) {
-			return &io_board_adc_5_8[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_IO_ADC_5_8, id, io_board_adc_5_8, sizeof(io_board_adc_values));
 }
 
 io_board_digial_inputs *comm_can_get_io_board_digital_in_index(int index) {
@@ -1410,13 +1954,7 @@ io_board_digial_inputs *comm_can_get_io_board_digital_in_id(int id) {
 		return &io_board_digital_in[0];
 	}
 
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (io_board_digital_in[i].id == id) {
-			return &io_board_digital_in[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_IO_DIGITAL, id, io_board_digital_in, sizeof(io_board_digial_inputs));
 }
 
 void comm_can_io_board_set_output_digital(int id, int channel, bool on) {
@@ -1449,13 +1987,7 @@ psw_status *comm_can_get_psw_status_index(int index) {
 }
 
 psw_status *comm_can_get_psw_status_id(int id) {
-	for (int i = 0;i < CAN_STATUS_MSGS_TO_STORE;i++) {
-		if (psw_stat[i].id == id) {
-			return &psw_stat[i];
-		}
-	}
-
-	return 0;
+	return status_slot_lookup(CAN_IDX_PSW, id, psw_stat, sizeof(psw_status));
 }
 
 void comm_can_psw_switch(int id, bool is_on, bool plot) {
@@ -24,16 +24,49 @@
 
 #define CAN_STATUS_MSGS_TO_STORE	10
 
+// Ping latency histogram buckets: <0.5, <1, <2, <5, <=10 ms and timeout
+#define CAN_PING_HIST_LEN			6
+
+typedef struct {
+	uint32_t rx_frames_sec;
+	uint32_t tx_frames_sec;
+	float bus_load; // Percent of the last sample window
+	uint32_t tx_queue_max; // Driver TX queue high-water mark
+	uint32_t ping_hist[CAN_PING_HIST_LEN];
+	uint32_t rx_ring_drops; // Frames dropped because the RX ring was full
+	uint32_t rx_missed; // Frames lost in the driver queue or hardware FIFO
+} can_stats_t;
+
 // Functions
 void comm_can_start(int pin_tx, int pin_rx);
 void comm_can_stop(void);
 int comm_can_get_rx_recovery_cnt(void);
+uint32_t comm_can_get_rx_slot_evictions(void);
+uint32_t comm_can_get_rx_slot_drops(void);
+void comm_can_stats_get(can_stats_t *stats);
+void comm_can_stats_reset(void);
+uint32_t comm_can_decode_bench(uint32_t iters);
+uint16_t comm_can_ping_time_last(uint8_t controller_id);
 void comm_can_use_vesc_decoder(bool use_vesc_dec);
 CAN_BAUD comm_can_kbits_to_baud(int kbits);
+int comm_can_baud_to_kbits(CAN_BAUD baud);
+CAN_BAUD comm_can_probe_baud(int probe_ms);
 void comm_can_update_baudrate(int delay_msec);
+void comm_can_set_filter(uint32_t code, uint32_t mask);
+void comm_can_filter_local(uint8_t controller_id, bool accept_broadcast);
 void comm_can_change_pins(int tx, int rx);
 void comm_can_transmit_eid(uint32_t id, const uint8_t *data, uint8_t len);
 void comm_can_transmit_sid(uint32_t id, const uint8_t *data, uint8_t len);
+
+// One frame for comm_can_transmit_batch.
+typedef struct {
+	uint32_t id;
+	bool ext; // Extended (29-bit) identifier
+	uint8_t len;
+	uint8_t data[8];
+} can_batch_frame_t;
+
+void comm_can_transmit_batch(const can_batch_frame_t *frames, int num);
 void comm_can_send_buffer(uint8_t controller_id, uint8_t *data, unsigned int len, uint8_t send);
 bool comm_can_ping(uint8_t controller_id, HW_TYPE *hw_type);
 
@@ -0,0 +1,168 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include "comm_service.h"
+
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include <string.h>
+
+/*
+ * One event-driven task multiplexing the low-rate comm transports
+ * (UART events, BLE notify queue, USB polling) that each used to own a
+ * mostly-idle multi-KB task. Queue-backed handlers block in a queue
+ * set, so a posted event wakes the task immediately; poll handlers run
+ * on every wakeup, including the periodic timeout, and must be cheap
+ * no-ops when there is nothing to do.
+ *
+ * Handlers for queue members must consume at most one item per call
+ * with a non-blocking receive; the queue set delivers one wakeup per
+ * posted item. Command processing runs inline on this task, as it did
+ * on the per-transport tasks before.
+ */
+
+// Settings
+#define SERVICE_MEMBERS_MAX			8
+#define SERVICE_QUEUE_SET_LEN		64
+#define SERVICE_POLL_TICKS			1
+#define SERVICE_STACK_SIZE			4096
+
+typedef struct {
+	QueueHandle_t queue; // NULL for a free slot (and always NULL for polls)
+	comm_service_fn fn;
+	void *arg;
+} service_member_t;
+
+static service_member_t members[SERVICE_MEMBERS_MAX];
+static service_member_t polls[SERVICE_MEMBERS_MAX];
+static QueueSetHandle_t queue_set = NULL;
+// Serializes handler dispatch against registration, so unregistering a
+// queue guarantees its handler is not running when the call returns.
+// Recursive, because a handler running on the service task may itself
+// stop a transport (e.g. a script restarting a UART).
+static SemaphoreHandle_t reg_mutex = NULL;
+
+static void service_task(void *arg) {
+	(void)arg;
+
+	for (;;) {
+		QueueSetMemberHandle_t ready = xQueueSelectFromSet(queue_set, SERVICE_POLL_TICKS);
+
+		xSemaphoreTakeRecursive(reg_mutex, portMAX_DELAY);
+
+		if (ready != NULL) {
+			for (int i = 0;i < SERVICE_MEMBERS_MAX;i++) {
+				if (members[i].queue == ready && members[i].fn) {
+					members[i].fn(members[i].arg);
+					break;
+				}
+			}
+		}
+
+		for (int i = 0;i < SERVICE_MEMBERS_MAX;i++) {
+			if (polls[i].fn) {
+				polls[i].fn(polls[i].arg);
+			}
+		}
+
+		xSemaphoreGiveRecursive(reg_mutex);
+	}
+}
+
+void comm_service_init(void) {
+	if (queue_set != NULL) {
+		return;
+	}
+
+	memset(members, 0, sizeof(members));
+	memset(polls, 0, sizeof(polls));
+
+	queue_set = xQueueCreateSet(SERVICE_QUEUE_SET_LEN);
+	reg_mutex = xSemaphoreCreateRecursiveMutex();
+
+	xTaskCreatePinnedToCore(service_task, "comm_srv", SERVICE_STACK_SIZE,
+			NULL, 8, NULL, tskNO_AFFINITY);
+}
+
+bool comm_service_register_queue(QueueHandle_t queue, comm_service_fn fn, void *arg) {
+	bool res = false;
+
+	xSemaphoreTakeRecursive(reg_mutex, portMAX_DELAY);
+	for (int i = 0;i < SERVICE_MEMBERS_MAX;i++) {
+		if (members[i].queue == NULL) {
+			if (xQueueAddToSet(queue, queue_set) == pdPASS) {
+				members[i].queue = queue;
+				members[i].fn = fn;
+				members[i].arg = arg;
+				res = true;
+			}
+			break;
+		}
+	}
+	xSemaphoreGiveRecursive(reg_mutex);
+
+	return res;
+}
+
+void comm_service_unregister_queue(QueueHandle_t queue) {
+	xSemaphoreTakeRecursive(reg_mutex, portMAX_DELAY);
+
+	bool found = false;
+	for (int i = 0;i < SERVICE_MEMBERS_MAX;i++) {
+		if (members[i].queue == queue) {
+			members[i].queue = NULL;
+			members[i].fn = NULL;
+			members[i].arg = NULL;
+			found = true;
+		}
+	}
+
+	if (found) {
+		// A member can only leave the set while empty. The producer may
+		// still post between the drain and the removal, so retry until
+		// the removal wins the race. Stale ready-tokens left in the set
+		// are consumed harmlessly by the dispatch loop.
+		uint8_t scratch[COMM_SERVICE_ITEM_MAX];
+		while (xQueueRemoveFromSet(queue, queue_set) != pdPASS) {
+			while (xQueueReceive(queue, scratch, 0) == pdTRUE) {
+				;
+			}
+		}
+	}
+
+	xSemaphoreGiveRecursive(reg_mutex);
+}
+
+bool comm_service_register_poll(comm_service_fn fn, void *arg) {
+	bool res = false;
+
+	xSemaphoreTakeRecursive(reg_mutex, portMAX_DELAY);
+	for (int i = 0;i < SERVICE_MEMBERS_MAX;i++) {
+		if (polls[i].fn == NULL) {
+			polls[i].fn = fn;
+			polls[i].arg = arg;
+			res = true;
+			break;
+		}
+	}
+	xSemaphoreGiveRecursive(reg_mutex);
+
+	return res;
+}
@@ -0,0 +1,40 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#ifndef MAIN_COMM_SERVICE_H_
+#define MAIN_COMM_SERVICE_H_
+
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Largest item size, in bytes, of any queue registered with
+// comm_service_register_queue. Used as scratch storage when a queue is
+// drained during unregistration.
+#define COMM_SERVICE_ITEM_MAX		32
+
+typedef void (*comm_service_fn)(void *arg);
+
+// Functions
+void comm_service_init(void);
+bool comm_service_register_queue(QueueHandle_t queue, comm_service_fn fn, void *arg);
+void comm_service_unregister_queue(QueueHandle_t queue);
+bool comm_service_register_poll(comm_service_fn fn, void *arg);
+
+#endif /* MAIN_COMM_SERVICE_H_ */
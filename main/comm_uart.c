@@ -20,45 +20,105 @@
 #include "conf_general.h"
 #include "commands.h"
 #include "comm_uart.h"
+#include "comm_service.h"
 #include "packet.h"
+#include "pkt_trace.h"
 #include "driver/uart.h"
+#include "freertos/semphr.h"
 #include <string.h>
 
+// Settings
+#define RX_CHUNK_SIZE			256
+#define RX_DRIVER_BUFFER_SIZE	4096
+#define RX_EVENT_QUEUE_LEN		16
+
+// Idle-line framing thresholds. The VESC start/length framing cannot be
+// matched by the UART pattern detector (it only recognizes runs of one
+// repeated character), but a frame on the wire is a contiguous burst of
+// bytes followed by line idle. Raising the FIFO-full threshold to near
+// the 128-byte hardware FIFO and firing the RX-timeout interrupt after
+// two idle symbol times makes the ISR post one event per complete frame
+// instead of one per partial FIFO fill; only frames longer than the
+// FIFO cause an extra mid-frame event.
+#define RX_FULL_THRESHOLD		120
+#define RX_TIMEOUT_SYMBOLS		2
+
 typedef struct {
 	int uart_num;
 	PACKET_STATE_t packet_state;
-	volatile bool should_stop;
-	volatile bool is_running;
+	QueueHandle_t event_queue;
+	// Two RX chunks are alternated so one can be handed to the parser
+	// while the driver DMA:s into the other.
+	uint8_t rx_chunks[2][RX_CHUNK_SIZE];
+	int chunk_now;
 } uart_state;
 
+// High-speed profile ceiling; the UART peripheral divides from a
+// 40/80 MHz clock and 3 Mbaud is the highest rate with usable margin.
+#define UART_BAUD_MAX			3000000
+
 static uart_state *m_state[UART_NUM_MAX] = {0};
+static volatile uint32_t m_overflow_cnt = 0;
+static volatile uint32_t m_frame_err_cnt = 0;
+static volatile uint32_t m_parity_err_cnt = 0;
 
-static void rx_task(void *arg) {
+// Runs on the shared comm service task when the driver posts an event.
+// One non-blocking receive per call, as the queue set requires.
+static void uart_event_fn(void *arg) {
 	uart_state *state = (uart_state*)arg;
+	uart_event_t event;
 
-	state->is_running = true;
+	if (!xQueueReceive(state->event_queue, &event, 0)) {
+		return;
+	}
 
-	while (!state->should_stop) {
-		uint8_t buf[1];
-		int bytes = uart_read_bytes(state->uart_num, buf, 1, 3);
-		if (bytes > 0) {
-			packet_process_byte(buf[0], &(state->packet_state));
-		}
+	switch (event.type) {
+	case UART_DATA: {
+		// Drain everything buffered, whole chunks at a time, and
+		// feed the bulk parser. Alternating chunks lets the
+		// driver keep filling its DMA buffer while we parse.
+		size_t available = 0;
+		uart_get_buffered_data_len(state->uart_num, &available);
 
-		// Check if this uart has been stopped externally
-		if (!uart_is_driver_installed(state->uart_num)) {
-			m_state[state->uart_num] = NULL;
-			free(state);
-			state = NULL;
-			break;
-		}
-	}
+		while (available > 0) {
+			uint8_t *chunk = state->rx_chunks[state->chunk_now];
+			state->chunk_now = !state->chunk_now;
 
-	if (state) {
-		state->is_running = false;
-	}
+			int bytes = uart_read_bytes(state->uart_num, chunk,
+					available > RX_CHUNK_SIZE ? RX_CHUNK_SIZE : available, 0);
+
+			if (bytes <= 0) {
+				break;
+			}
 
-	vTaskDelete(NULL);
+			pkt_trace_stage(PKT_TRACE_RX);
+			packet_process_buffer(chunk, bytes, &(state->packet_state));
+			available -= bytes;
+		}
+	} break;
+
+	case UART_FIFO_OVF:
+	case UART_BUFFER_FULL:
+		// Bytes were lost. Count it and resynchronize.
+		m_overflow_cnt++;
+		uart_flush_input(state->uart_num);
+		xQueueReset(state->event_queue);
+		packet_reset(&(state->packet_state));
+		break;
+
+	// Line errors corrupt at most one packet, which the CRC rejects;
+	// counting them makes marginal cabling visible at high baud rates.
+	case UART_FRAME_ERR:
+		m_frame_err_cnt++;
+		break;
+
+	case UART_PARITY_ERR:
+		m_parity_err_cnt++;
+		break;
+
+	default:
+		break;
+	}
 }
 
 static void send_packet_u0(unsigned char *data, unsigned int len) {
@@ -109,17 +169,24 @@ bool comm_uart_init(int pin_tx, int pin_rx, int uart_num, int baudrate) {
 			.source_clk = UART_SCLK_DEFAULT,
 	};
 
-	uart_driver_install(uart_num, 512, 512, 0, 0, 0);
+	uart_driver_install(uart_num, RX_DRIVER_BUFFER_SIZE, 512,
+			RX_EVENT_QUEUE_LEN, &state->event_queue, 0);
 	uart_param_config(uart_num, &uart_config);
 	uart_set_pin(uart_num, pin_tx, pin_rx, -1, -1);
 
+	uart_set_rx_full_threshold(uart_num, RX_FULL_THRESHOLD);
+	uart_set_rx_timeout(uart_num, RX_TIMEOUT_SYMBOLS);
+	// Deliver the timeout event even when the FIFO is above the full
+	// threshold, so the end of a long frame is never missed.
+	uart_set_always_rx_timeout(uart_num, true);
+
 	if (uart_num == 0) {
 		packet_init(send_packet_raw_u0, process_packet_u0, &(state->packet_state));
 	} else {
 		packet_init(send_packet_raw_u1, process_packet_u1, &(state->packet_state));
 	}
 
-	xTaskCreatePinnedToCore(rx_task, "uart_rx", 3072, state, 8, NULL, tskNO_AFFINITY);
+	comm_service_register_queue(state->event_queue, uart_event_fn, state);
 	m_state[uart_num] = state;
 
 	return true;
@@ -134,12 +201,11 @@ void comm_uart_stop(int uart_num) {
 	if (state) {
 		m_state[uart_num] = NULL;
 
-		state->should_stop = true;
-		while (state->is_running) {
-			vTaskDelay(1);
-		}
+		// Returns with the handler guaranteed not running, so the state
+		// can be freed.
+		comm_service_unregister_queue(state->event_queue);
 
-		vTaskDelay(1);
+		packet_release_buffers(&(state->packet_state));
 		free(state);
 	}
 
@@ -155,3 +221,54 @@ void comm_uart_send_packet(unsigned char *data, unsigned int len, int uart_num)
 
 	packet_send_packet(data, len, &(m_state[uart_num]->packet_state));
 }
+
+uint32_t comm_uart_get_overflow_cnt(void) {
+	return m_overflow_cnt;
+}
+
+uint32_t comm_uart_get_frame_err_cnt(void) {
+	return m_frame_err_cnt;
+}
+
+uint32_t comm_uart_get_parity_err_cnt(void) {
+	return m_parity_err_cnt;
+}
+
+bool comm_uart_set_profile(int uart_num, int baudrate, bool flow_ctrl) {
+	if (uart_num < 0 || uart_num >= UART_NUM_MAX || m_state[uart_num] == NULL) {
+		return false;
+	}
+
+	if (baudrate <= 0 || baudrate > UART_BAUD_MAX) {
+		return false;
+	}
+
+	if (flow_ctrl) {
+#if defined(HW_UART_RTS) && defined(HW_UART_CTS)
+		if (uart_set_pin(uart_num, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE,
+				HW_UART_RTS, HW_UART_CTS) != ESP_OK) {
+			return false;
+		}
+		// RTS deasserts when the hardware FIFO passes the same threshold
+		// that triggers the full interrupt, so the peer stops before the
+		// driver ring has to absorb a burst.
+		uart_set_hw_flow_ctrl(uart_num, UART_HW_FLOWCTRL_CTS_RTS, RX_FULL_THRESHOLD);
+#else
+		// No RTS/CTS on this pin map.
+		return false;
+#endif
+	} else {
+		uart_set_hw_flow_ctrl(uart_num, UART_HW_FLOWCTRL_DISABLE, 0);
+	}
+
+	if (uart_set_baudrate(uart_num, baudrate) != ESP_OK) {
+		return false;
+	}
+
+	// Two idle symbols shrink to well under a microsecond at multi-
+	// megabaud, where scheduling jitter on the sender shows up as gaps.
+	// A longer timeout keeps one event per frame instead of one per gap.
+	uart_set_rx_timeout(uart_num, baudrate > 1000000 ? 8 : RX_TIMEOUT_SYMBOLS);
+
+	return true;
+}
@@ -23,5 +23,19 @@
 bool comm_uart_init(int pin_tx, int pin_rx, int uart_num, int baudrate);
 void comm_uart_stop(int uart_num);
 void comm_uart_send_packet(unsigned char *data, unsigned int len, int uart_num);
+uint32_t comm_uart_get_overflow_cnt(void);
+uint32_t comm_uart_get_frame_err_cnt(void);
+uint32_t comm_uart_get_parity_err_cnt(void);
+
+/*
+ * Switch a running port to a high-speed profile, up to 3 Mbaud.
+ * Hardware RTS/CTS flow control is enabled when requested and the pin
+ * map provides HW_UART_RTS/HW_UART_CTS; asking for flow control
+ * without those pins fails without touching the port. Negotiated via
+ * COMM_UART_SET_PROFILE: the reply is sent after the switch, so a
+ * gateway changes its own rate right after sending the command and
+ * reads the ack at the new rate.
+ */
+bool comm_uart_set_profile(int uart_num, int baudrate, bool flow_ctrl);
 
 #endif /* MAIN_COMM_UART_H_ */
@@ -19,7 +19,9 @@
 
 #include "commands.h"
 #include "comm_usb.h"
+#include "comm_service.h"
 #include "packet.h"
+#include "pkt_trace.h"
 
 #include <string.h>
 #include <stdbool.h>
@@ -37,12 +39,47 @@
 
 static PACKET_STATE_t packet_state;
 
-static void rx_task(void *arg) {
-	for (;;) {
-		uint8_t buf[1];
-		usb_serial_jtag_read_bytes(buf, 1, portMAX_DELAY);
-		packet_process_byte(buf[0], &packet_state);
+// Throughput counters, folded into per-second figures from the poll
+// function once per second, same scheme as the CAN stats.
+static volatile uint32_t stats_rx_bytes = 0;
+static volatile uint32_t stats_tx_bytes = 0;
+static volatile uint32_t stats_rx_sec = 0;
+static volatile uint32_t stats_tx_sec = 0;
+static uint32_t stats_rx_window = 0;
+static uint32_t stats_tx_window = 0;
+static uint32_t stats_sample_time = 0;
+
+static void stats_sample(void) {
+	uint32_t now = xTaskGetTickCount();
+	uint32_t elapsed = now - stats_sample_time;
+
+	if (elapsed < configTICK_RATE_HZ) {
+		return;
 	}
+
+	stats_rx_sec = stats_rx_bytes - stats_rx_window;
+	stats_tx_sec = stats_tx_bytes - stats_tx_window;
+	stats_rx_window = stats_rx_bytes;
+	stats_tx_window = stats_tx_bytes;
+	stats_sample_time = now;
+}
+
+// Polled from the shared comm service task. The USB-serial-JTAG driver
+// has no event queue to block on, so the driver RX buffer is sized to
+// hold more than one poll period of data at full line rate and drained
+// in bulk here, straight into the buffer-wise packet parser.
+static void usb_poll_fn(void *arg) {
+	(void)arg;
+	uint8_t buf[512];
+	int bytes;
+
+	while ((bytes = usb_serial_jtag_read_bytes(buf, sizeof(buf), 0)) > 0) {
+		stats_rx_bytes += bytes;
+		pkt_trace_stage(PKT_TRACE_RX);
+		packet_process_buffer(buf, bytes, &packet_state);
+	}
+
+	stats_sample();
 }
 
 static void process_packet(unsigned char *data, unsigned int len) {
@@ -53,14 +90,18 @@ static void send_packet_raw(unsigned char *buffer, unsigned int len) {
 	unsigned int sent = 0;
 	int fail_cnt = 0;
 
+	// The driver copies into its TX ring, so large chunks just mean
+	// fewer ring operations; the hardware drains 64-byte double-buffered
+	// endpoint frames from the ring on its own.
 	while (sent < len) {
 		int to_send = len - sent;
-		if (to_send > 150) {
-			to_send = 150;
+		if (to_send > 512) {
+			to_send = 512;
 		}
 
 		unsigned int sent_now = usb_serial_jtag_write_bytes(buffer + sent, to_send, 10);
 		sent += sent_now;
+		stats_tx_bytes += sent_now;
 
 		if (sent_now == 0) {
 			fail_cnt++;
@@ -76,15 +117,46 @@ static void send_packet_raw(unsigned char *buffer, unsigned int len) {
 
 void comm_usb_init(void) {
 	usb_serial_jtag_driver_config_t usb_serial_jtag_config;
-	usb_serial_jtag_config.rx_buffer_size = 1024;
-	usb_serial_jtag_config.tx_buffer_size = 256;
+	usb_serial_jtag_config.rx_buffer_size = 8192;
+	// Large enough that a full-size response fits in the ring in one
+	// write, so bulk pulls are not throttled by 256-byte copy steps.
+	usb_serial_jtag_config.tx_buffer_size = 4096;
 	usb_serial_jtag_driver_install(&usb_serial_jtag_config);
 
 	packet_init(send_packet_raw, process_packet, &packet_state);
 
-	xTaskCreatePinnedToCore(rx_task, "usb_rx", 3072, NULL, 8, NULL, tskNO_AFFINITY);
+	// USB is the fastest wired transport, allow streamed packets above
+	// the default payload limit for bulk log pulls.
+	packet_set_max_len(&packet_state, 4096);
+
+	comm_service_register_poll(usb_poll_fn, NULL);
 }
 
 void comm_usb_send_packet(unsigned char *data, unsigned int len) {
 	packet_send_packet(data, len, &packet_state);
 }
+
+bool comm_usb_set_integrity(int mode) {
+	if (mode < PACKET_INTEGRITY_CRC16 || mode > PACKET_INTEGRITY_NONE) {
+		return false;
+	}
+
+	packet_set_integrity(&packet_state, mode);
+	return true;
+}
+
+void comm_usb_stats_get(usb_stats_t *stats) {
+	stats->rx_bytes = stats_rx_bytes;
+	stats->tx_bytes = stats_tx_bytes;
+	stats->rx_bytes_sec = stats_rx_sec;
+	stats->tx_bytes_sec = stats_tx_sec;
+}
+
+void comm_usb_stats_reset(void) {
+	stats_rx_bytes = 0;
+	stats_tx_bytes = 0;
+	stats_rx_sec = 0;
+	stats_tx_sec = 0;
+	stats_rx_window = 0;
+	stats_tx_window = 0;
+}
@@ -20,7 +20,28 @@
 #ifndef MAIN_COMM_USB_H_
 #define MAIN_COMM_USB_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	uint32_t rx_bytes;
+	uint32_t tx_bytes;
+	uint32_t rx_bytes_sec; // Throughput over the last sample window
+	uint32_t tx_bytes_sec;
+} usb_stats_t;
+
 void comm_usb_init(void);
 void comm_usb_send_packet(unsigned char *data, unsigned int len);
+void comm_usb_stats_get(usb_stats_t *stats);
+void comm_usb_stats_reset(void);
+
+/*
+ * Switch the packet integrity mode on the USB link (PACKET_INTEGRITY_*
+ * in packet.h). The USB protocol has CRC-protected transfers of its
+ * own, so the lighter modes skip redundant per-packet CRC16 work at
+ * high packet rates. Negotiated via COMM_PACKET_SET_INTEGRITY; applied
+ * before the ack, so the host switches right after sending.
+ */
+bool comm_usb_set_integrity(int mode);
 
 #endif /* MAIN_COMM_USB_H_ */
@@ -24,15 +24,20 @@
 #include "utils.h"
 #include "main.h"
 #include "packet.h"
+#include "pkt_trace.h"
+#include "heap_track.h"
 #include "commands.h"
+#include "coex_stats.h"
 #include "datatypes.h"
 #include "esp_log.h"
 
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
@@ -67,15 +72,118 @@ static wifi_config_t wifi_config = {0};
 
 static comm_wifi_event_cb_t event_listener = NULL;
 
+/*
+ * Fast-rejoin cache. After a successful association the AP's channel
+ * and BSSID are remembered and the first reconnect attempts pin the
+ * scan to that channel and AP, skipping the full all-channel scan that
+ * costs several seconds of telemetry blackout. After
+ * FAST_REJOIN_MAX_FAILS failed attempts (AP rebooted, moved channel,
+ * roamed) the cache is dropped and reconnection falls back to a full
+ * scan. The DHCP lease is kept by esp_netif across reconnects, so a
+ * rejoin to the same AP only costs a renew.
+ */
+#define FAST_REJOIN_MAX_FAILS	3
+
+static bool fast_rejoin_valid = false;
+static uint8_t fast_rejoin_channel = 0;
+static uint8_t fast_rejoin_bssid[6] = {0};
+static int fast_rejoin_fails = 0;
+static int64_t reconnect_t_start = 0;
+static uint32_t reconnect_cnt = 0;
+static uint32_t reconnect_time_last_ms = 0;
+
+/*
+ * TX coalescing. Small packets written within a short window are
+ * appended to a per-socket buffer and sent as one segment, so a 500 Hz
+ * stream of 20-60 byte telemetry packets does not cost one TCP segment
+ * (and one radio wakeup) each. The buffer is one MSS so a flush never
+ * fragments. A dedicated task does the flushing (the sends can block)
+ * but is paced by an esp_timer giving a semaphore every
+ * TX_COALESCE_DELAY_MS, so the cadence is a real 2 ms and not rounded
+ * up to whole FreeRTOS ticks.
+ */
+#define TX_COALESCE_BUF_SIZE	1460
+#define TX_COALESCE_DELAY_MS	2
+
 typedef struct {
 	PACKET_STATE_t *packet;
 	int socket;
 	esp_ip4_addr_t ip_client;
+	uint8_t tx_buf[TX_COALESCE_BUF_SIZE];
+	volatile int tx_len;
+	SemaphoreHandle_t tx_mutex;
 } comm_state;
 
-static comm_state comm_local = {.socket = -1, .ip_client = {0}};
+/*
+ * The local TCP server accepts up to TCP_LOCAL_CLIENT_MAX concurrent
+ * clients, each with its own packet state (whose working buffers come
+ * from mempools) and coalescing buffer, so a logger and VESC Tool can
+ * share the device without killing each other's sessions. One
+ * select-based task serves all client sockets; replies are routed to
+ * the client that sent the request while comm_wifi_send_packet_local
+ * broadcasts to every connected client.
+ *
+ * When changing TCP_LOCAL_CLIENT_MAX, also update the
+ * LOCAL_CLIENT_FUNCS instantiations below.
+ */
+#define TCP_LOCAL_CLIENT_MAX	3
+
+static comm_state comm_local[TCP_LOCAL_CLIENT_MAX] = {
+		[0 ... (TCP_LOCAL_CLIENT_MAX - 1)] = {.socket = -1, .ip_client = {0}}};
 static comm_state comm_hub = {.socket = -1, .ip_client = {0}};
 
+/*
+ * UDP transport for loss-tolerant streams, served next to the local
+ * TCP server. Datagrams carry a 16-bit sequence number followed by a
+ * regular framed packet, are never retransmitted and therefore cannot
+ * head-of-line block the way the TCP streams can during RF fades.
+ * Replies go to the source of the last received datagram.
+ */
+#define UDP_LOCAL_PORT			65103
+
+static comm_state comm_udp = {.socket = -1, .ip_client = {0}};
+static struct sockaddr_in udp_peer;
+static volatile socklen_t udp_peer_len = 0;
+static uint16_t udp_seq_tx = 0;
+static uint16_t udp_seq_rx_last = 0;
+static bool udp_seq_rx_valid = false;
+static volatile uint32_t udp_seq_drops = 0;
+
+/*
+ * Link-quality statistics and the optional congestion controller. The
+ * send paths count transmissions, retries (a send() error that is
+ * retried) and failures (a send given up on or a dropped datagram) and
+ * track the worst send blocking time and coalesce-buffer fill over the
+ * current window. A 1 s timer samples the STA RSSI, closes the window
+ * and derives a rate scale in [LINK_SCALE_MIN, 1.0]: multiplicative
+ * decrease on any congestion sign (retry burst, long blocking, weak
+ * signal), slow recovery when a window was clean. The scale is always
+ * computed so scripts can trim their own telemetry rates to it; when
+ * the controller is enabled it is also actuated locally by stretching
+ * the TX coalescing flush period, so the same payload is carried in
+ * fewer, larger segments instead of piling up in socket buffers at the
+ * edge of range.
+ */
+#define LINK_STATS_PERIOD_MS		1000
+#define LINK_RETRY_HIGH				5
+#define LINK_BLOCK_HIGH_US			50000
+#define LINK_RSSI_LOW				(-80)
+#define LINK_SCALE_MIN				0.25
+#define TX_COALESCE_DELAY_MAX_MS	20
+
+static volatile uint32_t link_tx_cnt = 0;
+static volatile uint32_t link_tx_retries = 0;
+static volatile uint32_t link_tx_fails = 0;
+static volatile uint32_t link_tx_block_max_us = 0; // Current window
+static volatile uint32_t link_coalesce_hw = 0; // Current window, bytes
+static volatile int8_t link_rssi = 0;
+static volatile float link_scale = 1.0;
+static volatile bool link_rate_ctrl_en = false;
+static uint32_t link_tx_retries_last = 0;
+static volatile uint32_t tx_coalesce_delay_ms = TX_COALESCE_DELAY_MS;
+static SemaphoreHandle_t tx_flush_sem = NULL;
+static esp_timer_handle_t tx_flush_timer = NULL;
+
 // Used for logging
 __attribute__((unused))
 static const char *wifi_reason_to_str(wifi_err_reason_t reason) {
@@ -207,12 +315,17 @@ static void do_comm(const int sock, comm_state *comm) {
 	do {
 		len = recv(sock, rx_buffer, sizeof(rx_buffer) - 1, 0);
 
+		if (len > 0) {
+			pkt_trace_stage(PKT_TRACE_RX);
+		}
+
 		for (int i = 0;i < len;i++) {
 			packet_process_byte(rx_buffer[i], comm->packet);
 		}
 	} while (len > 0);
 
 	comm->socket = -1;
+	comm->tx_len = 0;
 }
 
 static void set_socket_options(int sock) {
@@ -268,18 +381,92 @@ static void tcp_task_local(void *arg) {
 		int opt = 1;
 		setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 		bind(listen_sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-		listen(listen_sock, 1);
+		listen(listen_sock, TCP_LOCAL_CLIENT_MAX);
+
+		for (;;) {
+			fd_set rfds;
+			FD_ZERO(&rfds);
+			FD_SET(listen_sock, &rfds);
+			int nfds = listen_sock;
+
+			for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+				if (comm_local[i].socket >= 0) {
+					FD_SET(comm_local[i].socket, &rfds);
+					if (comm_local[i].socket > nfds) {
+						nfds = comm_local[i].socket;
+					}
+				}
+			}
 
-		struct sockaddr addr;
-		socklen_t addr_len = sizeof(addr);
-		int sock = accept(listen_sock, &addr, &addr_len);
+			if (select(nfds + 1, &rfds, NULL, NULL, NULL) < 0) {
+				break;
+			}
 
-		memcpy(&comm_local.ip_client, addr.sa_data + 2, 4);
-		set_socket_options(sock);
+			if (FD_ISSET(listen_sock, &rfds)) {
+				struct sockaddr addr;
+				socklen_t addr_len = sizeof(addr);
+				int sock = accept(listen_sock, &addr, &addr_len);
+
+				if (sock >= 0) {
+					int slot = -1;
+					for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+						if (comm_local[i].socket < 0) {
+							slot = i;
+							break;
+						}
+					}
+
+					if (slot < 0) {
+						// All slots taken. Reject the newcomer instead of
+						// killing an established session.
+						shutdown(sock, 0);
+						close(sock);
+					} else {
+						memcpy(&comm_local[slot].ip_client, addr.sa_data + 2, 4);
+						set_socket_options(sock);
+						packet_reset(comm_local[slot].packet);
+						comm_local[slot].tx_len = 0;
+						comm_local[slot].socket = sock;
+					}
+				}
+			}
 
-		do_comm(sock, &comm_local);
-		shutdown(sock, 0);
-		close(sock);
+			for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+				int sock = comm_local[i].socket;
+				if (sock < 0 || !FD_ISSET(sock, &rfds)) {
+					continue;
+				}
+
+				char rx_buffer[128];
+				int len = recv(sock, rx_buffer, sizeof(rx_buffer) - 1, 0);
+
+				if (len <= 0) {
+					comm_local[i].socket = -1;
+					comm_local[i].tx_len = 0;
+					// Return the packet working buffers to mempools while
+					// no client uses this slot.
+					packet_release_buffers(comm_local[i].packet);
+					shutdown(sock, 0);
+					close(sock);
+				} else {
+					pkt_trace_stage(PKT_TRACE_RX);
+					for (int j = 0;j < len;j++) {
+						packet_process_byte(rx_buffer[j], comm_local[i].packet);
+					}
+				}
+			}
+		}
+
+		// select failed; drop all clients and rebuild the listener.
+		for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+			if (comm_local[i].socket >= 0) {
+				shutdown(comm_local[i].socket, 0);
+				close(comm_local[i].socket);
+				comm_local[i].socket = -1;
+				comm_local[i].tx_len = 0;
+				packet_release_buffers(comm_local[i].packet);
+			}
+		}
 
 		shutdown(listen_sock, 0);
 		close(listen_sock);
@@ -361,20 +548,166 @@ static void broadcast_task(void *arg) {
 	vTaskDelete(NULL);
 }
 
-static void process_packet_local(unsigned char *data, unsigned int len) {
-	commands_process_packet(data, len, comm_wifi_send_packet_local);
+static void send_coalesced(comm_state *comm, unsigned char *buffer, unsigned int len);
+
+/*
+ * Per-client send and process functions for the local TCP server. Each
+ * client slot needs its own reply function so that responses (including
+ * ones stored for later, like blocking command replies) reach the
+ * client that made the request and not whoever connected last.
+ */
+#define LOCAL_CLIENT_FUNCS(n) \
+static void send_packet_local_ ## n(unsigned char *data, unsigned int len) { \
+	packet_send_packet(data, len, comm_local[n].packet); \
+} \
+static void send_raw_local_ ## n(unsigned char *buffer, unsigned int len) { \
+	send_coalesced(&comm_local[n], buffer, len); \
+} \
+static void process_packet_local_ ## n(unsigned char *data, unsigned int len) { \
+	commands_process_packet(data, len, send_packet_local_ ## n); \
 }
 
+LOCAL_CLIENT_FUNCS(0)
+LOCAL_CLIENT_FUNCS(1)
+LOCAL_CLIENT_FUNCS(2)
+
+static comm_wifi_send_func_t const send_packet_local_fns[TCP_LOCAL_CLIENT_MAX] = {
+		send_packet_local_0, send_packet_local_1, send_packet_local_2};
+static comm_wifi_send_func_t const send_raw_local_fns[TCP_LOCAL_CLIENT_MAX] = {
+		send_raw_local_0, send_raw_local_1, send_raw_local_2};
+static comm_wifi_send_func_t const process_packet_local_fns[TCP_LOCAL_CLIENT_MAX] = {
+		process_packet_local_0, process_packet_local_1, process_packet_local_2};
+
 static void process_packet_hub(unsigned char *data, unsigned int len) {
 	commands_process_packet(data, len, comm_wifi_send_packet_hub);
 }
 
+static void process_packet_udp(unsigned char *data, unsigned int len) {
+	commands_process_packet(data, len, comm_wifi_send_packet_udp);
+}
+
+static void udp_send_raw(unsigned char *buffer, unsigned int len) {
+	if (comm_udp.socket < 0 || udp_peer_len == 0) {
+		return;
+	}
+
+	static uint8_t dgram[PACKET_BUFFER_LEN + 2];
+	if (len > sizeof(dgram) - 2) {
+		return;
+	}
+
+	xSemaphoreTake(comm_udp.tx_mutex, portMAX_DELAY);
+
+	link_tx_cnt++;
+	udp_seq_tx++;
+	dgram[0] = udp_seq_tx >> 8;
+	dgram[1] = udp_seq_tx & 0xFF;
+	memcpy(dgram + 2, buffer, len);
+
+	// Fire-and-forget, drop on failure
+	if (sendto(comm_udp.socket, dgram, len + 2, 0,
+			(struct sockaddr *)&udp_peer, udp_peer_len) < 0) {
+		link_tx_fails++;
+		coex_stats_note_denial(COEX_RADIO_WIFI);
+	} else {
+		coex_stats_note_grant(COEX_RADIO_WIFI);
+	}
+
+	xSemaphoreGive(comm_udp.tx_mutex);
+}
+
+static void udp_task(void *arg) {
+	static uint8_t rx_buffer[1500];
+
+	for (;;) {
+		struct sockaddr_in bind_addr = {0};
+		bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		bind_addr.sin_family = AF_INET;
+		bind_addr.sin_port = htons(UDP_LOCAL_PORT);
+
+		int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+		if (sock < 0 || bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) != 0) {
+			if (sock >= 0) {
+				close(sock);
+			}
+			vTaskDelay(1000 / portTICK_PERIOD_MS);
+			continue;
+		}
+
+		comm_udp.socket = sock;
+
+		for (;;) {
+			struct sockaddr_in src;
+			socklen_t src_len = sizeof(src);
+			int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0,
+					(struct sockaddr *)&src, &src_len);
+
+			if (len < 0) {
+				break;
+			}
+
+			if (len < 2) {
+				continue;
+			}
+
+			uint16_t seq = ((uint16_t)rx_buffer[0] << 8) | rx_buffer[1];
+			if (udp_seq_rx_valid) {
+				uint16_t expected = udp_seq_rx_last + 1;
+				if (seq != expected) {
+					udp_seq_drops += (uint16_t)(seq - expected);
+				}
+			}
+			udp_seq_rx_last = seq;
+			udp_seq_rx_valid = true;
+
+			udp_peer = src;
+			udp_peer_len = src_len;
+			memcpy(&comm_udp.ip_client, &src.sin_addr.s_addr, 4);
+
+			// Every datagram holds complete frames, so stale partial
+			// state from a lost datagram must not leak into this one.
+			packet_reset(comm_udp.packet);
+			pkt_trace_stage(PKT_TRACE_RX);
+			packet_process_buffer(rx_buffer + 2, len - 2, comm_udp.packet);
+		}
+
+		comm_udp.socket = -1;
+		close(sock);
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+	}
+
+	vTaskDelete(NULL);
+}
+
+// Apply the station config with or without the fast-rejoin channel and
+// BSSID pin. Works on a copy so the stored wifi_config keeps only what
+// the user configured.
+static void apply_sta_config(bool fast_rejoin) {
+	wifi_config_t cfg = wifi_config;
+
+	if (fast_rejoin) {
+		cfg.sta.channel = fast_rejoin_channel;
+		cfg.sta.bssid_set = true;
+		memcpy(cfg.sta.bssid, fast_rejoin_bssid, 6);
+		cfg.sta.scan_method = WIFI_FAST_SCAN;
+	}
+
+	esp_wifi_set_config(WIFI_IF_STA, &cfg);
+}
+
 void comm_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
 	if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
 		if (!wifi_reconnect_disabled) {
 			is_connecting = true;
 			esp_wifi_connect();
 		}
+	} else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+		wifi_event_sta_connected_t *data =
+			(wifi_event_sta_connected_t *)event_data;
+
+		fast_rejoin_channel = data->channel;
+		memcpy(fast_rejoin_bssid, data->bssid, 6);
+		fast_rejoin_valid = true;
 	} else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
 		wifi_event_sta_disconnected_t *data =
 			(wifi_event_sta_disconnected_t *)event_data;
@@ -398,7 +731,26 @@ void comm_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t eve
 		LED_RED_OFF();
 
 		if (will_reconnect) {
-			STORED_LOGF("reconnecting to network...");
+			if (reconnect_t_start == 0) {
+				reconnect_t_start = esp_timer_get_time();
+			} else {
+				// A previous attempt failed without getting an IP.
+				fast_rejoin_fails++;
+				if (fast_rejoin_fails >= FAST_REJOIN_MAX_FAILS && fast_rejoin_valid) {
+					STORED_LOGF("dropping fast-rejoin cache after %d failed attempts",
+							fast_rejoin_fails);
+					fast_rejoin_valid = false;
+					apply_sta_config(false);
+				}
+			}
+
+			STORED_LOGF("reconnecting to network... (fast rejoin: %s)",
+					utils_bool_to_str(fast_rejoin_valid));
+
+			if (fast_rejoin_valid) {
+				apply_sta_config(true);
+			}
+
 			is_connecting    = true;
 			esp_err_t result = esp_wifi_connect();
 			if (result != ESP_OK) {
@@ -433,6 +785,15 @@ void comm_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t eve
 			}
 		}
 		
+		if (reconnect_t_start != 0) {
+			reconnect_time_last_ms =
+					(esp_timer_get_time() - reconnect_t_start) / 1000;
+			reconnect_t_start = 0;
+			reconnect_cnt++;
+			STORED_LOGF("reconnect took %lu ms", reconnect_time_last_ms);
+		}
+		fast_rejoin_fails = 0;
+
 		is_connecting = false;
 		is_connected = true;
 		LED_RED_ON();
@@ -445,29 +806,144 @@ void comm_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t eve
 }
 
 void comm_wifi_send_packet_local(unsigned char *data, unsigned int len) {
-	packet_send_packet(data, len, comm_local.packet);
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (comm_local[i].socket >= 0) {
+			packet_send_packet(data, len, comm_local[i].packet);
+		}
+	}
 }
 
 void comm_wifi_send_packet_hub(unsigned char *data, unsigned int len) {
 	packet_send_packet(data, len, comm_hub.packet);
 }
 
-#define SEND_RAW_MAX_RETRIES 100
+void comm_wifi_send_packet_udp(unsigned char *data, unsigned int len) {
+	packet_send_packet(data, len, comm_udp.packet);
+}
 
-void comm_wifi_send_raw_local(unsigned char *buffer, unsigned int len) {
-	if (comm_local.socket < 0) {
-		return;
+uint32_t comm_wifi_get_udp_seq_drops(void) {
+	return udp_seq_drops;
+}
+
+uint32_t comm_wifi_get_reconnect_cnt(void) {
+	return reconnect_cnt;
+}
+
+uint32_t comm_wifi_get_reconnect_time_last_ms(void) {
+	return reconnect_time_last_ms;
+}
+
+static void link_stats_timer_cb(void *arg) {
+	(void)arg;
+
+	if (is_connected &&
+			(wifi_mode == WIFI_MODE_STATION || wifi_mode == WIFI_MODE_APSTA_CUSTOM)) {
+		wifi_ap_record_t ap_info;
+		if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+			link_rssi = ap_info.rssi;
+		}
+	} else {
+		link_rssi = 0;
+	}
+
+	uint32_t retries_win = link_tx_retries - link_tx_retries_last;
+	link_tx_retries_last = link_tx_retries;
+
+	float scale = link_scale;
+	if (retries_win > LINK_RETRY_HIGH ||
+			link_tx_block_max_us > LINK_BLOCK_HIGH_US ||
+			(link_rssi != 0 && link_rssi < LINK_RSSI_LOW)) {
+		scale *= 0.7;
+	} else {
+		scale *= 1.1;
+	}
+	utils_truncate_number(&scale, LINK_SCALE_MIN, 1.0);
+	link_scale = scale;
+
+	uint32_t delay = TX_COALESCE_DELAY_MS;
+	if (link_rate_ctrl_en) {
+		delay = (uint32_t)((float)TX_COALESCE_DELAY_MS / scale);
+		if (delay > TX_COALESCE_DELAY_MAX_MS) {
+			delay = TX_COALESCE_DELAY_MAX_MS;
+		}
+	}
+
+	if (delay != tx_coalesce_delay_ms) {
+		tx_coalesce_delay_ms = delay;
+		if (tx_flush_timer) {
+			esp_timer_restart(tx_flush_timer, (uint64_t)delay * 1000);
+		}
 	}
 
+	link_tx_block_max_us = 0;
+	link_coalesce_hw = 0;
+}
+
+void comm_wifi_link_stats_get(comm_wifi_link_stats *stats) {
+	stats->rssi = link_rssi;
+	stats->tx_cnt = link_tx_cnt;
+	stats->tx_retries = link_tx_retries;
+	stats->tx_fails = link_tx_fails;
+	stats->tx_block_max_us = link_tx_block_max_us;
+	stats->coalesce_hw = link_coalesce_hw;
+	stats->scale = link_scale;
+	stats->rate_ctrl_en = link_rate_ctrl_en;
+}
+
+float comm_wifi_link_scale(void) {
+	return link_scale;
+}
+
+void comm_wifi_link_rate_ctrl_set(bool en) {
+	link_rate_ctrl_en = en;
+}
+
+bool comm_wifi_link_rate_ctrl_get(void) {
+	return link_rate_ctrl_en;
+}
+
+void comm_wifi_link_stats_reset(void) {
+	link_tx_cnt = 0;
+	link_tx_retries = 0;
+	link_tx_fails = 0;
+	link_tx_retries_last = 0;
+	link_tx_block_max_us = 0;
+	link_coalesce_hw = 0;
+	link_scale = 1.0;
+}
+
+void comm_wifi_print_link_stats(void) {
+	commands_printf("comm_wifi,rssi=%d", (int)link_rssi);
+	commands_printf("comm_wifi,tx_cnt=%lu", link_tx_cnt);
+	commands_printf("comm_wifi,tx_retries=%lu", link_tx_retries);
+	commands_printf("comm_wifi,tx_fails=%lu", link_tx_fails);
+	commands_printf("comm_wifi,tx_block_max_us=%lu", link_tx_block_max_us);
+	commands_printf("comm_wifi,coalesce_hw=%lu", link_coalesce_hw);
+	commands_printf("comm_wifi,udp_seq_drops=%lu", udp_seq_drops);
+	commands_printf("comm_wifi,reconnects=%lu", reconnect_cnt);
+	commands_printf("comm_wifi,scale=%.2f", (double)link_scale);
+	commands_printf("comm_wifi,rate_ctrl=%d", link_rate_ctrl_en);
+	commands_printf(" ");
+}
+
+#define SEND_RAW_MAX_RETRIES 100
+
+static void send_socket_blocking(int sock, unsigned char *buffer, unsigned int len) {
 	int error_cnt = 0;
+	int64_t t_send_start = esp_timer_get_time();
+
+	link_tx_cnt++;
 
 	int to_write = len;
 	while (to_write > 0) {
-		int written = send(comm_local.socket, buffer + (len - to_write), to_write, 0);
+		int written = send(sock, buffer + (len - to_write), to_write, 0);
 		if (written < 0) {
 			error_cnt++;
+			link_tx_retries++;
+			coex_stats_note_denial(COEX_RADIO_WIFI);
 
 			if (error_cnt > SEND_RAW_MAX_RETRIES) {
+				link_tx_fails++;
 				return;
 			}
 
@@ -477,31 +953,105 @@ void comm_wifi_send_raw_local(unsigned char *buffer, unsigned int len) {
 
 		to_write -= written;
 	}
+
+	uint32_t block_us = esp_timer_get_time() - t_send_start;
+	if (block_us > link_tx_block_max_us) {
+		link_tx_block_max_us = block_us;
+	}
+
+	coex_stats_note_grant(COEX_RADIO_WIFI);
+	coex_stats_note_tx_time(COEX_RADIO_WIFI, block_us / 1000);
 }
 
-void comm_wifi_send_raw_hub(unsigned char *buffer, unsigned int len) {
-	if (comm_hub.socket < 0) {
+// Must be called with tx_mutex held.
+static void tx_flush_locked(comm_state *comm) {
+	if (comm->tx_len > 0 && comm->socket >= 0) {
+		send_socket_blocking(comm->socket, comm->tx_buf, comm->tx_len);
+	}
+	comm->tx_len = 0;
+}
+
+static void send_coalesced(comm_state *comm, unsigned char *buffer, unsigned int len) {
+	if (comm->socket < 0) {
 		return;
 	}
 
-	int error_cnt = 0;
+	xSemaphoreTake(comm->tx_mutex, portMAX_DELAY);
 
-	int to_write = len;
-	while (to_write > 0) {
-		int written = send(comm_hub.socket, buffer + (len - to_write), to_write, 0);
-		if (written < 0) {
-			error_cnt++;
+	if ((comm->tx_len + (int)len) > TX_COALESCE_BUF_SIZE) {
+		tx_flush_locked(comm);
+	}
 
-			if (error_cnt > SEND_RAW_MAX_RETRIES) {
-				return;
+	if (len >= TX_COALESCE_BUF_SIZE) {
+		// Too large to coalesce, send directly
+		send_socket_blocking(comm->socket, buffer, len);
+	} else {
+		memcpy(comm->tx_buf + comm->tx_len, buffer, len);
+		comm->tx_len += len;
+
+		if ((uint32_t)comm->tx_len > link_coalesce_hw) {
+			link_coalesce_hw = comm->tx_len;
+		}
+	}
+
+	xSemaphoreGive(comm->tx_mutex);
+}
+
+static void tx_flush_timer_cb(void *arg) {
+	(void)arg;
+	xSemaphoreGive(tx_flush_sem);
+}
+
+static void tx_flush_task(void *arg) {
+	for (;;) {
+		xSemaphoreTake(tx_flush_sem, portMAX_DELAY);
+
+		// Visit every client each round so one busy stream cannot starve
+		// the others of TX time.
+		for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+			if (comm_local[i].tx_mutex && comm_local[i].tx_len > 0) {
+				xSemaphoreTake(comm_local[i].tx_mutex, portMAX_DELAY);
+				tx_flush_locked(&comm_local[i]);
+				xSemaphoreGive(comm_local[i].tx_mutex);
 			}
+		}
 
-			vTaskDelay(1);
-			continue;
+		if (comm_hub.tx_mutex && comm_hub.tx_len > 0) {
+			xSemaphoreTake(comm_hub.tx_mutex, portMAX_DELAY);
+			tx_flush_locked(&comm_hub);
+			xSemaphoreGive(comm_hub.tx_mutex);
 		}
+	}
 
-		to_write -= written;
+	vTaskDelete(NULL);
+}
+
+void comm_wifi_send_raw_local(unsigned char *buffer, unsigned int len) {
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (comm_local[i].socket >= 0) {
+			send_coalesced(&comm_local[i], buffer, len);
+		}
+	}
+}
+
+comm_wifi_send_func_t comm_wifi_raw_func_for(comm_wifi_send_func_t packet_func) {
+	if (packet_func == comm_wifi_send_packet_local) {
+		return comm_wifi_send_raw_local;
+	} else if (packet_func == comm_wifi_send_packet_hub) {
+		return comm_wifi_send_raw_hub;
+	}
+
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (packet_func == send_packet_local_fns[i]) {
+			return send_raw_local_fns[i];
+		}
 	}
+
+	return 0;
+}
+
+void comm_wifi_send_raw_hub(unsigned char *buffer, unsigned int len) {
+	send_coalesced(&comm_hub, buffer, len);
 }
 
 void comm_wifi_init(void) {
@@ -675,18 +1225,49 @@ void comm_wifi_init(void) {
 	esp_wifi_start();
 
 	if (backup.config.use_tcp_local) {
-		comm_local.packet = calloc(1, sizeof(PACKET_STATE_t));
-		packet_init(comm_wifi_send_raw_local, process_packet_local, comm_local.packet);
+		for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+			comm_local[i].packet = heap_track_calloc("wifi_packet", 1, sizeof(PACKET_STATE_t));
+			comm_local[i].tx_mutex = xSemaphoreCreateMutex();
+			packet_init(send_raw_local_fns[i], process_packet_local_fns[i], comm_local[i].packet);
+		}
 		xTaskCreatePinnedToCore(tcp_task_local, "tcp_local", 3500, NULL, 8, NULL, tskNO_AFFINITY);
 	}
 
 	if (backup.config.use_tcp_hub) {
-		comm_hub.packet = calloc(1, sizeof(PACKET_STATE_t));
+		comm_hub.packet = heap_track_calloc("wifi_packet", 1, sizeof(PACKET_STATE_t));
+		comm_hub.tx_mutex = xSemaphoreCreateMutex();
 		packet_init(comm_wifi_send_raw_hub, process_packet_hub, comm_hub.packet);
 		xTaskCreatePinnedToCore(tcp_task_hub, "tcp_hub", 3500, NULL, 8, NULL, tskNO_AFFINITY);
 	}
 
+	if (backup.config.use_tcp_local || backup.config.use_tcp_hub) {
+		tx_flush_sem = xSemaphoreCreateBinary();
+		xTaskCreatePinnedToCore(tx_flush_task, "tcp_flush", 2048, NULL, 8, NULL, tskNO_AFFINITY);
+
+		const esp_timer_create_args_t flush_timer_args = {
+				.callback = tx_flush_timer_cb,
+				.name = "tcp_flush"};
+		esp_timer_create(&flush_timer_args, &tx_flush_timer);
+		esp_timer_start_periodic(tx_flush_timer, (uint64_t)TX_COALESCE_DELAY_MS * 1000);
+	}
+
+	// The UDP transport is served next to the local TCP server; clients
+	// choose per stream by sending to the UDP port instead.
+	if (backup.config.use_tcp_local) {
+		comm_udp.packet = heap_track_calloc("wifi_packet", 1, sizeof(PACKET_STATE_t));
+		comm_udp.tx_mutex = xSemaphoreCreateMutex();
+		packet_init(udp_send_raw, process_packet_udp, comm_udp.packet);
+		xTaskCreatePinnedToCore(udp_task, "udp_local", 3500, NULL, 8, NULL, tskNO_AFFINITY);
+	}
+
 	xTaskCreatePinnedToCore(broadcast_task, "udp_multicast", 4096, NULL, 8, NULL, tskNO_AFFINITY);
+
+	const esp_timer_create_args_t link_timer_args = {
+			.callback = link_stats_timer_cb,
+			.name = "wifi_link"};
+	esp_timer_handle_t link_timer;
+	esp_timer_create(&link_timer_args, &link_timer);
+	esp_timer_start_periodic(link_timer, (uint64_t)LINK_STATS_PERIOD_MS * 1000);
 }
 
 WIFI_MODE comm_wifi_get_mode(void) {
@@ -698,15 +1279,23 @@ esp_ip4_addr_t comm_wifi_get_ip(void) {
 }
 
 esp_ip4_addr_t comm_wifi_get_ip_client(void) {
-	if (comm_local.socket > 0) {
-		return comm_local.ip_client;
-	} else {
-		return comm_hub.ip_client;
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (comm_local[i].socket > 0) {
+			return comm_local[i].ip_client;
+		}
 	}
+
+	return comm_hub.ip_client;
 }
 
 bool comm_wifi_is_client_connected(void) {
-	return comm_local.socket >= 0;
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (comm_local[i].socket >= 0) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 bool comm_wifi_is_connected_hub(void) {
@@ -722,10 +1311,12 @@ bool comm_wifi_is_connected(void) {
 }
 
 void comm_wifi_disconnect(void) {
-	if (comm_local.socket >= 0) {
-		shutdown(comm_local.socket, 0);
-		close(comm_local.socket);
-		comm_local.socket = -1;
+	for (int i = 0;i < TCP_LOCAL_CLIENT_MAX;i++) {
+		if (comm_local[i].socket >= 0) {
+			shutdown(comm_local[i].socket, 0);
+			close(comm_local[i].socket);
+			comm_local[i].socket = -1;
+		}
 	}
 
 	if (comm_hub.socket >= 0) {
@@ -767,6 +1358,11 @@ bool comm_wifi_reconnect_network() {
 	wifi_config_changed = true;
 	wifi_reconnect_disabled = false;
 
+	// The cached AP is likely not part of the new network.
+	fast_rejoin_valid = false;
+	fast_rejoin_fails = 0;
+	reconnect_t_start = 0;
+
 	{
 		STORED_LOGF("Reconnecting to configured network, ssid: '%s', password: '%s'", wifi_config.sta.ssid, wifi_config.sta.password);
 		esp_err_t result = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
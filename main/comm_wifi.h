@@ -150,10 +150,47 @@ bool comm_wifi_get_auto_reconnect();
 void comm_wifi_set_event_listener(comm_wifi_event_cb_t handler);
 void comm_wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 
+typedef void (*comm_wifi_send_func_t)(unsigned char *data, unsigned int len);
+
+// Sends to every connected local TCP client; per-client reply routing is
+// handled internally by the packet states of the client slots.
 void comm_wifi_send_packet_local(unsigned char *data, unsigned int len);
 void comm_wifi_send_packet_hub(unsigned char *data, unsigned int len);
 void comm_wifi_send_raw_local(unsigned char *buffer, unsigned int len);
 void comm_wifi_send_raw_hub(unsigned char *buffer, unsigned int len);
+void comm_wifi_send_packet_udp(unsigned char *data, unsigned int len);
+uint32_t comm_wifi_get_udp_seq_drops(void);
+uint32_t comm_wifi_get_reconnect_cnt(void);
+uint32_t comm_wifi_get_reconnect_time_last_ms(void);
+
+/*
+ * Link-quality statistics, sampled once per second. Counters are
+ * cumulative since boot (or reset); tx_block_max_us and coalesce_hw
+ * cover the current sample window. scale is the congestion controller
+ * output in [0.25, 1.0], always computed; rate_ctrl_en says whether it
+ * is also applied to the TX coalescing flush period.
+ */
+typedef struct {
+	int8_t rssi;
+	uint32_t tx_cnt;
+	uint32_t tx_retries;
+	uint32_t tx_fails;
+	uint32_t tx_block_max_us;
+	uint32_t coalesce_hw;
+	float scale;
+	bool rate_ctrl_en;
+} comm_wifi_link_stats;
+
+void comm_wifi_link_stats_get(comm_wifi_link_stats *stats);
+float comm_wifi_link_scale(void);
+void comm_wifi_link_rate_ctrl_set(bool en);
+bool comm_wifi_link_rate_ctrl_get(void);
+void comm_wifi_link_stats_reset(void);
+void comm_wifi_print_link_stats(void);
+
+// Raw (pre-framed) counterpart of a wifi packet send function, including
+// the internal per-client ones. 0 when func is not a wifi transport.
+comm_wifi_send_func_t comm_wifi_raw_func_for(comm_wifi_send_func_t packet_func);
 
 
 // Utility functions
@@ -24,17 +24,21 @@
 #include <dirent.h>
 
 #include "comm_usb.h"
+#include "comm_uart.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "commands.h"
 #include "datatypes.h"
 #include "conf_general.h"
 #include "comm_can.h"
+#include "coex_stats.h"
 #include "terminal.h"
 #include "mempools.h"
 #include "utils.h"
+#include "rb.h"
 
 #ifdef OVR_CONF_PARSER_H
 #include OVR_CONF_PARSER_H
@@ -53,15 +57,23 @@
 #include "buffer.h"
 #include "main.h"
 #include "crc.h"
+#include "comm_ble.h"
 #include "comm_wifi.h"
 // #include "debug_wifi.h"  // DISABLED: WiFi debug components causing memory pressure
 #include "log.h"
 #include "nmea.h"
+#include "odometry.h"
 #include "lispif.h"
+#include "lbm_bench.h"
 #include "flash_helper.h"
 #include "bms.h"
 #include "imu.h"
+#include "stats.h"
+#include "task_stats.h"
+#include "perf.h"
+#include "pkt_trace.h"
 
+#include "esp_cpu.h"
 #include "esp_efuse.h"
 #include "esp_efuse_table.h"
 #include "esp_vfs_fat.h"
@@ -70,6 +82,7 @@
 #include "esp_partition.h"
 #include "esp_ota_ops.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
 #include "soc/rtc.h"
 #ifdef CONFIG_BT_ENABLED
 #ifdef CONFIG_BT_ENABLED
@@ -84,26 +97,116 @@
 // Settings
 #define PRINT_BUFFER_SIZE	400
 
+/*
+ * Buffered print accumulators. Each printf call appends its line here
+ * instead of sending its own packet, so chatty diagnostic output from
+ * terminal commands and scripts batches into full packets instead of a
+ * storm of tiny ones. An accumulator is flushed when the next line does
+ * not fit, when the short flush timer expires, or explicitly through
+ * commands_printf_flush after a terminal command. Terminal and LispBM
+ * prints keep separate accumulators since their packet ids differ.
+ */
+#define PRINT_FLUSH_DELAY_MS	20
+
+typedef struct {
+	uint8_t buf[PRINT_BUFFER_SIZE];
+	int len;
+} print_acc_t;
+
 // For double precision literals
 #define D(x) 						((double)x##L)
 
+// Per-command statistics, indexed by COMM_PACKET_ID.
+typedef struct {
+	uint32_t cnt;
+	uint64_t cycles;
+	uint32_t cycles_max;
+} cmd_stats_t;
+
 // Private variables
 static SemaphoreHandle_t print_mutex;
 static bool init_done = false;
 
+static print_acc_t print_acc_term = {.buf = {COMM_PRINT}, .len = 1};
+static print_acc_t print_acc_lisp = {.buf = {COMM_LISP_PRINT}, .len = 1};
+static esp_timer_handle_t print_flush_timer = NULL;
+static volatile bool print_flush_armed = false;
+
+static void print_flush_timeout(void *arg);
+
+/*
+ * Deferred diagnostic log. Producers on timing-sensitive paths enqueue
+ * only a format-string pointer and raw argument words; a low-priority
+ * task formats and ships the lines through commands_printf later. An
+ * enqueue is a ring write inside a short critical section, cheap enough
+ * to leave enabled in production code like the CAN decode and sensor
+ * paths. The format string must be a literal (it is stored by pointer)
+ * and may use up to four 32-bit integer conversions. When the ring is
+ * full the entry is dropped and counted rather than blocking the
+ * producer.
+ */
+#define DEFERRED_LOG_LEN		64
+#define DEFERRED_LOG_DRAIN_MS	100
+
+typedef struct {
+	const char *fmt;
+	uint32_t args[4];
+} deferred_log_entry_t;
+
+static deferred_log_entry_t deferred_log_buf[DEFERRED_LOG_LEN];
+static rb_spsc_t deferred_log_rb =
+		{ deferred_log_buf, 0, 0, sizeof(deferred_log_entry_t), DEFERRED_LOG_LEN };
+static volatile uint32_t deferred_log_drops = 0;
+// Serializes producers; the drain task is the only consumer, so the
+// ring stays within its single-producer single-consumer contract.
+static portMUX_TYPE deferred_log_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Dispatch table indexed by packet id. Entries that are 0 fall back to
+// the switch in commands_process_packet, so handlers can be broken out
+// or overridden one at a time without touching the dispatcher.
+static commands_handler_t dispatch_table[COMM_PACKET_ID_NUM] = {0};
+static cmd_stats_t cmd_stats[COMM_PACKET_ID_NUM] = {0};
+
 static const esp_partition_t *update_partition = NULL;
 static esp_ota_handle_t update_handle = 0;
 
+// Running image mapping for delta updates. Mapped on the first
+// COMM_WRITE_NEW_APP_DELTA and kept for the rest of the session.
+static const void *running_partition_data = NULL;
+static uint32_t running_partition_size = 0;
+static esp_partition_mmap_handle_t running_partition_handle = 0;
+
 // Function pointers
 static send_func_t send_func = 0;
 static send_func_t send_func_can_fwd = 0;
-static send_func_t send_func_blocking = 0;
+static send_func_t send_func_can_fwd_raw = 0;
+
+/*
+ * Worker pool for slow command handlers. Flagged commands (flash
+ * erase, CAN-wide scans, terminal commands) are copied into a pool
+ * buffer and queued; the workers process them and reply on completion,
+ * so a multi-second operation no longer blocks the other commands on
+ * the same transport. Handlers that share non-reentrant state
+ * serialize on the per-class mutexes below.
+ */
+#define CMD_WORKER_NUM			2
+#define CMD_WORKER_QUEUE_LEN	4
+
+typedef struct {
+	uint8_t *data;
+	unsigned int len;
+	send_func_t reply_func;
+} cmd_worker_job_t;
 
-// Blocking thread
-static SemaphoreHandle_t block_sem;
-static uint8_t blocking_thread_cmd_buffer[PACKET_MAX_PL_LEN];
-static volatile unsigned int blocking_thread_cmd_len = 0;
-static volatile bool is_blocking = false;
+static QueueHandle_t worker_queue;
+static SemaphoreHandle_t worker_term_mutex;
+static SemaphoreHandle_t worker_can_mutex;
+
+// Ring of the most recent packet ids seen by the dispatcher, newest
+// first. Feeds the persistent perf snapshots so a post-reset dump can
+// show what the device was asked to do right before it died.
+#define LAST_PKT_ID_NUM			4
+static volatile uint8_t m_last_pkt_ids[LAST_PKT_ID_NUM] = {0};
 
 #if LOGS_ENABLED
 volatile send_func_t stored_send_func;
@@ -135,73 +238,390 @@ static void send_func_dummy(unsigned char *data, unsigned int len) {
 	(void)data; (void)len;
 }
 
-static void block_task(void *arg) {
-	for (;;) {
-		is_blocking = false;
+// Raw (pre-framed) send function of a transport, or 0 when the
+// transport has no zero-copy path.
+static send_func_t send_func_raw_for(send_func_t func) {
+	return comm_wifi_raw_func_for(func);
+}
+
+/*
+ * Per-request bump arena for reply construction. A handler gets scratch
+ * memory with commands_arena_alloc and never frees it; the whole arena
+ * is torn down when commands_process_packet returns. The backing buffer
+ * is taken lazily from the large mempools class, so requests that never
+ * allocate pay nothing. Arenas are keyed on the calling task, which
+ * gives independent transports independent arenas instead of
+ * serializing them on a shared static buffer.
+ */
 
-		xSemaphoreTake(block_sem, portMAX_DELAY);
+#define CMD_ARENA_NUM			6
 
-		uint8_t *data = blocking_thread_cmd_buffer;
-		unsigned int len = blocking_thread_cmd_len;
+typedef struct {
+	TaskHandle_t volatile task;
+	uint8_t *buf;
+	unsigned int used;
+	int depth;
+} cmd_arena_t;
 
-		COMM_PACKET_ID packet_id;
-		static uint8_t send_buffer[512];
+static cmd_arena_t cmd_arenas[CMD_ARENA_NUM];
 
-		packet_id = data[0];
-		data++;
-		len--;
+static cmd_arena_t *arena_for_task(TaskHandle_t task) {
+	for (int i = 0;i < CMD_ARENA_NUM;i++) {
+		if (cmd_arenas[i].task == task) {
+			return &cmd_arenas[i];
+		}
+	}
 
-		switch (packet_id) {
-		case COMM_PING_CAN: {
-			int32_t ind = 0;
-			send_buffer[ind++] = COMM_PING_CAN;
+	return 0;
+}
 
-			for (uint8_t i = 0;i < 255;i++) {
-				HW_TYPE hw_type;
-				if (comm_can_ping(i, &hw_type)) {
-					send_buffer[ind++] = i;
-				}
+static void arena_begin(void) {
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+	cmd_arena_t *a = arena_for_task(task);
+	if (a) {
+		a->depth++;
+		return;
+	}
+
+	for (int i = 0;i < CMD_ARENA_NUM;i++) {
+		TaskHandle_t expected = 0;
+		if (__atomic_compare_exchange_n(&cmd_arenas[i].task, &expected, task,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			cmd_arenas[i].buf = 0;
+			cmd_arenas[i].used = 0;
+			cmd_arenas[i].depth = 1;
+			return;
+		}
+	}
+
+	// All slots taken; commands_arena_alloc returns NULL for this
+	// request, which callers have to handle anyway.
+}
+
+static void arena_end(void) {
+	cmd_arena_t *a = arena_for_task(xTaskGetCurrentTaskHandle());
+	if (!a || --a->depth > 0) {
+		return;
+	}
+
+	if (a->buf) {
+		mempools_free_packet_buffer(a->buf);
+		a->buf = 0;
+	}
+
+	a->used = 0;
+	__atomic_store_n(&a->task, (TaskHandle_t)0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Allocate reply scratch memory that lives until the current command
+ * has been processed. Only valid while a command handler is running.
+ * Returns NULL when the arena is exhausted, so callers must check.
+ */
+uint8_t *commands_arena_alloc(unsigned int size) {
+	cmd_arena_t *a = arena_for_task(xTaskGetCurrentTaskHandle());
+	if (!a) {
+		return 0;
+	}
+
+	if (!a->buf) {
+		a->buf = mempools_get_packet_buffer();
+		a->used = 0;
+	}
+
+	unsigned int size_al = (size + 3) & ~3U;
+	if (a->used + size_al > PACKET_MAX_PL_LEN) {
+		return 0;
+	}
+
+	uint8_t *res = a->buf + a->used;
+	a->used += size_al;
+	return res;
+}
+
+/*
+ * COMM_MULTI_CMD batching. One payload carries several concatenated
+ * sub-packets that are processed in order with their replies collected
+ * into a single response, so clients on high-latency links get e.g.
+ * values + IMU + BMS in one round trip instead of three. The capture
+ * state is guarded by batch_mutex and only appended to from the
+ * batching task itself, which keeps timer-driven print flushes and
+ * other tasks from racing the capture buffer.
+ */
+static SemaphoreHandle_t batch_mutex;
+static uint8_t *batch_buffer = 0;
+static int32_t batch_pos = 0;
+static uint8_t batch_sub_ind = 0;
+static volatile TaskHandle_t batch_task_handle = 0;
+
+static void batch_capture_send(unsigned char *data, unsigned int len) {
+	if (xTaskGetCurrentTaskHandle() != batch_task_handle || !batch_buffer) {
+		return;
+	}
+
+	if ((batch_pos + 3 + (int32_t)len) > PACKET_MAX_PL_LEN) {
+		return;
+	}
+
+	batch_buffer[batch_pos++] = batch_sub_ind;
+	buffer_append_uint16(batch_buffer, len, &batch_pos);
+	memcpy(batch_buffer + batch_pos, data, len);
+	batch_pos += len;
+}
+
+/*
+ * Bandwidth self-test state, one session at a time. The client streams
+ * sized COMM_BANDWIDTH_TEST packets over the transport under test and
+ * polls the report. Loss comes from sequence-number gaps, throughput
+ * from byte and time counters, and the inter-arrival histogram bounds
+ * device-side delivery jitter. Echo mode returns the payload unchanged
+ * so the client measures round-trip latency percentiles on its side.
+ */
+#define BW_TEST_HIST_LEN		6
+
+static uint32_t bw_packets = 0;
+static uint32_t bw_bytes = 0;
+static uint32_t bw_lost = 0;
+static uint32_t bw_seq_last = 0;
+static bool bw_seq_valid = false;
+static int64_t bw_time_first = 0;
+static int64_t bw_time_last = 0;
+static uint32_t bw_ia_min = 0;
+static uint32_t bw_ia_max = 0;
+static uint64_t bw_ia_sum = 0;
+// Inter-arrival buckets: <1, <2, <5, <10, <20 and >=20 ms
+static uint32_t bw_ia_hist[BW_TEST_HIST_LEN];
+
+static void bw_test_reset(void) {
+	bw_packets = 0;
+	bw_bytes = 0;
+	bw_lost = 0;
+	bw_seq_valid = false;
+	bw_time_first = 0;
+	bw_time_last = 0;
+	bw_ia_min = 0;
+	bw_ia_max = 0;
+	bw_ia_sum = 0;
+	memset(bw_ia_hist, 0, sizeof(bw_ia_hist));
+}
+
+static void bw_test_sample(uint32_t seq, unsigned int len) {
+	int64_t now = esp_timer_get_time();
+
+	if (bw_seq_valid && seq > (bw_seq_last + 1)) {
+		bw_lost += seq - bw_seq_last - 1;
+	}
+	bw_seq_last = seq;
+	bw_seq_valid = true;
+
+	if (bw_packets == 0) {
+		bw_time_first = now;
+	} else {
+		uint32_t ia = (uint32_t)(now - bw_time_last);
+		if (bw_ia_min == 0 || ia < bw_ia_min) {
+			bw_ia_min = ia;
+		}
+		if (ia > bw_ia_max) {
+			bw_ia_max = ia;
+		}
+		bw_ia_sum += ia;
+
+		int bucket;
+		if (ia < 1000) {
+			bucket = 0;
+		} else if (ia < 2000) {
+			bucket = 1;
+		} else if (ia < 5000) {
+			bucket = 2;
+		} else if (ia < 10000) {
+			bucket = 3;
+		} else if (ia < 20000) {
+			bucket = 4;
+		} else {
+			bucket = 5;
+		}
+		bw_ia_hist[bucket]++;
+	}
+
+	bw_time_last = now;
+	bw_packets++;
+	bw_bytes += len;
+}
+
+static void process_slow_cmd(uint8_t *data, unsigned int len,
+		send_func_t reply_func) {
+	COMM_PACKET_ID packet_id;
+	uint8_t send_buffer[256];
+
+	packet_id = data[0];
+	data++;
+	len--;
+
+	switch (packet_id) {
+	case COMM_PING_CAN: {
+		// Concurrent ping scans would interleave their CAN replies, so
+		// the CAN-wide slow commands serialize on one mutex.
+		xSemaphoreTake(worker_can_mutex, portMAX_DELAY);
+
+		int32_t ind = 0;
+		send_buffer[ind++] = COMM_PING_CAN;
+
+		for (uint8_t i = 0;i < 255;i++) {
+			HW_TYPE hw_type;
+			if (comm_can_ping(i, &hw_type)) {
+				send_buffer[ind++] = i;
 			}
+		}
 
-			if (send_func_blocking) {
-				send_func_blocking(send_buffer, ind);
+		xSemaphoreGive(worker_can_mutex);
+
+		if (reply_func) {
+			reply_func(send_buffer, ind);
+		}
+	} break;
+
+	case COMM_TERMINAL_CMD:
+		// terminal_process_string is not reentrant (strtok, static
+		// task-stat state), so terminal commands serialize.
+		xSemaphoreTake(worker_term_mutex, portMAX_DELAY);
+		data[len] = '\0';
+		terminal_process_string((char*)data);
+		// Deliver the command output right away instead of waiting
+		// for the timed flush.
+		commands_printf_flush();
+		xSemaphoreGive(worker_term_mutex);
+		break;
+
+	case COMM_CAN_UPDATE_BAUD_ALL: {
+		xSemaphoreTake(worker_can_mutex, portMAX_DELAY);
+
+		int32_t ind = 0;
+		uint32_t kbits = buffer_get_int16(data, &ind);
+		uint32_t delay_msec = buffer_get_int16(data, &ind);
+		CAN_BAUD baud = comm_can_kbits_to_baud(kbits);
+		if (baud != CAN_BAUD_INVALID) {
+			for (int i = 0; i < 10; i++) {
+				comm_can_send_update_baud(kbits, delay_msec);
+				vTaskDelay(50 / portTICK_PERIOD_MS);
 			}
-		} break;
 
-		case COMM_TERMINAL_CMD:
-			data[len] = '\0';
-			terminal_process_string((char*)data);
-			break;
+			backup.config.can_baud_rate = baud;
+			main_store_backup_data();
+			comm_can_update_baudrate(delay_msec);
+		}
 
-		case COMM_CAN_UPDATE_BAUD_ALL: {
-			int32_t ind = 0;
-			uint32_t kbits = buffer_get_int16(data, &ind);
-			uint32_t delay_msec = buffer_get_int16(data, &ind);
-			CAN_BAUD baud = comm_can_kbits_to_baud(kbits);
-			if (baud != CAN_BAUD_INVALID) {
-				for (int i = 0; i < 10; i++) {
-					comm_can_send_update_baud(kbits, delay_msec);
-					vTaskDelay(50 / portTICK_PERIOD_MS);
-				}
+		xSemaphoreGive(worker_can_mutex);
+
+		ind = 0;
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = baud != CAN_BAUD_INVALID;
+		if (reply_func) {
+			reply_func(send_buffer, ind);
+		}
+	}
+		break;
 
-				backup.config.can_baud_rate = baud;
-				main_store_backup_data();
-				comm_can_update_baudrate(delay_msec);
+	case COMM_LISP_BENCH: {
+		// Optional [u8 index] selects one benchmark, 255 or absent runs
+		// all. One reply per benchmark:
+		// [u8 ind][u8 ok][u32 eval_us][u32 steps][u32 steps_per_sec]
+		// [u32 gc_num][u32 gc_time_us][name], then [255] when done.
+		int bench_sel = 255;
+		if (len >= 1) {
+			bench_sel = data[0];
+		}
+
+		for (int i = 0;i < lbm_bench_num();i++) {
+			if (bench_sel != 255 && i != bench_sel) {
+				continue;
 			}
 
-			ind = 0;
+			lbm_bench_result res;
+			if (!lbm_bench_run(i, &res)) {
+				continue;
+			}
+
+			int32_t ind = 0;
 			send_buffer[ind++] = packet_id;
-			send_buffer[ind++] = baud != CAN_BAUD_INVALID;
-			if (send_func_blocking) {
-				send_func_blocking(send_buffer, ind);
+			send_buffer[ind++] = i;
+			send_buffer[ind++] = res.ok;
+			buffer_append_uint32(send_buffer, res.eval_us, &ind);
+			buffer_append_uint32(send_buffer, res.steps, &ind);
+			buffer_append_uint32(send_buffer, res.steps_per_sec, &ind);
+			buffer_append_uint32(send_buffer, res.gc_num, &ind);
+			buffer_append_uint32(send_buffer, res.gc_time_us, &ind);
+			buffer_append_str_max_len(send_buffer, (char*)lbm_bench_name(i), 25, &ind);
+
+			if (reply_func) {
+				reply_func(send_buffer, ind);
 			}
 		}
-			break;
 
-		default:
-			break;
+		// Put the stored script back after benching in a clean env.
+		lispif_restart(false, true, true);
+
+		int32_t ind = 0;
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = 255;
+		if (reply_func) {
+			reply_func(send_buffer, ind);
+		}
+	} break;
+
+	case COMM_ERASE_NEW_APP: {
+		int32_t ind = 0;
+
+		if (update_handle != 0) {
+			esp_ota_abort(update_handle);
+			update_handle = 0;
+		}
+
+		update_partition = esp_ota_get_next_update_partition(NULL);
+		bool ok = false;
+		if (update_partition != NULL) {
+			esp_err_t res = esp_ota_begin(update_partition, buffer_get_uint32(data, &ind) - 6, &update_handle);
+			ok = res == ESP_OK;
+		}
+
+		ind = 0;
+		send_buffer[ind++] = COMM_ERASE_NEW_APP;
+		send_buffer[ind++] = ok;
+		if (reply_func) {
+			reply_func(send_buffer, ind);
 		}
+	} break;
+
+	default:
+		break;
+	}
+}
+
+static void worker_task(void *arg) {
+	(void)arg;
 
+	for (;;) {
+		cmd_worker_job_t job;
+		if (xQueueReceive(worker_queue, &job, portMAX_DELAY) == pdTRUE) {
+			process_slow_cmd(job.data, job.len, job.reply_func);
+			mempools_free_any(job.data);
+		}
+	}
+
+	vTaskDelete(NULL);
+}
+
+static void deferred_log_task(void *arg) {
+	(void)arg;
+
+	for (;;) {
+		deferred_log_entry_t e;
+
+		while (rb_spsc_pop(&deferred_log_rb, &e)) {
+			commands_printf(e.fmt, e.args[0], e.args[1], e.args[2], e.args[3]);
+		}
+
+		vTaskDelay(DEFERRED_LOG_DRAIN_MS / portTICK_PERIOD_MS);
 	}
 
 	vTaskDelete(NULL);
@@ -209,8 +629,23 @@ static void block_task(void *arg) {
 
 void commands_init(void) {
 	print_mutex = xSemaphoreCreateMutex();
-	block_sem = xSemaphoreCreateBinary();
-	xTaskCreatePinnedToCore(block_task, "comm_block", 2500, NULL, 7, NULL, tskNO_AFFINITY);
+	worker_queue = xQueueCreate(CMD_WORKER_QUEUE_LEN, sizeof(cmd_worker_job_t));
+	worker_term_mutex = xSemaphoreCreateMutex();
+	worker_can_mutex = xSemaphoreCreateMutex();
+	batch_mutex = xSemaphoreCreateMutex();
+
+	const esp_timer_create_args_t flush_timer_args = {
+		.callback = print_flush_timeout,
+		.name = "print_flush",
+	};
+	esp_timer_create(&flush_timer_args, &print_flush_timer);
+
+	for (int i = 0;i < CMD_WORKER_NUM;i++) {
+		xTaskCreatePinnedToCore(worker_task, "comm_worker", 3000, NULL, 7, NULL, tskNO_AFFINITY);
+	}
+
+	xTaskCreatePinnedToCore(deferred_log_task, "log_defer", 2560, NULL, 1, NULL, tskNO_AFFINITY);
+
 	init_done = true;
 }
 
@@ -235,6 +670,7 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 
 	if (!send_func_can_fwd) {
 		send_func_can_fwd = reply_func;
+		send_func_can_fwd_raw = send_func_raw_for(reply_func);
 	}
 
 	// Avoid calling invalid function pointer if it is null.
@@ -242,6 +678,29 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		reply_func = send_func_dummy;
 	}
 
+	uint32_t cycles_start = esp_cpu_get_cycle_count();
+
+	for (int i = LAST_PKT_ID_NUM - 1;i > 0;i--) {
+		m_last_pkt_ids[i] = m_last_pkt_ids[i - 1];
+	}
+	m_last_pkt_ids[0] = packet_id;
+
+	pkt_trace_stage(PKT_TRACE_DISPATCH);
+
+	arena_begin();
+
+	// O(1) dispatch for registered handlers. Unregistered ids take the
+	// switch below.
+	if (packet_id < COMM_PACKET_ID_NUM && dispatch_table[packet_id]) {
+		PERF_ENTER(cmd_dispatch);
+		dispatch_table[packet_id](data, len, reply_func);
+		PERF_EXIT(cmd_dispatch);
+		commands_update_stats(packet_id, cycles_start);
+		arena_end();
+		pkt_trace_stage(PKT_TRACE_HANDLER);
+		return;
+	}
+
 	switch (packet_id) {
 	case COMM_FW_VERSION: {
 		int32_t ind = 0;
@@ -320,48 +779,99 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		}
 		break;
 
-	case COMM_ERASE_NEW_APP: {
+	case COMM_WRITE_NEW_APP_DATA: {
 		int32_t ind = 0;
+		uint32_t new_app_offset = buffer_get_uint32(data, &ind);
 
-		if (update_handle != 0) {
-			esp_ota_abort(update_handle);
-			update_handle = 0;
+		if (new_app_offset < 6) {
+			ind += (6 - new_app_offset); // Skip size and crc
+			new_app_offset = 0;
+		} else {
+			new_app_offset -= 6;
 		}
 
-		update_partition = esp_ota_get_next_update_partition(NULL);
 		bool ok = false;
-		if (update_partition != NULL) {
-			esp_err_t res = esp_ota_begin(update_partition, buffer_get_uint32(data, &ind) - 6, &update_handle);
+		if (update_handle != 0) {
+			esp_err_t res = esp_ota_write_with_offset(update_handle, data + ind, len - ind, new_app_offset);
 			ok = res == ESP_OK;
 		}
 
 		ind = 0;
 		uint8_t send_buffer[50];
-		send_buffer[ind++] = COMM_ERASE_NEW_APP;
+		send_buffer[ind++] = COMM_WRITE_NEW_APP_DATA;
 		send_buffer[ind++] = ok;
+		buffer_append_uint32(send_buffer, new_app_offset, &ind);
 		reply_func(send_buffer, ind);
 	} break;
 
-	case COMM_WRITE_NEW_APP_DATA: {
+	// Delta update. The packet carries the output offset followed by a
+	// stream of ops that reconstruct the new image: 0 is a literal
+	// (uint16 length + bytes), 1 is a copy from the running image
+	// (uint32 source offset + uint32 length). Offsets are raw image
+	// offsets; the 6-byte size/crc prefix of COMM_WRITE_NEW_APP_DATA is
+	// not used here. Point releases are mostly copy ops, so a fraction
+	// of the image goes over the air.
+	case COMM_WRITE_NEW_APP_DELTA: {
 		int32_t ind = 0;
 		uint32_t new_app_offset = buffer_get_uint32(data, &ind);
 
-		if (new_app_offset < 6) {
-			ind += (6 - new_app_offset); // Skip size and crc
-			new_app_offset = 0;
-		} else {
-			new_app_offset -= 6;
+		bool ok = update_handle != 0;
+
+		if (ok && !running_partition_data) {
+			const esp_partition_t *running = esp_ota_get_running_partition();
+			if (running && esp_partition_mmap(running, 0, running->size,
+					ESP_PARTITION_MMAP_DATA, &running_partition_data,
+					&running_partition_handle) == ESP_OK) {
+				running_partition_size = running->size;
+			} else {
+				ok = false;
+			}
 		}
 
-		bool ok = false;
-		if (update_handle != 0) {
-			esp_err_t res = esp_ota_write_with_offset(update_handle, data + ind, len - ind, new_app_offset);
-			ok = res == ESP_OK;
+		while (ok && ind < (int32_t)len) {
+			uint8_t op = data[ind++];
+
+			if (op == 0) {
+				uint16_t dlen = buffer_get_uint16(data, &ind);
+				if ((uint32_t)ind + dlen > len) {
+					ok = false;
+					break;
+				}
+
+				ok = esp_ota_write_with_offset(update_handle,
+						data + ind, dlen, new_app_offset) == ESP_OK;
+				ind += dlen;
+				new_app_offset += dlen;
+			} else if (op == 1) {
+				uint32_t src = buffer_get_uint32(data, &ind);
+				uint32_t clen = buffer_get_uint32(data, &ind);
+
+				if (src + clen > running_partition_size) {
+					ok = false;
+					break;
+				}
+
+				// Copy through a RAM bounce buffer, as the flash cache
+				// (and with it the mapping) is disabled while the update
+				// partition is programmed.
+				uint8_t buf[256];
+				while (ok && clen > 0) {
+					uint32_t now = clen > sizeof(buf) ? sizeof(buf) : clen;
+					memcpy(buf, (const uint8_t*)running_partition_data + src, now);
+					ok = esp_ota_write_with_offset(update_handle,
+							buf, now, new_app_offset) == ESP_OK;
+					src += now;
+					clen -= now;
+					new_app_offset += now;
+				}
+			} else {
+				ok = false;
+			}
 		}
 
 		ind = 0;
 		uint8_t send_buffer[50];
-		send_buffer[ind++] = COMM_WRITE_NEW_APP_DATA;
+		send_buffer[ind++] = COMM_WRITE_NEW_APP_DELTA;
 		send_buffer[ind++] = ok;
 		buffer_append_uint32(send_buffer, new_app_offset, &ind);
 		reply_func(send_buffer, ind);
@@ -379,6 +889,7 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 
 	case COMM_FORWARD_CAN:
 		send_func_can_fwd = reply_func;
+		send_func_can_fwd_raw = send_func_raw_for(reply_func);
 		comm_can_send_buffer(data[0], data + 1, len - 1, 0);
 		break;
 
@@ -397,7 +908,8 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 	case COMM_GET_CUSTOM_CONFIG:
 	case COMM_GET_CUSTOM_CONFIG_DEFAULT:
 	case COMM_SET_CUSTOM_CONFIG:
-	case COMM_GET_CUSTOM_CONFIG_XML: {
+	case COMM_GET_CUSTOM_CONFIG_XML:
+	case COMM_MAIN_CONFIG_DELTA: {
 		conf_custom_process_cmd(data - 1, len + 1, reply_func);
 	} break;
 
@@ -410,7 +922,10 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		char *from = (char*)data + ind;
 		ind += strlen(from);
 
-		uint8_t *send_buffer_global = mempools_get_packet_buffer();
+		uint8_t *send_buffer_global = commands_arena_alloc(PACKET_MAX_PL_LEN);
+		if (!send_buffer_global) {
+			break;
+		}
 
 		ind = 0;
 		send_buffer_global[ind++] = packet_id;
@@ -476,10 +991,15 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		}
 
 		reply_func(send_buffer_global, ind);
-		mempools_free_packet_buffer(send_buffer_global);
 	} break;
 
 	case COMM_FILE_READ: {
+		// Chunked file pulls are the throughput-critical BLE case;
+		// ask for the bulk connection profile while they run.
+		if (reply_func == comm_ble_send_packet) {
+			comm_ble_note_bulk_transfer();
+		}
+
 		static FILE *f_last = 0;
 		static int32_t f_last_offset = 0;
 		static int32_t f_last_size = 0;
@@ -488,18 +1008,14 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		uint8_t *send_buffer = 0;
 		size_t send_size = 400;
 
-		void(*reply_func_raw)(unsigned char *data, unsigned int len) = 0;
-		if (reply_func == comm_wifi_send_packet_local) {
-			reply_func_raw = comm_wifi_send_raw_local;
-		} else if (reply_func == comm_wifi_send_packet_hub) {
-			reply_func_raw = comm_wifi_send_raw_hub;
-		}
+		void(*reply_func_raw)(unsigned char *data, unsigned int len) =
+				comm_wifi_raw_func_for(reply_func);
 
 		if (reply_func_raw) {
 			const int wifi_buffer_size = 4000;
 			wifi_buffer = malloc(wifi_buffer_size);
 			if (wifi_buffer) {
-				send_buffer = wifi_buffer + 3;
+				send_buffer = wifi_buffer + PACKET_HEADROOM;
 				send_size = wifi_buffer_size - 100;
 			} else {
 				reply_func_raw = 0;
@@ -552,25 +1068,11 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		}
 
 		if (reply_func_raw) {
-			unsigned short crc = crc16(send_buffer, ind);
-
-			if (ind > 255) {
-				wifi_buffer[0] = 3;
-				wifi_buffer[1] = ind >> 8;
-				wifi_buffer[2] = ind & 0xFF;
-				ind += 3;
-				wifi_buffer[ind++] = (uint8_t)(crc >> 8);
-				wifi_buffer[ind++] = (uint8_t)(crc & 0xFF);
-				wifi_buffer[ind++] = 3;
-				reply_func_raw(wifi_buffer, ind);
-			} else {
-				wifi_buffer[1] = 2;
-				wifi_buffer[2] = ind & 0xFF;
-				ind += 3;
-				wifi_buffer[ind++] = (uint8_t)(crc >> 8);
-				wifi_buffer[ind++] = (uint8_t)(crc & 0xFF);
-				wifi_buffer[ind++] = 3;
-				reply_func_raw(wifi_buffer + 1, ind - 1);
+			unsigned char *frame_start;
+			unsigned int frame_total;
+
+			if (packet_frame_in_place(send_buffer, ind, &frame_start, &frame_total)) {
+				reply_func_raw(frame_start, frame_total);
 			}
 
 			free(wifi_buffer);
@@ -581,6 +1083,10 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 	} break;
 
 	case COMM_FILE_WRITE: {
+		if (reply_func == comm_ble_send_packet) {
+			comm_ble_note_bulk_transfer();
+		}
+
 		static FILE *f_last = 0;
 		static int32_t f_last_offset = 0;
 
@@ -674,7 +1180,9 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 	case COMM_LOG_STOP:
 	case COMM_LOG_CONFIG_FIELD:
 	case COMM_LOG_DATA_F32:
-	case COMM_LOG_DATA_F64: {
+	case COMM_LOG_DATA_F64:
+	case COMM_LOG_DATA_BATCH:
+	case COMM_LOG_GET_RANGE: {
 		log_process_packet(data - 1, len + 1);
 	} break;
 
@@ -703,10 +1211,57 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		reply_func(send_buffer, ind);
 	} break;
 
+	case COMM_GET_ODOMETRY: {
+		odometry_state odom;
+		odometry_get(&odom);
+
+		int32_t ind = 0;
+		uint8_t send_buffer[40];
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = odometry_is_running();
+		send_buffer[ind++] = odom.valid;
+		buffer_append_float32_auto(send_buffer, odom.pos[0], &ind);
+		buffer_append_float32_auto(send_buffer, odom.pos[1], &ind);
+		buffer_append_float32_auto(send_buffer, odom.pos[2], &ind);
+		buffer_append_float32_auto(send_buffer, odom.vel[0], &ind);
+		buffer_append_float32_auto(send_buffer, odom.vel[1], &ind);
+		buffer_append_float32_auto(send_buffer, odom.vel[2], &ind);
+		buffer_append_float32_auto(send_buffer, odom.gnss_age, &ind);
+		reply_func(send_buffer, ind);
+	} break;
+
+	case COMM_GET_MEMPOOL_STATS: {
+		mempools_stats_t stats;
+		mempools_stats_get(&stats);
+
+		int32_t ind = 0;
+		uint8_t send_buffer[80];
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = MEMPOOLS_STAT_POOL_NUM;
+
+		for (int i = 0;i < MEMPOOLS_STAT_POOL_NUM;i++) {
+			mempool_pool_stats_t *s = &stats.pools[i];
+			buffer_append_uint16(send_buffer, s->buffer_size, &ind);
+			send_buffer[ind++] = s->buffer_num;
+			send_buffer[ind++] = s->used_now;
+			send_buffer[ind++] = s->used_peak;
+			buffer_append_uint32(send_buffer, s->takes, &ind);
+			buffer_append_uint32(send_buffer, s->empty_misses, &ind);
+			buffer_append_uint32(send_buffer, s->hold_avg_us, &ind);
+			buffer_append_uint32(send_buffer, s->hold_max_us, &ind);
+		}
+
+		buffer_append_uint32(send_buffer, stats.legacy_takes, &ind);
+		buffer_append_uint32(send_buffer, stats.heap_allocs, &ind);
+		buffer_append_uint32(send_buffer, stats.failures, &ind);
+		reply_func(send_buffer, ind);
+	} break;
+
 	case COMM_LISP_SET_RUNNING:
 	case COMM_LISP_GET_STATS:
 	case COMM_LISP_REPL_CMD:
 	case COMM_LISP_STREAM_CODE:
+	case COMM_LISP_PROF:
 	case COMM_LISP_RMSG: {
 		lispif_process_cmd(data - 1, len + 1, reply_func);
 		break;
@@ -714,6 +1269,10 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 
 	case COMM_GET_QML_UI_APP:
 	case COMM_LISP_READ_CODE: {
+		if (reply_func == comm_ble_send_packet) {
+			comm_ble_note_bulk_transfer();
+		}
+
 		int32_t ind = 0;
 
 		int32_t len_qml = buffer_get_int32(data, &ind);
@@ -740,7 +1299,11 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 			break;
 		}
 
-		uint8_t *send_buffer_global = mempools_get_packet_buffer();
+		uint8_t *send_buffer_global = commands_arena_alloc(PACKET_MAX_PL_LEN);
+		if (!send_buffer_global) {
+			break;
+		}
+
 		ind = 0;
 		send_buffer_global[ind++] = packet_id;
 		buffer_append_int32(send_buffer_global, qmlui_len, &ind);
@@ -748,7 +1311,6 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		flash_helper_code_data(code_type, ofs_qml, send_buffer_global + ind, len_qml);
 		ind += len_qml;
 		reply_func(send_buffer_global, ind);
-		mempools_free_packet_buffer(send_buffer_global);
 	} break;
 
 	case COMM_QMLUI_ERASE:
@@ -768,6 +1330,10 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 
 		bool flash_res = flash_helper_erase_code(packet_id == COMM_QMLUI_ERASE ? CODE_IND_QML : CODE_IND_LISP, erase_size);
 
+		if (packet_id == COMM_QMLUI_ERASE) {
+			main_invalidate_hw_crc();
+		}
+
 		ind = 0;
 		uint8_t send_buffer[50];
 		send_buffer[ind++] = packet_id;
@@ -783,6 +1349,10 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		bool flash_res = flash_helper_write_code(packet_id == COMM_QMLUI_WRITE ? CODE_IND_QML : CODE_IND_LISP,
 				qmlui_offset, data + ind, len - ind, 0);
 
+		if (packet_id == COMM_QMLUI_WRITE) {
+			main_invalidate_hw_crc();
+		}
+
 		ind = 0;
 		uint8_t send_buffer[50];
 		send_buffer[ind++] = packet_id;
@@ -856,7 +1426,124 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		lispif_process_custom_app_data(data, len);
 		break;
 
+	case COMM_STATS:
+		stats_process_cmd(data - 1, len + 1, reply_func);
+		break;
+
+	case COMM_TASK_STATS:
+		task_stats_process_cmd(data, len, reply_func);
+		break;
+
+	case COMM_UART_SET_PROFILE: {
+		// Payload: [u8 uart-num][u32 baud][u8 flow-ctrl]. The profile is
+		// applied before the ack, so a gateway negotiating over the
+		// affected port switches its own rate right after sending and
+		// reads the ack at the new rate. The ack carries the line error
+		// counters for link validation.
+		int32_t ind = 0;
+		int uart_num = data[ind++];
+		uint32_t baud = buffer_get_uint32(data, &ind);
+		bool flow_ctrl = data[ind++];
+
+		bool res = comm_uart_set_profile(uart_num, baud, flow_ctrl);
+
+		ind = 0;
+		uint8_t send_buffer[16];
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = res;
+		buffer_append_uint32(send_buffer, comm_uart_get_overflow_cnt(), &ind);
+		buffer_append_uint32(send_buffer, comm_uart_get_frame_err_cnt(), &ind);
+		buffer_append_uint32(send_buffer, comm_uart_get_parity_err_cnt(), &ind);
+		reply_func(send_buffer, ind);
+	} break;
+
+	case COMM_PACKET_SET_INTEGRITY: {
+		// Payload: [u8 transport][u8 mode]. Transport 0 is USB, the
+		// only link with its own integrity layer so far. The mode is
+		// applied before the ack, so the host switches its own side
+		// right after sending and verifies the ack in the new mode.
+		int32_t ind = 0;
+		uint8_t transport = data[ind++];
+		uint8_t mode = data[ind++];
+
+		bool res = false;
+		if (transport == 0) {
+			res = comm_usb_set_integrity(mode);
+		}
+
+		ind = 0;
+		uint8_t send_buffer[4];
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = res;
+		reply_func(send_buffer, ind);
+	} break;
+
+	case COMM_BANDWIDTH_TEST: {
+		// Payload: [u8 subcmd][...]. Subcommands: 0 reset (acked),
+		// 1 sink [u32 seq][fill] (not acked, counted), 2 echo (the
+		// whole packet is sent back), 3 report.
+		int32_t ind = 0;
+		uint8_t subcmd = data[ind++];
+
+		switch (subcmd) {
+		case 0: {
+			bw_test_reset();
+
+			ind = 0;
+			uint8_t send_buffer[4];
+			send_buffer[ind++] = packet_id;
+			send_buffer[ind++] = 0;
+			reply_func(send_buffer, ind);
+		} break;
+
+		case 1: {
+			uint32_t seq = buffer_get_uint32(data, &ind);
+			bw_test_sample(seq, len);
+		} break;
+
+		case 2:
+			reply_func(data - 1, len + 1);
+			break;
+
+		case 3: {
+			uint32_t elapsed_us = 0;
+			float mb_s = 0.0;
+			if (bw_packets > 1) {
+				elapsed_us = (uint32_t)(bw_time_last - bw_time_first);
+				if (elapsed_us > 0) {
+					// Bytes per microsecond is MB/s.
+					mb_s = (float)bw_bytes / (float)elapsed_us;
+				}
+			}
+
+			uint32_t ia_avg = bw_packets > 1 ?
+					(uint32_t)(bw_ia_sum / (bw_packets - 1)) : 0;
+
+			ind = 0;
+			uint8_t send_buffer[64];
+			send_buffer[ind++] = packet_id;
+			send_buffer[ind++] = 3;
+			buffer_append_uint32(send_buffer, bw_packets, &ind);
+			buffer_append_uint32(send_buffer, bw_bytes, &ind);
+			buffer_append_uint32(send_buffer, bw_lost, &ind);
+			buffer_append_uint32(send_buffer, elapsed_us, &ind);
+			buffer_append_float32_auto(send_buffer, mb_s, &ind);
+			buffer_append_uint32(send_buffer, bw_ia_min, &ind);
+			buffer_append_uint32(send_buffer, ia_avg, &ind);
+			buffer_append_uint32(send_buffer, bw_ia_max, &ind);
+			for (int i = 0;i < BW_TEST_HIST_LEN;i++) {
+				buffer_append_uint32(send_buffer, bw_ia_hist[i], &ind);
+			}
+			reply_func(send_buffer, ind);
+		} break;
+
+		default:
+			break;
+		}
+	} break;
+
 	case COMM_BMS_GET_VALUES:
+	case COMM_BMS_GET_VALUES_SELECTIVE:
 	case COMM_BMS_SET_CHARGE_ALLOWED:
 	case COMM_BMS_SET_BALANCE_OVERRIDE:
 	case COMM_BMS_RESET_COUNTERS:
@@ -979,18 +1666,22 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		reply_func(send_buffer, ind);
 	} break;
 
-	// Blocking commands
+	// Slow commands, dispatched to the worker pool. The extra byte of
+	// headroom is for the terminal NUL terminator.
 	case COMM_TERMINAL_CMD:
 	case COMM_PING_CAN:
 	case COMM_CAN_UPDATE_BAUD_ALL:
-		if (!is_blocking) {
-			memcpy(blocking_thread_cmd_buffer, data - 1, len + 1);
-			blocking_thread_cmd_len = len + 1;
-			is_blocking = true;
-			send_func_blocking = reply_func;
-			xSemaphoreGive(block_sem);
+	case COMM_LISP_BENCH:
+	case COMM_ERASE_NEW_APP: {
+		uint8_t *buf = mempools_alloc_any(len + 2);
+		if (buf) {
+			memcpy(buf, data - 1, len + 1);
+			cmd_worker_job_t job = {buf, len + 1, reply_func};
+			if (xQueueSend(worker_queue, &job, 0) != pdTRUE) {
+				mempools_free_any(buf);
+			}
 		}
-		break;
+	} break;
 
 	// Debug commands - Memory-efficient protocol extension
 	case COMM_DEBUG_GET_SYSTEM_INFO: {
@@ -1068,9 +1759,172 @@ void commands_process_packet(unsigned char *data, unsigned int len,
 		reply_func(send_buffer, ind);
 	} break;
 
+	case COMM_CAN_STATS: {
+		can_stats_t stats;
+		comm_can_stats_get(&stats);
+
+		int32_t ind = 0;
+		uint8_t send_buffer[32 + 4 * CAN_PING_HIST_LEN];
+		send_buffer[ind++] = packet_id;
+		buffer_append_uint32(send_buffer, stats.rx_frames_sec, &ind);
+		buffer_append_uint32(send_buffer, stats.tx_frames_sec, &ind);
+		buffer_append_float16(send_buffer, stats.bus_load, 1e1, &ind);
+		buffer_append_uint16(send_buffer, stats.tx_queue_max, &ind);
+		for (int i = 0;i < CAN_PING_HIST_LEN;i++) {
+			buffer_append_uint32(send_buffer, stats.ping_hist[i], &ind);
+		}
+		buffer_append_uint32(send_buffer, stats.rx_ring_drops, &ind);
+		buffer_append_uint32(send_buffer, stats.rx_missed, &ind);
+		reply_func(send_buffer, ind);
+
+		// Optional reset flag after the id
+		if (len >= 1 && data[0]) {
+			comm_can_stats_reset();
+		}
+	} break;
+
+	case COMM_COEX_STATS: {
+		coex_stats_t stats;
+		coex_stats_get(&stats);
+
+		int32_t ind = 0;
+		uint8_t send_buffer[24 + 7 * COEX_SPIKE_LOG_LEN];
+		send_buffer[ind++] = packet_id;
+		for (int i = 0;i < COEX_RADIO_NUM;i++) {
+			buffer_append_uint32(send_buffer, stats.grants[i], &ind);
+			buffer_append_uint32(send_buffer, stats.denials[i], &ind);
+		}
+		buffer_append_uint32(send_buffer, stats.spike_cnt, &ind);
+		for (int i = 0;i < COEX_SPIKE_LOG_LEN;i++) {
+			buffer_append_uint32(send_buffer, stats.spikes[i].t_ms, &ind);
+			buffer_append_uint16(send_buffer, stats.spikes[i].dur_ms, &ind);
+			send_buffer[ind++] = stats.spikes[i].radio;
+		}
+		reply_func(send_buffer, ind);
+
+		// Optional reset flag after the id
+		if (len >= 1 && data[0]) {
+			coex_stats_reset();
+		}
+	} break;
+
+	case COMM_MULTI_CMD: {
+		// Payload: {[u16 len][sub-packet]}... Each reply a sub-command
+		// produces is collected as [u8 sub-index][u16 len][reply] and
+		// everything is sent back in one packet. Nested batches are
+		// rejected, and only request/reply style sub-commands make
+		// sense here - asynchronous replies arriving after the batch
+		// has been sent are dropped.
+		if (batch_task_handle == xTaskGetCurrentTaskHandle()) {
+			break;
+		}
+
+		xSemaphoreTake(batch_mutex, portMAX_DELAY);
+
+		uint8_t *reply = commands_reply_reserve(PACKET_MAX_PL_LEN);
+		if (!reply) {
+			xSemaphoreGive(batch_mutex);
+			break;
+		}
+
+		batch_buffer = reply;
+		batch_pos = 0;
+		batch_sub_ind = 0;
+		batch_task_handle = xTaskGetCurrentTaskHandle();
+
+		reply[batch_pos++] = packet_id;
+
+		int32_t ind = 0;
+		while ((ind + 2) <= (int32_t)len) {
+			uint16_t sub_len = buffer_get_uint16(data, &ind);
+			if (sub_len == 0 || (ind + sub_len) > (int32_t)len) {
+				break;
+			}
+
+			commands_process_packet(data + ind, sub_len, batch_capture_send);
+			ind += sub_len;
+			batch_sub_ind++;
+		}
+
+		// Sub-commands update send_func; point it back at the batch
+		// transport before the capture buffer goes away.
+		send_func = reply_func;
+
+		int32_t reply_len = batch_pos;
+		batch_buffer = 0;
+		batch_task_handle = 0;
+		xSemaphoreGive(batch_mutex);
+
+		commands_reply_send(reply, reply_len, reply_func);
+		commands_reply_release(reply);
+	} break;
+
 	default:
 		break;
 	}
+
+	commands_update_stats(packet_id, cycles_start);
+	arena_end();
+	pkt_trace_stage(PKT_TRACE_HANDLER);
+}
+
+/**
+ * Register a handler that is called directly from the dispatch table for
+ * the given packet id, bypassing the switch. Pass 0 to unregister.
+ */
+void commands_register_handler(COMM_PACKET_ID id, commands_handler_t handler) {
+	if (id < COMM_PACKET_ID_NUM) {
+		dispatch_table[id] = handler;
+	}
+}
+
+void commands_update_stats(COMM_PACKET_ID id, uint32_t cycles_start) {
+	if (id >= COMM_PACKET_ID_NUM) {
+		return;
+	}
+
+	uint32_t cycles = esp_cpu_get_cycle_count() - cycles_start;
+	cmd_stats_t *s = &cmd_stats[id];
+	s->cnt++;
+	s->cycles += cycles;
+	if (cycles > s->cycles_max) {
+		s->cycles_max = cycles;
+	}
+}
+
+/**
+ * Print invocation counts and cycle times for all commands seen since
+ * boot or the last reset. Used by the cmd_stats terminal command.
+ */
+void commands_print_stats(void) {
+	commands_printf("  id        cnt   avg cycles   max cycles");
+	commands_printf("------------------------------------------");
+
+	for (int i = 0;i < COMM_PACKET_ID_NUM;i++) {
+		cmd_stats_t *s = &cmd_stats[i];
+		if (s->cnt == 0) {
+			continue;
+		}
+
+		commands_printf("%4d %10lu %12lu %12lu",
+				i, s->cnt, (uint32_t)(s->cycles / s->cnt), s->cycles_max);
+	}
+
+	commands_printf(" ");
+}
+
+void commands_reset_stats(void) {
+	memset(cmd_stats, 0, sizeof(cmd_stats));
+}
+
+void commands_last_packet_ids(uint8_t *ids, int num) {
+	for (int i = 0;i < num && i < LAST_PKT_ID_NUM;i++) {
+		ids[i] = m_last_pkt_ids[i];
+	}
+}
+
+int commands_worker_queue_waiting(void) {
+	return worker_queue ? (int)uxQueueMessagesWaiting(worker_queue) : 0;
 }
 
 /**
@@ -1088,12 +1942,71 @@ void commands_send_packet_can_last(unsigned char *data, unsigned int len) {
 	}
 }
 
+/**
+ * Same as commands_send_packet_can_last, but for buffers that have
+ * PACKET_HEADROOM before data and PACKET_TAILROOM after data + len.
+ * When the forwarding transport has a raw send path the packet is
+ * framed in place and handed over without any intermediate copy,
+ * otherwise this falls back to the regular path.
+ */
+void commands_send_packet_can_last_headroom(unsigned char *data, unsigned int len) {
+	if (send_func_can_fwd_raw) {
+		unsigned char *frame_start;
+		unsigned int frame_total;
+
+		if (packet_frame_in_place(data, len, &frame_start, &frame_total)) {
+			send_func_can_fwd_raw(frame_start, frame_total);
+			return;
+		}
+	}
+
+	commands_send_packet_can_last(data, len);
+}
+
 void commands_send_packet(unsigned char *data, unsigned int len) {
 	if (send_func) {
 		send_func(data, len);
 	}
 }
 
+/**
+ * Reserve a reply buffer for len payload bytes with PACKET_HEADROOM in
+ * front and PACKET_TAILROOM behind, taken from the smallest pool class
+ * that fits. Send it with commands_reply_send, which frames the packet
+ * in place and hands it to the transport's raw path when there is one,
+ * so a large reply is built exactly once at its final size. The buffer
+ * stays valid after sending and can be refilled for chunked replies;
+ * release it with commands_reply_release when done.
+ */
+uint8_t *commands_reply_reserve(unsigned int len) {
+	uint8_t *buf = mempools_alloc_any(PACKET_HEADROOM + len + PACKET_TAILROOM);
+	return buf ? buf + PACKET_HEADROOM : 0;
+}
+
+void commands_reply_send(uint8_t *payload, unsigned int len, send_func_t reply_func) {
+	send_func_t raw = send_func_raw_for(reply_func);
+
+	if (raw) {
+		unsigned char *frame_start;
+		unsigned int frame_total;
+
+		if (packet_frame_in_place(payload, len, &frame_start, &frame_total)) {
+			raw(frame_start, frame_total);
+			return;
+		}
+	}
+
+	if (reply_func) {
+		reply_func(payload, len);
+	}
+}
+
+void commands_reply_release(uint8_t *payload) {
+	if (payload) {
+		mempools_free_any(payload - PACKET_HEADROOM);
+	}
+}
+
 send_func_t commands_get_send_func(void) {
 	return send_func;
 }
@@ -1102,6 +2015,83 @@ void commands_set_send_func(send_func_t func) {
 	send_func = func;
 }
 
+// Must be called with print_mutex held.
+static void print_acc_flush(print_acc_t *acc) {
+	if (acc->len > 1) {
+		commands_send_packet(acc->buf, acc->len);
+		acc->len = 1;
+	}
+}
+
+// Must be called with print_mutex held. Arm the timed flush so
+// buffered output never sits for more than a blink.
+static void print_acc_arm_timer(void) {
+	if (!print_flush_armed && print_flush_timer) {
+		print_flush_armed = true;
+		esp_timer_start_once(print_flush_timer, PRINT_FLUSH_DELAY_MS * 1000);
+	}
+}
+
+// Must be called with print_mutex held. Appends one already-formatted
+// message, flushing first when it does not fit after what is buffered.
+static void print_acc_append(print_acc_t *acc, const char *data, int len) {
+	if (len <= 0) {
+		return;
+	}
+
+	if (len > PRINT_BUFFER_SIZE - 2) {
+		len = PRINT_BUFFER_SIZE - 2;
+	}
+
+	if ((acc->len + len + 1) > PRINT_BUFFER_SIZE) {
+		print_acc_flush(acc);
+	}
+
+	if (acc->len > 1) {
+		acc->buf[acc->len++] = '\n';
+	}
+
+	memcpy(acc->buf + acc->len, data, len);
+	acc->len += len;
+
+	print_acc_arm_timer();
+}
+
+static void print_flush_timeout(void *arg) {
+	(void)arg;
+	commands_printf_flush();
+}
+
+void commands_printf_flush(void) {
+	if (!init_done) {
+		return;
+	}
+
+	xSemaphoreTake(print_mutex, portMAX_DELAY);
+	print_flush_armed = false;
+	print_acc_flush(&print_acc_term);
+	print_acc_flush(&print_acc_lisp);
+	xSemaphoreGive(print_mutex);
+}
+
+void commands_log_deferred(const char *fmt,
+		uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+	deferred_log_entry_t e = {fmt, {a0, a1, a2, a3}};
+	bool ok;
+
+	portENTER_CRITICAL(&deferred_log_mux);
+	ok = rb_spsc_insert(&deferred_log_rb, &e);
+	portEXIT_CRITICAL(&deferred_log_mux);
+
+	if (!ok) {
+		deferred_log_drops++;
+	}
+}
+
+uint32_t commands_log_deferred_drops(void) {
+	return deferred_log_drops;
+}
+
 int commands_printf(const char* format, ...) {
 	if (!init_done) {
 		return 0;
@@ -1109,26 +2099,46 @@ int commands_printf(const char* format, ...) {
 
 	xSemaphoreTake(print_mutex, portMAX_DELAY);
 
-	va_list arg;
-	va_start (arg, format);
-	int len;
-
-	char *print_buffer = malloc(PRINT_BUFFER_SIZE);
+	va_list arg, arg2;
+	va_start(arg, format);
+	va_copy(arg2, arg);
+
+	// Format straight into the accumulator tail; no per-call allocation.
+	print_acc_t *acc = &print_acc_term;
+	int pos = acc->len > 1 ? acc->len + 1 : 1;
+	int space = PRINT_BUFFER_SIZE - pos;
+	int len = vsnprintf((char*)acc->buf + pos, space, format, arg);
+
+	if (len >= space && acc->len > 1) {
+		// Did not fit after what is already buffered; flush that and
+		// retry with the whole buffer.
+		print_acc_flush(acc);
+		pos = 1;
+		space = PRINT_BUFFER_SIZE - 1;
+		len = vsnprintf((char*)acc->buf + pos, space, format, arg2);
+	}
 
-	print_buffer[0] = COMM_PRINT;
-	len = vsnprintf(print_buffer + 1, (PRINT_BUFFER_SIZE - 1), format, arg);
-	va_end (arg);
+	va_end(arg);
+	va_end(arg2);
 
-	int len_to_print = (len < (PRINT_BUFFER_SIZE - 1)) ? len + 1 : PRINT_BUFFER_SIZE;
+	int stored = 0;
+	if (len > 0) {
+		stored = len < space ? len : space - 1;
+		if (pos > acc->len) {
+			acc->buf[acc->len] = '\n';
+		}
+		acc->len = pos + stored;
 
-	if(len > 0) {
-		commands_send_packet((unsigned char*)print_buffer, len_to_print);
+		if (acc->len >= PRINT_BUFFER_SIZE - 1) {
+			print_acc_flush(acc);
+		} else {
+			print_acc_arm_timer();
+		}
 	}
 
-	free(print_buffer);
 	xSemaphoreGive(print_mutex);
 
-	return len_to_print - 1;
+	return stored;
 }
 
 int commands_printf_lisp(const char* format, ...) {
@@ -1187,7 +2197,7 @@ int commands_printf_lisp(const char* format, ...) {
 			len_to_print--;
 		}
 
-		commands_send_packet((unsigned char*)print_buffer, len_to_print);
+		print_acc_append(&print_acc_lisp, print_buffer + 1, len_to_print - 1);
 
 		// Uncomment to always print to USB. Useful when debugging code that redirects prints
 //		comm_usb_send_packet((unsigned char*)print_buffer, len_to_print);
@@ -24,24 +24,53 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "datatypes.h"
+
+// One larger than the highest COMM_PACKET_ID, used to size the dispatch
+// and statistics tables.
+#define COMM_PACKET_ID_NUM		(COMM_LISP_BENCH + 1)
+
 typedef void (*send_func_t)(unsigned char *, unsigned int);
+typedef void (*commands_handler_t)(
+	unsigned char *data, unsigned int len, send_func_t reply_func
+);
 
 // Functions
 void commands_init(void);
+void commands_register_handler(COMM_PACKET_ID id, commands_handler_t handler);
+void commands_update_stats(COMM_PACKET_ID id, uint32_t cycles_start);
+void commands_print_stats(void);
+void commands_reset_stats(void);
+// The most recent packet ids seen by the dispatcher, newest first.
+void commands_last_packet_ids(uint8_t *ids, int num);
+int commands_worker_queue_waiting(void);
 void commands_process_packet(
 	unsigned char *data, unsigned int len, send_func_t reply_func
 );
 void commands_send_packet(unsigned char *data, unsigned int len);
 void commands_send_packet_can_last(unsigned char *data, unsigned int len);
+void commands_send_packet_can_last_headroom(unsigned char *data, unsigned int len);
 send_func_t commands_get_send_func(void);
 void commands_set_send_func(send_func_t func);
 int commands_printf(const char *format, ...);
 int commands_printf_lisp(const char *format, ...);
+void commands_printf_flush(void);
+// Enqueue a diagnostic line without formatting or sending it; a
+// low-priority task does both later. fmt must be a string literal with
+// at most four 32-bit integer conversions. Cheap enough for
+// timing-sensitive paths; drops (and counts) when the ring is full.
+void commands_log_deferred(const char *fmt,
+		uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+uint32_t commands_log_deferred_drops(void);
 void commands_init_plot(char *namex, char *namey);
 void commands_plot_add_graph(char *name);
 void commands_plot_set_graph(int graph);
 void commands_send_plot_points(float x, float y);
 void commands_send_app_data(unsigned char *data, unsigned int len);
+uint8_t *commands_arena_alloc(unsigned int size);
+uint8_t *commands_reply_reserve(unsigned int len);
+void commands_reply_send(uint8_t *payload, unsigned int len, send_func_t reply_func);
+void commands_reply_release(uint8_t *payload);
 
 #if LOGS_ENABLED
 
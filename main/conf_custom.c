@@ -25,6 +25,7 @@
 #include "buffer.h"
 #include "main.h"
 #include "confparser.h"
+#include "confxml.h"
 #include "comm_can.h"
 #include "commands.h"
 
@@ -35,6 +36,25 @@ static int (*m_get_cfg)(uint8_t *data, bool is_default) = 0;
 static bool (*m_set_cfg)(uint8_t *data) = 0;
 static int (*m_get_cfg_xml)(uint8_t **data) = 0;
 
+/*
+ * Generation counter for differential config sync. Every accepted
+ * config change, full or delta, bumps it. A delta request carries the
+ * generation it was computed against and is rejected on mismatch, so a
+ * client that missed a change by another client falls back to a full
+ * round trip instead of silently clobbering it.
+ */
+static uint32_t m_config_generation = 1;
+
+/*
+ * Serialized snapshot of the current config, rebuilt at most once per
+ * config generation. Config-heavy client sessions query the full config
+ * repeatedly; with the cache each query is a memcpy instead of another
+ * walk of the confparser field table.
+ */
+static uint8_t *m_cfg_cache = 0;
+static int32_t m_cfg_cache_len = 0;
+static uint32_t m_cfg_cache_gen = 0;
+
 // VESC Express compatibility functions
 static int vesc_express_get_cfg(uint8_t *data, bool is_default);
 static bool vesc_express_set_cfg(uint8_t *data);
@@ -45,27 +65,14 @@ static bool is_func_valid(void *func) {
 	return func != NULL;
 }
 
-// Static XML configuration data
-static const char* vesc_express_xml = 
-"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-"<config>\n"
-"  <param name=\"controller_id\" type=\"int16\" min=\"0\" max=\"254\" default=\"0\" />\n"
-"  <param name=\"can_baud_rate\" type=\"uint8\" min=\"0\" max=\"8\" default=\"3\" />\n"
-"  <param name=\"can_status_rate_hz\" type=\"int16\" min=\"1\" max=\"1000\" default=\"50\" />\n"
-"  <param name=\"wifi_mode\" type=\"uint8\" min=\"0\" max=\"3\" default=\"3\" />\n"
-"  <param name=\"wifi_sta_ssid\" type=\"string\" maxlen=\"64\" default=\"\" />\n"
-"  <param name=\"wifi_sta_key\" type=\"string\" maxlen=\"64\" default=\"\" />\n"
-"  <param name=\"wifi_ap_ssid\" type=\"string\" maxlen=\"64\" default=\"VESC Express\" />\n"
-"  <param name=\"wifi_ap_key\" type=\"string\" maxlen=\"64\" default=\"\" />\n"
-"  <param name=\"use_tcp_local\" type=\"bool\" default=\"true\" />\n"
-"  <param name=\"use_tcp_hub\" type=\"bool\" default=\"false\" />\n"
-"  <param name=\"tcp_hub_url\" type=\"string\" maxlen=\"256\" default=\"\" />\n"
-"  <param name=\"tcp_hub_port\" type=\"int16\" min=\"1\" max=\"65535\" default=\"65102\" />\n"
-"  <param name=\"tcp_hub_id\" type=\"string\" maxlen=\"64\" default=\"\" />\n"
-"  <param name=\"tcp_hub_pass\" type=\"string\" maxlen=\"64\" default=\"\" />\n"
-"  <param name=\"ble_name\" type=\"string\" maxlen=\"32\" default=\"VESC Express\" />\n"
-"  <param name=\"ble_pin\" type=\"int32\" min=\"0\" max=\"999999\" default=\"123456\" />\n"
-"</config>\n";
+/*
+ * The settings XML is served from the generated confxml.c blob, which
+ * is deflate-compressed with a 4-byte uncompressed-size prefix - the
+ * format VESC Tool already inflates for other VESC products. At about
+ * a tenth of the plain text size it cuts the config-UI first-open time
+ * over BLE accordingly, and it always matches the generated parser
+ * instead of a hand-maintained copy.
+ */
 
 void conf_custom_add_config(
 		int (*get_cfg)(uint8_t *data, bool is_default),
@@ -116,6 +123,69 @@ int conf_custom_get_cfg_xml(int conf_ind, uint8_t **data) {
 	}
 }
 
+// Copy a NUL-terminated string field out of a delta packet with bounds
+// checking against both the packet and the destination field size.
+static bool delta_get_string(char *dst, int32_t dst_size, const uint8_t *buf,
+		int32_t len, int32_t *ind) {
+	int32_t start = *ind;
+	int32_t end = start;
+
+	while (end < len && buf[end] != 0) {
+		end++;
+	}
+
+	if (end >= len || (end - start) >= dst_size) {
+		return false;
+	}
+
+	strcpy(dst, (const char*)buf + start);
+	*ind = end + 1;
+	return true;
+}
+
+/*
+ * Apply one (field-id, value) pair to conf. Field ids follow the field
+ * order of confparser_serialize_main_config_t and are part of the
+ * protocol, so new fields may only be appended.
+ */
+static bool delta_apply_field(main_config_t *conf, const uint8_t *buf,
+		int32_t len, int32_t *ind_io) {
+	int32_t ind = *ind_io;
+
+	if (ind >= len) {
+		return false;
+	}
+
+	uint8_t field = buf[ind++];
+	bool ok = true;
+
+	switch (field) {
+	case 0: ok = (len - ind) >= 2; if (ok) conf->controller_id = buffer_get_int16(buf, &ind); break;
+	case 1: ok = (len - ind) >= 1; if (ok) conf->can_baud_rate = buf[ind++]; break;
+	case 2: ok = (len - ind) >= 2; if (ok) conf->can_status_rate_hz = buffer_get_int16(buf, &ind); break;
+	case 3: ok = (len - ind) >= 1; if (ok) conf->wifi_mode = buf[ind++]; break;
+	case 4: ok = delta_get_string(conf->wifi_sta_ssid, sizeof(conf->wifi_sta_ssid), buf, len, &ind); break;
+	case 5: ok = delta_get_string(conf->wifi_sta_key, sizeof(conf->wifi_sta_key), buf, len, &ind); break;
+	case 6: ok = delta_get_string(conf->wifi_ap_ssid, sizeof(conf->wifi_ap_ssid), buf, len, &ind); break;
+	case 7: ok = delta_get_string(conf->wifi_ap_key, sizeof(conf->wifi_ap_key), buf, len, &ind); break;
+	case 8: ok = (len - ind) >= 1; if (ok) conf->use_tcp_local = buf[ind++]; break;
+	case 9: ok = (len - ind) >= 1; if (ok) conf->use_tcp_hub = buf[ind++]; break;
+	case 10: ok = delta_get_string(conf->tcp_hub_url, sizeof(conf->tcp_hub_url), buf, len, &ind); break;
+	case 11: ok = (len - ind) >= 2; if (ok) conf->tcp_hub_port = buffer_get_uint16(buf, &ind); break;
+	case 12: ok = delta_get_string(conf->tcp_hub_id, sizeof(conf->tcp_hub_id), buf, len, &ind); break;
+	case 13: ok = delta_get_string(conf->tcp_hub_pass, sizeof(conf->tcp_hub_pass), buf, len, &ind); break;
+	case 14: ok = (len - ind) >= 1; if (ok) conf->ble_mode = buf[ind++]; break;
+	case 15: ok = delta_get_string(conf->ble_name, sizeof(conf->ble_name), buf, len, &ind); break;
+	case 16: ok = (len - ind) >= 4; if (ok) conf->ble_pin = buffer_get_uint32(buf, &ind); break;
+	case 17: ok = (len - ind) >= 4; if (ok) conf->ble_service_capacity = buffer_get_uint32(buf, &ind); break;
+	case 18: ok = (len - ind) >= 4; if (ok) conf->ble_chr_descr_capacity = buffer_get_uint32(buf, &ind); break;
+	default: ok = false; break;
+	}
+
+	*ind_io = ind;
+	return ok;
+}
+
 void conf_custom_process_cmd(unsigned char *data, unsigned int len,
 		void(*reply_func)(unsigned char *data, unsigned int len)) {
 	COMM_PACKET_ID packet_id;
@@ -130,21 +200,25 @@ void conf_custom_process_cmd(unsigned char *data, unsigned int len,
 	case COMM_GET_CUSTOM_CONFIG_DEFAULT: {
 		int conf_ind = data[0];
 		if ((m_get_cfg && conf_ind == 0) || conf_ind == 0) {
-			uint8_t *send_buffer = mempools_get_packet_buffer();
+			uint8_t *send_buffer = commands_reply_reserve(PACKET_MAX_PL_LEN);
+			if (!send_buffer) {
+				break;
+			}
+
 			int32_t ind = 0;
 			send_buffer[ind++] = packet_id;
 			send_buffer[ind++] = conf_ind;
-			
+
 			int32_t len_cfg;
 			if (m_get_cfg) {
 				len_cfg = m_get_cfg(send_buffer + ind, packet_id == COMM_GET_CUSTOM_CONFIG_DEFAULT);
 			} else {
 				len_cfg = vesc_express_get_cfg(send_buffer + ind, packet_id == COMM_GET_CUSTOM_CONFIG_DEFAULT);
 			}
-			
+
 			ind += len_cfg;
-			reply_func(send_buffer, ind);
-			mempools_free_packet_buffer(send_buffer);
+			commands_reply_send(send_buffer, ind, reply_func);
+			commands_reply_release(send_buffer);
 		}
 	} break;
 
@@ -192,7 +266,12 @@ void conf_custom_process_cmd(unsigned char *data, unsigned int len,
 			break;
 		}
 
-		uint8_t *send_buffer = mempools_get_packet_buffer();
+		// Exact final size: id, conf index, two int32 fields, chunk data.
+		uint8_t *send_buffer = commands_reply_reserve(10 + len_conf);
+		if (!send_buffer) {
+			break;
+		}
+
 		int32_t send_ind = 0;
 		send_buffer[send_ind++] = packet_id;
 		send_buffer[send_ind++] = conf_ind;
@@ -201,8 +280,57 @@ void conf_custom_process_cmd(unsigned char *data, unsigned int len,
 		memcpy(send_buffer + send_ind, xml_data + ofs_conf, len_conf);
 		send_ind += len_conf;
 
+		commands_reply_send(send_buffer, send_ind, reply_func);
+		commands_reply_release(send_buffer);
+	} break;
+
+	case COMM_MAIN_CONFIG_DELTA: {
+		// [u32 generation][u8 num_fields]{[u8 field-id][value]}...
+		// num_fields 0 just queries the current generation. The whole
+		// delta is applied atomically or not at all.
+		bool ok = false;
+
+		if (len >= 5) {
+			int32_t ind = 0;
+			uint32_t gen = buffer_get_uint32(data, &ind);
+			uint8_t num = data[ind++];
+
+			if (num == 0) {
+				ok = true;
+			} else if (gen == m_config_generation && !m_set_cfg) {
+				main_config_t *conf = calloc(1, sizeof(main_config_t));
+				if (conf) {
+					*conf = backup.config;
+
+					ok = true;
+					for (int i = 0;i < num && ok;i++) {
+						ok = delta_apply_field(conf, data, len, &ind);
+					}
+
+					if (ok) {
+						bool baud_changed = backup.config.can_baud_rate != conf->can_baud_rate;
+
+						backup.config = *conf;
+						m_config_generation++;
+
+						if (baud_changed) {
+							comm_can_update_baudrate(0);
+						}
+
+						main_store_backup_data();
+					}
+
+					free(conf);
+				}
+			}
+		}
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[10];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = ok;
+		buffer_append_uint32(send_buffer, m_config_generation, &send_ind);
 		reply_func(send_buffer, send_ind);
-		mempools_free_packet_buffer(send_buffer);
 	} break;
 
 	default:
@@ -212,16 +340,37 @@ void conf_custom_process_cmd(unsigned char *data, unsigned int len,
 
 // VESC Express compatibility implementations
 static int vesc_express_get_cfg(uint8_t *data, bool is_default) {
+	if (!is_default && m_cfg_cache && m_cfg_cache_gen == m_config_generation) {
+		memcpy(data, m_cfg_cache, m_cfg_cache_len);
+		return m_cfg_cache_len;
+	}
+
 	main_config_t *conf = calloc(1, sizeof(main_config_t));
-	
+	if (!conf) {
+		return 0;
+	}
+
 	if (is_default) {
 		confparser_set_defaults_main_config_t(conf);
 	} else {
 		*conf = backup.config;
 	}
-	
+
 	int32_t len = confparser_serialize_main_config_t(data, conf);
 	free(conf);
+
+	if (!is_default && len > 0) {
+		if (m_cfg_cache == 0) {
+			m_cfg_cache = malloc(len);
+		}
+
+		if (m_cfg_cache) {
+			memcpy(m_cfg_cache, data, len);
+			m_cfg_cache_len = len;
+			m_cfg_cache_gen = m_config_generation;
+		}
+	}
+
 	return len;
 }
 
@@ -233,9 +382,10 @@ static bool vesc_express_set_cfg(uint8_t *data) {
 	if (success) {
 		// Check if CAN baud rate changed to update CAN bus
 		bool baud_changed = backup.config.can_baud_rate != conf->can_baud_rate;
-		
+
 		backup.config = *conf;
-		
+		m_config_generation++;
+
 		if (baud_changed) {
 			comm_can_update_baudrate(0);
 		}
@@ -248,6 +398,6 @@ static bool vesc_express_set_cfg(uint8_t *data) {
 }
 
 static int vesc_express_get_cfg_xml(uint8_t **data) {
-	*data = (uint8_t*)vesc_express_xml;
-	return strlen(vesc_express_xml);
+	*data = data_main_config_t_;
+	return DATA_MAIN_CONFIG_T__SIZE;
 }
\ No newline at end of file
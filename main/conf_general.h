@@ -28,6 +28,15 @@
 // Set to 0 for building a release and iterate during beta test builds
 #define FW_TEST_VERSION_NUMBER		0
 
+// Run the AHRS and biquad filter hot paths on the fixed-point math
+// module instead of soft-float. Worthwhile on FPU-less targets, where
+// every float operation is a library call.
+//#define USE_FIXMATH
+
+// Compile in the PERF_ENTER/PERF_EXIT cycle-counter instrumentation,
+// see perf.h. Dump the tables with the perf_stats terminal command.
+//#define PERF_INSTRUMENT
+
 #if !defined(HW_SOURCE) && !defined(HW_HEADER)
 #define HW_HEADER					"hw_devkit_c6.h"
 #define HW_SOURCE					"hw_devkit_c6.c"
@@ -18,6 +18,7 @@
     */
 
 #include "crc.h"
+#include <stdbool.h>
 
 // CRC Table
 const unsigned short crc16_tab[] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084,
@@ -51,15 +52,66 @@ const unsigned short crc16_tab[] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084,
 		0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0 };
 
 unsigned short crc16(unsigned char *buf, unsigned int len) {
-	unsigned short cksum = 0;
-	for (unsigned int i = 0; i < len; i++) {
-		cksum = crc16_tab[(((cksum >> 8) ^ *buf++) & 0xFF)] ^ (cksum << 8);
+	return crc16_with_init(buf, len, 0);
+}
+
+/*
+ * The CRC functions below use slice-by-8: eight table lookups combine
+ * the CRC of eight message bytes at once, roughly quadrupling
+ * throughput over the byte-at-a-time loop. These run on every packet in
+ * and out plus over whole firmware images during OTA verification. The
+ * extended tables are generated from the base tables on first use.
+ */
+
+static bool tables_generated = false;
+static unsigned short crc16_tabs[8][256];
+static uint32_t crc32_tabs[8][256];
+
+static void generate_tables(void) {
+	for (int i = 0;i < 256;i++) {
+		crc16_tabs[0][i] = crc16_tab[i];
+
+		uint32_t c = i;
+		for (int j = 0;j < 8;j++) {
+			uint32_t mask = -(c & 1);
+			c = (c >> 1) ^ (0xEDB88320 & mask);
+		}
+		crc32_tabs[0][i] = c;
 	}
-	return cksum;
+
+	// Table t holds the CRC of a byte followed by t zero bytes.
+	for (int t = 1;t < 8;t++) {
+		for (int i = 0;i < 256;i++) {
+			unsigned short c16 = crc16_tabs[t - 1][i];
+			crc16_tabs[t][i] = crc16_tabs[0][c16 >> 8] ^ (unsigned short)(c16 << 8);
+
+			uint32_t c32 = crc32_tabs[t - 1][i];
+			crc32_tabs[t][i] = crc32_tabs[0][c32 & 0xFF] ^ (c32 >> 8);
+		}
+	}
+
+	tables_generated = true;
 }
 
 unsigned short crc16_with_init(unsigned char *buf, unsigned int len, unsigned short cksum) {
-	for (unsigned int i = 0; i < len; i++) {
+	if (!tables_generated) {
+		generate_tables();
+	}
+
+	while (len >= 8) {
+		cksum = crc16_tabs[7][buf[0] ^ (cksum >> 8)] ^
+				crc16_tabs[6][buf[1] ^ (cksum & 0xFF)] ^
+				crc16_tabs[5][buf[2]] ^
+				crc16_tabs[4][buf[3]] ^
+				crc16_tabs[3][buf[4]] ^
+				crc16_tabs[2][buf[5]] ^
+				crc16_tabs[1][buf[6]] ^
+				crc16_tabs[0][buf[7]];
+		buf += 8;
+		len -= 8;
+	}
+
+	while (len--) {
 		cksum = crc16_tab[(((cksum >> 8) ^ *buf++) & 0xFF)] ^ (cksum << 8);
 	}
 
@@ -67,8 +119,30 @@ unsigned short crc16_with_init(unsigned char *buf, unsigned int len, unsigned sh
 }
 
 uint32_t crc32_with_init(const uint8_t *buf, uint32_t len, uint32_t cksum) {
+	if (!tables_generated) {
+		generate_tables();
+	}
+
 	cksum = ~cksum;
 
+	while (len >= 8) {
+		uint32_t low = cksum ^ ((uint32_t)buf[0] |
+				(uint32_t)buf[1] << 8 |
+				(uint32_t)buf[2] << 16 |
+				(uint32_t)buf[3] << 24);
+
+		cksum = crc32_tabs[7][low & 0xFF] ^
+				crc32_tabs[6][(low >> 8) & 0xFF] ^
+				crc32_tabs[5][(low >> 16) & 0xFF] ^
+				crc32_tabs[4][low >> 24] ^
+				crc32_tabs[3][buf[4]] ^
+				crc32_tabs[2][buf[5]] ^
+				crc32_tabs[1][buf[6]] ^
+				crc32_tabs[0][buf[7]];
+		buf += 8;
+		len -= 8;
+	}
+
 	while (len--) {
 		cksum = cksum ^ *buf++;
 
@@ -304,6 +304,25 @@ typedef enum {
 	COMM_DEBUG_GET_LOG_LEVEL				= 161,
 	COMM_DEBUG_STREAM_START					= 162,
 	COMM_DEBUG_STREAM_STOP					= 163,
+
+	COMM_CAN_STATS							= 164,
+	COMM_COEX_STATS							= 165,
+	COMM_LISP_PROF							= 166,
+
+	COMM_WRITE_NEW_APP_DELTA				= 167,
+	COMM_LOG_DATA_BATCH						= 168,
+	COMM_LOG_GET_RANGE						= 169,
+	COMM_GET_ODOMETRY						= 170,
+	COMM_GET_MEMPOOL_STATS					= 171,
+	COMM_MAIN_CONFIG_DELTA					= 172,
+	COMM_BMS_GET_VALUES_SELECTIVE			= 173,
+	COMM_MULTI_CMD							= 174,
+	COMM_STATS								= 175,
+	COMM_TASK_STATS							= 176,
+	COMM_UART_SET_PROFILE					= 177,
+	COMM_PACKET_SET_INTEGRITY				= 178,
+	COMM_BANDWIDTH_TEST						= 179,
+	COMM_LISP_BENCH							= 180,
 } COMM_PACKET_ID;
 
 // CAN commands
@@ -236,30 +236,155 @@ void filter_add_sample(float *buffer, float sample, int bits, uint32_t *offset)
 /**
  * Biquad filter
  */
+#ifdef USE_FIXMATH
+float biquad_process(Biquad *biquad, float in) {
+    q16_t in_q = q16_from_float(in);
+    q16_t out = q16_mul(in_q, biquad->a0) + biquad->z1;
+    biquad->z1 = q16_mul(in_q, biquad->a1) + biquad->z2 - q16_mul(biquad->b1, out);
+    biquad->z2 = q16_mul(in_q, biquad->a2) - q16_mul(biquad->b2, out);
+    return q16_to_float(out);
+}
+#else
 float biquad_process(Biquad *biquad, float in) {
     float out = in * biquad->a0 + biquad->z1;
     biquad->z1 = in * biquad->a1 + biquad->z2 - biquad->b1 * out;
     biquad->z2 = in * biquad->a2 - biquad->b2 * out;
     return out;
 }
+#endif
 void biquad_config(Biquad *biquad, BiquadType type, float Fc) {
 	float K = tanf(M_PI * Fc);	// -0.0159;
 	float Q = 0.707; // maximum sharpness (0.5 = maximum smoothness)
 	float norm = 1 / (1 + K / Q + K * K);
+	float a0 = 0.0, a1 = 0.0, a2 = 0.0;
 	if (type == BQ_LOWPASS) {
-		biquad->a0 = K * K * norm;
-		biquad->a1 = 2 * biquad->a0;
-		biquad->a2 = biquad->a0;
+		a0 = K * K * norm;
+		a1 = 2 * a0;
+		a2 = a0;
 	}
 	else if (type == BQ_HIGHPASS) {
-		biquad->a0 = 1 * norm;
-		biquad->a1 = -2 * biquad->a0;
-		biquad->a2 = biquad->a0;
+		a0 = 1 * norm;
+		a1 = -2 * a0;
+		a2 = a0;
 	}
-	biquad->b1 = 2 * (K * K - 1) * norm;
-	biquad->b2 = (1 - K / Q + K * K) * norm;
+	float b1 = 2 * (K * K - 1) * norm;
+	float b2 = (1 - K / Q + K * K) * norm;
+
+	// Configuration is cold, so the coefficients are computed in float
+	// either way and only stored in the format the filter runs in.
+#ifdef USE_FIXMATH
+	biquad->a0 = q16_from_float(a0);
+	biquad->a1 = q16_from_float(a1);
+	biquad->a2 = q16_from_float(a2);
+	biquad->b1 = q16_from_float(b1);
+	biquad->b2 = q16_from_float(b2);
+#else
+	biquad->a0 = a0;
+	biquad->a1 = a1;
+	biquad->a2 = a2;
+	biquad->b1 = b1;
+	biquad->b2 = b2;
+#endif
 }
 void biquad_reset(Biquad *biquad) {
 	biquad->z1 = 0;
 	biquad->z2 = 0;
 }
+
+void biquad_cascade_init(BiquadCascade *cascade) {
+	cascade->num_stages = 0;
+}
+
+/**
+ * Add a filter stage to a cascade.
+ *
+ * @param cascade
+ * The cascade to add the stage to.
+ * @param type
+ * Filter type of the stage.
+ * @param Fc
+ * Normalized cutoff frequency of the stage.
+ *
+ * @return
+ * The stage index, or -1 if the cascade is full.
+ */
+int biquad_cascade_add(BiquadCascade *cascade, BiquadType type, float Fc) {
+	if (cascade->num_stages >= BIQUAD_CASCADE_MAX_STAGES) {
+		return -1;
+	}
+
+	Biquad *bq = &cascade->stages[cascade->num_stages];
+	biquad_config(bq, type, Fc);
+	biquad_reset(bq);
+
+	return cascade->num_stages++;
+}
+
+void biquad_cascade_reset(BiquadCascade *cascade) {
+	for (int i = 0;i < cascade->num_stages;i++) {
+		biquad_reset(&cascade->stages[i]);
+	}
+}
+
+/**
+ * Run a biquad cascade over a block of samples. The filter state of each
+ * stage is kept in locals over the whole block, so the per-sample cost is
+ * a handful of multiply-adds per stage with no call overhead. in and out
+ * may point to the same buffer; the block is processed stage by stage
+ * with out as the intermediate buffer.
+ *
+ * @param cascade
+ * The cascade to run.
+ * @param in
+ * Input samples.
+ * @param out
+ * Output buffer, at least n samples. May alias in.
+ * @param n
+ * Number of samples in the block.
+ */
+void filter_run_block(BiquadCascade *cascade, const float *in, float *out, int n) {
+	if (cascade->num_stages == 0) {
+		if (in != out) {
+			for (int i = 0;i < n;i++) {
+				out[i] = in[i];
+			}
+		}
+		return;
+	}
+
+	const float *src = in;
+	for (int s = 0;s < cascade->num_stages;s++) {
+		Biquad *bq = &cascade->stages[s];
+
+#ifdef USE_FIXMATH
+		q16_t a0 = bq->a0, a1 = bq->a1, a2 = bq->a2;
+		q16_t b1 = bq->b1, b2 = bq->b2;
+		q16_t z1 = bq->z1, z2 = bq->z2;
+
+		for (int i = 0;i < n;i++) {
+			q16_t x = q16_from_float(src[i]);
+			q16_t y = q16_mul(x, a0) + z1;
+			z1 = q16_mul(x, a1) + z2 - q16_mul(b1, y);
+			z2 = q16_mul(x, a2) - q16_mul(b2, y);
+			out[i] = q16_to_float(y);
+		}
+#else
+		float a0 = bq->a0, a1 = bq->a1, a2 = bq->a2;
+		float b1 = bq->b1, b2 = bq->b2;
+		float z1 = bq->z1, z2 = bq->z2;
+
+		for (int i = 0;i < n;i++) {
+			float x = src[i];
+			float y = x * a0 + z1;
+			z1 = x * a1 + z2 - b1 * y;
+			z2 = x * a2 - b2 * y;
+			out[i] = y;
+		}
+#endif
+
+		bq->z1 = z1;
+		bq->z2 = z2;
+
+		src = out;
+	}
+}
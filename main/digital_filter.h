@@ -21,11 +21,26 @@
 #define DIGITAL_FILTER_H_
 
 #include <stdint.h>
+#include "conf_general.h"
 
+#ifdef USE_FIXMATH
+#include "fixmath.h"
+#endif
 
+/*
+ * With USE_FIXMATH the biquad coefficients and delay line are kept in
+ * Q16.16 so the per-sample path runs on integer multiplies only; the
+ * float in/out conversions at the API boundary are two operations
+ * against the nine inside the filter.
+ */
 typedef struct{
+#ifdef USE_FIXMATH
+	q16_t a0, a1, a2, b1, b2;
+	q16_t z1, z2;
+#else
 	float a0, a1, a2, b1, b2;
 	float z1, z2;
+#endif
 } Biquad;
 
 typedef enum {
@@ -33,6 +48,14 @@ typedef enum {
 	BQ_HIGHPASS
 } BiquadType;
 
+// Maximum number of biquad stages in a cascade
+#define BIQUAD_CASCADE_MAX_STAGES	4
+
+typedef struct {
+	Biquad stages[BIQUAD_CASCADE_MAX_STAGES];
+	int num_stages;
+} BiquadCascade;
+
 // Functions
 void filter_fft(int dir, int m, float *real, float *imag);
 void filter_dft(int dir, int len, float *real, float *imag);
@@ -45,5 +68,9 @@ void filter_add_sample(float *buffer, float sample, int bits, uint32_t *offset);
 float biquad_process(Biquad *biquad, float in);
 void biquad_config(Biquad *biquad, BiquadType type, float Fc);
 void biquad_reset(Biquad *biquad);
+void biquad_cascade_init(BiquadCascade *cascade);
+int biquad_cascade_add(BiquadCascade *cascade, BiquadType type, float Fc);
+void biquad_cascade_reset(BiquadCascade *cascade);
+void filter_run_block(BiquadCascade *cascade, const float *in, float *out, int n);
 
 #endif /* DIGITAL_FILTER_H_ */
@@ -71,6 +71,61 @@ static const uint8_t disp_ssd1306_init_sequence[19][5] = {
 		{2, 0x0, 0xAF}
 };
 
+/*
+ * Shadow of the panel framebuffer in page layout. Updates are diffed
+ * against it per page and only the changed column span of each page is
+ * transmitted, so a small text update is a few short I2C writes instead
+ * of the full 1 KB frame every time. The shadow is invalid until the
+ * panel content is known (after a clear or a full-frame write).
+ */
+static uint8_t m_shadow[1024];
+static bool m_shadow_valid = false;
+
+static void set_window(uint8_t col_start, uint8_t col_end, uint8_t page_start, uint8_t page_end) {
+	uint8_t cmd_col[4] = {0x00, 0x21, col_start, col_end};
+	uint8_t cmd_page[4] = {0x00, 0x22, page_start, page_end};
+	i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, cmd_col, 4, 2000);
+	i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, cmd_page, 4, 2000);
+}
+
+// Send the parts of buffer (0x40-prefixed page layout frame) that differ
+// from the shadow and bring the shadow up to date.
+static void send_updates(uint8_t *buffer) {
+	if (!m_shadow_valid) {
+		set_window(0, 127, 0, 7);
+		i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, buffer, 1025, 2000);
+		memcpy(m_shadow, &buffer[1], 1024);
+		m_shadow_valid = true;
+		return;
+	}
+
+	uint8_t tx[130];
+	for (int p = 0;p < 8;p++) {
+		uint8_t *n = &buffer[1 + p * 128];
+		uint8_t *s = &m_shadow[p * 128];
+
+		int c0 = -1;
+		int c1 = -1;
+		for (int c = 0;c < 128;c++) {
+			if (n[c] != s[c]) {
+				if (c0 < 0) {
+					c0 = c;
+				}
+				c1 = c;
+			}
+		}
+
+		if (c0 >= 0) {
+			int len = c1 - c0 + 1;
+			set_window((uint8_t)c0, (uint8_t)c1, (uint8_t)p, (uint8_t)p);
+			tx[0] = 0x40;
+			memcpy(&tx[1], &n[c0], len);
+			i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, tx, len + 1, 2000);
+			memcpy(&s[c0], &n[c0], len);
+		}
+	}
+}
+
 void disp_ssd1306_clear(uint32_t color) {
 
 	uint8_t *buffer = NULL;
@@ -79,7 +134,10 @@ void disp_ssd1306_clear(uint32_t color) {
 	buffer[0] = 0x40;
 
 	memset(&buffer[1], color ? 1 : 0 , 1024);
+	set_window(0, 127, 0, 7);
 	i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, buffer, 1025, 2000);
+	memcpy(m_shadow, &buffer[1], 1024);
+	m_shadow_valid = true;
 	free(buffer);
 }
 
@@ -89,21 +147,22 @@ void disp_ssd1306_reset(void) {
 				&disp_ssd1306_init_sequence[i][1],
 				disp_ssd1306_init_sequence[i][0], 2000);
 	}
+	m_shadow_valid = false;
 	disp_ssd1306_clear(0);
 }
 
 bool disp_ssd1306_render_image(image_buffer_t *img, uint16_t x, uint16_t y, color_t *colors) {
 	(void)colors;
 
-	uint32_t num_pix = img->width * img->height;
-
-	if (num_pix != 8192) return false;
+	if (img->fmt != indexed2) {
+		return false;
+	}
 
-	uint8_t *buffer = NULL;
+	uint32_t num_pix = img->width * img->height;
 
-	switch(img->fmt) {
-	case indexed2: {
-		buffer = malloc(1025);
+	if (num_pix == 8192) {
+		// Full frame; convert to page layout and send what changed.
+		uint8_t *buffer = malloc(1025);
 		if (!buffer) return false;
 		buffer[0] = 0x40;
 		int pos = 1;
@@ -126,13 +185,42 @@ bool disp_ssd1306_render_image(image_buffer_t *img, uint16_t x, uint16_t y, colo
 			}
 		}
 
-		i2c_master_write_to_device(0, DISPLAY_I2C_ADDRESS, buffer, 1025, 2000);
+		send_updates(buffer);
 		free(buffer);
+		return true;
 	}
-	break;
-	default:
+
+	// Region update: merge a smaller image into the shadow at (x, y) and
+	// send the changed pages. Only possible when the panel content is
+	// known; otherwise fail so the caller falls back to a full render.
+	if (!m_shadow_valid ||
+			x + img->width > DISPLAY_WIDTH ||
+			y + img->height > DISPLAY_HEIGHT) {
 		return false;
 	}
 
+	uint8_t *buffer = malloc(1025);
+	if (!buffer) return false;
+	buffer[0] = 0x40;
+	memcpy(&buffer[1], m_shadow, 1024);
+
+	for (int j = 0;j < img->height;j++) {
+		int py = y + j;
+		int page = py >> 3;
+		int page_bit = py & 0x7;
+		for (int i = 0;i < img->width;i++) {
+			int pos = j * img->width + i;
+			int pixel = (img->data[pos >> 3] >> (7 - (pos & 0x7))) & 1;
+			uint8_t *b = &buffer[1 + page * 128 + x + i];
+			if (pixel) {
+				*b |= (uint8_t)(1 << page_bit);
+			} else {
+				*b &= (uint8_t)~(1 << page_bit);
+			}
+		}
+	}
+
+	send_updates(buffer);
+	free(buffer);
 	return true;
 }
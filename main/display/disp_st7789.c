@@ -69,6 +69,25 @@ static uint16_t to_disp_color(uint32_t rgb) {
 	return color;
 }
 
+
+/*
+ * Plain colors do not depend on pixel position, so when every color the
+ * format can address is COLOR_REGULAR the palette can be converted to
+ * panel format once and each source byte unpacked directly, instead of
+ * running the full rgb888 conversion (including a division and a modulo
+ * for the gradient position) on every pixel. Returns false when a
+ * gradient color is present and the generic per-pixel path is needed.
+ */
+static bool plain_palette(color_t *colors, int num_colors, uint16_t *pal) {
+	for (int i = 0;i < num_colors;i++) {
+		if (colors[i].type != COLOR_REGULAR) {
+			return false;
+		}
+		pal[i] = to_disp_color((uint32_t)colors[i].color1);
+	}
+	return true;
+}
+
 static void blast_indexed2(image_buffer_t *img, color_t *colors) {
 	command_start(0x2C);
 	hwspi_data_stream_start();
@@ -76,19 +95,38 @@ static void blast_indexed2(image_buffer_t *img, color_t *colors) {
 	uint8_t *data = img->data;
 	int num_pix = img->width * img->height;
 
-	for (int i = 0; i < num_pix; i ++) {
-		int byte = i >> 3;
-		int bit  = 7 - (i & 0x7);
-		int color_ind = (data[byte] & (1 << bit)) >> bit;
-
-		uint16_t c = to_disp_color(
-				COLOR_TO_RGB888(colors[color_ind],
-						i % img->width, i / img->width));
-		hwspi_data_stream_write((uint8_t)c);
-		hwspi_data_stream_write((uint8_t)(c >> 8));
+	uint16_t pal[2];
+	if (plain_palette(colors, 2, pal)) {
+		int full_bytes = num_pix >> 3;
+		for (int i = 0;i < full_bytes;i++) {
+			uint8_t b = data[i];
+			for (int bit = 7;bit >= 0;bit--) {
+				uint16_t c = pal[(b >> bit) & 0x01];
+				hwspi_data_stream_write((uint8_t)c);
+				hwspi_data_stream_write((uint8_t)(c >> 8));
+			}
+		}
+		for (int i = full_bytes << 3;i < num_pix;i++) {
+			int bit = 7 - (i & 0x7);
+			uint16_t c = pal[(data[i >> 3] >> bit) & 0x01];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
+	} else {
+		for (int i = 0; i < num_pix; i ++) {
+			int byte = i >> 3;
+			int bit  = 7 - (i & 0x7);
+			int color_ind = (data[byte] & (1 << bit)) >> bit;
+
+			uint16_t c = to_disp_color(
+					COLOR_TO_RGB888(colors[color_ind],
+							i % img->width, i / img->width));
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 static void blast_indexed4(image_buffer_t *img, color_t *colors) {
@@ -98,19 +136,45 @@ static void blast_indexed4(image_buffer_t *img, color_t *colors) {
 	uint8_t *data = img->data;
 	int num_pix = img->width * img->height;
 
-	for (int i = 0; i < num_pix; i ++) {
-		int byte = i >> 2;
-		int bit = (3 - (i & 0x03)) * 2;
-		int color_ind = (data[byte] & (0x03 << bit)) >> bit;
-
-		uint16_t c = to_disp_color(
-				COLOR_TO_RGB888(colors[color_ind],
-						i % img->width, i / img->width));
-		hwspi_data_stream_write((uint8_t)c);
-		hwspi_data_stream_write((uint8_t)(c >> 8));
+	uint16_t pal[4];
+	if (plain_palette(colors, 4, pal)) {
+		int full_bytes = num_pix >> 2;
+		for (int i = 0;i < full_bytes;i++) {
+			uint8_t b = data[i];
+			uint16_t c = pal[(b >> 6) & 0x03];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+			c = pal[(b >> 4) & 0x03];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+			c = pal[(b >> 2) & 0x03];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+			c = pal[b & 0x03];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
+		for (int i = full_bytes << 2;i < num_pix;i++) {
+			int bit = (3 - (i & 0x03)) * 2;
+			uint16_t c = pal[(data[i >> 2] >> bit) & 0x03];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
+	} else {
+		for (int i = 0; i < num_pix; i ++) {
+			int byte = i >> 2;
+			int bit = (3 - (i & 0x03)) * 2;
+			int color_ind = (data[byte] & (0x03 << bit)) >> bit;
+
+			uint16_t c = to_disp_color(
+					COLOR_TO_RGB888(colors[color_ind],
+							i % img->width, i / img->width));
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 static void blast_indexed16(image_buffer_t *img, color_t *colors) {
@@ -120,18 +184,37 @@ static void blast_indexed16(image_buffer_t *img, color_t *colors) {
 	uint8_t *data = img->data;
 	int num_pix = img->width * img->height;
 
-	for (int i = 0; i < num_pix; i++) {
-		int byte = i >> 1;    // byte to access is pix / 2
-		int bit = (1 - (i & 0x01)) * 4; // bit position to access within byte
-		int color_ind = (data[byte] & (0x0F << bit)) >> bit; // extract 4 bit value.
-
-		uint16_t c = to_disp_color(
-				COLOR_TO_RGB888(colors[color_ind], i % img->width, i / img->width));
-		hwspi_data_stream_write((uint8_t)c);
-		hwspi_data_stream_write((uint8_t)(c >> 8));
+	uint16_t pal[16];
+	if (plain_palette(colors, 16, pal)) {
+		int full_bytes = num_pix >> 1;
+		for (int i = 0;i < full_bytes;i++) {
+			uint8_t b = data[i];
+			uint16_t c = pal[(b >> 4) & 0x0F];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+			c = pal[b & 0x0F];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
+		if (num_pix & 1) {
+			uint16_t c = pal[(data[num_pix >> 1] >> 4) & 0x0F];
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
+	} else {
+		for (int i = 0; i < num_pix; i++) {
+			int byte = i >> 1;    // byte to access is pix / 2
+			int bit = (1 - (i & 0x01)) * 4; // bit position to access within byte
+			int color_ind = (data[byte] & (0x0F << bit)) >> bit; // extract 4 bit value.
+
+			uint16_t c = to_disp_color(
+					COLOR_TO_RGB888(colors[color_ind], i % img->width, i / img->width));
+			hwspi_data_stream_write((uint8_t)c);
+			hwspi_data_stream_write((uint8_t)(c >> 8));
+		}
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 
@@ -150,7 +233,7 @@ static void blast_rgb332(uint8_t *data, uint32_t num_pix) {
 		hwspi_data_stream_write((uint8_t)(disp >> 8));
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 static void blast_rgb565(uint8_t *data, uint32_t num_pix) {
@@ -170,7 +253,7 @@ static void blast_rgb565(uint8_t *data, uint32_t num_pix) {
 		hwspi_data_stream_write((uint8_t)(disp >> 8));
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 static void blast_rgb888(uint8_t *data, uint32_t num_pix) {
@@ -189,7 +272,7 @@ static void blast_rgb888(uint8_t *data, uint32_t num_pix) {
 		hwspi_data_stream_write((uint8_t)(disp >> 8));
 	}
 
-	hwspi_data_stream_finish();
+	hwspi_data_stream_finish_async();
 }
 
 bool disp_st7789_render_image(image_buffer_t *img, uint16_t x, uint16_t y, color_t *colors) {
@@ -236,7 +319,7 @@ bool disp_st7789_render_image(image_buffer_t *img, uint16_t x, uint16_t y, color
 	default:
 		break;
 	}
-	hwspi_end();
+	hwspi_end_async();
 
 	return true;
 }
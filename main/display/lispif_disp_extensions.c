@@ -26,6 +26,7 @@
 #include "lbm_custom_type.h"
 #include "commands.h"
 #include "utils.h"
+#include "perf.h"
 
 #include "display/disp_sh8501b.h"
 #include "display/disp_ili9341.h"
@@ -37,6 +38,126 @@
 #include "display/disp_icna3306.h"
 
 #include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+/*
+ * Render queue. Rendering an image runs the color conversion and the SPI
+ * push, which for a full frame takes longer than most script iterations.
+ * Instead of doing that in the evaluator context, disp-render copies the
+ * image data and color list into a command that a dedicated task feeds to
+ * the display driver. The script continues evaluating (typically drawing
+ * the next frame) while the previous one is pushed, and disp-sync blocks
+ * until all queued frames have reached the panel. Colors with
+ * precalculated gradients point into lbm memory that the queue cannot
+ * keep alive, so those renders (and renders the heap cannot stage) fall
+ * back to running synchronously.
+ */
+
+#define RENDER_QUEUE_LEN		2
+
+typedef struct {
+	image_buffer_t img;
+	uint16_t x;
+	uint16_t y;
+	color_t colors[16];
+} render_cmd_t;
+
+static bool(*m_render_fun)(image_buffer_t *img, uint16_t x, uint16_t y, color_t *colors) = 0;
+static void(*m_clear_fun)(uint32_t color) = 0;
+static void(*m_reset_fun)(void) = 0;
+
+static QueueHandle_t m_render_queue = NULL;
+static volatile int m_renders_pending = 0;
+
+static void render_task(void *arg) {
+	(void)arg;
+	for (;;) {
+		render_cmd_t *cmd = 0;
+		if (xQueueReceive(m_render_queue, &cmd, portMAX_DELAY) == pdTRUE) {
+			PERF_ENTER(disp_render);
+			m_render_fun(&cmd->img, cmd->x, cmd->y, cmd->colors);
+			PERF_EXIT(disp_render);
+			free(cmd);
+			m_renders_pending--;
+		}
+	}
+}
+
+static void render_sync(void) {
+	while (m_renders_pending > 0) {
+		vTaskDelay(1);
+	}
+}
+
+static bool render_enqueue(image_buffer_t *img, uint16_t x, uint16_t y, color_t *colors) {
+	bool precalc = false;
+	for (int i = 0;i < 16;i++) {
+		if (colors[i].precalc) {
+			precalc = true;
+			break;
+		}
+	}
+
+	render_cmd_t *cmd = NULL;
+	uint32_t data_size = image_dims_to_size_bytes(img->fmt, img->width, img->height);
+	if (!precalc) {
+		cmd = malloc(sizeof(render_cmd_t) + data_size);
+	}
+
+	if (!cmd) {
+		return m_render_fun(img, x, y, colors);
+	}
+
+	cmd->img = *img;
+	cmd->img.data = (uint8_t*)cmd + sizeof(render_cmd_t);
+	cmd->img.mem_base = cmd->img.data;
+	memcpy(cmd->img.data, img->data, data_size);
+	cmd->x = x;
+	cmd->y = y;
+	memcpy(cmd->colors, colors, sizeof(cmd->colors));
+
+	m_renders_pending++;
+	xQueueSend(m_render_queue, &cmd, portMAX_DELAY);
+
+	return true;
+}
+
+// Clear and reset must not overtake frames that are already queued.
+static void render_clear(uint32_t color) {
+	render_sync();
+	m_clear_fun(color);
+}
+
+static void render_reset(void) {
+	render_sync();
+	m_reset_fun();
+}
+
+static void disp_register_callbacks(
+		bool(*render)(image_buffer_t *img, uint16_t x, uint16_t y, color_t *colors),
+		void(*clear)(uint32_t color),
+		void(*reset)(void)) {
+	if (m_render_queue) {
+		render_sync();
+	} else {
+		m_render_queue = xQueueCreate(RENDER_QUEUE_LEN, sizeof(render_cmd_t*));
+		xTaskCreatePinnedToCore(render_task, "disp_render", 3072, NULL, 7, NULL, tskNO_AFFINITY);
+	}
+
+	m_render_fun = render;
+	m_clear_fun = clear;
+	m_reset_fun = reset;
+
+	lbm_display_extensions_set_callbacks(
+			render_enqueue,
+			render_clear,
+			render_reset);
+}
 
 // Display Drivers
 
@@ -95,7 +216,7 @@ static lbm_value ext_disp_load_sh8501b(lbm_value *args, lbm_uint argn) {
 
 	disp_sh8501b_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_sh8501b_render_image,
 			disp_sh8501b_clear,
 			disp_sh8501b_reset);
@@ -131,7 +252,7 @@ static lbm_value ext_disp_load_ili9341(lbm_value *args, lbm_uint argn) {
 
 	disp_ili9341_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, gpio_dc, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_ili9341_render_image,
 			disp_ili9341_clear,
 			disp_ili9341_reset);
@@ -157,7 +278,7 @@ static lbm_value ext_disp_load_ssd1306(lbm_value *args, lbm_uint argn) {
 	}
 
 	disp_ssd1306_init(gpio_sda, gpio_scl, clk_speed);
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_ssd1306_render_image,
 			disp_ssd1306_clear,
 			disp_ssd1306_reset);
@@ -192,7 +313,7 @@ static lbm_value ext_disp_load_st7789(lbm_value *args, lbm_uint argn) {
 
 	disp_st7789_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, gpio_dc, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_st7789_render_image,
 			disp_st7789_clear,
 			disp_st7789_reset);
@@ -228,7 +349,7 @@ static lbm_value ext_disp_load_ili9488(lbm_value *args, lbm_uint argn) {
 
 	disp_ili9488_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, gpio_dc, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_ili9488_render_image,
 			disp_ili9488_clear,
 			disp_ili9488_reset);
@@ -261,7 +382,7 @@ static lbm_value ext_disp_load_st7735(lbm_value *args, lbm_uint argn) {
 	}
 
 	disp_st7735_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, gpio_dc, spi_mhz);
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_st7735_render_image,
 			disp_st7735_clear,
 			disp_st7735_reset);
@@ -296,7 +417,7 @@ static lbm_value ext_disp_load_ssd1351(lbm_value *args, lbm_uint argn) {
 
 	disp_ssd1351_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, gpio_dc, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_ssd1351_render_image,
 			disp_ssd1351_clear,
 			disp_ssd1351_reset);
@@ -330,7 +451,7 @@ static lbm_value ext_disp_load_icna3306(lbm_value *args, lbm_uint argn) {
 
 	disp_icna3306_init(gpio_sd0, gpio_clk, gpio_cs, gpio_reset, spi_mhz);
 
-	lbm_display_extensions_set_callbacks(
+	disp_register_callbacks(
 			disp_icna3306_render_image,
 			disp_icna3306_clear,
 			disp_icna3306_reset);
@@ -338,6 +459,297 @@ static lbm_value ext_disp_load_icna3306(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+/*
+ * Retained sprite compositor. Dashboards that rebuild a scene from
+ * dozens of script-level draw calls per frame spend most of the frame
+ * in the interpreter. Sprites are registered once (the pixel data is
+ * copied, so the script-side buffer can be dropped and the compositor
+ * is unaffected by garbage collection), after which the script only
+ * updates position, z order and visibility, and a single disp-compose
+ * call paints all visible sprites into a target image buffer C-side.
+ * The raw pixel value given as transparent at creation (for indexed
+ * formats the palette index) is skipped when painting, and drawing is
+ * clipped against the target by putpixel.
+ */
+
+#define COMPOSE_MAX_SPRITES		16
+
+typedef struct {
+	bool used;
+	bool visible;
+	int16_t x;
+	int16_t y;
+	int16_t z;
+	int32_t transparent; // Source pixel value treated as transparent, -1 for none
+	image_buffer_t img; // Pixel data owned by the compositor
+} sprite_t;
+
+static sprite_t m_sprites[COMPOSE_MAX_SPRITES];
+
+static sprite_t *get_sprite(lbm_value v) {
+	if (!lbm_is_number(v)) {
+		return NULL;
+	}
+	int id = lbm_dec_as_i32(v);
+	if (id < 0 || id >= COMPOSE_MAX_SPRITES || !m_sprites[id].used) {
+		return NULL;
+	}
+	return &m_sprites[id];
+}
+
+static lbm_value ext_disp_sprite_create(lbm_value *args, lbm_uint argn) {
+	lbm_array_header_t *arr;
+	if ((argn == 4 || argn == 5) &&
+			(arr = get_image_buffer(args[0])) &&
+			lbm_is_number(args[1]) &&
+			lbm_is_number(args[2]) &&
+			lbm_is_number(args[3]) &&
+			(argn == 4 || lbm_is_number(args[4]))) {
+
+		int id = -1;
+		for (int i = 0;i < COMPOSE_MAX_SPRITES;i++) {
+			if (!m_sprites[i].used) {
+				id = i;
+				break;
+			}
+		}
+
+		if (id < 0) {
+			lbm_set_error_reason("All sprite slots are in use");
+			return ENC_SYM_EERROR;
+		}
+
+		uint8_t *data = (uint8_t*)arr->data;
+		uint16_t w = image_buffer_width(data);
+		uint16_t h = image_buffer_height(data);
+		color_format_t fmt = (color_format_t)image_buffer_format(data);
+
+		uint32_t size = image_dims_to_size_bytes(fmt, w, h);
+		uint8_t *copy = malloc(size);
+		if (!copy) {
+			return ENC_SYM_MERROR;
+		}
+		memcpy(copy, image_buffer_data(data), size);
+
+		sprite_t *s = &m_sprites[id];
+		s->img.fmt = fmt;
+		s->img.width = w;
+		s->img.height = h;
+		s->img.mem_base = copy;
+		s->img.data = copy;
+		s->x = (int16_t)lbm_dec_as_i32(args[1]);
+		s->y = (int16_t)lbm_dec_as_i32(args[2]);
+		s->z = (int16_t)lbm_dec_as_i32(args[3]);
+		s->transparent = argn == 5 ? lbm_dec_as_i32(args[4]) : -1;
+		s->visible = true;
+		s->used = true;
+
+		return lbm_enc_i(id);
+	}
+	return ENC_SYM_TERROR;
+}
+
+static lbm_value ext_disp_sprite_pos(lbm_value *args, lbm_uint argn) {
+	sprite_t *s;
+	if (argn == 3 &&
+			(s = get_sprite(args[0])) &&
+			lbm_is_number(args[1]) &&
+			lbm_is_number(args[2])) {
+		s->x = (int16_t)lbm_dec_as_i32(args[1]);
+		s->y = (int16_t)lbm_dec_as_i32(args[2]);
+		return ENC_SYM_TRUE;
+	}
+	return ENC_SYM_TERROR;
+}
+
+static lbm_value ext_disp_sprite_z(lbm_value *args, lbm_uint argn) {
+	sprite_t *s;
+	if (argn == 2 &&
+			(s = get_sprite(args[0])) &&
+			lbm_is_number(args[1])) {
+		s->z = (int16_t)lbm_dec_as_i32(args[1]);
+		return ENC_SYM_TRUE;
+	}
+	return ENC_SYM_TERROR;
+}
+
+static lbm_value ext_disp_sprite_visible(lbm_value *args, lbm_uint argn) {
+	sprite_t *s;
+	if (argn == 2 && (s = get_sprite(args[0]))) {
+		s->visible = !lbm_is_symbol_nil(args[1]);
+		return ENC_SYM_TRUE;
+	}
+	return ENC_SYM_TERROR;
+}
+
+static void sprite_delete_all(void) {
+	for (int i = 0;i < COMPOSE_MAX_SPRITES;i++) {
+		if (m_sprites[i].used) {
+			free(m_sprites[i].img.mem_base);
+			m_sprites[i].used = false;
+		}
+	}
+}
+
+static lbm_value ext_disp_sprite_delete(lbm_value *args, lbm_uint argn) {
+	if (argn == 0) {
+		sprite_delete_all();
+		return ENC_SYM_TRUE;
+	}
+
+	sprite_t *s;
+	if (argn == 1 && (s = get_sprite(args[0]))) {
+		free(s->img.mem_base);
+		s->used = false;
+		return ENC_SYM_TRUE;
+	}
+	return ENC_SYM_TERROR;
+}
+
+static lbm_value ext_disp_compose(lbm_value *args, lbm_uint argn) {
+	lbm_array_header_t *arr;
+	if (argn == 1 && (arr = get_image_buffer(args[0]))) {
+		uint8_t *data = (uint8_t*)arr->data;
+
+		image_buffer_t tgt;
+		tgt.fmt = (color_format_t)image_buffer_format(data);
+		tgt.width = image_buffer_width(data);
+		tgt.height = image_buffer_height(data);
+		tgt.mem_base = data;
+		tgt.data = image_buffer_data(data);
+
+		// Painter's order, lowest z first. The sprite count is small
+		// enough that a selection scan per sprite is fine.
+		bool done[COMPOSE_MAX_SPRITES] = {false};
+		for (;;) {
+			int best = -1;
+			for (int i = 0;i < COMPOSE_MAX_SPRITES;i++) {
+				sprite_t *s = &m_sprites[i];
+				if (!s->used || !s->visible || done[i]) {
+					continue;
+				}
+				if (best < 0 || s->z < m_sprites[best].z) {
+					best = i;
+				}
+			}
+
+			if (best < 0) {
+				break;
+			}
+			done[best] = true;
+
+			sprite_t *s = &m_sprites[best];
+			for (int j = 0;j < s->img.height;j++) {
+				for (int i = 0;i < s->img.width;i++) {
+					uint32_t c = getpixel(&s->img, i, j);
+					if ((int32_t)c != s->transparent) {
+						putpixel(&tgt, s->x + i, s->y + j, c);
+					}
+				}
+			}
+		}
+
+		return ENC_SYM_TRUE;
+	}
+	return ENC_SYM_TERROR;
+}
+
+static lbm_value ext_disp_sync(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	render_sync();
+	return ENC_SYM_TRUE;
+}
+
+
+/*
+ * Display benchmark. Runs standard scenes directly against the active
+ * driver callbacks, bypassing the render queue so driver performance is
+ * what gets measured. Reports frame rate, payload bandwidth (assuming a
+ * 16-bit panel format) and the share of wall time spent inside the
+ * driver call. With asynchronous transfer completion the driver returns
+ * before DMA drains, which legitimately shows up as cpu below 100 even
+ * when the bus is saturated.
+ */
+bool lispif_disp_benchmark(uint16_t w, uint16_t h) {
+	if (!m_render_fun || w < 32 || h < 32) {
+		return false;
+	}
+
+	render_sync();
+
+	static const char *scene_names[] = {"fill ix2", "blit ix4", "partial 32x32"};
+
+	for (int scene = 0;scene < 3;scene++) {
+		color_format_t fmt = scene == 1 ? indexed4 : indexed2;
+		uint16_t sw = scene == 2 ? 32 : w;
+		uint16_t sh = scene == 2 ? 32 : h;
+		int frames = scene == 2 ? 256 : 32;
+
+		uint32_t size = image_dims_to_size_bytes(fmt, sw, sh);
+		uint8_t *data = malloc(size);
+		if (!data) {
+			return false;
+		}
+
+		image_buffer_t img;
+		img.fmt = fmt;
+		img.width = sw;
+		img.height = sh;
+		img.mem_base = data;
+		img.data = data;
+
+		color_t colors[16];
+		memset(colors, 0, sizeof(colors));
+		for (int i = 0;i < 16;i++) {
+			colors[i].color1 = i * 0x111111;
+		}
+
+		int64_t busy = 0;
+		int64_t start = esp_timer_get_time();
+		for (int f = 0;f < frames;f++) {
+			// New content every frame so diffing drivers cannot skip work.
+			memset(data, (uint8_t)(0x55 << (f & 1)), size);
+
+			uint16_t x = 0;
+			uint16_t y = 0;
+			if (scene == 2) {
+				x = (uint16_t)((f * 8) % (w - 32));
+				y = (uint16_t)((f * 4) % (h - 32));
+			}
+
+			int64_t t0 = esp_timer_get_time();
+			m_render_fun(&img, x, y, colors);
+			busy += esp_timer_get_time() - t0;
+		}
+		int64_t wall = esp_timer_get_time() - start;
+		free(data);
+
+		if (wall <= 0) {
+			wall = 1;
+		}
+
+		float fps = (float)frames * 1.0e6f / (float)wall;
+		float mbps = fps * (float)sw * (float)sh * 2.0f / 1.0e6f;
+		float cpu = 100.0f * (float)busy / (float)wall;
+
+		commands_printf("%-14s: %6.1f fps, %6.2f MB/s, cpu %5.1f %%",
+				scene_names[scene], (double)fps, (double)mbps, (double)cpu);
+	}
+	commands_printf(" ");
+
+	return true;
+}
+
+static lbm_value ext_disp_bench(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN_NUMBER(2);
+	if (!lispif_disp_benchmark(
+			(uint16_t)lbm_dec_as_u32(args[0]),
+			(uint16_t)lbm_dec_as_u32(args[1]))) {
+		return ENC_SYM_NIL;
+	}
+	return ENC_SYM_TRUE;
+}
+
 void lispif_load_disp_extensions(void) {
 
 	lbm_display_extensions_init();
@@ -350,5 +762,16 @@ void lispif_load_disp_extensions(void) {
 	lbm_add_extension("disp-load-st7735", ext_disp_load_st7735);
 	lbm_add_extension("disp-load-ssd1351", ext_disp_load_ssd1351);
 	lbm_add_extension("disp-load-icna3306", ext_disp_load_icna3306);
+	lbm_add_extension("disp-sync", ext_disp_sync);
+
+	sprite_delete_all();
+	lbm_add_extension("disp-sprite-create", ext_disp_sprite_create);
+	lbm_add_extension("disp-sprite-pos", ext_disp_sprite_pos);
+	lbm_add_extension("disp-sprite-z", ext_disp_sprite_z);
+	lbm_add_extension("disp-sprite-visible", ext_disp_sprite_visible);
+	lbm_add_extension("disp-sprite-delete", ext_disp_sprite_delete);
+	lbm_add_extension("disp-compose", ext_disp_compose);
+
+	lbm_add_extension("disp-bench", ext_disp_bench);
 }
 
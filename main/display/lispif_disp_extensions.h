@@ -29,4 +29,8 @@
 
 void lispif_load_disp_extensions(void);
 
+// Run the display benchmark scenes against the loaded driver and print
+// the results. Returns false when no driver is loaded.
+bool lispif_disp_benchmark(uint16_t w, uint16_t h);
+
 #endif
@@ -22,6 +22,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/i2c.h"
+#include "esp_timer.h"
 #include <string.h>
 
 // Private variables
@@ -32,8 +33,14 @@ static float m_last_pres = 0.0;
 static volatile bool mutex_init = false;
 static SemaphoreHandle_t i2c_mutex;
 
+static struct bme280_dev m_dev;
+static uint8_t m_dev_addr = BME280_I2C_ADDR_PRIM;
+static uint32_t m_req_delay = 0;
+static esp_timer_handle_t m_timer = NULL;
+
 // Private functions
-static void bme_task(void *arg);
+static void bme_setup_task(void *arg);
+static void bme_timer_cb(void *arg);
 
 void bme280_if_init(int pin_sda, int pin_scl) {
 	i2c_config_t conf = {
@@ -48,13 +55,13 @@ void bme280_if_init(int pin_sda, int pin_scl) {
 	i2c_param_config(0, &conf);
 	i2c_driver_install(0, conf.mode, 0, 0, 0);
 
-	xTaskCreatePinnedToCore(bme_task, "BME280", 1536, NULL, 6, NULL, tskNO_AFFINITY);
+	xTaskCreatePinnedToCore(bme_setup_task, "BME280", 1536, NULL, 6, NULL, tskNO_AFFINITY);
 }
 
 void bme280_if_init_with_mutex(SemaphoreHandle_t mutex) {
 	mutex_init = true;
 	i2c_mutex = mutex;
-	xTaskCreatePinnedToCore(bme_task, "BME280", 1536, NULL, 6, NULL, tskNO_AFFINITY);
+	xTaskCreatePinnedToCore(bme_setup_task, "BME280", 1536, NULL, 6, NULL, tskNO_AFFINITY);
 }
 
 float bme280_if_get_hum(void) {
@@ -113,38 +120,61 @@ static int8_t user_i2c_write(uint8_t reg_addr, const uint8_t *reg_data, uint32_t
 	return res == ESP_OK ? 0 : -1; // Return 0 for Success, non-zero for failure
 }
 
-static void bme_task(void *arg) {
-	struct bme280_dev dev;
-	uint8_t dev_addr = BME280_I2C_ADDR_PRIM;
-
-	dev.intf_ptr = &dev_addr;
-	dev.intf = BME280_I2C_INTF;
-	dev.read = user_i2c_read;
-	dev.write = user_i2c_write;
-	dev.delay_us = user_delay_us;
-
-	bme280_init(&dev);
-
-	dev.settings.osr_h = BME280_OVERSAMPLING_1X;
-	dev.settings.osr_p = BME280_OVERSAMPLING_16X;
-	dev.settings.osr_t = BME280_OVERSAMPLING_2X;
-	dev.settings.filter = BME280_FILTER_COEFF_16;
+/*
+ * Conversions run as an asynchronous pipeline: a one-shot esp_timer fires
+ * when the current forced-mode conversion is done, the callback reads out
+ * and caches the result and kicks off the next conversion. Readers only
+ * ever touch the cached values, so nothing blocks for the conversion time
+ * anywhere. The setup task just brings the sensor up, starts the pipeline
+ * and exits.
+ */
+static void bme_timer_cb(void *arg) {
+	(void)arg;
 
-	uint8_t settings_sel;
-	uint32_t req_delay;
 	struct bme280_data comp_data;
+	if (bme280_get_sensor_data(BME280_ALL, &comp_data, &m_dev) == BME280_OK) {
+		// Fixed-point compensation (BME280_64BIT_ENABLE): humidity in
+		// 1/1024 %RH, temperature in 0.01 degC, pressure in 1/256 Pa.
+		m_last_hum = (float)comp_data.humidity / 1024.0;
+		m_last_temp = (float)comp_data.temperature / 100.0;
+		m_last_pres = (float)comp_data.pressure / 256.0;
+	}
 
-	settings_sel = BME280_OSR_PRESS_SEL | BME280_OSR_TEMP_SEL | BME280_OSR_HUM_SEL | BME280_FILTER_SEL;
-	bme280_set_sensor_settings(settings_sel, &dev);
-	req_delay = bme280_cal_meas_delay(&dev.settings);
-
-	for(;;) {
-		bme280_set_sensor_mode(BME280_FORCED_MODE, &dev);
-		vTaskDelay(req_delay / portTICK_PERIOD_MS);
+	bme280_set_sensor_mode(BME280_FORCED_MODE, &m_dev);
+	esp_timer_start_once(m_timer, (uint64_t)m_req_delay * 1000);
+}
 
-		bme280_get_sensor_data(BME280_ALL, &comp_data, &dev);
-		m_last_hum = comp_data.humidity;
-		m_last_temp = comp_data.temperature;
-		m_last_pres = comp_data.pressure;
+static void bme_setup_task(void *arg) {
+	(void)arg;
+
+	m_dev.intf_ptr = &m_dev_addr;
+	m_dev.intf = BME280_I2C_INTF;
+	m_dev.read = user_i2c_read;
+	m_dev.write = user_i2c_write;
+	m_dev.delay_us = user_delay_us;
+
+	if (bme280_init(&m_dev) == BME280_OK) {
+		m_dev.settings.osr_h = BME280_OVERSAMPLING_1X;
+		m_dev.settings.osr_p = BME280_OVERSAMPLING_16X;
+		m_dev.settings.osr_t = BME280_OVERSAMPLING_2X;
+		m_dev.settings.filter = BME280_FILTER_COEFF_16;
+
+		uint8_t settings_sel = BME280_OSR_PRESS_SEL | BME280_OSR_TEMP_SEL |
+				BME280_OSR_HUM_SEL | BME280_FILTER_SEL;
+		bme280_set_sensor_settings(settings_sel, &m_dev);
+		m_req_delay = bme280_cal_meas_delay(&m_dev.settings);
+
+		if (m_timer == NULL) {
+			const esp_timer_create_args_t timer_args = {
+					.callback = bme_timer_cb,
+					.name = "bme280",
+			};
+			esp_timer_create(&timer_args, &m_timer);
+		}
+
+		bme280_set_sensor_mode(BME280_FORCED_MODE, &m_dev);
+		esp_timer_start_once(m_timer, (uint64_t)m_req_delay * 1000);
 	}
+
+	vTaskDelete(NULL);
 }
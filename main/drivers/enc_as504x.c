@@ -20,6 +20,7 @@
 
 #include "enc_as504x.h"
 #include "utils.h"
+#include "samp_stats.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
@@ -65,14 +66,62 @@ bool enc_as504x_init(AS504x_config_t *cfg) {
 }
 
 void enc_as504x_deinit(AS504x_config_t *cfg) {
+	enc_as504x_stop_sampling(cfg);
 	spi_bb_deinit(&(cfg->sw_spi));
 	cfg->state.last_enc_angle = 0.0;
 	cfg->state.spi_error_rate = 0.0;
 }
 
+/*
+ * Timer-paced background sampling. The esp_timer callback runs the normal
+ * read routine at the configured rate and the result lands in
+ * state.last_enc_angle, which acts as the latest-value cell: an aligned
+ * 32-bit float store is atomic on this architecture, so readers just load
+ * it without locking. While sampling is running, enc_as504x_read_angle
+ * returns the cached angle instead of doing an SPI transaction of its own.
+ */
+static void sample_timer_cb(void *arg) {
+	enc_as504x_routine((AS504x_config_t*)arg);
+}
+
+bool enc_as504x_start_sampling(AS504x_config_t *cfg, int rate_hz) {
+	if (rate_hz < 1 || rate_hz > 10000) {
+		return false;
+	}
+
+	if (cfg->sample_timer == NULL) {
+		const esp_timer_create_args_t timer_args = {
+				.callback = sample_timer_cb,
+				.arg = cfg,
+				.name = "as504x",
+		};
+		if (esp_timer_create(&timer_args, &cfg->sample_timer) != ESP_OK) {
+			return false;
+		}
+	} else {
+		esp_timer_stop(cfg->sample_timer);
+	}
+
+	if (esp_timer_start_periodic(cfg->sample_timer, 1000000 / rate_hz) != ESP_OK) {
+		return false;
+	}
+
+	cfg->sampling = true;
+	return true;
+}
+
+void enc_as504x_stop_sampling(AS504x_config_t *cfg) {
+	if (cfg->sample_timer != NULL) {
+		esp_timer_stop(cfg->sample_timer);
+	}
+	cfg->sampling = false;
+}
+
 void enc_as504x_routine(AS504x_config_t *cfg) {
 	uint16_t pos;
 
+	samp_stats_add(SAMP_SRC_ENC);
+
 	float timestep = UTILS_AGE_S(cfg->state.last_update_time);
 	if (timestep > 1.0) {
 		timestep = 1.0;
@@ -141,7 +190,9 @@ void enc_as504x_routine(AS504x_config_t *cfg) {
 }
 
 float enc_as504x_read_angle(AS504x_config_t *cfg) {
-	enc_as504x_routine(cfg);
+	if (!cfg->sampling) {
+		enc_as504x_routine(cfg);
+	}
 	return cfg->state.last_enc_angle;
 }
 
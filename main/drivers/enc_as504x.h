@@ -24,6 +24,7 @@
 #include "stdint.h"
 #include "stdbool.h"
 #include "spi_bb.h"
+#include "esp_timer.h"
 
 typedef struct {
 	uint8_t is_connected;
@@ -54,10 +55,14 @@ typedef struct {
 typedef struct {
 	spi_bb_state sw_spi;
 	AS504x_state state;
+	esp_timer_handle_t sample_timer;
+	volatile bool sampling;
 } AS504x_config_t;
 
 // Functions
 bool enc_as504x_init(AS504x_config_t *AS504x_config);
+bool enc_as504x_start_sampling(AS504x_config_t *AS504x_config, int rate_hz);
+void enc_as504x_stop_sampling(AS504x_config_t *AS504x_config);
 void enc_as504x_deinit(AS504x_config_t *cfg);
 void enc_as504x_routine(AS504x_config_t *cfg);
 float enc_as504x_read_angle(AS504x_config_t *cfg);
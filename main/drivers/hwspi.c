@@ -21,6 +21,8 @@
 #include "hwspi.h"
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "soc/gpio_struct.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
@@ -46,10 +48,55 @@ static bool m_init_done = false;
 static spi_bus_config_t m_buscfg = {0};
 static spi_device_interface_config_t m_devcfg = {0};
 
+/*
+ * Asynchronous stream completion. The last chunk of a stream can be
+ * queued instead of sent with a polling transaction, which lets the
+ * caller continue (e.g. the LispBM evaluator rendering the next frame)
+ * while DMA drains the remaining buffers. CS is deasserted and the
+ * send-done callback invoked from the SPI post-transaction interrupt
+ * when the marked final chunk has been clocked out. The bus stays
+ * acquired until hwspi_wait_done, which hwspi_begin calls first, so no
+ * other traffic can interleave with the tail of the frame.
+ */
+static volatile bool m_async_pending = false;	// Bus held, stream finishing in the background
+static volatile bool m_done_cb_pending = false;	// Send-done callback not yet invoked
+static void(* volatile m_send_done_cb)(void) = 0;
+static int m_queued = 0;						// Queued transactions with uncollected results
+
+#define HWSPI_SEND_TRANS		3
+static spi_transaction_t m_send_trans[HWSPI_SEND_TRANS];
+static int m_send_trans_next = 0;
+
+// Bus clients, see hwspi.h. The waiting counter is bumped by priority
+// clients before they go for the bus, which makes the stream side yield
+// at the next chunk boundary.
+typedef struct {
+	spi_device_handle_t dev;
+	bool used;
+	bool prio;
+} hwspi_client;
+
+static hwspi_client m_clients[HWSPI_CLIENTS_MAX] = {0};
+static volatile int m_prio_waiting = 0;
+
 // Global variables
 uint8_t *hwspi_buffer_pointer = 0;
 int *hwspi_buffer_pos = 0;
 
+static void hwspi_post_trans_cb(spi_transaction_t *t) {
+	// Only the final chunk of an asynchronously finished stream has the
+	// user field set.
+	if (t->user) {
+		SET_CS();
+		if (m_done_cb_pending) {
+			m_done_cb_pending = false;
+			if (m_send_done_cb) {
+				m_send_done_cb();
+			}
+		}
+	}
+}
+
 void hwspi_init(int clk_mhz, int mode,
 		int pin_miso, int pin_mosi, int pin_clk, int pin_cs) {
 
@@ -74,6 +121,7 @@ void hwspi_init(int clk_mhz, int mode,
 	m_devcfg.flags = 0;
 	m_devcfg.queue_size = 1; // Must be 1, otherwise multiple buffers will be queued at the same time
 	m_devcfg.pre_cb = NULL;
+	m_devcfg.post_cb = hwspi_post_trans_cb;
 
 	gpio_config_t gpconf = {0};
 	gpconf.pin_bit_mask = BIT(m_pin_cs);
@@ -89,6 +137,10 @@ void hwspi_init(int clk_mhz, int mode,
 		static spi_transaction_t *tmp_ptr = 0;
 		spi_device_get_trans_result(m_spi, &tmp_ptr, 0);
 		spi_device_get_trans_result(m_spi, &tmp_ptr, 0);
+		m_queued = 0;
+		m_async_pending = false;
+		m_done_cb_pending = false;
+		m_send_trans_next = 0;
 		spi_bus_remove_device(m_spi);
 #ifndef SD_PIN_MOSI
 		spi_bus_free(SPI2_HOST);
@@ -104,6 +156,43 @@ void hwspi_init(int clk_mhz, int mode,
 }
 
 void hwspi_begin(void) {
+	if (m_async_pending) {
+		hwspi_wait_done();
+	}
+
+	// Don't grab the bus for a new bulk stream while a priority client
+	// is waiting for it.
+	while (m_prio_waiting > 0) {
+		vTaskDelay(1);
+	}
+
+	spi_device_acquire_bus(m_spi, portMAX_DELAY);
+	CLEAR_CS();
+}
+
+/*
+ * Let waiting priority clients onto the bus at a chunk boundary. The
+ * queued chunks are drained first, then CS is raised and the bus
+ * released until the waiters are done. The display controllers used
+ * with this driver continue an interrupted pixel stream when CS is
+ * reasserted, so a frame can be paused mid-stream without corruption.
+ */
+static void yield_to_prio(void) {
+	spi_transaction_t *tmp_ptr;
+	while (m_queued > 0) {
+		if (spi_device_get_trans_result(m_spi, &tmp_ptr, portMAX_DELAY) != ESP_OK) {
+			break;
+		}
+		m_queued--;
+	}
+
+	SET_CS();
+	spi_device_release_bus(m_spi);
+
+	while (m_prio_waiting > 0) {
+		vTaskDelay(1);
+	}
+
 	spi_device_acquire_bus(m_spi, portMAX_DELAY);
 	CLEAR_CS();
 }
@@ -113,13 +202,63 @@ void hwspi_end(void) {
 	spi_device_release_bus(m_spi);
 }
 
+void hwspi_end_async(void) {
+	if (!m_async_pending) {
+		// Nothing was queued asynchronously, end as usual.
+		hwspi_end();
+		return;
+	}
+#ifdef SD_PIN_MOSI
+	// The SPI bus is shared with the SD card on this hardware. Holding
+	// it between frames would starve logging, so complete synchronously.
+	hwspi_wait_done();
+#endif
+}
+
+void hwspi_wait_done(void) {
+	spi_transaction_t *tmp_ptr;
+	while (m_queued > 0) {
+		if (spi_device_get_trans_result(m_spi, &tmp_ptr, portMAX_DELAY) != ESP_OK) {
+			break;
+		}
+		m_queued--;
+	}
+
+	if (m_async_pending) {
+		SET_CS(); // No-op when the post-transaction callback already deasserted.
+		if (m_done_cb_pending) {
+			m_done_cb_pending = false;
+			if (m_send_done_cb) {
+				m_send_done_cb();
+			}
+		}
+		spi_device_release_bus(m_spi);
+		m_async_pending = false;
+	}
+}
+
+void hwspi_set_send_done_callback(void (*cb)(void)) {
+	m_send_done_cb = cb;
+}
+
 void hwspi_swap_buffer(void) {
+	// Collect results of finished transactions without blocking.
+	spi_transaction_t *tmp_ptr;
+	while (m_queued > 0 && spi_device_get_trans_result(m_spi, &tmp_ptr, 0) == ESP_OK) {
+		m_queued--;
+	}
+
 	m_active_buffer->trans.length = m_active_buffer->pos * 8;
 	m_active_buffer->pos = 0;
 	spi_device_queue_trans(m_spi, &m_active_buffer->trans, portMAX_DELAY);
+	m_queued++;
 	m_active_buffer = m_active_buffer->next;
 	hwspi_buffer_pointer = m_active_buffer->data;
 	hwspi_buffer_pos = &m_active_buffer->pos;
+
+	if (m_prio_waiting > 0) {
+		yield_to_prio();
+	}
 }
 
 void hwspi_data_stream_start(void) {
@@ -145,6 +284,25 @@ void hwspi_data_stream_finish(void) {
 	hwspi_send_data(m_active_buffer->data, m_active_buffer->pos);
 }
 
+void hwspi_data_stream_finish_async(void) {
+	if (m_active_buffer->pos > 0) {
+		m_active_buffer->trans.length = m_active_buffer->pos * 8;
+		m_active_buffer->trans.user = m_active_buffer; // Marks the final chunk for the post cb
+		m_active_buffer->pos = 0;
+		m_done_cb_pending = true;
+		spi_device_queue_trans(m_spi, &m_active_buffer->trans, portMAX_DELAY);
+		m_queued++;
+		m_active_buffer = m_active_buffer->next;
+	} else {
+		// The stream length was a multiple of the chunk size, so the
+		// last chunk is already queued without the final-chunk mark. CS
+		// and the callback are handled when the results are collected
+		// in hwspi_wait_done instead.
+		m_done_cb_pending = true;
+	}
+	m_async_pending = true;
+}
+
 void hwspi_send_data(const uint8_t *data, int len) {
 	spi_transaction_t t;
 	memset(&t, 0, sizeof(t));
@@ -154,3 +312,121 @@ void hwspi_send_data(const uint8_t *data, int len) {
 	spi_device_polling_transmit(m_spi, &t);
 }
 
+void hwspi_transfer(const uint8_t *tx, uint8_t *rx, int len) {
+	spi_transaction_t t;
+	memset(&t, 0, sizeof(t));
+	t.length = (size_t)len * 8;
+	t.tx_buffer = tx;
+	t.rx_buffer = rx;
+	if (rx) {
+		t.rxlength = (size_t)len * 8;
+	}
+	spi_device_polling_transmit(m_spi, &t);
+}
+
+int hwspi_add_client(int clk_mhz, int mode, int pin_cs, bool prio) {
+	if (!m_init_done) {
+		return -1;
+	}
+
+	int ind = -1;
+	for (int i = 0;i < HWSPI_CLIENTS_MAX;i++) {
+		if (!m_clients[i].used) {
+			ind = i;
+			break;
+		}
+	}
+
+	if (ind < 0) {
+		return -1;
+	}
+
+	spi_device_interface_config_t devcfg = {0};
+	devcfg.clock_speed_hz = clk_mhz * 1000 * 1000;
+	devcfg.mode = mode;
+	devcfg.spics_io_num = pin_cs; // Hardware CS frames each transaction.
+	devcfg.queue_size = 1;
+
+	if (spi_bus_add_device(SPI2_HOST, &devcfg, &m_clients[ind].dev) != ESP_OK) {
+		return -1;
+	}
+
+	m_clients[ind].used = true;
+	m_clients[ind].prio = prio;
+	return ind;
+}
+
+bool hwspi_client_transfer(int client, const uint8_t *tx, uint8_t *rx, int len) {
+	if (client < 0 || client >= HWSPI_CLIENTS_MAX || !m_clients[client].used) {
+		return false;
+	}
+
+	if (m_clients[client].prio) {
+		m_prio_waiting++;
+	}
+
+	spi_transaction_t t;
+	memset(&t, 0, sizeof(t));
+	t.length = (size_t)len * 8;
+	t.tx_buffer = tx;
+	t.rx_buffer = rx;
+	if (rx) {
+		t.rxlength = (size_t)len * 8;
+	}
+
+	// Blocks until the stream side yields the bus when it is held.
+	esp_err_t res = spi_device_polling_transmit(m_clients[client].dev, &t);
+
+	if (m_clients[client].prio) {
+		m_prio_waiting--;
+	}
+
+	return res == ESP_OK;
+}
+
+/*
+ * Queued transmits. The transaction structs must stay valid until the
+ * result is collected, so they come from a small ring; when all of them
+ * could still be in flight the oldest result is collected first. The
+ * queued counter is shared with the stream buffers, which makes the
+ * reservation check conservative when streams and queued sends mix.
+ */
+static spi_transaction_t *next_send_trans(void) {
+	spi_transaction_t *tmp_ptr;
+	while (m_queued > 0 && spi_device_get_trans_result(m_spi, &tmp_ptr, 0) == ESP_OK) {
+		m_queued--;
+	}
+	while (m_queued >= HWSPI_SEND_TRANS) {
+		if (spi_device_get_trans_result(m_spi, &tmp_ptr, portMAX_DELAY) != ESP_OK) {
+			break;
+		}
+		m_queued--;
+	}
+
+	spi_transaction_t *t = &m_send_trans[m_send_trans_next];
+	m_send_trans_next = (m_send_trans_next + 1) % HWSPI_SEND_TRANS;
+	return t;
+}
+
+void hwspi_queue_data(const uint8_t *data, int len) {
+	spi_transaction_t *t = next_send_trans();
+	memset(t, 0, sizeof(spi_transaction_t));
+	t->length = (size_t)len * 8;
+	t->tx_buffer = data;
+	spi_device_queue_trans(m_spi, t, portMAX_DELAY);
+	m_queued++;
+	m_async_pending = true;
+}
+
+void hwspi_send_data_async(const uint8_t *data, int len) {
+	spi_transaction_t *t = next_send_trans();
+	memset(t, 0, sizeof(spi_transaction_t));
+	t->length = (size_t)len * 8;
+	t->tx_buffer = data;
+	t->user = t; // Completion raises CS and fires the send-done callback.
+	m_done_cb_pending = true;
+	spi_device_queue_trans(m_spi, t, portMAX_DELAY);
+	m_queued++;
+	m_async_pending = true;
+}
+
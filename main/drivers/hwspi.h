@@ -22,6 +22,7 @@
 #define MAIN_HWSPI_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /*
  * Triple buffering: Write to one buffer while one is in the queue for sending and one
@@ -44,9 +45,24 @@ void hwspi_init(int clk_mhz, int mode,
 		int pin_miso, int pin_mosi, int pin_clk, int pin_cs);
 void hwspi_begin(void);
 void hwspi_end(void);
+void hwspi_end_async(void);
+void hwspi_wait_done(void);
+void hwspi_set_send_done_callback(void (*cb)(void));
 void hwspi_swap_buffer(void);
 void hwspi_send_data(const uint8_t *data, int len);
 
+/*
+ * Queued DMA transmits. Both return as soon as the transaction is
+ * queued; data must stay valid (and be DMA-capable) until completion.
+ * hwspi_queue_data keeps CS asserted for more traffic, while
+ * hwspi_send_data_async marks the transfer as the last one: CS is
+ * deasserted and the send-done callback fires from the SPI interrupt
+ * when it completes. The bus stays acquired until hwspi_wait_done or
+ * the next hwspi_begin. hwspi_send_data is the blocking equivalent.
+ */
+void hwspi_queue_data(const uint8_t *data, int len);
+void hwspi_send_data_async(const uint8_t *data, int len);
+
 void hwspi_data_stream_start(void);
 static inline void hwspi_data_stream_write(uint8_t byte) {
 	if (*hwspi_buffer_pos == HWSPI_DATA_BUFFER_SIZE) {
@@ -55,5 +71,25 @@ static inline void hwspi_data_stream_write(uint8_t byte) {
 	hwspi_buffer_pointer[(*hwspi_buffer_pos)++] = byte;
 }
 void hwspi_data_stream_finish(void);
+void hwspi_data_stream_finish_async(void);
+
+// Full-duplex polling transfer on the main device. The bus must be held
+// via hwspi_begin. rx may be NULL for transmit-only; when given it must
+// hold len bytes and is clocked in simultaneously with the transmit.
+void hwspi_transfer(const uint8_t *tx, uint8_t *rx, int len);
+
+/*
+ * Bus clients. A client is a second device on the same bus with its own
+ * hardware-managed CS pin, arbitrated by the SPI driver at transaction
+ * boundaries. Priority clients additionally preempt a running display
+ * stream at the next chunk boundary: the stream raises CS, releases the
+ * bus until the waiters are done and then resumes, so the worst-case
+ * latency of e.g. an encoder read on a shared bus is one stream chunk
+ * plus its own transaction instead of a whole frame.
+ */
+#define HWSPI_CLIENTS_MAX		3
+
+int hwspi_add_client(int clk_mhz, int mode, int pin_cs, bool prio);
+bool hwspi_client_transfer(int client, const uint8_t *tx, uint8_t *rx, int len);
 
 #endif /* MAIN_HWSPI_H_ */
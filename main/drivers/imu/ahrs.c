@@ -16,8 +16,13 @@
 // Header files
 #include <ahrs.h>
 #include "utils.h"
+#include "conf_general.h"
 #include <math.h>
 
+#ifdef USE_FIXMATH
+#include "fixmath.h"
+#endif
+
 // Private functions
 static float invSqrt(float x);
 static float calculateAccConfidence(float accMag, float *accMagP, float acc_confidence_decay);
@@ -94,6 +99,127 @@ void ahrs_update_initial_orientation(float *accelXYZ, float *magXYZ, ATTITUDE_IN
 	att->q3 = cr * cp * sy - sr * sp * cy;
 }
 
+#ifdef USE_FIXMATH
+/*
+ * Fixed-point Mahony update for FPU-less targets. The quaternion and
+ * its integration run in Q1.30, whose resolution comfortably holds the
+ * per-step increments that Q16.16 would quantize away; vectors, gains
+ * and feedback terms run in Q16.16. Floats only appear at the struct
+ * boundary, so ATTITUDE_INFO keeps the same layout as the float build.
+ */
+void ahrs_update_mahony_imu(float *gyroXYZ, float *accelXYZ, float dt, ATTITUDE_INFO *att) {
+	q16_t gx = q16_from_float(gyroXYZ[0]);
+	q16_t gy = q16_from_float(gyroXYZ[1]);
+	q16_t gz = q16_from_float(gyroXYZ[2]);
+
+	q16_t ax = q16_from_float(accelXYZ[0]);
+	q16_t ay = q16_from_float(accelXYZ[1]);
+	q16_t az = q16_from_float(accelXYZ[2]);
+
+	q30_t q0 = q30_from_float(att->q0);
+	q30_t q1 = q30_from_float(att->q1);
+	q30_t q2 = q30_from_float(att->q2);
+	q30_t q3 = q30_from_float(att->q3);
+
+	// Sample periods are well below one second, so dt fits Q1.30.
+	q30_t dt_q = q30_from_float(dt);
+
+	q16_t accelNorm2 = q16_mul(ax, ax) + q16_mul(ay, ay) + q16_mul(az, az);
+
+	// Same small-vector cutoff as the float path: 0.01^2 in Q16.16.
+	if (accelNorm2 > 7) {
+		// The confidence weighting is a handful of operations on
+		// filtered state; it stays in float and only the resulting
+		// gains are converted.
+		float accelConfidence = calculateAccConfidence(
+				q16_to_float(q16_sqrt(accelNorm2)),
+				&att->accMagP, att->acc_confidence_decay);
+
+		q16_t twoKp = q16_from_float(2.0 * att->kp * accelConfidence);
+		q16_t twoKi = q16_from_float(2.0 * att->ki * accelConfidence);
+
+		// Normalise accelerometer measurement
+		q16_t recipNorm = q16_inv_sqrt(accelNorm2);
+		ax = q16_mul(ax, recipNorm);
+		ay = q16_mul(ay, recipNorm);
+		az = q16_mul(az, recipNorm);
+
+		// Estimated direction of gravity. Unit-bounded, so Q16.16
+		// copies of the quaternion are accurate enough here.
+		q16_t q0_16 = q0 >> 14;
+		q16_t q1_16 = q1 >> 14;
+		q16_t q2_16 = q2 >> 14;
+		q16_t q3_16 = q3 >> 14;
+
+		q16_t halfvx = q16_mul(q1_16, q3_16) - q16_mul(q0_16, q2_16);
+		q16_t halfvy = q16_mul(q0_16, q1_16) + q16_mul(q2_16, q3_16);
+		q16_t halfvz = q16_mul(q0_16, q0_16) - Q16_ONE / 2 + q16_mul(q3_16, q3_16);
+
+		// Error is sum of cross product between estimated and measured direction of gravity
+		q16_t halfex = q16_mul(ay, halfvz) - q16_mul(az, halfvy);
+		q16_t halfey = q16_mul(az, halfvx) - q16_mul(ax, halfvz);
+		q16_t halfez = q16_mul(ax, halfvy) - q16_mul(ay, halfvx);
+
+		// Compute and apply integral feedback if enabled. The
+		// integrals accumulate in Q1.30 since their per-step
+		// increments are far below the Q16.16 LSB.
+		if (twoKi > 0) {
+			q30_t ifbx = q30_from_float(att->integralFBx);
+			q30_t ifby = q30_from_float(att->integralFBy);
+			q30_t ifbz = q30_from_float(att->integralFBz);
+
+			ifbx += q16_mul_q30(q16_mul(twoKi, halfex), dt_q);
+			ifby += q16_mul_q30(q16_mul(twoKi, halfey), dt_q);
+			ifbz += q16_mul_q30(q16_mul(twoKi, halfez), dt_q);
+
+			att->integralFBx = q30_to_float(ifbx);
+			att->integralFBy = q30_to_float(ifby);
+			att->integralFBz = q30_to_float(ifbz);
+
+			gx += (q16_t)(ifbx >> 14);
+			gy += (q16_t)(ifby >> 14);
+			gz += (q16_t)(ifbz >> 14);
+		} else {
+			att->integralFBx = 0.0;	// prevent integral windup
+			att->integralFBy = 0.0;
+			att->integralFBz = 0.0;
+		}
+
+		// Apply proportional feedback
+		gx += q16_mul(twoKp, halfex);
+		gy += q16_mul(twoKp, halfey);
+		gz += q16_mul(twoKp, halfez);
+	}
+
+	// Integrate rate of change of quaternion. The rate * dt products
+	// land directly in Q1.30 to keep the small increments.
+	q30_t gx2 = q16_mul_q30(gx, dt_q) / 2;
+	q30_t gy2 = q16_mul_q30(gy, dt_q) / 2;
+	q30_t gz2 = q16_mul_q30(gz, dt_q) / 2;
+
+	q30_t qa = q0;
+	q30_t qb = q1;
+	q30_t qc = q2;
+	q0 += -q30_mul(qb, gx2) - q30_mul(qc, gy2) - q30_mul(q3, gz2);
+	q1 += q30_mul(qa, gx2) + q30_mul(qc, gz2) - q30_mul(q3, gy2);
+	q2 += q30_mul(qa, gy2) - q30_mul(qb, gz2) + q30_mul(q3, gx2);
+	q3 += q30_mul(qa, gz2) + q30_mul(qb, gy2) - q30_mul(qc, gx2);
+
+	// Normalize quaternion
+	q30_t norm2 = q30_mul(q0, q0) + q30_mul(q1, q1) +
+			q30_mul(q2, q2) + q30_mul(q3, q3);
+	q30_t recip = q30_inv_sqrt(norm2);
+	q0 = q30_mul(q0, recip);
+	q1 = q30_mul(q1, recip);
+	q2 = q30_mul(q2, recip);
+	q3 = q30_mul(q3, recip);
+
+	att->q0 = q30_to_float(q0);
+	att->q1 = q30_to_float(q1);
+	att->q2 = q30_to_float(q2);
+	att->q3 = q30_to_float(q3);
+}
+#else
 void ahrs_update_mahony_imu(float *gyroXYZ, float *accelXYZ, float dt, ATTITUDE_INFO *att) {
 	float accelNorm, recipNorm;
 	float qa, qb, qc;
@@ -177,6 +303,7 @@ void ahrs_update_mahony_imu(float *gyroXYZ, float *accelXYZ, float dt, ATTITUDE_
 	att->q2 *= recipNorm;
 	att->q3 *= recipNorm;
 }
+#endif
 
 void ahrs_update_madgwick_imu(float *gyroXYZ, float *accelXYZ, float dt, ATTITUDE_INFO *att) {
 	float accelNorm, recipNorm;
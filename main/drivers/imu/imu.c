@@ -23,6 +23,7 @@
 #include "lsm6ds3.h"
 #include "utils.h"
 #include "digital_filter.h"
+#include "samp_stats.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -40,7 +41,7 @@ static Biquad acc_x_biquad, acc_y_biquad, acc_z_biquad, gyro_x_biquad, gyro_y_bi
 static SemaphoreHandle_t m_i2c_mutex = 0;
 
 // Private functions
-static void imu_read_callback(float *accel, float *gyro, float *mag);
+static void imu_read_callback(float *accel, float *gyro, float *mag, float dt);
 
 // Function pointers
 static void (*m_read_callback)(float *acc, float *gyro, float *mag, float dt) = NULL;
@@ -343,12 +344,11 @@ void imu_set_read_callback(void (*func)(float *acc, float *gyro, float *mag, flo
 	m_read_callback = func;
 }
 
-static void imu_read_callback(float *accel, float *gyro, float *mag) {
-	static TickType_t last_time = 0;
-
-	// TODO: More accurate dt measurement
-	float dt = UTILS_AGE_S(last_time);
-	last_time = xTaskGetTickCount();
+// dt is the sample period reported by the driver, which allows samples to
+// arrive in batches (e.g. drained from a hardware FIFO) and still advance
+// the AHRS by the actual time between samples.
+static void imu_read_callback(float *accel, float *gyro, float *mag, float dt) {
+	samp_stats_add(SAMP_SRC_IMU);
 
 	if (!imu_ready && UTILS_AGE_S(init_time) > 1.0) {
 		ahrs_update_all_parameters(
@@ -23,24 +23,32 @@
 #include "imu.h"
 #include "commands.h"
 #include "utils.h"
+#include "samp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #include <stdio.h>
 
+// Maximum number of gyro + accel sample sets drained from the FIFO in one
+// I2C transfer. 32 sets = 384 bytes, which keeps a single burst short enough
+// to not hog the shared bus.
+#define FIFO_READ_MAX			32
+
 static volatile uint16_t lsm6ds3_addr;
 static int rate_hz = 1000;
 static IMU_FILTER filter;
-static volatile bool thd_running = false;
-static volatile bool should_terminate = false;
+static float m_sample_dt = 0.001;
+static uint8_t m_fifo_ctrl5 = 0;
+static uint8_t m_fifo_buf[FIFO_READ_MAX * 12];
+static samp_timer_t m_samp = {0};
 
 static void terminal_read_reg(int argc, const char **argv);
 static uint8_t read_single_reg(uint8_t reg);
-static void lsm_task(void *arg);
+static void lsm_sample_fn(void *arg);
 
 // Function pointers
-static void(*read_callback)(float *accel, float *gyro, float *mag) = 0;
+static void(*read_callback)(float *accel, float *gyro, float *mag, float dt) = 0;
 
 
 void lsm6ds3_set_rate_hz(int hz) {
@@ -197,25 +205,104 @@ void lsm6ds3_init(void) {
 		}
 	}
 
+	// Block data update and register address auto-increment, needed for the
+	// burst reads below. This used to be rewritten by the read task on every
+	// iteration.
+	txb[0] = LSM6DS3_ACC_GYRO_CTRL3_C;
+	txb[1] = LSM6DS3_ACC_GYRO_BDU_BLOCK_UPDATE | LSM6DS3_ACC_GYRO_IF_INC_ENABLED;
+	res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+	if (!res){
+		commands_printf("LSM6DS3 CTRL3 Config FAILED");
+		return;
+	}
+
+	/*
+	 * Hardware FIFO in continuous mode with gyro + accel and no decimation,
+	 * drained in whole sample sets by lsm_sample_fn. That turns one I2C
+	 * transaction per sample into one transaction per batch. The sample
+	 * timing also comes from the sensor ODR instead of from task
+	 * scheduling, so it is passed to the read callback as dt.
+	 *
+	 * The TRC filtering configurations above double the accelerometer ODR
+	 * relative to the gyro; decimate the accelerometer by 2 in that case so
+	 * the FIFO pattern stays aligned as gyro + accel pairs.
+	 */
+	bool xl_boosted = is_trc && (filter >= IMU_FILTER_MEDIUM) &&
+			rate_hz > 208 && rate_hz <= 1660;
+
+	float odr;
+	uint8_t odr_fifo;
+	if (rate_hz <= 13) {
+		odr = 13.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_25Hz;
+	} else if (rate_hz <= 26) {
+		odr = 26.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_50Hz;
+	} else if (rate_hz <= 52) {
+		odr = 52.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_100Hz;
+	} else if (rate_hz <= 104) {
+		odr = 104.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_200Hz;
+	} else if (rate_hz <= 208) {
+		odr = 208.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_400Hz;
+	} else if (rate_hz <= 416) {
+		odr = 416.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_800Hz;
+	} else if (rate_hz <= 833) {
+		odr = 833.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_1600Hz;
+	} else if (rate_hz <= 1660 || is_trc == false) {
+		odr = 1660.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_3300Hz;
+	} else if (rate_hz <= 3330) {
+		odr = 3330.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_6600Hz;
+	} else {
+		odr = 6660.0; odr_fifo = LSM6DS3_ACC_GYRO_ODR_FIFO_13300Hz;
+	}
+	m_sample_dt = 1.0 / odr;
+
+	txb[0] = LSM6DS3_ACC_GYRO_FIFO_CTRL3;
+	txb[1] = LSM6DS3_ACC_GYRO_DEC_FIFO_G_NO_DECIMATION;
+	txb[1] |= xl_boosted ? LSM6DS3_ACC_GYRO_DEC_FIFO_XL_DECIMATION_BY_2 :
+			LSM6DS3_ACC_GYRO_DEC_FIFO_XL_NO_DECIMATION;
+	res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+	if (!res){
+		commands_printf("LSM6DS3 FIFO Config FAILED");
+		return;
+	}
+
+	// Continuous mode has to be entered from bypass to start from an
+	// empty FIFO.
+	m_fifo_ctrl5 = odr_fifo | LSM6DS3_ACC_GYRO_FIFO_MODE_DYN_STREAM_2;
+	txb[0] = LSM6DS3_ACC_GYRO_FIFO_CTRL5;
+	txb[1] = LSM6DS3_ACC_GYRO_FIFO_MODE_BYPASS;
+	imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+	txb[1] = m_fifo_ctrl5;
+	res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+	if (!res){
+		commands_printf("LSM6DS3 FIFO Mode Config FAILED");
+		return;
+	}
+
 	terminal_register_command_callback(
 				"lsm_read_reg",
 				"Read register of the LSM6DS3",
 				"[reg]",
 				terminal_read_reg);
 
-	should_terminate = false;
-	thd_running = true;
-	xTaskCreatePinnedToCore(lsm_task, "LSM6DSx", 1536, NULL, 6, NULL, tskNO_AFFINITY);
+	// Drain roughly four sample sets per wakeup. Timer pacing keeps the
+	// cadence tick-independent and drift-free, so the batch size - and
+	// with it the worst-case sample latency - stays put regardless of
+	// the tick rate and scheduler load.
+	uint32_t interval_us = 4000000 / (uint32_t)rate_hz;
+	if (interval_us < 1000) {
+		interval_us = 1000;
+	}
+	if (interval_us > 10000) {
+		interval_us = 10000;
+	}
+
+	samp_timer_start(&m_samp, "LSM6DSx", interval_us, lsm_sample_fn, NULL, 1536, 6);
 }
 
 void lsm6ds3_stop(void) {
-	should_terminate = true;
+	bool thd_was_running = m_samp.running;
 
-	bool thd_was_running = thd_running;
-
-	while (thd_running) {
-		vTaskDelay(1);
-	}
+	samp_timer_stop(&m_samp);
 
 	// Put IMU in sleep mode
 	if (thd_was_running) {
@@ -229,12 +316,16 @@ void lsm6ds3_stop(void) {
 		txb[0] = LSM6DS3_ACC_GYRO_CTRL2_G;
 		txb[1] = 0;
 		imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+
+		txb[0] = LSM6DS3_ACC_GYRO_FIFO_CTRL5;
+		txb[1] = LSM6DS3_ACC_GYRO_FIFO_MODE_BYPASS;
+		imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
 	}
 
 	terminal_unregister_callback(terminal_read_reg);
 }
 
-void lsm6ds3_set_read_callback(void(*func)(float *accel, float *gyro, float *mag)) {
+void lsm6ds3_set_read_callback(void(*func)(float *accel, float *gyro, float *mag, float dt)) {
 	read_callback = func;
 }
 
@@ -272,39 +363,74 @@ static void terminal_read_reg(int argc, const char **argv) {
 	}
 }
 
-static void lsm_task(void *arg) {
+// One sampling wakeup, paced by samp_timer. Drains whatever complete
+// sample sets are waiting in the FIFO and keeps going without waiting
+// for the next period while a full burst is pending.
+static void lsm_sample_fn(void *arg) {
 	(void)arg;
 
-	while (!should_terminate) {
+	bool again = true;
+	while (again) {
+		again = false;
+
 		uint8_t txb[2];
-		uint8_t rxb[12];
+		uint8_t status[2];
 
-		// Disable IMU writing to output registers
-		txb[0] = LSM6DS3_ACC_GYRO_CTRL3_C;
-		txb[1] = LSM6DS3_ACC_GYRO_BDU_BLOCK_UPDATE | LSM6DS3_ACC_GYRO_IF_INC_ENABLED;
-		imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, rxb, 1);
+		// Number of unread 16-bit words in the FIFO
+		txb[0] = LSM6DS3_ACC_GYRO_FIFO_STATUS1;
+		bool res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 1, status, 2);
 
-		// Read IMU output registers
-		txb[0] = LSM6DS3_ACC_GYRO_OUTX_L_G;
-		bool res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 1, rxb, 12);
-
-		// Parse 6 axis values
-		float gx = (float)((int16_t)((uint16_t)rxb[1] << 8) + rxb[0]) * 4.375 * (2000 / 125) / 1000;
-		float gy = (float)((int16_t)((uint16_t)rxb[3] << 8) + rxb[2]) * 4.375 * (2000 / 125) / 1000;
-		float gz = (float)((int16_t)((uint16_t)rxb[5] << 8) + rxb[4]) * 4.375 * (2000 / 125) / 1000;
-		float ax = (float)((int16_t)((uint16_t)rxb[7] << 8) + rxb[6]) * 0.061 * (16 >> 1) / 1000;
-		float ay = (float)((int16_t)((uint16_t)rxb[9] << 8) + rxb[8]) * 0.061 * (16 >> 1) / 1000;
-		float az = (float)((int16_t)((uint16_t)rxb[11] << 8) + rxb[10]) * 0.061 * (16 >> 1) / 1000;
-
-		if (res && read_callback) {
-			float tmp_accel[3] = {ax,ay,az}, tmp_gyro[3] = {gx,gy,gz}, tmp_mag[3] = {1,2,3};
-			read_callback(tmp_accel, tmp_gyro, tmp_mag);
-		}
+		if (res) {
+			int words = status[0] | ((status[1] & 0x0F) << 8);
+			bool overrun = (status[1] & 0x40) != 0;
 
-		vTaskDelay(portTICK_PERIOD_MS / rate_hz);
-	}
+			int sets = words / 6;
+			if (sets > FIFO_READ_MAX) {
+				sets = FIFO_READ_MAX;
+			}
 
-	thd_running = false;
-	vTaskDelete(NULL);
+			if (sets > 0) {
+				// Drain whole gyro + accel sample sets in one transfer. The
+				// FIFO data register address wraps automatically in burst
+				// reads.
+				txb[0] = LSM6DS3_ACC_GYRO_FIFO_DATA_OUT_L;
+				res = imu_i2c_tx_rx(lsm6ds3_addr, txb, 1, m_fifo_buf, sets * 12);
+
+				if (res && read_callback) {
+					for (int i = 0;i < sets;i++) {
+						uint8_t *b = m_fifo_buf + i * 12;
+
+						// Parse 6 axis values
+						float gx = (float)((int16_t)((uint16_t)b[1] << 8) + b[0]) * 4.375 * (2000 / 125) / 1000;
+						float gy = (float)((int16_t)((uint16_t)b[3] << 8) + b[2]) * 4.375 * (2000 / 125) / 1000;
+						float gz = (float)((int16_t)((uint16_t)b[5] << 8) + b[4]) * 4.375 * (2000 / 125) / 1000;
+						float ax = (float)((int16_t)((uint16_t)b[7] << 8) + b[6]) * 0.061 * (16 >> 1) / 1000;
+						float ay = (float)((int16_t)((uint16_t)b[9] << 8) + b[8]) * 0.061 * (16 >> 1) / 1000;
+						float az = (float)((int16_t)((uint16_t)b[11] << 8) + b[10]) * 0.061 * (16 >> 1) / 1000;
+
+						float tmp_accel[3] = {ax,ay,az}, tmp_gyro[3] = {gx,gy,gz}, tmp_mag[3] = {1,2,3};
+						read_callback(tmp_accel, tmp_gyro, tmp_mag, m_sample_dt);
+					}
+				}
+
+				// Catch up without waiting for the next period if
+				// there is more than a full burst waiting.
+				if (res && sets == FIFO_READ_MAX) {
+					again = true;
+					continue;
+				}
+			}
+
+			if (overrun) {
+				// The sample pattern alignment is lost on overrun, restart
+				// the FIFO from bypass mode.
+				txb[0] = LSM6DS3_ACC_GYRO_FIFO_CTRL5;
+				txb[1] = LSM6DS3_ACC_GYRO_FIFO_MODE_BYPASS;
+				imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, status, 1);
+				txb[1] = m_fifo_ctrl5;
+				imu_i2c_tx_rx(lsm6ds3_addr, txb, 2, status, 1);
+			}
+		}
+	}
 }
 
@@ -38,7 +38,7 @@
 void lsm6ds3_set_rate_hz(int hz);
 void lsm6ds3_set_filter(IMU_FILTER f);
 void lsm6ds3_init(void);
-void lsm6ds3_set_read_callback(void(*func)(float *accel, float *gyro, float *mag));
+void lsm6ds3_set_read_callback(void(*func)(float *accel, float *gyro, float *mag, float dt));
 void lsm6ds3_stop(void);
 
 
@@ -29,6 +29,13 @@
 #define CLEAR_PIN(pin) 			(GPIO.out_w1tc.val = 1 << (pin))
 #define WRITE_PIN(pin, level)	{if (level) SET_PIN(pin); else CLEAR_PIN(pin);}
 
+// Mask variants for the transfer loops. The masks come precomputed from
+// spi_bb_init and live in locals over the loops, so a clock edge is a
+// single register write instead of a state-struct load plus a shift.
+#define SET_MASK(mask) 			(GPIO.out_w1ts.val = (mask))
+#define CLEAR_MASK(mask) 		(GPIO.out_w1tc.val = (mask))
+#define WRITE_MASK(mask, level)	{if (level) SET_MASK(mask); else CLEAR_MASK(mask);}
+
 // ESP32-C6 GPIO register compatibility
 #ifdef CONFIG_IDF_TARGET_ESP32C6
 #define READ_PIN(pin)			((gpio_ll_get_level(&GPIO, pin)) & 0x1)
@@ -51,6 +58,10 @@ void spi_bb_init(spi_bb_state *s) {
 		gpio_reset_pin(s->mosi_pin);
 		gpio_set_direction(s->mosi_pin, GPIO_MODE_INPUT_OUTPUT);
 	}
+
+	s->nss_mask = 1 << s->nss_pin;
+	s->sck_mask = 1 << s->sck_pin;
+	s->mosi_mask = s->mosi_pin >= 0 ? 1 << s->mosi_pin : 0;
 }
 
 void spi_bb_deinit(spi_bb_state *s) {
@@ -75,31 +86,35 @@ void spi_bb_transfer_8(
 		const uint8_t *out_buf,
 		int length
 		) {
+	const uint32_t sck_mask = s->sck_mask;
+	const uint32_t mosi_mask = s->mosi_mask;
+	const int miso_pin = s->miso_pin;
+
 	for (int i = 0; i < length; i++) {
 		uint8_t send = out_buf ? out_buf[i] : 0xFF;
 		uint8_t receive = 0;
 
 		for (int bit = 0; bit < 8; bit++) {
-			if(s->mosi_pin >= 0) {
-				WRITE_PIN(s->mosi_pin, send >> 7);
+			if (mosi_mask) {
+				WRITE_MASK(mosi_mask, send >> 7);
 				send <<= 1;
 			}
 
-			SET_PIN(s->sck_pin);
+			SET_MASK(sck_mask);
 			spi_bb_delay();
 
 			int samples = 0;
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 
-			CLEAR_PIN(s->sck_pin);
+			CLEAR_MASK(sck_mask);
 
 			// does 5 samples of each pad read, to minimize noise
 			receive <<= 1;
@@ -122,36 +137,40 @@ void spi_bb_transfer_16(
 		const uint16_t *out_buf, 
 		int length
 		) {
+	const uint32_t sck_mask = s->sck_mask;
+	const uint32_t mosi_mask = s->mosi_mask;
+	const int miso_pin = s->miso_pin;
+
 	for (int i = 0; i < length; i++) {
 		uint16_t send = out_buf ? out_buf[i] : 0xFFFF;
 		uint16_t receive = 0;
 
 		for (int bit = 0; bit < 16; bit++) {
-			if(s->mosi_pin >= 0) {
-				WRITE_PIN(s->mosi_pin, send >> 7);
+			if (mosi_mask) {
+				WRITE_MASK(mosi_mask, send >> 7);
 				send <<= 1;
 			}
 
-			SET_PIN(s->sck_pin);
+			SET_MASK(sck_mask);
 			spi_bb_delay_short();
 
 			int samples = 0;
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 			__NOP();
-			samples += READ_PIN(s->miso_pin);
+			samples += READ_PIN(miso_pin);
 
 			receive <<= 1;
 			if (samples > 2) {
 				receive |= 1;
 			}
 
-			CLEAR_PIN(s->sck_pin);
+			CLEAR_MASK(sck_mask);
 			spi_bb_delay_short();
 		}
 
@@ -163,13 +182,13 @@ void spi_bb_transfer_16(
 
 void spi_bb_begin(spi_bb_state *s) {
 	spi_bb_delay();
-	CLEAR_PIN(s->nss_pin);
+	CLEAR_MASK(s->nss_mask);
 	spi_bb_delay();
 }
 
 void spi_bb_end(spi_bb_state *s) {
 	spi_bb_delay();
-	SET_PIN(s->nss_pin);
+	SET_MASK(s->nss_mask);
 	spi_bb_delay();
 }
 
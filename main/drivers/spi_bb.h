@@ -28,6 +28,11 @@ typedef struct {
 	int sck_pin;
 	int mosi_pin;
 	int miso_pin;
+	// Precomputed W1TS/W1TC register masks, set up by spi_bb_init so the
+	// transfer loops do not rebuild 1 << pin on every clock edge.
+	uint32_t nss_mask;
+	uint32_t sck_mask;
+	uint32_t mosi_mask;
 } spi_bb_state;
 
 void spi_bb_init(spi_bb_state *s);
@@ -0,0 +1,158 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "fixmath.h"
+
+/*
+ * Integer square root of a 64-bit value via the classic shift-and-
+ * subtract method, used as the core of the q16 square roots. 32
+ * iterations, no divisions.
+ */
+static uint32_t isqrt64(uint64_t x) {
+	uint64_t rem = 0;
+	uint32_t root = 0;
+
+	for (int i = 0;i < 32;i++) {
+		root <<= 1;
+		rem = (rem << 2) | (x >> 62);
+		x <<= 2;
+
+		if (root < rem) {
+			rem -= root | 1;
+			root += 2;
+		}
+	}
+
+	return root >> 1;
+}
+
+q16_t q16_sqrt(q16_t x) {
+	if (x <= 0) {
+		return 0;
+	}
+
+	// sqrt(v * 2^-16) * 2^16 = sqrt(v * 2^16)
+	return (q16_t)isqrt64((uint64_t)(uint32_t)x << 16);
+}
+
+q16_t q16_inv_sqrt(q16_t x) {
+	q16_t s = q16_sqrt(x);
+	if (s == 0) {
+		return INT32_MAX;
+	}
+	return q16_div(Q16_ONE, s);
+}
+
+/*
+ * 1/sqrt(x) for Q1.30 arguments near one, e.g. the squared norm of an
+ * almost-unit quaternion. Three Newton iterations
+ * y <- y * (3 - x * y^2) / 2 from y = 1 converge to well below the
+ * Q1.30 LSB for x in [0.5, 1.75]; outside that the intermediate y^2
+ * would leave the Q1.30 range, so arguments are clamped. The callers
+ * pass squared norms of nearly normalized state, which sit close to
+ * one.
+ */
+q30_t q30_inv_sqrt(q30_t x) {
+	if (x < (Q30_ONE / 2)) {
+		x = Q30_ONE / 2;
+	}
+	if (x > (Q30_ONE + Q30_ONE / 2 + Q30_ONE / 4)) {
+		x = Q30_ONE + Q30_ONE / 2 + Q30_ONE / 4;
+	}
+
+	q30_t y = Q30_ONE;
+	for (int i = 0;i < 4;i++) {
+		q30_t y2 = q30_mul(y, y);
+		q30_t xy2 = q30_mul(x, y2);
+		// (3 - x * y^2) / 2 computed in 64 bits; 3.0 overflows Q1.30.
+		q30_t half_t = (q30_t)((((int64_t)3 << 30) - xy2) / 2);
+		y = q30_mul(y, half_t);
+	}
+
+	return y;
+}
+
+/*
+ * Sine via a fifth-order odd polynomial on [-pi/2, pi/2] after range
+ * reduction, accurate to about 2e-4 which is plenty for orientation
+ * work. Coefficients are the Taylor ones with the x^5 term tweaked to
+ * zero the error at the interval ends.
+ */
+q16_t q16_sin(q16_t angle) {
+	// Reduce to [-pi, pi]
+	while (angle > Q16_PI) {
+		angle -= Q16_2PI;
+	}
+	while (angle < -Q16_PI) {
+		angle += Q16_2PI;
+	}
+
+	// Fold into [-pi/2, pi/2]
+	if (angle > Q16_PI_2) {
+		angle = Q16_PI - angle;
+	} else if (angle < -Q16_PI_2) {
+		angle = -Q16_PI - angle;
+	}
+
+	// sin(x) ~= x - x^3/6 + 0.0078674 * x^5, with the x^5 coefficient
+	// chosen so the error is zero at x = pi/2.
+	q16_t x2 = q16_mul(angle, angle);
+	q16_t x3 = q16_mul(x2, angle);
+	q16_t x5 = q16_mul(x3, x2);
+
+	return angle - x3 / 6 + q16_mul(x5, 516);
+}
+
+q16_t q16_cos(q16_t angle) {
+	return q16_sin(angle + Q16_PI_2);
+}
+
+/*
+ * atan2 via the common two-term rational approximation
+ * atan(z) ~= z * (0.97239 - 0.19195 * z^2) for |z| <= 1, with octant
+ * folding. Worst-case error is about 0.005 rad.
+ */
+q16_t q16_atan2(q16_t y, q16_t x) {
+	if (x == 0 && y == 0) {
+		return 0;
+	}
+
+	q16_t abs_y = y >= 0 ? y : -y;
+	q16_t abs_x = x >= 0 ? x : -x;
+	q16_t angle;
+
+	if (abs_x >= abs_y) {
+		q16_t z = q16_div(y, x);
+		q16_t z2 = q16_mul(z, z);
+		// 0.97239 and 0.19195 in Q16.16
+		q16_t at = q16_mul(z, 63727 - q16_mul(12580, z2));
+		if (x >= 0) {
+			angle = at;
+		} else {
+			angle = (y >= 0 ? Q16_PI : -Q16_PI) + at;
+		}
+	} else {
+		q16_t z = q16_div(x, y);
+		q16_t z2 = q16_mul(z, z);
+		q16_t at = q16_mul(z, 63727 - q16_mul(12580, z2));
+		angle = (y >= 0 ? Q16_PI_2 : -Q16_PI_2) - at;
+	}
+
+	return angle;
+}
@@ -0,0 +1,87 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_FIXMATH_H_
+#define MAIN_FIXMATH_H_
+
+#include <stdint.h>
+
+/*
+ * Fixed-point math for hot paths on FPU-less cores, where every float
+ * operation is a soft-float library call. Two formats are used:
+ *
+ * q16_t: Q16.16, general-purpose. Range +-32767, resolution ~1.5e-5.
+ * q30_t: Q1.30, for unit-magnitude quantities (quaternion components,
+ *        normalized vectors) where Q16.16 resolution is too coarse.
+ */
+typedef int32_t q16_t;
+typedef int32_t q30_t;
+
+#define Q16_ONE					((q16_t)(1 << 16))
+#define Q30_ONE					((q30_t)(1 << 30))
+#define Q16_PI					((q16_t)205887)		// pi in Q16.16
+#define Q16_2PI					((q16_t)411775)
+#define Q16_PI_2				((q16_t)102944)
+
+static inline q16_t q16_from_float(float x) {
+	return (q16_t)(x * 65536.0f);
+}
+
+static inline float q16_to_float(q16_t x) {
+	return (float)x / 65536.0f;
+}
+
+static inline q30_t q30_from_float(float x) {
+	return (q30_t)(x * 1073741824.0f);
+}
+
+static inline float q30_to_float(q30_t x) {
+	return (float)x / 1073741824.0f;
+}
+
+static inline q16_t q16_mul(q16_t a, q16_t b) {
+	return (q16_t)(((int64_t)a * b) >> 16);
+}
+
+static inline q16_t q16_div(q16_t a, q16_t b) {
+	if (b == 0) {
+		return a >= 0 ? INT32_MAX : INT32_MIN;
+	}
+	return (q16_t)(((int64_t)a << 16) / b);
+}
+
+static inline q30_t q30_mul(q30_t a, q30_t b) {
+	return (q30_t)(((int64_t)a * b) >> 30);
+}
+
+// Product of a Q16.16 and a Q1.30 value as Q1.30, for e.g. rate * dt
+// terms that must keep quaternion-level resolution.
+static inline q30_t q16_mul_q30(q16_t a, q30_t b) {
+	return (q30_t)(((int64_t)a * b) >> 16);
+}
+
+// Functions
+q16_t q16_sqrt(q16_t x);
+q16_t q16_inv_sqrt(q16_t x);
+q30_t q30_inv_sqrt(q30_t x);
+q16_t q16_sin(q16_t angle);
+q16_t q16_cos(q16_t angle);
+q16_t q16_atan2(q16_t y, q16_t x);
+
+#endif /* MAIN_FIXMATH_H_ */
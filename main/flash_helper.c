@@ -18,7 +18,9 @@
  */
 
 #include "flash_helper.h"
+#include "commands.h"
 #include "esp_partition.h"
+#include "esp_timer.h"
 #include "crc.h"
 #include "buffer.h"
 
@@ -36,6 +38,34 @@ typedef struct {
 
 static _code_checks m_code_checks[2] = {0};
 static flast_stats m_stats = {0};
+static flash_op_stats m_op_stats[2][FLASH_OP_NUM] = {0};
+
+// Fold one timed operation into the per-partition stats. t_start is
+// from esp_timer_get_time just before the operation.
+static void stats_account(int ind, int op, uint32_t bytes, int64_t t_start) {
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+	flash_op_stats *s = &m_op_stats[ind][op];
+
+	s->cnt++;
+	s->bytes += bytes;
+	s->lat_sum_us += us;
+	if (s->cnt == 1 || us < s->lat_min_us) {
+		s->lat_min_us = us;
+	}
+	if (us > s->lat_max_us) {
+		s->lat_max_us = us;
+	}
+	s->bins[us ? 31 - __builtin_clz(us) : 0]++;
+}
+
+/*
+ * Erase-ahead state. flash_helper_erase_code only erases the first
+ * sector so upload can start immediately; the remaining sectors are
+ * checked and erased lazily just ahead of the write pointer as chunks
+ * arrive. The watermark is the partition offset below which sectors
+ * are known to be erased (or were found already erased and skipped).
+ */
+static uint32_t m_erased_until[2] = {0, 0};
 
 static const esp_partition_t* get_partition(int ind) {
 	return esp_partition_find_first(
@@ -117,27 +147,135 @@ bool flash_helper_erase_code(int ind, int size) {
 		return false;
 	}
 
-	// Always erase the entire partition as that allows using it as constant storage. To speed
-	// up the process erase is only performed on sectors that are not already erased.
+	// The entire partition is erased eventually as that allows using it as
+	// constant storage, but only the first sector is erased here. The rest
+	// is handled ahead of the write pointer in flash_helper_write_code, so
+	// the multi-second up-front stall before the first chunk is gone.
 
+	int64_t t_start = esp_timer_get_time();
 	esp_partition_erase_range(part, 0, part->erase_size);
-	uint8_t *erased_data = malloc(part->erase_size);
-	if (!erased_data) {
+	stats_account(ind, FLASH_OP_ERASE, part->erase_size, t_start);
+
+	m_erased_until[ind] = part->erase_size;
+	return true;
+}
+
+// Erase everything from offset to the end of the partition, preserving
+// the bytes below offset in the sector it lands in. Already-erased
+// sectors are skipped. This clears the image area behind the stored
+// code in one erase per sector instead of going word by word through
+// flash_helper_write_code, where every word in a non-erased sector
+// costs a full sector read-modify-erase-write cycle.
+bool flash_helper_erase_from(int ind, uint32_t offset) {
+	const esp_partition_t *part = get_partition(ind);
+
+	if (!part || offset >= part->size) {
 		return false;
 	}
 
-	esp_partition_read(part, 0, erased_data, part->erase_size);
+	if (!perform_mmap(ind)) {
+		return false;
+	}
+
+	const uint8_t *base = (const uint8_t*)m_code_checks[ind].addr;
+	uint32_t sector = (offset / part->erase_size) * part->erase_size;
+	uint32_t head = offset - sector;
+
+	// The first sector can be shared with data that should be kept, in
+	// which case it has to go through a read-modify-write cycle.
+	if (head > 0) {
+		bool erased = true;
+		for (uint32_t i = offset;i < sector + part->erase_size;i++) {
+			if (base[i] != 0xff) {
+				erased = false;
+				break;
+			}
+		}
+
+		if (!erased) {
+			uint8_t *buf = calloc(part->erase_size, 1);
+			if (!buf) {
+				return false;
+			}
+
+			memcpy(buf, base + sector, head);
+			memset(buf + head, 0xff, part->erase_size - head);
+
+			int64_t t_start = esp_timer_get_time();
+			bool erase_ok = esp_partition_erase_range(part, sector, part->erase_size) == ESP_OK;
+			stats_account(ind, FLASH_OP_ERASE, part->erase_size, t_start);
+
+			t_start = esp_timer_get_time();
+			bool write_ok = esp_partition_write(part, sector, buf, head) == ESP_OK;
+			stats_account(ind, FLASH_OP_WRITE, head, t_start);
+			free(buf);
+
+			if (!erase_ok || !write_ok) {
+				return false;
+			}
+		}
+
+		sector += part->erase_size;
+	}
+
+	for (;sector < part->size;sector += part->erase_size) {
+		bool erased = true;
+		for (uint32_t i = 0;i < part->erase_size;i++) {
+			if (base[sector + i] != 0xff) {
+				erased = false;
+				break;
+			}
+		}
 
-	for (uint32_t i = part->erase_size; i < part->size; i += part->erase_size) {
-		if (memcmp(m_code_checks[ind].addr + i, erased_data, part->erase_size) != 0) {
-			esp_partition_erase_range(part, i, part->erase_size);
+		if (!erased) {
+			int64_t t_start = esp_timer_get_time();
+			if (esp_partition_erase_range(part, sector, part->erase_size) != ESP_OK) {
+				return false;
+			}
+			stats_account(ind, FLASH_OP_ERASE, part->erase_size, t_start);
 		}
 	}
 
-	free(erased_data);
 	return true;
 }
 
+// Bring the erase watermark up to the given offset. Sectors that are
+// already erased are skipped, like the old up-front scan did. Only
+// active during an upload sequence (watermark set by
+// flash_helper_erase_code); outside of one - e.g. image snapshot
+// writes after a reboot - the watermark is 0 and stored code must not
+// be treated as sectors awaiting erase.
+static void erase_ahead(int ind, const esp_partition_t *part, uint32_t until) {
+	if (m_erased_until[ind] == 0) {
+		return;
+	}
+
+	if (!perform_mmap(ind)) {
+		return;
+	}
+
+	while (m_erased_until[ind] < until && m_erased_until[ind] < part->size) {
+		uint32_t sector = m_erased_until[ind];
+		const uint8_t *p = (const uint8_t*)m_code_checks[ind].addr + sector;
+
+		bool erased = true;
+		for (uint32_t i = 0;i < part->erase_size;i++) {
+			if (p[i] != 0xff) {
+				erased = false;
+				break;
+			}
+		}
+
+		if (!erased) {
+			int64_t t_start = esp_timer_get_time();
+			esp_partition_erase_range(part, sector, part->erase_size);
+			stats_account(ind, FLASH_OP_ERASE, part->erase_size, t_start);
+		}
+
+		m_erased_until[ind] += part->erase_size;
+	}
+}
+
 bool flash_helper_write_code(int ind, uint32_t offset, uint8_t *data, uint32_t len, uint32_t save_after) {
 	if (offset < (m_code_checks[ind].size + 8)) {
 		m_code_checks[ind].size = 0;
@@ -151,6 +289,10 @@ bool flash_helper_write_code(int ind, uint32_t offset, uint8_t *data, uint32_t l
 		return false;
 	}
 
+	// Erase one sector past the end of this chunk so the next chunk
+	// lands in ready flash.
+	erase_ahead(ind, part, offset + len + part->erase_size);
+
 	uint8_t *data_old = flash_helper_code_data_raw(ind);
 	bool erased = true;
 	for (int i = 0;i < len;i++) {
@@ -181,8 +323,13 @@ bool flash_helper_write_code(int ind, uint32_t offset, uint8_t *data, uint32_t l
 		memcpy(buf, data_old + sector_start, buf_len);
 		memcpy(buf + (offset - sector_start), data, len);
 
+		int64_t t_start = esp_timer_get_time();
 		bool erase_ok = esp_partition_erase_range(part, sector_start, part->erase_size) == ESP_OK;
+		stats_account(ind, FLASH_OP_ERASE, part->erase_size, t_start);
+
+		t_start = esp_timer_get_time();
 		bool write_ok = esp_partition_write(part, sector_start, buf, buf_len) == ESP_OK;
+		stats_account(ind, FLASH_OP_WRITE, buf_len, t_start);
 		free(buf);
 
 		if (m_stats.sector_last != sector_start) {
@@ -199,7 +346,10 @@ bool flash_helper_write_code(int ind, uint32_t offset, uint8_t *data, uint32_t l
 
 		return erase_ok && write_ok;
 	} else {
-		return esp_partition_write(part, offset, data, len) == ESP_OK;
+		int64_t t_start = esp_timer_get_time();
+		bool res = esp_partition_write(part, offset, data, len) == ESP_OK;
+		stats_account(ind, FLASH_OP_WRITE, len, t_start);
+		return res;
 	}
 }
 
@@ -216,7 +366,27 @@ bool flash_helper_code_data(int ind, uint32_t offset, uint8_t *data, uint32_t le
 		return 0;
 	}
 
-	return esp_partition_read(part, offset + 8, data, len) == ESP_OK;
+	if ((offset + 8 + len) > part->size) {
+		return false;
+	}
+
+	// The partition is already memory-mapped, so copy through the map
+	// instead of esp_partition_read. Mapped reads go through the MMU
+	// flash cache, which fetches whole cache lines and keeps them
+	// resident, so sequential consumers (script load, verify, XML
+	// serving) stream at near-flash bandwidth instead of paying SPI
+	// transaction setup for every small read.
+	if (m_code_checks[ind].mmap_done) {
+		int64_t t_start = esp_timer_get_time();
+		memcpy(data, (const uint8_t*)m_code_checks[ind].addr + offset + 8, len);
+		stats_account(ind, FLASH_OP_READ, len, t_start);
+		return true;
+	}
+
+	int64_t t_start = esp_timer_get_time();
+	bool res = esp_partition_read(part, offset + 8, data, len) == ESP_OK;
+	stats_account(ind, FLASH_OP_READ, len, t_start);
+	return res;
 }
 
 const uint8_t *flash_helper_code_data_ptr(int ind) {
@@ -257,3 +427,62 @@ uint16_t flash_helper_code_flags(int ind) {
 flast_stats flash_helper_stats(void) {
 	return m_stats;
 }
+
+void flash_helper_op_stats(int ind, int op, flash_op_stats *stats) {
+	if (ind < 0 || ind > 1 || op < 0 || op >= FLASH_OP_NUM) {
+		memset(stats, 0, sizeof(flash_op_stats));
+		return;
+	}
+
+	*stats = m_op_stats[ind][op];
+}
+
+void flash_helper_stats_reset(void) {
+	memset(&m_stats, 0, sizeof(m_stats));
+	memset(m_op_stats, 0, sizeof(m_op_stats));
+}
+
+void flash_helper_print_stats(void) {
+	static const char *part_names[2] = {"qml", "lisp"};
+	static const char *op_names[FLASH_OP_NUM] = {"erase", "write", "read"};
+
+	commands_printf("Erase cnt tot: %u, erase cnt max sector: %u, sectors erased: %u",
+			m_stats.erase_cnt_tot, m_stats.erase_cnt_max, m_stats.erased_sector_num);
+	commands_printf(" ");
+	commands_printf("part op          cnt      bytes   min_us   avg_us   max_us");
+	commands_printf("------------------------------------------------------------");
+
+	for (int ind = 0;ind < 2;ind++) {
+		for (int op = 0;op < FLASH_OP_NUM;op++) {
+			flash_op_stats *s = &m_op_stats[ind][op];
+			if (s->cnt == 0) {
+				continue;
+			}
+
+			commands_printf("%-4s %-5s %8lu %10lu %8lu %8lu %8lu",
+					part_names[ind], op_names[op], s->cnt, s->bytes,
+					s->lat_min_us, (uint32_t)(s->lat_sum_us / s->cnt),
+					s->lat_max_us);
+		}
+	}
+
+	commands_printf(" ");
+	commands_printf("Latency histograms (2^n us bins):");
+	for (int ind = 0;ind < 2;ind++) {
+		for (int op = 0;op < FLASH_OP_NUM;op++) {
+			flash_op_stats *s = &m_op_stats[ind][op];
+			if (s->cnt == 0) {
+				continue;
+			}
+
+			commands_printf("%s %s:", part_names[ind], op_names[op]);
+			for (int b = 0;b < FLASH_LAT_BIN_NUM;b++) {
+				if (s->bins[b] > 0) {
+					commands_printf("  2^%02d us: %lu", b, s->bins[b]);
+				}
+			}
+		}
+	}
+
+	commands_printf(" ");
+}
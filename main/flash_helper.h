@@ -26,6 +26,11 @@
 #define CODE_IND_QML	0
 #define CODE_IND_LISP	1
 
+// Code flags, stored in the 2 byte flags field of the code header by
+// the uploader. The stored blob is a zip archive whose first entry is
+// the actual code; it is inflated at load time.
+#define CODE_FLAG_COMPRESSED	(1 << 0)
+
 typedef struct {
 	unsigned int erase_cnt_tot; // Total erase operations
 	unsigned int sector_last; // Last sector that was erased
@@ -34,7 +39,27 @@ typedef struct {
 	unsigned int erase_cnt_max; // Largest erase counter for a given sector
 } flast_stats;
 
+// Per-partition per-operation instrumentation. Latencies are in
+// microseconds, histogram bins are log2 of the latency. Rising erase
+// latency over a fleet is an early sign of flash wear.
+#define FLASH_OP_ERASE		0
+#define FLASH_OP_WRITE		1
+#define FLASH_OP_READ		2
+#define FLASH_OP_NUM		3
+
+#define FLASH_LAT_BIN_NUM	32
+
+typedef struct {
+	uint32_t cnt;
+	uint32_t bytes;
+	uint32_t lat_min_us;
+	uint32_t lat_max_us;
+	uint64_t lat_sum_us;
+	uint32_t bins[FLASH_LAT_BIN_NUM];
+} flash_op_stats;
+
 bool flash_helper_erase_code(int ind, int size);
+bool flash_helper_erase_from(int ind, uint32_t offset);
 bool flash_helper_write_code(int ind, uint32_t offset, uint8_t *data, uint32_t len, uint32_t save_after);
 bool flash_helper_code_data(int ind, uint32_t offset, uint8_t *data, uint32_t len);
 const uint8_t *flash_helper_code_data_ptr(int ind);
@@ -43,5 +68,8 @@ int flash_helper_code_size_raw(int ind);
 uint32_t flash_helper_code_size(int ind);
 uint16_t flash_helper_code_flags(int ind);
 flast_stats flash_helper_stats(void);
+void flash_helper_op_stats(int ind, int op, flash_op_stats *stats);
+void flash_helper_stats_reset(void);
+void flash_helper_print_stats(void);
 
 #endif /* FLASH_HELPER_H_ */
@@ -0,0 +1,197 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "gc_stats.h"
+#include "commands.h"
+#include "log.h"
+#include "utils.h"
+
+#include "heap.h"
+#include "lbm_memory.h"
+#include "lbm_defrag_mem.h"
+
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Periodic GC and heap telemetry for the lisp runtime. Once a second
+ * the lbm heap state is snapshotted and the deltas since the previous
+ * snapshot are folded into a ring of window records, so a script hitch
+ * can be matched against what GC did at that moment. The recent
+ * windows are queryable live from the gc_stats terminal command and
+ * can be streamed to the SD card through the auxiliary log channel for
+ * days-long runs.
+ *
+ * The gc_min/max_duration fields in lbm_heap_state are sampled and
+ * reset each window; this module is their only consumer.
+ */
+
+#define GC_STATS_PERIOD_MS	1000
+#define GC_STATS_TREND_NUM	60
+
+typedef struct {
+	uint32_t t_s;
+	uint32_t gc_cnt;
+	uint32_t pause_avg_us;
+	uint32_t pause_max_us;
+	uint32_t recovered;
+	uint32_t heap_used;
+	uint32_t mem_used;
+	uint32_t defrag_steps;
+} gc_record_t;
+
+static gc_record_t m_trend[GC_STATS_TREND_NUM];
+static int m_trend_next = 0;
+static int m_trend_cnt = 0;
+
+// Previous snapshot for the window deltas.
+static uint32_t m_gc_num_last = 0;
+static uint32_t m_gc_time_last = 0;
+static uint32_t m_defrag_last = 0;
+
+// Cumulative since reset.
+static uint32_t m_gc_total = 0;
+static uint64_t m_pause_total_us = 0;
+static uint32_t m_pause_max_us = 0;
+
+static volatile bool m_log_lines = false;
+static esp_timer_handle_t m_timer = NULL;
+
+static void gc_stats_sample(void *arg) {
+	(void)arg;
+
+	if (lbm_heap_state.heap_size == 0) {
+		// Lisp not started (yet).
+		return;
+	}
+
+	uint32_t gc_num = lbm_heap_state.gc_num;
+	uint32_t gc_time = lbm_heap_state.gc_time_acc;
+	uint32_t defrag = lbm_defrag_mem_compact_steps();
+
+	gc_record_t rec;
+	rec.t_s = (uint32_t)(utils_ms_tot() / 1000);
+	rec.gc_cnt = gc_num - m_gc_num_last;
+	rec.recovered = lbm_heap_state.gc_recovered;
+	rec.heap_used = lbm_heap_state.num_alloc;
+	rec.mem_used = lbm_memory_num_words() - lbm_memory_num_free();
+	rec.defrag_steps = defrag - m_defrag_last;
+
+	uint32_t pause_sum = gc_time - m_gc_time_last;
+	rec.pause_avg_us = rec.gc_cnt > 0 ? pause_sum / rec.gc_cnt : 0;
+	rec.pause_max_us = rec.gc_cnt > 0 ? lbm_heap_state.gc_max_duration : 0;
+
+	m_gc_num_last = gc_num;
+	m_gc_time_last = gc_time;
+	m_defrag_last = defrag;
+
+	// Window max sampled, start over for the next window.
+	lbm_heap_state.gc_max_duration = 0;
+	lbm_heap_state.gc_min_duration = (lbm_uint)-1;
+
+	m_gc_total += rec.gc_cnt;
+	m_pause_total_us += pause_sum;
+	if (rec.pause_max_us > m_pause_max_us) {
+		m_pause_max_us = rec.pause_max_us;
+	}
+
+	m_trend[m_trend_next] = rec;
+	m_trend_next = (m_trend_next + 1) % GC_STATS_TREND_NUM;
+	if (m_trend_cnt < GC_STATS_TREND_NUM) {
+		m_trend_cnt++;
+	}
+
+	if (m_log_lines) {
+		char line[160];
+		snprintf(line, sizeof(line),
+				"%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu;%lu\n",
+				rec.t_s, rec.gc_cnt, rec.pause_avg_us, rec.pause_max_us,
+				rec.recovered, rec.heap_used,
+				(uint32_t)lbm_heap_state.heap_size, rec.mem_used,
+				(uint32_t)lbm_memory_num_words(), rec.defrag_steps);
+		log_aux_write(line);
+	}
+}
+
+void gc_stats_init(void) {
+	const esp_timer_create_args_t args = {
+			.callback = gc_stats_sample,
+			.name = "gc_stats",
+	};
+
+	esp_timer_create(&args, &m_timer);
+	esp_timer_start_periodic(m_timer, (uint64_t)GC_STATS_PERIOD_MS * 1000);
+}
+
+void gc_stats_reset(void) {
+	m_trend_next = 0;
+	m_trend_cnt = 0;
+	m_gc_total = 0;
+	m_pause_total_us = 0;
+	m_pause_max_us = 0;
+}
+
+void gc_stats_print(void) {
+	commands_printf("GCs: %lu, pause avg %lu us, pause max %lu us",
+			m_gc_total,
+			m_gc_total > 0 ? (uint32_t)(m_pause_total_us / m_gc_total) : 0,
+			m_pause_max_us);
+	commands_printf("Heap: %lu / %lu cells, mem: %lu / %lu words",
+			(uint32_t)lbm_heap_state.num_alloc,
+			(uint32_t)lbm_heap_state.heap_size,
+			(uint32_t)(lbm_memory_num_words() - lbm_memory_num_free()),
+			(uint32_t)lbm_memory_num_words());
+	commands_printf("Logging: %d, lines dropped: %lu",
+			m_log_lines, log_aux_dropped());
+	commands_printf(" ");
+	commands_printf("    t_s  gc avg_us max_us  recov  heap_use   mem_use defrag");
+	commands_printf("--------------------------------------------------------------");
+
+	for (int i = 0;i < m_trend_cnt;i++) {
+		int ind = (m_trend_next - m_trend_cnt + i + GC_STATS_TREND_NUM) %
+				GC_STATS_TREND_NUM;
+		gc_record_t *rec = &m_trend[ind];
+
+		commands_printf("%7lu %3lu %6lu %6lu %6lu %9lu %9lu %6lu",
+				rec->t_s, rec->gc_cnt, rec->pause_avg_us, rec->pause_max_us,
+				rec->recovered, rec->heap_used, rec->mem_used,
+				rec->defrag_steps);
+	}
+
+	commands_printf(" ");
+}
+
+bool gc_stats_log_start(void) {
+	if (!log_aux_start("gc",
+			"t_s;gc_cnt;pause_avg_us;pause_max_us;recovered_cells;"
+			"heap_used_cells;heap_size_cells;mem_used_words;"
+			"mem_size_words;defrag_steps")) {
+		return false;
+	}
+
+	m_log_lines = true;
+	return true;
+}
+
+void gc_stats_log_stop(void) {
+	m_log_lines = false;
+	log_aux_stop();
+}
@@ -0,0 +1,33 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_GC_STATS_H_
+#define MAIN_GC_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Functions
+void gc_stats_init(void);
+void gc_stats_reset(void);
+void gc_stats_print(void);
+bool gc_stats_log_start(void);
+void gc_stats_log_stop(void);
+
+#endif /* MAIN_GC_STATS_H_ */
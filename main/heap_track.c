@@ -0,0 +1,223 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "heap_track.h"
+#include "commands.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+/*
+ * Heap fragmentation shows up as large allocations failing while plenty
+ * of bytes are still free, usually days into a run, and by then the
+ * damage is anonymous. This module wraps the named allocation sites in
+ * the codebase with per-site live-bytes accounting (charged at the real
+ * allocated size, so heap overhead is included) and keeps a slow trend
+ * ring of free bytes versus the largest free block. Comparing the two
+ * over time points at the sites whose churn carves up the heap. Sites
+ * register themselves on first use; the table is claimed with an atomic
+ * exchange so allocation from any task is safe, and the counters are
+ * plain increments like in mempools.c since this is a diagnostics
+ * surface.
+ */
+
+#define HEAP_TRACK_SITE_MAX		16
+
+// One trend sample every 10 minutes, 36 entries = the last 6 hours.
+#define HEAP_TRACK_TREND_NUM	36
+#define HEAP_TRACK_TREND_S		600
+
+typedef struct {
+	const char *name;
+	uint32_t allocs;
+	uint32_t fails;
+	int32_t live_cnt;
+	int32_t live_bytes;
+	int32_t peak_bytes;
+} heap_site_t;
+
+typedef struct {
+	uint32_t uptime_s;
+	uint32_t free_bytes;
+	uint32_t largest_block;
+} heap_trend_t;
+
+// Private variables
+static heap_site_t m_sites[HEAP_TRACK_SITE_MAX];
+static heap_trend_t m_trend[HEAP_TRACK_TREND_NUM];
+static int m_trend_next = 0;
+static int m_trend_cnt = 0;
+static uint32_t m_largest_min = 0xFFFFFFFF;
+static esp_timer_handle_t m_trend_timer = NULL;
+
+// Private functions
+static heap_site_t *site_get(const char *name) {
+	for (int i = 0;i < HEAP_TRACK_SITE_MAX;i++) {
+		const char *n = __atomic_load_n(&m_sites[i].name, __ATOMIC_ACQUIRE);
+
+		if (n == NULL) {
+			const char *expect = NULL;
+			if (__atomic_compare_exchange_n(&m_sites[i].name, &expect, name,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				return &m_sites[i];
+			}
+			n = expect;
+		}
+
+		// Site names are string literals, so pointer equality catches
+		// almost every lookup before the strcmp fallback.
+		if (n == name || strcmp(n, name) == 0) {
+			return &m_sites[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void account_alloc(heap_site_t *s, void *ptr) {
+	if (!s) {
+		return;
+	}
+
+	if (!ptr) {
+		s->fails++;
+		return;
+	}
+
+	s->allocs++;
+	s->live_cnt++;
+	s->live_bytes += heap_caps_get_allocated_size(ptr);
+	if (s->live_bytes > s->peak_bytes) {
+		s->peak_bytes = s->live_bytes;
+	}
+}
+
+static void trend_sample(void *arg) {
+	(void)arg;
+
+	heap_trend_t *t = &m_trend[m_trend_next];
+	t->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+	t->free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+	t->largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+	if (t->largest_block < m_largest_min) {
+		m_largest_min = t->largest_block;
+	}
+
+	m_trend_next = (m_trend_next + 1) % HEAP_TRACK_TREND_NUM;
+	if (m_trend_cnt < HEAP_TRACK_TREND_NUM) {
+		m_trend_cnt++;
+	}
+}
+
+void heap_track_init(void) {
+	const esp_timer_create_args_t timer_args = {
+		.callback = trend_sample,
+		.name = "heap_trend",
+	};
+	esp_timer_create(&timer_args, &m_trend_timer);
+	esp_timer_start_periodic(m_trend_timer, (uint64_t)HEAP_TRACK_TREND_S * 1000000);
+
+	// Capture the boot baseline right away.
+	trend_sample(NULL);
+}
+
+void *heap_track_malloc(const char *site, size_t size) {
+	void *res = malloc(size);
+	account_alloc(site_get(site), res);
+	return res;
+}
+
+void *heap_track_calloc(const char *site, size_t num, size_t size) {
+	void *res = calloc(num, size);
+	account_alloc(site_get(site), res);
+	return res;
+}
+
+void heap_track_free(const char *site, void *ptr) {
+	if (!ptr) {
+		return;
+	}
+
+	heap_site_t *s = site_get(site);
+	if (s) {
+		s->live_cnt--;
+		s->live_bytes -= heap_caps_get_allocated_size(ptr);
+	}
+
+	free(ptr);
+}
+
+void heap_track_print_stats(void) {
+	uint32_t free_now = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+	uint32_t largest_now = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+	commands_printf("site                  allocs  fails  live   live bytes   peak bytes");
+	commands_printf("---------------------------------------------------------------------");
+
+	for (int i = 0;i < HEAP_TRACK_SITE_MAX;i++) {
+		heap_site_t *s = &m_sites[i];
+		if (!s->name) {
+			continue;
+		}
+
+		commands_printf("%-20s %7lu %6lu %5ld %12ld %12ld",
+				s->name, s->allocs, s->fails, s->live_cnt,
+				s->live_bytes, s->peak_bytes);
+	}
+
+	commands_printf(" ");
+	commands_printf("Free now      : %lu", free_now);
+	commands_printf("Largest block : %lu (%lu %% of free)", largest_now,
+			free_now ? (largest_now * 100) / free_now : 0);
+	commands_printf("Largest min   : %lu",
+			m_largest_min == 0xFFFFFFFF ? largest_now : m_largest_min);
+
+	commands_printf(" ");
+	commands_printf("Trend (oldest first, one sample per %d min):", HEAP_TRACK_TREND_S / 60);
+	commands_printf("uptime s    free bytes  largest block");
+
+	for (int i = 0;i < m_trend_cnt;i++) {
+		int ind = (m_trend_next - m_trend_cnt + i + HEAP_TRACK_TREND_NUM) %
+				HEAP_TRACK_TREND_NUM;
+		heap_trend_t *t = &m_trend[ind];
+		commands_printf("%8lu %13lu %14lu",
+				t->uptime_s, t->free_bytes, t->largest_block);
+	}
+
+	commands_printf(" ");
+}
+
+void heap_track_reset_stats(void) {
+	for (int i = 0;i < HEAP_TRACK_SITE_MAX;i++) {
+		heap_site_t *s = &m_sites[i];
+		s->allocs = 0;
+		s->fails = 0;
+		s->peak_bytes = s->live_bytes;
+	}
+
+	m_trend_next = 0;
+	m_trend_cnt = 0;
+	m_largest_min = 0xFFFFFFFF;
+	trend_sample(NULL);
+}
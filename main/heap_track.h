@@ -0,0 +1,33 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_HEAP_TRACK_H_
+#define MAIN_HEAP_TRACK_H_
+
+#include <stddef.h>
+
+// Functions
+void heap_track_init(void);
+void *heap_track_malloc(const char *site, size_t size);
+void *heap_track_calloc(const char *site, size_t num, size_t size);
+void heap_track_free(const char *site, void *ptr);
+void heap_track_print_stats(void);
+void heap_track_reset_stats(void);
+
+#endif /* MAIN_HEAP_TRACK_H_ */
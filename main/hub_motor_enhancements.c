@@ -221,6 +221,122 @@ bool hub_motor_validate_configuration(const hub_motor_config_t *config) {
     return true;
 }
 
+/*
+ * Online parameter estimation.
+ *
+ * Tracks winding resistance and back-EMF constant from the steady-state
+ * motor equation v = R*i + ke*omega using rank-1 recursive least squares.
+ * Each sample performs a fixed small number of integer multiplies and one
+ * integer divide - no matrix inversion, no transcendental calls - so the
+ * update can run at full sample rate on the RISC-V cores (which have no
+ * FPU) without the periodic CPU spikes a batched solve would cause.
+ *
+ * All accumulators are Q16.16 fixed point with 64-bit intermediates.
+ * The 2x2 covariance matrix is symmetric, so only three elements are
+ * stored and updated.
+ */
+
+#define EST_Q               16
+#define EST_ONE             (1 << EST_Q)
+#define EST_LAMBDA          65470       // Forgetting factor ~0.999 in Q16.16
+#define EST_P_INIT          (100 * EST_ONE)
+#define EST_P_MAX           ((int32_t)1 << 30)
+#define EST_CONV_TRACE      (EST_ONE / 10)
+
+static volatile int32_t est_theta_r = 0;    // R estimate, Q16.16
+static volatile int32_t est_theta_ke = 0;   // ke estimate, Q16.16
+static int32_t est_p00 = EST_P_INIT;
+static int32_t est_p01 = 0;
+static int32_t est_p11 = EST_P_INIT;
+static volatile uint32_t est_samples = 0;
+static volatile bool est_converged = false;
+
+static inline int32_t est_from_float(float v) {
+    return (int32_t)(v * (float)EST_ONE);
+}
+
+static inline float est_to_float(int32_t v) {
+    return (float)v / (float)EST_ONE;
+}
+
+static inline int32_t est_mul(int32_t a, int32_t b) {
+    return (int32_t)(((int64_t)a * (int64_t)b) >> EST_Q);
+}
+
+void hub_motor_estimator_reset(float initial_resistance, float initial_ke) {
+    est_theta_r = est_from_float(initial_resistance);
+    est_theta_ke = est_from_float(initial_ke);
+    est_p00 = EST_P_INIT;
+    est_p01 = 0;
+    est_p11 = EST_P_INIT;
+    est_samples = 0;
+    est_converged = false;
+
+    ESP_LOGI(TAG, "Parameter estimator reset (R0: %.3f Ohm, ke0: %.4f V/(rad/s))",
+             initial_resistance, initial_ke);
+}
+
+void hub_motor_estimator_update(float voltage, float current, float omega) {
+    // Skip samples without excitation - the regressor carries no
+    // information and the divide below would approach 0/lambda.
+    if (fabsf(current) < 0.1f && fabsf(omega) < 0.1f) {
+        return;
+    }
+
+    int32_t xi = est_from_float(current);
+    int32_t xw = est_from_float(omega);
+    int32_t y = est_from_float(voltage);
+
+    // Px = P * x (rank-1: two dot products)
+    int32_t px0 = est_mul(est_p00, xi) + est_mul(est_p01, xw);
+    int32_t px1 = est_mul(est_p01, xi) + est_mul(est_p11, xw);
+
+    // Gain denominator: lambda + x' * P * x
+    int64_t denom = (int64_t)EST_LAMBDA + est_mul(xi, px0) + est_mul(xw, px1);
+    if (denom <= 0) {
+        return;
+    }
+
+    // Kalman gain k = Px / denom
+    int32_t k0 = (int32_t)(((int64_t)px0 << EST_Q) / denom);
+    int32_t k1 = (int32_t)(((int64_t)px1 << EST_Q) / denom);
+
+    // Prediction error and parameter update theta += k * err
+    int32_t err = y - est_mul(xi, est_theta_r) - est_mul(xw, est_theta_ke);
+    est_theta_r += est_mul(k0, err);
+    est_theta_ke += est_mul(k1, err);
+
+    // Covariance update P = (P - k * Px') / lambda, clamped so the
+    // Q16.16 representation cannot overflow on long idle stretches.
+    int64_t p00 = (((int64_t)(est_p00 - est_mul(k0, px0))) << EST_Q) / EST_LAMBDA;
+    int64_t p01 = (((int64_t)(est_p01 - est_mul(k0, px1))) << EST_Q) / EST_LAMBDA;
+    int64_t p11 = (((int64_t)(est_p11 - est_mul(k1, px1))) << EST_Q) / EST_LAMBDA;
+    est_p00 = p00 > EST_P_MAX ? EST_P_MAX : (int32_t)p00;
+    est_p01 = p01 > EST_P_MAX ? EST_P_MAX : (int32_t)p01;
+    est_p11 = p11 > EST_P_MAX ? EST_P_MAX : (int32_t)p11;
+
+    est_samples++;
+
+    if (!est_converged && (est_p00 + est_p11) < EST_CONV_TRACE) {
+        est_converged = true;
+        ESP_LOGI(TAG, "Parameter estimator converged after %lu samples "
+                 "(R: %.3f Ohm, ke: %.4f V/(rad/s))",
+                 (unsigned long)est_samples,
+                 est_to_float(est_theta_r), est_to_float(est_theta_ke));
+    }
+}
+
+void hub_motor_estimator_get_state(hub_motor_estimator_state_t *state) {
+    if (!state) {
+        return;
+    }
+
+    state->resistance = est_to_float(est_theta_r);
+    state->ke = est_to_float(est_theta_ke);
+    state->sample_count = est_samples;
+    state->converged = est_converged;
+}
+
 void hub_motor_print_capabilities(void) {
     ESP_LOGI(TAG, "Hub Motor Enhancement Capabilities:");
     ESP_LOGI(TAG, "  ✓ Low-Speed Torque Optimization (2024 Research)");
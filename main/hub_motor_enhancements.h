@@ -97,4 +97,20 @@ typedef struct {
     float temperature_factor;
 } cogging_lut_t;
 
+// Online Parameter Estimation (Incremental RLS)
+typedef struct {
+    float resistance;       // Estimated winding resistance (Ohm)
+    float ke;               // Estimated back-EMF constant (V/(rad/s))
+    uint32_t sample_count;  // Samples processed since last reset
+    bool converged;         // Covariance has settled below threshold
+} hub_motor_estimator_state_t;
+
+// Rank-1 recursive least squares over the steady-state motor equation
+// v = R*i + ke*omega, implemented with Q16.16 fixed-point accumulators
+// so one update is a handful of integer multiplies and a single divide.
+// Feed at sample rate; read estimates from any context.
+void hub_motor_estimator_reset(float initial_resistance, float initial_ke);
+void hub_motor_estimator_update(float voltage, float current, float omega);
+void hub_motor_estimator_get_state(hub_motor_estimator_state_t *state);
+
 #endif /* HUB_MOTOR_ENHANCEMENTS_H_ */
\ No newline at end of file
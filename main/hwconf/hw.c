@@ -19,3 +19,116 @@
 
 #include "conf_general.h"
 #include HW_SOURCE
+
+#include "hw.h"
+#include "adc.h"
+#include "utils.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if HW_HAS_ADC
+
+/*
+ * Background ADC sampler shared by all hardware variants. A single
+ * low-priority task does the conversions and low-pass filters the
+ * results, so every values packet and script read costs a variable
+ * load instead of a fresh conversion. Values start at -1.0 and snap to
+ * the first conversion before filtering, so readers can tell an
+ * unsampled channel apart from a real voltage.
+ */
+static volatile float m_samp_v[HW_SAMPLER_CH_NUM] = {-1.0, -1.0, -1.0, -1.0, -1.0};
+static volatile bool m_samp_running = false;
+static volatile bool m_samp_should_stop = false;
+static volatile bool m_samp_task_running = false;
+static int m_samp_delay_ms = 10;
+
+static const adc_channel_t m_samp_channels[HW_SAMPLER_CH_NUM] = {
+		HW_ADC_CH0, HW_ADC_CH1, HW_ADC_CH2, HW_ADC_CH3, HW_ADC_CH4,
+};
+
+static void sampler_task(void *arg) {
+	(void)arg;
+
+	while (!m_samp_should_stop) {
+		for (int i = 0;i < HW_SAMPLER_CH_NUM;i++) {
+			float v = adc_get_voltage(m_samp_channels[i]);
+			if (v >= 0.0) {
+				if (m_samp_v[i] < 0.0) {
+					m_samp_v[i] = v;
+				} else {
+					UTILS_LP_FAST(m_samp_v[i], v, 0.2);
+				}
+			}
+		}
+
+		vTaskDelay(m_samp_delay_ms / portTICK_PERIOD_MS);
+	}
+
+	m_samp_task_running = false;
+	vTaskDelete(NULL);
+}
+
+void hw_sampler_start(int rate_hz) {
+	if (m_samp_running) {
+		return;
+	}
+
+	if (rate_hz < 1) {
+		rate_hz = 1;
+	}
+
+	m_samp_delay_ms = 1000 / rate_hz;
+	if (m_samp_delay_ms < (int)portTICK_PERIOD_MS) {
+		m_samp_delay_ms = (int)portTICK_PERIOD_MS;
+	}
+
+	m_samp_should_stop = false;
+	m_samp_task_running = true;
+	m_samp_running = true;
+	xTaskCreatePinnedToCore(sampler_task, "hw_samp", 2048, NULL, 1, NULL, tskNO_AFFINITY);
+}
+
+void hw_sampler_stop(void) {
+	if (!m_samp_running) {
+		return;
+	}
+
+	m_samp_should_stop = true;
+	while (m_samp_task_running) {
+		vTaskDelay(1);
+	}
+
+	m_samp_running = false;
+}
+
+bool hw_sampler_running(void) {
+	return m_samp_running;
+}
+
+float hw_sampler_get_voltage(int ch_index) {
+	if (ch_index < 0 || ch_index >= HW_SAMPLER_CH_NUM) {
+		return -1.0;
+	}
+
+	return m_samp_v[ch_index];
+}
+
+#else
+// Boards that set HW_HAS_ADC to 0 compile the sampler out entirely.
+void hw_sampler_start(int rate_hz) {
+	(void)rate_hz;
+}
+
+void hw_sampler_stop(void) {
+}
+
+bool hw_sampler_running(void) {
+	return false;
+}
+
+float hw_sampler_get_voltage(int ch_index) {
+	(void)ch_index;
+	return -1.0;
+}
+#endif
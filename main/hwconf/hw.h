@@ -70,6 +70,12 @@
 #define UART_RX						20
 #endif
 
+// Boards with RTS/CTS routed to the comm UART can define these to make
+// the high-speed UART profile (comm_uart_set_profile) able to enable
+// hardware flow control.
+//#define HW_UART_RTS				x
+//#define HW_UART_CTS				x
+
 #ifndef HW_ADC_CH0
 #define HW_ADC_CH0					ADC_CHANNEL_0
 #endif
@@ -86,4 +92,65 @@
 #define HW_ADC_CH4					ADC_CHANNEL_4
 #endif
 
+/*
+ * Per-board capability flags, resolved at compile time. Boards can
+ * override any flag in their hw_*.h; the rest are derived from defines
+ * the board already provides (pins, HW_NO_UART and so on). Shared code
+ * tests the flags with plain #if, so a disabled capability compiles
+ * out entirely instead of leaving a dead branch in a hot path.
+ */
+#ifndef HW_HAS_ADC
+#define HW_HAS_ADC					1
+#endif
+
+#ifndef HW_HAS_UART
+#ifdef HW_NO_UART
+#define HW_HAS_UART					0
+#else
+#define HW_HAS_UART					1
+#endif
+#endif
+
+#ifndef HW_HAS_CAN
+#ifdef CAN_TX_GPIO_NUM
+#define HW_HAS_CAN					1
+#else
+#define HW_HAS_CAN					0
+#endif
+#endif
+
+#ifndef HW_HAS_RGB_LED
+#define HW_HAS_RGB_LED				0
+#endif
+
+#ifndef HW_HAS_SD_CARD
+#ifdef SD_PIN_MOSI
+#define HW_HAS_SD_CARD				1
+#else
+#define HW_HAS_SD_CARD				0
+#endif
+#endif
+
+#ifndef HW_HAS_NAND_FLASH
+#ifdef NAND_PIN_MOSI
+#define HW_HAS_NAND_FLASH			1
+#else
+#define HW_HAS_NAND_FLASH			0
+#endif
+#endif
+
+// Background ADC sampler. When started, a low-priority task keeps
+// filtered copies of the configured ADC channels updated at the given
+// rate, so hot telemetry paths and scripts read a cached variable
+// instead of triggering a conversion. Reads are lock-free: there is a
+// single writer and the values are word-sized.
+#define HW_SAMPLER_CH_NUM			5
+
+void hw_sampler_start(int rate_hz);
+void hw_sampler_stop(void);
+bool hw_sampler_running(void);
+// ch_index 0 - 4 maps to HW_ADC_CH0 - HW_ADC_CH4. Returns -1.0 until
+// the sampler has produced a value for the channel.
+float hw_sampler_get_voltage(int ch_index);
+
 #endif /* MAIN_HWCONF_HW_H_ */
@@ -46,6 +46,53 @@ static unsigned int m_cells_ic2 = 16;
 static uint16_t m_bal_state_ic1 = 0;
 static uint16_t m_bal_state_ic2 = 0;
 
+/*
+ * Incrementally sorted cell-voltage index, maintained as cell reads land
+ * in bms-get-vcells. A balance pass can take its candidates from an
+ * already sorted order instead of re-sorting all cells, and ADC noise
+ * only moves a cell a few positions between reads, so the reposition
+ * step stays cheap.
+ */
+static float m_cell_v_cache[32];
+static uint8_t m_cell_order[32]; // Cell indices, lowest voltage first
+static int m_cell_order_num = 0;
+
+static void cell_cache_update(int cell, float v) {
+	if (cell < 0 || cell >= 32) {
+		return;
+	}
+
+	m_cell_v_cache[cell] = v;
+
+	int pos = -1;
+	for (int i = 0;i < m_cell_order_num;i++) {
+		if (m_cell_order[i] == cell) {
+			pos = i;
+			break;
+		}
+	}
+
+	if (pos < 0) {
+		pos = m_cell_order_num++;
+		m_cell_order[pos] = cell;
+	}
+
+	while (pos > 0 && m_cell_v_cache[m_cell_order[pos - 1]] > v) {
+		uint8_t tmp = m_cell_order[pos - 1];
+		m_cell_order[pos - 1] = m_cell_order[pos];
+		m_cell_order[pos] = tmp;
+		pos--;
+	}
+
+	while (pos < (m_cell_order_num - 1) &&
+			m_cell_v_cache[m_cell_order[pos + 1]] < v) {
+		uint8_t tmp = m_cell_order[pos + 1];
+		m_cell_order[pos + 1] = m_cell_order[pos];
+		m_cell_order[pos] = tmp;
+		pos++;
+	}
+}
+
 // Error messages
 static char *error_comm_bq1 = "BQ1 communication error";
 static char *error_comm_bq2 = "BQ2 communication error";
@@ -453,6 +500,7 @@ static lbm_value ext_bms_init(lbm_value *args, lbm_uint argn) {
 
 	m_bal_state_ic1 = 0;
 	m_bal_state_ic2 = 0;
+	m_cell_order_num = 0;
 
 	unsigned int cells_ic1 = 16;
 	if (argn >= 1) {
@@ -615,6 +663,7 @@ static lbm_value ext_get_vcells(lbm_value *args, lbm_uint argn) {
 		bool ok = false;
 		int res = command_read(BQ_ADDR_1, Cell1Voltage + i * 2, &ok);
 		if (ok) {
+			cell_cache_update(i, (float)res / 1000.0);
 			vc_list = lbm_cons(lbm_enc_float((float)res / 1000.0), vc_list);
 		} else {
 			lbm_set_error_reason(error_comm_bq1);
@@ -626,6 +675,7 @@ static lbm_value ext_get_vcells(lbm_value *args, lbm_uint argn) {
 		bool ok = false;
 		int res = command_read(BQ_ADDR_2, Cell1Voltage + i * 2, &ok);
 		if (ok) {
+			cell_cache_update(m_cells_ic1 + i, (float)res / 1000.0);
 			vc_list = lbm_cons(lbm_enc_float((float)res / 1000.0), vc_list);
 		} else {
 			lbm_set_error_reason(error_comm_bq2);
@@ -877,6 +927,21 @@ static lbm_value ext_get_bal(lbm_value *args, lbm_uint argn) {
 	return lbm_enc_i(res);
 }
 
+// Cell indices sorted by voltage from the cache bms-get-vcells maintains.
+// Consing from the lowest-first order gives highest voltage first, which
+// is the order the balance loop wants its candidates in.
+static lbm_value ext_get_bal_order(lbm_value *args, lbm_uint argn) {
+	(void)args;
+	(void)argn;
+
+	lbm_value order = ENC_SYM_NIL;
+	for (int i = 0;i < m_cell_order_num;i++) {
+		order = lbm_cons(lbm_enc_i(m_cell_order[i]), order);
+	}
+
+	return order;
+}
+
 static lbm_value ext_direct_cmd(lbm_value *args, lbm_uint argn) {
 	LBM_CHECK_ARGN_NUMBER(2);
 
@@ -1354,6 +1419,7 @@ static void load_extensions(bool main_found) {
 	// Set and get balancing state for cell
 	lbm_add_extension("bms-set-bal", ext_set_bal);
 	lbm_add_extension("bms-get-bal", ext_get_bal);
+	lbm_add_extension("bms-get-bal-order", ext_get_bal_order);
 
 	// HW-specific commands
 	lbm_add_extension("bms-direct-cmd", ext_direct_cmd);
@@ -23,6 +23,7 @@
 
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 // IEEE 802.15.4 includes - may not be available in all ESP-IDF versions
 #ifdef CONFIG_IEEE802154_ENABLED
 #include "esp_ieee802154.h"
@@ -39,19 +40,46 @@ static zigbee_config_t zigbee_config = ZIGBEE_CONFIG_DEFAULT();
 static bool ieee802154_initialized = false;
 static void (*receive_callback)(const uint8_t *data, size_t len) = NULL;
 
+// Minimal-latency raw frame path. Received frames are copied into
+// preallocated slots and timestamped directly in the RX-done callback,
+// before any driver queueing, so the reader sees arrival times with
+// ISR-level accuracy. The slot ring is single-producer (the callback)
+// single-consumer (whoever polls ieee802154_fast_rx_pop), so no locking
+// is needed; a full ring drops the frame and counts it.
+#define FAST_RX_SLOTS           8
+
+static ieee802154_fast_frame_t fast_rx_slots[FAST_RX_SLOTS];
+static volatile uint32_t fast_rx_head = 0; // Written by the consumer
+static volatile uint32_t fast_rx_tail = 0; // Written by the RX callback
+static volatile uint32_t fast_rx_drop_cnt = 0;
+
 // IEEE 802.15.4 receive callback
 #ifdef CONFIG_IEEE802154_ENABLED
 static void ieee802154_receive_done(uint8_t *frame, esp_ieee802154_frame_info_t *frame_info) {
+    if (frame && frame_info) {
+        uint32_t next = (fast_rx_tail + 1) % FAST_RX_SLOTS;
+        if (next != fast_rx_head) {
+            ieee802154_fast_frame_t *slot = &fast_rx_slots[fast_rx_tail];
+            slot->timestamp_us = esp_timer_get_time();
+            slot->rssi = frame_info->rssi;
+            slot->len = frame_info->length > IEEE802154_FRAME_MAX ?
+                    IEEE802154_FRAME_MAX : frame_info->length;
+            memcpy(slot->data, frame, slot->len);
+            fast_rx_tail = next;
+        } else {
+            fast_rx_drop_cnt++;
+        }
+    }
+
     if (receive_callback && frame && frame_info) {
         // Extract payload from the frame (skip MAC header)
         uint8_t *payload = frame + 3; // Skip FCF, sequence, and addressing
         size_t payload_len = frame_info->length - 3;
-        
+
         receive_callback(payload, payload_len);
     }
 }
 #endif
-}
 
 void ieee802154_init(void) {
     if (ieee802154_initialized) {
@@ -82,8 +110,8 @@ void ieee802154_init(void) {
     ieee802154_print_capabilities();
 }
 
-#ifdef CONFIG_IEEE802154_ENABLED
 bool ieee802154_configure(const ieee802154_config_t *config) {
+#ifdef CONFIG_IEEE802154_ENABLED
     if (!config) {
         ESP_LOGE(TAG, "Invalid configuration pointer");
         return false;
@@ -156,13 +184,14 @@ bool ieee802154_configure(const ieee802154_config_t *config) {
     ESP_LOGI(TAG, "IEEE 802.15.4 configuration completed");
     return true;
 #else
+    (void)config;
     ESP_LOGW(TAG, "IEEE 802.15.4 not available");
     return false;
 #endif
 }
 
-#ifdef CONFIG_IEEE802154_ENABLED
 bool ieee802154_start(void) {
+#ifdef CONFIG_IEEE802154_ENABLED
     if (!ieee802154_initialized) {
         ESP_LOGE(TAG, "IEEE 802.15.4 not initialized");
         return false;
@@ -241,6 +270,67 @@ void ieee802154_set_receive_callback(void (*callback)(const uint8_t *data, size_
     receive_callback = callback;
 }
 
+bool ieee802154_send_frame_immediate(const uint8_t *data, size_t len, uint16_t dst_addr) {
+#ifdef CONFIG_IEEE802154_ENABLED
+    if (!ieee802154_initialized || !data || len == 0) {
+        return false;
+    }
+
+    // Preallocated TX slot, header layout matches ieee802154_send_frame.
+    // The transmit is handed to the radio without CCA backoff, so air
+    // latency stays deterministic; callers use this for short signaling
+    // frames where an application-level retry is cheaper than the CCA
+    // wait.
+    static uint8_t frame[IEEE802154_FRAME_MAX];
+    size_t frame_len = 0;
+
+    // Frame Control Field (FCF)
+    frame[frame_len++] = 0x41; // Data frame, short addressing
+    frame[frame_len++] = 0x88; // PAN ID compression
+
+    // Sequence number
+    static uint8_t seq_num_fast = 0;
+    frame[frame_len++] = seq_num_fast++;
+
+    // Destination PAN ID and address
+    frame[frame_len++] = current_config.pan_id & 0xFF;
+    frame[frame_len++] = (current_config.pan_id >> 8) & 0xFF;
+    frame[frame_len++] = dst_addr & 0xFF;
+    frame[frame_len++] = (dst_addr >> 8) & 0xFF;
+
+    // Source address
+    frame[frame_len++] = current_config.short_addr & 0xFF;
+    frame[frame_len++] = (current_config.short_addr >> 8) & 0xFF;
+
+    if (frame_len + len > sizeof(frame)) {
+        ESP_LOGE(TAG, "Frame too large");
+        return false;
+    }
+
+    memcpy(&frame[frame_len], data, len);
+    frame_len += len;
+
+    return esp_ieee802154_transmit(frame, false) == ESP_OK;
+#else
+    (void)data; (void)len; (void)dst_addr;
+    return false;
+#endif
+}
+
+bool ieee802154_fast_rx_pop(ieee802154_fast_frame_t *frame) {
+    if (fast_rx_head == fast_rx_tail) {
+        return false;
+    }
+
+    *frame = fast_rx_slots[fast_rx_head];
+    fast_rx_head = (fast_rx_head + 1) % FAST_RX_SLOTS;
+    return true;
+}
+
+uint32_t ieee802154_fast_rx_dropped(void) {
+    return fast_rx_drop_cnt;
+}
+
 bool thread_init(const thread_config_t *config) {
     if (!config) {
         ESP_LOGE(TAG, "Invalid Thread configuration");
@@ -368,14 +458,10 @@ void ieee802154_set_channel(uint8_t channel) {
     if (ieee802154_initialized) {
         esp_ieee802154_set_channel(channel);
     }
+#else
+    (void)channel;
 #endif
 }
-    
-    current_config.channel = channel;
-    if (ieee802154_initialized) {
-        esp_ieee802154_set_channel(channel);
-    }
-}
 
 uint8_t ieee802154_get_channel(void) {
     return current_config.channel;
@@ -24,6 +24,18 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// Maximum 802.15.4 frame size
+#define IEEE802154_FRAME_MAX    127
+
+// One frame through the minimal-latency raw path. The timestamp is
+// taken in the RX-done callback before any queueing.
+typedef struct {
+    int64_t timestamp_us;
+    int8_t rssi;
+    uint8_t len;
+    uint8_t data[IEEE802154_FRAME_MAX];
+} ieee802154_fast_frame_t;
+
 #ifdef CONFIG_IDF_TARGET_ESP32C6
 
 // IEEE 802.15.4 configuration for Thread/Zigbee support
@@ -101,6 +113,13 @@ void ieee802154_stop(void);
 bool ieee802154_send_frame(const uint8_t *data, size_t len, uint16_t dst_addr);
 void ieee802154_set_receive_callback(void (*callback)(const uint8_t *data, size_t len));
 
+// Minimal-latency raw frame path for sub-millisecond inter-board
+// signaling: TX goes to the radio without CCA backoff, RX frames come
+// out of preallocated slots with ISR-level arrival timestamps.
+bool ieee802154_send_frame_immediate(const uint8_t *data, size_t len, uint16_t dst_addr);
+bool ieee802154_fast_rx_pop(ieee802154_fast_frame_t *frame);
+uint32_t ieee802154_fast_rx_dropped(void);
+
 // Thread protocol functions
 bool thread_init(const thread_config_t *config);
 bool thread_start_network(void);
@@ -128,6 +147,9 @@ static inline bool ieee802154_start(void) { return false; }
 static inline void ieee802154_stop(void) {}
 static inline bool ieee802154_send_frame(const uint8_t *data, size_t len, uint16_t dst_addr) { return false; }
 static inline void ieee802154_set_receive_callback(void (*callback)(const uint8_t *data, size_t len)) {}
+static inline bool ieee802154_send_frame_immediate(const uint8_t *data, size_t len, uint16_t dst_addr) { return false; }
+static inline bool ieee802154_fast_rx_pop(ieee802154_fast_frame_t *frame) { return false; }
+static inline uint32_t ieee802154_fast_rx_dropped(void) { return 0; }
 static inline bool thread_init(const void *config) { return false; }
 static inline bool thread_start_network(void) { return false; }
 static inline void thread_stop_network(void) {}
@@ -0,0 +1,157 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "lbm_bench.h"
+#include "lispif.h"
+#include "commands.h"
+
+#include "heap.h"
+#include "eval_cps.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+
+/*
+ * On-target interpreter benchmarks. The programs are the small ones
+ * from lispBM/benchmarks, embedded here so dispatch, GC and arithmetic
+ * changes can be measured on the silicon they target instead of on a
+ * desktop build. Each benchmark runs in a fresh context after an
+ * evaluator restart without the stored script, so results are
+ * comparable between runs; the caller is expected to restart with the
+ * stored code afterwards (lbm_bench_run_all_print does).
+ */
+
+typedef struct {
+	const char *name;
+	const char *code;
+} bench_entry;
+
+static const bench_entry m_benchmarks[] = {
+	{"dec_cnt1",
+		"(define dec-cnt (lambda (x) (if (= x 0) 0 (dec-cnt (- x 1)))))"
+		"(dec-cnt 100000)"},
+	{"dec_cnt2",
+		"(define dec-cnt2 (lambda (x) (match x (0 0) (_ (dec-cnt2 (- x 1))))))"
+		"(dec-cnt2 100000)"},
+	{"dec_cnt3",
+		"(define dec-cnt3 (lambda (x)"
+		" (if (> x 0) (dec-cnt3 (- (- (- (- (- (- (- x 1) 1) 1) 1) 1) 1) 1)) 0)))"
+		"(dec-cnt3 100000)"},
+	{"fibonacci",
+		"(let ((fib (lambda (n) (if (> 2 n) n (+ (fib (- n 1)) (fib (- n 2)))))))"
+		" (fib 23))"},
+	{"fibonacci_tail",
+		"(define fib (lambda (n)"
+		" (let ((fib0 (lambda (n a b)"
+		"  (if (= n 0) a (if (= n 1) b (fib0 (- n 1) b (+ a b)))))))"
+		"  (fib0 n 0 1))))"
+		"(fib 23)"},
+	{"tak",
+		"(define tak (lambda (x y z)"
+		" (if (not (< y x)) z"
+		"  (tak (tak (- x 1) y z) (tak (- y 1) z x) (tak (- z 1) x y)))))"
+		"(tak 18 12 6)"},
+	{"q2",
+		"(define q2 (lambda (x y)"
+		" (if (or (< x 1) (< y 1)) 1"
+		"  (+ (q2 (- x (q2 (- x 1) y)) y) (q2 x (- y (q2 x (- y 1))))))))"
+		"(q2 6 7)"},
+	{"loop_200k",
+		"(loop ((n 200000)) (> n 0) (setq n (- n 1)))"},
+	{"tail_call_200k",
+		"(define f (lambda (n) (if (= n 0) () (f (- n 1)))))"
+		"(f 200000)"},
+	{"insertionsort",
+		"(define insert (lambda (l ls)"
+		" (match ls"
+		"  (nil (cons l nil))"
+		"  (((? a) . (? xs))"
+		"   (if (< l a) (cons l (cons a xs)) (cons a (insert l xs)))))))"
+		"(define isort (lambda (ls)"
+		" (match ls (nil nil) (((? a) . (? xs)) (insert a (isort xs))))))"
+		"(isort '(4 2 0 9 1 56 2 4 7))"},
+};
+
+#define BENCH_NUM			(sizeof(m_benchmarks) / sizeof(bench_entry))
+#define BENCH_TIMEOUT_MS	60000
+
+int lbm_bench_num(void) {
+	return BENCH_NUM;
+}
+
+const char *lbm_bench_name(int ind) {
+	if (ind < 0 || ind >= (int)BENCH_NUM) {
+		return "";
+	}
+
+	return m_benchmarks[ind].name;
+}
+
+bool lbm_bench_run(int ind, lbm_bench_result *res) {
+	memset(res, 0, sizeof(lbm_bench_result));
+
+	if (ind < 0 || ind >= (int)BENCH_NUM) {
+		return false;
+	}
+
+	// Fresh evaluator without the stored script, so the only load is
+	// the benchmark itself.
+	if (!lispif_restart(false, false, false)) {
+		return false;
+	}
+
+	uint32_t steps_start = lbm_get_eval_steps();
+	uint32_t gc_num_start = lbm_heap_state.gc_num;
+	uint32_t gc_time_start = lbm_heap_state.gc_time_acc;
+	int64_t t_start = esp_timer_get_time();
+
+	res->ok = lispif_eval_sync(m_benchmarks[ind].code, BENCH_TIMEOUT_MS);
+
+	res->eval_us = (uint32_t)(esp_timer_get_time() - t_start);
+	res->steps = lbm_get_eval_steps() - steps_start;
+	res->gc_num = lbm_heap_state.gc_num - gc_num_start;
+	res->gc_time_us = lbm_heap_state.gc_time_acc - gc_time_start;
+
+	if (res->eval_us > 0) {
+		res->steps_per_sec =
+				(uint32_t)(((uint64_t)res->steps * 1000000) / res->eval_us);
+	}
+
+	return true;
+}
+
+void lbm_bench_run_all_print(void) {
+	for (int i = 0;i < (int)BENCH_NUM;i++) {
+		lbm_bench_result res;
+		if (!lbm_bench_run(i, &res)) {
+			commands_printf("lbm_bench,%s,failed=restart", m_benchmarks[i].name);
+			continue;
+		}
+
+		commands_printf("lbm_bench,%s,ok=%d,eval_us=%lu,steps=%lu,"
+				"steps_s=%lu,gc=%lu,gc_us=%lu",
+				m_benchmarks[i].name, res.ok, res.eval_us, res.steps,
+				res.steps_per_sec, res.gc_num, res.gc_time_us);
+	}
+
+	// Put the stored script back.
+	lispif_restart(false, true, true);
+	commands_printf("lbm_bench,done");
+}
@@ -0,0 +1,41 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_LBM_BENCH_H_
+#define MAIN_LBM_BENCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	bool ok;
+	uint32_t eval_us;
+	uint32_t steps;
+	uint32_t steps_per_sec;
+	uint32_t gc_num;
+	uint32_t gc_time_us;
+} lbm_bench_result;
+
+// Functions
+int lbm_bench_num(void);
+const char *lbm_bench_name(int ind);
+bool lbm_bench_run(int ind, lbm_bench_result *res);
+void lbm_bench_run_all_print(void);
+
+#endif /* MAIN_LBM_BENCH_H_ */
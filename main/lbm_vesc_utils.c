@@ -19,6 +19,7 @@
 	*/
 
 #include <stdbool.h>
+#include <string.h>
 
 #include "symrepr.h"
 #include "lbm_defines.h"
@@ -124,6 +125,84 @@ bool lbm_check_argn_least(lbm_uint argn, lbm_uint n_min) {
 	return true;
 }
 
+extern const char *lbm_error_str_no_number;
+extern const char *lbm_error_str_incorrect_arg;
+bool lbm_dec_args(lbm_value *args, lbm_uint argn, const char *spec, lbm_arg_t *out) {
+	lbm_uint i = 0;
+	bool optional = false;
+
+	for (const char *c = spec; *c != '\0'; c++) {
+		if (*c == '|') {
+			optional = true;
+			continue;
+		}
+
+		if (i >= argn) {
+			if (optional) {
+				memset(&out[i], 0, sizeof(lbm_arg_t));
+				i++;
+				continue;
+			}
+			lbm_set_error_reason((char *)lbm_error_str_num_args);
+			return false;
+		}
+
+		switch (*c) {
+		case 'f':
+			if (!lbm_is_number(args[i])) {
+				lbm_set_error_reason((char *)lbm_error_str_no_number);
+				return false;
+			}
+			out[i].f = lbm_dec_as_float(args[i]);
+			break;
+
+		case 'i':
+			if (!lbm_is_number(args[i])) {
+				lbm_set_error_reason((char *)lbm_error_str_no_number);
+				return false;
+			}
+			out[i].i = lbm_dec_as_i32(args[i]);
+			break;
+
+		case 'u':
+			if (!lbm_is_number(args[i])) {
+				lbm_set_error_reason((char *)lbm_error_str_no_number);
+				return false;
+			}
+			out[i].u = lbm_dec_as_u32(args[i]);
+			break;
+
+		case 'a': {
+			lbm_array_header_t *header = lbm_dec_array_header(args[i]);
+			if (header == NULL) {
+				lbm_set_error_reason((char *)lbm_error_str_incorrect_arg);
+				return false;
+			}
+			out[i].arr.data = (uint8_t *)header->data;
+			out[i].arr.len = header->size;
+			break;
+		}
+
+		default:
+			lbm_set_error_reason((char *)lbm_error_str_incorrect_arg);
+			return false;
+		}
+
+		i++;
+	}
+
+	if (i < argn) {
+		lbm_set_error_reason((char *)lbm_error_str_num_args);
+		return false;
+	}
+
+	return true;
+}
+
+bool lbm_make_array_view(void *data, lbm_uint size, lbm_value *res) {
+	return lbm_lift_array(res, (char *)data, size) == 1;
+}
+
 bool f_pack_array(lbm_flat_value_t *result, void *data, size_t size) {
 	if (!lbm_start_flatten(result, 5 + size)) {
 		return false;
@@ -182,6 +182,69 @@ bool lbm_check_argn_least(lbm_uint argn, lbm_uint n_min);
 		return ENC_SYM_EERROR;                                                 \
 	}
 
+/**
+ * A single argument decoded by lbm_dec_args.
+*/
+typedef union {
+	float f;
+	int32_t i;
+	uint32_t u;
+	struct {
+		uint8_t *data;
+		lbm_uint len;
+	} arr;
+} lbm_arg_t;
+
+/**
+ * Declarative argument decoding. The spec holds one character per argument:
+ *
+ *   'f'  any number, decoded as float
+ *   'i'  any number, decoded as i32
+ *   'u'  any number, decoded as u32
+ *   'a'  byte array, decoded as data pointer and length
+ *   '|'  all spec characters after this one are optional
+ *
+ * Count validation and unpacking happen in one pass, replacing the usual
+ * hand-rolled chains of lbm_is_number/lbm_dec_as_* calls. Optional arguments
+ * that were not provided are left zeroed, so numeric defaults of 0 come for
+ * free and array entries can be tested against NULL.
+ *
+ * Sets error-reason if result is false.
+ *
+ * @param args Argument array as passed to the extension.
+ * @param argn Number of arguments.
+ * @param spec Type signature, see above.
+ * @param out Caller-allocated array with one entry per spec character,
+ * not counting '|'.
+ * @return If the arguments matched the spec.
+*/
+bool lbm_dec_args(lbm_value *args, lbm_uint argn, const char *spec, lbm_arg_t *out);
+
+#define LBM_DEC_ARGS(spec, out)                                                \
+	if (!lbm_dec_args(args, argn, (spec), (out))) {                            \
+		return ENC_SYM_TERROR;                                                 \
+	}
+
+/**
+ * Create a zero-copy array view over C-owned memory. The result is a
+ * normal lbm byte array whose data pointer references the backing
+ * memory directly, so reads always see the live C state without a
+ * per-access copy - only the array header is allocated.
+ *
+ * GC never frees the backing memory (lbm_memory_free ignores pointers
+ * outside the lbm memory pool), but the backing memory must stay valid
+ * for the lifetime of the lisp heap, so only hand out views of
+ * statically allocated state. Views should be treated as read-only by
+ * scripts; writing through one writes straight into the C state.
+ *
+ * @param data Pointer to the C-owned memory.
+ * @param size Size of the view in bytes.
+ * @param res Set to the created array value, or ENC_SYM_MERROR on
+ * allocation failure.
+ * @return If the view was created.
+*/
+bool lbm_make_array_view(void *data, lbm_uint size, lbm_value *res);
+
 /**
  * Construct a flat value containing a single lbm array from a c array,
  * automatically allocating a flat value of the required size.
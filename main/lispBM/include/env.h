@@ -28,6 +28,8 @@ extern "C" {
 #define GLOBAL_ENV_ROOTS 32
 #define GLOBAL_ENV_MASK  0x1F
 
+#define GLOBAL_ENV_CACHE_SIZE 32 // Must be a power of two.
+
 //environment interface
 /** Initialize the global environment. This sets the global environment to NIL
  *
@@ -65,6 +67,12 @@ bool lbm_env_lookup_b(lbm_value *res, lbm_value sym, lbm_value env);
  * \return True on success or false otherwise.
  */
 bool lbm_global_env_lookup(lbm_value *res, lbm_value sym);
+/** Drop a key from the global environment lookup cache. Must be
+ * called whenever a binding is removed from the global environment,
+ * such as by undefine.
+ * \param key The symbol whose cached binding should be dropped.
+ */
+void lbm_global_env_cache_drop(lbm_value key);
 /** Create a new binding on the environment or replace an old binding.
  *
  * \param env Environment to modify.
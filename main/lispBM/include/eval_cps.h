@@ -76,6 +76,7 @@ typedef struct eval_context_s{
   lbm_uint timestamp;
   lbm_uint sleep_us;
   uint32_t state;
+  uint32_t quota_weight; /* Evaluation quota multiplier, see lbm_set_ctx_quota_weight */
   char *name;
   lbm_cid id;
   lbm_cid parent;
@@ -144,6 +145,25 @@ void lbm_set_eval_time_quota(uint32_t quota);
  */
 void lbm_set_eval_step_quota(uint32_t quota);
 #endif
+/** Maximum evaluation quota weight that can be given to a context. */
+#define LBM_QUOTA_WEIGHT_MAX 32
+/** Set the evaluation quota weight of a context. A context with weight
+ *  N is given N times the base quota each time it is scheduled, so
+ *  latency-critical contexts keep a guaranteed share of evaluator time
+ *  when competing with background contexts. All contexts start with
+ *  weight 1.
+ *  \param cid Context id.
+ *  \param weight Weight between 1 and LBM_QUOTA_WEIGHT_MAX (clamped).
+ *  \return true if the context was found, false otherwise.
+ */
+bool lbm_set_ctx_quota_weight(lbm_cid cid, uint32_t weight);
+/** Enable or disable evaluator preemption on event arrival. When
+ *  enabled, posting an event zeroes the remaining quota of the running
+ *  context so the scheduler reaches process_events at the next step
+ *  boundary instead of after a full quota round. Disabled by default.
+ *  \param enable True to enable preemption.
+ */
+void lbm_set_event_preempt(bool enable);
 /** Initialize events
  * \param num_events The maximum number of unprocessed events.
  * \return true on success, false otherwise.
@@ -249,6 +269,12 @@ void lbm_kill_eval(void);
  * \return Current state of the evaluator.
  */
 uint32_t lbm_get_eval_state(void);
+/** Get the total number of evaluation steps performed since startup.
+ *  Wraps around; meant for computing deltas.
+ *
+ * \return Number of evaluation steps.
+ */
+lbm_uint lbm_get_eval_steps(void);
 /** Provide a description of an error as a string.
  *  Use when implementing for example extensions to
  *  report an error message to the programmer in case
@@ -347,6 +373,14 @@ void lbm_set_verbose(bool verbose);
  * \param hide true to hide error messages when trapped.
  */
 void lbm_set_hide_trapped_error(bool hide);
+/** Enable or disable load-time constant folding.
+ *  When enabled, each expression produced by the reader is rewritten
+ *  before evaluation: applications of pure arithmetic and comparison
+ *  fundamentals where all arguments are number literals are replaced
+ *  by their result. Off by default.
+ * \param enable true to fold constants at load time.
+ */
+void lbm_set_const_fold(bool enable);
 /** Set a usleep callback for use by the evaluator thread.
  *
  * \param fptr Pointer to a sleep function.
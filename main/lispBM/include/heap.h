@@ -226,6 +226,9 @@ typedef struct {
   lbm_uint gc_least_free;      // The smallest length of the freelist.
   lbm_uint gc_last_free;       // Number of elements on the freelist
                                // after most recent GC.
+  lbm_uint gc_time_acc;        // Accumulated GC pause time.
+  lbm_uint gc_min_duration;    // Shortest GC pause.
+  lbm_uint gc_max_duration;    // Longest GC pause.
 } lbm_heap_state_t;
 
 extern lbm_heap_state_t lbm_heap_state;
@@ -606,10 +609,34 @@ void lbm_gc_mark_aux(lbm_uint *data, lbm_uint n);
  */
 void lbm_gc_mark_roots(lbm_uint *roots, lbm_uint num_roots);
 /** Sweep up all non marked heap cells and place them on the free list.
- *
+ *  With LBM_USE_INCREMENTAL_GC this only clears mark bits and records
+ *  the garbage cells, which are then freed by lbm_gc_sweep_slice.
  * \return 1
  */
 int lbm_gc_sweep_phase(void);
+#ifdef LBM_USE_INCREMENTAL_GC
+/** Free up to max_cells recorded garbage cells onto the free list.
+ * \param max_cells Maximum number of cells to free in this slice.
+ * \return 1
+ */
+int lbm_gc_sweep_slice(lbm_uint max_cells);
+/** Run one budget-sized sweep slice if a sweep is pending.
+ */
+void lbm_gc_sweep_continue(void);
+/** Drain the entire pending sweep, freeing all recorded garbage.
+ *  For allocation-failure paths that must see every recoverable cell
+ *  before reporting out of memory.
+ */
+void lbm_gc_sweep_finish(void);
+/** Set the number of cells freed per incremental sweep slice.
+ * \param cells Cells per slice, must be > 0.
+ */
+void lbm_set_gc_sweep_budget(lbm_uint cells);
+/** Mark all cells on the freelist so the sweep scan leaves them alone.
+ *  Used instead of lbm_nil_freelist when collecting incrementally.
+ */
+void lbm_gc_mark_freelist(void);
+#endif
 
 // Array functionality
 /** Allocate an bytearray in symbols and arrays memory (lispbm_memory.h)
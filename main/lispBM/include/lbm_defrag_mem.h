@@ -26,6 +26,19 @@ extern void lbm_defrag_mem_destroy(lbm_uint *ptr);
 extern lbm_value lbm_defrag_mem_alloc(lbm_uint *defrag_mem, lbm_uint nbytes);
 //extern lbm_value lbm_defrag_mem_alloc_lisparray(lbm_uint *defrag_mem, lbm_uint elts);
 extern void lbm_defrag_mem_free(lbm_uint* data);
+// Clear the registry of defrag mems tracked for background
+// compaction. Called when the runtime system is (re)initialized.
+extern void lbm_defrag_mem_reset(void);
+// Perform one budget-bounded compaction step on a dirty defrag mem,
+// if there is one. Called by the evaluator between evaluation quanta.
+extern void lbm_defrag_mem_compact_continue(void);
+// Set the background compaction step budget in words.
+extern void lbm_set_defrag_compact_budget(lbm_uint words);
+// Number of compaction steps performed since startup.
+extern lbm_uint lbm_defrag_mem_compact_steps(void);
+// True if ptr points into a registered defrag mem. Data there can be
+// moved by compaction, so its address cannot be used as a stable key.
+extern bool lbm_defrag_mem_ptr_inside(uint8_t *ptr);
 
 static inline bool lbm_defrag_mem_valid(lbm_value arr) {
   return !(lbm_is_symbol_nil(lbm_car(arr))); 
@@ -65,6 +65,16 @@ typedef struct {
 
 
 bool lbm_start_flatten(lbm_flat_value_t *v, size_t buffer_size);
+// Flatten into an externally provided buffer instead of lbm memory.
+// The buffer must stay alive until it is freed by the consumer via
+// lbm_free_flat_buffer.
+bool lbm_start_flatten_buffer(lbm_flat_value_t *v, uint8_t *buffer, size_t buffer_size);
+// Callback used by lbm_free_flat_buffer for flat value buffers that
+// are not stored in lbm memory.
+void lbm_set_flat_ext_free_callback(void (*f)(uint8_t *buf));
+// Free a flat value buffer. Buffers in lbm memory are freed there,
+// other buffers are handed to the registered ext free callback.
+void lbm_free_flat_buffer(uint8_t *buf);
 bool lbm_finish_flatten(lbm_flat_value_t *v);
 bool f_cons(lbm_flat_value_t *v);
 bool f_lisp_array(lbm_flat_value_t *v, uint32_t num_elt);
@@ -76,6 +86,7 @@ bool f_b(lbm_flat_value_t *v, uint8_t b);
 bool f_i32(lbm_flat_value_t *v, int32_t w);
 bool f_u32(lbm_flat_value_t *v, uint32_t w);
 bool f_float(lbm_flat_value_t *v, float f);
+bool f_double(lbm_flat_value_t *v, double d);
 bool f_i64(lbm_flat_value_t *v, int64_t w);
 bool f_u64(lbm_flat_value_t *v, uint64_t w);
 bool f_lbm_array(lbm_flat_value_t *v, uint32_t num_bytes, uint8_t *data);
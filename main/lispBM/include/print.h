@@ -42,6 +42,16 @@ bool lbm_value_is_printable_string(lbm_value v, char **str);
  */
 int lbm_print_init(lbm_uint print_stack_size);
 
+/** Set truncation limits for value printing.
+ *  Deeply nested or very long structures are cut off with "..." instead of
+ *  being printed in full, which bounds both the time and the work-stack
+ *  usage of a print.
+ *
+ * \param max_depth Maximum nesting depth of lists and arrays that is printed. 0 for no limit.
+ * \param max_length Maximum number of elements printed per list or array. 0 for no limit.
+ */
+void lbm_print_set_limits(lbm_uint max_depth, lbm_uint max_length);
+
 /** Print an lbm_value into a buffer provided by the user.
  *  If printing fails, the buffer may contain an error message.
  *
@@ -34,6 +34,7 @@ typedef struct {
   lbm_uint* data;
   lbm_uint sp;
   lbm_uint size;
+  lbm_uint max_size;
 } lbm_stack_t;
 
 /** Allocate a stack on the symbols and arrays memory.
@@ -43,6 +44,23 @@ typedef struct {
  * \return 1 on success and 0 on failure.
  */
 int lbm_stack_allocate(lbm_stack_t *s, lbm_uint stack_size);
+/** Allocate a stack that can grow on demand.
+ *  Only initial_size words are allocated up front. The stack can then
+ *  be extended with lbm_stack_grow up to max_size words.
+ * \param s Pointer to an lbm_stack_t to initialize.
+ * \param initial_size Size in words of the initial allocation.
+ * \param max_size Size in words that the stack may grow to.
+ * \return 1 on success and 0 on failure.
+ */
+int lbm_stack_allocate_growable(lbm_stack_t *s, lbm_uint initial_size, lbm_uint max_size);
+/** Grow a stack allocated with lbm_stack_allocate_growable.
+ *  The stack size is doubled, capped at max_size. The contents of the
+ *  stack are preserved but the storage moves, so no pointers into the
+ *  stack data may be live across this call.
+ * \param s Stack to grow.
+ * \return 1 on success and 0 on failure (at max size or out of memory).
+ */
+int lbm_stack_grow(lbm_stack_t *s);
 /** Create a stack in a statically allocated array.
  *
  * \param s Pointer to an lbm_stack_t to initialize.
@@ -26,13 +26,42 @@
 
 static lbm_value env_global[GLOBAL_ENV_ROOTS];
 
+/* Direct mapped cache over the global environment.
+
+   Each slot remembers a symbol and the (key . val) binding cell it
+   resolved to, so a steady-state global reference is a single compare
+   and a cell dereference instead of a walk down the association list.
+   Values are updated in place by set and define of an existing
+   binding, so a cached cell always holds the current value. The only
+   operation that detaches a binding cell is undefine, which drops the
+   cached slot via lbm_global_env_cache_drop. */
+
+typedef struct {
+  lbm_value sym;
+  lbm_value binding;
+} global_env_cache_entry_t;
+
+static global_env_cache_entry_t env_global_cache[GLOBAL_ENV_CACHE_SIZE];
+
 int lbm_init_env(void) {
   for (int i = 0; i < GLOBAL_ENV_ROOTS; i ++) {
     env_global[i] = ENC_SYM_NIL;
   }
+  for (int i = 0; i < GLOBAL_ENV_CACHE_SIZE; i ++) {
+    env_global_cache[i].sym = ENC_SYM_NIL;
+    env_global_cache[i].binding = ENC_SYM_NIL;
+  }
   return 1;
 }
 
+void lbm_global_env_cache_drop(lbm_value key) {
+  global_env_cache_entry_t *ce = &env_global_cache[lbm_dec_sym(key) & (GLOBAL_ENV_CACHE_SIZE - 1)];
+  if (ce->sym == key) {
+    ce->sym = ENC_SYM_NIL;
+    ce->binding = ENC_SYM_NIL;
+  }
+}
+
 lbm_uint lbm_get_global_env_size(void) {
   lbm_uint n = 0;
   for (int i = 0; i < GLOBAL_ENV_ROOTS; i ++) {
@@ -87,12 +116,19 @@ bool lbm_env_lookup_b(lbm_value *res, lbm_value sym, lbm_value env) {
 
 bool lbm_global_env_lookup(lbm_value *res, lbm_value sym) {
   lbm_uint dec_sym = lbm_dec_sym(sym);
+  global_env_cache_entry_t *ce = &env_global_cache[dec_sym & (GLOBAL_ENV_CACHE_SIZE - 1)];
+  if (ce->sym == sym) {
+    *res = lbm_ref_cell(ce->binding)->cdr;
+    return true;
+  }
   lbm_uint ix = dec_sym & GLOBAL_ENV_MASK;
   lbm_value curr = env_global[ix];
 
   while (lbm_is_ptr(curr)) {
     lbm_value c = lbm_ref_cell(curr)->car;
     if ((lbm_ref_cell(c)->car) == sym) {
+      ce->sym = sym;
+      ce->binding = c;
       *res = lbm_ref_cell(c)->cdr;
       return true;
     }
@@ -30,6 +30,7 @@
 #include "print.h"
 #include "platform_mutex.h"
 #include "lbm_flat_value.h"
+#include "lbm_defrag_mem.h"
 #include "lbm_flags.h"
 
 #ifdef VISUALIZE_HEAP
@@ -268,21 +269,51 @@ void lbm_request_gc(void) {
 #define EVAL_CPS_MIN_SLEEP 200
 #define EVAL_STEPS_QUOTA   10
 
+/* Context stacks are allocated small and grown on demand up to the
+   requested stack_size, so contexts that never recurse deeply only
+   hold a fraction of their worst-case stack. Growth happens between
+   evaluation steps and between dispatched continuations, points where
+   no C pointers into the stack data are live, so the storage can move
+   safely. EVAL_STACK_HEADROOM must cover the largest number of words a
+   single step or continuation can push. */
+#define EVAL_CPS_INITIAL_STACK_SIZE 128
+#define EVAL_STACK_HEADROOM 32
+
+#ifdef LBM_USE_DIRECT_DISPATCH
+// Longest chain of continuations dispatched without returning to the
+// scheduler loop in between.
+#define LBM_DIRECT_DISPATCH_CHAIN_MAX 8
+#endif
+
+// Total evaluator steps since start. Counted in both quota variants;
+// only the step quota uses steps for scheduling.
+static volatile lbm_uint eval_steps_cnt = 0;
+
 #ifdef LBM_USE_TIME_QUOTA
 static volatile uint32_t eval_time_refill = EVAL_TIME_QUOTA;
 static uint32_t eval_time_quota = EVAL_TIME_QUOTA;
-static uint32_t eval_current_quota = 0;
+static volatile uint32_t eval_current_quota = 0;
 void lbm_set_eval_time_quota(uint32_t quota) {
   eval_time_refill = quota;
 }
 #else
 static volatile uint32_t eval_steps_refill = EVAL_STEPS_QUOTA;
-static uint32_t eval_steps_quota = EVAL_STEPS_QUOTA;
+static volatile uint32_t eval_steps_quota = EVAL_STEPS_QUOTA;
 void lbm_set_eval_step_quota(uint32_t quota) {
   eval_steps_refill = quota;
 }
 #endif
 
+/* When enabled, posting an event expires the remaining quota of the
+   running context so the scheduler reaches process_events at the next
+   step boundary. Best effort: the write races with the evaluator
+   thread, and losing the race just means the event waits out the
+   current quota round as before. */
+static volatile bool event_preempt = false;
+void lbm_set_event_preempt(bool enable) {
+  event_preempt = enable;
+}
+
 static uint32_t          eval_cps_run_state = EVAL_CPS_STATE_DEAD;
 static volatile uint32_t eval_cps_next_state = EVAL_CPS_STATE_NONE;
 static volatile uint32_t eval_cps_next_state_arg = 0;
@@ -410,6 +441,13 @@ static bool event_internal(lbm_event_type_t event_type, lbm_uint parameter, lbm_
       lbm_events_head = (lbm_events_head + 1) % lbm_events_max;
       lbm_events_full = lbm_events_head == lbm_events_tail;
       r = true;
+      if (event_preempt) {
+#ifdef LBM_USE_TIME_QUOTA
+        eval_current_quota = timestamp_us_callback();
+#else
+        eval_steps_quota = 0;
+#endif
+      }
     }
     mutex_unlock(&lbm_events_mutex);
   }
@@ -668,6 +706,11 @@ static lbm_value allocate_binding(lbm_value key, lbm_value val, lbm_value the_cd
     lbm_gc_mark_phase(val);
     lbm_gc_mark_phase(the_cdr);
     gc();
+#ifdef LBM_USE_INCREMENTAL_GC
+    // This path takes cells off the freelist directly, so any still
+    // unswept garbage must be drained before giving up.
+    if (lbm_heap_num_free() < 2) lbm_gc_sweep_finish();
+#endif
     if (lbm_heap_num_free() < 2) {
       ERROR_CTX(ENC_SYM_MERROR);
     }
@@ -740,6 +783,17 @@ static void atomic_error(void) {
   ERROR_CTX(ENC_SYM_EERROR);
 }
 
+/* Earliest-deadline gate for the wake-up scan. Each scan records when
+   the soonest sleeper expires; until that point is reached the scan is
+   skipped entirely, so scheduler passes are O(1) no matter how many
+   contexts are sleeping. Enqueueing a sleeper invalidates the cache.
+   Externally unblocked contexts can only make the cached deadline too
+   early, which costs one redundant scan and nothing else. */
+#define WAKE_DEADLINE_NONE ((lbm_uint)~0)
+static bool wake_deadline_valid = false;
+static lbm_uint wake_deadline_ts = 0;
+static lbm_uint wake_deadline_us = 0;
+
 // block_current_ctx blocks a context until it is
 // woken up externally or a timeout period of time passes.
 // Blocking while in an atomic block would have bad consequences.
@@ -749,6 +803,7 @@ static void block_current_ctx(uint32_t state, lbm_uint sleep_us,  bool do_cont)
   ctx_running->sleep_us = sleep_us;
   ctx_running->state  = state;
   ctx_running->app_cont = do_cont;
+  wake_deadline_valid = false;
   enqueue_ctx(&blocked, ctx_running);
   ctx_running = NULL;
 }
@@ -759,6 +814,7 @@ static void reblock_current_ctx(uint32_t state, bool do_cont) {
   if (is_atomic) atomic_error();
   ctx_running->state  = state;
   ctx_running->app_cont = do_cont;
+  wake_deadline_valid = false;
   enqueue_ctx(&blocked, ctx_running);
   ctx_running = NULL;
 }
@@ -1131,6 +1187,9 @@ static noreturn void error_ctx_base(lbm_value err_val, bool has_at, lbm_value at
   if (ctx_running->flags & EVAL_CPS_CONTEXT_FLAG_TRAP) {
     if (lbm_heap_num_free() < 3) {
       gc();
+#ifdef LBM_USE_INCREMENTAL_GC
+      if (lbm_heap_num_free() < 3) lbm_gc_sweep_finish();
+#endif
     }
 
     if (lbm_heap_num_free() >= 3) {
@@ -1225,6 +1284,18 @@ static eval_context_t *dequeue_ctx_nm(eval_context_queue_t *q) {
   return res;
 }
 
+static lbm_uint time_since(lbm_uint t_now, lbm_uint t_then) {
+  if (t_then > t_now) {
+    /* There was an overflow on the counter */
+#ifndef LBM64
+    return (0xFFFFFFFF - t_then) + t_now;
+#else
+    return (0xFFFFFFFFFFFFFFFF - t_then) + t_now;
+#endif
+  }
+  return t_now - t_then;
+}
+
 static void wake_up_ctxs_nm(void) {
   lbm_uint t_now;
 
@@ -1234,23 +1305,20 @@ static void wake_up_ctxs_nm(void) {
     t_now = 0;
   }
 
+  if (wake_deadline_valid &&
+      time_since(t_now, wake_deadline_ts) < wake_deadline_us) {
+    return;
+  }
+
+  lbm_uint next_us = WAKE_DEADLINE_NONE;
+
   eval_context_queue_t *q = &blocked;
   eval_context_t *curr = q->first;
 
   while (curr != NULL) {
-    lbm_uint t_diff;
     eval_context_t *next = curr->next;
     if (LBM_IS_STATE_WAKE_UP_WAKABLE(curr->state)) {
-      if ( curr->timestamp > t_now) {
-        /* There was an overflow on the counter */
-#ifndef LBM64
-        t_diff = (0xFFFFFFFF - curr->timestamp) + t_now;
-#else
-        t_diff = (0xFFFFFFFFFFFFFFFF - curr->timestamp) + t_now;
-#endif
-      } else {
-        t_diff = t_now - curr->timestamp;
-      }
+      lbm_uint t_diff = time_since(t_now, curr->timestamp);
 
       if (t_diff >= curr->sleep_us) {
         eval_context_t *wake_ctx = curr;
@@ -1279,10 +1347,19 @@ static void wake_up_ctxs_nm(void) {
         }
         wake_ctx->state = LBM_THREAD_STATE_READY;
         enqueue_ctx_nm(&queue, wake_ctx);
+      } else {
+        lbm_uint remaining = curr->sleep_us - t_diff;
+        if (remaining < next_us) {
+          next_us = remaining;
+        }
       }
     }
     curr = next;
   }
+
+  wake_deadline_ts = t_now;
+  wake_deadline_us = next_us;
+  wake_deadline_valid = true;
 }
 
 static void yield_ctx(lbm_uint sleep_us) {
@@ -1298,6 +1375,7 @@ static void yield_ctx(lbm_uint sleep_us) {
   }
   ctx_running->r = ENC_SYM_TRUE;
   ctx_running->app_cont = true;
+  wake_deadline_valid = false;
   enqueue_ctx(&blocked,ctx_running);
   ctx_running = NULL;
 }
@@ -1329,11 +1407,11 @@ static lbm_cid lbm_create_ctx_parent(lbm_value program, lbm_value env, lbm_uint
     gc();
   }
 #endif
-  if (!lbm_stack_allocate(&ctx->K, stack_size)) {
+  if (!lbm_stack_allocate_growable(&ctx->K, EVAL_CPS_INITIAL_STACK_SIZE, stack_size)) {
     lbm_uint roots[2] = {program, env};
     lbm_gc_mark_roots(roots, 2);
     gc();
-    if (!lbm_stack_allocate(&ctx->K, stack_size)) {
+    if (!lbm_stack_allocate_growable(&ctx->K, EVAL_CPS_INITIAL_STACK_SIZE, stack_size)) {
       lbm_memory_free((lbm_uint*)ctx);
       return -1;
     }
@@ -1403,6 +1481,7 @@ static lbm_cid lbm_create_ctx_parent(lbm_value program, lbm_value env, lbm_uint
   ctx->timestamp = 0;
   ctx->sleep_us = 0;
   ctx->state = LBM_THREAD_STATE_READY;
+  ctx->quota_weight = 1;
   ctx->prev = NULL;
   ctx->next = NULL;
 
@@ -1599,6 +1678,31 @@ static uint32_t lbm_mailbox_free_space_for_cid(lbm_cid cid) {
   return res;
 }
 
+bool lbm_set_ctx_quota_weight(lbm_cid cid, uint32_t weight) {
+  eval_context_t *found = NULL;
+
+  if (weight < 1) weight = 1;
+  if (weight > LBM_QUOTA_WEIGHT_MAX) weight = LBM_QUOTA_WEIGHT_MAX;
+
+  mutex_lock(&qmutex);
+
+  found = lookup_ctx_nm(&blocked, cid);
+  if (!found) {
+    found = lookup_ctx_nm(&queue, cid);
+  }
+  if (!found && ctx_running && ctx_running->id == cid) {
+    found = ctx_running;
+  }
+
+  if (found) {
+    found->quota_weight = weight;
+  }
+
+  mutex_unlock(&qmutex);
+
+  return found != NULL;
+}
+
 /** find_receiver_and_send is used for message passing where
  * the semantics is that the oldest message is dropped if the
  * receiver mailbox is full.
@@ -1746,8 +1850,16 @@ static int gc(void) {
   gc_requested = false;
   lbm_gc_state_inc();
 
+  uint32_t gc_t_start = timestamp_us_callback();
+
+#ifdef LBM_USE_INCREMENTAL_GC
+  // The freelist is kept over the collection; marking it makes the
+  // sweep scan leave the free cells in place.
+  lbm_gc_mark_freelist();
+#else
   // The freelist should generally be NIL when GC runs.
   lbm_nil_freelist();
+#endif
   lbm_value *env = lbm_get_global_env();
   for (int i = 0; i < GLOBAL_ENV_ROOTS; i ++) {
     lbm_gc_mark_env(env[i]);
@@ -1771,6 +1883,7 @@ static int gc(void) {
   int r = lbm_gc_sweep_phase();
   lbm_heap_new_freelist_length();
   lbm_memory_update_min_free();
+  lbm_heap_new_gc_time(timestamp_us_callback() - gc_t_start);
 
   if (ctx_running) {
     ctx_running->state = ctx_running->state & ~LBM_THREAD_STATE_GC_BIT;
@@ -1972,6 +2085,10 @@ static inline lbm_value allocate_closure(lbm_value params, lbm_value body, lbm_v
 #else
   if (lbm_heap_num_free() < 4) {
     gc();
+#ifdef LBM_USE_INCREMENTAL_GC
+    // Direct freelist pops below, see allocate_binding.
+    if (lbm_heap_num_free() < 4) lbm_gc_sweep_finish();
+#endif
     if (lbm_heap_num_free() < 4) {
       ERROR_CTX(ENC_SYM_MERROR);
     }
@@ -4668,6 +4785,69 @@ static void cont_read_append_continue(eval_context_t *ctx) {
   ctx->app_cont = true;
 }
 
+/* Optional load-time constant folding. When enabled, each top-level
+   expression coming out of the reader is rewritten in place before it
+   is evaluated: applications of pure arithmetic and comparison
+   fundamentals where all arguments are number literals are replaced by
+   their result, so steady-state execution does not recompute what the
+   source text already determines. Quoted data is already built by the
+   reader and is left alone, as are match and receive forms whose
+   patterns are code-shaped data. An application that would error when
+   folded (type error, division by zero, out of memory) is left
+   untouched so the error still occurs at runtime. */
+#define FOLD_MAX_DEPTH 16
+#define FOLD_MAX_ARGS  8
+
+static bool const_fold_enabled = false;
+
+void lbm_set_const_fold(bool enable) {
+  const_fold_enabled = enable;
+}
+
+static bool foldable_fundamental(lbm_value h) {
+  switch (h) {
+  case ENC_SYM_ADD: case ENC_SYM_SUB: case ENC_SYM_MUL:
+  case ENC_SYM_DIV: case ENC_SYM_MOD:
+  case ENC_SYM_NUMEQ: case ENC_SYM_LT: case ENC_SYM_GT:
+  case ENC_SYM_LEQ: case ENC_SYM_GEQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static lbm_value fold_constants(lbm_value e, unsigned int depth, eval_context_t *ctx) {
+  if (depth >= FOLD_MAX_DEPTH || !lbm_is_cons(e)) return e;
+  lbm_value h = lbm_ref_cell(e)->car;
+  if (h == ENC_SYM_QUOTE || h == ENC_SYM_MATCH ||
+      h == ENC_SYM_RECEIVE || h == ENC_SYM_RECEIVE_TIMEOUT) {
+    return e;
+  }
+  lbm_value args[FOLD_MAX_ARGS];
+  lbm_uint n = 0;
+  bool args_const = true;
+  lbm_value curr = e;
+  while (lbm_is_cons(curr)) {
+    lbm_cons_t *cell = lbm_ref_cell(curr);
+    cell->car = fold_constants(cell->car, depth + 1, ctx);
+    if (curr != e) { // everything but the head is an argument
+      if (n < FOLD_MAX_ARGS) args[n] = cell->car;
+      if (!lbm_is_number(cell->car)) args_const = false;
+      n ++;
+    }
+    curr = cell->cdr;
+  }
+  if (curr == ENC_SYM_NIL && args_const &&
+      n >= 1 && n <= FOLD_MAX_ARGS &&
+      lbm_is_symbol(h) && foldable_fundamental(h)) {
+    lbm_value res = fundamental_table[SYMBOL_IX(lbm_dec_sym(h))](args, n, ctx);
+    if (!lbm_is_error(res)) {
+      return res;
+    }
+  }
+  return e;
+}
+
 static void cont_read_eval_continue(eval_context_t *ctx) {
   lbm_value env;
   lbm_value stream;
@@ -4699,7 +4879,7 @@ static void cont_read_eval_continue(eval_context_t *ctx) {
     rptr[5] = POP_READER_FLAGS;
 
     ctx->curr_env = env;
-    ctx->curr_exp = ctx->r;
+    ctx->curr_exp = const_fold_enabled ? fold_constants(ctx->r, 0, ctx) : ctx->r;
   } else {
     ERROR_CTX(ENC_SYM_FATAL_ERROR);
   }
@@ -5523,13 +5703,59 @@ static const evaluator_fun evaluators[] =
 /*********************************************************/
 /* Evaluator step function                               */
 
+// Grow the context stack ahead of time when it is close to full.
+// Failure to grow is not an error here; the context keeps its current
+// stack and errors out only on an actual overflow, as before.
+static inline void stack_grow_check(eval_context_t *ctx) {
+  if (ctx->K.size < ctx->K.max_size &&
+      ctx->K.size - ctx->K.sp < EVAL_STACK_HEADROOM) {
+    lbm_stack_grow(&ctx->K);
+  }
+}
+
 static void evaluation_step(void){
   eval_context_t *ctx = ctx_running;
 #ifdef VISUALIZE_HEAP
   heap_vis_gen_image();
 #endif
+  stack_grow_check(ctx);
+
+#ifdef LBM_USE_DIRECT_DISPATCH
+  /* Direct-threaded continuation dispatch. Chains of continuation
+     applications are dispatched here without returning through the
+     scheduler loop between each one, which removes the per-step call
+     and quota-check overhead for continuation-heavy code. The chain
+     ends as soon as the context blocks, finishes or errors. With a
+     step quota each dispatched continuation still consumes quota;
+     with a time quota the chain length is bounded instead so the
+     timestamp is re-checked regularly. Scheduling behavior is
+     otherwise unchanged. */
+  uint32_t chain_left = LBM_DIRECT_DISPATCH_CHAIN_MAX;
+  while (ctx->app_cont) {
+    eval_steps_cnt ++;
+    stack_grow_check(ctx);
+    lbm_value k;
+    lbm_pop(&ctx->K, &k);
+    ctx->app_cont = false;
 
+    lbm_uint decoded_k = DEC_CONTINUATION(k);
+    // If app_cont is true, then top of stack must be a valid continuation!
+    if (decoded_k < NUM_CONTINUATIONS) {
+      continuations[decoded_k](ctx);
+    } else {
+      ERROR_CTX(ENC_SYM_FATAL_ERROR);
+    }
+    if (ctx != ctx_running) return;
+#ifdef LBM_USE_TIME_QUOTA
+    if (--chain_left == 0) return;
+#else
+    if (--chain_left == 0 || !eval_steps_quota) return;
+    eval_steps_quota--;
+#endif
+  }
+#else
   if (ctx->app_cont) {
+    eval_steps_cnt ++;
     lbm_value k;
     lbm_pop(&ctx->K, &k);
     ctx->app_cont = false;
@@ -5543,7 +5769,9 @@ static void evaluation_step(void){
     }
     return;
   }
+#endif
 
+  eval_steps_cnt ++;
   if (lbm_is_symbol(ctx->curr_exp)) {
     eval_symbol(ctx);
     return;
@@ -5727,6 +5955,10 @@ uint32_t lbm_get_eval_state(void) {
   return eval_cps_run_state;
 }
 
+lbm_uint lbm_get_eval_steps(void) {
+  return eval_steps_cnt;
+}
+
 // Only unblocks threads that are unblockable.
 // A sleeping thread is not unblockable.
 static void handle_event_unblock_ctx(lbm_cid cid, lbm_value v) {
@@ -5771,7 +6003,9 @@ static lbm_value get_event_value(lbm_event_t *e) {
       v = ENC_SYM_EERROR;
     }
     // Free the flat value buffer. GC is unaware of its existence.
-    lbm_free(fv.buf);
+    // Buffers flattened into external storage are routed back to
+    // their owner by lbm_free_flat_buffer.
+    lbm_free_flat_buffer(fv.buf);
   } else {
     v = (lbm_value)e->buf_ptr;
   }
@@ -5901,6 +6135,10 @@ void lbm_run_eval(void){
           if (gc_requested) {
             gc();
           }
+#ifdef LBM_USE_INCREMENTAL_GC
+          lbm_gc_sweep_continue();
+#endif
+          lbm_defrag_mem_compact_continue();
           process_events();
           mutex_lock(&qmutex);
           if (ctx_running) {
@@ -5910,6 +6148,10 @@ void lbm_run_eval(void){
           wake_up_ctxs_nm();
           ctx_running = dequeue_ctx_nm(&queue);
           mutex_unlock(&qmutex);
+          if (ctx_running && ctx_running->quota_weight > 1) {
+            eval_current_quota = timestamp_us_callback() +
+              eval_time_refill * ctx_running->quota_weight;
+          }
           if (!ctx_running) {
             lbm_system_sleeping = true;
             //Fixed sleep interval to poll events regularly.
@@ -5929,6 +6171,10 @@ void lbm_run_eval(void){
           if (gc_requested) {
             gc();
           }
+#ifdef LBM_USE_INCREMENTAL_GC
+          lbm_gc_sweep_continue();
+#endif
+          lbm_defrag_mem_compact_continue();
           process_events();
           mutex_lock(&qmutex);
           if (ctx_running) {
@@ -5938,6 +6184,9 @@ void lbm_run_eval(void){
           wake_up_ctxs_nm();
           ctx_running = dequeue_ctx_nm(&queue);
           mutex_unlock(&qmutex);
+          if (ctx_running && ctx_running->quota_weight > 1) {
+            eval_steps_quota = eval_steps_refill * ctx_running->quota_weight;
+          }
           if (!ctx_running) {
             lbm_system_sleeping = true;
             //Fixed sleep interval to poll events regularly.
@@ -31,8 +31,66 @@ static lbm_uint next_extension_ix = 0;
 
 lbm_extension_t *extension_table = NULL;
 
+/* Open-addressing hash index over extension names. Name lookups
+   (registration, symbol resolution) otherwise scan the whole table,
+   which makes loading hundreds of extensions quadratic. Slots hold
+   extension index + 2; 0 is empty and 1 a tombstone left by
+   lbm_clr_extension. The index is sized once, below 75% load for a
+   full table, so it never grows. It is built lazily on first use,
+   which also covers tables restored from an image. If the allocation
+   fails, lookups fall back to scanning. */
+
+#define EXT_INDEX_EMPTY 0
+#define EXT_INDEX_TOMB  1
+
+static lbm_uint *ext_index = NULL;
+static lbm_uint ext_index_size = 0;
+
+static lbm_uint ext_index_hash(const char *str) {
+  lbm_uint h = 5381;
+  unsigned char c;
+  while ((c = (unsigned char)*str++) != 0) {
+    h = ((h << 5) + h) + c;
+  }
+  return h;
+}
+
+static void ext_index_insert(char *name, lbm_uint ix) {
+  lbm_uint mask = ext_index_size - 1;
+  lbm_uint i = ext_index_hash(name) & mask;
+  while (ext_index[i] != EXT_INDEX_EMPTY && ext_index[i] != EXT_INDEX_TOMB) {
+    i = (i + 1) & mask;
+  }
+  ext_index[i] = ix + 2;
+}
+
+static bool ext_index_ensure(void) {
+  if (ext_index) return true;
+  if (ext_max == 0) return false;
+  lbm_uint size = 64;
+  while (ext_max * 4 >= size * 3) size <<= 1;
+  lbm_uint *tab = (lbm_uint*)lbm_memory_allocate(size);
+  if (!tab) return false;
+  memset(tab, 0, size * sizeof(lbm_uint));
+  ext_index = tab;
+  ext_index_size = size;
+  for (lbm_uint i = 0; i < ext_max; i ++) {
+    if (extension_table[i].name) {
+      ext_index_insert(extension_table[i].name, i);
+    }
+  }
+  return true;
+}
+
 void lbm_extensions_set_next(lbm_uint i) {
   next_extension_ix = i;
+  // The table contents changed under the index, e.g. on image
+  // reboot; rebuild it on next use.
+  if (ext_index) {
+    lbm_memory_free(ext_index);
+    ext_index = NULL;
+    ext_index_size = 0;
+  }
 }
 
 lbm_value lbm_extensions_default(lbm_value *args, lbm_uint argn) {
@@ -53,6 +111,9 @@ int lbm_extensions_init(lbm_extension_t *extension_storage, lbm_uint extension_s
 
   next_extension_ix = 0;
   ext_max = (lbm_uint)extension_storage_size;
+  // lbm_memory was reinitialized alongside, so any old index is gone.
+  ext_index = NULL;
+  ext_index_size = 0;
 
   return 1;
 }
@@ -78,12 +139,38 @@ bool lbm_clr_extension(lbm_uint sym_id) {
   if (ext_id >= ext_max) {
     return false;
   }
+  if (ext_index && extension_table[ext_id].name) {
+    lbm_uint mask = ext_index_size - 1;
+    lbm_uint i = ext_index_hash(extension_table[ext_id].name) & mask;
+    while (ext_index[i] != EXT_INDEX_EMPTY) {
+      if (ext_index[i] == ext_id + 2) {
+        ext_index[i] = EXT_INDEX_TOMB;
+        break;
+      }
+      i = (i + 1) & mask;
+    }
+  }
   extension_table[ext_id].name = NULL;
   extension_table[ext_id].fptr = lbm_extensions_default;
   return true;
 }
 
 bool lbm_lookup_extension_id(char *sym_str, lbm_uint *ix) {
+  if (ext_index_ensure()) {
+    lbm_uint mask = ext_index_size - 1;
+    lbm_uint i = ext_index_hash(sym_str) & mask;
+    while (ext_index[i] != EXT_INDEX_EMPTY) {
+      if (ext_index[i] != EXT_INDEX_TOMB) {
+        lbm_uint e = ext_index[i] - 2;
+        if (extension_table[e].name && str_eq(extension_table[e].name, sym_str)) {
+          *ix = e + EXTENSION_SYMBOLS_START;
+          return true;
+        }
+      }
+      i = (i + 1) & mask;
+    }
+    return false;
+  }
   for (lbm_uint i = 0; i < ext_max; i ++) {
     if(extension_table[i].name) {
       if (str_eq(extension_table[i].name, sym_str)) {
@@ -117,6 +204,9 @@ bool lbm_add_extension(char *sym_str, extension_fptr ext) {
     lbm_uint sym_ix = next_extension_ix ++;
     extension_table[sym_ix].name = sym_str;
     extension_table[sym_ix].fptr = ext;
+    if (ext_index_ensure()) {
+      ext_index_insert(sym_str, sym_ix);
+    }
     return true;
   }
   return false;
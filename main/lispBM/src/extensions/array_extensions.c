@@ -57,7 +57,10 @@ static lbm_value array_extension_buffer_length(lbm_value *args, lbm_uint argn);
 
 static lbm_value array_extensions_bufclear(lbm_value *args, lbm_uint argn);
 static lbm_value array_extensions_bufcpy(lbm_value *args, lbm_uint argn);
+static lbm_value array_extensions_bufcmp(lbm_value *args, lbm_uint argn);
 static lbm_value array_extensions_bufset_bit(lbm_value *args, lbm_uint argn);
+static lbm_value array_extensions_bufpack(lbm_value *args, lbm_uint argn);
+static lbm_value array_extensions_bufunpack(lbm_value *args, lbm_uint argn);
 
 void lbm_array_extensions_init(void) {
 
@@ -86,7 +89,10 @@ void lbm_array_extensions_init(void) {
   lbm_add_extension("buflen",  array_extension_buffer_length);
   lbm_add_extension("bufclear", array_extensions_bufclear);
   lbm_add_extension("bufcpy", array_extensions_bufcpy);
+  lbm_add_extension("bufcmp", array_extensions_bufcmp);
   lbm_add_extension("bufset-bit", array_extensions_bufset_bit);
+  lbm_add_extension("bufpack", array_extensions_bufpack);
+  lbm_add_extension("bufunpack", array_extensions_bufunpack);
 }
 
 lbm_value array_extension_unsafe_free_array(lbm_value *args, lbm_uint argn) {
@@ -664,6 +670,42 @@ static lbm_value array_extensions_bufcpy(lbm_value *args, lbm_uint argn) {
   return res;
 }
 
+/* (bufcmp arr1 start1 arr2 start2 len)
+   Compares len bytes, clamped to what both arrays hold past their
+   start offsets. Returns a negative, zero or positive number with the
+   same meaning as memcmp. */
+static lbm_value array_extensions_bufcmp(lbm_value *args, lbm_uint argn) {
+  lbm_value res = ENC_SYM_EERROR;
+
+  if (argn == 5) {
+    res = ENC_SYM_TERROR;
+    if (lbm_is_array_r(args[0]) && lbm_is_number(args[1]) &&
+        lbm_is_array_r(args[2]) && lbm_is_number(args[3]) && lbm_is_number(args[4])) {
+      lbm_array_header_t *array1 = (lbm_array_header_t *)lbm_car(args[0]);
+
+      uint32_t start1 = lbm_dec_as_u32(args[1]);
+
+      lbm_array_header_t *array2 = (lbm_array_header_t *)lbm_car(args[2]);
+
+      uint32_t start2 = lbm_dec_as_u32(args[3]);
+      uint32_t len = lbm_dec_as_u32(args[4]);
+
+      if (start1 < array1->size && start2 < array2->size) {
+        if (len > (array1->size - start1)) {
+          len = ((uint32_t)array1->size - start1);
+        }
+        if (len > (array2->size - start2)) {
+          len = ((uint32_t)array2->size - start2);
+        }
+
+        int cmp = memcmp((char*)array1->data + start1, (char*)array2->data + start2, len);
+        res = lbm_enc_i(cmp);
+      }
+    }
+  }
+  return res;
+}
+
 static lbm_value array_extensions_bufset_bit(lbm_value *args, lbm_uint argn) {
   lbm_value res = ENC_SYM_EERROR;
 
@@ -689,3 +731,129 @@ static lbm_value array_extensions_bufset_bit(lbm_value *args, lbm_uint argn) {
   }
   return res;
 }
+
+/* Multi-field pack and unpack driven by a format string, so that a
+   whole CAN frame or display header is moved in one extension call
+   instead of one bufset/bufget per field.
+
+   Format characters follow the bufset/bufget type names:
+     b i8, B u8, h i16, H u16, T u24, i i32, I u32, f f32
+   '>' switches to big-endian (the default, as for bufset/bufget) and
+   '<' to little-endian, taking effect for the fields that follow. */
+
+static bool pack_format_field(char c, lbm_uint *nbytes, bool *is_signed, bool *is_float) {
+  *is_signed = false;
+  *is_float = false;
+  switch (c) {
+  case 'b': *is_signed = true; /* fall through */
+  case 'B': *nbytes = 1; break;
+  case 'h': *is_signed = true; /* fall through */
+  case 'H': *nbytes = 2; break;
+  case 'T': *nbytes = 3; break;
+  case 'i': *is_signed = true; /* fall through */
+  case 'I': *nbytes = 4; break;
+  case 'f': *is_float = true; *nbytes = 4; break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+/* (bufpack arr index fmt v1 ... vn)
+   Returns the index following the last written field on success, so
+   consecutive packs can be chained. */
+static lbm_value array_extensions_bufpack(lbm_value *args, lbm_uint argn) {
+  lbm_value res = ENC_SYM_EERROR;
+  char *fmt;
+  if (argn >= 3 &&
+      lbm_is_array_rw(args[0]) &&
+      lbm_is_number(args[1]) &&
+      (fmt = lbm_dec_str(args[2]))) {
+    res = ENC_SYM_TERROR;
+    lbm_array_header_t *array = (lbm_array_header_t *)lbm_car(args[0]);
+    uint8_t *data = (uint8_t*)array->data;
+    lbm_uint index = lbm_dec_as_u32(args[1]);
+    lbm_uint arg = 3;
+    bool be = true;
+
+    for (lbm_uint i = 0; fmt[i] != 0; i ++) {
+      if (fmt[i] == '<') { be = false; continue; }
+      if (fmt[i] == '>') { be = true; continue; }
+      lbm_uint nbytes;
+      bool is_signed, is_float;
+      if (!pack_format_field(fmt[i], &nbytes, &is_signed, &is_float) ||
+          arg >= argn || !lbm_is_number(args[arg])) {
+        return res;
+      }
+      lbm_uint value;
+      if (is_float) {
+        value = (lbm_uint)float_to_u(lbm_dec_as_float(args[arg]));
+      } else if (is_signed) {
+        value = (lbm_uint)lbm_dec_as_i32(args[arg]);
+      } else {
+        value = lbm_dec_as_u32(args[arg]);
+      }
+      if (!buffer_append_bytes(data, array->size, be, index, nbytes, value)) {
+        return res;
+      }
+      index += nbytes;
+      arg ++;
+    }
+    res = lbm_enc_i((lbm_int)index);
+  }
+  return res;
+}
+
+/* (bufunpack arr index fmt)
+   Returns the list of decoded fields. */
+static lbm_value array_extensions_bufunpack(lbm_value *args, lbm_uint argn) {
+  lbm_value res = ENC_SYM_EERROR;
+  char *fmt;
+  if (argn == 3 &&
+      lbm_is_array_r(args[0]) &&
+      lbm_is_number(args[1]) &&
+      (fmt = lbm_dec_str(args[2]))) {
+    res = ENC_SYM_TERROR;
+    lbm_array_header_t *array = (lbm_array_header_t *)lbm_car(args[0]);
+    uint8_t *data = (uint8_t*)array->data;
+    lbm_uint index = lbm_dec_as_u32(args[1]);
+    bool be = true;
+    lbm_value result = ENC_SYM_NIL;
+
+    for (lbm_uint i = 0; fmt[i] != 0; i ++) {
+      if (fmt[i] == '<') { be = false; continue; }
+      if (fmt[i] == '>') { be = true; continue; }
+      lbm_uint nbytes;
+      bool is_signed, is_float;
+      lbm_uint value;
+      if (!pack_format_field(fmt[i], &nbytes, &is_signed, &is_float) ||
+          !buffer_get_uint(&value, data, array->size, be, index, nbytes)) {
+        return res;
+      }
+      lbm_value field;
+      if (is_float) {
+        field = lbm_enc_float(u_to_float((uint32_t)value));
+      } else if (is_signed) {
+        switch (nbytes) {
+        case 1: field = lbm_enc_i((int8_t)value); break;
+        case 2: field = lbm_enc_i((int16_t)value); break;
+        default: field = lbm_enc_i((int32_t)value); break;
+        }
+      } else if (nbytes == 4) {
+        field = lbm_enc_u32((uint32_t)value);
+      } else {
+        field = lbm_enc_i((lbm_int)value);
+      }
+      if (lbm_is_symbol_merror(field)) {
+        return field;
+      }
+      result = lbm_cons(field, result);
+      if (lbm_is_symbol_merror(result)) {
+        return result;
+      }
+      index += nbytes;
+    }
+    res = lbm_list_destructive_reverse(result);
+  }
+  return res;
+}
@@ -187,10 +187,14 @@ uint32_t image_dims_to_size_bytes(color_format_t fmt, uint16_t width, uint16_t h
   }
 }
 
+static void dirty_forget(uint8_t *mem_base);
+
 static lbm_value image_buffer_lift(uint8_t *buf, color_format_t fmt, uint16_t width, uint16_t height) {
   lbm_value res = ENC_SYM_MERROR;
   lbm_uint size = image_dims_to_size_bytes(fmt, width, height);
   if ( lbm_lift_array(&res, (char*)buf, IMAGE_BUFFER_HEADER_SIZE + size)) {
+    // The address may be reused from a previously tracked buffer.
+    dirty_forget(buf);
     buf[0] = (uint8_t)(width >> 8);
     buf[1] = (uint8_t)width;
     buf[2] = (uint8_t)(height >> 8);
@@ -290,6 +294,7 @@ static lbm_value image_buffer_allocate_dm(lbm_uint *dm, color_format_t fmt, uint
   lbm_array_header_t *arr = lbm_dec_array_r(res);
   if (arr) {
     uint8_t *buf = (uint8_t*)arr->data;
+    dirty_forget(buf);
     buf[0] = (uint8_t)(width >> 8);
     buf[1] = (uint8_t)width;
     buf[2] = (uint8_t)(height >> 8);
@@ -487,12 +492,19 @@ static uint32_t  rgb565to888(uint16_t rgb) {
   return res_rgb888;
 }
 
+static inline void dirty_mark(image_buffer_t *img, uint16_t x, uint16_t y);
+
 void image_buffer_clear(image_buffer_t *img, uint32_t cc) {
   color_format_t fmt = img->fmt;
   uint32_t w = img->width;
   uint32_t h = img->height;
   uint32_t img_size = w * h;
   uint8_t *data = img->data;
+  if (w > 0 && h > 0) {
+    // The whole buffer changes, so union both corners.
+    dirty_mark(img, 0, 0);
+    dirty_mark(img, (uint16_t)(w - 1), (uint16_t)(h - 1));
+  }
   switch (fmt) {
   case indexed2: {
     uint32_t bytes = (img_size / 8) + (img_size % 8 ? 1 : 0);
@@ -541,6 +553,96 @@ void image_buffer_clear(image_buffer_t *img, uint32_t cc) {
   }
 }
 
+/* Dirty-rectangle tracking.
+
+   Image buffers that have been pushed to the display are tracked in a
+   small registry. putpixel is the funnel that every drawing primitive
+   (lines, shapes, text, blit and the ttf renderer) eventually goes
+   through, so marking there catches all modifications. As long as the
+   panel is known to match a buffer, disp-render only transmits the
+   bounding rectangle of the pixels modified since the previous render,
+   which cuts the SPI traffic dramatically for small periodic updates
+   such as dashboard gauges.
+
+   Tracking entries are created by disp-render and stop being trusted
+   whenever the panel can no longer be assumed to match the buffer
+   outside the dirty rectangle: a render at a different position,
+   disp-clear, disp-reset, a jpg render, or the buffer address being
+   reused for a new image buffer. Buffers in defrag memory are never
+   tracked since compaction can move them. */
+
+#define DISP_DIRTY_NUM 4
+
+typedef struct {
+  uint8_t *mem_base; // Image buffer address, NULL when the slot is unused.
+  uint16_t width;
+  uint16_t height;
+  uint8_t fmt;
+  uint16_t render_x;
+  uint16_t render_y;
+  bool synced; // Panel matches the buffer outside the dirty rectangle.
+  int16_t x0;  // Dirty bounds, x0 > x1 when the rectangle is empty.
+  int16_t y0;
+  int16_t x1;
+  int16_t y1;
+} disp_dirty_t;
+
+static disp_dirty_t dirty_bufs[DISP_DIRTY_NUM];
+static int dirty_evict_next = 0;
+
+// One entry lookaside so that drawing into an untracked buffer costs a
+// single compare per pixel.
+static uint8_t *dirty_cache_base = NULL;
+static disp_dirty_t *dirty_cache_entry = NULL;
+
+static disp_dirty_t *dirty_lookup(uint8_t *mem_base) {
+  for (int i = 0; i < DISP_DIRTY_NUM; i ++) {
+    if (dirty_bufs[i].mem_base == mem_base) {
+      return &dirty_bufs[i];
+    }
+  }
+  return NULL;
+}
+
+static void dirty_rect_reset(disp_dirty_t *d) {
+  d->x0 = INT16_MAX;
+  d->y0 = INT16_MAX;
+  d->x1 = INT16_MIN;
+  d->y1 = INT16_MIN;
+}
+
+static void dirty_forget(uint8_t *mem_base) {
+  disp_dirty_t *d = dirty_lookup(mem_base);
+  if (d) {
+    d->mem_base = NULL;
+  }
+  dirty_cache_base = NULL;
+  dirty_cache_entry = NULL;
+}
+
+// Called when the panel is changed behind the back of the tracked
+// buffers (disp-clear, disp-reset, jpg rendering). The next render of
+// each buffer transmits it in full again.
+static void dirty_unsync_all(void) {
+  for (int i = 0; i < DISP_DIRTY_NUM; i ++) {
+    dirty_bufs[i].synced = false;
+  }
+}
+
+static inline void dirty_mark(image_buffer_t *img, uint16_t x, uint16_t y) {
+  if (img->mem_base != dirty_cache_base) {
+    dirty_cache_base = img->mem_base;
+    dirty_cache_entry = dirty_lookup(img->mem_base);
+  }
+  disp_dirty_t *d = dirty_cache_entry;
+  if (d) {
+    if ((int16_t)x < d->x0) d->x0 = (int16_t)x;
+    if ((int16_t)x > d->x1) d->x1 = (int16_t)x;
+    if ((int16_t)y < d->y0) d->y0 = (int16_t)y;
+    if ((int16_t)y > d->y1) d->y1 = (int16_t)y;
+  }
+}
+
 static const uint8_t indexed4_mask[4] = {0x03, 0x0C, 0x30, 0xC0};
 static const uint8_t indexed4_shift[4] = {0, 2, 4, 6};
 static const uint8_t indexed16_mask[4] = {0x0F, 0xF0};
@@ -554,6 +656,7 @@ void putpixel(image_buffer_t* img, int x_i, int y_i, uint32_t c) {
   uint16_t y = (uint16_t)y_i;
 
   if (x < w && y < h) {
+    dirty_mark(img, x, y);
     color_format_t fmt = img->fmt;
     uint8_t *data = img->data;
     switch(fmt) {
@@ -971,6 +1074,66 @@ static void fill_triangle(image_buffer_t *img, int x0, int y0,
   }
 }
 
+/* Packed vertex arrays: 16 bit little endian signed x y pairs. */
+static int poly_pt_x(const uint8_t *pts, uint32_t ix) {
+  return (int16_t)((uint16_t)pts[ix * 4] | (uint16_t)pts[ix * 4 + 1] << 8);
+}
+
+static int poly_pt_y(const uint8_t *pts, uint32_t ix) {
+  return (int16_t)((uint16_t)pts[ix * 4 + 2] | (uint16_t)pts[ix * 4 + 3] << 8);
+}
+
+/* Even-odd scanline fill. For each scanline the crossing x coordinates
+   of all edges are collected into a table, sorted, and the spans
+   between pairs are filled with h_line. O(height * num_points) and one
+   extension call regardless of how many vertices the polygon has. */
+static void fill_polygon(image_buffer_t *img, const uint8_t *pts, uint32_t n, uint32_t color) {
+  int y_min = poly_pt_y(pts, 0);
+  int y_max = y_min;
+  for (uint32_t i = 1; i < n; i++) {
+    int y = poly_pt_y(pts, i);
+    if (y < y_min) y_min = y;
+    if (y > y_max) y_max = y;
+  }
+
+  if (y_min < 0) y_min = 0;
+  if (y_max > (int)img->height - 1) y_max = (int)img->height - 1;
+
+  int *xs = lbm_malloc(n * sizeof(int));
+  if (!xs) {
+    return;
+  }
+
+  for (int y = y_min; y <= y_max; y++) {
+    int num = 0;
+    for (uint32_t i = 0, j = n - 1; i < n; j = i++) {
+      int yi = poly_pt_y(pts, i);
+      int yj = poly_pt_y(pts, j);
+      if ((yi > y) == (yj > y)) continue; // edge does not cross this scanline
+      int xi = poly_pt_x(pts, i);
+      int xj = poly_pt_x(pts, j);
+      xs[num++] = xi + ((y - yi) * (xj - xi)) / (yj - yi);
+    }
+
+    // Insertion sort; the table holds at most one entry per edge and is
+    // usually just a handful of crossings.
+    for (int i = 1; i < num; i++) {
+      int x = xs[i];
+      int j = i - 1;
+      for (; j >= 0 && xs[j] > x; j--) {
+        xs[j + 1] = xs[j];
+      }
+      xs[j + 1] = x;
+    }
+
+    for (int i = 0; i + 1 < num; i += 2) {
+      h_line(img, xs[i], y, xs[i + 1] - xs[i] + 1, color);
+    }
+  }
+
+  lbm_free(xs);
+}
+
 static void generic_arc(image_buffer_t *img, int x, int y, int rad, float ang_start, float ang_end,
                         int thickness, bool filled, int dot1, int dot2, int res, bool sector, bool segment, uint32_t color) {
   ang_start *= (float)M_PI / 180.0f;
@@ -2102,6 +2265,56 @@ static lbm_value ext_image_buffer(lbm_value *args, lbm_uint argn) {
 }
 
 
+// (img-buffer-copy img) or (img-buffer-copy dm img)
+// Clone an image buffer with a single allocation and memcpy, header
+// included. Much cheaper than allocating and blitting when duplicating
+// buffers for sprite or theme variants. The copy goes to defrag memory
+// when a dm argument is given, otherwise to lbm memory like img-buffer.
+static lbm_value ext_image_buffer_copy(lbm_value *args, lbm_uint argn) {
+  lbm_value res = ENC_SYM_TERROR;
+  lbm_value img_val = ENC_SYM_NIL;
+  bool use_dm = false;
+
+  if (argn == 1) {
+    img_val = args[0];
+  } else if (argn == 2 && lbm_is_defrag_mem(args[0])) {
+    use_dm = true;
+    img_val = args[1];
+  } else {
+    return res;
+  }
+
+  lbm_array_header_t *arr = lbm_dec_array_r(img_val);
+  if (arr && image_buffer_is_valid((uint8_t*)arr->data, arr->size)) {
+    lbm_uint size = arr->size;
+
+    if (use_dm) {
+      res = lbm_defrag_mem_alloc((lbm_uint*)lbm_car(args[0]), size);
+      lbm_array_header_t *dst = lbm_dec_array_r(res);
+      if (dst) {
+        // The allocation may have compacted the defrag memory and moved
+        // the source, so decode the source pointer again afterwards.
+        arr = lbm_dec_array_r(img_val);
+        dirty_forget((uint8_t*)dst->data);
+        memcpy(dst->data, arr->data, size);
+      }
+    } else {
+      uint8_t *buf = lbm_malloc(size);
+      if (!buf) {
+        return ENC_SYM_MERROR;
+      }
+      memcpy(buf, arr->data, size);
+      res = ENC_SYM_MERROR;
+      if (lbm_lift_array(&res, (char*)buf, size)) {
+        dirty_forget(buf);
+      } else {
+        lbm_free(buf);
+      }
+    }
+  }
+  return res;
+}
+
 static lbm_value ext_is_image_buffer(lbm_value *args, lbm_uint argn) {
   lbm_value res = ENC_SYM_TERROR;
 
@@ -2597,6 +2810,93 @@ static lbm_value ext_triangle(lbm_value *args, lbm_uint argn) {
   return ENC_SYM_TRUE;
 }
 
+/* Shared decode for the vertex-array extensions. The points argument
+   (args[1]) is pulled out and the rest is passed through decode_args,
+   like ext_blit does for its second image. */
+static bool decode_poly_args(lbm_value *args, lbm_uint argn, img_args_t *arg_dec,
+                             const uint8_t **pts, uint32_t *num_pts) {
+  if (argn < 3 || argn > ARG_MAX_NUM + 2 || !lbm_is_array_r(args[1])) {
+    return false;
+  }
+
+  lbm_array_header_t *parr = (lbm_array_header_t *)lbm_car(args[1]);
+
+  lbm_value rest[ARG_MAX_NUM + 1];
+  rest[0] = args[0];
+  for (lbm_uint i = 2; i < argn; i++) {
+    rest[i - 1] = args[i];
+  }
+
+  *arg_dec = decode_args(rest, argn - 1, 1);
+  if (!arg_dec->is_valid) {
+    return false;
+  }
+
+  *pts = (const uint8_t *)parr->data;
+  *num_pts = (uint32_t)parr->size / 4;
+  return true;
+}
+
+// lisp args: img points color opt-attr1 ... opt-attrN
+// points is a byte array of packed 16 bit little endian x y pairs.
+static lbm_value ext_polyline(lbm_value *args, lbm_uint argn) {
+  img_args_t arg_dec;
+  const uint8_t *pts;
+  uint32_t n;
+  if (!decode_poly_args(args, argn, &arg_dec, &pts, &n)) {
+    return ENC_SYM_TERROR;
+  }
+
+  int thickness = lbm_dec_as_i32(arg_dec.attr_thickness.args[0]);
+  int dot1 = lbm_dec_as_i32(arg_dec.attr_dotted.args[0]);
+  int dot2 = lbm_dec_as_i32(arg_dec.attr_dotted.args[1]);
+  uint32_t color = lbm_dec_as_u32(arg_dec.args[0]);
+
+  for (uint32_t i = 0; i + 1 < n; i++) {
+    line(&arg_dec.img,
+         poly_pt_x(pts, i), poly_pt_y(pts, i),
+         poly_pt_x(pts, i + 1), poly_pt_y(pts, i + 1),
+         thickness, dot1, dot2, color);
+  }
+
+  return ENC_SYM_TRUE;
+}
+
+// lisp args: img points color opt-attr1 ... opt-attrN
+// Closed variant of img-polyline; the filled attribute rasterizes the
+// interior with a scanline fill, even-odd rule.
+static lbm_value ext_polygon(lbm_value *args, lbm_uint argn) {
+  img_args_t arg_dec;
+  const uint8_t *pts;
+  uint32_t n;
+  if (!decode_poly_args(args, argn, &arg_dec, &pts, &n)) {
+    return ENC_SYM_TERROR;
+  }
+
+  uint32_t color = lbm_dec_as_u32(arg_dec.args[0]);
+
+  if (n < 3) {
+    return ENC_SYM_TRUE;
+  }
+
+  if (arg_dec.attr_filled.is_valid) {
+    fill_polygon(&arg_dec.img, pts, n, color);
+  } else {
+    int thickness = lbm_dec_as_i32(arg_dec.attr_thickness.args[0]);
+    int dot1 = lbm_dec_as_i32(arg_dec.attr_dotted.args[0]);
+    int dot2 = lbm_dec_as_i32(arg_dec.attr_dotted.args[1]);
+
+    for (uint32_t i = 0, j = n - 1; i < n; j = i++) {
+      line(&arg_dec.img,
+           poly_pt_x(pts, j), poly_pt_y(pts, j),
+           poly_pt_x(pts, i), poly_pt_y(pts, i),
+           thickness, dot1, dot2, color);
+    }
+  }
+
+  return ENC_SYM_TRUE;
+}
+
 // lisp args: img x y fg bg font str
 static lbm_value ext_text(lbm_value *args, lbm_uint argn) {
   bool up = false;
@@ -2773,6 +3073,7 @@ static lbm_value ext_disp_reset(lbm_value *args, lbm_uint argn) {
   }
 
   disp_reset();
+  dirty_unsync_all();
 
   return ENC_SYM_TRUE;
 }
@@ -2798,6 +3099,7 @@ static lbm_value ext_disp_clear(lbm_value *args, lbm_uint argn) {
   }
 
   disp_clear(clear_color);
+  dirty_unsync_all();
 
   return ENC_SYM_TRUE;
 }
@@ -2843,9 +3145,74 @@ static lbm_value ext_disp_render(lbm_value *args, lbm_uint argn) {
       }
     }
 
-    // img_buf is a stack allocated image_buffer_t.
-    bool render_res = disp_render_image(&img_buf, (uint16_t)lbm_dec_as_u32(args[1]), (uint16_t)lbm_dec_as_u32(args[2]), colors);
-    if (!render_res) {
+    uint16_t px = (uint16_t)lbm_dec_as_u32(args[1]);
+    uint16_t py = (uint16_t)lbm_dec_as_u32(args[2]);
+
+    bool render_res = false;
+    bool partial_done = false;
+    disp_dirty_t *d = dirty_lookup(img_buf.mem_base);
+
+    // Partial flush is only valid when the panel is known to match the
+    // buffer outside the dirty rectangle: same buffer shape, same
+    // position and nothing has disturbed the panel since last render.
+    if (d && d->synced &&
+        d->render_x == px && d->render_y == py &&
+        d->width == img_buf.width && d->height == img_buf.height &&
+        d->fmt == (uint8_t)img_buf.fmt) {
+      if (d->x0 > d->x1) {
+        // Nothing changed since the previous render.
+        render_res = true;
+        partial_done = true;
+      } else {
+        uint16_t sw = (uint16_t)(d->x1 - d->x0 + 1);
+        uint16_t sh = (uint16_t)(d->y1 - d->y0 + 1);
+        // Only worth the copy when the dirty area is clearly smaller
+        // than the whole buffer.
+        if ((uint32_t)sw * (uint32_t)sh * 2 < (uint32_t)img_buf.width * (uint32_t)img_buf.height) {
+          uint8_t *sub = lbm_malloc(image_dims_to_size_bytes(img_buf.fmt, sw, sh));
+          if (sub) {
+            image_buffer_t sub_img;
+            sub_img.fmt = img_buf.fmt;
+            sub_img.width = sw;
+            sub_img.height = sh;
+            sub_img.mem_base = sub;
+            sub_img.data = sub;
+            for (uint16_t j = 0; j < sh; j ++) {
+              for (uint16_t i = 0; i < sw; i ++) {
+                putpixel(&sub_img, i, j, getpixel(&img_buf, d->x0 + i, d->y0 + j));
+              }
+            }
+            render_res = disp_render_image(&sub_img, (uint16_t)(px + (uint16_t)d->x0), (uint16_t)(py + (uint16_t)d->y0), colors);
+            lbm_free(sub);
+            partial_done = render_res;
+          }
+        }
+      }
+    }
+
+    if (!partial_done) {
+      // img_buf is a stack allocated image_buffer_t.
+      render_res = disp_render_image(&img_buf, px, py, colors);
+    }
+
+    if (render_res) {
+      if (!d && !lbm_defrag_mem_ptr_inside(img_buf.mem_base)) {
+        d = &dirty_bufs[dirty_evict_next];
+        dirty_evict_next = (dirty_evict_next + 1) % DISP_DIRTY_NUM;
+      }
+      if (d) {
+        d->mem_base = img_buf.mem_base;
+        d->width = img_buf.width;
+        d->height = img_buf.height;
+        d->fmt = (uint8_t)img_buf.fmt;
+        d->render_x = px;
+        d->render_y = py;
+        d->synced = true;
+        dirty_rect_reset(d);
+        dirty_cache_base = NULL;
+        dirty_cache_entry = NULL;
+      }
+    } else {
       lbm_set_error_reason("Could not render image. Check if the format and location is compatible with the display.");
       return ENC_SYM_EERROR;
     }
@@ -2862,6 +3229,15 @@ typedef struct {
   int size;
   int ofs_x;
   int ofs_y;
+  // MCU row assembly. The decoder produces small MCU blocks (typically
+  // 16x16) and issuing a windowed blit per block means hundreds of
+  // window setups for a full-screen image. When row_buf is available
+  // the blocks are assembled into one full-width MCU row and flushed
+  // with a single blit per row. row_buf is NULL when the allocation
+  // failed, in which case each block is rendered directly as before.
+  uint8_t *row_buf;
+  uint16_t row_w;
+  uint16_t row_h;
 } jpg_bufdef;
 
 size_t jpg_input_func (JDEC* jd, uint8_t* buff, size_t ndata) {
@@ -2885,11 +3261,37 @@ int jpg_output_func (	/* 1:Ok, 0:Aborted */
                         ) {
   jpg_bufdef *dev = (jpg_bufdef*)jd->device;
 
+  uint16_t bw = (uint16_t)(rect->right - rect->left + 1);
+  uint16_t bh = (uint16_t)(rect->bottom - rect->top + 1);
+
+  if (dev->row_buf) {
+    // Copy the block into the row at its horizontal position. Edge
+    // blocks can be narrower and the bottom row shorter.
+    for (uint16_t j = 0; j < bh; j ++) {
+      memcpy(dev->row_buf + ((uint32_t)j * dev->row_w + rect->left) * 3,
+             (uint8_t*)bitmap + (uint32_t)j * bw * 3,
+             (uint32_t)bw * 3);
+    }
+
+    if (rect->right + 1 >= jd->width) {
+      // Rightmost block of the row, flush it with one blit.
+      image_buffer_t img;
+      img.mem_base = dev->row_buf;
+      img.data = dev->row_buf;
+      img.width = dev->row_w;
+      img.height = bh;
+      img.fmt = rgb888;
+
+      disp_render_image(&img, (uint16_t)dev->ofs_x, (uint16_t)(rect->top + dev->ofs_y), 0);
+    }
+    return 1;
+  }
+
   image_buffer_t img;
   img.mem_base = (uint8_t*)bitmap;
   img.data = (uint8_t*)bitmap;
-  img.width = (uint16_t)(rect->right - rect->left + 1);
-  img.height = (uint16_t)(rect->bottom - rect->top + 1);
+  img.width = bw;
+  img.height = bh;
   img.fmt = rgb888;
 
   disp_render_image(&img, (uint16_t)(rect->left + dev->ofs_x), (uint16_t)(rect->top + dev->ofs_y), 0);
@@ -2925,9 +3327,24 @@ static lbm_value ext_disp_render_jpg(lbm_value *args, lbm_uint argn) {
     iodev.pos = 0;
     iodev.ofs_x = lbm_dec_as_i32(args[1]);
     iodev.ofs_y = lbm_dec_as_i32(args[2]);
-    jd_prepare(&jd, jpg_input_func, jdwork, sz_work + IMAGE_BUFFER_HEADER_SIZE, &iodev);
+    iodev.row_buf = NULL;
+    iodev.row_w = 0;
+    iodev.row_h = 0;
+    JRESULT jres = jd_prepare(&jd, jpg_input_func, jdwork, sz_work + IMAGE_BUFFER_HEADER_SIZE, &iodev);
+    if (jres == JDR_OK) {
+      // One full-width MCU row of working memory. Optional; decode
+      // falls back to per-block blits when it cannot be allocated.
+      iodev.row_w = jd.width;
+      iodev.row_h = (uint16_t)(jd.msy * 8);
+      iodev.row_buf = lbm_malloc((lbm_uint)iodev.row_w * iodev.row_h * 3);
+    }
     jd_decomp(&jd, jpg_output_func, 0);
+    if (iodev.row_buf) {
+      lbm_free(iodev.row_buf);
+    }
     lbm_free(jdwork);
+    // The jpg may have overwritten areas covered by tracked buffers.
+    dirty_unsync_all();
     res = ENC_SYM_TRUE;
   }
   return res;
@@ -2940,8 +3357,14 @@ void lbm_display_extensions_init(void) {
   disp_clear = NULL;
   disp_reset = NULL;
 
+  memset(dirty_bufs, 0, sizeof(dirty_bufs));
+  dirty_evict_next = 0;
+  dirty_cache_base = NULL;
+  dirty_cache_entry = NULL;
+
   lbm_add_extension("img-buffer", ext_image_buffer);
   lbm_add_extension("img-buffer?", ext_is_image_buffer);
+  lbm_add_extension("img-buffer-copy", ext_image_buffer_copy);
   lbm_add_extension("img-color", ext_color);
   lbm_add_extension("img-color-set", ext_color_set);
   lbm_add_extension("img-color-get", ext_color_get);
@@ -2958,6 +3381,8 @@ void lbm_display_extensions_init(void) {
   lbm_add_extension("img-circle-segment", ext_circle_segment);
   lbm_add_extension("img-rectangle", ext_rectangle);
   lbm_add_extension("img-triangle", ext_triangle);
+  lbm_add_extension("img-polyline", ext_polyline);
+  lbm_add_extension("img-polygon", ext_polygon);
   lbm_add_extension("img-blit", ext_blit);
 
   lbm_add_extension("disp-reset", ext_disp_reset);
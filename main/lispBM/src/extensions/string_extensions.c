@@ -26,6 +26,7 @@
 #include "print.h"
 
 #include <ctype.h>
+#include <string.h>
 
 #ifdef LBM_OPT_STRING_EXTENSIONS_SIZE
 #pragma GCC optimize ("-Os")
@@ -230,6 +231,208 @@ static lbm_value ext_str_to_f(lbm_value *args, lbm_uint argn) {
   return lbm_enc_float(strtof(str, NULL));
 }
 
+/*
+ * Fast ASCII number parsing. strtof/strtol carry locale handling,
+ * errno and full rounding; on soft-float targets that dominates
+ * CSV-style ingest scripts. These parsers accumulate digits in an
+ * integer and apply a binary power-of-ten scale table, which is a few
+ * ULP off strtof in the worst case but several times faster.
+ */
+
+static float scale_10f(float v, int e) {
+  static const float pos[] = {1e1f, 1e2f, 1e4f, 1e8f, 1e16f, 1e32f};
+  bool div = e < 0;
+  unsigned int ue = (unsigned int)(div ? -e : e);
+  if (ue > 63) ue = 63;
+  for (int i = 0; ue; i ++, ue >>= 1) {
+    if (ue & 1) {
+      v = div ? v / pos[i] : v * pos[i];
+    }
+  }
+  return v;
+}
+
+static bool parse_i_fast(const char *s, const char *end, int32_t *out) {
+  while (s < end && (*s == ' ' || *s == '\t')) s ++;
+  bool neg = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    neg = *s == '-';
+    s ++;
+  }
+  int64_t v = 0;
+  bool any = false;
+  while (s < end && *s >= '0' && *s <= '9') {
+    any = true;
+    if (v < ((int64_t)1 << 40)) {
+      v = v * 10 + (*s - '0');
+    }
+    s ++;
+  }
+  if (!any) return false;
+  if (neg) v = -v;
+  if (v > INT32_MAX) v = INT32_MAX;
+  if (v < INT32_MIN) v = INT32_MIN;
+  *out = (int32_t)v;
+  return true;
+}
+
+static bool parse_f_fast(const char *s, const char *end, float *out) {
+  while (s < end && (*s == ' ' || *s == '\t')) s ++;
+  bool neg = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    neg = *s == '-';
+    s ++;
+  }
+  int64_t mant = 0;
+  int digits = 0;
+  int exp_adj = 0;
+  bool any = false;
+  while (s < end && *s >= '0' && *s <= '9') {
+    any = true;
+    if (digits < 18) {
+      mant = mant * 10 + (*s - '0');
+      digits ++;
+    } else {
+      exp_adj ++;
+    }
+    s ++;
+  }
+  if (s < end && *s == '.') {
+    s ++;
+    while (s < end && *s >= '0' && *s <= '9') {
+      any = true;
+      if (digits < 18) {
+        mant = mant * 10 + (*s - '0');
+        digits ++;
+        exp_adj --;
+      }
+      s ++;
+    }
+  }
+  if (!any) return false;
+  int e = 0;
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char *sp = s + 1;
+    bool eneg = false;
+    if (sp < end && (*sp == '-' || *sp == '+')) {
+      eneg = *sp == '-';
+      sp ++;
+    }
+    int ev = 0;
+    bool edig = false;
+    while (sp < end && *sp >= '0' && *sp <= '9') {
+      edig = true;
+      if (ev < 1000) ev = ev * 10 + (*sp - '0');
+      sp ++;
+    }
+    if (edig) {
+      e = eneg ? -ev : ev;
+    }
+  }
+  float res = scale_10f((float)mant, e + exp_adj);
+  *out = neg ? -res : res;
+  return true;
+}
+
+static lbm_value ext_str_to_i_fast(lbm_value *args, lbm_uint argn) {
+  if (argn != 1) {
+    lbm_set_error_reason((char*)lbm_error_str_num_args);
+    return ENC_SYM_EERROR;
+  }
+
+  size_t str_size = 0;
+  char *str = NULL;
+  if (!dec_str_size(args[0], &str, &str_size)) {
+    return ENC_SYM_TERROR;
+  }
+
+  int32_t v = 0;
+  parse_i_fast(str, str + strlen_max(str, str_size), &v);
+  return lbm_enc_i32(v);
+}
+
+static lbm_value ext_str_to_f_fast(lbm_value *args, lbm_uint argn) {
+  if (argn != 1) {
+    lbm_set_error_reason((char*)lbm_error_str_num_args);
+    return ENC_SYM_EERROR;
+  }
+
+  size_t str_size = 0;
+  char *str = NULL;
+  if (!dec_str_size(args[0], &str, &str_size)) {
+    return ENC_SYM_TERROR;
+  }
+
+  float v = 0.0f;
+  parse_f_fast(str, str + strlen_max(str, str_size), &v);
+  return lbm_enc_float(v);
+}
+
+// (str-parse-nums str delim) -> list of numbers, one per delimited
+// field. Fields containing . or e parse as float, others as i32.
+// Empty or non-numeric fields become nil, so field positions are kept.
+static lbm_value ext_str_parse_nums(lbm_value *args, lbm_uint argn) {
+  if (argn != 2) {
+    lbm_set_error_reason((char*)lbm_error_str_num_args);
+    return ENC_SYM_EERROR;
+  }
+
+  size_t str_size = 0;
+  char *str = NULL;
+  if (!dec_str_size(args[0], &str, &str_size)) {
+    return ENC_SYM_TERROR;
+  }
+
+  char *delim = lbm_dec_str(args[1]);
+  if (!delim || delim[0] == '\0') {
+    return ENC_SYM_TERROR;
+  }
+  char d = delim[0];
+
+  const char *s = str;
+  const char *end = str + strlen_max(str, str_size);
+  lbm_value res = ENC_SYM_NIL;
+
+  for (;;) {
+    const char *field_end = (const char *)memchr(s, d, (size_t)(end - s));
+    if (!field_end) field_end = end;
+
+    bool is_float = false;
+    for (const char *p = s; p < field_end; p ++) {
+      if (*p == '.' || *p == 'e' || *p == 'E') {
+        is_float = true;
+        break;
+      }
+    }
+
+    lbm_value v = ENC_SYM_NIL;
+    if (is_float) {
+      float f;
+      if (parse_f_fast(s, field_end, &f)) {
+        v = lbm_enc_float(f);
+      }
+    } else {
+      int32_t i;
+      if (parse_i_fast(s, field_end, &i)) {
+        v = lbm_enc_i32(i);
+      }
+    }
+    if (v == ENC_SYM_MERROR) {
+      return ENC_SYM_MERROR;
+    }
+
+    res = lbm_cons(v, res);
+    if (res == ENC_SYM_MERROR) {
+      return ENC_SYM_MERROR;
+    }
+
+    if (field_end == end) break;
+    s = field_end + 1;
+  }
+
+  return lbm_list_destructive_reverse(res);
+}
+
 static lbm_value ext_str_part(lbm_value *args, lbm_uint argn) {
   if ((argn != 2 && argn != 3) || !lbm_is_number(args[1])) {
     lbm_set_error_reason((char*)lbm_error_str_num_args);
@@ -400,8 +603,10 @@ static lbm_value ext_str_replace(lbm_value *args, lbm_uint argn) {
   while (count--) {
     ins = strstr(orig, rep);
     size_t len_front = (size_t)ins - (size_t)orig;
-    tmp = strncpy(tmp, orig, len_front) + len_front;
-    tmp = strncpy(tmp, with, len_with) + len_with;
+    memcpy(tmp, orig, len_front);
+    tmp += len_front;
+    memcpy(tmp, with, len_with);
+    tmp += len_with;
     orig += len_front + len_rep; // move to next "end of rep"
   }
   strcpy(tmp, orig);
@@ -425,14 +630,17 @@ static lbm_value change_case(lbm_value *args, lbm_uint argn, bool to_upper) {
   lbm_value lbm_res;
   if (lbm_create_array(&lbm_res, len + 1)) {
     lbm_array_header_t *arr = (lbm_array_header_t*)lbm_car(lbm_res);
-    for (unsigned int i = 0;i < len;i++) {
-      if (to_upper) {
-        ((char*)(arr->data))[i] = (char)toupper(orig[i]);
-      } else {
-        ((char*)(arr->data))[i] = (char)tolower(orig[i]);
+    char *data = (char*)arr->data;
+    if (to_upper) {
+      for (unsigned int i = 0;i < len;i++) {
+        data[i] = (char)toupper(orig[i]);
+      }
+    } else {
+      for (unsigned int i = 0;i < len;i++) {
+        data[i] = (char)tolower(orig[i]);
       }
     }
-    ((char*)(arr->data))[len] = '\0';
+    data[len] = '\0';
     return lbm_res;
   } else {
     return ENC_SYM_MERROR;
@@ -700,6 +908,32 @@ static lbm_value ext_str_find(lbm_value *args, lbm_uint argn) {
       start = 0;
     }
 
+    // Fast path for the common case: a single substring, searching
+    // right, case sensitive. memchr skips to candidate positions for
+    // the first byte instead of testing every offset.
+    if (to_right && case_sensitive && lbm_is_array_r(args[1])) {
+      lbm_array_header_t *header = (lbm_array_header_t *)lbm_car(args[1]);
+      lbm_int substr_len = (lbm_int)header->size - 1;
+      const char *substr = (const char *)header->data;
+      if (substr_len >= 1) {
+        lbm_int i = start;
+        while (i <= str_size - substr_len) {
+          const char *hit = (const char *)memchr(str + i, substr[0],
+              (size_t)(str_size - substr_len - i + 1));
+          if (!hit) break;
+          i = (lbm_int)(hit - str);
+          if (memcmp(str + i, substr, (size_t)substr_len) == 0) {
+            if (occurrence == 0) {
+              return lbm_enc_i(i);
+            }
+            occurrence -= 1;
+          }
+          i += 1;
+        }
+        return lbm_enc_i(-1);
+      }
+    }
+
     lbm_int dir = to_right ? 1 : -1;
     for (lbm_int i = start; to_right ? (i <= str_size - min_substr_len) : (i >= 0); i += dir) {
       for (lbm_value current = substrings; lbm_is_cons(current); current = lbm_cdr(current)) {
@@ -740,6 +974,9 @@ void lbm_string_extensions_init(void) {
   lbm_add_extension("str-join", ext_str_join);
   lbm_add_extension("str-to-i", ext_str_to_i);
   lbm_add_extension("str-to-f", ext_str_to_f);
+  lbm_add_extension("str-to-i-fast", ext_str_to_i_fast);
+  lbm_add_extension("str-to-f-fast", ext_str_to_f_fast);
+  lbm_add_extension("str-parse-nums", ext_str_parse_nums);
   lbm_add_extension("str-part", ext_str_part);
   lbm_add_extension("str-split", ext_str_split);
   lbm_add_extension("str-replace", ext_str_replace);
@@ -542,6 +542,93 @@ bool font_get_kerning(uint8_t *buffer, uint32_t left, uint32_t right, float *x_s
   return false;
 }
 
+/*
+ * Glyph lookup cache. The glyph bitmaps themselves are rasterized once
+ * by ttf-prepare, but finding a glyph in the prepared font is a linear
+ * scan over the glyph table that skips past every preceding bitmap, and
+ * it is repeated for each character on every draw. The cache memoizes
+ * the scan result (metrics and a pointer to the bitmap inside the font
+ * buffer) keyed by font buffer and codepoint, with least-recently-used
+ * replacement. Entries are guarded by the font buffer size as well, so
+ * a stale hit requires a different prepared font of the exact same size
+ * at the exact same address.
+ */
+
+#define GLYPH_CACHE_SIZE 32
+
+typedef struct {
+  uint8_t *font_data;
+  lbm_uint font_size;
+  uint32_t utf32;
+  uint32_t lru;
+  float advance_width;
+  float left_side_bearing;
+  int32_t y_offset;
+  int32_t width;
+  int32_t height;
+  uint8_t *gfx;
+} glyph_cache_entry_t;
+
+static glyph_cache_entry_t glyph_cache[GLYPH_CACHE_SIZE];
+static uint32_t glyph_cache_tick = 0;
+
+static bool font_get_glyph_cached(lbm_array_header_t *font_arr,
+                                  float *advance_width,
+                                  float *left_side_bearing,
+                                  int32_t *y_offset,
+                                  int32_t *width,
+                                  int32_t *height,
+                                  uint8_t **gfx,
+                                  uint32_t utf32,
+                                  uint32_t num_codes,
+                                  color_format_t fmt,
+                                  int32_t index) {
+
+  uint8_t *font_data = (uint8_t*)font_arr->data;
+  glyph_cache_entry_t *oldest = &glyph_cache[0];
+  for (int i = 0; i < GLYPH_CACHE_SIZE; i ++) {
+    glyph_cache_entry_t *e = &glyph_cache[i];
+    if (e->font_data == font_data &&
+        e->font_size == font_arr->size &&
+        e->utf32 == utf32) {
+      e->lru = ++glyph_cache_tick;
+      *advance_width = e->advance_width;
+      *left_side_bearing = e->left_side_bearing;
+      *y_offset = e->y_offset;
+      *width = e->width;
+      *height = e->height;
+      *gfx = e->gfx;
+      return true;
+    }
+    if (e->lru < oldest->lru) oldest = e;
+  }
+
+  if (font_get_glyph(font_data,
+                     advance_width,
+                     left_side_bearing,
+                     y_offset,
+                     width,
+                     height,
+                     gfx,
+                     utf32,
+                     num_codes,
+                     fmt,
+                     index)) {
+    oldest->font_data = font_data;
+    oldest->font_size = font_arr->size;
+    oldest->utf32 = utf32;
+    oldest->lru = ++glyph_cache_tick;
+    oldest->advance_width = *advance_width;
+    oldest->left_side_bearing = *left_side_bearing;
+    oldest->y_offset = *y_offset;
+    oldest->width = *width;
+    oldest->height = *height;
+    oldest->gfx = *gfx;
+    return true;
+  }
+  return false;
+}
+
 lbm_value ttf_text_bin(lbm_value *args, lbm_uint argn) {
   lbm_value res = ENC_SYM_TERROR;
   lbm_array_header_t *img_arr;
@@ -651,17 +738,17 @@ lbm_value ttf_text_bin(lbm_value *args, lbm_uint argn) {
     int32_t height;
     uint8_t *gfx;
 
-    if (font_get_glyph((uint8_t*)font_arr->data,
-                       &advance_width,
-                       &left_side_bearing,
-                       &y_offset,
-                       &width,
-                       &height,
-                       &gfx,
-                       utf32,
-                       num_codes,
-                       fmt,
-                       glyphs_index)) {
+    if (font_get_glyph_cached(font_arr,
+                              &advance_width,
+                              &left_side_bearing,
+                              &y_offset,
+                              &width,
+                              &height,
+                              &gfx,
+                              utf32,
+                              num_codes,
+                              fmt,
+                              glyphs_index)) {
 
       float x_shift = 0;
       float y_shift = 0;
@@ -803,17 +890,17 @@ lbm_value ext_ttf_wh(lbm_value *args, lbm_uint argn) {
     int32_t height;
     uint8_t *gfx;
 
-    if (font_get_glyph((uint8_t*)font_arr->data,
-                       &advance_width,
-                       &left_side_bearing,
-                       &y_offset,
-                       &width,
-                       &height,
-                       &gfx,
-                       utf32,
-                       num_codes,
-                       (color_format_t)color_fmt,
-                       glyphs_index)) {
+    if (font_get_glyph_cached(font_arr,
+                              &advance_width,
+                              &left_side_bearing,
+                              &y_offset,
+                              &width,
+                              &height,
+                              &gfx,
+                              utf32,
+                              num_codes,
+                              (color_format_t)color_fmt,
+                              glyphs_index)) {
 
       float x_shift = 0;
       float y_shift = 0;
@@ -884,17 +971,17 @@ lbm_value ext_ttf_glyph_dims(lbm_value *args, lbm_uint argn) {
     int32_t height;
     uint8_t *gfx;
 
-    if (font_get_glyph((uint8_t*)font_arr->data,
-                       &advance_width,
-                       &left_side_bearing,
-                       &y_offset,
-                       &width,
-                       &height,
-                       &gfx,
-                       utf32,
-                       num_codes,
-                       (color_format_t)color_fmt,
-                       glyphs_index)) {
+    if (font_get_glyph_cached(font_arr,
+                              &advance_width,
+                              &left_side_bearing,
+                              &y_offset,
+                              &width,
+                              &height,
+                              &gfx,
+                              utf32,
+                              num_codes,
+                              (color_format_t)color_fmt,
+                              glyphs_index)) {
 
       return lbm_heap_allocate_list_init(2,
                                         lbm_enc_u((uint32_t)(width)),
@@ -1022,6 +1109,9 @@ lbm_value ext_ttf_line_gap(lbm_value *args, lbm_uint argn) {
 
 void lbm_ttf_extensions_init(void) {
 
+  memset(glyph_cache, 0, sizeof(glyph_cache));
+  glyph_cache_tick = 0;
+
   // metrics
   lbm_add_extension("ttf-line-height", ext_ttf_line_height);
   lbm_add_extension("ttf-ascender", ext_ttf_ascender);
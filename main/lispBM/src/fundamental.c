@@ -105,6 +105,19 @@
 //       But the checks required to figure out if it is possible to apply the
 //       operation in this way has a cost too...
 
+// True for values encoded as LBM_TYPE_I (the unboxed 28/56-bit integer).
+// Checks the entire tag field so that pointers, whose type bits could
+// alias LBM_TYPE_I, are excluded.
+#define IS_FIXNUM(x) (((x) & ((1u << LBM_VAL_SHIFT) - 1)) == LBM_TYPE_I)
+
+// Fixnum-fixnum add, sub and compare are performed directly on the
+// encoded values with a correction of the result type bits (the idea
+// from the todo above, applied where the check is just a tag test).
+// Since both tags are equal and the value field sits above the tag,
+// the result wraps at the fixnum width exactly like going through
+// dec/enc does, so no overflow fallback is needed and the results are
+// bit-identical to the generic path.
+
 static lbm_uint mul2(lbm_uint a, lbm_uint b) {
   lbm_uint retval = ENC_SYM_TERROR;
   if (IS_NUMBER(a) && IS_NUMBER(b)) {
@@ -187,6 +200,9 @@ static lbm_uint mod2(lbm_uint a, lbm_uint b) {
 }
 
 static lbm_uint sub2(lbm_uint a, lbm_uint b) {
+  if (IS_FIXNUM(a) && IS_FIXNUM(b)) {
+    return a - b + LBM_TYPE_I;
+  }
   lbm_uint retval = ENC_SYM_TERROR;
   if (IS_NUMBER(a) && IS_NUMBER(b)) {
     lbm_uint t;
@@ -291,6 +307,11 @@ bool struct_eq(lbm_value a, lbm_value b) {
 */
 static int compare_num(lbm_uint a, lbm_uint b) {
 
+  if (IS_FIXNUM(a) && IS_FIXNUM(b)) {
+    // Equal tags, so the encoded values order the same as the decoded ones.
+    return CMP((lbm_int)a, (lbm_int)b);
+  }
+
   int retval = 0;
 
   lbm_uint t;
@@ -356,6 +377,9 @@ static lbm_value cossa_lookup(lbm_value key, lbm_value assoc) {
 
 static lbm_value fundamental_add(lbm_value *args, lbm_uint nargs, eval_context_t *ctx) {
   (void) ctx;
+  if (nargs == 2 && IS_FIXNUM(args[0]) && IS_FIXNUM(args[1])) {
+    return args[0] + (args[1] - LBM_TYPE_I);
+  }
   lbm_uint sum = lbm_enc_char(0);
   for (lbm_uint i = 0; i < nargs; i ++) {
     lbm_value v = args[i];
@@ -736,6 +760,7 @@ static lbm_value fundamental_undefine(lbm_value *args, lbm_uint nargs, eval_cont
       return ENC_SYM_NIL;
     }
     global_env[ix_key] = res;
+    lbm_global_env_cache_drop(key);
     return ENC_SYM_TRUE;
   } else if (nargs == 1 && lbm_is_cons(args[0])) {
     lbm_value curr = args[0];
@@ -746,6 +771,7 @@ static lbm_value fundamental_undefine(lbm_value *args, lbm_uint nargs, eval_cont
       lbm_value res = lbm_env_drop_binding(env, key);
       if (res != ENC_SYM_NOT_FOUND) {
         global_env[ix_key] = res;
+        lbm_global_env_cache_drop(key);
       }
       curr = lbm_cdr(curr);
     }
@@ -1306,6 +1332,9 @@ static lbm_value fundamental_range(lbm_value *args, lbm_uint nargs, eval_context
 
   int num = end - start;
 
+#ifdef LBM_USE_INCREMENTAL_GC
+  if ((unsigned int)num > lbm_heap_num_free()) lbm_gc_sweep_finish();
+#endif
   if ((unsigned int)num > lbm_heap_num_free()) {
     return ENC_SYM_MERROR;
   }
@@ -81,6 +81,28 @@ static inline lbm_value lbm_clr_gc_flag(lbm_value x) {
 
 lbm_heap_state_t lbm_heap_state;
 
+#ifdef LBM_USE_INCREMENTAL_GC
+// Incremental sweep state, see the incremental sweep section further down.
+#define LBM_UINT_BITS (sizeof(lbm_uint) * 8)
+#define GC_SWEEP_BUDGET_DEFAULT 128
+
+static lbm_uint *gc_garbage_bitmap = NULL;
+static lbm_uint gc_garbage_words = 0;
+static lbm_uint gc_sweep_cursor = 0;
+static bool gc_sweep_pending = false;
+static lbm_uint gc_sweep_budget = GC_SWEEP_BUDGET_DEFAULT;
+
+// Free garbage until at least n cells are on the freelist or the
+// pending sweep completes. Unswept garbage is still counted in
+// num_alloc, so lbm_heap_num_free is the exact freelist length, also
+// when callers outside the heap pop cells off the freelist directly.
+static void sweep_ensure_free(lbm_uint n) {
+  while (gc_sweep_pending && lbm_heap_num_free() < n) {
+    lbm_gc_sweep_slice(gc_sweep_budget);
+  }
+}
+#endif
+
 lbm_const_heap_t *lbm_const_heap_state;
 
 lbm_cons_t *lbm_heaps[2] = {NULL, NULL};
@@ -558,6 +580,11 @@ static int generate_freelist(size_t num_cells) {
   t = lbm_ref_cell(lbm_enc_cons_ptr(num_cells-1));
   t->cdr = ENC_SYM_NIL;
 
+#ifdef LBM_USE_INCREMENTAL_GC
+  gc_sweep_pending = false;
+  gc_sweep_cursor = 0;
+#endif
+
   return 1;
 }
 
@@ -582,6 +609,17 @@ static void heap_init_state(lbm_cons_t *addr, lbm_uint num_cells,
   lbm_heap_state.gc_recovered_arrays = 0;
   lbm_heap_state.gc_least_free       = num_cells;
   lbm_heap_state.gc_last_free        = num_cells;
+  lbm_heap_state.gc_time_acc         = 0;
+  lbm_heap_state.gc_min_duration     = (lbm_uint)-1;
+  lbm_heap_state.gc_max_duration     = 0;
+}
+
+void lbm_heap_new_gc_time(lbm_uint dur) {
+  lbm_heap_state.gc_time_acc += dur;
+  if (dur > lbm_heap_state.gc_max_duration)
+    lbm_heap_state.gc_max_duration = dur;
+  if (dur < lbm_heap_state.gc_min_duration)
+    lbm_heap_state.gc_min_duration = dur;
 }
 
 void lbm_heap_new_freelist_length(void) {
@@ -601,6 +639,12 @@ int lbm_heap_init(lbm_cons_t *addr, lbm_uint num_cells,
   lbm_uint *gc_stack_storage = (lbm_uint*)lbm_malloc(gc_stack_size * sizeof(lbm_uint));
   if (gc_stack_storage == NULL) return 0;
 
+#ifdef LBM_USE_INCREMENTAL_GC
+  gc_garbage_words = (num_cells + LBM_UINT_BITS - 1) / LBM_UINT_BITS;
+  gc_garbage_bitmap = (lbm_uint*)lbm_malloc(gc_garbage_words * sizeof(lbm_uint));
+  if (gc_garbage_bitmap == NULL) return 0;
+#endif
+
   heap_init_state(addr, num_cells,
                   gc_stack_storage, gc_stack_size);
 
@@ -612,6 +656,9 @@ int lbm_heap_init(lbm_cons_t *addr, lbm_uint num_cells,
 
 lbm_value lbm_heap_allocate_cell(lbm_type ptr_type, lbm_value car, lbm_value cdr) {
   lbm_value r;
+#ifdef LBM_USE_INCREMENTAL_GC
+  if (!lbm_heap_state.freelist) sweep_ensure_free(1);
+#endif
   lbm_value cell = lbm_heap_state.freelist;
   if (cell) {
     lbm_uint heap_ix = lbm_dec_ptr(cell);
@@ -628,6 +675,11 @@ lbm_value lbm_heap_allocate_cell(lbm_type ptr_type, lbm_value car, lbm_value cdr
 
 lbm_value lbm_heap_allocate_list(lbm_uint n) {
   if (n == 0) return ENC_SYM_NIL;
+#ifdef LBM_USE_INCREMENTAL_GC
+  // Unswept garbage is not on the freelist yet, so drain enough of a
+  // pending sweep for n cells before walking it.
+  sweep_ensure_free(n);
+#endif
   if (lbm_heap_num_free() < n) return ENC_SYM_MERROR;
 
   lbm_value curr = lbm_heap_state.freelist;
@@ -652,6 +704,9 @@ lbm_value lbm_heap_allocate_list(lbm_uint n) {
 
 lbm_value lbm_heap_allocate_list_init_va(unsigned int n, va_list valist) {
   if (n == 0) return ENC_SYM_NIL;
+#ifdef LBM_USE_INCREMENTAL_GC
+  sweep_ensure_free(n);
+#endif
   if (lbm_heap_num_free() < n) return ENC_SYM_MERROR;
 
   lbm_value curr = lbm_heap_state.freelist;
@@ -938,7 +993,175 @@ void lbm_gc_mark_roots(lbm_uint *roots, lbm_uint num_roots) {
   }
 }
 
+// Free any lbm_memory backed payload (array, channel, custom, ...)
+// attached to a cell.
+static void sweep_free_payload(lbm_cons_t *heap, lbm_uint i) {
+  // Check if this cell is a pointer to an array
+  // and free it.
+  if (lbm_type_of(heap[i].cdr) == LBM_TYPE_SYMBOL) {
+    switch(heap[i].cdr) {
+
+    case ENC_SYM_IND_I_TYPE: /* fall through */
+    case ENC_SYM_IND_U_TYPE:
+    case ENC_SYM_IND_F_TYPE:
+      lbm_memory_free((lbm_uint*)heap[i].car);
+      break;
+    case ENC_SYM_DEFRAG_LISPARRAY_TYPE: /* fall through */
+    case ENC_SYM_DEFRAG_ARRAY_TYPE:
+      lbm_defrag_mem_free((lbm_uint*)heap[i].car);
+      break;
+    case ENC_SYM_LISPARRAY_TYPE: /* fall through */
+    case ENC_SYM_ARRAY_TYPE:{
+      lbm_array_header_t *arr = (lbm_array_header_t*)heap[i].car;
+      lbm_memory_free((lbm_uint *)arr->data);
+      lbm_heap_state.gc_recovered_arrays++;
+      lbm_memory_free((lbm_uint *)arr);
+    } break;
+    case ENC_SYM_CHANNEL_TYPE:{
+      lbm_char_channel_t *chan = (lbm_char_channel_t*)heap[i].car;
+      lbm_memory_free((lbm_uint*)chan->state);
+      lbm_memory_free((lbm_uint*)chan);
+    } break;
+    case ENC_SYM_CUSTOM_TYPE: {
+      lbm_uint *t = (lbm_uint*)heap[i].car;
+      lbm_custom_type_destroy(t);
+      lbm_memory_free(t);
+      } break;
+    case ENC_SYM_DEFRAG_MEM_TYPE: {
+      lbm_uint *ptr = (lbm_uint *)heap[i].car;
+      lbm_defrag_mem_destroy(ptr);
+      } break;
+    default:
+      break;
+    }
+  }
+}
+
 // Sweep moves non-marked heap objects to the free list.
+static void sweep_free_cell(lbm_cons_t *heap, lbm_uint i) {
+  sweep_free_payload(heap, i);
+  // create pointer to use as new freelist
+  lbm_uint addr = lbm_enc_cons_ptr(i);
+
+  // Clear the "freed" cell.
+  heap[i].car = ENC_SYM_RECOVERED;
+  heap[i].cdr = lbm_heap_state.freelist;
+  lbm_heap_state.freelist = addr;
+  lbm_heap_state.num_alloc --;
+  lbm_heap_state.gc_recovered ++;
+}
+
+#ifdef LBM_USE_INCREMENTAL_GC
+/* ************************************************************
+   Incremental sweep.
+
+   The mark phase is still stop-the-world, but instead of freeing all
+   garbage before evaluation resumes, the sweep phase only does a
+   cheap scan over the heap that clears the mark bits of live cells,
+   frees the lbm_memory payloads of garbage cells and records the
+   cells themselves in a side bitmap. No mark bits remain
+   once the scan is done, so evaluation can resume immediately and the
+   recorded cells are freed in budget-bounded slices interleaved with
+   evaluation, either from the scheduler loop or on demand when the
+   freelist runs low.
+
+   The bitmap is fixed at the time of the scan and cells only leave it
+   by being freed, so a garbage cell can never be handed out by the
+   allocator and then freed again by a later slice. num_alloc counts
+   unswept garbage as allocated (it is decremented per cell as the
+   slices free them), so lbm_heap_num_free is always the exact number
+   of cells on the freelist and the allocators key the on-demand
+   sweeping off it directly.
+
+   Free cells are kept on the freelist over a collection (marked
+   before the mark phase, instead of the freelist being rebuilt by the
+   sweep), which keeps the num_alloc accounting exact across
+   incremental collections.
+*/
+
+int lbm_gc_sweep_phase(void) {
+  lbm_cons_t *heap = (lbm_cons_t *)lbm_heap_state.heap;
+
+  memset(gc_garbage_bitmap, 0, gc_garbage_words * sizeof(lbm_uint));
+  for (lbm_uint i = 0; i < lbm_heap_state.heap_size; i ++) {
+    if (lbm_get_gc_mark(heap[i].cdr)) {
+      heap[i].cdr = lbm_clr_gc_mark(heap[i].cdr);
+    } else {
+      // Payloads stored in lbm_memory are released eagerly during the
+      // scan so that memory pressure is relieved as soon as the
+      // collection finishes; only the recycling of the cells
+      // themselves is deferred. The cdr is neutralized so that a
+      // later slice (or a re-scan by a collection that runs while
+      // garbage is still pending) cannot free a payload twice.
+      sweep_free_payload(heap, i);
+      heap[i].cdr = ENC_SYM_RECOVERED;
+      gc_garbage_bitmap[i / LBM_UINT_BITS] |= (lbm_uint)1 << (i % LBM_UINT_BITS);
+    }
+  }
+  gc_sweep_cursor = 0;
+  gc_sweep_pending = true;
+
+  // Free an initial slice so the allocation that triggered the
+  // collection can succeed right away.
+  return lbm_gc_sweep_slice(gc_sweep_budget);
+}
+
+int lbm_gc_sweep_slice(lbm_uint max_cells) {
+  if (!gc_sweep_pending) return 1;
+  lbm_cons_t *heap = (lbm_cons_t *)lbm_heap_state.heap;
+  lbm_uint freed = 0;
+  lbm_uint i = gc_sweep_cursor;
+
+  while (i < lbm_heap_state.heap_size && freed < max_cells) {
+    lbm_uint word = gc_garbage_bitmap[i / LBM_UINT_BITS];
+    if (word == 0 && (i % LBM_UINT_BITS) == 0) {
+      // Skip over fully live words.
+      i += LBM_UINT_BITS;
+      continue;
+    }
+    if (word & ((lbm_uint)1 << (i % LBM_UINT_BITS))) {
+      gc_garbage_bitmap[i / LBM_UINT_BITS] &= ~((lbm_uint)1 << (i % LBM_UINT_BITS));
+      sweep_free_cell(heap, i);
+      freed ++;
+    }
+    i ++;
+  }
+  gc_sweep_cursor = i;
+  if (i >= lbm_heap_state.heap_size) {
+    gc_sweep_pending = false;
+    lbm_heap_new_freelist_length();
+  }
+  return 1;
+}
+
+void lbm_gc_sweep_continue(void) {
+  if (gc_sweep_pending) {
+    lbm_gc_sweep_slice(gc_sweep_budget);
+  }
+}
+
+void lbm_gc_sweep_finish(void) {
+  if (gc_sweep_pending) {
+    lbm_gc_sweep_slice(lbm_heap_state.heap_size);
+  }
+}
+
+void lbm_set_gc_sweep_budget(lbm_uint cells) {
+  if (cells > 0) gc_sweep_budget = cells;
+}
+
+void lbm_gc_mark_freelist(void) {
+  lbm_value curr = lbm_heap_state.freelist;
+  while (lbm_is_ptr(curr)) {
+    lbm_cons_t *cell = lbm_ref_cell(curr);
+    lbm_value next = cell->cdr;
+    cell->cdr = lbm_set_gc_mark(next);
+    curr = next;
+  }
+}
+
+#else
+
 int lbm_gc_sweep_phase(void) {
   unsigned int i = 0;
   lbm_cons_t *heap = (lbm_cons_t *)lbm_heap_state.heap;
@@ -947,59 +1170,14 @@ int lbm_gc_sweep_phase(void) {
     if ( lbm_get_gc_mark(heap[i].cdr)) {
       heap[i].cdr = lbm_clr_gc_mark(heap[i].cdr);
     } else {
-      // Check if this cell is a pointer to an array
-      // and free it.
-      if (lbm_type_of(heap[i].cdr) == LBM_TYPE_SYMBOL) {
-        switch(heap[i].cdr) {
-
-        case ENC_SYM_IND_I_TYPE: /* fall through */
-        case ENC_SYM_IND_U_TYPE:
-        case ENC_SYM_IND_F_TYPE:
-          lbm_memory_free((lbm_uint*)heap[i].car);
-          break;
-        case ENC_SYM_DEFRAG_LISPARRAY_TYPE: /* fall through */
-        case ENC_SYM_DEFRAG_ARRAY_TYPE:
-          lbm_defrag_mem_free((lbm_uint*)heap[i].car);
-          break;
-        case ENC_SYM_LISPARRAY_TYPE: /* fall through */
-        case ENC_SYM_ARRAY_TYPE:{
-          lbm_array_header_t *arr = (lbm_array_header_t*)heap[i].car;
-          lbm_memory_free((lbm_uint *)arr->data);
-          lbm_heap_state.gc_recovered_arrays++;
-          lbm_memory_free((lbm_uint *)arr);
-        } break;
-        case ENC_SYM_CHANNEL_TYPE:{
-          lbm_char_channel_t *chan = (lbm_char_channel_t*)heap[i].car;
-          lbm_memory_free((lbm_uint*)chan->state);
-          lbm_memory_free((lbm_uint*)chan);
-        } break;
-        case ENC_SYM_CUSTOM_TYPE: {
-          lbm_uint *t = (lbm_uint*)heap[i].car;
-          lbm_custom_type_destroy(t);
-          lbm_memory_free(t);
-          } break;
-        case ENC_SYM_DEFRAG_MEM_TYPE: {
-          lbm_uint *ptr = (lbm_uint *)heap[i].car;
-          lbm_defrag_mem_destroy(ptr);
-          } break;
-        default:
-          break;
-        }
-      }
-      // create pointer to use as new freelist
-      lbm_uint addr = lbm_enc_cons_ptr(i);
-
-      // Clear the "freed" cell.
-      heap[i].car = ENC_SYM_RECOVERED;
-      heap[i].cdr = lbm_heap_state.freelist;
-      lbm_heap_state.freelist = addr;
-      lbm_heap_state.num_alloc --;
-      lbm_heap_state.gc_recovered ++;
+      sweep_free_cell(heap, i);
     }
   }
   return 1;
 }
 
+#endif
+
 void lbm_gc_state_inc(void) {
   lbm_heap_state.gc_num ++;
   lbm_heap_state.gc_recovered = 0;
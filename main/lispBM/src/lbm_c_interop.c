@@ -216,6 +216,7 @@ int lbm_undefine(char *symbol) {
 
   if (new_env == ENC_SYM_NOT_FOUND) return 0;
   glob_env[ix_key] = new_env;
+  lbm_global_env_cache_drop(lbm_enc_sym(sym_id));
   return 1;
 }
 
@@ -39,6 +39,79 @@ static inline lbm_uint bs2ws(lbm_uint bs) {
 #define DEFRAG_ALLOC_CELLPTR(X) X[2]
 #define DEFRAG_ALLOC_ARRAY_HEADER_SIZE 3
 
+/* Incremental compaction.
+
+   Compacting a whole defrag mem in one go stalls the evaluator for as
+   long as the memmoves take, which is visible when large image
+   buffers are involved. Live defrag mems are therefore tracked in a
+   small registry and marked dirty when holes appear (GC freeing an
+   allocation, or an allocation-time defrag that stopped early). The
+   evaluator calls lbm_defrag_mem_compact_continue between evaluation
+   quanta, which compacts one dirty region at a time in steps bounded
+   by a word budget. Each step rescans from the start, so the already
+   packed prefix is skipped with a cheap pointer walk and no state
+   needs to survive between steps. Allocation-time defrag still runs
+   when an allocation cannot wait, but only until a large enough hole
+   has been opened, as before. */
+
+#define DEFRAG_MEM_MAX_REGISTERED 4
+#define DEFRAG_COMPACT_BUDGET_DEFAULT 256
+
+static lbm_uint *defrag_registry[DEFRAG_MEM_MAX_REGISTERED] = { NULL };
+static bool defrag_dirty[DEFRAG_MEM_MAX_REGISTERED] = { false };
+static lbm_uint defrag_compact_budget = DEFRAG_COMPACT_BUDGET_DEFAULT;
+static lbm_uint defrag_compact_steps = 0;
+
+void lbm_defrag_mem_reset(void) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    defrag_registry[i] = NULL;
+    defrag_dirty[i] = false;
+  }
+}
+
+static void defrag_mem_register(lbm_uint *defrag_mem) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    if (defrag_registry[i] == NULL) {
+      defrag_registry[i] = defrag_mem;
+      defrag_dirty[i] = false;
+      return;
+    }
+  }
+  // Unregistered defrag mems only miss out on background compaction.
+}
+
+static void defrag_mem_unregister(lbm_uint *defrag_mem) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    if (defrag_registry[i] == defrag_mem) {
+      defrag_registry[i] = NULL;
+      defrag_dirty[i] = false;
+      return;
+    }
+  }
+}
+
+static void defrag_mem_mark_dirty(lbm_uint *defrag_mem) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    if (defrag_registry[i] == defrag_mem) {
+      defrag_dirty[i] = true;
+      return;
+    }
+  }
+}
+
+bool lbm_defrag_mem_ptr_inside(uint8_t *ptr) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    lbm_uint *mem = defrag_registry[i];
+    if (mem) {
+      uint8_t *mem_data = (uint8_t*)DEFRAG_MEM_DATA(mem);
+      if (ptr >= mem_data && ptr < mem_data + DEFRAG_MEM_SIZE(mem) * sizeof(lbm_uint)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 lbm_value lbm_defrag_mem_create(lbm_uint nbytes) {
   lbm_value res = ENC_SYM_TERROR;
   lbm_uint nwords = bs2ws(nbytes); // multiple of 4.
@@ -53,6 +126,7 @@ lbm_value lbm_defrag_mem_create(lbm_uint nbytes) {
       if (cell == ENC_SYM_MERROR) {
         lbm_free(data);
       } else {
+        defrag_mem_register(data);
         res = cell;
       }
     }
@@ -100,16 +174,20 @@ void lbm_defrag_mem_destroy(lbm_uint *defrag_mem) {
     }
     else i ++;
   }
+  defrag_mem_unregister(defrag_mem);
   lbm_free(defrag_mem);
 }
 
 
-static void lbm_defrag_mem_defrag(lbm_uint *defrag_mem, lbm_uint bytes) {
+// Compact, stopping early either when a hole of until_words words has
+// been opened or when more than budget_words words have been moved
+// (0 disables the respective limit). Returns true when the region is
+// fully compacted.
+static bool defrag_mem_compact(lbm_uint *defrag_mem, lbm_uint until_words, lbm_uint budget_words) {
   lbm_uint mem_size = ((lbm_uint*)defrag_mem)[0]; // mem size words
   lbm_uint *mem_data = DEFRAG_MEM_DATA(defrag_mem);
   lbm_uint hole_start = 0;
-
-  lbm_uint until_size =  DEFRAG_ALLOC_ARRAY_HEADER_SIZE + bs2ws(bytes); // defrag until hole is this size or complete defrag.
+  lbm_uint moved_words = 0;
 
   for (lbm_uint i = 0; i < mem_size; ) {
     // check if there is an allocation here
@@ -124,7 +202,8 @@ static void lbm_defrag_mem_defrag(lbm_uint *defrag_mem, lbm_uint bytes) {
         hole_start = i;
       } else {
         lbm_uint move_dist = i - hole_start;
-        if (move_dist >= until_size) break;
+        if (until_words > 0 && move_dist >= until_words) return false;
+        if (budget_words > 0 && moved_words >= budget_words) return false;
         lbm_uint clear_ix = (hole_start + alloc_words + DEFRAG_ALLOC_ARRAY_HEADER_SIZE);
         memmove(target, source, (alloc_words + DEFRAG_ALLOC_ARRAY_HEADER_SIZE) * sizeof(lbm_uint));
         memset(&mem_data[clear_ix],0, move_dist* sizeof(lbm_uint));
@@ -132,6 +211,7 @@ static void lbm_defrag_mem_defrag(lbm_uint *defrag_mem, lbm_uint bytes) {
         lbm_value cell = DEFRAG_ALLOC_CELLPTR(target);
 
         lbm_set_car(cell,(lbm_uint)target);
+        moved_words += alloc_words + DEFRAG_ALLOC_ARRAY_HEADER_SIZE;
         // move home and i forwards.
         // i can move to the original end of allocation.
         hole_start += alloc_words +  DEFRAG_ALLOC_ARRAY_HEADER_SIZE;
@@ -142,6 +222,36 @@ static void lbm_defrag_mem_defrag(lbm_uint *defrag_mem, lbm_uint bytes) {
       i ++;
     }
   }
+  return true;
+}
+
+static void lbm_defrag_mem_defrag(lbm_uint *defrag_mem, lbm_uint bytes) {
+  // defrag until hole is this size or complete defrag.
+  lbm_uint until_size = DEFRAG_ALLOC_ARRAY_HEADER_SIZE + bs2ws(bytes);
+  if (!defrag_mem_compact(defrag_mem, until_size, 0)) {
+    // Stopped at a large enough hole; the tail is still fragmented.
+    defrag_mem_mark_dirty(defrag_mem);
+  }
+}
+
+void lbm_defrag_mem_compact_continue(void) {
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    if (defrag_registry[i] && defrag_dirty[i]) {
+      defrag_compact_steps ++;
+      if (defrag_mem_compact(defrag_registry[i], 0, defrag_compact_budget)) {
+        defrag_dirty[i] = false;
+      }
+      return; // at most one step per call
+    }
+  }
+}
+
+void lbm_set_defrag_compact_budget(lbm_uint words) {
+  if (words > 0) defrag_compact_budget = words;
+}
+
+lbm_uint lbm_defrag_mem_compact_steps(void) {
+  return defrag_compact_steps;
 }
 
 // Allocate an array from the defragable pool
@@ -271,5 +381,17 @@ void lbm_defrag_mem_free(lbm_uint* data) {
   for (lbm_uint i = 0; i < words_to_wipe; i ++) {
     data[i] = 0;
   }
+  // The wipe leaves a hole, so mark the owning region for background
+  // compaction.
+  for (int i = 0; i < DEFRAG_MEM_MAX_REGISTERED; i ++) {
+    lbm_uint *mem = defrag_registry[i];
+    if (mem) {
+      lbm_uint *mem_data = DEFRAG_MEM_DATA(mem);
+      if (data >= mem_data && data < mem_data + DEFRAG_MEM_SIZE(mem)) {
+        defrag_dirty[i] = true;
+        break;
+      }
+    }
+  }
 }
 
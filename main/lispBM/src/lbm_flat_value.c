@@ -41,6 +41,31 @@ bool lbm_start_flatten(lbm_flat_value_t *v, size_t buffer_size) {
   return res;
 }
 
+bool lbm_start_flatten_buffer(lbm_flat_value_t *v, uint8_t *buffer, size_t buffer_size) {
+  bool res = false;
+  if (buffer && buffer_size > 0) {
+    v->buf = buffer;
+    v->buf_size = buffer_size;
+    v->buf_pos = 0;
+    res = true;
+  }
+  return res;
+}
+
+static void (*flat_ext_free_callback)(uint8_t *buf) = NULL;
+
+void lbm_set_flat_ext_free_callback(void (*f)(uint8_t *buf)) {
+  flat_ext_free_callback = f;
+}
+
+void lbm_free_flat_buffer(uint8_t *buf) {
+  if (lbm_memory_ptr_inside((lbm_uint*)buf)) {
+    lbm_free(buf);
+  } else if (flat_ext_free_callback) {
+    flat_ext_free_callback(buf);
+  }
+}
+
 bool lbm_finish_flatten(lbm_flat_value_t *v) {
   lbm_uint size_words;
   if (v->buf_pos % sizeof(lbm_uint) == 0) {
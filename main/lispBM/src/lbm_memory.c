@@ -51,6 +51,24 @@ static mutex_t lbm_mem_mutex;
 static bool    lbm_mem_mutex_initialized;
 static lbm_uint alloc_offset = 0;
 
+/* Segregated quick lists layered over the bitmap.
+
+   Freed blocks of MEM_QUICK_CLASSES words or less are threaded onto a
+   per-size free list, using the first word of the free block itself
+   as the link. A listed block keeps its allocated marking in the
+   bitmap, so an allocation of the same size is a pop with no bitmap
+   work at all, and the scan never hands a listed block out twice.
+
+   The cost is that listed blocks cannot coalesce with free
+   neighbours, so when a scan fails while blocks are parked in the
+   lists, the lists are flushed back to the bitmap and the scan is
+   retried once. memory_num_free counts listed blocks as free. */
+
+#define MEM_QUICK_CLASSES 8
+
+static lbm_uint *quick_lists[MEM_QUICK_CLASSES]; // ix n holds blocks of n+1 words
+static lbm_uint quick_list_words = 0;
+
 int lbm_memory_init(lbm_uint *data, lbm_uint data_size,
                     lbm_uint *bits, lbm_uint bits_size) {
 
@@ -61,6 +79,11 @@ int lbm_memory_init(lbm_uint *data, lbm_uint data_size,
 
   alloc_offset = 0;
 
+  for (int i = 0; i < MEM_QUICK_CLASSES; i ++) {
+    quick_lists[i] = NULL;
+  }
+  quick_list_words = 0;
+
   mutex_lock(&lbm_mem_mutex);
   int res = 0;
   if (data == NULL || bits == NULL) return 0;
@@ -158,6 +181,27 @@ static inline void set_status(lbm_uint i, lbm_uint status) {
   bitmap[word_ix] |= mask;
 }
 
+// Return all quick listed blocks to the bitmap so that they can
+// coalesce with their neighbours. Must be called with the memory
+// mutex held.
+static void quick_lists_flush(void) {
+  for (int c = 0; c < MEM_QUICK_CLASSES; c ++) {
+    lbm_uint *curr = quick_lists[c];
+    while (curr) {
+      lbm_uint *next = (lbm_uint*)curr[0];
+      lbm_uint ix = address_to_bitmap_ix(curr);
+      set_status(ix, FREE_OR_USED);
+      if (c > 0) {
+        set_status(ix + (lbm_uint)c, FREE_OR_USED);
+      }
+      curr = next;
+    }
+    quick_lists[c] = NULL;
+  }
+  quick_list_words = 0;
+  alloc_offset = 0;
+}
+
 lbm_uint lbm_memory_num_words(void) {
   return memory_size;
 }
@@ -180,6 +224,9 @@ lbm_uint lbm_memory_longest_free(void) {
     return 0;
   }
   mutex_lock(&lbm_mem_mutex);
+  // Parked quick list blocks look allocated to the scan below, so
+  // return them first for an accurate answer.
+  quick_lists_flush();
   unsigned int state = INIT;
   lbm_uint max_length = 0;
 
@@ -234,12 +281,24 @@ static lbm_uint *lbm_memory_allocate_internal(lbm_uint num_words) {
 
   mutex_lock(&lbm_mem_mutex);
 
+  if (num_words >= 1 && num_words <= MEM_QUICK_CLASSES) {
+    lbm_uint *blk = quick_lists[num_words - 1];
+    if (blk) {
+      quick_lists[num_words - 1] = (lbm_uint*)blk[0];
+      quick_list_words -= num_words;
+      memory_num_free -= num_words;
+      mutex_unlock(&lbm_mem_mutex);
+      return blk;
+    }
+  }
+
   lbm_uint start_ix = 0;
   lbm_uint end_ix = 0;
   lbm_uint free_length = 0;
   unsigned int state = INIT;
   lbm_uint loop_max = (bitmap_size << BITMAP_SIZE_SHIFT);
 
+ scan:
   for (lbm_uint i = 0; i < loop_max; i ++) {
     switch(status(alloc_offset)) {
     case FREE_OR_USED:
@@ -291,6 +350,16 @@ static lbm_uint *lbm_memory_allocate_internal(lbm_uint num_words) {
     }
   }
 
+  if (state != ALLOC_DONE && quick_list_words > 0) {
+    // The scan failed while blocks are parked in the quick lists.
+    // Return them to the bitmap so they can coalesce and try again.
+    // The flush empties the lists, so this retries at most once.
+    quick_lists_flush();
+    free_length = 0;
+    state = INIT;
+    goto scan;
+  }
+
   if (state == ALLOC_DONE) {
     if (start_ix == end_ix) {
       set_status(start_ix, START_END);
@@ -320,21 +389,17 @@ int lbm_memory_free(lbm_uint *ptr) {
     mutex_lock(&lbm_mem_mutex);
     lbm_uint ix = address_to_bitmap_ix(ptr);
     lbm_uint count_freed = 0;
-    alloc_offset = ix;
     switch(status(ix)) {
     case START:
-      set_status(ix, FREE_OR_USED);
       for (lbm_uint i = ix; i < (bitmap_size << BITMAP_SIZE_SHIFT); i ++) {
         count_freed ++;
         if (status(i) == END) {
-          set_status(i, FREE_OR_USED);
           r = 1;
           break;
         }
       }
       break;
     case START_END:
-      set_status(ix, FREE_OR_USED);
       count_freed = 1;
       r = 1;
       break;
@@ -342,8 +407,19 @@ int lbm_memory_free(lbm_uint *ptr) {
       break;
     }
     if (r) {
-      while (alloc_offset > 0 && status(alloc_offset - 1) == FREE_OR_USED) {
-        alloc_offset--;
+      if (count_freed <= MEM_QUICK_CLASSES) {
+        // Park the block on its quick list with the bitmap marking
+        // kept, so a same-size allocation can reuse it directly.
+        ptr[0] = (lbm_uint)quick_lists[count_freed - 1];
+        quick_lists[count_freed - 1] = ptr;
+        quick_list_words += count_freed;
+      } else {
+        set_status(ix, FREE_OR_USED);
+        set_status(ix + count_freed - 1, FREE_OR_USED);
+        alloc_offset = ix;
+        while (alloc_offset > 0 && status(alloc_offset - 1) == FREE_OR_USED) {
+          alloc_offset--;
+        }
       }
     }
     memory_num_free += count_freed;
@@ -16,6 +16,7 @@
 */
 
 #include "lispbm.h"
+#include "lbm_defrag_mem.h"
 
 int lbm_init(lbm_cons_t *heap_storage, lbm_uint heap_size,
              lbm_uint *memory, lbm_uint memory_size,
@@ -35,6 +36,8 @@ int lbm_init(lbm_cons_t *heap_storage, lbm_uint heap_size,
   if (lbm_heap_init(heap_storage, heap_size, gc_stack_size) == 0)
     return 0;
 
+  lbm_defrag_mem_reset();
+
   if (lbm_print_init(print_stack_size) == 0)
     return 0;
 
@@ -39,9 +39,24 @@
 #define CONTINUE_ARRAY 8
 #define END_ARRAY      9
 
-static lbm_stack_t print_stack = { NULL, 0, 0};
+static lbm_stack_t print_stack = { NULL, 0, 0, 0};
 static bool print_has_stack = false;
 
+// Truncation limits set with lbm_print_set_limits. 0 means no limit.
+// max_depth is enforced through the size of the work stack, which grows
+// with nesting depth but not with list length.
+static lbm_uint print_max_depth = 0;
+static lbm_uint print_max_length = 0;
+
+// Upper bound on the number of work-stack entries one nesting level can
+// hold, used to translate max_depth into a bound on the stack pointer.
+#define PRINT_DEPTH_FRAMES 6
+
+void lbm_print_set_limits(lbm_uint max_depth, lbm_uint max_length) {
+  print_max_depth = max_depth;
+  print_max_length = max_length;
+}
+
 const char *failed_str = "Error: print failed\n";
 
 // is_printable_string is turning out to be a headache.
@@ -325,6 +340,16 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
       lbm_pop_2(&print_stack, &arr_ptr, &ix);
       arr = (lbm_array_header_t *)arr_ptr;
       lbm_value *arrdata = (lbm_value*)arr->data;
+      if (ix < (arr->size / sizeof(lbm_value)) &&
+          print_max_length > 0 && ix >= print_max_length) {
+        r = print_emit_string(chan, " ...");
+        if (r != EMIT_OK) return r;
+        res = lbm_push(&print_stack, END_ARRAY);
+        if (!res) {
+          return EMIT_FAILED;
+        }
+        break;
+      }
       if (ix < (arr->size / sizeof(lbm_value))) {
         r = print_emit_char(chan, ' ');
         lbm_value continuation[5] =
@@ -355,8 +380,8 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
       int res = 1;
       if (lbm_type_of(cdr_val) == LBM_TYPE_CONS ||
           lbm_type_of(cdr_val) == (LBM_TYPE_CONS | LBM_PTR_TO_CONSTANT_BIT)) {
-        lbm_value cont[2] = {cdr_val, CONTINUE_LIST};
-        res = res && push_n(&print_stack, cont, 2);
+        lbm_value cont[3] = {1, cdr_val, CONTINUE_LIST};
+        res = res && push_n(&print_stack, cont, 3);
       } else if (lbm_type_of(cdr_val) == LBM_TYPE_SYMBOL &&
                  cdr_val == ENC_SYM_NIL) {
         res = res && lbm_push(&print_stack, END_LIST);
@@ -373,13 +398,24 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
     }
     case CONTINUE_LIST: {
       int res = 1;
-      lbm_pop(&print_stack, &curr);
+      lbm_uint ix;
+      lbm_pop_2(&print_stack, &curr, &ix);
 
       if (lbm_type_of(curr) == LBM_TYPE_SYMBOL &&
           curr == ENC_SYM_NIL) {
         break;
       }
 
+      if (print_max_length > 0 && ix >= print_max_length) {
+        r = print_emit_string(chan, " ...");
+        if (r != EMIT_OK) return r;
+        res = lbm_push(&print_stack, END_LIST);
+        if (!res) {
+          return EMIT_FAILED;
+        }
+        break;
+      }
+
       lbm_value car_val = lbm_car(curr);
       lbm_value cdr_val = lbm_cdr(curr);
 
@@ -389,8 +425,8 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
       }
       if (lbm_type_of(cdr_val) == LBM_TYPE_CONS ||
           lbm_type_of(cdr_val) == (LBM_TYPE_CONS | LBM_PTR_TO_CONSTANT_BIT)) {
-        lbm_value cont[2] = {cdr_val, CONTINUE_LIST};
-        res = res && push_n(&print_stack, cont, 2);
+        lbm_value cont[3] = {ix + 1, cdr_val, CONTINUE_LIST};
+        res = res && push_n(&print_stack, cont, 3);
       } else if (lbm_type_of(cdr_val) == LBM_TYPE_SYMBOL &&
                   cdr_val == ENC_SYM_NIL) {
         res = res && lbm_push(&print_stack, END_LIST);
@@ -428,6 +464,10 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
       case LBM_TYPE_CONS: {
         if (lbm_dec_ptr(curr) == LBM_PTR_NULL) {
           print_emit_string(chan, " LBM_NULL ");
+        } else if (print_max_depth > 0 &&
+                   print_stack.sp > print_max_depth * PRINT_DEPTH_FRAMES) {
+          r = print_emit_string(chan, "...");
+          if (r != EMIT_OK) return r;
         } else {
           lbm_value cont[2] = {curr, START_LIST};
           int res = push_n(&print_stack, cont, 2);
@@ -484,6 +524,12 @@ static int lbm_print_internal(lbm_char_channel_t *chan, lbm_value v) {
 	r = print_emit_defrag_mem(chan, curr);
 	break;
       case LBM_TYPE_LISPARRAY: {
+        if (print_max_depth > 0 &&
+            print_stack.sp > print_max_depth * PRINT_DEPTH_FRAMES) {
+          r = print_emit_string(chan, "...");
+          if (r != EMIT_OK) return r;
+          break;
+        }
         lbm_value cont[2] = {curr, START_ARRAY};
         int res = push_n(&print_stack, cont, 2);
         if (!res) {
@@ -36,16 +36,44 @@ int lbm_stack_allocate(lbm_stack_t *s, lbm_uint stack_size) {
     memset(s->data, STACK_UNUSED_BYTE, stack_size * sizeof(lbm_uint));
     s->sp = 0;
     s->size = stack_size;
+    s->max_size = stack_size;
     r = 1;
   }
   return r;
 }
 
+int lbm_stack_allocate_growable(lbm_stack_t *s, lbm_uint initial_size, lbm_uint max_size) {
+  // A max_size that cannot possibly be satisfied is an error at
+  // allocation time, not when the stack eventually tries to grow.
+  if (max_size > lbm_memory_num_words()) return 0;
+  if (initial_size > max_size) initial_size = max_size;
+  int r = lbm_stack_allocate(s, initial_size);
+  if (r) {
+    s->max_size = max_size;
+  }
+  return r;
+}
+
+int lbm_stack_grow(lbm_stack_t *s) {
+  if (s->size >= s->max_size) return 0;
+  lbm_uint new_size = s->size * 2;
+  if (new_size > s->max_size) new_size = s->max_size;
+  lbm_uint *new_data = lbm_memory_allocate(new_size);
+  if (new_data == NULL) return 0;
+  memcpy(new_data, s->data, s->sp * sizeof(lbm_uint));
+  memset(new_data + s->sp, STACK_UNUSED_BYTE, (new_size - s->sp) * sizeof(lbm_uint));
+  lbm_memory_free(s->data);
+  s->data = new_data;
+  s->size = new_size;
+  return 1;
+}
+
 int lbm_stack_create(lbm_stack_t *s, lbm_uint* data, lbm_uint stack_size) {
   s->data = data;
   memset(s->data, STACK_UNUSED_BYTE, stack_size * sizeof(lbm_uint));
   s->sp = 0;
   s->size = stack_size;
+  s->max_size = stack_size;
   return 1;
 }
 
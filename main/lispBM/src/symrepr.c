@@ -265,9 +265,125 @@ static lbm_uint symbol_table_size_list_flash = 0;
 static lbm_uint symbol_table_size_strings = 0;
 static lbm_uint symbol_table_size_strings_flash = 0;
 
+/* Runtime symbol index.
+
+   The symbol list itself is part of the image format and cannot
+   change layout, but looking symbols up by walking it is O(n) per
+   lookup which adds up during code load and printing once an
+   application has defined thousands of symbols. The index is a pair
+   of open-addressing hash tables in lbm_memory (name -> entry and
+   id -> entry) that just point into the list entries. It is filled
+   in as entries are added, both at runtime and when an image is
+   rebooted, and grows by doubling at 75% load. Symbols are never
+   removed so there is no deletion to handle.
+
+   If a table allocation ever fails the index is marked incomplete
+   and lookups fall back to walking the list. */
+
+#define SYM_INDEX_INITIAL_SIZE 64 // slots, must be a power of two
+
+static lbm_uint *sym_index_name = NULL;
+static lbm_uint *sym_index_id = NULL;
+static lbm_uint sym_index_size = 0;
+static lbm_uint sym_index_count = 0;
+static bool sym_index_complete = true;
+
+static lbm_uint sym_index_hash_string(const char *str) {
+  lbm_uint h = 5381;
+  unsigned char c;
+  while ((c = (unsigned char)*str++) != 0) {
+    h = ((h << 5) + h) + c;
+  }
+  return h;
+}
+
+static lbm_uint sym_index_hash_id(lbm_uint id) {
+  return id * (lbm_uint)2654435761u;
+}
+
+static void sym_index_insert_tables(lbm_uint *name_tab, lbm_uint *id_tab, lbm_uint size, lbm_uint *entry) {
+  lbm_uint mask = size - 1;
+  lbm_uint i = sym_index_hash_string((const char *)entry[NAME]) & mask;
+  while (name_tab[i]) i = (i + 1) & mask;
+  name_tab[i] = (lbm_uint)entry;
+  i = sym_index_hash_id(entry[ID]) & mask;
+  while (id_tab[i]) i = (i + 1) & mask;
+  id_tab[i] = (lbm_uint)entry;
+}
+
+static bool sym_index_grow(void) {
+  lbm_uint new_size = sym_index_size ? sym_index_size * 2 : SYM_INDEX_INITIAL_SIZE;
+  lbm_uint *name_tab = lbm_memory_allocate(new_size);
+  if (!name_tab) return false;
+  lbm_uint *id_tab = lbm_memory_allocate(new_size);
+  if (!id_tab) {
+    lbm_memory_free(name_tab);
+    return false;
+  }
+  memset(name_tab, 0, new_size * sizeof(lbm_uint));
+  memset(id_tab, 0, new_size * sizeof(lbm_uint));
+  // Every entry is present in both tables, so the old name table
+  // alone enumerates them all.
+  for (lbm_uint i = 0; i < sym_index_size; i ++) {
+    if (sym_index_name[i]) {
+      sym_index_insert_tables(name_tab, id_tab, new_size, (lbm_uint*)sym_index_name[i]);
+    }
+  }
+  if (sym_index_name) lbm_memory_free(sym_index_name);
+  if (sym_index_id) lbm_memory_free(sym_index_id);
+  sym_index_name = name_tab;
+  sym_index_id = id_tab;
+  sym_index_size = new_size;
+  return true;
+}
+
+static void sym_index_add(lbm_uint *entry) {
+  if ((sym_index_count + 1) * 4 >= sym_index_size * 3) {
+    if (!sym_index_grow()) {
+      sym_index_complete = false;
+      return;
+    }
+  }
+  sym_index_insert_tables(sym_index_name, sym_index_id, sym_index_size, entry);
+  sym_index_count ++;
+}
+
+static lbm_uint *sym_index_lookup_name(char *name) {
+  if (sym_index_size == 0) return NULL;
+  lbm_uint mask = sym_index_size - 1;
+  lbm_uint i = sym_index_hash_string(name) & mask;
+  while (sym_index_name[i]) {
+    lbm_uint *entry = (lbm_uint*)sym_index_name[i];
+    if (str_eq(name, (char*)entry[NAME])) {
+      return entry;
+    }
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+static lbm_uint *sym_index_lookup_id(lbm_uint id) {
+  if (sym_index_size == 0) return NULL;
+  lbm_uint mask = sym_index_size - 1;
+  lbm_uint i = sym_index_hash_id(id) & mask;
+  while (sym_index_id[i]) {
+    lbm_uint *entry = (lbm_uint*)sym_index_id[i];
+    if (id == entry[ID]) {
+      return entry;
+    }
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
 // When rebooting an image...
 void lbm_symrepr_set_symlist(lbm_uint *ls) {
   symlist = ls;
+  // Image reboot adds one entry at a time to the head of the list,
+  // so index the new head here.
+  if (ls) {
+    sym_index_add(ls);
+  }
 }
 
 
@@ -286,6 +402,13 @@ int lbm_symrepr_init(void) {
   symbol_table_size_list_flash = 0;
   symbol_table_size_strings = 0;
   symbol_table_size_strings_flash = 0;
+  // lbm_memory was just re-initialized, so any previous index
+  // storage is already gone.
+  sym_index_name = NULL;
+  sym_index_id = NULL;
+  sym_index_size = 0;
+  sym_index_count = 0;
+  sym_index_complete = true;
   return 1;
 }
 
@@ -300,6 +423,13 @@ void lbm_symrepr_name_iterator(symrepr_name_iterator_fun f) {
 
 const char *lookup_symrepr_name_memory(lbm_uint id) {
 
+  lbm_uint *entry = sym_index_lookup_id(id);
+  if (entry) {
+    return (const char *)entry[NAME];
+  }
+  if (sym_index_complete) {
+    return NULL;
+  }
   lbm_uint *curr = symlist;
   while (curr) {
     if (id == curr[ID]) {
@@ -337,6 +467,10 @@ const char *lbm_get_name_by_symbol(lbm_uint id) {
 }
 
 lbm_uint *lbm_get_symbol_list_entry_by_name(char *name) {
+  lbm_uint *entry = sym_index_lookup_name(name);
+  if (entry || sym_index_complete) {
+    return entry;
+  }
   lbm_uint *curr = symlist;
   while (curr) {
     char *str = (char*)curr[NAME];
@@ -359,14 +493,19 @@ int lbm_get_symbol_by_name(char *name, lbm_uint* id) {
     }
    }
 
-  // loop through extensions
-  for (unsigned int i = 0; i < lbm_get_max_extensions(); i ++) {
-    if (extension_table[i].name && str_eq(name, extension_table[i].name)) {
-      *id = EXTENSION_SYMBOLS_START + i;
-      return 1;
-    }
+  // Extensions have their own hash index over names.
+  if (lbm_lookup_extension_id(name, id)) {
+    return 1;
   }
 
+  lbm_uint *entry = sym_index_lookup_name(name);
+  if (entry) {
+    *id = entry[ID];
+    return 1;
+  }
+  if (sym_index_complete) {
+    return 0;
+  }
   lbm_uint *curr = symlist;
   while (curr) {
     char *str = (char*)curr[NAME];
@@ -426,6 +565,7 @@ int lbm_add_symbol_base(char *name, lbm_uint *id) {
     return 0;
   }
   symlist = new_symlist;
+  sym_index_add(new_symlist);
   *id = next_symbol_id ++;
   return 1;
 }
@@ -453,6 +593,7 @@ int lbm_add_symbol_const_base(char *name, lbm_uint* id, bool link) {
   }
   if (new_symlist) {
     symlist = new_symlist;
+    sym_index_add(new_symlist);
     *id = next_symbol_id ++;
     return 1;
   }
@@ -0,0 +1,15 @@
+(define a [1 2 3 4 5 6])
+(define b [1 2 3 9 5 6])
+
+(define r1 (= 0 (bufcmp a 0 b 0 3)))
+(define r2 (< (bufcmp a 0 b 0 6) 0))
+(define r3 (> (bufcmp b 0 a 0 6) 0))
+(define r4 (= 0 (bufcmp a 4 b 4 2)))
+
+(define terr '(exit-error type_error))
+(define r5 (eq terr (trap (bufcmp a 10 b 0 2))))
+
+(define eerr '(exit-error eval_error))
+(define r6 (eq eerr (trap (bufcmp a 0 b 0))))
+
+(check (and r1 r2 r3 r4 r5 r6))
@@ -0,0 +1,22 @@
+(define b (bufcreate 16))
+
+(define r1 (= 7 (bufpack b 0 "BhI" 0xAA -300 70000u32)))
+(define r2 (= 170 (bufget-u8 b 0)))
+(define r3 (= -300 (bufget-i16 b 1)))
+(define r4 (= 70000u32 (bufget-u32 b 3)))
+
+(define r5 (= 9 (bufpack b 7 "<H" 0x1234)))
+(define r6 (= 0x34 (bufget-u8 b 7)))
+(define r7 (= 0x12 (bufget-u8 b 8)))
+
+(define r8 (eq (list 170 -300 70000u32) (bufunpack b 0 "BhI")))
+
+(bufpack b 9 "f" 3.25)
+(define r9 (= 3.25 (car (bufunpack b 9 "f"))))
+
+(define terr '(exit-error type_error))
+(define r10 (eq terr (trap (bufpack b 14 "I" 1))))
+(define r11 (eq terr (trap (bufunpack b 14 "I"))))
+(define r12 (eq terr (trap (bufpack b 0 "B"))))
+
+(check (and r1 r2 r3 r4 r5 r6 r7 r8 r9 r10 r11 r12))
@@ -0,0 +1,9 @@
+(define r (str-parse-nums "1,2.5,,x,-3" ","))
+
+(check (and
+        (= (ix r 0) 1)
+        (< (- (ix r 1) 2.5) 0.001) (> (- (ix r 1) 2.5) -0.001)
+        (eq (ix r 2) nil)
+        (eq (ix r 3) nil)
+        (= (ix r 4) -3)
+        ))
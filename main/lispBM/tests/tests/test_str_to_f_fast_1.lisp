@@ -0,0 +1,9 @@
+(define f (str-to-f-fast "124.321"))
+(define e (str-to-f-fast "-1.5e3"))
+
+(check (and
+        (< (- f 124.321) 0.001) (> (- f 124.321) -0.001)
+        (< (- e -1500.0) 0.1) (> (- e -1500.0) -0.1)
+        (= (str-to-i-fast "-42") -42)
+        (= (str-to-i-fast "  123") 123)
+        ))
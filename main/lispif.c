@@ -27,6 +27,7 @@
 #include "buffer.h"
 #include "lispbm.h"
 #include "mempools.h"
+#include "packet.h"
 #include "flash_helper.h"
 #include "lbm_prof.h"
 #include "esp_timer.h"
@@ -34,6 +35,8 @@
 #include "lbm_image.h"
 #include "esp_partition.h"
 #include "esp_ota_ops.h"
+#include "lowzip.h"
+#include "crc.h"
 
 #define GC_STACK_SIZE			160
 #define PRINT_STACK_SIZE		128
@@ -58,6 +61,22 @@ static lbm_extension_t extension_storage[EXTENSION_STORAGE_SIZE + USER_EXTENSION
 static volatile lbm_uint *image_ptr = 0;
 static int image_max_ind = 0;
 
+/*
+ * Decompressed code buffer. When the code header has
+ * CODE_FLAG_COMPRESSED set, the stored blob is a zip archive and the
+ * actual source (including any trailing import table) is inflated
+ * into this buffer at restart. Uncompressed code is tokenized straight
+ * out of the memory-mapped partition and never touches this buffer.
+ * Once the loader context has finished the tokenizer is done with the
+ * buffer, so it is freed again unless import arrays were shared out of
+ * it; those stay valid for the whole session and pin the buffer. The
+ * image area in flash is still placed after the stored blob, so a
+ * compressed script leaves more room for the image.
+ */
+static char *code_decomp_buf = 0;
+static bool code_decomp_pinned = false;
+static volatile int load_cid = -1;
+
 static lbm_string_channel_state_t string_tok_state;
 static lbm_char_channel_t string_tok;
 static lbm_buffered_channel_state_t buffered_tok_state;
@@ -73,6 +92,11 @@ static int main_cid = -1;
 static lbm_cid repl_cid_for_buffer = -1;
 static char *repl_buffer = 0;
 static volatile TickType_t repl_time = 0;
+
+// Context tracked by lispif_eval_sync; the done-callback gives the
+// semaphore when it finishes.
+static volatile lbm_cid sync_cid = -1;
+static SemaphoreHandle_t sync_done_sem = NULL;
 static int restart_cnt = 0;
 
 static esp_timer_handle_t prof_timer;
@@ -181,6 +205,86 @@ static void prof_timer_callback(void* arg) {
 	lbm_prof_sample();
 }
 
+// Returns true when the profiler was started fresh and false when an
+// already running profiler had its sample buffer reset.
+bool lispif_prof_start(void) {
+	if (prof_running) {
+		lbm_prof_init(prof_data, PROF_DATA_NUM);
+		return false;
+	} else {
+		lbm_prof_init(prof_data, PROF_DATA_NUM);
+		prof_running = true;
+		esp_timer_create(&periodic_timer_args, &prof_timer);
+		// Use a period that isn't a multiple if the eval thread periods
+		esp_timer_start_periodic(prof_timer, 571);
+		return true;
+	}
+}
+
+// Returns true if the profiler was running. The collected samples are
+// kept and can still be dumped after stopping.
+bool lispif_prof_stop(void) {
+	if (prof_running) {
+		prof_running = false;
+		esp_timer_stop(prof_timer);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Dump the collected profiler samples in the folded-stack format that
+ * flamegraph.pl and speedscope consume (one "frame;frame count" line
+ * per bucket). The sampler attributes samples per context, not per
+ * function, so the stacks are two levels deep: the context name (or
+ * cid when the context is unnamed) under an lbm root frame, with GC
+ * time split out as a child frame. Returns the number of bytes
+ * written; entries that do not fit in buf are dropped.
+ */
+int lispif_prof_dump_folded(char *buf, int buf_size) {
+	int ind = 0;
+
+	for (int i = 0;i < PROF_DATA_NUM;i++) {
+		if (prof_data[i].cid == -1) {
+			break;
+		}
+
+		char name[LBM_PROF_MAX_NAME_SIZE + 15];
+		if (prof_data[i].has_name) {
+			snprintf(name, sizeof(name), "%s", prof_data[i].name);
+		} else {
+			snprintf(name, sizeof(name), "cid_%d", (int)prof_data[i].cid);
+		}
+
+		lbm_uint run_count = prof_data[i].count - prof_data[i].gc_count;
+		if (run_count > 0) {
+			int res = snprintf(buf + ind, buf_size - ind, "lbm;%s %u\n", name, run_count);
+			if (res < 0 || res >= buf_size - ind) {
+				break;
+			}
+			ind += res;
+		}
+
+		if (prof_data[i].gc_count > 0) {
+			int res = snprintf(buf + ind, buf_size - ind, "lbm;%s;gc %u\n", name, prof_data[i].gc_count);
+			if (res < 0 || res >= buf_size - ind) {
+				break;
+			}
+			ind += res;
+		}
+	}
+
+	int res = snprintf(buf + ind, buf_size - ind, "lbm;system %u\nsleep %u\n",
+			lbm_prof_get_num_system_samples(),
+			lbm_prof_get_num_sleep_samples());
+	if (res > 0 && res < buf_size - ind) {
+		ind += res;
+	}
+
+	return ind;
+}
+
 static bool pause_eval(uint32_t num_free, uint32_t timeout_ms) {
 	if (!lisp_thd_running) {
 		return false;
@@ -313,6 +417,36 @@ void lispif_process_cmd(unsigned char *data, unsigned int len,
 		mempools_free_packet_buffer(send_buffer_global);
 	} break;
 
+	case COMM_LISP_PROF: {
+		// Byte after the id selects the operation:
+		// 0: stop, 1: start (or restart), 2: dump folded samples
+		uint8_t op = len >= 1 ? data[0] : 2;
+
+		int32_t ind = 0;
+		uint8_t *send_buffer = mempools_get_packet_buffer();
+		send_buffer[ind++] = packet_id;
+		send_buffer[ind++] = op;
+
+		switch (op) {
+		case 0:
+			send_buffer[ind++] = lispif_prof_stop();
+			break;
+
+		case 1:
+			lispif_prof_start();
+			send_buffer[ind++] = 1;
+			break;
+
+		case 2:
+		default:
+			ind += lispif_prof_dump_folded((char*)send_buffer + ind, PACKET_MAX_PL_LEN - ind);
+			break;
+		}
+
+		reply_func(send_buffer, ind);
+		mempools_free_packet_buffer(send_buffer);
+	} break;
+
 	case COMM_LISP_REPL_CMD: {
 		if (UTILS_AGE_S(repl_time) <= 0.5) {
 			return;
@@ -409,22 +543,10 @@ void lispif_process_cmd(unsigned char *data, unsigned int len,
 				commands_printf_lisp("Erase Cnt Max Sector: %d\n", stats.erase_cnt_max);
 				commands_printf_lisp("Num sectors erased: %d\n", stats.erased_sector_num);
 			} else if (strncmp(str, ":prof start", 11) == 0) {
-				if (prof_running) {
-					lbm_prof_init(prof_data, PROF_DATA_NUM);
-					commands_printf_lisp("Profiler restarted\n");
-				} else {
-					lbm_prof_init(prof_data, PROF_DATA_NUM);
-					prof_running = true;
-					esp_timer_create(&periodic_timer_args, &prof_timer);
-					// Use a period that isn't a multiple if the eval thread periods
-					esp_timer_start_periodic(prof_timer, 571);
-					commands_printf_lisp("Profiler started\n");
-				}
+				commands_printf_lisp(lispif_prof_start() ?
+						"Profiler started\n" : "Profiler restarted\n");
 			} else if (strncmp(str, ":prof stop", 10) == 0) {
-				if (prof_running) {
-					prof_running = false;
-					esp_timer_stop(prof_timer);
-				}
+				lispif_prof_stop();
 				commands_printf_lisp("Profiler stopped. Issue command ':prof report' for statistics\n");
 			} else if (strncmp(str, ":prof report", 12) == 0) {
 				lbm_uint num_sleep = lbm_prof_get_num_sleep_samples();
@@ -722,12 +844,98 @@ static void done_callback(eval_context_t *ctx) {
 		repl_buffer = 0;
 	}
 
+	if (cid == sync_cid) {
+		sync_cid = -1;
+		xSemaphoreGive(sync_done_sem);
+	}
+
+	if (cid == load_cid) {
+		load_cid = -1;
+		// The tokenizer has consumed all of the source, so the
+		// decompressed copy can go unless shared imports point into it.
+		if (code_decomp_buf && !code_decomp_pinned) {
+			free(code_decomp_buf);
+			code_decomp_buf = 0;
+		}
+	}
+
 	if (cid == main_cid) {
+		// First completion of the main program on a freshly created image. If
+		// the program defines a main-function we also snapshot the parsed
+		// environment and extension table into the image, so that subsequent
+		// boots restore everything memory-mapped and only evaluate (main)
+		// instead of re-tokenizing the entire source.
+		lbm_uint main_sym = ENC_SYM_NIL;
+		if (lbm_get_symbol_by_name("main", &main_sym)) {
+			lbm_value binding;
+			if (lbm_global_env_lookup(&binding, lbm_enc_sym(main_sym))) {
+				if (lbm_is_cons(binding) && lbm_car(binding) == ENC_SYM_CLOSURE) {
+					lbm_image_save_global_env();
+					lbm_image_save_extensions();
+				}
+			}
+		}
+
 		lbm_image_save_constant_heap_ix();
 		main_cid = -1;
 	}
 }
 
+/*
+ * Evaluate code and block until the spawned context finishes or the
+ * timeout expires. Follows the same load path as the REPL, including
+ * reusing repl_buffer and its free-on-done handling. Used by the bench
+ * terminal command; not for use from lisp itself or from the eval
+ * task.
+ */
+bool lispif_eval_sync(const char *code, uint32_t timeout_ms) {
+	if (!lisp_thd_running) {
+		return false;
+	}
+
+	lispif_lock_lbm();
+
+	if (repl_buffer || sync_cid >= 0) {
+		lispif_unlock_lbm();
+		return false;
+	}
+
+	if (sync_done_sem == NULL) {
+		sync_done_sem = xSemaphoreCreateBinary();
+	}
+
+	bool started = false;
+
+	if (pause_eval(30, 1000)) {
+		repl_buffer = lbm_malloc_reserve(strlen(code) + 1);
+		if (repl_buffer) {
+			strcpy(repl_buffer, code);
+			lbm_create_string_char_channel(&string_tok_state, &string_tok, repl_buffer);
+			lbm_cid cid = lbm_load_and_eval_expression(&string_tok);
+			repl_cid_for_buffer = cid;
+			if (cid >= 0) {
+				sync_cid = cid;
+				started = true;
+			}
+		}
+		lbm_continue_eval();
+	}
+
+	lispif_unlock_lbm();
+
+	if (!started) {
+		return false;
+	}
+
+	if (xSemaphoreTake(sync_done_sem, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+		// Context still running; sync_cid clears itself when it
+		// eventually finishes.
+		return false;
+	}
+
+	return true;
+}
+
 void lispif_stop(void) {
 	if (!lisp_thd_running) {
 		return;
@@ -755,6 +963,65 @@ void lispif_stop(void) {
 	lispif_unlock_lbm();
 }
 
+typedef struct {
+	const unsigned char *data;
+	unsigned int len;
+} code_read_state;
+
+static unsigned int code_read_cb(void *udata, unsigned int offset) {
+	code_read_state *st = (code_read_state*)udata;
+	if (offset < st->len) {
+		return st->data[offset];
+	}
+	return 0x100;
+}
+
+// Inflate the first entry of the stored zip archive into a fresh
+// buffer. Returns 0 and leaves len_out untouched on failure.
+static char *decompress_code(const char *stored, int32_t stored_len, int32_t *len_out) {
+	lowzip_state st;
+	memset(&st, 0, sizeof(st));
+
+	code_read_state rd;
+	rd.data = (const unsigned char*)stored;
+	rd.len = stored_len;
+
+	st.udata = &rd;
+	st.read_callback = code_read_cb;
+	st.zip_length = stored_len;
+
+	lowzip_init_archive(&st);
+	if (st.have_error) {
+		return 0;
+	}
+
+	lowzip_file *fileinfo = lowzip_locate_file(&st, 0, NULL);
+	if (!fileinfo) {
+		return 0;
+	}
+
+	char *buf = malloc(fileinfo->uncompressed_size + 1);
+	if (!buf) {
+		return 0;
+	}
+
+	st.output_start = (unsigned char*)buf;
+	st.output_end = st.output_start + fileinfo->uncompressed_size;
+	st.output_next = st.output_start;
+
+	lowzip_get_data(&st);
+
+	if (st.have_error) {
+		free(buf);
+		return 0;
+	}
+
+	// Safety terminator; the source has its own before any import table.
+	buf[fileinfo->uncompressed_size] = '\0';
+	*len_out = fileinfo->uncompressed_size;
+	return buf;
+}
+
 bool lispif_restart(bool print, bool load_code, bool load_imports) {
 	bool res = false;
 
@@ -780,6 +1047,23 @@ bool lispif_restart(bool print, bool load_code, bool load_imports) {
 			lbm_image_save_constant_heap_ix();
 		}
 
+		if (code_decomp_buf) {
+			free(code_decomp_buf);
+			code_decomp_buf = 0;
+		}
+		code_decomp_pinned = false;
+		load_cid = -1;
+
+		if (code_data && code_len > 0 &&
+				(flash_helper_code_flags(CODE_IND_LISP) & CODE_FLAG_COMPRESSED)) {
+			code_decomp_buf = decompress_code(code_data, code_len, &code_len);
+			if (!code_decomp_buf) {
+				commands_printf_lisp("Could not inflate compressed code");
+				return false;
+			}
+			code_data = code_decomp_buf;
+		}
+
 		int code_chars = 0;
 		if (code_data) {
 			code_chars = strnlen(code_data, code_len);
@@ -787,12 +1071,20 @@ bool lispif_restart(bool print, bool load_code, bool load_imports) {
 			code_data = (char*)flash_helper_code_data_raw(CODE_IND_LISP);
 		}
 
+		// The image is placed in flash after the stored blob, which for
+		// compressed code is smaller than what the tokenizer sees.
+		char *code_flash = (char*)flash_helper_code_data_ptr(CODE_IND_LISP);
+		if (!code_flash) {
+			code_flash = (char*)flash_helper_code_data_raw(CODE_IND_LISP);
+		}
+		int32_t code_flash_len = flash_helper_code_size(CODE_IND_LISP);
+
 		bool new_image_created = false;
 		image_max_ind = 0;
-		image_ptr = (lbm_uint*)(code_data + code_len + 32);
+		image_ptr = (lbm_uint*)(code_flash + code_flash_len + 32);
 		image_ptr = (lbm_uint*)((uint32_t)image_ptr & 0xFFFFFFF0);
-		if ((((uint32_t)code_data + flash_helper_code_size_raw(CODE_IND_LISP))) > (uint32_t)image_ptr) {
-			uint32_t image_len = ((uint32_t)code_data + flash_helper_code_size_raw(CODE_IND_LISP)) - (uint32_t)image_ptr;
+		if ((((uint32_t)code_flash + flash_helper_code_size_raw(CODE_IND_LISP))) > (uint32_t)image_ptr) {
+			uint32_t image_len = ((uint32_t)code_flash + flash_helper_code_size_raw(CODE_IND_LISP)) - (uint32_t)image_ptr;
 			image_len /= sizeof(lbm_uint);
 			image_len &= 0xFFFFFFF0;
 
@@ -807,24 +1099,50 @@ bool lispif_restart(bool print, bool load_code, bool load_imports) {
 			lbm_set_printf_callback(commands_printf_lisp);
 			lbm_set_ctx_done_callback(done_callback);
 
+			// The print buffers here are 128 bytes, so nothing deeper or
+			// longer than this survives anyway; the limits keep large
+			// nested structures from stalling the evaluator first.
+			lbm_print_set_limits(10, 64);
+
+			// Fold constant arithmetic once at load time so control
+			// loops do not recompute it every iteration.
+			lbm_set_const_fold(true);
+
 			lbm_image_init((uint32_t*)image_ptr, image_len, image_write);
 
 			const esp_partition_t *running = esp_ota_get_running_partition();
 			esp_app_desc_t running_app_info;
 			esp_ota_get_partition_description(running, &running_app_info);
-			char ver_str[20];
-			sprintf(ver_str, "%02X%02X%02X%02X%02X%02X%02X%02X",
+
+			// The image version ties the snapshot to both the firmware
+			// build and the exact code blob it was parsed from. A new
+			// upload changes the CRC and invalidates the old snapshot,
+			// so the first start after a store parses once and every
+			// restart after that restores the snapshot memory-mapped,
+			// without re-tokenizing. This also keeps a stale snapshot
+			// from a previous script from being restored now that the
+			// store path no longer erases the whole partition up front.
+			uint16_t code_crc = 0;
+			if (code_flash && code_flash_len > 0) {
+				code_crc = crc16((unsigned char*)code_flash, code_flash_len);
+			}
+
+			char ver_str[28];
+			sprintf(ver_str, "%02X%02X%02X%02X%02X%02X%02X%02X-%04X",
 				running_app_info.app_elf_sha256[0], running_app_info.app_elf_sha256[1], running_app_info.app_elf_sha256[2], running_app_info.app_elf_sha256[3],
-				running_app_info.app_elf_sha256[4], running_app_info.app_elf_sha256[5], running_app_info.app_elf_sha256[6], running_app_info.app_elf_sha256[7]);
+				running_app_info.app_elf_sha256[4], running_app_info.app_elf_sha256[5], running_app_info.app_elf_sha256[6], running_app_info.app_elf_sha256[7],
+				code_crc);
 
 			bool load_imports_before = load_imports;
 			load_imports = false;
 
 			if (!lbm_image_exists() || strcmp(lbm_image_get_version(), ver_str) != 0) {
 				commands_printf_lisp("Preparing new image...");
-				for (uint32_t i = 0; i < image_len;i++) {
-					image_write(0xffffffff, i, true);
-				}
+				// Clear the image area sector-wise. Going through
+				// image_write here would cost one sector
+				// read-modify-write per stale word.
+				flash_helper_erase_from(CODE_IND_LISP,
+						(uint32_t)image_ptr - (uint32_t)flash_helper_code_data_raw(CODE_IND_LISP));
 				image_max_ind = 0;
 				lbm_image_create(ver_str);
 				load_imports = load_imports_before;
@@ -885,6 +1203,9 @@ bool lispif_restart(bool print, bool load_code, bool load_imports) {
 						lbm_value val;
 						if (lbm_share_array_const(&val, code_data + offset, len)) {
 							lbm_define(name, val);
+							if (code_data == code_decomp_buf) {
+								code_decomp_pinned = true;
+							}
 						}
 					}
 				}
@@ -904,6 +1225,7 @@ bool lispif_restart(bool print, bool load_code, bool load_imports) {
 
 			lbm_create_string_char_channel(&string_tok_state, &string_tok, code_data);
 			main_cid = lbm_load_and_eval_program_incremental(&string_tok, "main-u");
+			load_cid = main_cid;
 
 			// The first time a new image is created we save the const heap ptr after main exits. This makes
 			// it more likely to work with code using const blocks from before there were images. We do
@@ -37,7 +37,24 @@ void lispif_disable_all_events(void);
 void lispif_free(void *ptr);
 void lispif_process_cmd(unsigned char *data, unsigned int len,
 		void(*reply_func)(unsigned char *data, unsigned int len));
+bool lispif_eval_sync(const char *code, uint32_t timeout_ms);
+bool lispif_prof_start(void);
+bool lispif_prof_stop(void);
+int lispif_prof_dump_folded(char *buf, int buf_size);
 void lispif_process_can(uint32_t can_id, uint8_t *data8, int len, bool is_ext);
+
+// One tapped CAN frame in a batch delivered to event-can-batch.
+typedef struct {
+	uint32_t id;
+	uint8_t len;
+	bool ext;
+	uint8_t data[8];
+} can_frame_tap_t;
+
+bool lispif_can_batch_enabled(void);
+void lispif_process_can_batch(const can_frame_tap_t *frames, int cnt);
+void lispif_process_gnss(void);
+void lispif_process_stack_warn(const char *name, uint32_t stack_min_free);
 void lispif_process_custom_app_data(unsigned char *data, unsigned int len);
 void lispif_process_rmsg(int slot, unsigned char *data, unsigned int len);
 void lispif_add_ext_load_callback(void (*p_func)(bool));
@@ -1,17 +1,26 @@
 #include "stdbool.h"
 #include "lbm_types.h"
 #include "symrepr.h"
+#include "lispif_events.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // Idk if this is really the best way to handle this, but these variables need
 // to be available in different source files.
 
 volatile bool event_can_sid_en = false;
 volatile bool event_can_eid_en = false;
+volatile bool event_can_batch_en = false;
 volatile bool event_data_rx_en = false;
 volatile bool event_esp_now_rx_en = false;
 volatile bool event_ble_rx_en = false;
 volatile bool event_wifi_disconnect_en = false;
 volatile bool event_cmds_data_tx_en = false;
+volatile bool event_tcp_connect_en = false;
+volatile bool event_tcp_recv_en = false;
+volatile bool event_gnss_en = false;
+volatile bool event_stack_warn_en = false;
 
 volatile bool event_bms_bal_ovr_en = false;
 volatile bool event_bms_chg_allow_en = false;
@@ -21,11 +30,16 @@ volatile bool event_bms_zero_ofs_en = false;
 
 lbm_uint sym_event_can_sid = 0;
 lbm_uint sym_event_can_eid = 0;
+lbm_uint sym_event_can_batch = 0;
 lbm_uint sym_event_data_rx = 0;
 lbm_uint sym_event_esp_now_rx = 0;
 lbm_uint sym_event_ble_rx = 0;
 lbm_uint sym_event_wifi_disconnect = 0;
 lbm_uint sym_event_cmds_data_tx = 0;
+lbm_uint sym_event_tcp_connect = 0;
+lbm_uint sym_event_tcp_recv = 0;
+lbm_uint sym_event_gnss = 0;
+lbm_uint sym_event_stack_warn = 0;
 
 lbm_uint sym_bms_chg_allow = 0;
 lbm_uint sym_bms_bal_ovr = 0;
@@ -33,14 +47,118 @@ lbm_uint sym_bms_reset_cnt = 0;
 lbm_uint sym_bms_force_bal = 0;
 lbm_uint sym_bms_zero_ofs = 0;
 
+// Rate caps as minimum tick intervals. 0 means uncapped. Each slot has
+// a single conceptual writer per field (producers bump last/dropped,
+// the config extension writes interval), so plain volatiles suffice.
+static volatile uint32_t rate_interval_ticks[EVENT_RATE_NUM] = {0};
+static volatile uint32_t rate_last_tick[EVENT_RATE_NUM] = {0};
+static volatile uint32_t rate_dropped[EVENT_RATE_NUM] = {0};
+
+// CAN id filters, index 0 for standard ids and 1 for extended ids.
+// Checked by the producers before the flat value is built, so a
+// filtered-out frame costs two comparisons instead of an allocation
+// plus an evaluator wakeup in the script that would discard it anyway.
+typedef struct {
+	volatile bool en;
+	volatile uint32_t mask;
+	volatile uint32_t match;
+	volatile uint32_t id_min;
+	volatile uint32_t id_max;
+} can_id_filter;
+
+static can_id_filter can_filters[2] = {0};
+
+void lispif_events_set_rate(event_rate_slot_t slot, float max_hz) {
+	if (slot < 0 || slot >= EVENT_RATE_NUM) {
+		return;
+	}
+
+	if (max_hz <= 0.0) {
+		rate_interval_ticks[slot] = 0;
+	} else {
+		uint32_t interval = (uint32_t)((float)configTICK_RATE_HZ / max_hz);
+		rate_interval_ticks[slot] = interval < 1 ? 1 : interval;
+	}
+
+	rate_dropped[slot] = 0;
+}
+
+bool lispif_events_allow(event_rate_slot_t slot) {
+	if (slot < 0 || slot >= EVENT_RATE_NUM) {
+		return true;
+	}
+
+	uint32_t interval = rate_interval_ticks[slot];
+	if (interval == 0) {
+		return true;
+	}
+
+	uint32_t now = xTaskGetTickCount();
+	if ((now - rate_last_tick[slot]) >= interval) {
+		rate_last_tick[slot] = now;
+		return true;
+	}
+
+	rate_dropped[slot]++;
+	return false;
+}
+
+uint32_t lispif_events_dropped(event_rate_slot_t slot) {
+	if (slot < 0 || slot >= EVENT_RATE_NUM) {
+		return 0;
+	}
+
+	return rate_dropped[slot];
+}
+
+void lispif_events_reset_rates(void) {
+	for (int i = 0;i < EVENT_RATE_NUM;i++) {
+		rate_interval_ticks[i] = 0;
+		rate_dropped[i] = 0;
+	}
+
+	for (int i = 0;i < 2;i++) {
+		can_filters[i].en = false;
+	}
+}
+
+void lispif_events_set_can_filter(bool is_ext, uint32_t mask, uint32_t match,
+		uint32_t id_min, uint32_t id_max) {
+	can_id_filter *f = &can_filters[is_ext ? 1 : 0];
+	f->en = false; // Keep the producers away while the fields change.
+	f->mask = mask;
+	f->match = match;
+	f->id_min = id_min;
+	f->id_max = id_max;
+	f->en = true;
+}
+
+void lispif_events_clear_can_filter(bool is_ext) {
+	can_filters[is_ext ? 1 : 0].en = false;
+}
+
+bool lispif_events_can_id_allowed(uint32_t id, bool is_ext) {
+	can_id_filter *f = &can_filters[is_ext ? 1 : 0];
+	if (!f->en) {
+		return true;
+	}
+
+	return (id & f->mask) == f->match && id >= f->id_min && id <= f->id_max;
+}
+
 void lispif_events_load_symbols() {
     lbm_add_symbol_const("event-can-sid", &sym_event_can_sid);
 	lbm_add_symbol_const("event-can-eid", &sym_event_can_eid);
+	lbm_add_symbol_const("event-can-batch", &sym_event_can_batch);
 	lbm_add_symbol_const("event-data-rx", &sym_event_data_rx);
 	lbm_add_symbol_const("event-esp-now-rx", &sym_event_esp_now_rx);
 	lbm_add_symbol_const("event-ble-rx", &sym_event_ble_rx);
 	lbm_add_symbol_const("event-wifi-disconnect", &sym_event_wifi_disconnect);
 	lbm_add_symbol_const("event-cmds-data-tx", &sym_event_cmds_data_tx);
+	lbm_add_symbol_const("event-tcp-connect", &sym_event_tcp_connect);
+	lbm_add_symbol_const("event-tcp-recv", &sym_event_tcp_recv);
+	lbm_add_symbol_const("event-gnss", &sym_event_gnss);
+	lbm_add_symbol_const("event-stack-warn", &sym_event_stack_warn);
 
 	lbm_add_symbol_const("event-bms-chg-allow", &sym_bms_chg_allow);
 	lbm_add_symbol_const("event-bms-bal-ovr", &sym_bms_bal_ovr);
@@ -3,11 +3,16 @@
 
 extern volatile bool event_can_sid_en;
 extern volatile bool event_can_eid_en;
+extern volatile bool event_can_batch_en;
 extern volatile bool event_data_rx_en;
 extern volatile bool event_esp_now_rx_en;
 extern volatile bool event_ble_rx_en;
 extern volatile bool event_wifi_disconnect_en;
 extern volatile bool event_cmds_data_tx_en;
+extern volatile bool event_tcp_connect_en;
+extern volatile bool event_tcp_recv_en;
+extern volatile bool event_gnss_en;
+extern volatile bool event_stack_warn_en;
 
 extern volatile bool event_bms_bal_ovr_en;
 extern volatile bool event_bms_chg_allow_en;
@@ -17,11 +22,16 @@ extern volatile bool event_bms_zero_ofs_en;
 
 extern lbm_uint sym_event_can_sid;
 extern lbm_uint sym_event_can_eid;
+extern lbm_uint sym_event_can_batch;
 extern lbm_uint sym_event_data_rx;
 extern lbm_uint sym_event_esp_now_rx;
 extern lbm_uint sym_event_ble_rx;
 extern lbm_uint sym_event_wifi_disconnect;
 extern lbm_uint sym_event_cmds_data_tx;
+extern lbm_uint sym_event_tcp_connect;
+extern lbm_uint sym_event_tcp_recv;
+extern lbm_uint sym_event_gnss;
+extern lbm_uint sym_event_stack_warn;
 
 extern lbm_uint sym_bms_chg_allow;
 extern lbm_uint sym_bms_bal_ovr;
@@ -29,4 +39,36 @@ extern lbm_uint sym_bms_reset_cnt;
 extern lbm_uint sym_bms_force_bal;
 extern lbm_uint sym_bms_zero_ofs;
 
+/*
+ * Per-event-type rate caps. A cap of 0 (the default) delivers every
+ * event. With a cap set, events past the budget within the interval are
+ * dropped and counted; sources that regenerate their state (gnss, CAN
+ * status) effectively degrade to keep-latest at the cap rate, while
+ * stream sources shed load instead of flooding the evaluator queue.
+ */
+typedef enum {
+	EVENT_RATE_CAN = 0,
+	EVENT_RATE_DATA_RX,
+	EVENT_RATE_ESP_NOW_RX,
+	EVENT_RATE_BLE_RX,
+	EVENT_RATE_GNSS,
+	EVENT_RATE_NUM,
+} event_rate_slot_t;
+
+void lispif_events_set_rate(event_rate_slot_t slot, float max_hz);
+bool lispif_events_allow(event_rate_slot_t slot);
+uint32_t lispif_events_dropped(event_rate_slot_t slot);
+void lispif_events_reset_rates(void);
+
+/*
+ * CAN id filters for event delivery, evaluated in the producers before
+ * any flat value is built. A frame passes when (id & mask) == match and
+ * id is within [id_min, id_max]. Filters only affect events; blocking
+ * can-recv-sid/eid readers always get the next frame.
+ */
+void lispif_events_set_can_filter(bool is_ext, uint32_t mask, uint32_t match,
+		uint32_t id_min, uint32_t id_max);
+void lispif_events_clear_can_filter(bool is_ext);
+bool lispif_events_can_id_allowed(uint32_t id, bool is_ext);
+
 void lispif_events_load_symbols();
\ No newline at end of file
@@ -56,6 +56,7 @@
 #include "crc.h"
 #include "bms.h"
 #include "nmea.h"
+#include "odometry.h"
 #include "ublox.h"
 #include "log_comm.h"
 #include "comm_wifi.h"
@@ -66,6 +67,7 @@
 #include "comm_ble.h"
 #include "lbm_image.h"
 #include "packet.h"
+#include "ieee802154_c6.h"
 
 #include "esp_netif.h"
 #include "esp_wifi.h"
@@ -364,22 +366,22 @@ static bool compare_symbol(lbm_uint sym, lbm_uint *comp) {
 	return *comp == sym;
 }
 
+static void flat_buffer_free(uint8_t *buf) {
+	mempools_free_any(buf);
+}
+
 static bool start_flatten_with_gc(lbm_flat_value_t *v, size_t buffer_size) {
 	if (lispif_is_eval_task()) {
 		return lbm_start_flatten(v, buffer_size);
 	}
 
-	if (lbm_start_flatten(v, buffer_size)) {
-		return true;
-	}
-
-	int timeout = 3;
-	uint32_t gc_last = lbm_heap_state.gc_num;
-	lbm_request_gc();
-
-	while (lbm_heap_state.gc_num <= gc_last && timeout > 0) {
-		vTaskDelay(1);
-		timeout--;
+	// Event payloads from other tasks are flattened straight into a
+	// pooled buffer, so they do not compete with the evaluator for lbm
+	// memory and do not have to wait for GC when it is full. The event
+	// processor returns the buffer through flat_buffer_free.
+	uint8_t *buf = mempools_alloc_any(buffer_size);
+	if (buf) {
+		return lbm_start_flatten_buffer(v, buf, buffer_size);
 	}
 
 	return lbm_start_flatten(v, buffer_size);
@@ -836,6 +838,42 @@ static lbm_value ext_get_adc(lbm_value *args, lbm_uint argn) {
 	}
 }
 
+// (hw-sampler-start [rate-hz]) starts the background ADC sampler;
+// (get-adc-cached ch) then returns the filtered cached value without
+// triggering a conversion.
+static lbm_value ext_hw_sampler_start(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_NUMBER_ALL();
+
+	int rate_hz = 100;
+	if (argn >= 1) {
+		rate_hz = lbm_dec_as_i32(args[0]);
+	}
+
+	hw_sampler_start(rate_hz);
+	return ENC_SYM_TRUE;
+}
+
+static lbm_value ext_hw_sampler_stop(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	hw_sampler_stop();
+	return ENC_SYM_TRUE;
+}
+
+static lbm_value ext_get_adc_cached(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_NUMBER_ALL();
+
+	int channel = 0;
+	if (argn >= 1) {
+		channel = lbm_dec_as_i32(args[0]);
+	}
+
+	if (channel < 0 || channel >= HW_SAMPLER_CH_NUM) {
+		return ENC_SYM_EERROR;
+	}
+
+	return lbm_enc_float(hw_sampler_get_voltage(channel));
+}
+
 static lbm_value ext_systime(lbm_value *args, lbm_uint argn) {
 	(void)args; (void)argn;
 	return lbm_enc_u32(xTaskGetTickCount());
@@ -984,6 +1022,137 @@ static lbm_value ext_recv_data(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+/*
+ * Inter-context mailboxes. Each mailbox is a small ring of flattened
+ * values, so producer and consumer scripts hand off data in one
+ * operation instead of polling shared globals. A receiver blocked on
+ * an empty mailbox is woken directly from the send with the message as
+ * result, using the same unblock path as the other blocking
+ * extensions. One waiter per mailbox; a second recv on the same empty
+ * mailbox replaces the first waiter. Extensions only run on the eval
+ * thread, so no locking is needed around the ring state.
+ */
+
+#define MBOX_NUM		8
+#define MBOX_SLOTS		8
+
+typedef struct {
+	lbm_flat_value_t slots[MBOX_SLOTS];
+	int first;
+	int cnt;
+	volatile lbm_cid wait_cid;
+} mbox_state;
+
+static mbox_state mboxes[MBOX_NUM] = {0};
+
+static void mbox_reset_all(void) {
+	// Queued flat buffers live in lbm memory, which does not survive a
+	// restart, so the slots are dropped without freeing.
+	memset(mboxes, 0, sizeof(mboxes));
+	for (int i = 0;i < MBOX_NUM;i++) {
+		mboxes[i].wait_cid = -1;
+	}
+}
+
+static lbm_value ext_mbox_send(lbm_value *args, lbm_uint argn) {
+	if (argn != 2 || !lbm_is_number(args[0])) {
+		return ENC_SYM_TERROR;
+	}
+
+	int box = lbm_dec_as_i32(args[0]);
+	if (box < 0 || box >= MBOX_NUM) {
+		lbm_set_error_reason((char*)lbm_error_str_incorrect_arg);
+		return ENC_SYM_EERROR;
+	}
+
+	mbox_state *m = &mboxes[box];
+
+	int fv_size = flatten_value_size(args[1], false);
+	if (fv_size < 0) {
+		return ENC_SYM_EERROR;
+	}
+
+	lbm_flat_value_t fv;
+	if (!lbm_start_flatten(&fv, (size_t)fv_size)) {
+		return ENC_SYM_MERROR;
+	}
+
+	if (flatten_value_c(&fv, args[1]) != FLATTEN_VALUE_OK) {
+		lbm_free_flat_buffer(fv.buf);
+		return ENC_SYM_EERROR;
+	}
+
+	lbm_finish_flatten(&fv);
+
+	if (m->wait_cid >= 0) {
+		lbm_cid cid = m->wait_cid;
+		m->wait_cid = -1;
+		if (lbm_unblock_ctx(cid, &fv)) {
+			return ENC_SYM_TRUE;
+		}
+		// The waiter timed out in the meantime, fall through and queue.
+	}
+
+	if (m->cnt >= MBOX_SLOTS) {
+		lbm_free_flat_buffer(fv.buf);
+		return ENC_SYM_NIL;
+	}
+
+	m->slots[(m->first + m->cnt) % MBOX_SLOTS] = fv;
+	m->cnt++;
+
+	return ENC_SYM_TRUE;
+}
+
+static lbm_value ext_mbox_recv(lbm_value *args, lbm_uint argn) {
+	if ((argn != 1 && argn != 2) || !lbm_is_number(args[0]) ||
+			(argn == 2 && !lbm_is_number(args[1]))) {
+		return ENC_SYM_TERROR;
+	}
+
+	int box = lbm_dec_as_i32(args[0]);
+	if (box < 0 || box >= MBOX_NUM) {
+		lbm_set_error_reason((char*)lbm_error_str_incorrect_arg);
+		return ENC_SYM_EERROR;
+	}
+
+	mbox_state *m = &mboxes[box];
+
+	if (m->cnt > 0) {
+		lbm_flat_value_t fv = m->slots[m->first];
+		fv.buf_pos = 0;
+
+		lbm_value res = ENC_SYM_NIL;
+		bool ok = lbm_unflatten_value(&fv, &res);
+
+		// On merror the message is left queued; the evaluator runs GC
+		// and retries the call. Malformed entries are dropped as well
+		// so the mailbox cannot wedge.
+		if (ok || res != ENC_SYM_MERROR) {
+			lbm_free_flat_buffer(fv.buf);
+			m->first = (m->first + 1) % MBOX_SLOTS;
+			m->cnt--;
+		}
+
+		return res;
+	}
+
+	m->wait_cid = lbm_get_current_cid();
+
+	float timeout = -1.0;
+	if (argn == 2) {
+		timeout = lbm_dec_as_float(args[1]);
+	}
+
+	if (timeout > 0.0) {
+		lbm_block_ctx_from_extension_timeout(timeout);
+	} else {
+		lbm_block_ctx_from_extension();
+	}
+
+	return ENC_SYM_TRUE;
+}
+
 typedef union {
 	uint32_t as_u32;
 	int32_t as_i32;
@@ -1414,6 +1583,57 @@ static lbm_value ext_can_get_adc(lbm_value *args, lbm_uint argn) {
 	}
 }
 
+// (can-get-status id) returns every cached status field of a node in
+// one call: (rpm current duty ah ah-chg wh wh-chg temp-fet temp-motor
+// current-in pid-pos v-in tacho adc1 adc2 adc3 ppm age). Fields whose
+// status message has not been received read as 0 and age is the
+// oldest rx age of the messages present, so a dashboard polls one
+// extension call per node instead of one per field.
+static lbm_value ext_can_get_status(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN_NUMBER(1);
+
+	int id = lbm_dec_as_i32(args[0]);
+
+	can_status_msg *s1 = comm_can_get_status_msg_id(id);
+	can_status_msg_2 *s2 = comm_can_get_status_msg_2_id(id);
+	can_status_msg_3 *s3 = comm_can_get_status_msg_3_id(id);
+	can_status_msg_4 *s4 = comm_can_get_status_msg_4_id(id);
+	can_status_msg_5 *s5 = comm_can_get_status_msg_5_id(id);
+	can_status_msg_6 *s6 = comm_can_get_status_msg_6_id(id);
+
+	if (!s1 && !s2 && !s3 && !s4 && !s5 && !s6) {
+		return ENC_SYM_NIL;
+	}
+
+	float age = -1.0;
+	if (s1) age = UTILS_AGE_S(s1->rx_time);
+	if (s2 && UTILS_AGE_S(s2->rx_time) > age) age = UTILS_AGE_S(s2->rx_time);
+	if (s3 && UTILS_AGE_S(s3->rx_time) > age) age = UTILS_AGE_S(s3->rx_time);
+	if (s4 && UTILS_AGE_S(s4->rx_time) > age) age = UTILS_AGE_S(s4->rx_time);
+	if (s5 && UTILS_AGE_S(s5->rx_time) > age) age = UTILS_AGE_S(s5->rx_time);
+	if (s6 && UTILS_AGE_S(s6->rx_time) > age) age = UTILS_AGE_S(s6->rx_time);
+
+	return lbm_heap_allocate_list_init(18,
+			lbm_enc_float(s1 ? s1->rpm : 0.0),
+			lbm_enc_float(s1 ? s1->current : 0.0),
+			lbm_enc_float(s1 ? s1->duty : 0.0),
+			lbm_enc_float(s2 ? s2->amp_hours : 0.0),
+			lbm_enc_float(s2 ? s2->amp_hours_charged : 0.0),
+			lbm_enc_float(s3 ? s3->watt_hours : 0.0),
+			lbm_enc_float(s3 ? s3->watt_hours_charged : 0.0),
+			lbm_enc_float(s4 ? s4->temp_fet : 0.0),
+			lbm_enc_float(s4 ? s4->temp_motor : 0.0),
+			lbm_enc_float(s4 ? s4->current_in : 0.0),
+			lbm_enc_float(s4 ? s4->pid_pos_now : 0.0),
+			lbm_enc_float(s5 ? s5->v_in : 0.0),
+			lbm_enc_i(s5 ? s5->tacho_value : 0),
+			lbm_enc_float(s6 ? s6->adc_1 : 0.0),
+			lbm_enc_float(s6 ? s6->adc_2 : 0.0),
+			lbm_enc_float(s6 ? s6->adc_3 : 0.0),
+			lbm_enc_float(s6 ? s6->ppm : 0.0),
+			lbm_enc_float(age));
+}
+
 static lbm_value ext_can_get_vin(lbm_value *args, lbm_uint argn) {
 	LBM_CHECK_ARGN_NUMBER(1);
 	can_status_msg_5 *stat5 = comm_can_get_status_msg_5_id(lbm_dec_as_i32(args[0]));
@@ -1488,6 +1708,27 @@ static lbm_value ext_can_update_baud(lbm_value *args, lbm_uint argn) {
 	}
 }
 
+static lbm_value ext_can_probe_baud(lbm_value *args, lbm_uint argn) {
+	if (argn > 1) {
+		lbm_set_error_reason((char*)lbm_error_str_num_args);
+		return ENC_SYM_TERROR;
+	}
+
+	LBM_CHECK_NUMBER_ALL();
+
+	int probe_ms = 100;
+	if (argn == 1) {
+		probe_ms = lbm_dec_as_i32(args[0]);
+	}
+
+	CAN_BAUD baud = comm_can_probe_baud(probe_ms);
+	if (baud == CAN_BAUD_INVALID) {
+		return ENC_SYM_NIL;
+	}
+
+	return lbm_enc_i(comm_can_baud_to_kbits(baud));
+}
+
 static lbm_value ext_can_start(lbm_value *args, lbm_uint argn) {
 	if (argn > 2) {
 		lbm_set_error_reason((char*)lbm_error_str_num_args);
@@ -1530,6 +1771,30 @@ static lbm_value ext_can_stop(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+static lbm_value ext_can_filter(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN_NUMBER(2);
+	comm_can_set_filter(lbm_dec_as_u32(args[0]), lbm_dec_as_u32(args[1]));
+	return ENC_SYM_TRUE;
+}
+
+static lbm_value ext_can_filter_local(lbm_value *args, lbm_uint argn) {
+	if (argn > 1) {
+		lbm_set_error_reason((char*)lbm_error_str_num_args);
+		return ENC_SYM_TERROR;
+	}
+
+	bool accept_broadcast = true;
+	if (argn == 1) {
+		if (!is_symbol_true_false(args[0])) {
+			return ENC_SYM_TERROR;
+		}
+		accept_broadcast = lbm_is_symbol_true(args[0]);
+	}
+
+	comm_can_filter_local(backup.config.controller_id, accept_broadcast);
+	return ENC_SYM_TRUE;
+}
+
 static lbm_value ext_can_use_vesc(lbm_value *args, lbm_uint argn) {
 	LBM_CHECK_ARGN(1);
 
@@ -1621,6 +1886,126 @@ static lbm_value ext_can_send_eid(lbm_value *args, lbm_uint argn) {
 	return ext_can_send(args, argn, true);
 }
 
+// Frames per comm_can_transmit_batch submission. Longer bursts are
+// flushed in chunks so the stack frame stays small.
+#define CAN_SEND_BATCH_CHUNK		16
+
+static lbm_value ext_can_send_batch(lbm_value *args, lbm_uint argn) {
+	if (argn != 1 && argn != 2) {
+		lbm_set_error_reason((char*)lbm_error_str_num_args);
+		return ENC_SYM_TERROR;
+	}
+
+	bool is_eid = true;
+	if (argn == 2) {
+		is_eid = !lbm_is_symbol_nil(args[1]);
+	}
+
+	can_batch_frame_t frames[CAN_SEND_BATCH_CHUNK];
+	int num = 0;
+
+	lbm_value curr = args[0];
+	while (lbm_is_cons(curr)) {
+		lbm_value rec = lbm_car(curr);
+
+		if (!lbm_is_cons(rec) || !lbm_is_number(lbm_car(rec))) {
+			return ENC_SYM_TERROR;
+		}
+
+		can_batch_frame_t *fr = &frames[num];
+		fr->id = lbm_dec_as_u32(lbm_car(rec));
+		fr->ext = is_eid;
+		fr->len = 0;
+
+		// Accept both (id . data) pairs and (id data) lists with the
+		// data as a byte array or a list of numbers.
+		lbm_value data = lbm_cdr(rec);
+		if (lbm_is_cons(data) && !lbm_is_number(lbm_car(data))) {
+			data = lbm_car(data);
+		}
+
+		if (lbm_is_array_r(data)) {
+			lbm_array_header_t *array = (lbm_array_header_t*)lbm_car(data);
+			int len = array->size;
+			if (len > 8) {
+				len = 8;
+			}
+			memcpy(fr->data, array->data, len);
+			fr->len = len;
+		} else {
+			while (lbm_is_cons(data) && fr->len < 8) {
+				lbm_value b = lbm_car(data);
+				if (!lbm_is_number(b)) {
+					return ENC_SYM_TERROR;
+				}
+				fr->data[fr->len++] = lbm_dec_as_u32(b);
+				data = lbm_cdr(data);
+			}
+		}
+
+		num++;
+		if (num == CAN_SEND_BATCH_CHUNK) {
+			comm_can_transmit_batch(frames, num);
+			num = 0;
+		}
+
+		curr = lbm_cdr(curr);
+	}
+
+	if (num > 0) {
+		comm_can_transmit_batch(frames, num);
+	}
+
+	return ENC_SYM_TRUE;
+}
+
+// Zero-copy views over stable C state. The returned arrays reference
+// the live backing structs directly, so a polling script reads fresh
+// data without per-access copies or allocations. Layouts follow the C
+// structs of the running build; the views are to be treated as
+// read-only.
+
+static lbm_value ext_view_can_status(lbm_value *args, lbm_uint argn) {
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("i|i", a);
+
+	int msg = a[1].i < 1 ? 1 : a[1].i;
+
+	void *ptr = NULL;
+	lbm_uint size = 0;
+
+	switch (msg) {
+	case 1: ptr = comm_can_get_status_msg_index(a[0].i); size = sizeof(can_status_msg); break;
+	case 2: ptr = comm_can_get_status_msg_2_index(a[0].i); size = sizeof(can_status_msg_2); break;
+	case 3: ptr = comm_can_get_status_msg_3_index(a[0].i); size = sizeof(can_status_msg_3); break;
+	case 4: ptr = comm_can_get_status_msg_4_index(a[0].i); size = sizeof(can_status_msg_4); break;
+	case 5: ptr = comm_can_get_status_msg_5_index(a[0].i); size = sizeof(can_status_msg_5); break;
+	default: return ENC_SYM_TERROR;
+	}
+
+	if (ptr == NULL) {
+		return ENC_SYM_NIL;
+	}
+
+	lbm_value res;
+	if (!lbm_make_array_view(ptr, size, &res)) {
+		return ENC_SYM_MERROR;
+	}
+
+	return res;
+}
+
+static lbm_value ext_view_gnss(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+
+	lbm_value res;
+	if (!lbm_make_array_view(nmea_get_state(), sizeof(nmea_state_t), &res)) {
+		return ENC_SYM_MERROR;
+	}
+
+	return res;
+}
+
 static volatile lbm_cid can_recv_sid_cid = -1;
 static volatile lbm_cid can_recv_eid_cid = -1;
 
@@ -1666,73 +2051,77 @@ static lbm_value ext_can_recv_eid(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+// The CAN setters are the extensions the control loops hammer, so they
+// use the declarative arg-spec decoder: one shared validation pass
+// instead of per-extension lbm_is_number/lbm_dec_as_* chains.
+
 static lbm_value ext_can_current(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_NUMBER_ALL();
+	lbm_arg_t a[3];
+	LBM_DEC_ARGS("if|f", a);
 
-	if (argn == 2) {
-		comm_can_set_current(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
-	} else if (argn == 3) {
-		comm_can_set_current_off_delay(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]), lbm_dec_as_float(args[2]));
+	if (argn == 3) {
+		comm_can_set_current_off_delay(a[0].i, a[1].f, a[2].f);
 	} else {
-		return ENC_SYM_EERROR;
+		comm_can_set_current(a[0].i, a[1].f);
 	}
 
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_current_rel(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_NUMBER_ALL();
+	lbm_arg_t a[3];
+	LBM_DEC_ARGS("if|f", a);
 
-	if (argn == 2) {
-		comm_can_set_current_rel(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
-	} else if (argn == 3) {
-		comm_can_set_current_rel_off_delay(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]), lbm_dec_as_float(args[2]));
+	if (argn == 3) {
+		comm_can_set_current_rel_off_delay(a[0].i, a[1].f, a[2].f);
 	} else {
-		return ENC_SYM_EERROR;
+		comm_can_set_current_rel(a[0].i, a[1].f);
 	}
 
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_duty(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(2);
-	comm_can_set_duty(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("if", a);
+	comm_can_set_duty(a[0].i, a[1].f);
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_brake(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(2);
-	comm_can_set_current_brake(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("if", a);
+	comm_can_set_current_brake(a[0].i, a[1].f);
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_brake_rel(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(2);
-	comm_can_set_current_brake_rel(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("if", a);
+	comm_can_set_current_brake_rel(a[0].i, a[1].f);
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_rpm(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(2);
-	comm_can_set_rpm(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("if", a);
+	comm_can_set_rpm(a[0].i, a[1].f);
 	return ENC_SYM_TRUE;
 }
 
 static lbm_value ext_can_pos(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(2);
-	comm_can_set_pos(lbm_dec_as_i32(args[0]), lbm_dec_as_float(args[1]));
+	lbm_arg_t a[2];
+	LBM_DEC_ARGS("if", a);
+	comm_can_set_pos(a[0].i, a[1].f);
 	return ENC_SYM_TRUE;
 }
 
 // Math
 
 static lbm_value ext_throttle_curve(lbm_value *args, lbm_uint argn) {
-	LBM_CHECK_ARGN_NUMBER(4);
-	return lbm_enc_float(utils_throttle_curve(
-			lbm_dec_as_float(args[0]),
-			lbm_dec_as_float(args[1]),
-			lbm_dec_as_float(args[2]),
-			lbm_dec_as_i32(args[3])));
+	lbm_arg_t a[4];
+	LBM_DEC_ARGS("fffi", a);
+	return lbm_enc_float(utils_throttle_curve(a[0].f, a[1].f, a[2].f, a[3].i));
 }
 
 static lbm_value ext_rand(lbm_value *args, lbm_uint argn) {
@@ -1825,7 +2214,7 @@ static void bms_cmd_handler(COMM_PACKET_ID cmd, int param1, int param2) {
 				f_sym(&v, ENC_SYM_NIL);
 
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -1844,7 +2233,7 @@ static void bms_cmd_handler(COMM_PACKET_ID cmd, int param1, int param2) {
 				f_sym(&v, ENC_SYM_NIL);
 
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -1863,7 +2252,7 @@ static void bms_cmd_handler(COMM_PACKET_ID cmd, int param1, int param2) {
 				f_sym(&v, ENC_SYM_NIL);
 
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -1880,7 +2269,7 @@ static void bms_cmd_handler(COMM_PACKET_ID cmd, int param1, int param2) {
 				f_sym(&v, ENC_SYM_NIL);
 
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -1893,7 +2282,7 @@ static void bms_cmd_handler(COMM_PACKET_ID cmd, int param1, int param2) {
 				f_sym(&v, sym_bms_zero_ofs);
 
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -1924,6 +2313,8 @@ static lbm_value ext_enable_event(lbm_value *args, lbm_uint argn) {
 		event_can_sid_en = en;
 	} else if (name == sym_event_can_eid) {
 		event_can_eid_en = en;
+	} else if (name == sym_event_can_batch) {
+		event_can_batch_en = en;
 	} else if (name == sym_event_data_rx) {
 		event_data_rx_en = en;
 	} else if (name == sym_event_esp_now_rx) {
@@ -1936,6 +2327,14 @@ static lbm_value ext_enable_event(lbm_value *args, lbm_uint argn) {
 		event_wifi_disconnect_en = en;
 	} else if (name == sym_event_cmds_data_tx) {
 		event_cmds_data_tx_en = en;
+	} else if (name == sym_event_tcp_connect) {
+		event_tcp_connect_en = en;
+	} else if (name == sym_event_tcp_recv) {
+		event_tcp_recv_en = en;
+	} else if (name == sym_event_gnss) {
+		event_gnss_en = en;
+	} else if (name == sym_event_stack_warn) {
+		event_stack_warn_en = en;
 	} else if (name == sym_bms_chg_allow) {
 		event_bms_chg_allow_en = en;
 	} else if (name == sym_bms_bal_ovr) {
@@ -1960,6 +2359,94 @@ static lbm_value ext_enable_event(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+// (event-rate 'event-sym max-hz) caps the delivery rate of an event
+// source; a rate of 0 removes the cap. (event-rate 'event-sym) returns
+// the number of events the cap has dropped. The three CAN event
+// symbols share one cap slot.
+static lbm_value ext_event_rate(lbm_value *args, lbm_uint argn) {
+	if ((argn != 1 && argn != 2) || !lbm_is_symbol(args[0])) {
+		return ENC_SYM_TERROR;
+	}
+
+	if (argn == 2 && !lbm_is_number(args[1])) {
+		return ENC_SYM_TERROR;
+	}
+
+	lbm_uint name = lbm_dec_sym(args[0]);
+	event_rate_slot_t slot;
+
+	if (name == sym_event_can_sid || name == sym_event_can_eid ||
+			name == sym_event_can_batch) {
+		slot = EVENT_RATE_CAN;
+	} else if (name == sym_event_data_rx) {
+		slot = EVENT_RATE_DATA_RX;
+	} else if (name == sym_event_esp_now_rx) {
+		slot = EVENT_RATE_ESP_NOW_RX;
+	} else if (name == sym_event_ble_rx) {
+		slot = EVENT_RATE_BLE_RX;
+	} else if (name == sym_event_gnss) {
+		slot = EVENT_RATE_GNSS;
+	} else {
+		return ENC_SYM_TERROR;
+	}
+
+	if (argn == 2) {
+		lispif_events_set_rate(slot, lbm_dec_as_float(args[1]));
+		return ENC_SYM_TRUE;
+	}
+
+	return lbm_enc_u32(lispif_events_dropped(slot));
+}
+
+// (event-can-filter 'event-can-sid/eid mask match opt-id-min opt-id-max)
+// installs a C-side id filter on CAN event delivery: a frame is passed
+// on when (id & mask) == match and id is within the optional range.
+// (event-can-filter 'event-can-sid/eid) removes the filter. The batch
+// event applies both filters frame by frame.
+static lbm_value ext_event_can_filter(lbm_value *args, lbm_uint argn) {
+	if (argn < 1 || !lbm_is_symbol(args[0])) {
+		return ENC_SYM_TERROR;
+	}
+
+	for (lbm_uint i = 1;i < argn;i++) {
+		if (!lbm_is_number(args[i])) {
+			return ENC_SYM_TERROR;
+		}
+	}
+
+	lbm_uint name = lbm_dec_sym(args[0]);
+	bool is_ext;
+	if (name == sym_event_can_sid) {
+		is_ext = false;
+	} else if (name == sym_event_can_eid) {
+		is_ext = true;
+	} else {
+		return ENC_SYM_TERROR;
+	}
+
+	if (argn == 1) {
+		lispif_events_clear_can_filter(is_ext);
+		return ENC_SYM_TRUE;
+	}
+
+	if (argn != 3 && argn != 5) {
+		lbm_set_error_reason((char*)lbm_error_str_num_args);
+		return ENC_SYM_EERROR;
+	}
+
+	uint32_t id_min = 0;
+	uint32_t id_max = 0xFFFFFFFF;
+	if (argn == 5) {
+		id_min = lbm_dec_as_u32(args[3]);
+		id_max = lbm_dec_as_u32(args[4]);
+	}
+
+	lispif_events_set_can_filter(is_ext,
+			lbm_dec_as_u32(args[1]), lbm_dec_as_u32(args[2]), id_min, id_max);
+
+	return ENC_SYM_TRUE;
+}
+
 static lbm_value ext_lbm_set_quota(lbm_value *args, lbm_uint argn) {
 	LBM_CHECK_ARGN_NUMBER(1);
 	uint32_t q = lbm_dec_as_u32(args[0]);
@@ -1977,6 +2464,28 @@ static lbm_value ext_lbm_set_quota(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+static lbm_value ext_lbm_set_quota_weight(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN_NUMBER(2);
+	lbm_cid cid = lbm_dec_as_i32(args[0]);
+	uint32_t weight = lbm_dec_as_u32(args[1]);
+
+	if (weight < 1 || weight > LBM_QUOTA_WEIGHT_MAX) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (lbm_set_ctx_quota_weight(cid, weight)) {
+		return ENC_SYM_TRUE;
+	}
+
+	return ENC_SYM_NIL;
+}
+
+static lbm_value ext_lbm_set_event_preempt(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN(1);
+	lbm_set_event_preempt(lbm_is_symbol_true(args[0]));
+	return ENC_SYM_TRUE;
+}
+
 lbm_value ext_lbm_set_gc_stack_size(lbm_value *args, lbm_uint argn) {
 	if (argn == 1) {
 		if (lbm_is_number(args[0])) {
@@ -2175,11 +2684,11 @@ static void esp_rx_fun(void *arg) {
 
 			if (esp_now_recv_cid >= 0) {
 				if (!lbm_unblock_ctx(esp_now_recv_cid, &v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			} else {
 				if (!lbm_event(&v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 				}
 			}
 		}
@@ -2194,6 +2703,10 @@ static void espnow_send_cb(const esp_now_send_info_t *tx_info, esp_now_send_stat
 
 static void espnow_recv_cb(const esp_now_recv_info_t *esp_now_info, const uint8_t *data, int data_len) {
 	if (event_esp_now_rx_en || esp_now_recv_cid >= 0) {
+		if (esp_now_recv_cid < 0 && !lispif_events_allow(EVENT_RATE_ESP_NOW_RX)) {
+			return;
+		}
+
 		esp_now_send_data sdata;
 
 		sdata.data = malloc(data_len);
@@ -2566,6 +3079,62 @@ static lbm_value ext_esp_now_recv(lbm_value *args, lbm_uint argn) {
 
 #endif // ENABLE_ESP_NOW
 
+#ifdef CONFIG_IDF_TARGET_ESP32C6
+// IEEE 802.15.4 raw frame fast path. TX goes straight to the radio
+// without CCA backoff and RX frames come out of the preallocated slot
+// ring with the arrival timestamp taken in the RX-done callback, so
+// scripts can do sub-millisecond inter-board signaling over 802.15.4.
+
+static lbm_value ext_ieee_tx(lbm_value *args, lbm_uint argn) {
+	if (argn != 2 || !lbm_is_number(args[0])) {
+		lbm_set_error_reason((char*)lbm_error_str_incorrect_arg);
+		return ENC_SYM_TERROR;
+	}
+
+	char *str = lbm_dec_str(args[1]);
+	if (!str) {
+		lbm_set_error_reason("Argument must be an array");
+		return ENC_SYM_TERROR;
+	}
+
+	lbm_array_header_t *array = (lbm_array_header_t *)lbm_car(args[1]);
+	bool res = ieee802154_send_frame_immediate(
+			(uint8_t*)str, array->size, lbm_dec_as_u32(args[0]));
+
+	return res ? ENC_SYM_TRUE : ENC_SYM_NIL;
+}
+
+// Returns nil when no frame is pending, otherwise
+// (timestamp-us rssi frame)
+static lbm_value ext_ieee_rx(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+
+	ieee802154_fast_frame_t frame;
+	if (!ieee802154_fast_rx_pop(&frame)) {
+		return ENC_SYM_NIL;
+	}
+
+	lbm_value data;
+	if (!lbm_heap_allocate_array(&data, frame.len)) {
+		return ENC_SYM_MERROR;
+	}
+
+	lbm_array_header_t *arr = (lbm_array_header_t*)lbm_car(data);
+	memcpy(arr->data, frame.data, frame.len);
+
+	lbm_value res = ENC_SYM_NIL;
+	res = lbm_cons(data, res);
+	res = lbm_cons(lbm_enc_i(frame.rssi), res);
+	res = lbm_cons(lbm_enc_i64(frame.timestamp_us), res);
+	return res;
+}
+
+static lbm_value ext_ieee_rx_dropped(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	return lbm_enc_u32(ieee802154_fast_rx_dropped());
+}
+#endif // CONFIG_IDF_TARGET_ESP32C6
+
 static bool i2c_started = false;
 static SemaphoreHandle_t i2c_mutex;
 static bool i2c_mutex_init_done = false;
@@ -3224,6 +3793,23 @@ static lbm_value ext_log_send_f64(lbm_value *args, lbm_uint argn) {
 	return log_send_fxx(true, args, argn);
 }
 
+// (log-set-batching max-bytes max-delay-ms)
+// Batch data packets into COMM_LOG_DATA_BATCH containers of up to
+// max-bytes (set from the transport MTU), flushed after at most
+// max-delay-ms. 0 bytes disables batching.
+static lbm_value ext_log_set_batching(lbm_value *args, lbm_uint argn) {
+	LBM_CHECK_ARGN_NUMBER(2);
+	log_comm_set_batching(lbm_dec_as_i32(args[0]), lbm_dec_as_i32(args[1]));
+	return ENC_SYM_TRUE;
+}
+
+// (log-flush)
+static lbm_value ext_log_flush(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	log_comm_flush();
+	return ENC_SYM_TRUE;
+}
+
 // GNSS
 
 static lbm_value ext_gnss_lat_lon(lbm_value *args, lbm_uint argn) {
@@ -3267,12 +3853,63 @@ static lbm_value ext_gnss_date_time(lbm_value *args, lbm_uint argn) {
 	lat_lon = lbm_cons(lbm_enc_i(s->rmc.mo), lat_lon);
 	lat_lon = lbm_cons(lbm_enc_i(s->rmc.yy), lat_lon);
 
-	return lat_lon;
+	return lat_lon;
+}
+
+static lbm_value ext_gnss_age(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	return lbm_enc_float(UTILS_AGE_S(nmea_get_state()->gga.update_time));
+}
+
+static lbm_value ext_gnss_epoch_ms(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+
+	// Precomputed per epoch by the decoder; no date math here.
+	nmea_derived_info_t der;
+	nmea_get_derived(&der);
+
+	return lbm_enc_i64(der.epoch_ms);
+}
+
+// Fused odometry
+
+static lbm_value ext_odom_start(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	return odometry_start() ? ENC_SYM_TRUE : ENC_SYM_NIL;
+}
+
+static lbm_value ext_odom_stop(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+	odometry_stop();
+	return ENC_SYM_TRUE;
+}
+
+static lbm_value ext_odom_pos(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+
+	odometry_state odom;
+	odometry_get(&odom);
+
+	lbm_value res = ENC_SYM_NIL;
+	res = lbm_cons(lbm_enc_float(odom.pos[2]), res);
+	res = lbm_cons(lbm_enc_float(odom.pos[1]), res);
+	res = lbm_cons(lbm_enc_float(odom.pos[0]), res);
+
+	return res;
 }
 
-static lbm_value ext_gnss_age(lbm_value *args, lbm_uint argn) {
+static lbm_value ext_odom_vel(lbm_value *args, lbm_uint argn) {
 	(void)args; (void)argn;
-	return lbm_enc_float(UTILS_AGE_S(nmea_get_state()->gga.update_time));
+
+	odometry_state odom;
+	odometry_get(&odom);
+
+	lbm_value res = ENC_SYM_NIL;
+	res = lbm_cons(lbm_enc_float(odom.vel[2]), res);
+	res = lbm_cons(lbm_enc_float(odom.vel[1]), res);
+	res = lbm_cons(lbm_enc_float(odom.vel[0]), res);
+
+	return res;
 }
 
 typedef struct {
@@ -3281,13 +3918,14 @@ typedef struct {
 	int num_uart;
 	int pin_rx;
 	int pin_tx;
+	bool ubx_only;
 } ublox_init_args;
 
 static void ublox_init_task(void *arg) {
 	int restart_cnt = lispif_get_restart_cnt();
 	ublox_init_args *a = (ublox_init_args*)arg;
 
-	bool res = ublox_init(false, a->rate_ms, a->num_uart, a->pin_rx, a->pin_tx);
+	bool res = ublox_init(false, a->rate_ms, a->num_uart, a->pin_rx, a->pin_tx, a->ubx_only);
 
 	if (restart_cnt == lispif_get_restart_cnt()) {
 		lbm_unblock_ctx_unboxed(a->id, res ? ENC_SYM_TRUE : ENC_SYM_NIL);
@@ -3297,12 +3935,17 @@ static void ublox_init_task(void *arg) {
 }
 
 static lbm_value ext_ublox_init(lbm_value *args, lbm_uint argn) {
-	if (argn > 4) {
+	if (argn > 5) {
 		lbm_set_error_reason((char*)lbm_error_str_incorrect_arg);
 		return ENC_SYM_TERROR;
 	}
 
-	LBM_CHECK_NUMBER_ALL();
+	for (lbm_uint i = 0;i < argn && i < 4;i++) {
+		if (!lbm_is_number(args[i])) {
+			lbm_set_error_reason((char*)lbm_error_str_no_number);
+			return ENC_SYM_TERROR;
+		}
+	}
 
 	uint16_t rate = 500;
 	if (argn >= 1) {
@@ -3324,6 +3967,16 @@ static lbm_value ext_ublox_init(lbm_value *args, lbm_uint argn) {
 		pin_tx = lbm_dec_as_i32(args[3]);
 	}
 
+	// UBX-only mode: binary NAV-PVT and NAV-DOP instead of NMEA, which
+	// supports rates down to 100 ms without saturating the serial link.
+	bool ubx_only = false;
+	if (argn >= 5) {
+		if (!is_symbol_true_false(args[4])) {
+			return ENC_SYM_TERROR;
+		}
+		ubx_only = lbm_is_symbol_true(args[4]);
+	}
+
 	if (!utils_gpio_is_valid(pin_rx) || !utils_gpio_is_valid(pin_tx)) {
 		lbm_set_error_reason(string_pin_invalid);
 		return ENC_SYM_EERROR;
@@ -3340,6 +3993,7 @@ static lbm_value ext_ublox_init(lbm_value *args, lbm_uint argn) {
 	a.num_uart = uart_num;
 	a.pin_rx = pin_rx;
 	a.pin_tx = pin_tx;
+	a.ubx_only = ubx_only;
 
 	xTaskCreatePinnedToCore(ublox_init_task, "Ublox Init", 2048, &a, 7, NULL, tskNO_AFFINITY);
 	lbm_block_ctx_from_extension();
@@ -4275,7 +4929,7 @@ static void fw_reply_func(unsigned char *data, unsigned int len) {
 			lbm_finish_flatten(&v);
 
 			if (!lbm_unblock_ctx(fw_rx_cid, &v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
 				lbm_unblock_ctx_unboxed(fw_rx_cid, ENC_SYM_EERROR);
 			}
 		}
@@ -4333,7 +4987,7 @@ static void fw_reply_func(unsigned char *data, unsigned int len) {
 				lbm_finish_flatten(&v);
 
 				if (!lbm_unblock_ctx(fw_rx_cid, &v)) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 					lbm_unblock_ctx_unboxed(fw_rx_cid, ENC_SYM_EERROR);
 				}
 			} else {
@@ -4909,6 +5563,37 @@ static lbm_value ext_as504x_angle(lbm_value *args, lbm_uint argn) {
 	return lbm_enc_float(enc_as504x_read_angle(&as504x));
 }
 
+static lbm_value ext_as504x_start_sampling(lbm_value *args, lbm_uint argn) {
+	if (!as504x_init_done) {
+		lbm_set_error_reason(str_as504x_not_init_msg);
+		return ENC_SYM_EERROR;
+	}
+
+	int rate = 1000;
+	if (argn == 1) {
+		if (!lbm_is_number(args[0])) {
+			return ENC_SYM_TERROR;
+		}
+		rate = lbm_dec_as_i32(args[0]);
+	} else if (argn != 0) {
+		return ENC_SYM_TERROR;
+	}
+
+	return enc_as504x_start_sampling(&as504x, rate) ? ENC_SYM_TRUE : ENC_SYM_NIL;
+}
+
+static lbm_value ext_as504x_stop_sampling(lbm_value *args, lbm_uint argn) {
+	(void)args; (void)argn;
+
+	if (!as504x_init_done) {
+		lbm_set_error_reason(str_as504x_not_init_msg);
+		return ENC_SYM_EERROR;
+	}
+
+	enc_as504x_stop_sampling(&as504x);
+	return ENC_SYM_TRUE;
+}
+
 // IMU
 
 static imu_config imu_cfg;
@@ -5575,12 +6260,24 @@ static void unzip_task(void *arg) {
 	if (restart_cnt == lispif_get_restart_cnt()) {
 		lbm_value res = ENC_SYM_NIL;
 		if (!a->st->have_error) {
-			unsigned int count = fwrite(update_partition_data, 1, a->buflen, a->f_out);
-			fsync(fileno(a->f_out));
-			res = count == a->buflen ? ENC_SYM_TRUE : ENC_SYM_NIL;
+			if (a->f_out) {
+				unsigned int count = fwrite(update_partition_data, 1, a->buflen, a->f_out);
+				fsync(fileno(a->f_out));
+				res = count == a->buflen ? ENC_SYM_TRUE : ENC_SYM_NIL;
 
-			if (!res) {
-				commands_printf_lisp("Unzip: could not write all data to output file");
+				if (!res) {
+					commands_printf_lisp("Unzip: could not write all data to output file");
+				}
+			} else {
+				// No output file means the inflated data itself is a
+				// firmware image for the update partition; activate it.
+				// Validates the image header, so garbage is rejected here.
+				res = esp_ota_set_boot_partition(update_partition) == ESP_OK ?
+						ENC_SYM_TRUE : ENC_SYM_NIL;
+
+				if (!res) {
+					commands_printf_lisp("Unzip: could not activate new firmware");
+				}
 			}
 		} else {
 			commands_printf_lisp("Unzip: get_data error in extension");
@@ -5789,6 +6486,170 @@ static lbm_value ext_unzip(lbm_value *args, lbm_uint argn) {
 	}
 }
 
+/*
+ * (fw-unzip input fileInZip) -> t, nil
+ *
+ * Inflate a firmware image from a zip archive straight into the update
+ * partition and activate it on success. The write callback streams the
+ * decompressed output to flash as it is produced, so archive reads,
+ * inflation and flash programming overlap and no intermediate file or
+ * full-size RAM buffer is needed. Reboot to start the new image.
+ */
+static lbm_value ext_fw_unzip(lbm_value *args, lbm_uint argn) {
+	if (argn != 2) {
+		return ENC_SYM_TERROR;
+	}
+
+	FILE *f_in = NULL;
+	lbm_array_header_t *arr_in = NULL;
+	if (lbm_is_number(args[0])) {
+		f_in = file_from_arg(args[0]);
+		if (!f_in) {
+			lbm_set_error_reason((char*)str_f_not_open);
+			return ENC_SYM_EERROR;
+		}
+	} else if (lbm_is_array_r(args[0])) {
+		arr_in = (lbm_array_header_t *)lbm_car(args[0]);
+	} else {
+		return ENC_SYM_TERROR;
+	}
+
+	int ind_in_zip = 0;
+	char *name_in_zip = NULL;
+	if (lbm_is_number(args[1])) {
+		ind_in_zip = lbm_dec_as_i32(args[1]);
+		if (ind_in_zip < 0) {
+			return ENC_SYM_TERROR;
+		}
+	} else {
+		name_in_zip = lbm_dec_str(args[1]);
+		if (!name_in_zip) {
+			return ENC_SYM_TERROR;
+		}
+	}
+
+	lowzip_state *st = (lowzip_state *) lbm_malloc(sizeof(lowzip_state));
+	if (!st) {
+		return ENC_SYM_MERROR;
+	}
+
+	memset((void *) st, 0, sizeof(lowzip_state));
+
+	read_file_state *st_file = NULL;
+	read_buf_state *st_buf = NULL;
+
+	if (f_in) {
+		st_file = (read_file_state*)lbm_malloc(sizeof(read_file_state));
+		if (!st_file) {
+			lbm_free(st);
+			return ENC_SYM_MERROR;
+		}
+		memset((void *)st_file, 0, sizeof(read_file_state));
+
+		fseek(f_in, 0, SEEK_END);
+
+		st_file->input = f_in;
+		st_file->input_length = ftell(f_in);
+
+		st->udata = (void *)st_file;
+		st->read_callback = my_lz_read_file;
+		st->zip_length = st_file->input_length;
+	} else {
+		st_buf = (read_buf_state*)lbm_malloc(sizeof(read_buf_state));
+		if (!st_buf) {
+			lbm_free(st);
+			return ENC_SYM_MERROR;
+		}
+		memset((void *)st_buf, 0, sizeof(read_buf_state));
+
+		st_buf->data = (unsigned char*)arr_in->data;
+		st_buf->len = arr_in->size;
+
+		st->udata = st_buf;
+		st->read_callback = my_lz_read_buf;
+		st->zip_length = st_buf->len;
+	}
+
+	lowzip_init_archive(st);
+
+	if (st->have_error) {
+		lbm_set_error_reason("Invalid zip archive");
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		return ENC_SYM_EERROR;
+	}
+
+	lowzip_file *fileinfo = lowzip_locate_file(st, ind_in_zip, name_in_zip);
+	if (!fileinfo) {
+		lbm_set_error_reason("Invalid file in zip");
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		return ENC_SYM_EERROR;
+	}
+
+	write_file_state *st_write = lbm_malloc(sizeof(write_file_state));
+	if (!st_write) {
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		return ENC_SYM_MERROR;
+	}
+
+	memset((void *)st_write, 0, sizeof(write_file_state));
+
+	if (!fw_map_buffer()) {
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		lbm_free(st_write);
+		return ENC_SYM_EERROR;
+	}
+
+	unsigned int buflen = fileinfo->uncompressed_size;
+
+	if (buflen > update_partition->size) {
+		update_partition = NULL;
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		lbm_free(st_write);
+		lbm_set_error_reason("Too large file");
+		return ENC_SYM_EERROR;
+	}
+
+	st->output_start = (unsigned char *)update_partition_data;
+	st->output_end = st->output_start + buflen;
+	st->output_next = st->output_start;
+
+	st->write_callback = my_lz_write;
+	st->write_sync_callback = my_lz_write_sync;
+	st->udata_write = st_write;
+
+	unzip_args *a = (unzip_args*)lbm_malloc(sizeof(unzip_args));
+	if (!a) {
+		lbm_free(st);
+		lbm_free(st_file);
+		lbm_free(st_buf);
+		lbm_free(st_write);
+		return ENC_SYM_MERROR;
+	}
+
+	a->id = lbm_get_current_cid();
+	a->st = st;
+	a->st_file = st_file;
+	a->st_buf = st_buf;
+	a->st_write = st_write;
+	a->f_out = NULL;
+	a->buflen = buflen;
+
+	xTaskCreatePinnedToCore(unzip_task, "Unzip", 3072, a, 5, NULL, tskNO_AFFINITY);
+
+	lbm_block_ctx_from_extension();
+	return ENC_SYM_TRUE;
+}
+
 // (zip-ls input)
 static lbm_value ext_zip_ls(lbm_value *args, lbm_uint argn) {
 	if (argn != 1) {
@@ -6291,7 +7152,7 @@ static void cmds_send_raw(unsigned char *buffer, unsigned int len) {
 				}
 
 				if (timeout == 0 || lispif_is_eval_task() || !event_cmds_data_tx_en) {
-					lbm_free(v.buf);
+					lbm_free_flat_buffer(v.buf);
 					return;
 				}
 
@@ -6453,6 +7314,8 @@ static bool dynamic_loader(const char *str, const char **code) {
 }
 
 void lispif_load_vesc_extensions(bool main_found) {
+	lbm_set_flat_ext_free_callback(flat_buffer_free);
+
 	if (!i2c_mutex_init_done) {
 		i2c_mutex = xSemaphoreCreateMutex();
 		i2c_mutex_init_done = true;
@@ -6497,11 +7360,18 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("bms-zero-offset", ext_bms_zero_offset);
 		lbm_add_extension("bms-st", ext_bms_st);
 		lbm_add_extension("get-adc", ext_get_adc);
+		lbm_add_extension("get-adc-cached", ext_get_adc_cached);
+		lbm_add_extension("hw-sampler-start", ext_hw_sampler_start);
+		lbm_add_extension("hw-sampler-stop", ext_hw_sampler_stop);
 		lbm_add_extension("systime", ext_systime);
 		lbm_add_extension("secs-since", ext_secs_since);
 		lbm_add_extension("event-enable", ext_enable_event);
+		lbm_add_extension("event-rate", ext_event_rate);
+		lbm_add_extension("event-can-filter", ext_event_can_filter);
 		lbm_add_extension("send-data", ext_send_data);
 		lbm_add_extension("recv-data", ext_recv_data);
+		lbm_add_extension("mbox-send", ext_mbox_send);
+		lbm_add_extension("mbox-recv", ext_mbox_recv);
 		lbm_add_extension("sysinfo", ext_sysinfo);
 		lbm_add_extension("import", ext_empty);
 		lbm_add_extension("main-init-done", ext_main_init_done);
@@ -6526,16 +7396,22 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("can-start", ext_can_start);
 		lbm_add_extension("can-stop", ext_can_stop);
 		lbm_add_extension("can-use-vesc", ext_can_use_vesc);
+		lbm_add_extension("can-filter", ext_can_filter);
+		lbm_add_extension("can-filter-local", ext_can_filter_local);
 		lbm_add_extension("can-scan", ext_can_scan);
 		lbm_add_extension("can-ping", ext_can_ping);
 		lbm_add_extension("can-send-sid", ext_can_send_sid);
 		lbm_add_extension("can-send-eid", ext_can_send_eid);
+		lbm_add_extension("can-send-batch", ext_can_send_batch);
+		lbm_add_extension("view-can-status", ext_view_can_status);
+		lbm_add_extension("view-gnss", ext_view_gnss);
 		lbm_add_extension("can-recv-sid", ext_can_recv_sid);
 		lbm_add_extension("can-recv-eid", ext_can_recv_eid);
 		lbm_add_extension("can-cmd", ext_can_cmd);
 		lbm_add_extension("can-list-devs", ext_can_list_devs);
 		lbm_add_extension("can-local-id", ext_can_local_id);
 		lbm_add_extension("can-update-baud", ext_can_update_baud);
+		lbm_add_extension("can-probe-baud", ext_can_probe_baud);
 
 		lbm_add_extension("can-msg-age", ext_can_msg_age);
 		lbm_add_extension("canget-current", ext_can_get_current);
@@ -6550,6 +7426,7 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("canget-ppm", ext_can_get_ppm);
 		lbm_add_extension("canget-adc", ext_can_get_adc);
 		lbm_add_extension("canget-vin", ext_can_get_vin);
+		lbm_add_extension("can-get-status", ext_can_get_status);
 
 		lbm_add_extension("canset-current", ext_can_current);
 		lbm_add_extension("canset-current-rel", ext_can_current_rel);
@@ -6583,6 +7460,8 @@ void lispif_load_vesc_extensions(bool main_found) {
 
 		// Lbm settings
 		lbm_add_extension("lbm-set-quota", ext_lbm_set_quota);
+		lbm_add_extension("lbm-set-quota-weight", ext_lbm_set_quota_weight);
+		lbm_add_extension("lbm-set-event-preempt", ext_lbm_set_event_preempt);
 		lbm_add_extension("lbm-set-gc-stack-size", ext_lbm_set_gc_stack_size);
 
 		// Plot
@@ -6605,6 +7484,13 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("esp-now-send", ext_esp_now_send);
 		lbm_add_extension("esp-now-recv", ext_esp_now_recv);
 #endif
+
+		// IEEE 802.15.4 raw frame fast path
+#ifdef CONFIG_IDF_TARGET_ESP32C6
+		lbm_add_extension("ieee-tx", ext_ieee_tx);
+		lbm_add_extension("ieee-rx", ext_ieee_rx);
+		lbm_add_extension("ieee-rx-dropped", ext_ieee_rx_dropped);
+#endif
 #ifdef ENABLE_WIFI_EXTENSIONS
 		lbm_add_extension("get-mac-addr", ext_get_mac_addr);
 		lbm_add_extension("wifi-get-chan", ext_wifi_get_chan);
@@ -6621,6 +7507,8 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("log-config-field", ext_log_config_field);
 		lbm_add_extension("log-send-f32", ext_log_send_f32);
 		lbm_add_extension("log-send-f64", ext_log_send_f64);
+		lbm_add_extension("log-set-batching", ext_log_set_batching);
+		lbm_add_extension("log-flush", ext_log_flush);
 
 		// GNSS
 		lbm_add_extension("gnss-lat-lon", ext_gnss_lat_lon);
@@ -6629,6 +7517,11 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("gnss-hdop", ext_gnss_hdop);
 		lbm_add_extension("gnss-date-time", ext_gnss_date_time);
 		lbm_add_extension("gnss-age", ext_gnss_age);
+		lbm_add_extension("gnss-epoch-ms", ext_gnss_epoch_ms);
+		lbm_add_extension("odom-start", ext_odom_start);
+		lbm_add_extension("odom-stop", ext_odom_stop);
+		lbm_add_extension("odom-pos", ext_odom_pos);
+		lbm_add_extension("odom-vel", ext_odom_vel);
 		lbm_add_extension("ublox-init", ext_ublox_init);
 		lbm_add_extension("nmea-parse", ext_nmea_parse);
 		lbm_add_extension("set-pos-time", ext_set_pos_time);
@@ -6678,6 +7571,7 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("fw-data", ext_fw_data);
 		lbm_add_extension("fw-write-raw", ext_fw_write_raw);
 		lbm_add_extension("fw-info", ext_fw_info);
+	lbm_add_extension("fw-unzip", ext_fw_unzip);
 
 		// Lbm and script update
 		lbm_add_extension("lbm-erase", ext_lbm_erase);
@@ -6690,6 +7584,8 @@ void lispif_load_vesc_extensions(bool main_found) {
 		lbm_add_extension("as504x-init", ext_as504x_init);
 		lbm_add_extension("as504x-deinit", ext_as504x_deinit);
 		lbm_add_extension("as504x-angle", ext_as504x_angle);
+		lbm_add_extension("as504x-start-sampling", ext_as504x_start_sampling);
+		lbm_add_extension("as504x-stop-sampling", ext_as504x_stop_sampling);
 
 		// IMU
 		lbm_add_extension("imu-start-lsm6", ext_imu_start_lsm6);
@@ -6775,6 +7671,7 @@ void lispif_disable_all_events(void) {
 
 	event_can_sid_en = false;
 	event_can_eid_en = false;
+	event_can_batch_en = false;
 	event_data_rx_en = false;
 #ifdef ENABLE_ESP_NOW
 	event_esp_now_rx_en = false;
@@ -6782,6 +7679,10 @@ void lispif_disable_all_events(void) {
 	event_ble_rx_en = false;
 	event_wifi_disconnect_en = false;
 	event_cmds_data_tx_en = false;
+	event_tcp_connect_en = false;
+	event_tcp_recv_en = false;
+	event_gnss_en = false;
+	event_stack_warn_en = false;
 
 	event_bms_chg_allow_en = false;
 	event_bms_bal_ovr_en = false;
@@ -6789,6 +7690,8 @@ void lispif_disable_all_events(void) {
 	event_bms_force_bal_en = false;
 	event_bms_zero_ofs_en = false;
 
+	lispif_events_reset_rates();
+
 	bms_register_cmd_handler(NULL);
 
 #ifdef ENABLE_ESP_NOW
@@ -6798,6 +7701,8 @@ void lispif_disable_all_events(void) {
 	can_recv_eid_cid = -1;
 	recv_data_cid = -1;
 
+	mbox_reset_all();
+
 	for (int i = 0;i < file_now;i++) {
 		fclose(files_open[i]);
 		files_open[i] = 0;
@@ -6819,12 +7724,24 @@ void lispif_disable_all_events(void) {
 }
 
 void lispif_process_can(uint32_t can_id, uint8_t *data8, int len, bool is_ext) {
+	// With batch delivery enabled the per-frame events are suppressed;
+	// blocking can-recv-sid/eid readers are still served here.
+	bool ev_sid = event_can_sid_en && !event_can_batch_en;
+	bool ev_eid = event_can_eid_en && !event_can_batch_en;
+
+	// The id filter and rate cap only apply to event delivery; a blocking
+	// reader always gets the next frame. The filter is checked first so
+	// discarded frames do not consume the rate budget.
 	if (is_ext) {
-		if (can_recv_eid_cid < 0 && !event_can_eid_en)  {
+		if (can_recv_eid_cid < 0 && (!ev_eid ||
+				!lispif_events_can_id_allowed(can_id, true) ||
+				!lispif_events_allow(EVENT_RATE_CAN)))  {
 			return;
 		}
 	} else {
-		if (can_recv_sid_cid < 0 && !event_can_sid_en)  {
+		if (can_recv_sid_cid < 0 && (!ev_sid ||
+				!lispif_events_can_id_allowed(can_id, false) ||
+				!lispif_events_allow(EVENT_RATE_CAN)))  {
 			return;
 		}
 	}
@@ -6849,18 +7766,143 @@ void lispif_process_can(uint32_t can_id, uint8_t *data8, int len, bool is_ext) {
 
 		if (can_recv_sid_cid >= 0 && !is_ext) {
 			if (!lbm_unblock_ctx(can_recv_sid_cid, &v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
 			}
 			can_recv_sid_cid = -1;
 		} else if (can_recv_eid_cid >= 0 && is_ext) {
 			if (!lbm_unblock_ctx(can_recv_eid_cid, &v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
 			}
 			can_recv_eid_cid = -1;
 		} else {
 			if (!lbm_event(&v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
+			}
+		}
+	}
+}
+
+bool lispif_can_batch_enabled(void) {
+	return event_can_batch_en;
+}
+
+/**
+ * Deliver a burst of CAN frames as a single event-can-batch event. The
+ * payload is a list of (id . data) pairs flattened into one buffer, so
+ * a frame-sniffing script costs one event and one allocation per burst
+ * instead of per frame. Extended-id frames have bit 31 set in id.
+ */
+void lispif_process_can_batch(const can_frame_tap_t *frames, int cnt) {
+	if (!event_can_batch_en || cnt <= 0) {
+		return;
+	}
+
+	// Apply the id filters frame by frame; a burst where nothing passes
+	// is dropped before it consumes the rate budget or an allocation.
+	int pass = 0;
+	for (int i = 0;i < cnt;i++) {
+		if (lispif_events_can_id_allowed(frames[i].id, frames[i].ext)) {
+			pass++;
+		}
+	}
+
+	if (pass == 0 || !lispif_events_allow(EVENT_RATE_CAN)) {
+		return;
+	}
+
+	lbm_flat_value_t v;
+	if (start_flatten_with_gc(&v, 30 + pass * 30)) {
+		f_cons(&v);
+		f_sym(&v, sym_event_can_batch);
+
+		for (int i = 0;i < cnt;i++) {
+			if (!lispif_events_can_id_allowed(frames[i].id, frames[i].ext)) {
+				continue;
 			}
+			f_cons(&v);
+			f_cons(&v);
+			f_u32(&v, frames[i].id | (frames[i].ext ? 0x80000000 : 0));
+			f_lbm_array(&v, frames[i].len, (uint8_t*)frames[i].data);
+		}
+		f_sym(&v, ENC_SYM_NIL);
+
+		lbm_finish_flatten(&v);
+
+		if (!lbm_event(&v)) {
+			lbm_free_flat_buffer(v.buf);
+		}
+	}
+}
+
+/**
+ * Deliver one event-gnss event per nav epoch, triggered from the GGA
+ * decode path. The merged fix (position, velocity, satellite info) is
+ * flattened into a single buffer, so a subscribed script gets one wakeup
+ * and one allocation per epoch instead of one per decoded sentence. The
+ * payload is (event-gnss lat lon height speed hdop ms-today n-sat fix-type).
+ */
+void lispif_process_gnss(void) {
+	if (!event_gnss_en || !lispif_events_allow(EVENT_RATE_GNSS)) {
+		return;
+	}
+
+	nmea_state_t *s = nmea_get_state();
+
+	lbm_flat_value_t v;
+	if (start_flatten_with_gc(&v, 100)) {
+		f_cons(&v);
+		f_sym(&v, sym_event_gnss);
+		f_cons(&v);
+		f_double(&v, s->gga.lat);
+		f_cons(&v);
+		f_double(&v, s->gga.lon);
+		f_cons(&v);
+		f_float(&v, (float)s->gga.height);
+		f_cons(&v);
+		f_float(&v, s->rmc.speed);
+		f_cons(&v);
+		f_float(&v, s->gga.h_dop);
+		f_cons(&v);
+		f_i(&v, s->gga.ms_today);
+		f_cons(&v);
+		f_i(&v, s->gga.n_sat);
+		f_cons(&v);
+		f_i(&v, s->gga.fix_type);
+		f_sym(&v, ENC_SYM_NIL);
+
+		lbm_finish_flatten(&v);
+
+		if (!lbm_event(&v)) {
+			lbm_free_flat_buffer(v.buf);
+		}
+	}
+}
+
+/**
+ * Deliver one event-stack-warn event when the stack monitor sees a
+ * task drop below its headroom threshold. The payload is
+ * (event-stack-warn name free), with free being the stack high-water
+ * mark as reported by FreeRTOS.
+ */
+void lispif_process_stack_warn(const char *name, uint32_t stack_min_free) {
+	if (!event_stack_warn_en) {
+		return;
+	}
+
+	lbm_flat_value_t v;
+	if (start_flatten_with_gc(&v, 50)) {
+		f_cons(&v);
+		f_sym(&v, sym_event_stack_warn);
+		f_cons(&v);
+		f_lbm_array(&v, strlen(name) + 1, (uint8_t*)name);
+		f_cons(&v);
+		f_u(&v, stack_min_free);
+		f_sym(&v, ENC_SYM_NIL);
+
+		lbm_finish_flatten(&v);
+
+		if (!lbm_event(&v)) {
+			lbm_free_flat_buffer(v.buf);
 		}
 	}
 }
@@ -6870,6 +7912,10 @@ void lispif_process_custom_app_data(unsigned char *data, unsigned int len) {
 		return;
 	}
 
+	if (recv_data_cid < 0 && !lispif_events_allow(EVENT_RATE_DATA_RX)) {
+		return;
+	}
+
 	lbm_flat_value_t v;
 	if (start_flatten_with_gc(&v, 30 + len)) {
 		if (recv_data_cid < 0) {
@@ -6881,12 +7927,12 @@ void lispif_process_custom_app_data(unsigned char *data, unsigned int len) {
 
 		if (recv_data_cid >= 0) {
 			if (!lbm_unblock_ctx(recv_data_cid, &v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
 			}
 			recv_data_cid = -1;
 		} else {
 			if (!lbm_event(&v)) {
-				lbm_free(v.buf);
+				lbm_free_flat_buffer(v.buf);
 			}
 		}
 	}
@@ -6912,7 +7958,7 @@ void lispif_process_rmsg(int slot, unsigned char *data, unsigned int len) {
 		if (lbm_unblock_ctx(rmsg_slots[slot].cid, &v)) {
 			rmsg_slots[slot].cid = -1;
 		} else {
-			lbm_free(v.buf);
+			lbm_free_flat_buffer(v.buf);
 		}
 	}
 
@@ -26,6 +26,11 @@
 #include "esp_vfs.h"
 #include "buffer.h"
 #include "utils.h"
+#include "rb.h"
+#include "packet.h"
+#include "commands.h"
+#include "mempools.h"
+#include "heap_track.h"
 // NAND flash support temporarily disabled for ESP32-C6 compatibility
 // #include "vfs_fat_spinandflash.h"
 
@@ -73,33 +78,128 @@ static volatile bool m_append_time = false;
 static volatile bool m_append_gnss = false;
 static volatile bool m_append_gnss_time = false;
 
+/*
+ * Binary record mode, selected by an optional trailing byte in
+ * COMM_LOG_START. The file starts with a schema header (magic, field
+ * count, rate, append flags and the field descriptions) generated once
+ * from the configured fields, followed by fixed-width packed records.
+ * At 4 bytes per float32 instead of a formatted decimal plus separator
+ * this cuts bytes-per-sample several-fold, which matters at high rates.
+ */
+static volatile bool m_log_binary = false;
+
+/*
+ * The sample task and the write task are decoupled by a byte ring so
+ * that SD write stalls (which can exceed 200 ms on some cards) never
+ * delay sampling. The sample task runs at the configured rate, formats
+ * each CSV line into m_line and pushes it into the ring; when a line
+ * does not fit, the whole line is dropped and counted instead of
+ * blocking. The write task owns the file, writes the header on open
+ * and drains the ring to the card at its own pace.
+ */
+#define LOG_RING_SIZE		16384
+#define LOG_LINE_MAX		2048
+
+/*
+ * Sparse time index. While a log is written, an entry mapping seconds
+ * since log start to the file offset written so far is appended to a
+ * .idx sidecar file every few seconds. COMM_LOG_GET_RANGE uses it to
+ * seek close to a requested time range instead of streaming the whole
+ * file. Offsets can point into the middle of a line (the ring drains
+ * in fixed chunks), so readers skip to the next line boundary.
+ */
+#define LOG_INDEX_PERIOD_MS	5000
+
+static uint8_t m_ring_data[LOG_RING_SIZE];
+static rb_spsc_t m_ring;
+static volatile uint32_t m_dropped_samples = 0;
+
+static char m_line[LOG_LINE_MAX];
+static int m_line_pos = 0;
+
+/*
+ * Auxiliary log channel. Firmware modules that produce their own
+ * periodic telemetry (e.g. the lisp GC stats) write complete CSV lines
+ * here instead of into the field-based sample pipeline, which belongs
+ * to the connected client. The lines go through their own small ring
+ * into a separate file in log_aux/, drained by the write task so the
+ * producers never block on the card.
+ */
+#define LOG_AUX_RING_SIZE	2048
+#define LOG_AUX_NAME_MAX	20
+#define LOG_AUX_HEADER_MAX	256
+
+static uint8_t m_aux_ring_data[LOG_AUX_RING_SIZE];
+static rb_spsc_t m_aux_ring;
+static volatile bool m_aux_active = false;
+static char m_aux_name[LOG_AUX_NAME_MAX];
+static char m_aux_header[LOG_AUX_HEADER_MAX];
+static volatile uint32_t m_aux_dropped = 0;
+
+static void line_printf(const char *fmt, ...) {
+	if (m_line_pos >= (LOG_LINE_MAX - 1)) {
+		return;
+	}
+
+	va_list arg;
+	va_start(arg, fmt);
+	int res = vsnprintf(&m_line[m_line_pos], LOG_LINE_MAX - m_line_pos, fmt, arg);
+	va_end(arg);
+
+	if (res > 0) {
+		m_line_pos += res;
+		if (m_line_pos > (LOG_LINE_MAX - 1)) {
+			m_line_pos = LOG_LINE_MAX - 1;
+		}
+	}
+}
+
 static void print_header(log_header *h, FILE *file) {
 	fprintf(file, "%s:%s:%s:%d:%d:%d",
 			h->key, h->name, h->unit,
 			h->precision, h->is_relative, h->is_timestamp);
 }
 
-static void log_task(void *arg) {
-	FILE *f_log = 0;
+// Schema header for binary log files: magic, field count, rate, append
+// flags and the field descriptions. Everything needed to decode the
+// fixed-width records that follow.
+static void write_binary_schema(FILE *file) {
+	uint8_t buf[16];
+	int32_t ind = 0;
+
+	fwrite("VESCLOG1", 1, 8, file);
+
+	buffer_append_int16(buf, m_field_num, &ind);
+	buffer_append_float32_auto(buf, m_rate_hz, &ind);
+	buf[ind++] = m_append_time;
+	buf[ind++] = m_append_gnss_time;
+	buf[ind++] = m_append_gnss;
+	fwrite(buf, 1, ind, file);
+
+	for (int i = 0;i < m_field_num;i++) {
+		log_header *h = (log_header*)&m_headers[i];
+		fwrite(h->key, 1, strlen(h->key) + 1, file);
+		fwrite(h->name, 1, strlen(h->name) + 1, file);
+		fwrite(h->unit, 1, strlen(h->unit) + 1, file);
+
+		uint8_t meta[3] = {(uint8_t)h->precision, h->is_relative, h->is_timestamp};
+		fwrite(meta, 1, 3, file);
+	}
+}
+
+static void log_sample_task(void *arg) {
+	(void)arg;
+
 	int gga_cnt_last = 0;
 	int rmc_cnt_last = 0;
 	int64_t ms_last = utils_ms_tot();
-	TickType_t tick_last_fsync = xTaskGetTickCount();
+	bool was_active = false;
+	int64_t drop_report_last = 0;
+	uint32_t drop_reported = 0;
 
 	for (;;) {
-		if (!m_card) {
-			vTaskDelay(10);
-			continue;
-		}
-
 		nmea_state_t *s = nmea_get_state();
 
-		bool date_valid = true;
-		if (s->rmc.yy < 0 || s->rmc.mo < 0 || s->rmc.dd < 0 ||
-				s->rmc.hh < 0 || s->rmc.mm < 0 || s->rmc.ss < 0) {
-			date_valid = false;
-		}
-
 		bool gga_updated = false;
 		if (s->gga_cnt != gga_cnt_last) {
 			gga_updated = true;
@@ -112,6 +212,164 @@ static void log_task(void *arg) {
 			rmc_cnt_last = s->rmc_cnt;
 		}
 
+		if (m_card && m_field_num > 0) {
+			if (!was_active) {
+				// To get the first sample
+				gga_updated = true;
+				rmc_updated = true;
+				was_active = true;
+			}
+
+			m_line_pos = 0;
+
+			if (m_log_binary) {
+				// Fixed-width record. Fields that were not updated since
+				// the last sample repeat their last value; the timestamp
+				// fields make repeats identifiable in post-processing.
+				uint8_t *rec = (uint8_t*)m_line;
+				int32_t ind = 0;
+
+				for (int i = 0;i < m_field_num;i++) {
+					log_header *h = (log_header*)&m_headers[i];
+					buffer_append_float32_auto(rec, (float)h->value, &ind);
+					h->updated = false;
+				}
+
+				if (m_append_time) {
+					buffer_append_float32_auto(rec, (float)utils_ms_today() / 1000.0, &ind);
+				}
+
+				if (m_append_gnss_time) {
+					buffer_append_float32_auto(rec, (float)s->gga.ms_today / 1000.0, &ind);
+				}
+
+				if (m_append_gnss) {
+					buffer_append_float64_auto(rec, s->gga.lat, &ind);
+					buffer_append_float64_auto(rec, s->gga.lon, &ind);
+					buffer_append_float32_auto(rec, s->gga.height, &ind);
+					buffer_append_float32_auto(rec, s->gga.h_dop * 4.0, &ind);
+					buffer_append_float32_auto(rec, s->rmc.speed * 3.6, &ind);
+				}
+
+				m_line_pos = ind;
+			} else {
+				for (int i = 0;i < m_field_num;i++) {
+					log_header *h = (log_header*)&m_headers[i];
+					if (h->updated) {
+						line_printf("%.*f", h->precision, h->value);
+						h->updated = false;
+					}
+					if (i == (m_field_num - 1)) {
+						if (m_append_time || m_append_gnss_time || m_append_gnss) {
+							line_printf(";");
+						}
+
+						if (m_append_time) {
+							line_printf("%.3f", (float)utils_ms_today() / 1000.0);
+							if (m_append_gnss_time || m_append_gnss) {
+								line_printf(";");
+							}
+						}
+
+						if (m_append_gnss_time) {
+							if (gga_updated) {
+								line_printf("%.3f", (float)s->gga.ms_today / 1000.0);
+							}
+							if (m_append_gnss) {
+								line_printf(";");
+							}
+						}
+
+						if (m_append_gnss) {
+							if (gga_updated) {
+								line_printf("%.8f", s->gga.lat);
+							}
+							line_printf(";");
+
+							if (gga_updated) {
+								line_printf("%.8f", s->gga.lon);
+							}
+							line_printf(";");
+
+							if (gga_updated) {
+								line_printf("%.2f", s->gga.height);
+							}
+							line_printf(";");
+
+							if (gga_updated) {
+								line_printf("%.2f", s->gga.h_dop * 4.0);
+							}
+							line_printf(";");
+
+							if (rmc_updated) {
+								line_printf("%.2f", s->rmc.speed * 3.6);
+							}
+						}
+
+						line_printf("\n");
+					} else {
+						line_printf(";");
+					}
+				}
+			}
+
+			if (rb_spsc_get_free_space(&m_ring) >= (unsigned int)m_line_pos) {
+				rb_spsc_insert_multi(&m_ring, m_line, (unsigned int)m_line_pos);
+			} else {
+				m_dropped_samples++;
+			}
+
+			if (m_dropped_samples != drop_reported &&
+					(utils_ms_tot() - drop_report_last) > 5000) {
+				drop_report_last = utils_ms_tot();
+				drop_reported = m_dropped_samples;
+				commands_printf("Log: %lu samples dropped (SD too slow)",
+						(unsigned long)m_dropped_samples);
+			}
+		} else {
+			was_active = false;
+		}
+
+		if (m_rate_hz < 0.1) {
+			m_rate_hz = 10.0;
+		}
+
+		float task_time = (float)(utils_ms_tot() - ms_last) / 1000.0;
+		int sleep_time = (int)((float)configTICK_RATE_HZ  * ((1.0 / m_rate_hz) - task_time));
+		if (sleep_time < 0) {
+			sleep_time = 1;
+		}
+		vTaskDelay(sleep_time);
+		ms_last = utils_ms_tot();
+	}
+}
+
+static void log_write_task(void *arg) {
+	(void)arg;
+
+	FILE *f_log = 0;
+	FILE *f_idx = 0;
+	FILE *f_aux = 0;
+	TickType_t tick_last_fsync = xTaskGetTickCount();
+	TickType_t tick_last_fsync_aux = xTaskGetTickCount();
+	int64_t ms_log_start = 0;
+	int64_t ms_idx_last = 0;
+	uint32_t bytes_written = 0;
+
+	for (;;) {
+		if (!m_card) {
+			vTaskDelay(10);
+			continue;
+		}
+
+		nmea_state_t *s = nmea_get_state();
+
+		bool date_valid = true;
+		if (s->rmc.yy < 0 || s->rmc.mo < 0 || s->rmc.dd < 0 ||
+				s->rmc.hh < 0 || s->rmc.mm < 0 || s->rmc.ss < 0) {
+			date_valid = false;
+		}
+
 		if (m_field_num > 0 && !f_log) {
 			if ((m_append_gnss || m_append_gnss_time) && !date_valid) {
 				vTaskDelay(configTICK_RATE_HZ / 100);
@@ -145,27 +403,39 @@ static void log_task(void *arg) {
 				}
 				closedir(dir);
 
+				const char *ext = m_log_binary ? "vlb" : "csv";
+
 				if (date_valid) {
 					sprintf(
 						path,
-						"%slog_can/log_%03d_%02d-%02d-%02d_%02d-%02d-%02d.csv",
+						"%slog_can/log_%03d_%02d-%02d-%02d_%02d-%02d-%02d.%s",
 						file_basepath, highest_index + 1, s->rmc.yy, s->rmc.mo,
-						s->rmc.dd, s->rmc.hh, s->rmc.mm, s->rmc.ss
+						s->rmc.dd, s->rmc.hh, s->rmc.mm, s->rmc.ss, ext
 					);
 				} else {
 					sprintf(
-						path, "%slog_can/log_%03d.csv", file_basepath,
-						highest_index + 1
+						path, "%slog_can/log_%03d.%s", file_basepath,
+						highest_index + 1, ext
 					);
 				}
 				f_log = fopen(path, "w");
-			}
 
-			if (f_log) {
-				// To get the first sample
-				gga_updated = true;
-				rmc_updated = true;
+				// Sparse time index next to the log, see
+				// LOG_INDEX_PERIOD_MS. Retrieval works without it, just
+				// slower.
+				if (f_log) {
+					char path_idx[210];
+					sprintf(path_idx, "%s.idx", path);
+					f_idx = fopen(path_idx, "w");
+					ms_log_start = utils_ms_tot();
+					ms_idx_last = 0;
+					bytes_written = 0;
+				}
+			}
 
+			if (f_log && m_log_binary) {
+				write_binary_schema(f_log);
+			} else if (f_log) {
 				for (int i = 0;i < m_field_num;i++) {
 					print_header((log_header*)&m_headers[i], f_log);
 					if (i == (m_field_num - 1)) {
@@ -212,90 +482,128 @@ static void log_task(void *arg) {
 		}
 
 		if (m_field_num <= 0 && f_log) {
+			// Drain what the sample task queued before the stop before
+			// closing the file.
+			unsigned int n;
+			void *span;
+			while ((n = rb_spsc_read_reserve(&m_ring, &span)) > 0) {
+				fwrite(span, 1, n, f_log);
+				rb_spsc_read_commit(&m_ring, n);
+			}
 			fclose(f_log);
 			f_log = 0;
+
+			if (f_idx) {
+				fclose(f_idx);
+				f_idx = 0;
+			}
 		}
 
 		if (f_log) {
-			for (int i = 0;i < m_field_num;i++) {
-				log_header *h = (log_header*)&m_headers[i];
-				if (h->updated) {
-					fprintf(f_log, "%.*f", h->precision, h->value);
-					h->updated = false;
-				}
-				if (i == (m_field_num - 1)) {
-					if (m_append_time || m_append_gnss_time || m_append_gnss) {
-						fprintf(f_log, ";");
-					}
-
-					if (m_append_time) {
-						fprintf(f_log, "%.3f", (float)utils_ms_today() / 1000.0);
-						if (m_append_gnss_time || m_append_gnss) {
-							fprintf(f_log, ";");
-						}
-					}
-
-					if (m_append_gnss_time) {
-						if (gga_updated) {
-							fprintf(f_log, "%.3f", (float)s->gga.ms_today / 1000.0);
-						}
-						if (m_append_gnss) {
-							fprintf(f_log, ";");
-						}
-					}
+			// The ring is written to the card in place; at most two
+			// spans per drain when the data wraps.
+			unsigned int n;
+			void *span;
+			while ((n = rb_spsc_read_reserve(&m_ring, &span)) > 0) {
+				fwrite(span, 1, n, f_log);
+				rb_spsc_read_commit(&m_ring, n);
+				bytes_written += n;
+			}
 
-					if (m_append_gnss) {
-						if (gga_updated) {
-							fprintf(f_log, "%.8f", s->gga.lat);
-						}
-						fprintf(f_log, ";");
+			if (f_idx && (utils_ms_tot() - ms_idx_last) > LOG_INDEX_PERIOD_MS) {
+				ms_idx_last = utils_ms_tot();
 
-						if (gga_updated) {
-							fprintf(f_log, "%.8f", s->gga.lon);
-						}
-						fprintf(f_log, ";");
+				uint8_t entry[8];
+				int32_t ind = 0;
+				buffer_append_float32_auto(entry,
+						(float)(utils_ms_tot() - ms_log_start) / 1000.0, &ind);
+				buffer_append_uint32(entry, bytes_written, &ind);
+				fwrite(entry, 1, sizeof(entry), f_idx);
+			}
 
-						if (gga_updated) {
-							fprintf(f_log, "%.2f", s->gga.height);
-						}
-						fprintf(f_log, ";");
+			if (UTILS_AGE_S(tick_last_fsync) > 2.0) {
+				tick_last_fsync = xTaskGetTickCount();
+				fsync(fileno(f_log));
+				if (f_idx) {
+					fsync(fileno(f_idx));
+				}
+			}
+		} else if (!rb_spsc_is_empty(&m_ring)) {
+			// No file to write to (e.g. waiting for a valid GNSS date), so
+			// discard leftovers to not log stale samples later. Popping is
+			// safe against the sample task, flushing is not.
+			while (rb_spsc_pop_multi(&m_ring, 0, 512) > 0);
+		}
 
-						if (gga_updated) {
-							fprintf(f_log, "%.2f", s->gga.h_dop * 4.0);
-						}
-						fprintf(f_log, ";");
+		// Auxiliary channel, independent of the field-based log above.
+		if (m_aux_active && !f_aux) {
+			char path[220];
+			sprintf(path, "%slog_aux", file_basepath);
+			mkdir(path, 0775);
 
-						if (rmc_updated) {
-							fprintf(f_log, "%.2f", s->rmc.speed * 3.6);
+			int highest_index = -1;
+			DIR *dir = opendir(path);
+			if (dir) {
+				struct dirent *entry;
+				while ((entry = readdir(dir)) != NULL) {
+					if (entry->d_type == DT_REG &&
+							strncmp(entry->d_name, m_aux_name, strlen(m_aux_name)) == 0) {
+						const char *index_start = &entry->d_name[strlen(m_aux_name) + 1];
+						char *digits_end;
+						int index = (int)strtol(index_start, &digits_end, 10);
+						if (digits_end != index_start && index > highest_index) {
+							highest_index = index;
 						}
 					}
+				}
+				closedir(dir);
 
-					fprintf(f_log, "\n");
-				} else {
-					fprintf(f_log, ";");
+				sprintf(path, "%slog_aux/%s_%03d.csv",
+						file_basepath, m_aux_name, highest_index + 1);
+				f_aux = fopen(path, "w");
+
+				if (f_aux) {
+					fprintf(f_aux, "%s\n", m_aux_header);
 				}
 			}
+		}
 
-			if (UTILS_AGE_S(tick_last_fsync) > 2.0) {
-				tick_last_fsync = xTaskGetTickCount();
-				fsync(fileno(f_log));
+		if (!m_aux_active && f_aux) {
+			unsigned int n;
+			void *span;
+			while ((n = rb_spsc_read_reserve(&m_aux_ring, &span)) > 0) {
+				fwrite(span, 1, n, f_aux);
+				rb_spsc_read_commit(&m_aux_ring, n);
 			}
+			fclose(f_aux);
+			f_aux = 0;
 		}
 
-		if (m_rate_hz < 0.1) {
-			m_rate_hz = 10.0;
-		}
+		if (f_aux) {
+			unsigned int n;
+			void *span;
+			while ((n = rb_spsc_read_reserve(&m_aux_ring, &span)) > 0) {
+				fwrite(span, 1, n, f_aux);
+				rb_spsc_read_commit(&m_aux_ring, n);
+			}
 
-		float task_time = (float)(utils_ms_tot() - ms_last) / 1000.0;
-		int sleep_time = (int)((float)configTICK_RATE_HZ  * ((1.0 / m_rate_hz) - task_time));
-		if (sleep_time < 0) {
-			sleep_time = 1;
+			// Days-long telemetry runs should survive power loss, so the
+			// aux file gets the same fsync cadence as the main log.
+			if (UTILS_AGE_S(tick_last_fsync_aux) > 2.0) {
+				tick_last_fsync_aux = xTaskGetTickCount();
+				fsync(fileno(f_aux));
+			}
+		} else if (!m_aux_active && !rb_spsc_is_empty(&m_aux_ring)) {
+			while (rb_spsc_pop_multi(&m_aux_ring, 0, 512) > 0);
 		}
-		vTaskDelay(sleep_time);
-		ms_last = utils_ms_tot();
+
+		vTaskDelay(configTICK_RATE_HZ / 100);
 	}
 }
 
+#define SD_PROBE_SECTORS	8
+#define SD_PROBE_READS		4
+
 esp_err_t log_mount_card(int pin_mosi, int pin_miso, int pin_sck, int pin_cs, int freq) {
 	esp_err_t ret;
 
@@ -328,7 +636,133 @@ esp_err_t log_mount_card(int pin_mosi, int pin_miso, int pin_sck, int pin_cs, in
 	slot_config.host_id = m_host.slot;
 
 	file_basepath = "/sdcard/";
-	return esp_vfs_fat_sdspi_mount("/sdcard", &m_host, &slot_config, &mount_config, &m_card);
+	ret = esp_vfs_fat_sdspi_mount("/sdcard", &m_host, &slot_config, &mount_config, &m_card);
+	if (ret != ESP_OK) {
+		return ret;
+	}
+
+	/*
+	 * Autotune the interface clock. The passed frequency is a safe
+	 * baseline (some cards brown out at 40 MHz on marginal wiring), so
+	 * after a successful mount higher frequencies are probed by
+	 * remounting and verify-reading a few sectors against a reference
+	 * captured at the baseline. The fastest frequency that reads back
+	 * correctly wins; the first failure falls back to the last good
+	 * one. Probing never formats on a failed mount.
+	 */
+	static const int freqs_khz[] = {SDMMC_FREQ_DEFAULT, 26600, SDMMC_FREQ_HIGHSPEED};
+
+	mount_config.format_if_mount_failed = false;
+
+	uint8_t *ref = heap_track_malloc("log_sd_probe", SD_PROBE_SECTORS * 512);
+	uint8_t *buf = heap_track_malloc("log_sd_probe", SD_PROBE_SECTORS * 512);
+
+	if (ref && buf && sdmmc_read_sectors(m_card, ref, 0, SD_PROBE_SECTORS) == ESP_OK) {
+		int freq_good = freq;
+
+		for (unsigned int i = 0;i < (sizeof(freqs_khz) / sizeof(freqs_khz[0]));i++) {
+			if (freqs_khz[i] <= freq_good) {
+				continue;
+			}
+
+			esp_vfs_fat_sdcard_unmount("/sdcard", m_card);
+			m_card = 0;
+
+			m_host.max_freq_khz = freqs_khz[i];
+			if (esp_vfs_fat_sdspi_mount("/sdcard", &m_host, &slot_config,
+					&mount_config, &m_card) != ESP_OK) {
+				m_card = 0;
+				break;
+			}
+
+			bool ok = true;
+			for (int j = 0;j < SD_PROBE_READS && ok;j++) {
+				ok = sdmmc_read_sectors(m_card, buf, 0, SD_PROBE_SECTORS) == ESP_OK &&
+						memcmp(ref, buf, SD_PROBE_SECTORS * 512) == 0;
+			}
+
+			if (ok) {
+				freq_good = freqs_khz[i];
+			} else {
+				esp_vfs_fat_sdcard_unmount("/sdcard", m_card);
+				m_card = 0;
+				break;
+			}
+		}
+
+		if (!m_card) {
+			m_host.max_freq_khz = freq_good;
+			ret = esp_vfs_fat_sdspi_mount("/sdcard", &m_host, &slot_config,
+					&mount_config, &m_card);
+		}
+	}
+
+	heap_track_free("log_sd_probe", ref);
+	heap_track_free("log_sd_probe", buf);
+
+	return ret;
+}
+
+/*
+ * Sequential write benchmark, mostly to see what the autotuned clock
+ * gives on the card at hand. Writes size_mb to a scratch file in 4 kB
+ * chunks and prints the resulting rate.
+ */
+bool log_benchmark(int size_mb) {
+	if (!m_card) {
+		return false;
+	}
+
+	if (size_mb < 1) {
+		size_mb = 1;
+	}
+
+	if (size_mb > 64) {
+		size_mb = 64;
+	}
+
+	const int chunk = 4096;
+	uint8_t *buf = heap_track_malloc("log_bench", chunk);
+	if (!buf) {
+		return false;
+	}
+
+	for (int i = 0;i < chunk;i++) {
+		buf[i] = i;
+	}
+
+	char path[30];
+	sprintf(path, "%sbench.tmp", file_basepath);
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		heap_track_free("log_bench", buf);
+		return false;
+	}
+
+	int chunks = (size_mb * 1024 * 1024) / chunk;
+	int written = 0;
+
+	int64_t t_start = utils_ms_tot();
+	for (int i = 0;i < chunks;i++) {
+		written += fwrite(buf, 1, chunk, f);
+	}
+	fsync(fileno(f));
+	int64_t t_write = utils_ms_tot() - t_start;
+
+	fclose(f);
+	unlink(path);
+	heap_track_free("log_bench", buf);
+
+	if (t_write < 1) {
+		t_write = 1;
+	}
+
+	commands_printf("Card     : %s at %d kHz", m_card->cid.name, m_card->max_freq_khz);
+	commands_printf("Wrote    : %d bytes in %d ms", written, (int)t_write);
+	commands_printf("Seq write: %.2f MB/s\n",
+			((double)written / 1.0e6) / ((double)t_write / 1000.0));
+
+	return true;
 }
 
 void log_unmount_card(void) {
@@ -428,11 +862,165 @@ bool log_init(void) {
 	m_header_hvel.value = 0.0;
 	m_header_hvel.updated = false;
 
-	xTaskCreatePinnedToCore(log_task, "log", 3072, NULL, 8, NULL, tskNO_AFFINITY);
+	rb_spsc_init(&m_ring, m_ring_data, 1, LOG_RING_SIZE);
+	rb_spsc_init(&m_aux_ring, m_aux_ring_data, 1, LOG_AUX_RING_SIZE);
+
+	xTaskCreatePinnedToCore(log_sample_task, "log_sample", 3072, NULL, 8, NULL, tskNO_AFFINITY);
+	xTaskCreatePinnedToCore(log_write_task, "log_write", 3072, NULL, 7, NULL, tskNO_AFFINITY);
+
+	return true;
+}
+
+/*
+ * Stream the lines of a CSV log covering a time range, sending every
+ * dec:th line. The .idx sidecar narrows the byte range to read; when
+ * it is missing the whole file is scanned. Replies are
+ * COMM_LOG_GET_RANGE packets with a more-flag byte followed by line
+ * data; the final packet has the flag cleared and no data. Binary
+ * (.vlb) logs have fixed-width records, so clients seek those
+ * directly from the schema instead.
+ */
+static void log_send_range(const char *name, float t_start, float t_end, int dec) {
+	// Reserved with packet headroom, so every chunk is framed in place
+	// and handed straight to the transport when it has a raw path.
+	uint8_t *send_buf = commands_reply_reserve(PACKET_MAX_PL_LEN);
+	if (!send_buf) {
+		return;
+	}
+
+	send_buf[0] = COMM_LOG_GET_RANGE;
+	send_buf[1] = 1;
+	int32_t send_pos = 2;
+
+	if (dec < 1) {
+		dec = 1;
+	}
+
+	char path[250];
+	snprintf(path, sizeof(path), "%slog_can/%s", file_basepath, name);
+
+	uint32_t ofs_start = 0;
+	uint32_t ofs_end = 0xFFFFFFFF;
+
+	char path_idx[260];
+	snprintf(path_idx, sizeof(path_idx), "%s.idx", path);
+	FILE *f_idx = fopen(path_idx, "r");
+	if (f_idx) {
+		uint8_t entry[8];
+		while (fread(entry, 1, sizeof(entry), f_idx) == sizeof(entry)) {
+			int32_t ind = 0;
+			float t = buffer_get_float32_auto(entry, &ind);
+			uint32_t ofs = buffer_get_uint32(entry, &ind);
+
+			if (t <= t_start) {
+				ofs_start = ofs;
+			}
+
+			if (t >= t_end) {
+				ofs_end = ofs;
+				break;
+			}
+		}
+		fclose(f_idx);
+	}
+
+	FILE *f = fopen(path, "r");
+	char *line = 0;
+	if (f) {
+		line = heap_track_malloc("log_line", LOG_LINE_MAX);
+	}
+
+	if (line) {
+		fseek(f, ofs_start, SEEK_SET);
+
+		if (ofs_start > 0) {
+			// The index points into the byte stream, not at a line
+			// boundary; discard up to the next full line.
+			fgets(line, LOG_LINE_MAX, f);
+		}
+
+		int line_cnt = 0;
+		while (fgets(line, LOG_LINE_MAX, f)) {
+			if ((line_cnt++ % dec) == 0) {
+				int llen = strlen(line);
+
+				if ((send_pos + llen) > 400) {
+					commands_reply_send(send_buf, send_pos, commands_get_send_func());
+					send_pos = 2;
+				}
+
+				memcpy(send_buf + send_pos, line, llen);
+				send_pos += llen;
+			}
+
+			if ((uint32_t)ftell(f) >= ofs_end) {
+				break;
+			}
+		}
+
+		if (send_pos > 2) {
+			commands_reply_send(send_buf, send_pos, commands_get_send_func());
+		}
+
+		heap_track_free("log_line", line);
+	}
+
+	if (f) {
+		fclose(f);
+	}
+
+	send_buf[0] = COMM_LOG_GET_RANGE;
+	send_buf[1] = 0;
+	commands_reply_send(send_buf, 2, commands_get_send_func());
+	commands_reply_release(send_buf);
+}
+
+bool log_aux_start(const char *name, const char *header) {
+	if (m_aux_active || !m_card) {
+		return false;
+	}
+
+	if (strlen(name) >= sizeof(m_aux_name) ||
+			strlen(header) >= sizeof(m_aux_header)) {
+		return false;
+	}
+
+	strcpy(m_aux_name, name);
+	strcpy(m_aux_header, header);
+	rb_spsc_flush(&m_aux_ring);
+	m_aux_dropped = 0;
+	m_aux_active = true;
 
 	return true;
 }
 
+void log_aux_stop(void) {
+	m_aux_active = false;
+}
+
+bool log_aux_active(void) {
+	return m_aux_active && m_card;
+}
+
+bool log_aux_write(const char *line) {
+	if (!m_aux_active || !m_card) {
+		return false;
+	}
+
+	unsigned int len = strlen(line);
+	if (rb_spsc_get_free_space(&m_aux_ring) < len) {
+		m_aux_dropped++;
+		return false;
+	}
+
+	rb_spsc_insert_multi(&m_aux_ring, line, len);
+	return true;
+}
+
+uint32_t log_aux_dropped(void) {
+	return m_aux_dropped;
+}
+
 void log_process_packet(unsigned char *data, unsigned int len) {
 	COMM_PACKET_ID packet_id = data[0];
 	data++;
@@ -454,6 +1042,13 @@ void log_process_packet(unsigned char *data, unsigned int len) {
 		m_append_time = data[ind++];
 		m_append_gnss = data[ind++];
 		m_append_gnss_time = data[ind++];
+
+		// Optional, older senders do not include it.
+		if ((unsigned int)ind < len) {
+			m_log_binary = data[ind++];
+		} else {
+			m_log_binary = false;
+		}
 	} break;
 
 	case COMM_LOG_STOP: {
@@ -512,6 +1107,35 @@ void log_process_packet(unsigned char *data, unsigned int len) {
 		}
 	} break;
 
+	case COMM_LOG_GET_RANGE: {
+		int32_t ind = 0;
+		char *name = (char*)data;
+		ind += strlen(name) + 1;
+
+		if ((unsigned int)(ind + 10) > len) {
+			break;
+		}
+
+		float t_start = buffer_get_float32_auto(data, &ind);
+		float t_end = buffer_get_float32_auto(data, &ind);
+		int dec = buffer_get_uint16(data, &ind);
+
+		log_send_range(name, t_start, t_end, dec);
+	} break;
+
+	case COMM_LOG_DATA_BATCH: {
+		// Container with length-prefixed log packets, see log_comm.c.
+		int32_t ind = 0;
+		while ((unsigned int)(ind + 2) <= len) {
+			uint16_t plen = buffer_get_uint16(data, &ind);
+			if (plen == 0 || ((unsigned int)ind + plen) > len) {
+				break;
+			}
+			log_process_packet(data + ind, plen);
+			ind += plen;
+		}
+	} break;
+
 	default:
 		break;
 	}
@@ -29,10 +29,19 @@
 bool log_init(void);
 esp_err_t log_mount_card(int pin_mosi, int pin_miso, int pin_sck, int pin_cs, int freq);
 void log_unmount_card(void);
+bool log_benchmark(int size_mb);
 bool log_mount_nand_flash(int pin_mosi, int pin_miso, int pin_sck, int pin_cs, int freq);
 void log_unmount_nand_flash(void);
 void log_process_packet(unsigned char *data, unsigned int len);
 
+// Auxiliary log channel for firmware-generated telemetry lines. One
+// channel at a time; lines are complete CSV rows including the newline.
+bool log_aux_start(const char *name, const char *header);
+void log_aux_stop(void);
+bool log_aux_active(void);
+bool log_aux_write(const char *line);
+uint32_t log_aux_dropped(void);
+
 // Global variables
 extern char *file_basepath;
 
@@ -25,6 +25,35 @@
 #include "buffer.h"
 #include "datatypes.h"
 #include "mempools.h"
+#include "packet.h"
+#include "utils.h"
+
+/*
+ * Sample batching. One COMM packet per data point means most of the
+ * transport frame is framing, which caps remote log rates well below
+ * wire speed over BLE and TCP. When enabled, data packets are
+ * accumulated as length-prefixed entries in a COMM_LOG_DATA_BATCH
+ * container that is flushed when adding another entry would exceed
+ * max_bytes (set this from the transport MTU) or when the oldest
+ * entry has waited max_delay_ms. Disabled by default, so nothing
+ * changes for clients without batch support.
+ */
+static int m_batch_max_bytes = 0;
+static int m_batch_max_delay_ms = 50;
+static uint8_t m_batch[PACKET_MAX_PL_LEN];
+static int m_batch_pos = 0;
+static int m_batch_can_id = -1;
+static int64_t m_batch_ms_first = 0;
+
+static void send_raw(int can_id, uint8_t *data, unsigned int len) {
+	if (can_id >= 0 && can_id < 255) {
+		comm_can_send_buffer(can_id, data, len, 0);
+	} else if (can_id == -1) {
+		commands_send_packet(data, len);
+	} else {
+		log_process_packet(data, len);
+	}
+}
 
 void log_comm_start(
 		int can_id,
@@ -88,12 +117,58 @@ void log_comm_config_field(
 	mempools_free_packet_buffer(buffer);
 }
 
+void log_comm_set_batching(int max_bytes, int max_delay_ms) {
+	log_comm_flush();
+
+	if (max_bytes > (int)sizeof(m_batch)) {
+		max_bytes = sizeof(m_batch);
+	}
+
+	m_batch_max_bytes = max_bytes;
+	m_batch_max_delay_ms = max_delay_ms;
+}
+
+void log_comm_flush(void) {
+	if (m_batch_pos > 1) {
+		send_raw(m_batch_can_id, m_batch, m_batch_pos);
+	}
+	m_batch_pos = 0;
+}
+
 void log_comm_send(int can_id, uint8_t *data, unsigned int len) {
-	if (can_id >= 0 && can_id < 255) {
-		comm_can_send_buffer(can_id, data, len, 0);
-	} else if (can_id == -1) {
-		commands_send_packet(data, len);
-	} else {
-		log_process_packet(data, len);
+	bool is_data = len > 0 &&
+			(data[0] == COMM_LOG_DATA_F32 || data[0] == COMM_LOG_DATA_F64);
+
+	if (m_batch_max_bytes <= 0 || !is_data) {
+		// Flush first so that e.g. a stop cannot overtake queued samples.
+		log_comm_flush();
+		send_raw(can_id, data, len);
+		return;
+	}
+
+	if (m_batch_pos > 1 && (can_id != m_batch_can_id ||
+			(m_batch_pos + 2 + (int)len) > m_batch_max_bytes)) {
+		log_comm_flush();
+	}
+
+	if ((int)(3 + len) > m_batch_max_bytes) {
+		// Does not fit even in an empty batch.
+		send_raw(can_id, data, len);
+		return;
+	}
+
+	if (m_batch_pos == 0) {
+		m_batch[m_batch_pos++] = COMM_LOG_DATA_BATCH;
+		m_batch_can_id = can_id;
+		m_batch_ms_first = utils_ms_tot();
+	}
+
+	int32_t ind = m_batch_pos;
+	buffer_append_uint16(m_batch, len, &ind);
+	memcpy(m_batch + ind, data, len);
+	m_batch_pos = ind + len;
+
+	if ((utils_ms_tot() - m_batch_ms_first) >= m_batch_max_delay_ms) {
+		log_comm_flush();
 	}
 }
@@ -41,6 +41,8 @@ void log_comm_config_field(
 		int precision,
 		bool is_relative,
 		bool is_timestamp);
+void log_comm_set_batching(int max_bytes, int max_delay_ms);
+void log_comm_flush(void);
 void log_comm_send(int can_id, uint8_t *data, unsigned int len);
 
 #endif /* COMM_LOG_COMM_H_ */
@@ -0,0 +1,276 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "log_store.h"
+#include "crc.h"
+#include "buffer.h"
+#include "esp_partition.h"
+
+#include <string.h>
+
+/*
+ * On-flash layout. The logs partition is divided into segments of one
+ * erase sector each. A segment starts with an 8 byte header:
+ *
+ *   [0..1]	magic
+ *   [2..3]	crc, 0xFFFF (erased) while the segment is open, programmed
+ *			over the whole data area when the segment is sealed
+ *   [4..7]	sequence number, increases by one per segment ever opened
+ *
+ * Records follow as uint16 length plus payload, appended strictly in
+ * order; 0xFFFF marks the unwritten remainder. When a record does not
+ * fit, the segment is sealed and the oldest segment (round-robin) is
+ * erased and reused. Each sector is therefore erased exactly once per
+ * pass through the partition and no metadata is rewritten, which is
+ * what keeps both throughput and wear at the raw-flash limit.
+ *
+ * A single writer is assumed, like the other log paths.
+ */
+
+#define LOG_STORE_MAGIC		0x4C53
+#define LOG_STORE_HEADER	8
+#define LOG_STORE_BUF		256
+
+// Private variables
+static const esp_partition_t *m_part = NULL;
+static int m_seg_size = 0;
+static int m_seg_num = 0;
+static int m_seg_now = 0;		// Segment currently written
+static uint32_t m_seq_now = 0;	// Its sequence number
+static uint32_t m_seg_ofs = 0;	// Write offset within the segment
+static uint8_t m_buf[LOG_STORE_BUF];
+static int m_buf_pos = 0;
+
+static bool flush_buf(void) {
+	if (m_buf_pos == 0) {
+		return true;
+	}
+
+	esp_err_t res = esp_partition_write(m_part,
+			m_seg_now * m_seg_size + m_seg_ofs, m_buf, m_buf_pos);
+
+	if (res == ESP_OK) {
+		m_seg_ofs += m_buf_pos;
+		m_buf_pos = 0;
+		return true;
+	}
+
+	return false;
+}
+
+static bool read_header(int seg, uint16_t *magic, uint16_t *crc, uint32_t *seq) {
+	uint8_t header[LOG_STORE_HEADER];
+	if (esp_partition_read(m_part, seg * m_seg_size, header,
+			LOG_STORE_HEADER) != ESP_OK) {
+		return false;
+	}
+
+	int32_t ind = 0;
+	*magic = buffer_get_uint16(header, &ind);
+	*crc = buffer_get_uint16(header, &ind);
+	*seq = buffer_get_uint32(header, &ind);
+	return true;
+}
+
+// CRC over the whole data area of a segment, read back in chunks.
+static uint16_t data_crc(int seg) {
+	uint8_t buf[LOG_STORE_BUF];
+	uint16_t crc = 0;
+
+	for (int ofs = LOG_STORE_HEADER;ofs < m_seg_size;ofs += sizeof(buf)) {
+		int now = m_seg_size - ofs;
+		if (now > (int)sizeof(buf)) {
+			now = sizeof(buf);
+		}
+
+		if (esp_partition_read(m_part, seg * m_seg_size + ofs, buf, now) != ESP_OK) {
+			return 0;
+		}
+
+		crc = crc16_with_init(buf, now, crc);
+	}
+
+	return crc;
+}
+
+static bool open_segment(int seg, uint32_t seq) {
+	if (esp_partition_erase_range(m_part, seg * m_seg_size, m_seg_size) != ESP_OK) {
+		return false;
+	}
+
+	uint8_t header[LOG_STORE_HEADER];
+	int32_t ind = 0;
+	buffer_append_uint16(header, LOG_STORE_MAGIC, &ind);
+	buffer_append_uint16(header, 0xFFFF, &ind); // Stays erased until sealed
+	buffer_append_uint32(header, seq, &ind);
+
+	if (esp_partition_write(m_part, seg * m_seg_size, header,
+			LOG_STORE_HEADER) != ESP_OK) {
+		return false;
+	}
+
+	m_seg_now = seg;
+	m_seq_now = seq;
+	m_seg_ofs = LOG_STORE_HEADER;
+	m_buf_pos = 0;
+	return true;
+}
+
+static bool seal_segment(void) {
+	if (!flush_buf()) {
+		return false;
+	}
+
+	uint16_t crc = data_crc(m_seg_now);
+	uint8_t buf[2];
+	int32_t ind = 0;
+	buffer_append_uint16(buf, crc, &ind);
+
+	return esp_partition_write(m_part,
+			m_seg_now * m_seg_size + 2, buf, 2) == ESP_OK;
+}
+
+bool log_store_init(void) {
+	m_part = esp_partition_find_first(
+			ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "logs");
+
+	if (!m_part) {
+		return false;
+	}
+
+	m_seg_size = m_part->erase_size;
+	m_seg_num = m_part->size / m_seg_size;
+
+	// Resume after the newest segment from the previous session.
+	uint32_t seq_max = 0;
+	int seg_newest = -1;
+
+	for (int i = 0;i < m_seg_num;i++) {
+		uint16_t magic, crc;
+		uint32_t seq;
+		if (read_header(i, &magic, &crc, &seq) &&
+				magic == LOG_STORE_MAGIC && seq >= seq_max) {
+			seq_max = seq;
+			seg_newest = i;
+		}
+	}
+
+	return open_segment(seg_newest < 0 ? 0 : (seg_newest + 1) % m_seg_num,
+			seq_max + 1);
+}
+
+bool log_store_append(const uint8_t *data, uint16_t len) {
+	if (!m_part || len == 0 || len == 0xFFFF ||
+			(len + 2) > (m_seg_size - LOG_STORE_HEADER)) {
+		return false;
+	}
+
+	if ((m_seg_ofs + m_buf_pos + 2 + len) > (uint32_t)m_seg_size) {
+		if (!seal_segment()) {
+			return false;
+		}
+
+		if (!open_segment((m_seg_now + 1) % m_seg_num, m_seq_now + 1)) {
+			return false;
+		}
+	}
+
+	uint8_t prefix[2];
+	int32_t ind = 0;
+	buffer_append_uint16(prefix, len, &ind);
+
+	for (int i = 0;i < (2 + len);i++) {
+		m_buf[m_buf_pos++] = i < 2 ? prefix[i] : data[i - 2];
+		if (m_buf_pos == LOG_STORE_BUF) {
+			if (!flush_buf()) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool log_store_sync(void) {
+	return flush_buf();
+}
+
+int log_store_segment_num(void) {
+	return m_part ? m_seg_num : 0;
+}
+
+/*
+ * Copy the record stream (uint16 length prefixes included) of a
+ * segment into buf. Sealed segments are CRC-verified first. Returns
+ * the number of bytes copied, or -1 when the segment is empty, has
+ * never been written or fails its CRC. The segment currently open for
+ * writing can be read after log_store_sync.
+ */
+int log_store_read_segment(int seg, uint32_t *seq_out, uint8_t *buf, int buf_len) {
+	if (!m_part || seg < 0 || seg >= m_seg_num) {
+		return -1;
+	}
+
+	uint16_t magic, crc;
+	uint32_t seq;
+	if (!read_header(seg, &magic, &crc, &seq) || magic != LOG_STORE_MAGIC) {
+		return -1;
+	}
+
+	if (crc != 0xFFFF && data_crc(seg) != crc) {
+		return -1;
+	}
+
+	if (seq_out) {
+		*seq_out = seq;
+	}
+
+	// Walk the records to find the end of the valid stream.
+	int len_tot = 0;
+	for (;;) {
+		uint8_t prefix[2];
+		if ((LOG_STORE_HEADER + len_tot + 2) > m_seg_size) {
+			break;
+		}
+
+		if (esp_partition_read(m_part, seg * m_seg_size + LOG_STORE_HEADER + len_tot,
+				prefix, 2) != ESP_OK) {
+			return -1;
+		}
+
+		int32_t ind = 0;
+		uint16_t rlen = buffer_get_uint16(prefix, &ind);
+		if (rlen == 0xFFFF || (LOG_STORE_HEADER + len_tot + 2 + rlen) > m_seg_size) {
+			break;
+		}
+
+		len_tot += 2 + rlen;
+	}
+
+	if (len_tot == 0 || len_tot > buf_len) {
+		return -1;
+	}
+
+	if (esp_partition_read(m_part, seg * m_seg_size + LOG_STORE_HEADER,
+			buf, len_tot) != ESP_OK) {
+		return -1;
+	}
+
+	return len_tot;
+}
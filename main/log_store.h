@@ -0,0 +1,41 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAIN_LOG_STORE_H_
+#define MAIN_LOG_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Append-only segment store for log records on the logs partition.
+ * Writes are strictly sequential, each segment is one erase sector
+ * sealed with a CRC when full, and segments are recycled round-robin,
+ * so wear spreads evenly and there is no filesystem metadata to
+ * update. See log_store.c for the on-flash layout.
+ */
+
+// Functions
+bool log_store_init(void);
+bool log_store_append(const uint8_t *data, uint16_t len);
+bool log_store_sync(void);
+int log_store_segment_num(void);
+int log_store_read_segment(int seg, uint32_t *seq_out, uint8_t *buf, int buf_len);
+
+#endif /* MAIN_LOG_STORE_H_ */
@@ -20,11 +20,13 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "nvs_flash.h"
 #include "driver/uart.h"
 
 #include "conf_general.h"
 #include "comm_ble.h"
+#include "comm_service.h"
 #include "comm_uart.h"
 #include "comm_usb.h"
 #include "comm_can.h"
@@ -52,8 +54,13 @@
 #include "ublox.h"
 #include "nmea.h"
 #include "terminal.h"
+#include "task_stats.h"
 #include "main.h"
 #include "mempools.h"
+#include "heap_track.h"
+#include "gc_stats.h"
+#include "perf_snap.h"
+#include "stats.h"
 #include "lispif.h"
 #include "bms.h"
 #include "ble/custom_ble.h"
@@ -61,6 +68,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "VESC_MAIN";
 
@@ -70,16 +78,93 @@ volatile backup_data backup;
 // Private variables
 volatile static bool init_done = false;
 
+/*
+ * Waiters on full bring-up block on this event group instead of
+ * polling init_done, so they wake the moment the background init task
+ * finishes rather than on the next poll tick.
+ */
+static EventGroupHandle_t init_event_group;
+#define INIT_DONE_BIT						(1 << 0)
+
+/*
+ * Boot is staged so that the device answers its first packet in a few
+ * hundred milliseconds instead of after full bring-up. app_main only
+ * runs the comm-critical path (config load, pools, commands, CAN, USB
+ * and the comm UART); radios, GNSS, storage and LispBM come up in a
+ * background task in the same relative order they used to, off the
+ * critical path. init_done keeps its old meaning of "everything up",
+ * which is what lisp scripts wait on. Per-stage completion times are
+ * recorded and printed by the boot_stats terminal command.
+ */
+#define BOOT_STAGE_MAX						12
+
+typedef struct {
+	const char *name;
+	uint32_t done_ms;
+} boot_stage_t;
+
+static boot_stage_t boot_stages[BOOT_STAGE_MAX];
+static int boot_stage_num = 0;
+
+static void boot_stage_done(const char *name) {
+	if (boot_stage_num < BOOT_STAGE_MAX) {
+		boot_stages[boot_stage_num].name = name;
+		boot_stages[boot_stage_num].done_ms = esp_timer_get_time() / 1000;
+		boot_stage_num++;
+	}
+}
+
+/*
+ * The completed timeline is persisted to NVS at the end of init, so
+ * the previous boot stays inspectable after a crash or update and
+ * boot-time regressions can be compared between firmware releases.
+ */
+#define BOOT_REPORT_SIGNATURE		0x42545354
+#define BOOT_STAGE_NAME_LEN			16
+
+typedef struct {
+	uint32_t signature;
+	uint8_t fw_major;
+	uint8_t fw_minor;
+	uint8_t stage_num;
+	char names[BOOT_STAGE_MAX][BOOT_STAGE_NAME_LEN];
+	uint32_t done_ms[BOOT_STAGE_MAX];
+} boot_report_t;
+
+static void boot_report_store(void) {
+	boot_report_t rep = {0};
+	rep.signature = BOOT_REPORT_SIGNATURE;
+	rep.fw_major = FW_VERSION_MAJOR;
+	rep.fw_minor = FW_VERSION_MINOR;
+	rep.stage_num = boot_stage_num;
+
+	for (int i = 0;i < boot_stage_num;i++) {
+		strncpy(rep.names[i], boot_stages[i].name, BOOT_STAGE_NAME_LEN - 1);
+		rep.done_ms[i] = boot_stages[i].done_ms;
+	}
+
+	nvs_handle_t my_handle;
+	if (nvs_open("vesc", NVS_READWRITE, &my_handle) == ESP_OK) {
+		nvs_set_blob(my_handle, "boot_log", &rep, sizeof(rep));
+		nvs_commit(my_handle);
+		nvs_close(my_handle);
+	}
+}
+
 // Private functions
 static void terminal_nmea(int argc, const char **argv);
 static void terminal_ublox_reinit(int argc, const char **argv);
 static void terminal_debug_info(int argc, const char **argv);
 static void terminal_debug_level(int argc, const char **argv);
+static void terminal_boot_stats(int argc, const char **argv);
+static void init_bg_task(void *arg);
 
 void app_main(void) {
 	ESP_LOGI(TAG, "ESP32-C6 VESC Express starting...");
 	ESP_LOGI(TAG, "Chip model: ESP32-C6, BLE5.3 + WiFi6");
 	
+	init_event_group = xEventGroupCreate();
+
 	struct timeval tv;
 	gettimeofday(&tv, NULL);
 	tv.tv_sec = 0;
@@ -137,18 +222,72 @@ void app_main(void) {
 #endif
 
 	mempools_init();
+	heap_track_init();
+	gc_stats_init();
 	bms_init();
 	ESP_LOGI(TAG, "Initializing commands subsystem...");
 	commands_init();
-#ifdef CAN_TX_GPIO_NUM
+	task_stats_monitor_start();
+	perf_snap_init();
+#if HW_HAS_CAN
 	ESP_LOGI(TAG, "Starting CAN communication on GPIO%d/GPIO%d", CAN_TX_GPIO_NUM, CAN_RX_GPIO_NUM);
 	comm_can_start(CAN_TX_GPIO_NUM, CAN_RX_GPIO_NUM);
 #endif
+	comm_service_init();
 	ESP_LOGI(TAG, "Initializing USB communication...");
 	comm_usb_init();
 
 	vTaskDelay(1);
 
+	// The comm UART is part of the critical path; GNSS on the same
+	// pins is brought up in the background task instead.
+#if HW_HAS_UART && defined(HW_UART_COMM)
+	comm_uart_init(UART_TX, UART_RX, UART_NUM, UART_BAUDRATE);
+#endif
+
+	terminal_register_command_callback(
+			"nmea_info",
+			"Print NMEA message information",
+			0,
+			terminal_nmea);
+
+	terminal_register_command_callback(
+			"ublox_reinit",
+			"Re-initialize ublox gnss receiver",
+			0,
+			terminal_ublox_reinit);
+
+	// Memory-efficient debug commands using existing infrastructure
+	terminal_register_command_callback(
+			"debug_info",
+			"Show system debug information",
+			0,
+			terminal_debug_info);
+
+	terminal_register_command_callback(
+			"debug_level",
+			"Set/get debug log level (0-5)",
+			"[level]",
+			terminal_debug_level);
+
+	terminal_register_command_callback(
+			"boot_stats",
+			"Print boot stage completion times, or the stored previous boot",
+			"[last]",
+			terminal_boot_stats);
+
+	boot_stage_done("comm_ready");
+	ESP_LOGI(TAG, "Comm-critical init done, deferring radios, storage and lisp");
+
+	xTaskCreatePinnedToCore(init_bg_task, "init_bg", 3500, NULL, 6, NULL, tskNO_AFFINITY);
+
+	// Exit main to free up heap-space
+	vTaskDelete(NULL);
+}
+
+static void init_bg_task(void *arg) {
+	(void)arg;
+
 	ESP_LOGI(TAG, "BLE mode: %d", backup.config.ble_mode);
 	switch (backup.config.ble_mode) {
 		case BLE_MODE_DISABLED: {
@@ -168,6 +307,8 @@ void app_main(void) {
 		}
 	}
 
+	boot_stage_done("ble");
+
 	if (backup.config.wifi_mode != WIFI_MODE_DISABLED) {
 		comm_wifi_init();
 		
@@ -186,77 +327,79 @@ void app_main(void) {
 		*/
 	}
 
+	boot_stage_done("wifi");
+
 	nmea_init();
 	log_init();
-#ifdef SD_PIN_MOSI
+#if HW_HAS_SD_CARD
 	log_mount_card(SD_PIN_MOSI, SD_PIN_MISO, SD_PIN_SCK, SD_PIN_CS, SDMMC_FREQ_DEFAULT);
 #endif
-#ifdef NAND_PIN_MOSI
+#if HW_HAS_NAND_FLASH
 	log_mount_nand_flash(NAND_PIN_MOSI, NAND_PIN_MISO, NAND_PIN_SCK, NAND_PIN_CS, FLASH_FREQ_KHZ);
 #endif
 
+	stats_init();
+
+	boot_stage_done("storage");
+
 #ifndef HW_EARLY_LBM_INIT
 	HW_INIT_HOOK();
 	lispif_init();
 	HW_POST_LISPIF_HOOK();
 #endif
 
-#ifndef HW_NO_UART
-#ifdef HW_UART_COMM
-	comm_uart_init(UART_TX, UART_RX, UART_NUM, UART_BAUDRATE);
-#else
-	ublox_init(false, 500, UART_NUM, UART_RX, UART_TX);
-#endif
-#endif
-
-	terminal_register_command_callback(
-			"nmea_info",
-			"Print NMEA message information",
-			0,
-			terminal_nmea);
+	boot_stage_done("lisp");
 
-	terminal_register_command_callback(
-			"ublox_reinit",
-			"Re-initialize ublox gnss receiver",
-			0,
-			terminal_ublox_reinit);
-
-	// Memory-efficient debug commands using existing infrastructure
-	terminal_register_command_callback(
-			"debug_info",
-			"Show system debug information",
-			0,
-			terminal_debug_info);
+#if HW_HAS_UART && !defined(HW_UART_COMM)
+	ublox_init(false, 500, UART_NUM, UART_RX, UART_TX, false);
+#endif
 
-	terminal_register_command_callback(
-			"debug_level",
-			"Set/get debug log level (0-5)",
-			"[level]",
-			terminal_debug_level);
+	boot_stage_done("gnss");
 
 	init_done = true;
+	xEventGroupSetBits(init_event_group, INIT_DONE_BIT);
+	boot_stage_done("init_done");
+	boot_report_store();
 	ESP_LOGI(TAG, "VESC Express initialization complete!");
 
-	// Exit main to free up heap-space
 	vTaskDelete(NULL);
 }
 
-uint32_t main_calc_hw_crc(void) {
-	uint32_t crc = 0;
+/*
+ * The hardware CRC covers the generated config XML, which is constant
+ * for a given build, and the stored QML UI, so it only changes when the
+ * QML code partition is rewritten. VESC Tool asks for it on every
+ * connect; cache the answer and recompute lazily after invalidation
+ * instead of walking both blobs on every query.
+ */
+static volatile bool hw_crc_valid = false;
+static uint32_t hw_crc_cached = 0;
 
-	crc = crc32_with_init(
-			data_main_config_t_,
-			DATA_MAIN_CONFIG_T__SIZE,
-			crc);
+uint32_t main_calc_hw_crc(void) {
+	if (!hw_crc_valid) {
+		uint32_t crc = 0;
 
-	if (flash_helper_code_size(CODE_IND_QML) > 0) {
 		crc = crc32_with_init(
-				flash_helper_code_data_ptr(CODE_IND_QML),
-				flash_helper_code_size(CODE_IND_QML),
+				data_main_config_t_,
+				DATA_MAIN_CONFIG_T__SIZE,
 				crc);
+
+		if (flash_helper_code_size(CODE_IND_QML) > 0) {
+			crc = crc32_with_init(
+					flash_helper_code_data_ptr(CODE_IND_QML),
+					flash_helper_code_size(CODE_IND_QML),
+					crc);
+		}
+
+		hw_crc_cached = crc;
+		hw_crc_valid = true;
 	}
 
-	return crc;
+	return hw_crc_cached;
+}
+
+void main_invalidate_hw_crc(void) {
+	hw_crc_valid = false;
 }
 
 void main_store_backup_data(void) {
@@ -269,13 +412,58 @@ void main_store_backup_data(void) {
 	nvs_close(my_handle);
 }
 
+static void terminal_boot_stats(int argc, const char **argv) {
+	if (argc == 2 && strcmp(argv[1], "last") == 0) {
+		boot_report_t rep;
+		size_t size = sizeof(rep);
+		bool ok = false;
+
+		nvs_handle_t my_handle;
+		if (nvs_open("vesc", NVS_READONLY, &my_handle) == ESP_OK) {
+			ok = nvs_get_blob(my_handle, "boot_log", &rep, &size) == ESP_OK &&
+					size == sizeof(rep) &&
+					rep.signature == BOOT_REPORT_SIGNATURE &&
+					rep.stage_num <= BOOT_STAGE_MAX;
+			nvs_close(my_handle);
+		}
+
+		if (!ok) {
+			commands_printf("No stored boot report\n");
+			return;
+		}
+
+		commands_printf("Last completed boot (fw %d.%02d):", rep.fw_major, rep.fw_minor);
+		commands_printf("Stage            Done at (ms)");
+		commands_printf("-----------------------------");
+
+		for (int i = 0;i < rep.stage_num;i++) {
+			rep.names[i][BOOT_STAGE_NAME_LEN - 1] = '\0';
+			commands_printf("%-16s %12lu", rep.names[i], rep.done_ms[i]);
+		}
+
+		commands_printf(" ");
+		return;
+	}
+
+	commands_printf("Stage            Done at (ms)");
+	commands_printf("-----------------------------");
+
+	for (int i = 0;i < boot_stage_num;i++) {
+		commands_printf("%-16s %12lu",
+				boot_stages[i].name, boot_stages[i].done_ms);
+	}
+
+	commands_printf(" ");
+}
+
 bool main_init_done(void) {
 	return init_done;
 }
 
 void main_wait_until_init_done(void) {
 	while (!init_done) {
-		vTaskDelay(5 / portTICK_PERIOD_MS);
+		xEventGroupWaitBits(init_event_group, INIT_DONE_BIT,
+				pdFALSE, pdTRUE, portMAX_DELAY);
 	}
 }
 
@@ -373,5 +561,5 @@ static void terminal_nmea(int argc, const char **argv) {
 
 static void terminal_ublox_reinit(int argc, const char **argv) {
 	(void)argc;(void)argv;
-	commands_printf("Res: %d", ublox_init(true, 500, UART_NUM, UART_RX, UART_TX));
+	commands_printf("Res: %d", ublox_init(true, 500, UART_NUM, UART_RX, UART_TX, false));
 }
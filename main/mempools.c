@@ -19,36 +19,333 @@
 
 #include "mempools.h"
 #include "packet.h"
+#include "commands.h"
+#include "heap_track.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
+
+/*
+ * Packet buffers are handed out from lock-free size-classed pools. Each
+ * class has a bitmask of free slots that is claimed and released with
+ * atomic compare-exchange, so the CAN RX task and the WiFi TCP task can
+ * take buffers concurrently without a mutex and without priority
+ * inversion. Small telemetry replies come from the 64 and 256 byte
+ * classes and no longer tie up full-size buffers.
+ */
+
+#define POOL_NUM_SMALL			4
+#define POOL_NUM_MEDIUM			4
+#define POOL_NUM_LARGE			3
+
+#define POOL_SIZE_SMALL			64
+#define POOL_SIZE_MEDIUM		256
+#define POOL_SIZE_LARGE			PACKET_BUFFER_LEN
+
+#define POOL_SLOT_MAX			8
+
+typedef struct {
+	uint8_t *buffers;
+	unsigned int buffer_size;
+	unsigned int buffer_num;
+	volatile uint32_t free_mask;
+
+	// Statistics. Plain increments from the allocating tasks; a lost
+	// update under contention is acceptable for a diagnostics surface.
+	uint32_t stat_takes;
+	uint32_t stat_empty;
+	uint32_t stat_peak;
+	uint64_t hold_sum_us;
+	uint32_t hold_cnt;
+	uint32_t hold_max_us;
+	uint32_t take_time_us[POOL_SLOT_MAX];
+
+	// Reference count per slot. Taken buffers start at 1; extra views
+	// from mempools_buffer_ref keep the slot allocated until every view
+	// has been freed.
+	uint8_t refs[POOL_SLOT_MAX];
+} buffer_pool_t;
 
 // Private variables
+static uint8_t pool_small[POOL_NUM_SMALL][POOL_SIZE_SMALL];
+static uint8_t pool_medium[POOL_NUM_MEDIUM][POOL_SIZE_MEDIUM];
+static uint8_t pool_large[POOL_NUM_LARGE][POOL_SIZE_LARGE];
+
+static buffer_pool_t pools[] = {
+		{.buffers = (uint8_t*)pool_small, .buffer_size = POOL_SIZE_SMALL, .buffer_num = POOL_NUM_SMALL},
+		{.buffers = (uint8_t*)pool_medium, .buffer_size = POOL_SIZE_MEDIUM, .buffer_num = POOL_NUM_MEDIUM},
+		{.buffers = (uint8_t*)pool_large, .buffer_size = POOL_SIZE_LARGE, .buffer_num = POOL_NUM_LARGE},
+};
+
+#define POOL_NUM				(sizeof(pools) / sizeof(pools[0]))
+
+// Fallback buffer with the old mutex semantics, used when the large
+// pool is exhausted so callers never get NULL back.
 static uint8_t packet_buffer[PACKET_MAX_PL_LEN];
 static SemaphoreHandle_t packet_buffer_mutex;
 static uint8_t lbm_packet_buffer[PACKET_MAX_PL_LEN];
 static SemaphoreHandle_t lbm_packet_buffer_mutex;
 
+static uint32_t stat_legacy_takes = 0;
+static uint32_t stat_heap_allocs = 0;
+static uint32_t stat_failures = 0;
+
+// Private functions
+static uint8_t *pool_take(buffer_pool_t *pool) {
+	uint32_t mask = __atomic_load_n(&pool->free_mask, __ATOMIC_ACQUIRE);
+
+	while (mask != 0) {
+		int slot = __builtin_ctz(mask);
+		uint32_t bit = 1U << slot;
+
+		if (__atomic_compare_exchange_n(&pool->free_mask, &mask, mask & ~bit,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			pool->stat_takes++;
+
+			uint32_t used = pool->buffer_num -
+					__builtin_popcount(mask & ~bit);
+			if (used > pool->stat_peak) {
+				pool->stat_peak = used;
+			}
+
+			if (slot < POOL_SLOT_MAX) {
+				pool->take_time_us[slot] = (uint32_t)esp_timer_get_time();
+				pool->refs[slot] = 1;
+			}
+
+			return pool->buffers + (unsigned int)slot * pool->buffer_size;
+		}
+	}
+
+	pool->stat_empty++;
+	return 0;
+}
+
+static bool pool_give(buffer_pool_t *pool, uint8_t *buffer) {
+	uint8_t *start = pool->buffers;
+	uint8_t *end = start + pool->buffer_num * pool->buffer_size;
+
+	if (buffer < start || buffer >= end) {
+		return false;
+	}
+
+	int slot = (buffer - start) / pool->buffer_size;
+
+	if (slot < POOL_SLOT_MAX &&
+			__atomic_sub_fetch(&pool->refs[slot], 1, __ATOMIC_ACQ_REL) > 0) {
+		// Other views still hold the buffer
+		return true;
+	}
+
+	if (slot < POOL_SLOT_MAX && pool->take_time_us[slot] != 0) {
+		uint32_t hold = (uint32_t)esp_timer_get_time() - pool->take_time_us[slot];
+		pool->take_time_us[slot] = 0;
+		pool->hold_sum_us += hold;
+		pool->hold_cnt++;
+		if (hold > pool->hold_max_us) {
+			pool->hold_max_us = hold;
+		}
+	}
+
+	__atomic_fetch_or(&pool->free_mask, 1U << slot, __ATOMIC_RELEASE);
+	return true;
+}
+
 void mempools_init(void) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		pools[i].free_mask = (1U << pools[i].buffer_num) - 1;
+	}
+
 	packet_buffer_mutex = xSemaphoreCreateMutex();
 	lbm_packet_buffer_mutex = xSemaphoreCreateMutex();
 }
 
-uint8_t *mempools_get_packet_buffer(void) {
+/**
+ * Get a buffer with room for at least size bytes from the smallest pool
+ * that fits. Falls back to larger classes when the preferred class is
+ * empty and finally blocks on the legacy mutex-guarded buffer, so this
+ * never returns NULL for size <= PACKET_MAX_PL_LEN.
+ */
+uint8_t *mempools_get_buffer(unsigned int size) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		if (size > pools[i].buffer_size) {
+			continue;
+		}
+
+		uint8_t *res = pool_take(&pools[i]);
+		if (res) {
+			return res;
+		}
+	}
+
+	if (size > PACKET_MAX_PL_LEN) {
+		stat_failures++;
+		return 0;
+	}
+
+	stat_legacy_takes++;
 	xSemaphoreTake(packet_buffer_mutex, portMAX_DELAY);
 	return packet_buffer;
 }
 
+uint8_t *mempools_get_packet_buffer(void) {
+	return mempools_get_buffer(PACKET_MAX_PL_LEN);
+}
+
+/**
+ * Like mempools_get_buffer, but never blocks: when no pool buffer fits
+ * the allocation comes from the heap. Free with mempools_free_any.
+ */
+uint8_t *mempools_alloc_any(unsigned int size) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		if (size > pools[i].buffer_size) {
+			continue;
+		}
+
+		uint8_t *res = pool_take(&pools[i]);
+		if (res) {
+			return res;
+		}
+	}
+
+	uint8_t *res = heap_track_malloc("mempools_any", size);
+	if (res) {
+		stat_heap_allocs++;
+	} else {
+		stat_failures++;
+	}
+	return res;
+}
+
+void mempools_free_any(uint8_t *buffer) {
+	if (!buffer) {
+		return;
+	}
+
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		if (pool_give(&pools[i], buffer)) {
+			return;
+		}
+	}
+
+	if (buffer == packet_buffer) {
+		xSemaphoreGive(packet_buffer_mutex);
+	} else if (buffer == lbm_packet_buffer) {
+		xSemaphoreGive(lbm_packet_buffer_mutex);
+	} else {
+		heap_track_free("mempools_any", buffer);
+	}
+}
+
 uint8_t *mempools_get_lbm_packet_buffer(void) {
 	xSemaphoreTake(lbm_packet_buffer_mutex, portMAX_DELAY);
 	return lbm_packet_buffer;
 }
 
 void mempools_free_packet_buffer(uint8_t *buffer) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		if (pool_give(&pools[i], buffer)) {
+			return;
+		}
+	}
+
 	if (buffer == packet_buffer) {
 		xSemaphoreGive(packet_buffer_mutex);
 	} else if (buffer == lbm_packet_buffer) {
 		xSemaphoreGive(lbm_packet_buffer_mutex);
 	}
 }
+
+/**
+ * Take an extra reference on a pool-backed buffer, so several consumers
+ * can hold views into the same data; the slot is released when the last
+ * view is freed through any of the free functions. Returns false when
+ * the buffer is not pool-backed (heap or legacy fallback), in which
+ * case the caller has to copy instead.
+ */
+bool mempools_buffer_ref(uint8_t *buffer) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		buffer_pool_t *p = &pools[i];
+		uint8_t *start = p->buffers;
+		uint8_t *end = start + p->buffer_num * p->buffer_size;
+
+		if (buffer >= start && buffer < end) {
+			int slot = (buffer - start) / p->buffer_size;
+			if (slot >= POOL_SLOT_MAX) {
+				return false;
+			}
+
+			__atomic_add_fetch(&p->refs[slot], 1, __ATOMIC_ACQ_REL);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void mempools_stats_get(mempools_stats_t *stats) {
+	memset(stats, 0, sizeof(mempools_stats_t));
+
+	for (unsigned int i = 0;i < POOL_NUM && i < MEMPOOLS_STAT_POOL_NUM;i++) {
+		buffer_pool_t *p = &pools[i];
+		mempool_pool_stats_t *s = &stats->pools[i];
+
+		s->buffer_size = p->buffer_size;
+		s->buffer_num = p->buffer_num;
+		s->used_now = p->buffer_num - __builtin_popcount(p->free_mask);
+		s->used_peak = p->stat_peak;
+		s->takes = p->stat_takes;
+		s->empty_misses = p->stat_empty;
+		s->hold_avg_us = p->hold_cnt ? (uint32_t)(p->hold_sum_us / p->hold_cnt) : 0;
+		s->hold_max_us = p->hold_max_us;
+	}
+
+	stats->legacy_takes = stat_legacy_takes;
+	stats->heap_allocs = stat_heap_allocs;
+	stats->failures = stat_failures;
+}
+
+/**
+ * Print per-pool usage, pressure and hold-time statistics since boot or
+ * the last reset. Used by the pool_stats terminal command.
+ */
+void mempools_print_stats(void) {
+	mempools_stats_t stats;
+	mempools_stats_get(&stats);
+
+	commands_printf("size  num  used  peak      takes      empty  hold avg us  hold max us");
+	commands_printf("------------------------------------------------------------------------");
+
+	for (int i = 0;i < MEMPOOLS_STAT_POOL_NUM;i++) {
+		mempool_pool_stats_t *s = &stats.pools[i];
+		commands_printf("%4u %4u %5u %5u %10lu %10lu %12lu %12lu",
+				s->buffer_size, s->buffer_num, s->used_now, s->used_peak,
+				s->takes, s->empty_misses, s->hold_avg_us, s->hold_max_us);
+	}
+
+	commands_printf("Legacy takes  : %lu", stats.legacy_takes);
+	commands_printf("Heap allocs   : %lu", stats.heap_allocs);
+	commands_printf("Failures      : %lu", stats.failures);
+	commands_printf(" ");
+}
+
+void mempools_reset_stats(void) {
+	for (unsigned int i = 0;i < POOL_NUM;i++) {
+		buffer_pool_t *p = &pools[i];
+		p->stat_takes = 0;
+		p->stat_empty = 0;
+		p->stat_peak = 0;
+		p->hold_sum_us = 0;
+		p->hold_cnt = 0;
+		p->hold_max_us = 0;
+	}
+
+	stat_legacy_takes = 0;
+	stat_heap_allocs = 0;
+	stat_failures = 0;
+}
@@ -22,11 +22,39 @@
 
 #include "datatypes.h"
 
+// Number of buffer size classes reported in the statistics
+#define MEMPOOLS_STAT_POOL_NUM	3
+
+typedef struct {
+	uint16_t buffer_size;    // Buffer size of this class
+	uint8_t buffer_num;      // Buffers in this class
+	uint8_t used_now;        // Buffers taken right now
+	uint8_t used_peak;       // Most buffers taken at once since reset
+	uint32_t takes;          // Successful takes since reset
+	uint32_t empty_misses;   // Requests that found this class empty
+	uint32_t hold_avg_us;    // Average time a buffer was held
+	uint32_t hold_max_us;    // Longest time a buffer was held
+} mempool_pool_stats_t;
+
+typedef struct {
+	mempool_pool_stats_t pools[MEMPOOLS_STAT_POOL_NUM];
+	uint32_t legacy_takes;   // Blocking fallbacks to the mutex-guarded buffer
+	uint32_t heap_allocs;    // Heap fallbacks from mempools_alloc_any
+	uint32_t failures;       // Requests that returned NULL
+} mempools_stats_t;
+
 // Functions
 void mempools_init(void);
 
+uint8_t *mempools_get_buffer(unsigned int size);
+bool mempools_buffer_ref(uint8_t *buffer);
+uint8_t *mempools_alloc_any(unsigned int size);
+void mempools_free_any(uint8_t *buffer);
 uint8_t *mempools_get_packet_buffer(void);
 uint8_t *mempools_get_lbm_packet_buffer(void);
 void mempools_free_packet_buffer(uint8_t *buffer);
+void mempools_stats_get(mempools_stats_t *stats);
+void mempools_print_stats(void);
+void mempools_reset_stats(void);
 
 #endif /* MEMPOOLS_H_ */
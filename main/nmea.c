@@ -18,9 +18,10 @@
     */
 
 #include "nmea.h"
+#include "lispif.h"
 
 #include <string.h>
-#include <stdio.h>
+#include <math.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -31,6 +32,12 @@
 // Private variables
 static nmea_state_t m_state = {0};
 
+// Sequence lock for the derived values. The writer increments it to odd
+// before updating and to even after, readers retry while it is odd or
+// changes across their copy. Cheaper than a mutex since updates happen
+// once per navigation epoch and reads never block the decoder.
+static volatile uint32_t m_derived_seq = 0;
+
 void nmea_init(void) {
 	m_state.rmc.hh = -1;
 	m_state.rmc.mm = -1;
@@ -45,6 +52,58 @@ nmea_state_t* nmea_get_state(void) {
 	return &m_state;
 }
 
+void nmea_update_derived(void) {
+	nmea_derived_info_t d;
+
+	// Unix epoch from the RMC date and the GGA time of day. Computed
+	// with the days-from-civil algorithm rather than mktime, which
+	// consults the timezone database on every call.
+	if (m_state.rmc.yy >= 2000 && m_state.rmc.mo >= 1 && m_state.rmc.dd >= 1) {
+		int y = m_state.rmc.yy;
+		int m = m_state.rmc.mo;
+
+		if (m <= 2) {
+			y -= 1;
+		}
+
+		int era = y / 400;
+		int yoe = y - era * 400;
+		int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + m_state.rmc.dd - 1;
+		int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+		d.epoch_ms = days * INT64_C(86400000) + m_state.gga.ms_today;
+	} else {
+		d.epoch_ms = 0;
+	}
+
+	// Local tangent-plane scale factors on a spherical earth model,
+	// good to well under a percent over fusion-scale distances.
+	float m_per_deg = (float)(M_PI / 180.0 * 6371000.0);
+	d.m_per_deg_lat = m_per_deg;
+	d.m_per_deg_lon = m_per_deg * cosf((float)m_state.gga.lat * (float)(M_PI / 180.0));
+	d.update_time = xTaskGetTickCount();
+
+	m_derived_seq++;
+	m_state.derived = d;
+	m_derived_seq++;
+}
+
+void nmea_get_derived(nmea_derived_info_t *res) {
+	for (;;) {
+		uint32_t seq = m_derived_seq;
+		if (seq & 1) {
+			continue;
+		}
+
+		*res = m_state.derived;
+
+		if (seq == m_derived_seq) {
+			return;
+		}
+	}
+}
+
 const char* nmea_fix_type(void) {
 	switch (m_state.gga.fix_type) {
 		case 0: return "No fix";
@@ -72,6 +131,12 @@ bool nmea_decode_string(const char *data) {
 		m_state.gga.update_time = xTaskGetTickCount();
 		m_state.gga_cnt++;
 		ok = true;
+
+		// GGA arrives once per nav epoch, so this is where the
+		// per-epoch derived values are refreshed and the merged fix
+		// is handed to subscribed scripts as one coalesced event.
+		nmea_update_derived();
+		lispif_process_gnss();
 	}
 
 	if (gpgsv_res == 1) {
@@ -97,32 +162,170 @@ bool nmea_decode_string(const char *data) {
 	return ok;
 }
 
-static bool nmea_parse_val(char *str, double *val) {
-	int ind = -1;
-	int len = strlen(str);
-	bool retval = false;
+/*
+ * The decoders below walk each sentence in a single pass, in place, without
+ * allocating or copying anything. next_field returns a pointer to the start
+ * of the current field and advances *str past the delimiting comma, or
+ * returns 0 when the sentence is exhausted. Fields are parsed with the
+ * integer-accumulation routines below instead of sscanf, since the library
+ * conversions dominated the decode time of every fix.
+ */
+static const char *next_field(const char **str) {
+	const char *start = *str;
 
-	for (int i = 2;i < len;i++) {
-		if (str[i] == '.') {
-			ind = i - 2;
-			break;
+	if (!start) {
+		return 0;
+	}
+
+	const char *c = start;
+	while (*c != '\0' && *c != ',') {
+		c++;
+	}
+
+	*str = (*c == ',') ? (c + 1) : 0;
+	return start;
+}
+
+static bool parse_int_field(const char *s, int *out) {
+	bool neg = false;
+
+	if (*s == '-') {
+		neg = true;
+		s++;
+	} else if (*s == '+') {
+		s++;
+	}
+
+	if (*s < '0' || *s > '9') {
+		return false;
+	}
+
+	int val = 0;
+	while (*s >= '0' && *s <= '9') {
+		val = val * 10 + (*s++ - '0');
+	}
+
+	*out = neg ? -val : val;
+	return true;
+}
+
+static bool parse_float_field(const char *s, double *out) {
+	bool neg = false;
+	bool any = false;
+
+	if (*s == '-') {
+		neg = true;
+		s++;
+	} else if (*s == '+') {
+		s++;
+	}
+
+	uint32_t ip = 0;
+	while (*s >= '0' && *s <= '9') {
+		ip = ip * 10 + (*s++ - '0');
+		any = true;
+	}
+
+	double val = (double)ip;
+
+	if (*s == '.') {
+		s++;
+		uint32_t fp = 0;
+		uint32_t div = 1;
+		while (*s >= '0' && *s <= '9' && div < 1000000000) {
+			fp = fp * 10 + (*s++ - '0');
+			div *= 10;
+			any = true;
 		}
+		val += (double)fp / (double)div;
 	}
 
-	if (ind >= 0) {
-		char a[len + 1];
-		memcpy(a, str, ind);
-		a[ind] = ' ';
-		memcpy(a + ind + 1, str + ind, len - ind);
+	if (!any) {
+		return false;
+	}
 
-		double l1, l2;
-		if (sscanf(a, "%lf %lf", &l1, &l2) == 2) {
-			*val = l1 + l2 / D(60.0);
-			retval = true;
+	*out = neg ? -val : val;
+	return true;
+}
+
+/*
+ * Coordinate in [d]ddmm.mmmmm format, converted to decimal degrees. The
+ * degrees and whole minutes are accumulated as a single integer and split
+ * with a division, so no intermediate string is built.
+ */
+static bool parse_coord_field(const char *s, double *out) {
+	uint32_t dm = 0;
+	bool any = false;
+
+	while (*s >= '0' && *s <= '9') {
+		dm = dm * 10 + (*s++ - '0');
+		any = true;
+	}
+
+	if (!any || *s != '.') {
+		return false;
+	}
+
+	s++;
+	uint32_t fp = 0;
+	uint32_t div = 1;
+	while (*s >= '0' && *s <= '9' && div < 1000000000) {
+		fp = fp * 10 + (*s++ - '0');
+		div *= 10;
+	}
+
+	double min = (double)(dm % 100) + (double)fp / (double)div;
+	*out = (double)(dm / 100) + min / D(60.0);
+	return true;
+}
+
+// Time in hhmmss.ss format. The fraction is returned as the plain integer
+// after the decimal point, matching what sscanf("...%d") used to produce.
+static bool parse_time_field(const char *s, int *h, int *m, int *sec, int *frac) {
+	int val = 0;
+
+	for (int i = 0;i < 6;i++) {
+		if (*s < '0' || *s > '9') {
+			return false;
 		}
+		val = val * 10 + (*s++ - '0');
 	}
 
-	return retval;
+	if (*s++ != '.') {
+		return false;
+	}
+
+	if (*s < '0' || *s > '9') {
+		return false;
+	}
+
+	int f = 0;
+	while (*s >= '0' && *s <= '9') {
+		f = f * 10 + (*s++ - '0');
+	}
+
+	*h = val / 10000;
+	*m = (val / 100) % 100;
+	*sec = val % 100;
+	*frac = f;
+	return true;
+}
+
+// Date in ddmmyy format.
+static bool parse_date_field(const char *s, int *dd, int *mo, int *yy) {
+	int val = 0;
+
+	for (int i = 0;i < 6;i++) {
+		if (*s < '0' || *s > '9') {
+			return false;
+		}
+		val = val * 10 + (*s++ - '0');
+	}
+
+	*dd = val / 10000;
+	*mo = (val / 100) % 100;
+	*yy = val % 100;
+	return true;
 }
 
 /**
@@ -150,33 +353,23 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 
 	int dec_fields = 0;
 
-	bool found = false;
-	int len = strlen(data);
-	char *str_tmp = malloc(len + 1);
-
-	for (int i = 0;i < 10;i++) {
-		if ((i + 5) >= len) {
-			break;
-		}
+	const char *str = 0;
 
+	for (int i = 0;i < 10 && data[i] != '\0';i++) {
 		if (	data[i] == 'G' &&
 				data[i + 1] == 'G' &&
 				data[i + 2] == 'A' &&
 				data[i + 3] == ',') {
-			found = true;
-			strcpy(str_tmp, data + i + 4);
+			str = data + i + 4;
 			break;
 		}
 	}
 
-	if (found) {
-		char *token, *str;
+	if (str) {
+		const char *token;
 		int ind = 0;
 
-		str = str_tmp;
-		token = strsep(&str, ",");
-
-		while (token != 0) {
+		while ((token = next_field(&str)) != 0) {
 			if (token[0] == '*') {
 				break;
 			}
@@ -187,7 +380,7 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 				int h, m, s, ds;
 				dec_fields++;
 
-				if (sscanf(token, "%02d%02d%02d.%d", &h, &m, &s, &ds) == 4) {
+				if (parse_time_field(token, &h, &m, &s, &ds)) {
 					ms = h * 60 * 60 * 1000;
 					ms += m * 60 * 1000;
 					ms += s * 1000;
@@ -199,7 +392,7 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 
 			case 1: {
 				// Latitude
-				if (nmea_parse_val(token, &lat)) {
+				if (parse_coord_field(token, &lat)) {
 					dec_fields++;
 				}
 			} break;
@@ -214,7 +407,7 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 
 			case 3: {
 				// Longitude
-				if (nmea_parse_val(token, &lon)) {
+				if (parse_coord_field(token, &lon)) {
 					dec_fields++;
 				}
 			} break;
@@ -230,28 +423,30 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 			case 5:
 				// Fix type
 				dec_fields++;
-				if (sscanf(token, "%d", &fix_type) != 1) {
+				if (!parse_int_field(token, &fix_type)) {
 					fix_type = 0;
 				}
 				break;
 
 			case 6:
 				// Satellites
-				if (sscanf(token, "%d", &sats) == 1) {
+				if (parse_int_field(token, &sats)) {
 					dec_fields++;
 				}
 				break;
 
-			case 7:
+			case 7: {
 				// hdop
-				if (sscanf(token, "%f", &hdop) == 1) {
+				double v;
+				if (parse_float_field(token, &v)) {
+					hdop = v;
 					dec_fields++;
 				}
-				break;
+			} break;
 
 			case 8:
 				// Altitude
-				if (sscanf(token, "%lf", &height) == 1) {
+				if (parse_float_field(token, &height)) {
 					dec_fields++;
 				}
 				break;
@@ -260,7 +455,7 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 				// Altitude 2
 				double h2 = 0.0;
 				dec_fields++;
-				if (sscanf(token, "%lf", &h2) != 1) {
+				if (!parse_float_field(token, &h2)) {
 					h2 = 0.0;
 				}
 
@@ -269,8 +464,11 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 
 			case 12: {
 				// Correction age
+				double v;
 				dec_fields++;
-				if (sscanf(token, "%f", &diff_age) != 1) {
+				if (parse_float_field(token, &v)) {
+					diff_age = v;
+				} else {
 					diff_age = -1.0;
 				}
 			} break;
@@ -279,15 +477,12 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 				break;
 			}
 
-			token = strsep(&str, ",");
 			ind++;
 		}
 	} else {
 		dec_fields = -1;
 	}
 
-	free(str_tmp);
-
 	// 64-bit writes are not atomic
 	portDISABLE_INTERRUPTS();
 	gga->lat = lat;
@@ -328,35 +523,25 @@ int nmea_decode_gga(const char *data, nmea_gga_info_t *gga) {
 int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *gsv_info) {
 	int retval = -2;
 
-	bool found = false;
-	int len = strlen(data);
-	char *str_tmp = malloc(len + 1);
-
-	for (int i = 0;i < 10;i++) {
-		if ((i + 7) >= len) {
-			break;
-		}
+	const char *str = 0;
 
+	for (int i = 0;i < 10 && data[i] != '\0';i++) {
 		if (    data[i] == system_str[0] &&
 				data[i + 1] == system_str[1] &&
 				data[i + 2] == 'G' &&
 				data[i + 3] == 'S' &&
 				data[i + 4] == 'V' &&
 				data[i + 5] == ',') {
-			found = true;
-			strcpy(str_tmp, data + i + 6);
+			str = data + i + 6;
 			break;
 		}
 	}
 
-	if (found) {
-		char *token, *str;
+	if (str) {
+		const char *token;
 		int ind = 0;
 
-		str = str_tmp;
-		token = strsep(&str, ",");
-
-		while (token !=0) {
+		while ((token = next_field(&str)) != 0) {
 			if (token[0] == '*') {
 				break;
 			}
@@ -364,7 +549,7 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 			switch (ind) {
 			case 0: {
 				// Number of sentences
-				if (sscanf(token, "%d", &(gsv_info->sentences)) != 1) {
+				if (!parse_int_field(token, &(gsv_info->sentences))) {
 					gsv_info->sentences = 0;
 				}
 			} break;
@@ -372,7 +557,7 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 			case 1: {
 				// Sentence now
 				int sentence = 0;
-				if (sscanf(token, "%d", &sentence) != 1) {
+				if (!parse_int_field(token, &sentence)) {
 					sentence = 0;
 				}
 
@@ -383,7 +568,7 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 
 			case 2: {
 				// Sats
-				if (sscanf(token, "%d", &(gsv_info->sat_num)) != 1) {
+				if (!parse_int_field(token, &(gsv_info->sat_num))) {
 					gsv_info->sat_num = 0;
 				}
 			} break;
@@ -392,7 +577,7 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 				// PRN
 				if (gsv_info->sat_last < 32) {
 					int prn = 0;
-					sscanf(token, "%d", &prn);
+					parse_int_field(token, &prn);
 					gsv_info->sats[gsv_info->sat_last].prn = prn;
 				}
 			} break;
@@ -400,8 +585,8 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 			case 4: {
 				// Elevation
 				if (gsv_info->sat_last < 32) {
-					float elev = 0.0;
-					sscanf(token, "%f", &elev);
+					double elev = 0.0;
+					parse_float_field(token, &elev);
 					gsv_info->sats[gsv_info->sat_last].elevation = elev;
 				}
 			} break;
@@ -409,8 +594,8 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 			case 5: {
 				// Azimuth
 				if (gsv_info->sat_last < 32) {
-					float azimuth = 0.0;
-					sscanf(token, "%f", &azimuth);
+					double azimuth = 0.0;
+					parse_float_field(token, &azimuth);
 					gsv_info->sats[gsv_info->sat_last].azimuth = azimuth;
 				}
 			} break;
@@ -418,8 +603,8 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 			case 6: {
 				// SNR
 				if (gsv_info->sat_last < 32) {
-					float snr = 0.0;
-					sscanf(token, "%f", &snr);
+					double snr = 0.0;
+					parse_float_field(token, &snr);
 					gsv_info->sats[gsv_info->sat_last].snr = snr;
 					gsv_info->sat_last++;
 					ind = 2;
@@ -430,7 +615,6 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 				break;
 			}
 
-			token = strsep(&str, ",");
 			ind++;
 		}
 
@@ -443,8 +627,6 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 		retval = -1;
 	}
 
-	free(str_tmp);
-
 	return retval;
 }
 
@@ -500,33 +682,23 @@ int nmea_decode_rmc(const char *data, nmea_rmc_info_t *rmc) {
 
 	int dec_fields = 0;
 
-	bool found = false;
-	int len = strlen(data);
-	char *str_tmp = malloc(len + 1);
-
-	for (int i = 0;i < 10;i++) {
-		if ((i + 5) >= len) {
-			break;
-		}
+	const char *str = 0;
 
+	for (int i = 0;i < 10 && data[i] != '\0';i++) {
 		if (    data[i] == 'R' &&
 				data[i + 1] == 'M' &&
 				data[i + 2] == 'C' &&
 				data[i + 3] == ',') {
-			found = true;
-			strcpy(str_tmp, data + i + 4);
+			str = data + i + 4;
 			break;
 		}
 	}
 
-	if (found) {
-		char *token, *str;
+	if (str) {
+		const char *token;
 		int ind = 0;
 
-		str = str_tmp;
-		token = strsep(&str, ",");
-
-		while (token != 0) {
+		while ((token = next_field(&str)) != 0) {
 			if (token[0] == '*') {
 				break;
 			}
@@ -536,22 +708,24 @@ int nmea_decode_rmc(const char *data, nmea_rmc_info_t *rmc) {
 				// Time
 				dec_fields++;
 
-				if (sscanf(token, "%02d%02d%02d.%d", &hh, &mm, &ss, &ms) == 4) {
+				if (parse_time_field(token, &hh, &mm, &ss, &ms)) {
 					ms *= 10;
 				}
 			} break;
 
 			case 6: {
 				// Speed
-				sscanf(token, "%f", &speed);
-				speed *= 0.51444; // Knots to meters per second
+				double v;
+				if (parse_float_field(token, &v)) {
+					speed = v * 0.51444; // Knots to meters per second
+				}
 			} break;
 
 			case 8: {
 				// Date
 				dec_fields++;
 
-				if (sscanf(token, "%02d%02d%02d", &dd, &mo, &yy) == 3) {
+				if (parse_date_field(token, &dd, &mo, &yy)) {
 					yy += 2000;
 				}
 			} break;
@@ -560,7 +734,6 @@ int nmea_decode_rmc(const char *data, nmea_rmc_info_t *rmc) {
 				break;
 			}
 
-			token = strsep(&str, ",");
 			ind++;
 		}
 	} else {
@@ -576,7 +749,5 @@ int nmea_decode_rmc(const char *data, nmea_rmc_info_t *rmc) {
 	rmc->dd = dd;
 	rmc->speed = speed;
 
-	free(str_tmp);
-
 	return dec_fields;
 }
@@ -68,6 +68,13 @@ typedef struct {
 	uint32_t update_time;
 } nmea_rmc_info_t;
 
+typedef struct {
+	int64_t epoch_ms; // Unix time of the fix in ms, 0 when date or time is unknown
+	float m_per_deg_lat; // Meters per degree of latitude at the fix
+	float m_per_deg_lon; // Meters per degree of longitude at the fix
+	uint32_t update_time;
+} nmea_derived_info_t;
+
 typedef struct {
 	int gga_cnt;
 	int gsv_gp_cnt;
@@ -76,6 +83,7 @@ typedef struct {
 	nmea_gga_info_t gga;
 	nmea_gsv_info_t gsv;
 	nmea_rmc_info_t rmc;
+	nmea_derived_info_t derived;
 } nmea_state_t;
 
 // Functions
@@ -88,4 +96,14 @@ int nmea_decode_gsv(const char *system_str, const char *data, nmea_gsv_info_t *g
 void nmea_sync_gsv_info(nmea_gsv_info_t *old_info, nmea_gsv_info_t *new_info);
 int nmea_decode_rmc(const char *data, nmea_rmc_info_t *rmc);
 
+/*
+ * The derived values (unix epoch, meters-per-degree scaling) are computed
+ * once per navigation epoch by whatever fills the state - the NMEA decoder,
+ * the UBX PVT decoder or GNSS frames from CAN - so consumers never redo the
+ * date and trig math per query. nmea_get_derived copies them out under a
+ * sequence lock and is safe to call from any task.
+ */
+void nmea_update_derived(void);
+void nmea_get_derived(nmea_derived_info_t *res);
+
 #endif /* MAIN_NMEA_H_ */
@@ -0,0 +1,243 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "odometry.h"
+#include "nmea.h"
+#include "utils.h"
+#include "imu.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <math.h>
+#include <string.h>
+
+// Settings
+#define ODOM_RATE_HZ			100
+#define ODOM_GRAVITY			9.82
+
+// Complementary filter gains, applied once per GNSS update. The IMU
+// integration carries the state between updates.
+#define ODOM_POS_GAIN			0.2
+#define ODOM_VEL_GAIN			0.1
+
+/*
+ * Single-writer cell for samples from the IMU read callback. The writer
+ * keeps running totals (integrated derotated acceleration since start)
+ * instead of deltas, so the reader never has to write back: it remembers
+ * the totals it saw last time and differences them. The sequence counter
+ * is odd while a write is in progress, which lets the reader detect and
+ * retry torn reads without any locking.
+ */
+typedef struct {
+	volatile uint32_t seq;
+	volatile float vint[3];
+	volatile uint32_t samples;
+} imu_cell_t;
+
+// Private variables
+static imu_cell_t m_imu_cell;
+static volatile bool m_running = false;
+static volatile bool m_should_stop = false;
+static volatile bool m_task_running = false;
+
+// Fused output, same single-writer scheme with the odometry task writing
+static volatile uint32_t m_out_seq = 0;
+static odometry_state m_out_state = {0};
+
+// Private functions
+static void imu_cb(float *acc, float *gyro, float *mag, float dt);
+static void odom_task(void *arg);
+
+static void imu_cb(float *acc, float *gyro, float *mag, float dt) {
+	(void)gyro; (void)mag;
+
+	float acc_world[3];
+	imu_derotate(acc, acc_world);
+	acc_world[2] -= 1.0; // Remove gravity, accelerometer data is in G
+
+	m_imu_cell.seq++;
+	m_imu_cell.vint[0] += acc_world[0] * ODOM_GRAVITY * dt;
+	m_imu_cell.vint[1] += acc_world[1] * ODOM_GRAVITY * dt;
+	m_imu_cell.vint[2] += acc_world[2] * ODOM_GRAVITY * dt;
+	m_imu_cell.samples++;
+	m_imu_cell.seq++;
+}
+
+static bool imu_cell_read(float *vint_out) {
+	for (int i = 0;i < 5;i++) {
+		uint32_t s1 = m_imu_cell.seq;
+		vint_out[0] = m_imu_cell.vint[0];
+		vint_out[1] = m_imu_cell.vint[1];
+		vint_out[2] = m_imu_cell.vint[2];
+		if (!(s1 & 1) && s1 == m_imu_cell.seq) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void out_publish(const odometry_state *state) {
+	m_out_seq++;
+	m_out_state = *state;
+	m_out_seq++;
+}
+
+static void odom_task(void *arg) {
+	(void)arg;
+
+	odometry_state st = {0};
+
+	bool ref_set = false;
+	double lat_ref = 0.0, lon_ref = 0.0;
+	double height_ref = 0.0;
+
+	uint32_t gga_cnt_last = nmea_get_state()->gga_cnt;
+	uint32_t gnss_tick_last = xTaskGetTickCount();
+	float gnss_pos_last[3] = {0, 0, 0};
+	bool gnss_pos_last_set = false;
+
+	float vint_last[3] = {0, 0, 0};
+	imu_cell_read(vint_last);
+
+	const float dt = 1.0 / (float)ODOM_RATE_HZ;
+
+	while (!m_should_stop) {
+		// Predict: advance velocity by the acceleration integrated by the
+		// IMU callback since the last cycle, then advance position.
+		float vint[3];
+		if (imu_cell_read(vint)) {
+			for (int i = 0;i < 3;i++) {
+				st.vel[i] += vint[i] - vint_last[i];
+				vint_last[i] = vint[i];
+			}
+		}
+
+		for (int i = 0;i < 3;i++) {
+			st.pos[i] += st.vel[i] * dt;
+		}
+
+		// Correct: blend in GNSS position (and its derivative as velocity)
+		// whenever a new fix has arrived.
+		nmea_state_t *nmea = nmea_get_state();
+		if (nmea->gga_cnt != gga_cnt_last && nmea->gga.fix_type > 0) {
+			gga_cnt_last = nmea->gga_cnt;
+
+			double lat, lon;
+			portDISABLE_INTERRUPTS();
+			lat = nmea->gga.lat;
+			lon = nmea->gga.lon;
+			portENABLE_INTERRUPTS();
+			double height = nmea->gga.height;
+
+			if (!ref_set) {
+				lat_ref = lat;
+				lon_ref = lon;
+				height_ref = height;
+				ref_set = true;
+			}
+
+			// The scale factors are precomputed per epoch by the GNSS
+			// decoder, so no trig runs in the fusion loop.
+			nmea_derived_info_t der;
+			nmea_get_derived(&der);
+
+			float gnss_pos[3];
+			gnss_pos[0] = (float)(lon - lon_ref) * der.m_per_deg_lon;
+			gnss_pos[1] = (float)(lat - lat_ref) * der.m_per_deg_lat;
+			gnss_pos[2] = (float)(height - height_ref);
+
+			float dt_gnss = UTILS_AGE_S(gnss_tick_last);
+			gnss_tick_last = xTaskGetTickCount();
+
+			if (gnss_pos_last_set && dt_gnss > 0.01 && dt_gnss < 5.0) {
+				for (int i = 0;i < 3;i++) {
+					float vel_gnss = (gnss_pos[i] - gnss_pos_last[i]) / dt_gnss;
+					st.vel[i] += ODOM_VEL_GAIN * (vel_gnss - st.vel[i]);
+				}
+			}
+
+			for (int i = 0;i < 3;i++) {
+				st.pos[i] += ODOM_POS_GAIN * (gnss_pos[i] - st.pos[i]);
+				gnss_pos_last[i] = gnss_pos[i];
+			}
+			gnss_pos_last_set = true;
+
+			st.valid = true;
+		}
+
+		st.gnss_age = UTILS_AGE_S(gnss_tick_last);
+		out_publish(&st);
+
+		TickType_t delay_ticks = configTICK_RATE_HZ / ODOM_RATE_HZ;
+		vTaskDelay(delay_ticks > 0 ? delay_ticks : 1);
+	}
+
+	m_task_running = false;
+	vTaskDelete(NULL);
+}
+
+bool odometry_start(void) {
+	if (m_running) {
+		return true;
+	}
+
+	memset(&m_imu_cell, 0, sizeof(m_imu_cell));
+
+	odometry_state st = {0};
+	out_publish(&st);
+
+	imu_set_read_callback(imu_cb);
+
+	m_should_stop = false;
+	m_task_running = true;
+	m_running = true;
+	xTaskCreatePinnedToCore(odom_task, "odometry", 2048, NULL, 7, NULL, tskNO_AFFINITY);
+
+	return true;
+}
+
+void odometry_stop(void) {
+	if (!m_running) {
+		return;
+	}
+
+	imu_set_read_callback(NULL);
+
+	m_should_stop = true;
+	while (m_task_running) {
+		vTaskDelay(1);
+	}
+
+	m_running = false;
+}
+
+bool odometry_is_running(void) {
+	return m_running;
+}
+
+void odometry_get(odometry_state *state) {
+	for (int i = 0;i < 5;i++) {
+		uint32_t s1 = m_out_seq;
+		*state = m_out_state;
+		if (!(s1 & 1) && s1 == m_out_seq) {
+			return;
+		}
+	}
+}
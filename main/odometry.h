@@ -0,0 +1,40 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_ODOMETRY_H_
+#define MAIN_ODOMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fused position and velocity in a local ENU frame centered on the first
+// GNSS fix after start. Positions in meters, velocities in m/s.
+typedef struct {
+	float pos[3];
+	float vel[3];
+	float gnss_age;	// Seconds since the last GNSS correction
+	bool valid;		// True once a GNSS reference fix has been seen
+} odometry_state;
+
+bool odometry_start(void);
+void odometry_stop(void);
+bool odometry_is_running(void);
+void odometry_get(odometry_state *state);
+
+#endif /* MAIN_ODOMETRY_H_ */
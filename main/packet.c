@@ -18,12 +18,69 @@
     */
 
 #include <string.h>
+#include <stdlib.h>
 #include "packet.h"
 #include "crc.h"
+#include "mempools.h"
+#include "pkt_trace.h"
+#include "power_management_c6.h"
 
 // Private functions
 static int try_decode_packet(unsigned char *buffer, unsigned int in_len,
-		void(*process_func)(unsigned char *data, unsigned int len), int *bytes_left);
+		void(*process_func)(unsigned char *data, unsigned int len),
+		int *bytes_left, int integrity);
+static bool try_start_large_rx(PACKET_STATE_t *state);
+static unsigned int large_rx_process(PACKET_STATE_t *state,
+		const uint8_t *data, unsigned int len);
+static void large_rx_end(PACKET_STATE_t *state);
+
+// Draw the working buffers from mempools on first use. Idle transports
+// keep their PACKET_STATE_t but no buffers.
+static bool ensure_rx_buffer(PACKET_STATE_t *state) {
+	if (!state->rx_buffer) {
+		state->rx_buffer = mempools_alloc_any(PACKET_BUFFER_LEN);
+	}
+
+	return state->rx_buffer != 0;
+}
+
+static bool ensure_tx_buffer(PACKET_STATE_t *state) {
+	if (!state->tx_buffer) {
+		state->tx_buffer = mempools_alloc_any(PACKET_BUFFER_LEN);
+	}
+
+	return state->tx_buffer != 0;
+}
+
+// Compute the two check bytes for a payload in the given integrity
+// mode. The CRC16 dominates per-packet CPU on high-rate wired links
+// whose protocol already guarantees integrity, which is what the
+// cheaper modes are for; lossy links stay on full CRC.
+static unsigned short integrity_calc(const unsigned char *data, unsigned int len, int mode) {
+	if (mode == PACKET_INTEGRITY_SUM8) {
+		uint8_t sum = 0;
+		for (unsigned int i = 0;i < len;i++) {
+			sum += data[i];
+		}
+
+		return (unsigned short)sum << 8 | (unsigned short)(uint8_t)~sum;
+	}
+
+	if (mode == PACKET_INTEGRITY_NONE) {
+		return 0;
+	}
+
+	return crc16((unsigned char*)data, len);
+}
+
+static bool integrity_ok(const unsigned char *data, unsigned int len,
+		unsigned short chk_rx, int mode) {
+	if (mode == PACKET_INTEGRITY_NONE) {
+		return true;
+	}
+
+	return integrity_calc(data, len, mode) == chk_rx;
+}
 
 void packet_init(void (*s_func)(unsigned char *data, unsigned int len),
 		void (*p_func)(unsigned char *data, unsigned int len), PACKET_STATE_t *state) {
@@ -36,10 +93,113 @@ void packet_reset(PACKET_STATE_t *state) {
 	state->rx_read_ptr = 0;
 	state->rx_write_ptr = 0;
 	state->bytes_left = 0;
+	large_rx_end(state);
+}
+
+/**
+ * Return the RX/TX working buffers to mempools. Use when a transport is
+ * stopped; the buffers are allocated again on the next use.
+ */
+void packet_release_buffers(PACKET_STATE_t *state) {
+	packet_reset(state);
+
+	if (state->rx_buffer) {
+		mempools_free_any(state->rx_buffer);
+		state->rx_buffer = 0;
+	}
+
+	if (state->tx_buffer) {
+		mempools_free_any(state->tx_buffer);
+		state->tx_buffer = 0;
+	}
+}
+
+/**
+ * Raise the maximum payload length for this packet state above
+ * PACKET_MAX_PL_LEN. Intended to be negotiated per transport; payloads
+ * above PACKET_MAX_PL_LEN are then framed with the 16/24-bit length
+ * fields and reassembled into a heap buffer on reception, so OTA and
+ * script uploads can use multi-kilobyte chunks without growing every
+ * PACKET_STATE_t.
+ */
+void packet_set_max_len(PACKET_STATE_t *state, unsigned int max_len) {
+	if (max_len < PACKET_MAX_PL_LEN) {
+		max_len = PACKET_MAX_PL_LEN;
+	}
+
+	state->max_len = max_len;
+}
+
+unsigned int packet_get_max_len(PACKET_STATE_t *state) {
+	if (state->max_len < PACKET_MAX_PL_LEN) {
+		return PACKET_MAX_PL_LEN;
+	}
+
+	return state->max_len;
+}
+
+/**
+ * Switch the integrity mode for this packet state. Intended to be
+ * negotiated per transport; the peer must switch at the same protocol
+ * point, since frames carry no mode indication. Framing is unaffected.
+ */
+void packet_set_integrity(PACKET_STATE_t *state, int mode) {
+	if (mode < PACKET_INTEGRITY_CRC16 || mode > PACKET_INTEGRITY_NONE) {
+		return;
+	}
+
+	state->integrity = mode;
+}
+
+int packet_get_integrity(PACKET_STATE_t *state) {
+	return state->integrity;
 }
 
 void packet_send_packet(unsigned char *data, unsigned int len, PACKET_STATE_t *state) {
-	if (len == 0 || len > PACKET_MAX_PL_LEN) {
+	if (len == 0 || len > packet_get_max_len(state)) {
+		return;
+	}
+
+	pkt_trace_stage(PKT_TRACE_TX_QUEUE);
+
+	// Streaming mode: payloads above PACKET_MAX_PL_LEN do not fit in
+	// tx_buffer, so frame them in a temporary heap buffer.
+	if (len > PACKET_MAX_PL_LEN) {
+		uint8_t *buffer = malloc(len + 8);
+		if (!buffer) {
+			return;
+		}
+
+		int ind = 0;
+		if (len <= 65535) {
+			buffer[ind++] = 3;
+			buffer[ind++] = len >> 8;
+			buffer[ind++] = len & 0xFF;
+		} else {
+			buffer[ind++] = 4;
+			buffer[ind++] = len >> 16;
+			buffer[ind++] = (len >> 8) & 0xFF;
+			buffer[ind++] = len & 0xFF;
+		}
+
+		memcpy(buffer + ind, data, len);
+		ind += len;
+
+		unsigned short chk = integrity_calc(data, len, state->integrity);
+		buffer[ind++] = (uint8_t)(chk >> 8);
+		buffer[ind++] = (uint8_t)(chk & 0xFF);
+		buffer[ind++] = 3;
+
+		if (state->send_func) {
+			state->send_func(buffer, ind);
+		}
+
+		pkt_trace_stage(PKT_TRACE_TX_DONE);
+		free(buffer);
+		return;
+	}
+
+	if (!ensure_tx_buffer(state)) {
 		return;
 	}
 
@@ -62,17 +222,33 @@ void packet_send_packet(unsigned char *data, unsigned int len, PACKET_STATE_t *s
 	memcpy(state->tx_buffer + b_ind, data, len);
 	b_ind += len;
 
-	unsigned short crc = crc16(data, len);
-	state->tx_buffer[b_ind++] = (uint8_t)(crc >> 8);
-	state->tx_buffer[b_ind++] = (uint8_t)(crc & 0xFF);
+	unsigned short chk = integrity_calc(data, len, state->integrity);
+	state->tx_buffer[b_ind++] = (uint8_t)(chk >> 8);
+	state->tx_buffer[b_ind++] = (uint8_t)(chk & 0xFF);
 	state->tx_buffer[b_ind++] = 3;
 
 	if (state->send_func) {
 		state->send_func(state->tx_buffer, b_ind);
 	}
+
+	pkt_trace_stage(PKT_TRACE_TX_DONE);
 }
 
 void packet_process_byte(uint8_t rx_data, PACKET_STATE_t *state) {
+	// Boost the CPU clock before any parsing, so a packet arriving in
+	// an idle window is handled at full speed from the first byte.
+	pm_c6_note_comm_activity();
+
+	// An oversized packet is being reassembled into the heap buffer.
+	if (state->rx_large_buffer) {
+		large_rx_process(state, &rx_data, 1);
+		return;
+	}
+
+	if (!ensure_rx_buffer(state)) {
+		return;
+	}
+
 	unsigned int data_len = state->rx_write_ptr - state->rx_read_ptr;
 
 	// Out of space (should not happen)
@@ -106,8 +282,15 @@ void packet_process_byte(uint8_t rx_data, PACKET_STATE_t *state) {
 	// Try decoding the packet at various offsets until it succeeds, or
 	// until we run out of data.
 	for (;;) {
+		// A valid header longer than PACKET_MAX_PL_LEN switches to the
+		// streaming reassembly path when enabled for this state.
+		if (state->max_len > PACKET_MAX_PL_LEN && try_start_large_rx(state)) {
+			return;
+		}
+
 		int res = try_decode_packet(state->rx_buffer + state->rx_read_ptr,
-				data_len, state->process_func, &state->bytes_left);
+				data_len, state->process_func, &state->bytes_left,
+				state->integrity);
 
 		// More data is needed
 		if (res == -2) {
@@ -131,6 +314,301 @@ void packet_process_byte(uint8_t rx_data, PACKET_STATE_t *state) {
 	}
 }
 
+/**
+ * Frame a payload in place. The caller must have reserved
+ * PACKET_HEADROOM bytes before data and PACKET_TAILROOM bytes after
+ * data + len; the header is written into the headroom and CRC plus stop
+ * byte into the tailroom, so no payload copy is needed. Always frames
+ * with CRC16, since there is no state here; the raw zero-copy send
+ * paths are only registered for transports that keep the full CRC.
+ *
+ * @param data
+ * The payload, with reserved headroom and tailroom around it.
+ *
+ * @param len
+ * The payload length.
+ *
+ * @param start_out
+ * Set to the first byte of the framed packet.
+ *
+ * @param total_out
+ * Set to the total framed length.
+ *
+ * @return
+ * True on success, false if the length is invalid.
+ */
+bool packet_frame_in_place(unsigned char *data, unsigned int len,
+		unsigned char **start_out, unsigned int *total_out) {
+	if (len == 0) {
+		return false;
+	}
+
+	unsigned char *start;
+
+	if (len <= 255) {
+		start = data - 2;
+		start[0] = 2;
+		start[1] = len;
+	} else if (len <= 65535) {
+		start = data - 3;
+		start[0] = 3;
+		start[1] = len >> 8;
+		start[2] = len & 0xFF;
+	} else {
+		start = data - 4;
+		start[0] = 4;
+		start[1] = len >> 16;
+		start[2] = (len >> 8) & 0xFF;
+		start[3] = len & 0xFF;
+	}
+
+	unsigned short crc = crc16(data, len);
+	data[len] = (uint8_t)(crc >> 8);
+	data[len + 1] = (uint8_t)(crc & 0xFF);
+	data[len + 2] = 3;
+
+	*start_out = start;
+	*total_out = (data - start) + len + 3;
+
+	return true;
+}
+
+/**
+ * Send a payload without copying it. Same headroom/tailroom convention
+ * as packet_frame_in_place; the framed packet is handed to the send
+ * function of state as-is, skipping the tx_buffer memcpy that
+ * packet_send_packet does.
+ */
+void packet_send_packet_headroom(unsigned char *data, unsigned int len,
+		PACKET_STATE_t *state) {
+	if (len > packet_get_max_len(state)) {
+		return;
+	}
+
+	unsigned char *start;
+	unsigned int total;
+
+	if (!packet_frame_in_place(data, len, &start, &total)) {
+		return;
+	}
+
+	// packet_frame_in_place has no state and always writes CRC16;
+	// rewrite the check bytes when this transport negotiated another
+	// mode.
+	if (state->integrity != PACKET_INTEGRITY_CRC16) {
+		unsigned short chk = integrity_calc(data, len, state->integrity);
+		data[len] = (uint8_t)(chk >> 8);
+		data[len + 1] = (uint8_t)(chk & 0xFF);
+	}
+
+	if (state->send_func) {
+		state->send_func(start, total);
+	}
+}
+
+/**
+ * Process a whole buffer of received bytes at once. This is functionally
+ * equivalent to calling packet_process_byte for every byte, but takes bulk
+ * shortcuts where possible: leading garbage in front of a start byte is
+ * skipped with memchr-style scanning and the payload of a partially received
+ * packet is copied with a single memcpy instead of one state machine step
+ * per byte. This matters on fast links (3 Mbaud UART, TCP) where the RX
+ * path receives large DMA chunks.
+ *
+ * @param data
+ * The received bytes.
+ *
+ * @param len
+ * Number of received bytes.
+ *
+ * @param state
+ * The packet state to use.
+ */
+void packet_process_buffer(uint8_t *data, unsigned int len, PACKET_STATE_t *state) {
+	pm_c6_note_comm_activity();
+
+	if (!ensure_rx_buffer(state)) {
+		return;
+	}
+
+	while (len > 0) {
+		// Oversized packet in progress, consume in bulk.
+		if (state->rx_large_buffer) {
+			unsigned int consumed = large_rx_process(state, data, len);
+			data += consumed;
+			len -= consumed;
+			continue;
+		}
+
+		// Fast path 1: A packet header has been decoded and bytes_left bytes
+		// are known to belong to the current packet. Copy all but the last
+		// one in bulk; the last byte goes through packet_process_byte so
+		// that the decode attempt runs exactly as in the byte-wise path.
+		if (state->bytes_left > 1) {
+			unsigned int to_copy = (unsigned int)state->bytes_left - 1;
+			if (to_copy > len) {
+				to_copy = len;
+			}
+
+			unsigned int data_len = state->rx_write_ptr - state->rx_read_ptr;
+
+			// Shift buffer to make room, same alignment strategy as
+			// packet_process_byte.
+			if (state->rx_write_ptr + to_copy > PACKET_BUFFER_LEN) {
+				memmove(state->rx_buffer,
+						state->rx_buffer + state->rx_read_ptr,
+						data_len);
+				state->rx_read_ptr = 0;
+				state->rx_write_ptr = data_len;
+			}
+
+			// Out of space (should not happen)
+			if (state->rx_write_ptr + to_copy > PACKET_BUFFER_LEN) {
+				packet_reset(state);
+				continue;
+			}
+
+			memcpy(state->rx_buffer + state->rx_write_ptr, data, to_copy);
+			state->rx_write_ptr += to_copy;
+			state->bytes_left -= to_copy;
+
+			data += to_copy;
+			len -= to_copy;
+			continue;
+		}
+
+		// Fast path 2: Nothing is buffered, so the next packet must begin
+		// with a valid start byte (2, 3 or 4). Skip everything in front of
+		// the first candidate in one scan instead of one failed decode
+		// attempt per byte.
+		if (state->rx_read_ptr == state->rx_write_ptr && state->bytes_left == 0) {
+			unsigned int skip = 0;
+			while (skip < len && (data[skip] < 2 || data[skip] > 4)) {
+				skip++;
+			}
+
+			data += skip;
+			len -= skip;
+
+			if (len == 0) {
+				break;
+			}
+		}
+
+		packet_process_byte(*data++, state);
+		len--;
+	}
+}
+
+/**
+ * Check if the buffered data begins with a valid header for a payload
+ * longer than PACKET_MAX_PL_LEN but within the negotiated maximum. If
+ * so, allocate a reassembly buffer, move any already buffered payload
+ * bytes into it and enter streaming mode.
+ *
+ * @return
+ * True if streaming mode was entered.
+ */
+static bool try_start_large_rx(PACKET_STATE_t *state) {
+	unsigned char *buffer = state->rx_buffer + state->rx_read_ptr;
+	unsigned int in_len = state->rx_write_ptr - state->rx_read_ptr;
+
+	if (in_len < 1) {
+		return false;
+	}
+
+	unsigned int data_start = buffer[0];
+	if (data_start != 3 && data_start != 4) {
+		return false;
+	}
+
+	if (in_len < data_start) {
+		return false;
+	}
+
+	unsigned int len;
+	if (data_start == 3) {
+		len = (unsigned int)buffer[1] << 8 | (unsigned int)buffer[2];
+	} else {
+		len = (unsigned int)buffer[1] << 16 |
+				(unsigned int)buffer[2] << 8 |
+				(unsigned int)buffer[3];
+	}
+
+	if (len <= PACKET_MAX_PL_LEN || len > packet_get_max_len(state)) {
+		return false;
+	}
+
+	// Payload + crc + stop byte
+	uint8_t *large_buffer = malloc(len + 3);
+	if (!large_buffer) {
+		return false;
+	}
+
+	state->rx_large_buffer = large_buffer;
+	state->rx_large_len = len;
+	state->rx_large_ind = 0;
+
+	unsigned int have = in_len - data_start;
+	state->rx_read_ptr = 0;
+	state->rx_write_ptr = 0;
+	state->bytes_left = 0;
+
+	if (have > 0) {
+		large_rx_process(state, buffer + data_start, have);
+	}
+
+	return true;
+}
+
+/**
+ * Consume received bytes into the streaming reassembly buffer. When the
+ * packet is complete the stop byte and CRC are checked and the payload
+ * handed to process_func.
+ *
+ * @return
+ * Number of bytes consumed from data.
+ */
+static unsigned int large_rx_process(PACKET_STATE_t *state,
+		const uint8_t *data, unsigned int len) {
+	unsigned int total = state->rx_large_len + 3;
+	unsigned int left = total - state->rx_large_ind;
+	unsigned int to_copy = len < left ? len : left;
+
+	memcpy(state->rx_large_buffer + state->rx_large_ind, data, to_copy);
+	state->rx_large_ind += to_copy;
+
+	if (state->rx_large_ind == total) {
+		unsigned int pl_len = state->rx_large_len;
+		uint8_t *buf = state->rx_large_buffer;
+
+		if (buf[pl_len + 2] == 3) {
+			unsigned short chk_rx = (unsigned short)buf[pl_len] << 8
+									| (unsigned short)buf[pl_len + 1];
+
+			if (integrity_ok(buf, pl_len, chk_rx, state->integrity) &&
+					state->process_func) {
+				pkt_trace_stage(PKT_TRACE_PARSE);
+				state->process_func(buf, pl_len);
+			}
+		}
+
+		large_rx_end(state);
+	}
+
+	return to_copy;
+}
+
+static void large_rx_end(PACKET_STATE_t *state) {
+	if (state->rx_large_buffer) {
+		free(state->rx_large_buffer);
+	}
+
+	state->rx_large_buffer = 0;
+	state->rx_large_len = 0;
+	state->rx_large_ind = 0;
+}
+
 /**
  * Try if it is possible to decode a packet from a buffer.
  *
@@ -153,7 +631,8 @@ void packet_process_byte(uint8_t rx_data, PACKET_STATE_t *state) {
  * -2: OK so far, but not enough data
  */
 static int try_decode_packet(unsigned char *buffer, unsigned int in_len,
-		void(*process_func)(unsigned char *data, unsigned int len), int *bytes_left) {
+		void(*process_func)(unsigned char *data, unsigned int len),
+		int *bytes_left, int integrity) {
 	*bytes_left = 0;
 
 	if (in_len == 0) {
@@ -230,12 +709,12 @@ static int try_decode_packet(unsigned char *buffer, unsigned int in_len,
 		return -1;
 	}
 
-	unsigned short crc_calc = crc16(buffer + data_start, len);
-	unsigned short crc_rx = (unsigned short)buffer[data_start + len] << 8
+	unsigned short chk_rx = (unsigned short)buffer[data_start + len] << 8
 							| (unsigned short)buffer[data_start + len + 1];
 
-	if (crc_calc == crc_rx) {
+	if (integrity_ok(buffer + data_start, len, chk_rx, integrity)) {
 		if (process_func) {
+			pkt_trace_stage(PKT_TRACE_PARSE);
 			process_func(buffer + data_start, len);
 		}
 
@@ -30,6 +30,22 @@
 
 #define PACKET_BUFFER_LEN		(PACKET_MAX_PL_LEN + 8)
 
+// Headroom/tailroom that callers must reserve around the payload to use
+// the in-place framing functions.
+#define PACKET_HEADROOM			4
+#define PACKET_TAILROOM			3
+
+// Integrity modes, negotiated per transport. The frame layout is the
+// same in all modes - two check bytes before the stop byte - only how
+// they are computed and verified differs, so switching mode never
+// changes the framing. CRC16 is the default; SUM8 puts an 8-bit sum
+// and its complement in the check bytes as a cheap tripwire on links
+// with their own integrity layer (USB); NONE writes zeros and skips
+// verification entirely.
+#define PACKET_INTEGRITY_CRC16	0
+#define PACKET_INTEGRITY_SUM8	1
+#define PACKET_INTEGRITY_NONE	2
+
 // Types
 typedef struct {
 	void(*send_func)(unsigned char *data, unsigned int len);
@@ -37,15 +53,41 @@ typedef struct {
 	unsigned int rx_read_ptr;
 	unsigned int rx_write_ptr;
 	int bytes_left;
-	unsigned char rx_buffer[PACKET_BUFFER_LEN];
-	unsigned char tx_buffer[PACKET_BUFFER_LEN];
+
+	// RX/TX working buffers (PACKET_BUFFER_LEN each) are drawn from
+	// mempools on first use instead of being embedded here, so idle
+	// transports cost only the size of this struct.
+	unsigned char *rx_buffer;
+	unsigned char *tx_buffer;
+
+	// Streaming mode for payloads above PACKET_MAX_PL_LEN. max_len stays
+	// at PACKET_MAX_PL_LEN until raised per transport with
+	// packet_set_max_len; larger packets are then reassembled into a
+	// heap buffer instead of rx_buffer.
+	unsigned int max_len;
+	unsigned char *rx_large_buffer;
+	unsigned int rx_large_len;
+	unsigned int rx_large_ind;
+
+	// Integrity mode, PACKET_INTEGRITY_CRC16 unless negotiated.
+	int integrity;
 } PACKET_STATE_t;
 
 // Functions
 void packet_init(void (*s_func)(unsigned char *data, unsigned int len),
 		void (*p_func)(unsigned char *data, unsigned int len), PACKET_STATE_t *state);
 void packet_reset(PACKET_STATE_t *state);
+void packet_release_buffers(PACKET_STATE_t *state);
+void packet_set_max_len(PACKET_STATE_t *state, unsigned int max_len);
+unsigned int packet_get_max_len(PACKET_STATE_t *state);
+void packet_set_integrity(PACKET_STATE_t *state, int mode);
+int packet_get_integrity(PACKET_STATE_t *state);
 void packet_process_byte(uint8_t rx_data, PACKET_STATE_t *state);
+void packet_process_buffer(uint8_t *data, unsigned int len, PACKET_STATE_t *state);
 void packet_send_packet(unsigned char *data, unsigned int len, PACKET_STATE_t *state);
+bool packet_frame_in_place(unsigned char *data, unsigned int len,
+		unsigned char **start_out, unsigned int *total_out);
+void packet_send_packet_headroom(unsigned char *data, unsigned int len,
+		PACKET_STATE_t *state);
 
 #endif /* PACKET_H_ */
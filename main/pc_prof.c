@@ -0,0 +1,178 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "pc_prof.h"
+#include "commands.h"
+
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "riscv/csr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The sample interrupt reads the mepc CSR, which holds the program
+ * counter that was interrupted and is not rewritten until the handler
+ * returns. A dedicated gptimer is used instead of esp_timer so the
+ * capture really runs in interrupt context; esp_timer callbacks run in
+ * a task by default and would only ever sample the scheduler.
+ *
+ * The histogram is a fixed open-addressing table of address:count
+ * pairs with addresses bucketed to 4 bytes. With the firmware hot in a
+ * few hundred distinct sites, 1024 slots collide rarely; samples that
+ * fail to find a slot within the probe limit are counted as dropped
+ * rather than stretching the interrupt.
+ */
+
+#define PC_PROF_SLOTS		1024
+#define PC_PROF_PROBE_MAX	8
+
+typedef struct {
+	uint32_t addr;
+	uint32_t cnt;
+} pc_prof_slot_t;
+
+static pc_prof_slot_t *m_table = NULL;
+static gptimer_handle_t m_timer = NULL;
+static volatile bool m_running = false;
+static volatile uint32_t m_samples = 0;
+static volatile uint32_t m_dropped = 0;
+static uint32_t m_rate_hz = 0;
+
+static bool IRAM_ATTR pc_prof_isr(gptimer_handle_t timer,
+		const gptimer_alarm_event_data_t *edata, void *user_ctx) {
+	(void)timer; (void)edata; (void)user_ctx;
+
+	uint32_t pc = RV_READ_CSR(mepc) & ~(uint32_t)3;
+	m_samples++;
+
+	uint32_t ind = (pc >> 2) * 2654435761u;
+	for (int i = 0;i < PC_PROF_PROBE_MAX;i++) {
+		pc_prof_slot_t *slot = &m_table[(ind + i) & (PC_PROF_SLOTS - 1)];
+
+		if (slot->addr == pc) {
+			slot->cnt++;
+			return false;
+		}
+
+		if (slot->addr == 0) {
+			slot->addr = pc;
+			slot->cnt = 1;
+			return false;
+		}
+	}
+
+	m_dropped++;
+	return false;
+}
+
+bool pc_prof_start(uint32_t rate_hz) {
+	if (rate_hz < 10 || rate_hz > 20000 || m_running) {
+		return false;
+	}
+
+	if (m_table == NULL) {
+		m_table = calloc(PC_PROF_SLOTS, sizeof(pc_prof_slot_t));
+		if (m_table == NULL) {
+			return false;
+		}
+	} else {
+		memset(m_table, 0, PC_PROF_SLOTS * sizeof(pc_prof_slot_t));
+	}
+
+	m_samples = 0;
+	m_dropped = 0;
+	m_rate_hz = rate_hz;
+
+	if (m_timer == NULL) {
+		gptimer_config_t cfg = {
+				.clk_src = GPTIMER_CLK_SRC_DEFAULT,
+				.direction = GPTIMER_COUNT_UP,
+				.resolution_hz = 1000000,
+		};
+		if (gptimer_new_timer(&cfg, &m_timer) != ESP_OK) {
+			return false;
+		}
+
+		gptimer_event_callbacks_t cbs = {
+				.on_alarm = pc_prof_isr,
+		};
+		if (gptimer_register_event_callbacks(m_timer, &cbs, NULL) != ESP_OK) {
+			gptimer_del_timer(m_timer);
+			m_timer = NULL;
+			return false;
+		}
+	}
+
+	gptimer_alarm_config_t alarm = {
+			.alarm_count = 1000000 / rate_hz,
+			.reload_count = 0,
+			.flags.auto_reload_on_alarm = true,
+	};
+	if (gptimer_set_alarm_action(m_timer, &alarm) != ESP_OK) {
+		return false;
+	}
+
+	if (gptimer_enable(m_timer) != ESP_OK) {
+		return false;
+	}
+
+	if (gptimer_start(m_timer) != ESP_OK) {
+		gptimer_disable(m_timer);
+		return false;
+	}
+
+	m_running = true;
+	return true;
+}
+
+bool pc_prof_stop(void) {
+	if (!m_running) {
+		return false;
+	}
+
+	gptimer_stop(m_timer);
+	gptimer_disable(m_timer);
+	m_running = false;
+	return true;
+}
+
+void pc_prof_dump(void) {
+	if (m_table == NULL) {
+		commands_printf("pc_prof,info,samples=0");
+		return;
+	}
+
+	uint32_t used = 0;
+	for (int i = 0;i < PC_PROF_SLOTS;i++) {
+		if (m_table[i].addr != 0) {
+			used++;
+		}
+	}
+
+	commands_printf("pc_prof,info,samples=%lu,dropped=%lu,slots_used=%lu,rate_hz=%lu,running=%d",
+			m_samples, m_dropped, used, m_rate_hz, m_running);
+
+	for (int i = 0;i < PC_PROF_SLOTS;i++) {
+		if (m_table[i].addr != 0) {
+			commands_printf("pc_prof,0x%08lx,%lu", m_table[i].addr, m_table[i].cnt);
+		}
+	}
+}
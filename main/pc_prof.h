@@ -0,0 +1,49 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_PC_PROF_H_
+#define MAIN_PC_PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Whole-firmware sampling profiler. A periodic hardware timer
+ * interrupt captures the interrupted program counter into a compact
+ * address histogram, so hot spots anywhere in the image (including IDF
+ * code) show up without JTAG or instrumentation. The dump is
+ * address:count pairs meant to be resolved against the matching ELF
+ * offline, e.g. with addr2line. Start, stop and dump through the
+ * pc_prof terminal command.
+ */
+
+// Start sampling at the given rate. Restarting clears the previous
+// histogram. Returns false when the rate is invalid or the timer or
+// histogram could not be allocated.
+bool pc_prof_start(uint32_t rate_hz);
+
+// Stop sampling. The histogram is kept for dumping. Returns false when
+// the profiler was not running.
+bool pc_prof_stop(void);
+
+// Print the histogram as one CSV line per address. Works while
+// sampling is running, at the cost of slightly racy counts.
+void pc_prof_dump(void);
+
+#endif /* MAIN_PC_PROF_H_ */
@@ -0,0 +1,84 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "perf.h"
+#include "commands.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Singly linked list of sites that have been hit at least once. Sites
+// are static storage in their translation units, so only the links
+// live here.
+static perf_site_t *site_list = NULL;
+static portMUX_TYPE perf_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void perf_record(perf_site_t *site, uint32_t cycles) {
+	if (!site->registered) {
+		// First hit; link into the dump list. Only registration is
+		// locked. The counter updates themselves are unguarded: a
+		// lost sample under contention is acceptable for profiling
+		// and keeps the per-hit cost to a few loads and stores.
+		portENTER_CRITICAL(&perf_mux);
+		if (!site->registered) {
+			site->next = site_list;
+			site_list = site;
+			site->registered = true;
+		}
+		portEXIT_CRITICAL(&perf_mux);
+	}
+
+	site->count++;
+	site->cycles += cycles;
+	if (cycles > site->cycles_max) {
+		site->cycles_max = cycles;
+	}
+}
+
+void perf_print(void) {
+	if (site_list == NULL) {
+#ifdef PERF_INSTRUMENT
+		commands_printf("No instrumented sites hit yet");
+#else
+		commands_printf("Instrumentation compiled out; define PERF_INSTRUMENT");
+#endif
+		return;
+	}
+
+	commands_printf("%-20s %10s %12s %10s %10s", "Site", "Count", "Cycles", "Avg", "Max");
+	for (perf_site_t *s = site_list;s != NULL;s = s->next) {
+		commands_printf("%-20s %10lu %12llu %10lu %10lu",
+				s->name,
+				(unsigned long)s->count,
+				(unsigned long long)s->cycles,
+				(unsigned long)(s->count > 0 ? s->cycles / s->count : 0),
+				(unsigned long)s->cycles_max);
+	}
+	commands_printf(" ");
+}
+
+void perf_reset(void) {
+	portENTER_CRITICAL(&perf_mux);
+	for (perf_site_t *s = site_list;s != NULL;s = s->next) {
+		s->count = 0;
+		s->cycles = 0;
+		s->cycles_max = 0;
+	}
+	portEXIT_CRITICAL(&perf_mux);
+}
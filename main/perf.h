@@ -0,0 +1,70 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_PERF_H_
+#define MAIN_PERF_H_
+
+#include "conf_general.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Cycle-counter instrumentation for hot paths. PERF_ENTER/PERF_EXIT
+ * bracket a section with a name token; each site gets a static record
+ * that self-registers on first hit and aggregates count, total and max
+ * cycles. Dump and reset through the perf_stats terminal command.
+ *
+ * Compiled out unless PERF_INSTRUMENT is defined, so shipped builds
+ * pay nothing. Both macros must be in the same scope, and sections
+ * with early returns need the exit on each path.
+ */
+
+typedef struct perf_site {
+	const char *name;
+	uint32_t count;
+	uint64_t cycles;
+	uint32_t cycles_max;
+	struct perf_site *next;
+	bool registered;
+} perf_site_t;
+
+#ifdef PERF_INSTRUMENT
+
+#include "esp_cpu.h"
+
+#define PERF_ENTER(name) \
+	static perf_site_t perf_site_ ## name = {#name, 0, 0, 0, 0, false}; \
+	uint32_t perf_start_ ## name = esp_cpu_get_cycle_count()
+
+#define PERF_EXIT(name) \
+	perf_record(&perf_site_ ## name, esp_cpu_get_cycle_count() - perf_start_ ## name)
+
+#else
+
+#define PERF_ENTER(name)
+#define PERF_EXIT(name)
+
+#endif
+
+// Functions
+void perf_record(perf_site_t *site, uint32_t cycles);
+void perf_print(void);
+void perf_reset(void);
+
+#endif /* MAIN_PERF_H_ */
@@ -0,0 +1,196 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "perf_snap.h"
+#include "commands.h"
+#include "task_stats.h"
+#include "utils.h"
+
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Persistent performance snapshot ring for crash forensics. Every
+ * PERF_SNAP_PERIOD_MS a snapshot of heap levels, the command worker
+ * queue depth, the last packet ids seen by the dispatcher and the
+ * busiest tasks of the last stats window is written into a ring in RTC
+ * noinit memory, which survives watchdog and panic resets (not power
+ * cycles). After a field reset the perf_snap terminal command dumps
+ * the minutes leading up to the death, so performance-related resets
+ * can be analyzed post-mortem without a reproduction.
+ *
+ * Snapshots are tagged with a boot counter so pre-reset entries are
+ * distinguishable from ones taken since the restart. The ring is
+ * dropped on power-on resets (RTC memory content is undefined then)
+ * and whenever the signature does not match, e.g. after a firmware
+ * update that changed the layout.
+ */
+
+#define PERF_SNAP_SIGNATURE		0x50534E50 // 'PSNP'
+
+typedef struct {
+	char name[PERF_SNAP_TASK_NAME_LEN];
+	uint8_t load; // Percent of the last task stats window
+} snap_task_t;
+
+typedef struct {
+	uint32_t uptime_s;
+	uint16_t boot_cnt;
+	uint32_t heap_free;
+	uint32_t heap_min_free;
+	uint32_t heap_largest;
+	uint8_t worker_queue;
+	uint8_t pkt_ids[PERF_SNAP_PKT_ID_NUM];
+	uint8_t task_num;
+	snap_task_t tasks[PERF_SNAP_TASK_NUM];
+} perf_snap_t;
+
+typedef struct {
+	uint32_t signature;
+	uint32_t write_cnt;
+	uint16_t boot_cnt;
+	perf_snap_t snaps[PERF_SNAP_NUM];
+} perf_snap_ring_t;
+
+RTC_NOINIT_ATTR static perf_snap_ring_t m_ring;
+
+static esp_timer_handle_t m_timer = NULL;
+static int m_reset_reason = 0;
+// Scratch for the task query, too large for the timer task stack.
+static task_stats_t m_task_stats;
+
+static void perf_snap_sample(void *arg) {
+	(void)arg;
+
+	perf_snap_t *s = &m_ring.snaps[m_ring.write_cnt % PERF_SNAP_NUM];
+	memset(s, 0, sizeof(perf_snap_t));
+
+	s->uptime_s = (uint32_t)(utils_ms_tot() / 1000);
+	s->boot_cnt = m_ring.boot_cnt;
+	s->heap_free = esp_get_free_heap_size();
+	s->heap_min_free = esp_get_minimum_free_heap_size();
+	s->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+	s->worker_queue = commands_worker_queue_waiting();
+	commands_last_packet_ids(s->pkt_ids, PERF_SNAP_PKT_ID_NUM);
+
+	// Keep the busiest tasks of the last window. The deltas are since
+	// whoever queried last (the stack monitor also samples), but load
+	// is a ratio within the same interval so it stays meaningful.
+	if (task_stats_get(&m_task_stats) && m_task_stats.time_delta > 0) {
+		for (int n = 0;n < PERF_SNAP_TASK_NUM;n++) {
+			int best = -1;
+			for (int i = 0;i < m_task_stats.num_tasks;i++) {
+				if (m_task_stats.tasks[i].run_time_delta == 0) {
+					continue;
+				}
+				if (best < 0 || m_task_stats.tasks[i].run_time_delta >
+						m_task_stats.tasks[best].run_time_delta) {
+					best = i;
+				}
+			}
+
+			if (best < 0) {
+				break;
+			}
+
+			task_stat_t *t = &m_task_stats.tasks[best];
+			strncpy(s->tasks[n].name, t->name, PERF_SNAP_TASK_NAME_LEN - 1);
+			s->tasks[n].load = (uint8_t)((uint64_t)t->run_time_delta * 100 /
+					m_task_stats.time_delta);
+			s->task_num = n + 1;
+
+			t->run_time_delta = 0; // Taken, skip in the next pass
+		}
+	}
+
+	m_ring.write_cnt++;
+}
+
+void perf_snap_init(void) {
+	m_reset_reason = esp_reset_reason();
+
+	if (m_ring.signature != PERF_SNAP_SIGNATURE ||
+			m_reset_reason == ESP_RST_POWERON ||
+			m_reset_reason == ESP_RST_BROWNOUT) {
+		memset(&m_ring, 0, sizeof(m_ring));
+		m_ring.signature = PERF_SNAP_SIGNATURE;
+	}
+
+	m_ring.boot_cnt++;
+
+	const esp_timer_create_args_t args = {
+			.callback = perf_snap_sample,
+			.name = "perf_snap",
+	};
+
+	esp_timer_create(&args, &m_timer);
+	esp_timer_start_periodic(m_timer, (uint64_t)PERF_SNAP_PERIOD_MS * 1000);
+}
+
+void perf_snap_print(void) {
+	commands_printf("Boot: %u, reset reason: %d, snapshots: %lu (every %d s)",
+			m_ring.boot_cnt, m_reset_reason, m_ring.write_cnt,
+			PERF_SNAP_PERIOD_MS / 1000);
+
+	if (m_ring.write_cnt == 0) {
+		commands_printf("No snapshots yet");
+		commands_printf(" ");
+		return;
+	}
+
+	commands_printf("boot      t_s  heap_free   heap_min    largest wq pkt_last");
+	commands_printf("-------------------------------------------------------------");
+
+	uint32_t first = m_ring.write_cnt > PERF_SNAP_NUM ?
+			m_ring.write_cnt - PERF_SNAP_NUM : 0;
+
+	for (uint32_t cnt = first;cnt < m_ring.write_cnt;cnt++) {
+		perf_snap_t *s = &m_ring.snaps[cnt % PERF_SNAP_NUM];
+
+		commands_printf("%4u %8lu %10lu %10lu %10lu %2u %3u %3u %3u %3u",
+				s->boot_cnt, s->uptime_s, s->heap_free, s->heap_min_free,
+				s->heap_largest, s->worker_queue,
+				s->pkt_ids[0], s->pkt_ids[1], s->pkt_ids[2], s->pkt_ids[3]);
+
+		char line[120];
+		int pos = snprintf(line, sizeof(line), "     tasks:");
+		for (int i = 0;i < s->task_num;i++) {
+			pos += snprintf(line + pos, sizeof(line) - pos, " %s:%u%%",
+					s->tasks[i].name, s->tasks[i].load);
+			if (pos >= (int)sizeof(line)) {
+				break;
+			}
+		}
+		commands_printf("%s", line);
+	}
+
+	commands_printf(" ");
+}
+
+void perf_snap_reset(void) {
+	memset(&m_ring.snaps, 0, sizeof(m_ring.snaps));
+	m_ring.write_cnt = 0;
+}
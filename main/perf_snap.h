@@ -0,0 +1,38 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_PERF_SNAP_H_
+#define MAIN_PERF_SNAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Settings
+#define PERF_SNAP_NUM			12
+#define PERF_SNAP_PERIOD_MS		10000
+#define PERF_SNAP_TASK_NUM		6
+#define PERF_SNAP_TASK_NAME_LEN	8
+#define PERF_SNAP_PKT_ID_NUM	4
+
+// Functions
+void perf_snap_init(void);
+void perf_snap_print(void);
+void perf_snap_reset(void);
+
+#endif /* MAIN_PERF_SNAP_H_ */
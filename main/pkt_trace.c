@@ -0,0 +1,263 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "pkt_trace.h"
+#include "commands.h"
+#include "buffer.h"
+
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <string.h>
+
+/*
+ * A packet is processed synchronously within one task from transport
+ * RX to handler exit, so the in-flight trace context is found by task
+ * handle, same scheme as the command reply arenas. Commands that
+ * defer to the worker task record their TX stages against the worker
+ * context instead, which shows up as traces with missing stages;
+ * per-stage histograms stay correct because every stage is attributed
+ * the cycles since the previous stage recorded in the same context.
+ */
+
+#define TRACE_CTX_NUM		4
+#define TRACE_SAMPLE_NUM	8
+#define TRACE_BIN_NUM		32
+
+typedef struct {
+	TaskHandle_t task;
+	bool active;
+	uint32_t ts_last;
+	uint32_t dur[PKT_TRACE_STAGE_NUM];
+	uint8_t recorded; // Bitmask of recorded stages
+} trace_ctx_t;
+
+typedef struct {
+	uint32_t cnt;
+	uint64_t cycles;
+	uint32_t cycles_max;
+	uint32_t bins[TRACE_BIN_NUM];
+} stage_stats_t;
+
+typedef struct {
+	uint8_t recorded;
+	uint32_t dur[PKT_TRACE_STAGE_NUM];
+} trace_sample_t;
+
+static volatile bool m_enabled = false;
+static trace_ctx_t m_ctx[TRACE_CTX_NUM];
+static stage_stats_t m_stages[PKT_TRACE_STAGE_NUM];
+static trace_sample_t m_samples[TRACE_SAMPLE_NUM];
+static int m_sample_next = 0;
+static uint32_t m_traces = 0;
+static uint32_t m_ctx_misses = 0;
+
+// Folding happens from multiple comm tasks into shared aggregates.
+static portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *stage_names[PKT_TRACE_STAGE_NUM] = {
+		"rx", "parse", "dispatch", "tx_queue", "tx_done", "handler",
+};
+
+static trace_ctx_t *ctx_for_task(TaskHandle_t task, bool claim) {
+	for (int i = 0;i < TRACE_CTX_NUM;i++) {
+		if (m_ctx[i].active && m_ctx[i].task == task) {
+			return &m_ctx[i];
+		}
+	}
+
+	if (!claim) {
+		return NULL;
+	}
+
+	for (int i = 0;i < TRACE_CTX_NUM;i++) {
+		if (!m_ctx[i].active) {
+			m_ctx[i].task = task;
+			m_ctx[i].active = true;
+			m_ctx[i].recorded = 0;
+			memset(m_ctx[i].dur, 0, sizeof(m_ctx[i].dur));
+			return &m_ctx[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void fold_ctx(trace_ctx_t *ctx) {
+	portENTER_CRITICAL(&m_mux);
+
+	for (int i = 0;i < PKT_TRACE_STAGE_NUM;i++) {
+		if (!(ctx->recorded & (1 << i)) || i == PKT_TRACE_RX) {
+			continue;
+		}
+
+		stage_stats_t *st = &m_stages[i];
+		uint32_t dur = ctx->dur[i];
+
+		st->cnt++;
+		st->cycles += dur;
+		if (dur > st->cycles_max) {
+			st->cycles_max = dur;
+		}
+		st->bins[dur ? 31 - __builtin_clz(dur) : 0]++;
+	}
+
+	trace_sample_t *samp = &m_samples[m_sample_next];
+	m_sample_next = (m_sample_next + 1) % TRACE_SAMPLE_NUM;
+	samp->recorded = ctx->recorded;
+	memcpy(samp->dur, ctx->dur, sizeof(samp->dur));
+
+	m_traces++;
+
+	portEXIT_CRITICAL(&m_mux);
+
+	ctx->active = false;
+}
+
+void pkt_trace_enable(bool en) {
+	if (en && !m_enabled) {
+		pkt_trace_reset();
+	}
+	m_enabled = en;
+}
+
+bool pkt_trace_enabled(void) {
+	return m_enabled;
+}
+
+void pkt_trace_stage(pkt_trace_stage_t stage) {
+	if (!m_enabled) {
+		return;
+	}
+
+	uint32_t now = esp_cpu_get_cycle_count();
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+	if (stage == PKT_TRACE_RX) {
+		trace_ctx_t *ctx = ctx_for_task(task, false);
+		if (ctx) {
+			// The previous packet on this transport never completed
+			// (e.g. a command without a reply); fold what it recorded.
+			fold_ctx(ctx);
+		}
+
+		ctx = ctx_for_task(task, true);
+		if (ctx == NULL) {
+			m_ctx_misses++;
+			return;
+		}
+
+		ctx->ts_last = now;
+		ctx->recorded = 1 << PKT_TRACE_RX;
+		return;
+	}
+
+	trace_ctx_t *ctx = ctx_for_task(task, false);
+	if (ctx == NULL) {
+		// Unsolicited send (print, event) outside a traced packet.
+		return;
+	}
+
+	ctx->dur[stage] += now - ctx->ts_last;
+	ctx->ts_last = now;
+	ctx->recorded |= 1 << stage;
+
+	if (stage == PKT_TRACE_HANDLER) {
+		fold_ctx(ctx);
+	}
+}
+
+void pkt_trace_reset(void) {
+	portENTER_CRITICAL(&m_mux);
+	memset(m_stages, 0, sizeof(m_stages));
+	memset(m_samples, 0, sizeof(m_samples));
+	m_sample_next = 0;
+	m_traces = 0;
+	m_ctx_misses = 0;
+	portEXIT_CRITICAL(&m_mux);
+}
+
+void pkt_trace_print(void) {
+	commands_printf("Packet traces: %lu (enabled: %d, ctx misses: %lu)",
+			m_traces, m_enabled, m_ctx_misses);
+
+	for (int i = 1;i < PKT_TRACE_STAGE_NUM;i++) {
+		stage_stats_t *st = &m_stages[i];
+		if (st->cnt == 0) {
+			continue;
+		}
+
+		commands_printf(" ");
+		commands_printf("Stage %s: cnt %lu, avg %lu cycles, max %lu cycles",
+				stage_names[i], st->cnt,
+				(uint32_t)(st->cycles / st->cnt), st->cycles_max);
+
+		for (int b = 0;b < TRACE_BIN_NUM;b++) {
+			if (st->bins[b] > 0) {
+				commands_printf("  2^%02d cycles: %lu", b, st->bins[b]);
+			}
+		}
+	}
+
+	commands_printf(" ");
+	commands_printf("Recent traces (cycles per stage):");
+	for (int i = 0;i < TRACE_SAMPLE_NUM;i++) {
+		trace_sample_t *samp = &m_samples[(m_sample_next + i) % TRACE_SAMPLE_NUM];
+		if (samp->recorded == 0) {
+			continue;
+		}
+
+		commands_printf("  parse %lu, dispatch %lu, tx_queue %lu, tx_done %lu, handler %lu",
+				samp->dur[PKT_TRACE_PARSE], samp->dur[PKT_TRACE_DISPATCH],
+				samp->dur[PKT_TRACE_TX_QUEUE], samp->dur[PKT_TRACE_TX_DONE],
+				samp->dur[PKT_TRACE_HANDLER]);
+	}
+}
+
+/*
+ * Binary report for the stats packet: per-stage count/avg/max plus the
+ * sampled full traces, compact enough for one reply packet. The
+ * histograms are terminal-only.
+ */
+int pkt_trace_report(uint8_t *buffer) {
+	int32_t ind = 0;
+
+	buffer_append_uint32(buffer, m_traces, &ind);
+	buffer[ind++] = PKT_TRACE_STAGE_NUM;
+	buffer[ind++] = TRACE_SAMPLE_NUM;
+
+	for (int i = 1;i < PKT_TRACE_STAGE_NUM;i++) {
+		stage_stats_t *st = &m_stages[i];
+		buffer_append_uint32(buffer, st->cnt, &ind);
+		buffer_append_uint32(buffer,
+				st->cnt > 0 ? (uint32_t)(st->cycles / st->cnt) : 0, &ind);
+		buffer_append_uint32(buffer, st->cycles_max, &ind);
+	}
+
+	for (int i = 0;i < TRACE_SAMPLE_NUM;i++) {
+		trace_sample_t *samp = &m_samples[(m_sample_next + i) % TRACE_SAMPLE_NUM];
+		buffer[ind++] = samp->recorded;
+		for (int s = 1;s < PKT_TRACE_STAGE_NUM;s++) {
+			buffer_append_uint32(buffer, samp->dur[s], &ind);
+		}
+	}
+
+	return ind;
+}
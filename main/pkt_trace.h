@@ -0,0 +1,56 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_PKT_TRACE_H_
+#define MAIN_PKT_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Optional packet lifecycle tracing. Cycle timestamps are captured at
+ * fixed stages as a packet moves through the firmware, so end-to-end
+ * latency decomposes into parsing, dispatch, handler and transmit
+ * time. Each stage is attributed the cycles since the previous
+ * recorded stage, which keeps the accounting correct for commands that
+ * send no reply or skip stages. Aggregated into per-stage log2
+ * histograms plus a ring of recent full traces; disabled by default
+ * and costing one branch per stage call when off. Control and dump
+ * through the pkt_trace terminal command or the stats packet.
+ */
+
+typedef enum {
+	PKT_TRACE_RX = 0,		// Transport delivered raw bytes
+	PKT_TRACE_PARSE,		// Packet framing validated, payload extracted
+	PKT_TRACE_DISPATCH,		// Command dispatcher entered
+	PKT_TRACE_TX_QUEUE,		// Reply framing started (handler compute done)
+	PKT_TRACE_TX_DONE,		// Reply handed to the transport driver
+	PKT_TRACE_HANDLER,		// Command dispatcher exited
+	PKT_TRACE_STAGE_NUM,
+} pkt_trace_stage_t;
+
+// Functions
+void pkt_trace_enable(bool en);
+bool pkt_trace_enabled(void);
+void pkt_trace_stage(pkt_trace_stage_t stage);
+void pkt_trace_reset(void);
+void pkt_trace_print(void);
+int pkt_trace_report(uint8_t *buffer);
+
+#endif /* MAIN_PKT_TRACE_H_ */
@@ -31,11 +31,133 @@
 #include "soc/gpio_reg.h"
 #include "soc/rtc.h"
 
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
 static const char *TAG = "PM_C6";
 static pm_c6_config_t current_config = PM_C6_CONFIG_DEFAULT();
 static pm_c6_mode_t current_mode = PM_C6_MODE_ACTIVE;
 static pm_c6_wake_source_t last_wake_source = PM_C6_WAKE_TIMER;
 
+// Load-adaptive frequency scaling. esp_pm scales the CPU between
+// min_freq and max_freq based on held locks, so the closed loop is:
+// acquire a CPU_FREQ_MAX lock the moment the first RX byte of a packet
+// is seen (pm_c6_note_comm_activity, hooked in packet.c), and release
+// it once no comm activity has been seen for DVFS_IDLE_RELEASE_MS.
+// The boost is taken on the receiving task before any parsing, so a
+// packet arriving in an idle window is processed at full clock from the
+// first byte and power-save mode adds no measurable comm latency.
+#define DVFS_IDLE_RELEASE_MS	200
+#define DVFS_IDLE_CHECK_MS		50
+
+// Connected light sleep. The stock pm_c6_enter_light_sleep powers the
+// crystal domain down hard, which drops the modem far enough that WiFi
+// has to re-associate and BLE supervision times out on wake. The
+// connected variant keeps the modem-relevant domains under automatic
+// control so the C6's MAC/baseband retention preserves association and
+// connection state, and enables radio wakeup so a peer packet ends the
+// sleep instead of timing the session out. Wake-to-first-packet latency
+// is stamped when the next packet byte arrives (pm_c6_note_comm_activity)
+// and reported through pm_c6_get_wake_latency_us / the power stats.
+static volatile int64_t wake_time_us = 0;
+static volatile bool wake_latency_pending = false;
+static volatile uint32_t last_wake_latency_us = 0;
+
+static esp_pm_lock_handle_t dvfs_max_lock = NULL;
+static esp_timer_handle_t dvfs_idle_timer = NULL;
+static volatile int64_t dvfs_last_activity = 0;
+static volatile bool dvfs_boosted = false;
+static volatile bool dvfs_enabled = false;
+static portMUX_TYPE dvfs_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void dvfs_idle_timer_cb(void *arg) {
+    (void)arg;
+
+    bool release = false;
+
+    portENTER_CRITICAL(&dvfs_mux);
+    if (dvfs_boosted &&
+        (esp_timer_get_time() - dvfs_last_activity) >
+            (int64_t)DVFS_IDLE_RELEASE_MS * 1000) {
+        dvfs_boosted = false;
+        release = true;
+    }
+    portEXIT_CRITICAL(&dvfs_mux);
+
+    if (release) {
+        esp_pm_lock_release(dvfs_max_lock);
+    }
+}
+
+void pm_c6_dvfs_enable(bool enable) {
+    if (enable && dvfs_max_lock == NULL) {
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0,
+                "comm_boost", &dvfs_max_lock) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to create DVFS boost lock");
+            return;
+        }
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = dvfs_idle_timer_cb,
+            .name = "pm_dvfs_idle",
+        };
+        esp_timer_create(&timer_args, &dvfs_idle_timer);
+    }
+
+    if (dvfs_max_lock == NULL) {
+        return;
+    }
+
+    if (enable && !dvfs_enabled) {
+        dvfs_enabled = true;
+        esp_timer_start_periodic(dvfs_idle_timer, DVFS_IDLE_CHECK_MS * 1000);
+        ESP_LOGI(TAG, "Load-adaptive frequency scaling enabled");
+    } else if (!enable && dvfs_enabled) {
+        dvfs_enabled = false;
+        esp_timer_stop(dvfs_idle_timer);
+
+        bool release = false;
+        portENTER_CRITICAL(&dvfs_mux);
+        if (dvfs_boosted) {
+            dvfs_boosted = false;
+            release = true;
+        }
+        portEXIT_CRITICAL(&dvfs_mux);
+
+        if (release) {
+            esp_pm_lock_release(dvfs_max_lock);
+        }
+
+        ESP_LOGI(TAG, "Load-adaptive frequency scaling disabled");
+    }
+}
+
+void pm_c6_note_comm_activity(void) {
+    if (wake_latency_pending) {
+        wake_latency_pending = false;
+        last_wake_latency_us = (uint32_t)(esp_timer_get_time() - wake_time_us);
+        ESP_LOGD(TAG, "Wake-to-first-packet: %lu us", last_wake_latency_us);
+    }
+
+    if (!dvfs_enabled) {
+        return;
+    }
+
+    bool acquire = false;
+
+    portENTER_CRITICAL(&dvfs_mux);
+    dvfs_last_activity = esp_timer_get_time();
+    if (!dvfs_boosted) {
+        dvfs_boosted = true;
+        acquire = true;
+    }
+    portEXIT_CRITICAL(&dvfs_mux);
+
+    if (acquire) {
+        esp_pm_lock_acquire(dvfs_max_lock);
+    }
+}
+
 void pm_c6_init(void) {
     ESP_LOGI(TAG, "Initializing ESP32-C6 power management (Research-Enhanced)");
     
@@ -67,7 +189,13 @@ void pm_c6_init(void) {
     if (current_config.gpio_hold_mask != 0) {
         pm_c6_configure_gpio_power_management();
     }
-    
+
+    // Close the DVFS loop: packet RX boosts to max clock immediately,
+    // idle windows drop back to min_freq_mhz
+    if (current_config.dynamic_freq_scaling) {
+        pm_c6_dvfs_enable(true);
+    }
+
     ESP_LOGI(TAG, "ESP32-C6 research-enhanced power management initialized");
 }
 
@@ -176,6 +304,54 @@ void pm_c6_enter_light_sleep(uint32_t duration_ms) {
     }
 }
 
+bool pm_c6_enter_connected_light_sleep(uint32_t duration_ms) {
+    ESP_LOGI(TAG, "Entering connected light sleep for %lu ms", duration_ms);
+
+    // Keep the crystal and fast oscillator under automatic control so
+    // the modem retention can keep WiFi association and BLE connection
+    // state alive across the sleep, instead of the hard XTAL power-down
+    // used for the unconnected modes.
+    esp_sleep_pd_config(ESP_PD_DOMAIN_XTAL, ESP_PD_OPTION_AUTO);
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_AUTO);
+#if SOC_PM_SUPPORT_MODEM_PD
+    esp_sleep_pd_config(ESP_PD_DOMAIN_MODEM, ESP_PD_OPTION_AUTO);
+#endif
+
+    // Wake on radio activity so a peer packet ends the sleep
+    esp_sleep_enable_wifi_wakeup();
+    esp_sleep_enable_bt_wakeup();
+
+    if (duration_ms > 0) {
+        esp_sleep_enable_timer_wakeup((uint64_t)duration_ms * 1000);
+    }
+
+    if (current_config.gpio_hold_mask != 0) {
+        pm_c6_gpio_hold_all();
+    }
+
+    esp_err_t ret = esp_light_sleep_start();
+
+    wake_time_us = esp_timer_get_time();
+    wake_latency_pending = true;
+    last_wake_source = pm_c6_get_last_wake_source();
+
+    if (current_config.gpio_hold_mask != 0) {
+        pm_c6_gpio_unhold_all();
+    }
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Connected light sleep failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Woke from connected light sleep, source: %d", last_wake_source);
+    return true;
+}
+
+uint32_t pm_c6_get_wake_latency_us(void) {
+    return last_wake_latency_us;
+}
+
 void pm_c6_enter_deep_sleep(uint32_t duration_ms) {
     ESP_LOGI(TAG, "Entering deep sleep for %lu ms", duration_ms);
     
@@ -303,6 +479,7 @@ void pm_c6_print_power_stats(void) {
     ESP_LOGI(TAG, "  Auto Light Sleep: %s", current_config.auto_light_sleep ? "Yes" : "No");
     ESP_LOGI(TAG, "  Estimated Consumption: %lu mA", pm_c6_get_power_consumption_estimate());
     ESP_LOGI(TAG, "  Last Wake Source: %d", last_wake_source);
+    ESP_LOGI(TAG, "  Last Wake-to-First-Packet: %lu us", last_wake_latency_us);
     
     // Additional power-related information
     ESP_LOGI(TAG, "Power Optimization Features:");
@@ -92,9 +92,18 @@ pm_c6_mode_t pm_c6_get_mode(void);
 
 // Sleep functions
 void pm_c6_enter_light_sleep(uint32_t duration_ms);
+// Light sleep that keeps WiFi association and BLE connections alive via
+// the C6's modem retention. Wakes on radio activity or the timer; the
+// wake-to-first-packet latency is available afterwards.
+bool pm_c6_enter_connected_light_sleep(uint32_t duration_ms);
+uint32_t pm_c6_get_wake_latency_us(void);
 void pm_c6_enter_deep_sleep(uint32_t duration_ms);
 void pm_c6_configure_wake_source(pm_c6_wake_source_t source, uint32_t param);
 
+// Load-adaptive frequency scaling with latency guard
+void pm_c6_dvfs_enable(bool enable);
+void pm_c6_note_comm_activity(void);
+
 // Power optimization functions
 void pm_c6_enable_wifi_power_save(bool enable);
 void pm_c6_enable_ble_power_save(bool enable);
@@ -129,8 +138,12 @@ static inline bool pm_c6_configure(const void *config) { return false; }
 static inline void pm_c6_set_mode(int mode) {}
 static inline int pm_c6_get_mode(void) { return 0; }
 static inline void pm_c6_enter_light_sleep(uint32_t duration_ms) {}
+static inline bool pm_c6_enter_connected_light_sleep(uint32_t duration_ms) { return false; }
+static inline uint32_t pm_c6_get_wake_latency_us(void) { return 0; }
 static inline void pm_c6_enter_deep_sleep(uint32_t duration_ms) {}
 static inline void pm_c6_configure_wake_source(int source, uint32_t param) {}
+static inline void pm_c6_dvfs_enable(bool enable) {}
+static inline void pm_c6_note_comm_activity(void) {}
 static inline void pm_c6_enable_wifi_power_save(bool enable) {}
 static inline void pm_c6_enable_ble_power_save(bool enable) {}
 static inline void pm_c6_enable_peripheral_retention(bool enable) {}
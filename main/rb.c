@@ -123,6 +123,156 @@ unsigned int rb_get_free_space(rb_t *rb) {
 	return res;
 }
 
+// SPSC variant. No locks are taken, so all of these are usable from ISR
+// context on the side (producer or consumer) that the caller owns.
+
+void rb_spsc_init(rb_spsc_t *rb, void *buffer, int item_size, int item_count) {
+	rb->data = buffer;
+	rb->item_size = item_size;
+	rb->item_count = item_count;
+	rb->head = 0;
+	rb->tail = 0;
+}
+
+// Only safe when neither producer nor consumer is active.
+void rb_spsc_flush(rb_spsc_t *rb) {
+	rb->head = 0;
+	rb->tail = 0;
+}
+
+bool rb_spsc_insert(rb_spsc_t *rb, const void *data) {
+	return rb_spsc_insert_multi(rb, data, 1) == 1;
+}
+
+unsigned int rb_spsc_insert_multi(rb_spsc_t *rb, const void *data, unsigned int count) {
+	unsigned int head = rb->head;
+	unsigned int tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+
+	unsigned int free_space = (tail + rb->item_count - head - 1) % rb->item_count;
+	if (count > free_space) {
+		count = free_space;
+	}
+
+	// Up to two contiguous copies around the wrap point.
+	unsigned int first = rb->item_count - head;
+	if (first > count) {
+		first = count;
+	}
+
+	memcpy((char*)rb->data + head * rb->item_size, data, first * rb->item_size);
+
+	if (count > first) {
+		memcpy(rb->data, (const char*)data + first * rb->item_size,
+				(count - first) * rb->item_size);
+	}
+
+	__atomic_store_n(&rb->head, (head + count) % rb->item_count, __ATOMIC_RELEASE);
+
+	return count;
+}
+
+bool rb_spsc_pop(rb_spsc_t *rb, void *data) {
+	return rb_spsc_pop_multi(rb, data, 1) == 1;
+}
+
+unsigned int rb_spsc_pop_multi(rb_spsc_t *rb, void *data, unsigned int count) {
+	unsigned int tail = rb->tail;
+	unsigned int head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+
+	unsigned int avail = (head + rb->item_count - tail) % rb->item_count;
+	if (count > avail) {
+		count = avail;
+	}
+
+	if (data) {
+		unsigned int first = rb->item_count - tail;
+		if (first > count) {
+			first = count;
+		}
+
+		memcpy(data, (char*)rb->data + tail * rb->item_size, first * rb->item_size);
+
+		if (count > first) {
+			memcpy((char*)data + first * rb->item_size, rb->data,
+					(count - first) * rb->item_size);
+		}
+	}
+
+	__atomic_store_n(&rb->tail, (tail + count) % rb->item_count, __ATOMIC_RELEASE);
+
+	return count;
+}
+
+/**
+ * Reserve the largest linear span at the write position and return it
+ * in ptr, so a DMA engine or read() call can fill ring memory directly
+ * without a staging copy. Returns the number of items in the span,
+ * which may be less than the total free space when the ring wraps;
+ * commit and reserve again to use the remainder. Nothing becomes
+ * visible to the consumer until rb_spsc_write_commit.
+ */
+unsigned int rb_spsc_write_reserve(rb_spsc_t *rb, void **ptr) {
+	unsigned int head = rb->head;
+	unsigned int tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+
+	unsigned int free_space = (tail + rb->item_count - head - 1) % rb->item_count;
+	unsigned int linear = rb->item_count - head;
+	if (linear > free_space) {
+		linear = free_space;
+	}
+
+	*ptr = (char*)rb->data + head * rb->item_size;
+	return linear;
+}
+
+// Publish count items previously filled in through rb_spsc_write_reserve.
+// count must not exceed what the reserve returned.
+void rb_spsc_write_commit(rb_spsc_t *rb, unsigned int count) {
+	__atomic_store_n(&rb->head, (rb->head + count) % rb->item_count,
+			__ATOMIC_RELEASE);
+}
+
+/**
+ * Read-side counterpart of rb_spsc_write_reserve: returns the largest
+ * linear span of unread items, so fwrite and friends can consume ring
+ * memory in place. The items stay in the ring until
+ * rb_spsc_read_commit.
+ */
+unsigned int rb_spsc_read_reserve(rb_spsc_t *rb, void **ptr) {
+	unsigned int tail = rb->tail;
+	unsigned int head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+
+	unsigned int avail = (head + rb->item_count - tail) % rb->item_count;
+	unsigned int linear = rb->item_count - tail;
+	if (linear > avail) {
+		linear = avail;
+	}
+
+	*ptr = (char*)rb->data + tail * rb->item_size;
+	return linear;
+}
+
+// Release count items previously obtained through rb_spsc_read_reserve.
+// count must not exceed what the reserve returned.
+void rb_spsc_read_commit(rb_spsc_t *rb, unsigned int count) {
+	__atomic_store_n(&rb->tail, (rb->tail + count) % rb->item_count,
+			__ATOMIC_RELEASE);
+}
+
+bool rb_spsc_is_empty(rb_spsc_t *rb) {
+	return rb_spsc_get_item_count(rb) == 0;
+}
+
+unsigned int rb_spsc_get_item_count(rb_spsc_t *rb) {
+	unsigned int head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+	unsigned int tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+	return (head + rb->item_count - tail) % rb->item_count;
+}
+
+unsigned int rb_spsc_get_free_space(rb_spsc_t *rb) {
+	return rb->item_count - 1 - rb_spsc_get_item_count(rb);
+}
+
 // Private function implementations
 
 static unsigned int get_item_count(rb_t *rb) {
@@ -37,6 +37,21 @@ typedef struct {
 	bool full;
 } rb_t;
 
+/*
+ * Single-producer single-consumer ring buffer without locks. Safe for
+ * exactly one producer (which may be an ISR) and one consumer running
+ * concurrently; head is only written by the producer and tail only by
+ * the consumer. One slot is kept empty to distinguish full from empty,
+ * so it holds item_count - 1 items.
+ */
+typedef struct {
+	void *data;
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	unsigned int item_size;
+	unsigned int item_count;
+} rb_spsc_t;
+
 void rb_init(rb_t *rb, void *buffer, int item_size, int item_count);
 void rb_init_alloc(rb_t *rb, int item_size, int item_count);
 void rb_free(rb_t *rb);
@@ -50,5 +65,19 @@ bool rb_is_empty(rb_t *rb);
 unsigned int rb_get_item_count(rb_t *rb);
 unsigned int rb_get_free_space(rb_t *rb);
 
+void rb_spsc_init(rb_spsc_t *rb, void *buffer, int item_size, int item_count);
+void rb_spsc_flush(rb_spsc_t *rb);
+bool rb_spsc_insert(rb_spsc_t *rb, const void *data);
+unsigned int rb_spsc_insert_multi(rb_spsc_t *rb, const void *data, unsigned int count);
+bool rb_spsc_pop(rb_spsc_t *rb, void *data);
+unsigned int rb_spsc_pop_multi(rb_spsc_t *rb, void *data, unsigned int count);
+unsigned int rb_spsc_write_reserve(rb_spsc_t *rb, void **ptr);
+void rb_spsc_write_commit(rb_spsc_t *rb, unsigned int count);
+unsigned int rb_spsc_read_reserve(rb_spsc_t *rb, void **ptr);
+void rb_spsc_read_commit(rb_spsc_t *rb, unsigned int count);
+bool rb_spsc_is_empty(rb_spsc_t *rb);
+unsigned int rb_spsc_get_item_count(rb_spsc_t *rb);
+unsigned int rb_spsc_get_free_space(rb_spsc_t *rb);
+
 #endif
 
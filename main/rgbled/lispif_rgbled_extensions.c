@@ -46,6 +46,27 @@ static rmt_encoder_handle_t led_encoder = NULL;
 static unsigned int led_type_driver = 0;
 static int led_pin_driver = -1;
 
+// Double-buffered transmission with frame diffing. The pixel data is
+// copied into driver-owned buffers before the transmit is queued, so
+// the RMT encoder never reads from the script's array while the
+// evaluator keeps running, and the previous frame stays around to diff
+// against. WS281x LEDs latch whatever they last received on reset, so
+// when only a prefix of the strip changed the transmit can stop at the
+// last changed pixel and the unchanged tail keeps its color; identical
+// frames skip the transmit entirely.
+static uint8_t *led_tx_buf[2] = {NULL, NULL};
+static size_t led_tx_buf_size = 0;
+static int led_tx_cur = 0;
+static size_t led_last_len = 0;
+
+// Optional per-channel color correction, applied while the pixels are
+// copied into the TX buffer. The LUTs are loaded once from a script
+// (rgbled-correction), after which scripts can write raw colors and the
+// correction costs one table lookup per byte on the C side instead of
+// evaluator time per pixel. Rows are R, G, B, W.
+static uint8_t corr_lut[4][256];
+static bool corr_enabled = false;
+
 static const uint8_t gamma_table[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 		0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3,
 		4, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10,
@@ -181,6 +202,13 @@ static lbm_value ext_rgbled_deinit(lbm_value *args, lbm_uint argn) {
 		led_pin_driver = -1;
 	}
 
+	free(led_tx_buf[0]);
+	free(led_tx_buf[1]);
+	led_tx_buf[0] = NULL;
+	led_tx_buf[1] = NULL;
+	led_tx_buf_size = 0;
+	led_last_len = 0;
+
 	return ENC_SYM_TRUE;
 }
 
@@ -422,8 +450,146 @@ static lbm_value ext_rgbled_update(lbm_value *args, lbm_uint argn) {
 	}
 
 	lbm_array_header_t *array = (lbm_array_header_t *)lbm_car(args[0]);
+	uint8_t *pixels = (uint8_t*)array->data + 1;
+	size_t len = array->size - 1;
+
+	uint8_t type_led = ((uint8_t*)array->data)[0] & 0x0F;
+	int led_colors = type_led >= 2 ? 4 : 3;
+
+	if (led_tx_buf_size < len) {
+		rmt_tx_wait_all_done(led_chan, 100);
+		free(led_tx_buf[0]);
+		free(led_tx_buf[1]);
+		led_tx_buf[0] = malloc(len);
+		led_tx_buf[1] = malloc(len);
+		if (led_tx_buf[0] == NULL || led_tx_buf[1] == NULL) {
+			free(led_tx_buf[0]);
+			free(led_tx_buf[1]);
+			led_tx_buf[0] = NULL;
+			led_tx_buf[1] = NULL;
+			led_tx_buf_size = 0;
+		} else {
+			led_tx_buf_size = len;
+		}
+		led_last_len = 0;
+	}
+
+	if (led_tx_buf_size < len) {
+		// Allocation failed, transmit straight out of the script's
+		// array like before.
+		rmt_transmit(led_chan, led_encoder, pixels, len, &tx_config);
+		return ENC_SYM_TRUE;
+	}
+
+	// Map byte position within a pixel to the correction LUT for the
+	// channel it carries in this strip's color order.
+	const uint8_t *luts[4] = {NULL, NULL, NULL, NULL};
+	bool corr = corr_enabled;
+	if (corr) {
+		switch (type_led) {
+		case 0: // GRB
+			luts[0] = corr_lut[1]; luts[1] = corr_lut[0]; luts[2] = corr_lut[2];
+			break;
+		case 1: // RGB
+			luts[0] = corr_lut[0]; luts[1] = corr_lut[1]; luts[2] = corr_lut[2];
+			break;
+		case 2: // GRBW
+			luts[0] = corr_lut[1]; luts[1] = corr_lut[0]; luts[2] = corr_lut[2];
+			luts[3] = corr_lut[3];
+			break;
+		case 3: // RGBW
+			luts[0] = corr_lut[0]; luts[1] = corr_lut[1]; luts[2] = corr_lut[2];
+			luts[3] = corr_lut[3];
+			break;
+		default:
+			corr = false;
+			break;
+		}
+	}
+
+	uint8_t *prev = led_tx_buf[led_tx_cur ^ 1];
+	uint8_t *next = led_tx_buf[led_tx_cur];
+
+	size_t send_len = len;
+	if (led_last_len == len) {
+		size_t last_changed = 0;
+		bool changed = false;
+		for (size_t i = 0;i < len;i++) {
+			uint8_t v = corr ? luts[i % led_colors][pixels[i]] : pixels[i];
+			if (v != prev[i]) {
+				last_changed = i;
+				changed = true;
+			}
+		}
+
+		if (!changed) {
+			return ENC_SYM_TRUE;
+		}
+
+		send_len = (last_changed / (size_t)led_colors + 1) * (size_t)led_colors;
+	}
+
+	// The buffer being filled was queued two updates ago; make sure the
+	// hardware is done with it before overwriting. The previous update's
+	// transmit still overlaps with the script work done since then.
+	rmt_tx_wait_all_done(led_chan, 100);
+
+	if (corr) {
+		for (size_t i = 0;i < len;i++) {
+			next[i] = luts[i % led_colors][pixels[i]];
+		}
+	} else {
+		memcpy(next, pixels, len);
+	}
+	led_last_len = len;
+	led_tx_cur ^= 1;
+
+	rmt_transmit(led_chan, led_encoder, next, send_len, &tx_config);
+
+	return ENC_SYM_TRUE;
+}
+
+// (rgbled-correction r-lut g-lut b-lut [w-lut]) where each LUT is a
+// 256-byte array, or no arguments to disable correction. The W channel
+// stays uncorrected when no LUT is given for it.
+static lbm_value ext_rgbled_correction(lbm_value *args, lbm_uint argn) {
+	if (argn == 0) {
+		corr_enabled = false;
+		led_last_len = 0; // Force a full retransmit on the next update
+		return ENC_SYM_TRUE;
+	}
+
+	if (argn != 3 && argn != 4) {
+		lbm_set_error_reason((char*)lbm_error_str_num_args);
+		return ENC_SYM_TERROR;
+	}
+
+	for (lbm_uint i = 0;i < argn;i++) {
+		if (!lbm_is_array_r(args[i])) {
+			lbm_set_error_reason((char*)lbm_error_str_incorrect_arg);
+			return ENC_SYM_TERROR;
+		}
+
+		lbm_array_header_t *arr = (lbm_array_header_t*)lbm_car(args[i]);
+		if (arr->size != 256) {
+			lbm_set_error_reason("LUT must be 256 bytes");
+			return ENC_SYM_TERROR;
+		}
+	}
+
+	for (lbm_uint i = 0;i < argn;i++) {
+		lbm_array_header_t *arr = (lbm_array_header_t*)lbm_car(args[i]);
+		memcpy(corr_lut[i], arr->data, 256);
+	}
+
+	if (argn == 3) {
+		for (int i = 0;i < 256;i++) {
+			corr_lut[3][i] = i;
+		}
+	}
 
-	rmt_transmit(led_chan, led_encoder, (uint8_t*)array->data + 1, array->size - 1, &tx_config);
+	corr_enabled = true;
+	led_last_len = 0; // Force a full retransmit with the new correction
 
 	return ENC_SYM_TRUE;
 }
@@ -434,4 +600,5 @@ void lispif_load_rgbled_extensions(void) {
 	lbm_add_extension("rgbled-buffer", ext_rgbled_color_buffer);
 	lbm_add_extension("rgbled-color", ext_rgbled_color);
 	lbm_add_extension("rgbled-update", ext_rgbled_update);
+	lbm_add_extension("rgbled-correction", ext_rgbled_correction);
 }
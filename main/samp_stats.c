@@ -0,0 +1,124 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include "samp_stats.h"
+#include "commands.h"
+
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+/*
+ * The sampling paths report into here from whatever context they run in
+ * (task or esp_timer callback), so adding a sample has to be cheap: one
+ * cycle-counter read, a subtraction and a power-of-two bin increment.
+ * The bin is the position of the highest set bit in the interval, which
+ * gives logarithmic resolution over the whole counter range without any
+ * division. Note that the IMU reports once per delivered sample, so with
+ * FIFO draining the histogram becomes bimodal: small intervals within a
+ * drained batch and the batch cadence between them. Scheduler
+ * interference shows up as counts above the expected cadence bin.
+ */
+
+typedef struct {
+	uint32_t last;
+	bool has_last;
+	uint32_t cnt;
+	uint32_t int_min;
+	uint32_t int_max;
+	uint32_t bins[SAMP_STATS_BIN_NUM];
+} samp_src_stats_t;
+
+static samp_src_stats_t m_stats[SAMP_SRC_NUM] = {0};
+
+static const char *src_name(SAMP_SRC src) {
+	switch (src) {
+		case SAMP_SRC_IMU: return "IMU";
+		case SAMP_SRC_ADC: return "ADC";
+		case SAMP_SRC_ENC: return "ENC";
+		default: return "?";
+	}
+}
+
+void samp_stats_add(SAMP_SRC src) {
+	if (src >= SAMP_SRC_NUM) {
+		return;
+	}
+
+	uint32_t now = esp_cpu_get_cycle_count();
+	samp_src_stats_t *s = &m_stats[src];
+
+	if (s->has_last) {
+		uint32_t interval = now - s->last;
+		int bin = interval ? 31 - __builtin_clz(interval) : 0;
+
+		s->bins[bin]++;
+		s->cnt++;
+
+		if (s->cnt == 1 || interval < s->int_min) {
+			s->int_min = interval;
+		}
+		if (interval > s->int_max) {
+			s->int_max = interval;
+		}
+	}
+
+	s->last = now;
+	s->has_last = true;
+}
+
+/**
+ * Print inter-sample interval histograms for all sources that have seen
+ * samples since boot or the last reset. Used by the samp_stats terminal
+ * command.
+ */
+void samp_stats_print(void) {
+	uint32_t cyc_per_us = esp_rom_get_cpu_ticks_per_us();
+
+	for (int src = 0;src < SAMP_SRC_NUM;src++) {
+		samp_src_stats_t *s = &m_stats[src];
+
+		if (s->cnt == 0) {
+			continue;
+		}
+
+		commands_printf("%s: %lu intervals, min %.1f us, max %.1f us",
+				src_name(src), s->cnt,
+				(double)s->int_min / (double)cyc_per_us,
+				(double)s->int_max / (double)cyc_per_us);
+
+		for (int bin = 0;bin < SAMP_STATS_BIN_NUM;bin++) {
+			if (s->bins[bin] == 0) {
+				continue;
+			}
+
+			commands_printf("  %9.1f - %9.1f us: %lu",
+					(double)(1ull << bin) / (double)cyc_per_us,
+					(double)(1ull << (bin + 1)) / (double)cyc_per_us,
+					s->bins[bin]);
+		}
+	}
+
+	commands_printf(" ");
+}
+
+void samp_stats_reset(void) {
+	memset(m_stats, 0, sizeof(m_stats));
+}
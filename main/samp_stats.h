@@ -0,0 +1,41 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#ifndef MAIN_SAMP_STATS_H_
+#define MAIN_SAMP_STATS_H_
+
+#include <stdint.h>
+
+// Histogram bins. Bin i counts inter-sample intervals in
+// [2^i, 2^(i + 1)) CPU cycles, so the full uint32_t range is covered.
+#define SAMP_STATS_BIN_NUM			32
+
+typedef enum {
+	SAMP_SRC_IMU = 0,
+	SAMP_SRC_ADC,
+	SAMP_SRC_ENC,
+	SAMP_SRC_NUM
+} SAMP_SRC;
+
+// Functions
+void samp_stats_add(SAMP_SRC src);
+void samp_stats_print(void);
+void samp_stats_reset(void);
+
+#endif /* MAIN_SAMP_STATS_H_ */
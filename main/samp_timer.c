@@ -0,0 +1,129 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include "samp_timer.h"
+
+/*
+ * Pacing comes from a periodic esp_timer, which schedules on absolute
+ * 52-bit microsecond time and therefore does not accumulate drift the
+ * way a delay loop does, and is not quantized to the FreeRTOS tick.
+ * The timer callback only notifies the worker task; the sample function
+ * runs in the worker, so it may block on I2C/SPI without holding up the
+ * shared esp_timer task. Notifications are counted, so periods missed
+ * while a slow sample was in progress show up in overrun_cnt instead of
+ * silently stretching the cadence.
+ */
+
+static void samp_timer_timer_cb(void *arg) {
+	samp_timer_t *st = (samp_timer_t*)arg;
+
+	if (st->task) {
+		xTaskNotifyGive(st->task);
+	}
+}
+
+static void samp_timer_task(void *arg) {
+	samp_timer_t *st = (samp_timer_t*)arg;
+
+	while (!st->should_stop) {
+		uint32_t cnt = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+		if (st->should_stop) {
+			break;
+		}
+
+		if (cnt > 1) {
+			st->overrun_cnt += cnt - 1;
+		}
+
+		st->sample_fn(st->arg);
+	}
+
+	st->running = false;
+	vTaskDelete(NULL);
+}
+
+bool samp_timer_start(samp_timer_t *st, const char *name, uint32_t interval_us,
+		void (*sample_fn)(void *arg), void *arg,
+		uint32_t task_stack, unsigned int task_prio) {
+	if (interval_us == 0 || sample_fn == NULL || st->running) {
+		return false;
+	}
+
+	st->sample_fn = sample_fn;
+	st->arg = arg;
+	st->should_stop = false;
+	st->overrun_cnt = 0;
+
+	if (st->timer == NULL) {
+		const esp_timer_create_args_t timer_args = {
+				.callback = samp_timer_timer_cb,
+				.arg = st,
+				.name = name,
+		};
+		if (esp_timer_create(&timer_args, &st->timer) != ESP_OK) {
+			return false;
+		}
+	} else {
+		esp_timer_stop(st->timer);
+	}
+
+	st->running = true;
+	if (xTaskCreatePinnedToCore(samp_timer_task, name, task_stack, st,
+			task_prio, &st->task, tskNO_AFFINITY) != pdPASS) {
+		st->running = false;
+		st->task = NULL;
+		return false;
+	}
+
+	if (esp_timer_start_periodic(st->timer, interval_us) != ESP_OK) {
+		st->should_stop = true;
+		xTaskNotifyGive(st->task);
+		while (st->running) {
+			vTaskDelay(1);
+		}
+		st->task = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void samp_timer_stop(samp_timer_t *st) {
+	if (!st->running) {
+		return;
+	}
+
+	if (st->timer) {
+		esp_timer_stop(st->timer);
+	}
+
+	st->should_stop = true;
+	xTaskNotifyGive(st->task);
+
+	while (st->running) {
+		vTaskDelay(1);
+	}
+
+	st->task = NULL;
+}
+
+uint32_t samp_timer_overruns(samp_timer_t *st) {
+	return st->overrun_cnt;
+}
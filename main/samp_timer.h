@@ -0,0 +1,57 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#ifndef MAIN_SAMP_TIMER_H_
+#define MAIN_SAMP_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Shared pacing for periodic driver sampling. A periodic esp_timer
+ * notifies a dedicated worker task that runs the sample function, so
+ * acquisition gets microsecond-granular, drift-free intervals instead
+ * of tick-quantized vTaskDelay pacing, while the sample function may
+ * still block on the bus. Drivers whose reads are short and
+ * non-blocking can keep running directly in an esp_timer callback
+ * (enc_as504x does); this is for the ones that cannot.
+ */
+
+typedef struct {
+	esp_timer_handle_t timer;
+	TaskHandle_t task;
+	void (*sample_fn)(void *arg);
+	void *arg;
+	volatile bool should_stop;
+	volatile bool running;
+	volatile uint32_t overrun_cnt;
+} samp_timer_t;
+
+// st must be zero-initialized before first use (static storage is fine).
+bool samp_timer_start(samp_timer_t *st, const char *name, uint32_t interval_us,
+		void (*sample_fn)(void *arg), void *arg,
+		uint32_t task_stack, unsigned int task_prio);
+void samp_timer_stop(samp_timer_t *st);
+uint32_t samp_timer_overruns(samp_timer_t *st);
+
+#endif /* MAIN_SAMP_TIMER_H_ */
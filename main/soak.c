@@ -0,0 +1,248 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "soak.h"
+#include "commands.h"
+#include "comm_can.h"
+#include "lispif.h"
+#include "log.h"
+#include "task_stats.h"
+#include "utils.h"
+
+#include "heap.h"
+
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * On-device soak-test load generator. A background task produces
+ * configurable synthetic load - CAN TX at a fixed frame rate, a lisp
+ * busy snippet evaluated once a second, optional padding writes to the
+ * SD card - and once a second records a performance sample (heap
+ * levels, CPU busy, CAN rates and queue high-water, GC activity, lisp
+ * eval latency) to the auxiliary log channel. A qualification run is
+ * then just "soak start" plus an SD card: hours of load with the full
+ * perf recording on file, so throughput degradation over time shows up
+ * in the CSV instead of needing a bench of external equipment.
+ *
+ * Display load is not generated here; displays are configured and
+ * driven from lisp in this firmware, so animation load belongs in the
+ * soak script of setups that have one.
+ *
+ * The CAN frames carry a counter payload on an extended id whose
+ * command byte no VESC decodes, so they load the bus without
+ * triggering handlers on other nodes.
+ */
+
+#define SOAK_TICK_MS			10
+#define SOAK_CAN_EID			0xFFFF
+#define SOAK_LISP_TIMEOUT_MS	900
+#define SOAK_PAD_CHUNK			128
+
+// The busy snippet; recursive fibonacci touches eval, the stack and GC.
+static const char *soak_lisp_code =
+		"(define soak-fib (lambda (n) "
+		"(if (< n 2) n (+ (soak-fib (- n 1)) (soak-fib (- n 2)))))) "
+		"(soak-fib 18)";
+
+// Parameters of the running soak
+static uint32_t m_minutes = 0;
+static uint32_t m_can_fps = 0;
+static bool m_lisp_load = false;
+static uint32_t m_sd_pad_bytes = 0;
+
+static volatile bool m_running = false;
+static volatile bool m_stop_req = false;
+
+// Progress counters
+static int64_t m_t_start_ms = 0;
+static uint32_t m_can_sent = 0;
+static uint32_t m_lisp_runs = 0;
+static uint32_t m_lisp_fails = 0;
+static uint32_t m_rec_lines = 0;
+
+// Scratch for the task query, too large for the stack.
+static task_stats_t m_task_stats;
+
+static uint8_t cpu_busy_percent(void) {
+	if (!task_stats_get(&m_task_stats) || m_task_stats.time_delta == 0) {
+		return 0;
+	}
+
+	uint32_t idle = 0;
+	for (int i = 0;i < m_task_stats.num_tasks;i++) {
+		if (strncmp(m_task_stats.tasks[i].name, "IDLE", 4) == 0) {
+			idle += m_task_stats.tasks[i].run_time_delta;
+		}
+	}
+
+	if (idle > m_task_stats.time_delta) {
+		idle = m_task_stats.time_delta;
+	}
+
+	return (uint8_t)(100 - (uint64_t)idle * 100 / m_task_stats.time_delta);
+}
+
+static void soak_task(void *arg) {
+	(void)arg;
+
+	int64_t t_end_ms = m_t_start_ms + (int64_t)m_minutes * 60 * 1000;
+	uint32_t can_acc = 0; // Fractional frames, in fps units
+	int64_t tick_last_rec = m_t_start_ms;
+	uint32_t gc_num_last = lbm_heap_state.gc_num;
+	uint32_t gc_time_last = lbm_heap_state.gc_time_acc;
+	uint8_t can_payload[8] = {0};
+
+	while (!m_stop_req && utils_ms_tot() < t_end_ms) {
+		int64_t now = utils_ms_tot();
+
+		// CAN load, spread evenly over the ticks
+		can_acc += m_can_fps * SOAK_TICK_MS;
+		while (can_acc >= 1000) {
+			can_acc -= 1000;
+			uint32_t cnt = m_can_sent;
+			memcpy(can_payload, &cnt, 4);
+			comm_can_transmit_eid(SOAK_CAN_EID, can_payload, 8);
+			m_can_sent++;
+		}
+
+		if ((now - tick_last_rec) >= 1000) {
+			tick_last_rec = now;
+
+			uint32_t lisp_ms = 0;
+			if (m_lisp_load) {
+				int64_t t_eval = esp_timer_get_time();
+				if (lispif_eval_sync(soak_lisp_code, SOAK_LISP_TIMEOUT_MS)) {
+					m_lisp_runs++;
+				} else {
+					m_lisp_fails++;
+				}
+				lisp_ms = (esp_timer_get_time() - t_eval) / 1000;
+			}
+
+			can_stats_t cs;
+			comm_can_stats_get(&cs);
+
+			uint32_t gc_num = lbm_heap_state.gc_num;
+			uint32_t gc_time = lbm_heap_state.gc_time_acc;
+
+			char line[220];
+			snprintf(line, sizeof(line),
+					"%lu;%lu;%lu;%lu;%u;%lu;%lu;%.1f;%lu;%lu;%lu;%lu;%lu\n",
+					(uint32_t)((now - m_t_start_ms) / 1000),
+					esp_get_free_heap_size(),
+					esp_get_minimum_free_heap_size(),
+					(uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+					cpu_busy_percent(),
+					cs.tx_frames_sec, cs.rx_frames_sec,
+					(double)cs.bus_load, cs.tx_queue_max,
+					gc_num - gc_num_last, gc_time - gc_time_last,
+					lisp_ms, log_aux_dropped());
+
+			gc_num_last = gc_num;
+			gc_time_last = gc_time;
+
+			if (log_aux_write(line)) {
+				m_rec_lines++;
+			}
+
+			// Optional raw SD throughput load on top of the sample line
+			if (m_sd_pad_bytes > 0) {
+				char pad[SOAK_PAD_CHUNK + 1];
+				memset(pad, 'x', SOAK_PAD_CHUNK);
+				uint32_t left = m_sd_pad_bytes;
+				while (left > 0) {
+					uint32_t chunk = left > (SOAK_PAD_CHUNK - 1) ?
+							(SOAK_PAD_CHUNK - 1) : left;
+					pad[chunk] = '\n';
+					pad[chunk + 1] = 0;
+					log_aux_write(pad);
+					left -= chunk;
+				}
+			}
+		}
+
+		vTaskDelay(SOAK_TICK_MS / portTICK_PERIOD_MS);
+	}
+
+	log_aux_stop();
+	m_running = false;
+	vTaskDelete(NULL);
+}
+
+bool soak_start(uint32_t minutes, uint32_t can_fps,
+		bool lisp_load, uint32_t sd_pad_bytes) {
+	if (m_running) {
+		return false;
+	}
+
+	if (!log_aux_start("soak",
+			"t_s;heap_free;heap_min;heap_largest;cpu_busy;can_tx_fps;"
+			"can_rx_fps;bus_load;can_q_hw;gc_cnt;gc_us;lisp_ms;rec_drops")) {
+		return false;
+	}
+
+	m_minutes = minutes;
+	m_can_fps = can_fps;
+	m_lisp_load = lisp_load;
+	m_sd_pad_bytes = sd_pad_bytes;
+
+	m_t_start_ms = utils_ms_tot();
+	m_can_sent = 0;
+	m_lisp_runs = 0;
+	m_lisp_fails = 0;
+	m_rec_lines = 0;
+
+	m_stop_req = false;
+	m_running = true;
+
+	xTaskCreatePinnedToCore(soak_task, "soak", 3500, NULL, 6, NULL, tskNO_AFFINITY);
+
+	return true;
+}
+
+void soak_stop(void) {
+	m_stop_req = true;
+}
+
+bool soak_is_running(void) {
+	return m_running;
+}
+
+void soak_print_status(void) {
+	commands_printf("soak,running=%d", m_running);
+	commands_printf("soak,t_s=%lu", m_running ?
+			(uint32_t)((utils_ms_tot() - m_t_start_ms) / 1000) : 0);
+	commands_printf("soak,minutes=%lu", m_minutes);
+	commands_printf("soak,can_fps=%lu", m_can_fps);
+	commands_printf("soak,lisp_load=%d", m_lisp_load);
+	commands_printf("soak,sd_pad=%lu", m_sd_pad_bytes);
+	commands_printf("soak,can_sent=%lu", m_can_sent);
+	commands_printf("soak,lisp_runs=%lu", m_lisp_runs);
+	commands_printf("soak,lisp_fails=%lu", m_lisp_fails);
+	commands_printf("soak,rec_lines=%lu", m_rec_lines);
+	commands_printf("soak,rec_drops=%lu", log_aux_dropped());
+	commands_printf(" ");
+}
@@ -0,0 +1,38 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_SOAK_H_
+#define MAIN_SOAK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Default soak parameters
+#define SOAK_MINUTES_DEFAULT	60
+#define SOAK_CAN_FPS_DEFAULT	100
+#define SOAK_SD_PAD_DEFAULT		0
+
+// Functions
+bool soak_start(uint32_t minutes, uint32_t can_fps,
+		bool lisp_load, uint32_t sd_pad_bytes);
+void soak_stop(void);
+bool soak_is_running(void);
+void soak_print_status(void);
+
+#endif /* MAIN_SOAK_H_ */
@@ -0,0 +1,419 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#include "stats.h"
+#include "datatypes.h"
+#include "buffer.h"
+#include "commands.h"
+#include "comm_can.h"
+#include "bms.h"
+#include "nmea.h"
+#include "pkt_trace.h"
+#include "flash_helper.h"
+#include "comm_wifi.h"
+#include "utils.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+// Settings
+#define SAMPLE_MS_DEFAULT		100
+#define SAMPLE_MS_MIN			10
+#define SRC_MAX_AGE_S			2.0
+
+/*
+ * Per-channel running aggregates over the values that already flow
+ * through the CAN status caches, the BMS state and the GNSS parser.
+ * Clients used to stream raw values at high rate just to compute
+ * min/max/mean for ride summaries; sampling on-device and answering
+ * the whole summary in one COMM_STATS packet drops those poll rates
+ * to whatever refresh the UI wants. Variance is tracked with
+ * Welford's method so stddev stays stable over long windows.
+ */
+typedef struct {
+	stats_source_t source;
+	uint8_t can_id;
+	uint32_t n;
+	float min;
+	float max;
+	float mean;
+	float m2;
+	float last;
+	uint32_t start_time;
+} stats_channel_t;
+
+// Private variables
+static stats_channel_t m_channels[STATS_CH_MAX];
+static esp_timer_handle_t m_sample_timer;
+static uint32_t m_sample_ms = SAMPLE_MS_DEFAULT;
+
+// Private functions
+static void channel_reset(stats_channel_t *ch) {
+	ch->n = 0;
+	ch->min = 0.0;
+	ch->max = 0.0;
+	ch->mean = 0.0;
+	ch->m2 = 0.0;
+	ch->last = 0.0;
+	ch->start_time = xTaskGetTickCount();
+}
+
+// Read the current value of a source, or false when the source has no
+// fresh data (e.g. the CAN node has not sent a status message lately).
+static bool source_sample(stats_source_t source, uint8_t can_id, float *value) {
+	switch (source) {
+	case STATS_SRC_CAN_RPM:
+	case STATS_SRC_CAN_CURRENT:
+	case STATS_SRC_CAN_DUTY: {
+		can_status_msg *msg = comm_can_get_status_msg_id(can_id);
+		if (!msg || msg->id < 0 || UTILS_AGE_S(msg->rx_time) > SRC_MAX_AGE_S) {
+			return false;
+		}
+		*value = source == STATS_SRC_CAN_RPM ? msg->rpm :
+				source == STATS_SRC_CAN_CURRENT ? msg->current : msg->duty;
+		return true;
+	}
+
+	case STATS_SRC_CAN_CURRENT_IN:
+	case STATS_SRC_CAN_TEMP_FET:
+	case STATS_SRC_CAN_TEMP_MOTOR: {
+		can_status_msg_4 *msg = comm_can_get_status_msg_4_id(can_id);
+		if (!msg || msg->id < 0 || UTILS_AGE_S(msg->rx_time) > SRC_MAX_AGE_S) {
+			return false;
+		}
+		*value = source == STATS_SRC_CAN_CURRENT_IN ? msg->current_in :
+				source == STATS_SRC_CAN_TEMP_FET ? msg->temp_fet : msg->temp_motor;
+		return true;
+	}
+
+	case STATS_SRC_CAN_V_IN: {
+		can_status_msg_5 *msg = comm_can_get_status_msg_5_id(can_id);
+		if (!msg || msg->id < 0 || UTILS_AGE_S(msg->rx_time) > SRC_MAX_AGE_S) {
+			return false;
+		}
+		*value = msg->v_in;
+		return true;
+	}
+
+	case STATS_SRC_BMS_V_TOT:
+	case STATS_SRC_BMS_I_IN:
+	case STATS_SRC_BMS_SOC:
+	case STATS_SRC_BMS_TEMP_MAX_CELL: {
+		volatile bms_values *val = bms_get_values();
+		if (UTILS_AGE_S(val->update_time) > SRC_MAX_AGE_S) {
+			return false;
+		}
+		*value = source == STATS_SRC_BMS_V_TOT ? val->v_tot :
+				source == STATS_SRC_BMS_I_IN ? val->i_in :
+				source == STATS_SRC_BMS_SOC ? val->soc : val->temp_max_cell;
+		return true;
+	}
+
+	case STATS_SRC_GNSS_SPEED: {
+		nmea_state_t *s = nmea_get_state();
+		if (UTILS_AGE_S(s->rmc.update_time) > SRC_MAX_AGE_S) {
+			return false;
+		}
+		*value = s->rmc.speed;
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+static void sample_timer_cb(void *arg) {
+	(void)arg;
+
+	for (int i = 0;i < STATS_CH_MAX;i++) {
+		stats_channel_t *ch = &m_channels[i];
+		if (ch->source == STATS_SRC_NONE) {
+			continue;
+		}
+
+		float value;
+		if (!source_sample(ch->source, ch->can_id, &value)) {
+			continue;
+		}
+
+		if (ch->n == 0 || value < ch->min) {
+			ch->min = value;
+		}
+		if (ch->n == 0 || value > ch->max) {
+			ch->max = value;
+		}
+
+		ch->n++;
+		float delta = value - ch->mean;
+		ch->mean += delta / (float)ch->n;
+		ch->m2 += delta * (value - ch->mean);
+		ch->last = value;
+	}
+}
+
+static float channel_stddev(stats_channel_t *ch) {
+	if (ch->n < 2) {
+		return 0.0;
+	}
+	return sqrtf(ch->m2 / (float)(ch->n - 1));
+}
+
+void stats_init(void) {
+	for (int i = 0;i < STATS_CH_MAX;i++) {
+		m_channels[i].source = STATS_SRC_NONE;
+		channel_reset(&m_channels[i]);
+	}
+
+	const esp_timer_create_args_t timer_args = {
+		.callback = sample_timer_cb,
+		.name = "stats_sample",
+	};
+	esp_timer_create(&timer_args, &m_sample_timer);
+	esp_timer_start_periodic(m_sample_timer, (uint64_t)m_sample_ms * 1000);
+}
+
+void stats_config_channel(int channel, stats_source_t source, uint8_t can_id) {
+	if (channel < 0 || channel >= STATS_CH_MAX) {
+		return;
+	}
+
+	m_channels[channel].source = source;
+	m_channels[channel].can_id = can_id;
+	channel_reset(&m_channels[channel]);
+}
+
+void stats_set_rate(uint32_t sample_ms) {
+	if (sample_ms < SAMPLE_MS_MIN) {
+		sample_ms = SAMPLE_MS_MIN;
+	}
+
+	m_sample_ms = sample_ms;
+
+	if (m_sample_timer) {
+		esp_timer_stop(m_sample_timer);
+		esp_timer_start_periodic(m_sample_timer, (uint64_t)m_sample_ms * 1000);
+	}
+}
+
+void stats_reset(void) {
+	for (int i = 0;i < STATS_CH_MAX;i++) {
+		channel_reset(&m_channels[i]);
+	}
+}
+
+/*
+ * COMM_STATS sub-commands:
+ * 0: query. Reply: [u8 num]{[u8 source][u8 can_id][u32 n][f32 min]
+ *    [f32 max][f32 mean][f32 stddev][f32 last][u32 window_s]}...
+ * 1: reset all windows.
+ * 2: configure channel: [u8 channel][u8 source][u8 can_id].
+ * 3: set sample period: [u16 ms].
+ * 4: packet trace report, optional [u8 enable] to start/stop tracing
+ *    first. Reply: [u8 op] followed by the pkt_trace report blob.
+ * 5: flash stats. Reply: [u8 op][u32 erase_cnt_tot][u32 erase_cnt_max]
+ *    [u32 erased_sector_num] then per partition (qml, lisp) per op
+ *    (erase, write, read): [u32 cnt][u32 bytes][u32 lat_min_us]
+ *    [u32 lat_avg_us][u32 lat_max_us]. Histograms are terminal-only.
+ * 6: wifi link quality, optional [u8 rate_ctrl] (0/1, anything else
+ *    leaves it alone) to switch the congestion controller first.
+ *    Reply: [u8 op][i8 rssi][u32 tx_cnt][u32 tx_retries][u32 tx_fails]
+ *    [u32 tx_block_max_us][u32 coalesce_hw][u32 udp_seq_drops]
+ *    [u32 reconnects][f32 scale][u8 rate_ctrl_en].
+ */
+void stats_process_cmd(unsigned char *data, unsigned int len,
+		void(*reply_func)(unsigned char *data, unsigned int len)) {
+	COMM_PACKET_ID packet_id;
+
+	packet_id = data[0];
+	data++;
+	len--;
+
+	if (len < 1) {
+		return;
+	}
+
+	uint8_t op = data[0];
+	int32_t ind = 1;
+
+	switch (op) {
+	case 0: {
+		int32_t send_ind = 0;
+		uint8_t send_buffer[10 + 26 * STATS_CH_MAX];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = STATS_CH_MAX;
+
+		for (int i = 0;i < STATS_CH_MAX;i++) {
+			stats_channel_t *ch = &m_channels[i];
+			send_buffer[send_ind++] = ch->source;
+			send_buffer[send_ind++] = ch->can_id;
+			buffer_append_uint32(send_buffer, ch->n, &send_ind);
+			buffer_append_float32_auto(send_buffer, ch->min, &send_ind);
+			buffer_append_float32_auto(send_buffer, ch->max, &send_ind);
+			buffer_append_float32_auto(send_buffer, ch->mean, &send_ind);
+			buffer_append_float32_auto(send_buffer, channel_stddev(ch), &send_ind);
+			buffer_append_float32_auto(send_buffer, ch->last, &send_ind);
+			buffer_append_uint32(send_buffer,
+					(xTaskGetTickCount() - ch->start_time) / configTICK_RATE_HZ, &send_ind);
+		}
+
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 1: {
+		stats_reset();
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[10];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+		send_buffer[send_ind++] = 1;
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 2: {
+		bool ok = false;
+		if ((int32_t)len >= ind + 3) {
+			uint8_t channel = data[ind++];
+			uint8_t source = data[ind++];
+			uint8_t can_id = data[ind++];
+			if (channel < STATS_CH_MAX && source <= STATS_SRC_GNSS_SPEED) {
+				stats_config_channel(channel, source, can_id);
+				ok = true;
+			}
+		}
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[10];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+		send_buffer[send_ind++] = ok;
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 3: {
+		bool ok = false;
+		if ((int32_t)len >= ind + 2) {
+			stats_set_rate(buffer_get_uint16(data, &ind));
+			ok = true;
+		}
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[10];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+		send_buffer[send_ind++] = ok;
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 4: {
+		if ((int32_t)len >= ind + 1) {
+			pkt_trace_enable(data[ind++]);
+		}
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[256];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+		send_ind += pkt_trace_report(send_buffer + send_ind);
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 5: {
+		int32_t send_ind = 0;
+		uint8_t send_buffer[160];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+
+		flast_stats fs = flash_helper_stats();
+		buffer_append_uint32(send_buffer, fs.erase_cnt_tot, &send_ind);
+		buffer_append_uint32(send_buffer, fs.erase_cnt_max, &send_ind);
+		buffer_append_uint32(send_buffer, fs.erased_sector_num, &send_ind);
+
+		for (int part = 0;part < 2;part++) {
+			for (int fop = 0;fop < FLASH_OP_NUM;fop++) {
+				flash_op_stats os;
+				flash_helper_op_stats(part, fop, &os);
+				buffer_append_uint32(send_buffer, os.cnt, &send_ind);
+				buffer_append_uint32(send_buffer, os.bytes, &send_ind);
+				buffer_append_uint32(send_buffer, os.lat_min_us, &send_ind);
+				buffer_append_uint32(send_buffer,
+						os.cnt > 0 ? (uint32_t)(os.lat_sum_us / os.cnt) : 0, &send_ind);
+				buffer_append_uint32(send_buffer, os.lat_max_us, &send_ind);
+			}
+		}
+
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	case 6: {
+		if ((int32_t)len >= ind + 1) {
+			uint8_t ctrl = data[ind++];
+			if (ctrl < 2) {
+				comm_wifi_link_rate_ctrl_set(ctrl);
+			}
+		}
+
+		comm_wifi_link_stats ls;
+		comm_wifi_link_stats_get(&ls);
+
+		int32_t send_ind = 0;
+		uint8_t send_buffer[50];
+		send_buffer[send_ind++] = packet_id;
+		send_buffer[send_ind++] = op;
+		send_buffer[send_ind++] = (uint8_t)ls.rssi;
+		buffer_append_uint32(send_buffer, ls.tx_cnt, &send_ind);
+		buffer_append_uint32(send_buffer, ls.tx_retries, &send_ind);
+		buffer_append_uint32(send_buffer, ls.tx_fails, &send_ind);
+		buffer_append_uint32(send_buffer, ls.tx_block_max_us, &send_ind);
+		buffer_append_uint32(send_buffer, ls.coalesce_hw, &send_ind);
+		buffer_append_uint32(send_buffer, comm_wifi_get_udp_seq_drops(), &send_ind);
+		buffer_append_uint32(send_buffer, comm_wifi_get_reconnect_cnt(), &send_ind);
+		buffer_append_float32_auto(send_buffer, ls.scale, &send_ind);
+		send_buffer[send_ind++] = ls.rate_ctrl_en;
+		reply_func(send_buffer, send_ind);
+	} break;
+
+	default:
+		break;
+	}
+}
+
+void stats_print(void) {
+	commands_printf("Sample period: %lu ms", m_sample_ms);
+	commands_printf("ch src can_id          n        min        max       mean     stddev");
+	commands_printf("---------------------------------------------------------------------");
+
+	for (int i = 0;i < STATS_CH_MAX;i++) {
+		stats_channel_t *ch = &m_channels[i];
+		if (ch->source == STATS_SRC_NONE) {
+			continue;
+		}
+
+		commands_printf("%2d %3d %6d %10lu %10.3f %10.3f %10.3f %10.3f",
+				i, ch->source, ch->can_id, ch->n,
+				(double)ch->min, (double)ch->max,
+				(double)ch->mean, (double)channel_stddev(ch));
+	}
+
+	commands_printf(" ");
+}
@@ -0,0 +1,55 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_STATS_H_
+#define MAIN_STATS_H_
+
+#include <stdint.h>
+
+// Settings
+#define STATS_CH_MAX			8
+
+// Value sources a channel can aggregate. The CAN sources read the
+// status-message caches for a configurable CAN id.
+typedef enum {
+	STATS_SRC_NONE = 0,
+	STATS_SRC_CAN_RPM,
+	STATS_SRC_CAN_CURRENT,
+	STATS_SRC_CAN_DUTY,
+	STATS_SRC_CAN_CURRENT_IN,
+	STATS_SRC_CAN_TEMP_FET,
+	STATS_SRC_CAN_TEMP_MOTOR,
+	STATS_SRC_CAN_V_IN,
+	STATS_SRC_BMS_V_TOT,
+	STATS_SRC_BMS_I_IN,
+	STATS_SRC_BMS_SOC,
+	STATS_SRC_BMS_TEMP_MAX_CELL,
+	STATS_SRC_GNSS_SPEED,
+} stats_source_t;
+
+// Functions
+void stats_init(void);
+void stats_config_channel(int channel, stats_source_t source, uint8_t can_id);
+void stats_set_rate(uint32_t sample_ms);
+void stats_reset(void);
+void stats_process_cmd(unsigned char *data, unsigned int len,
+		void(*reply_func)(unsigned char *data, unsigned int len));
+void stats_print(void);
+
+#endif /* MAIN_STATS_H_ */
@@ -0,0 +1,239 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include "task_stats.h"
+#include "datatypes.h"
+#include "buffer.h"
+#include "mempools.h"
+#include "commands.h"
+#include "lispif.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+/*
+ * Per-task CPU and stack telemetry built on uxTaskGetSystemState.
+ * CPU deltas are kept against the previous query, so polling
+ * COMM_TASK_STATS once a second gives per-second CPU shares directly.
+ * Queries arrive on the command-processing thread only, so the
+ * previous-snapshot state needs no locking (same assumption as the
+ * threads terminal command, which keeps its own snapshot).
+ */
+
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+static uint32_t prev_task_num[TASK_STATS_MAX_TASKS];
+static uint32_t prev_run_time[TASK_STATS_MAX_TASKS];
+static int prev_num = 0;
+static uint32_t prev_time_total = 0;
+#endif
+
+/*
+ * Continuous stack-headroom monitor. A low-priority task samples every
+ * task's high-water mark periodically; the first time a task drops
+ * below the warning level a counter is bumped, a line goes out through
+ * the deferred log and scripts subscribed to event-stack-warn get an
+ * event. A task is warned again only when its headroom halves below
+ * the previously warned level, so a task hovering at the threshold
+ * does not flood the channels. The warning counter and level ride
+ * along in the COMM_TASK_STATS reply so fleet tooling sees overflow
+ * pressure without streaming full per-task tables.
+ */
+static volatile uint16_t stack_warn_level = TASK_STATS_WARN_DEFAULT;
+static volatile uint16_t stack_warn_cnt = 0;
+
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+static uint32_t warn_task_num[TASK_STATS_MAX_TASKS];
+static uint16_t warn_task_free[TASK_STATS_MAX_TASKS];
+static int warn_num = 0;
+
+static void stack_monitor_check(void) {
+	int num_tasks = uxTaskGetNumberOfTasks();
+	TaskStatus_t *tasks = malloc((size_t)num_tasks * sizeof(TaskStatus_t));
+	if (tasks == NULL) {
+		return;
+	}
+
+	num_tasks = uxTaskGetSystemState(tasks, num_tasks, NULL);
+
+	for (int i = 0;i < num_tasks;i++) {
+		uint16_t min_free = tasks[i].usStackHighWaterMark;
+		if (min_free >= stack_warn_level) {
+			continue;
+		}
+
+		int slot = -1;
+		bool warn = true;
+		for (int j = 0;j < warn_num;j++) {
+			if (warn_task_num[j] == tasks[i].xTaskNumber) {
+				slot = j;
+				warn = min_free < warn_task_free[j] / 2;
+				break;
+			}
+		}
+
+		if (slot < 0 && warn_num < TASK_STATS_MAX_TASKS) {
+			slot = warn_num++;
+		}
+
+		if (warn && slot >= 0) {
+			warn_task_num[slot] = tasks[i].xTaskNumber;
+			warn_task_free[slot] = min_free;
+			stack_warn_cnt++;
+
+			commands_log_deferred("Task %u stack low: %u free (min)",
+					tasks[i].xTaskNumber, min_free, 0, 0);
+			lispif_process_stack_warn(tasks[i].pcTaskName, min_free);
+		}
+	}
+
+	free(tasks);
+}
+
+static void stack_monitor_task(void *arg) {
+	(void)arg;
+
+	for (;;) {
+		vTaskDelay(TASK_STATS_SAMPLE_MS / portTICK_PERIOD_MS);
+		stack_monitor_check();
+	}
+
+	vTaskDelete(NULL);
+}
+#endif
+
+void task_stats_monitor_start(void) {
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+	xTaskCreatePinnedToCore(stack_monitor_task, "stack_mon", 2560, NULL, 1,
+			NULL, tskNO_AFFINITY);
+#endif
+}
+
+void task_stats_set_stack_warn(uint16_t level) {
+	stack_warn_level = level;
+}
+
+uint16_t task_stats_get_stack_warn(void) {
+	return stack_warn_level;
+}
+
+uint16_t task_stats_get_stack_warn_cnt(void) {
+	return stack_warn_cnt;
+}
+
+bool task_stats_get(task_stats_t *stats) {
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+	int num_tasks = uxTaskGetNumberOfTasks();
+	TaskStatus_t *tasks = malloc((size_t)num_tasks * sizeof(TaskStatus_t));
+	if (tasks == NULL) {
+		return false;
+	}
+
+	uint32_t time_total = 0;
+	num_tasks = uxTaskGetSystemState(tasks, num_tasks, &time_total);
+	if (num_tasks > TASK_STATS_MAX_TASKS) {
+		num_tasks = TASK_STATS_MAX_TASKS;
+	}
+
+	stats->time_total = time_total;
+	stats->time_delta = time_total - prev_time_total;
+	stats->num_tasks = num_tasks;
+
+	for (int i = 0;i < num_tasks;i++) {
+		task_stat_t *t = &stats->tasks[i];
+		t->task_num = tasks[i].xTaskNumber;
+		t->run_time = tasks[i].ulRunTimeCounter;
+		// A task not present in the previous snapshot was created since
+		// then, so its full runtime is also its delta.
+		t->run_time_delta = tasks[i].ulRunTimeCounter;
+		for (int j = 0;j < prev_num;j++) {
+			if (prev_task_num[j] == tasks[i].xTaskNumber) {
+				t->run_time_delta = tasks[i].ulRunTimeCounter - prev_run_time[j];
+				break;
+			}
+		}
+		t->stack_min_free = tasks[i].usStackHighWaterMark;
+		t->state = (uint8_t)tasks[i].eCurrentState;
+		t->prio = (uint8_t)tasks[i].uxBasePriority;
+		strncpy(t->name, tasks[i].pcTaskName, TASK_STATS_NAME_LEN - 1);
+		t->name[TASK_STATS_NAME_LEN - 1] = '\0';
+
+		prev_task_num[i] = tasks[i].xTaskNumber;
+		prev_run_time[i] = tasks[i].ulRunTimeCounter;
+	}
+
+	prev_num = num_tasks;
+	prev_time_total = time_total;
+
+	free(tasks);
+	return true;
+#else
+	(void)stats;
+	return false;
+#endif
+}
+
+void task_stats_process_cmd(unsigned char *data, unsigned int len,
+		void(*reply_func)(unsigned char *data, unsigned int len)) {
+	(void)data; (void)len;
+
+	task_stats_t *stats = malloc(sizeof(task_stats_t));
+	if (stats == NULL) {
+		return;
+	}
+
+	uint8_t *send_buffer = mempools_get_packet_buffer();
+	int32_t ind = 0;
+	send_buffer[ind++] = COMM_TASK_STATS;
+
+	if (task_stats_get(stats)) {
+		send_buffer[ind++] = (uint8_t)stats->num_tasks;
+		buffer_append_uint32(send_buffer, stats->time_total, &ind);
+		buffer_append_uint32(send_buffer, stats->time_delta, &ind);
+		buffer_append_uint16(send_buffer, stack_warn_level, &ind);
+		buffer_append_uint16(send_buffer, stack_warn_cnt, &ind);
+
+		for (int i = 0;i < stats->num_tasks;i++) {
+			task_stat_t *t = &stats->tasks[i];
+			send_buffer[ind++] = (uint8_t)t->task_num;
+			send_buffer[ind++] = t->state;
+			send_buffer[ind++] = t->prio;
+			buffer_append_uint16(send_buffer, t->stack_min_free, &ind);
+			buffer_append_uint32(send_buffer, t->run_time, &ind);
+			buffer_append_uint32(send_buffer, t->run_time_delta, &ind);
+			strcpy((char*)(send_buffer + ind), t->name);
+			ind += (int32_t)strlen(t->name) + 1;
+		}
+	} else {
+		// Trace facility not compiled in (or out of memory), report
+		// zero tasks so the client can tell the difference from an
+		// empty system.
+		send_buffer[ind++] = 0;
+		buffer_append_uint32(send_buffer, 0, &ind);
+		buffer_append_uint32(send_buffer, 0, &ind);
+		buffer_append_uint16(send_buffer, 0, &ind);
+		buffer_append_uint16(send_buffer, 0, &ind);
+	}
+
+	reply_func(send_buffer, ind);
+	mempools_free_packet_buffer(send_buffer);
+	free(stats);
+}
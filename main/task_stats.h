@@ -0,0 +1,60 @@
+/*
+	Copyright 2025 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The VESC firmware is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#ifndef MAIN_TASK_STATS_H_
+#define MAIN_TASK_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Settings
+#define TASK_STATS_MAX_TASKS		24
+#define TASK_STATS_NAME_LEN			16
+#define TASK_STATS_SAMPLE_MS		5000
+// Default stack headroom warning threshold, in the units FreeRTOS
+// reports the high-water mark in.
+#define TASK_STATS_WARN_DEFAULT		256
+
+typedef struct {
+	uint32_t task_num;        // FreeRTOS task number, stable across queries
+	uint32_t run_time;        // Total runtime-counter time spent in the task
+	uint32_t run_time_delta;  // Runtime since the previous query
+	uint16_t stack_min_free;  // Stack high-water mark in words
+	uint8_t state;            // eTaskState at the time of the query
+	uint8_t prio;             // Base priority
+	char name[TASK_STATS_NAME_LEN];
+} task_stat_t;
+
+typedef struct {
+	uint32_t time_total;      // Total runtime-counter time
+	uint32_t time_delta;      // Counter time since the previous query
+	int num_tasks;
+	task_stat_t tasks[TASK_STATS_MAX_TASKS];
+} task_stats_t;
+
+// Functions
+bool task_stats_get(task_stats_t *stats);
+void task_stats_process_cmd(unsigned char *data, unsigned int len,
+		void(*reply_func)(unsigned char *data, unsigned int len));
+void task_stats_monitor_start(void);
+void task_stats_set_stack_warn(uint16_t level);
+uint16_t task_stats_get_stack_warn(void);
+uint16_t task_stats_get_stack_warn_cnt(void);
+
+#endif /* MAIN_TASK_STATS_H_ */
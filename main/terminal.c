@@ -22,7 +22,29 @@
 #include "commands.h"
 #include "comm_can.h"
 #include "comm_ble.h"
+#include "comm_uart.h"
 #include "ble/custom_ble.h"
+#include "ble_c6_enhancements.h"
+#include "lispif.h"
+#include "packet.h"
+#include "crc.h"
+#include "display/lispif_disp_extensions.h"
+#include "log.h"
+#include "samp_stats.h"
+#include "stats.h"
+#include "bench.h"
+#include "perf.h"
+#include "test_c6_integration.h"
+#include "pc_prof.h"
+#include "pkt_trace.h"
+#include "gc_stats.h"
+#include "perf_snap.h"
+#include "soak.h"
+#include "flash_helper.h"
+#include "lbm_bench.h"
+#include "mempools.h"
+#include "heap_track.h"
+#include "esp_cpu.h"
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
@@ -46,6 +68,7 @@
 
 // Settings
 #define CALLBACK_LEN						40
+#define CALLBACK_HASH_LEN					64 // Power of two, larger than CALLBACK_LEN
 
 // Private types
 typedef struct _terminal_callback_struct {
@@ -65,10 +88,65 @@ typedef struct {
 static terminal_callback_struct callbacks[CALLBACK_LEN];
 static int callback_write = 0;
 
+/*
+ * Hash index over the registered callbacks. Each entry holds the index into
+ * callbacks[] plus one, 0 meaning empty, with linear probing on collisions.
+ * Lookups stay O(1) regardless of how many commands hardware variants and
+ * scripts register, which matters for tooling that issues hundreds of
+ * terminal commands in a row. The index is rebuilt from callbacks[] on every
+ * registration change since those are rare and the table is tiny.
+ */
+static uint8_t callback_hash[CALLBACK_HASH_LEN];
+
 static taskinfo_struct *prev_taskinfo = NULL;
 static size_t prev_taskinfo_n = 0;
 static uint32_t prev_time = 0;
 
+// FNV-1a, good enough distribution for short command names.
+static uint32_t callback_hash_str(const char *str) {
+	uint32_t hash = 2166136261u;
+	for (int i = 0;str[i] != '\0';i++) {
+		hash ^= (uint8_t)str[i];
+		hash *= 16777619u;
+	}
+	return hash & (CALLBACK_HASH_LEN - 1);
+}
+
+static void callback_hash_rebuild(void) {
+	memset(callback_hash, 0, sizeof(callback_hash));
+
+	for (int i = 0;i < callback_write;i++) {
+		if (callbacks[i].cbf == 0) {
+			continue;
+		}
+
+		uint32_t pos = callback_hash_str(callbacks[i].command);
+		while (callback_hash[pos] != 0) {
+			pos = (pos + 1) & (CALLBACK_HASH_LEN - 1);
+		}
+		callback_hash[pos] = i + 1;
+	}
+}
+
+static terminal_callback_struct *callback_hash_lookup(const char *command) {
+	uint32_t pos = callback_hash_str(command);
+
+	for (int i = 0;i < CALLBACK_HASH_LEN;i++) {
+		if (callback_hash[pos] == 0) {
+			return NULL;
+		}
+
+		terminal_callback_struct *cb = &callbacks[callback_hash[pos] - 1];
+		if (cb->cbf != 0 && strcmp(command, cb->command) == 0) {
+			return cb;
+		}
+
+		pos = (pos + 1) & (CALLBACK_HASH_LEN - 1);
+	}
+
+	return NULL;
+}
+
 const char* utils_hw_type_to_string(HW_TYPE hw) {
 	switch (hw) {
 	case HW_TYPE_VESC: return "HW_TYPE_VESC"; break;
@@ -101,11 +179,10 @@ void terminal_process_string(char *str) {
 		argv[0][i] = tolower(argv[0][i]);
 	}
 
-	for (int i = 0;i < callback_write;i++) {
-		if (callbacks[i].cbf != 0 && strcmp(argv[0], callbacks[i].command) == 0) {
-			callbacks[i].cbf(argc, (const char**)argv);
-			return;
-		}
+	terminal_callback_struct *cb = callback_hash_lookup(argv[0]);
+	if (cb) {
+		cb->cbf(argc, (const char**)argv);
+		return;
 	}
 
 	if (strcmp(argv[0], "threads") == 0) {
@@ -200,7 +277,20 @@ void terminal_process_string(char *str) {
 		commands_printf("BLE MTU           : %d", comm_ble_mtu_now());
 		commands_printf("BLE Connected     : %d", comm_ble_is_connected());
 		commands_printf("Custom BLE Started: %d", custom_ble_started());
+		commands_printf("BLE TX Drops      : %lu", comm_ble_get_tx_drops());
+		commands_printf("BLE PHY TX/RX     : %d/%d", ble_c6_link_get_tx_phy(), ble_c6_link_get_rx_phy());
+		commands_printf("BLE TX PDU Len    : %d", ble_c6_link_get_tx_data_len());
+		commands_printf("BLE TX Rate       : %lu bps", ble_c6_link_get_tx_bps());
+		commands_printf("BLE RX Rate       : %lu bps", ble_c6_link_get_rx_bps());
 		commands_printf("CAN RX Recoveries : %d", comm_can_get_rx_recovery_cnt());
+		commands_printf("CAN RX Evictions  : %lu", comm_can_get_rx_slot_evictions());
+		commands_printf("CAN RX Drops      : %lu", comm_can_get_rx_slot_drops());
+		commands_printf("UART RX Overflows : %lu", comm_uart_get_overflow_cnt());
+		commands_printf("UART Frame Errors : %lu", comm_uart_get_frame_err_cnt());
+		commands_printf("UART Parity Errors: %lu", comm_uart_get_parity_err_cnt());
+		commands_printf("UDP Seq Drops     : %lu", comm_wifi_get_udp_seq_drops());
+		commands_printf("WIFI Reconnects   : %lu", comm_wifi_get_reconnect_cnt());
+		commands_printf("WIFI Reconn Last  : %lu ms", comm_wifi_get_reconnect_time_last_ms());
 
 		esp_ip4_addr_t ip = comm_wifi_get_ip();
 		esp_ip4_addr_t ip_client = comm_wifi_get_ip_client();
@@ -267,6 +357,273 @@ void terminal_process_string(char *str) {
 		} else {
 			commands_printf("No CAN devices found\n");
 		}
+	} else if (strcmp(argv[0], "crc_bench") == 0) {
+		const unsigned int bench_len = 4096;
+		const int iterations = 64;
+
+		uint8_t *buf = malloc(bench_len);
+		if (!buf) {
+			commands_printf("Out of memory\n");
+			return;
+		}
+
+		for (unsigned int i = 0;i < bench_len;i++) {
+			buf[i] = (uint8_t)(i * 31);
+		}
+
+		volatile unsigned short res16 = 0;
+		uint32_t start = esp_cpu_get_cycle_count();
+		for (int i = 0;i < iterations;i++) {
+			res16 = crc16(buf, bench_len);
+		}
+		uint32_t cycles16 = esp_cpu_get_cycle_count() - start;
+
+		volatile uint32_t res32 = 0;
+		start = esp_cpu_get_cycle_count();
+		for (int i = 0;i < iterations;i++) {
+			res32 = crc32_with_init(buf, bench_len, 0);
+		}
+		uint32_t cycles32 = esp_cpu_get_cycle_count() - start;
+
+		uint32_t total = bench_len * iterations;
+		commands_printf("CRC benchmark, %lu bytes total", total);
+		commands_printf("CRC16: %.3f cycles/byte (0x%04x)",
+				(double)cycles16 / (double)total, res16);
+		commands_printf("CRC32: %.3f cycles/byte (0x%08lx)",
+				(double)cycles32 / (double)total, res32);
+		commands_printf(" ");
+
+		free(buf);
+	} else if (strcmp(argv[0], "cmd_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			commands_reset_stats();
+			commands_printf("Command statistics reset\n");
+		} else {
+			commands_print_stats();
+		}
+	} else if (strcmp(argv[0], "pool_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			mempools_reset_stats();
+			commands_printf("Pool statistics reset\n");
+		} else {
+			mempools_print_stats();
+		}
+	} else if (strcmp(argv[0], "heap_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			heap_track_reset_stats();
+			commands_printf("Heap statistics reset\n");
+		} else {
+			heap_track_print_stats();
+		}
+	} else if (strcmp(argv[0], "ride_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			stats_reset();
+			commands_printf("Aggregation windows reset\n");
+		} else {
+			stats_print();
+		}
+	} else if (strcmp(argv[0], "bench") == 0) {
+		bench_run(argc, (const char **)argv);
+	} else if (strcmp(argv[0], "perf_report") == 0) {
+		test_perf_report(argc, (const char **)argv);
+	} else if (strcmp(argv[0], "perf_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			perf_reset();
+			commands_printf("Perf counters reset\n");
+		} else {
+			perf_print();
+		}
+	} else if (strcmp(argv[0], "samp_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			samp_stats_reset();
+			commands_printf("Sampling statistics reset\n");
+		} else {
+			samp_stats_print();
+		}
+	} else if (strcmp(argv[0], "can_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			comm_can_stats_reset();
+			commands_printf("CAN statistics reset\n");
+		} else {
+			can_stats_t stats;
+			comm_can_stats_get(&stats);
+
+			commands_printf("RX Frames/s   : %lu", stats.rx_frames_sec);
+			commands_printf("TX Frames/s   : %lu", stats.tx_frames_sec);
+			commands_printf("Bus Load      : %.1f %%", (double)stats.bus_load);
+			commands_printf("TX Queue Max  : %lu", stats.tx_queue_max);
+			commands_printf("RX Ring Drops : %lu", stats.rx_ring_drops);
+			commands_printf("RX Missed     : %lu", stats.rx_missed);
+			commands_printf("Ping Latency  : <0.5ms: %lu, <1ms: %lu, <2ms: %lu, "
+					"<5ms: %lu, <=10ms: %lu, timeout: %lu",
+					stats.ping_hist[0], stats.ping_hist[1], stats.ping_hist[2],
+					stats.ping_hist[3], stats.ping_hist[4], stats.ping_hist[5]);
+
+			for (int i = 0;i < 255;i++) {
+				uint16_t t = comm_can_ping_time_last(i);
+				if (t > 0) {
+					commands_printf("Node %3d Ping : %u us", i, t);
+				}
+			}
+			commands_printf(" ");
+		}
+	} else if (strcmp(argv[0], "pc_prof") == 0) {
+		if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+			int rate = 1000;
+			if (argc == 3) {
+				sscanf(argv[2], "%d", &rate);
+			}
+
+			commands_printf(pc_prof_start((uint32_t)rate) ?
+					"Profiler started\n" : "Could not start, check rate (10 to 20000 Hz)\n");
+		} else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+			commands_printf(pc_prof_stop() ?
+					"Profiler stopped\n" : "Profiler was not running\n");
+		} else {
+			pc_prof_dump();
+		}
+	} else if (strcmp(argv[0], "flash_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			flash_helper_stats_reset();
+			commands_printf("Flash stats reset\n");
+		} else {
+			flash_helper_print_stats();
+		}
+	} else if (strcmp(argv[0], "gc_stats") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			gc_stats_reset();
+			commands_printf("GC stats reset\n");
+		} else if (argc == 2 && strcmp(argv[1], "log_start") == 0) {
+			commands_printf(gc_stats_log_start() ?
+					"GC log started\n" : "Could not start, check SD card\n");
+		} else if (argc == 2 && strcmp(argv[1], "log_stop") == 0) {
+			gc_stats_log_stop();
+			commands_printf("GC log stopped\n");
+		} else {
+			gc_stats_print();
+		}
+	} else if (strcmp(argv[0], "pkt_trace") == 0) {
+		if (argc == 2 && strcmp(argv[1], "start") == 0) {
+			pkt_trace_enable(true);
+			commands_printf("Packet tracing started\n");
+		} else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+			pkt_trace_enable(false);
+			commands_printf("Packet tracing stopped\n");
+		} else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			pkt_trace_reset();
+			commands_printf("Packet trace stats reset\n");
+		} else {
+			pkt_trace_print();
+		}
+	} else if (strcmp(argv[0], "perf_snap") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			perf_snap_reset();
+			commands_printf("Perf snapshots reset\n");
+		} else {
+			perf_snap_print();
+		}
+	} else if (strcmp(argv[0], "soak") == 0) {
+		if (argc >= 2 && strcmp(argv[1], "start") == 0) {
+			int min = SOAK_MINUTES_DEFAULT;
+			int fps = SOAK_CAN_FPS_DEFAULT;
+			int lisp = 1;
+			int pad = SOAK_SD_PAD_DEFAULT;
+
+			if (argc >= 3) {
+				sscanf(argv[2], "%d", &min);
+			}
+			if (argc >= 4) {
+				sscanf(argv[3], "%d", &fps);
+			}
+			if (argc >= 5) {
+				sscanf(argv[4], "%d", &lisp);
+			}
+			if (argc >= 6) {
+				sscanf(argv[5], "%d", &pad);
+			}
+
+			commands_printf(soak_start(min, fps, lisp, pad) ?
+					"Soak started\n" :
+					"Could not start, already running or check SD card\n");
+		} else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+			soak_stop();
+			commands_printf("Soak stop requested\n");
+		} else {
+			soak_print_status();
+		}
+	} else if (strcmp(argv[0], "wifi_link") == 0) {
+		if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+			comm_wifi_link_stats_reset();
+			commands_printf("WiFi link stats reset\n");
+		} else if (argc == 2 && strcmp(argv[1], "ctrl_on") == 0) {
+			comm_wifi_link_rate_ctrl_set(true);
+			commands_printf("WiFi congestion controller enabled\n");
+		} else if (argc == 2 && strcmp(argv[1], "ctrl_off") == 0) {
+			comm_wifi_link_rate_ctrl_set(false);
+			commands_printf("WiFi congestion controller disabled\n");
+		} else {
+			comm_wifi_print_link_stats();
+		}
+	} else if (strcmp(argv[0], "lbm_bench") == 0) {
+		lbm_bench_run_all_print();
+	} else if (strcmp(argv[0], "lisp_prof") == 0) {
+		if (argc == 2 && strcmp(argv[1], "start") == 0) {
+			commands_printf(lispif_prof_start() ?
+					"Profiler started\n" : "Profiler restarted\n");
+		} else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+			commands_printf(lispif_prof_stop() ?
+					"Profiler stopped\n" : "Profiler was not running\n");
+		} else {
+			char *buf = malloc(PACKET_MAX_PL_LEN);
+			if (buf) {
+				int len = lispif_prof_dump_folded(buf, PACKET_MAX_PL_LEN);
+				buf[len] = '\0';
+
+				// One print per folded line so the dump is not cut off
+				// by the print buffer size.
+				char *line = buf;
+				for (char *p = buf;*p != '\0';p++) {
+					if (*p == '\n') {
+						*p = '\0';
+						commands_printf("%s", line);
+						line = p + 1;
+					}
+				}
+				commands_printf(" ");
+
+				free(buf);
+			}
+		}
+	} else if (strcmp(argv[0], "disp_bench") == 0) {
+		if (argc == 3) {
+			int w = -1;
+			int h = -1;
+			sscanf(argv[1], "%d", &w);
+			sscanf(argv[2], "%d", &h);
+
+			if (w >= 32 && h >= 32 && w <= 1024 && h <= 1024) {
+				if (!lispif_disp_benchmark((uint16_t)w, (uint16_t)h)) {
+					commands_printf("Benchmark failed. Is a display driver loaded?\n");
+				}
+			} else {
+				commands_printf("Invalid display size.\n");
+			}
+		} else {
+			commands_printf("This command requires width and height arguments.\n");
+		}
+	} else if (strcmp(argv[0], "sd_bench") == 0) {
+		int mb = 8;
+		if (argc == 2) {
+			sscanf(argv[1], "%d", &mb);
+		}
+
+		if (mb >= 1 && mb <= 64) {
+			if (!log_benchmark(mb)) {
+				commands_printf("Benchmark failed. Is a card mounted?\n");
+			}
+		} else {
+			commands_printf("Invalid size, use 1 to 64 MB.\n");
+		}
 	} else if (strcmp(argv[0], "uptime") == 0) {
 		commands_printf("Uptime: %.2f s", (double)(utils_ms_tot() / 1000.0));
 	} else if (strcmp(argv[0], "store_log_context") == 0) {
@@ -302,6 +659,91 @@ void terminal_process_string(char *str) {
 		commands_printf("can_scan");
 		commands_printf("  Scan CAN-bus using ping commands, and print all devices that are found.");
 
+		commands_printf("crc_bench");
+		commands_printf("  Benchmark the CRC16/CRC32 implementations and print cycles per byte.");
+
+		commands_printf("cmd_stats [reset]");
+		commands_printf("  Print invocation counts and cycle times per command, or reset them.");
+
+		commands_printf("pool_stats [reset]");
+		commands_printf("  Print buffer pool usage, pressure and hold-time stats, or reset them.");
+
+		commands_printf("heap_stats [reset]");
+		commands_printf("  Print per-site heap usage and the free-bytes versus largest-block");
+		commands_printf("  trend, or reset them.");
+
+		commands_printf("ride_stats [reset]");
+		commands_printf("  Print the on-device aggregation channels (min/max/mean/stddev),");
+		commands_printf("  or reset their windows.");
+
+		commands_printf("bench [kernel]");
+		commands_printf("  Run the on-target micro-benchmarks and print one CSV line per");
+		commands_printf("  kernel. Kernels: crc16 packet buffer blit q16 lbm all.");
+
+		commands_printf("perf_report [write_flash]");
+		commands_printf("  Run the cross-chip performance validation suite and print one");
+		commands_printf("  CSV line per figure. write_flash adds a flash write measurement");
+		commands_printf("  that erases the stored QML data.");
+
+		commands_printf("perf_stats [reset]");
+		commands_printf("  Print count/total/max cycle tables for the PERF_ENTER/PERF_EXIT");
+		commands_printf("  instrumentation sites, or reset them.");
+
+		commands_printf("samp_stats [reset]");
+		commands_printf("  Print inter-sample interval histograms for the IMU, ADC and");
+		commands_printf("  encoder sampling loops, or reset them.");
+
+		commands_printf("can_stats [reset]");
+		commands_printf("  Print CAN bus load, frame rates and ping latency stats, or reset them.");
+
+		commands_printf("pc_prof [start|stop] [optRateHz]");
+		commands_printf("  Control the whole-firmware sampling profiler, or dump the");
+		commands_printf("  address:count histogram to resolve against the ELF offline.");
+
+		commands_printf("flash_stats [reset]");
+		commands_printf("  Print per-partition flash erase/write/read counts, byte totals");
+		commands_printf("  and latency histograms, or reset them.");
+
+		commands_printf("gc_stats [reset|log_start|log_stop]");
+		commands_printf("  Print recent lisp GC and heap telemetry windows, reset them,");
+		commands_printf("  or stream them to the SD card as a CSV log.");
+
+		commands_printf("pkt_trace [start|stop|reset]");
+		commands_printf("  Control packet lifecycle tracing, or print per-stage cycle");
+		commands_printf("  histograms and recent full traces when run without arguments.");
+
+		commands_printf("perf_snap [reset]");
+		commands_printf("  Print the persistent performance snapshot ring (heap, worker");
+		commands_printf("  queue, last packet ids, busiest tasks). Survives watchdog and");
+		commands_printf("  panic resets for post-mortem analysis.");
+
+		commands_printf("soak [start|stop] [optMin] [optCanFps] [optLisp] [optSdPadBytes]");
+		commands_printf("  Control the soak-test load generator, or print its status.");
+		commands_printf("  Generates CAN TX, lisp and SD load while recording a perf");
+		commands_printf("  sample per second to the SD card.");
+
+		commands_printf("wifi_link [reset|ctrl_on|ctrl_off]");
+		commands_printf("  Print WiFi link-quality stats (RSSI, TX retries, blocking");
+		commands_printf("  times, congestion scale), reset them, or switch the");
+		commands_printf("  congestion controller.");
+
+		commands_printf("lbm_bench");
+		commands_printf("  Run the embedded lispBM interpreter benchmarks and print");
+		commands_printf("  eval time, steps/s and GC stats per benchmark. Restarts the");
+		commands_printf("  running script.");
+
+		commands_printf("lisp_prof [start|stop]");
+		commands_printf("  Control the lisp sampling profiler, or dump the collected samples");
+		commands_printf("  in folded-stack format when run without arguments.");
+
+		commands_printf("disp_bench [width] [height]");
+		commands_printf("  Run display benchmark scenes against the loaded driver and print");
+		commands_printf("  fps, bandwidth and cpu share per scene.");
+
+		commands_printf("sd_bench [optMb]");
+		commands_printf("  Write optMb (default 8) MB to the SD card and print the");
+		commands_printf("  sequential write rate.");
+
 		commands_printf("uptime");
 		commands_printf("  Prints how many seconds have passed since boot.");
 		
@@ -394,6 +836,8 @@ void terminal_register_command_callback(
 			callback_write = 0;
 		}
 	}
+
+	callback_hash_rebuild();
 }
 
 void terminal_unregister_callback(void(*cbf)(int argc, const char **argv)) {
@@ -402,4 +846,41 @@ void terminal_unregister_callback(void(*cbf)(int argc, const char **argv)) {
 			callbacks[i].cbf = 0;
 		}
 	}
+
+	callback_hash_rebuild();
+}
+
+/**
+ * List registered commands that start with a given prefix, e.g. for
+ * command-line completion in tooling.
+ *
+ * @param prefix
+ * The prefix to match. An empty string or NULL matches all commands.
+ *
+ * @param commands
+ * Output array that is filled with pointers to the matching command names.
+ *
+ * @param max_num
+ * The capacity of the output array.
+ *
+ * @return
+ * The number of matching commands stored.
+ */
+int terminal_get_matching_commands(
+		const char *prefix, const char **commands, int max_num) {
+	size_t prefix_len = prefix ? strlen(prefix) : 0;
+	int num = 0;
+
+	for (int i = 0;i < callback_write && num < max_num;i++) {
+		if (callbacks[i].cbf == 0) {
+			continue;
+		}
+
+		if (prefix_len == 0 ||
+				strncmp(callbacks[i].command, prefix, prefix_len) == 0) {
+			commands[num++] = callbacks[i].command;
+		}
+	}
+
+	return num;
 }
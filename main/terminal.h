@@ -30,5 +30,7 @@ void terminal_register_command_callback(
 		const char *arg_names,
 		void(*cbf)(int argc, const char **argv));
 void terminal_unregister_callback(void(*cbf)(int argc, const char **argv));
+int terminal_get_matching_commands(
+		const char *prefix, const char **commands, int max_num);
 
 #endif /* TERMINAL_H_ */
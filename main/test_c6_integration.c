@@ -19,6 +19,22 @@
 
 #include "test_c6_integration.h"
 
+// Cross-chip includes, used by the perf report at the bottom of this file.
+#include "conf_general.h"
+#include "main.h"
+#include "commands.h"
+#include "packet.h"
+#include "comm_usb.h"
+#include "comm_can.h"
+#include "flash_helper.h"
+#include "lispif.h"
+#include "display/lispif_disp_extensions.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+#include <stdlib.h>
+
 #ifdef CONFIG_IDF_TARGET_ESP32C6
 
 #include "esp_log.h"
@@ -194,4 +210,235 @@ void test_c6_integration_basic(void) {}
 void test_c6_integration_stress(void) {}
 void test_c6_integration_performance(void) {}
 void test_c6_integration_comprehensive(void) {}
-#endif /* CONFIG_IDF_TARGET_ESP32C6 */
\ No newline at end of file
+
+#endif
+
+/*
+ * Cross-chip performance validation report. Unlike the bring-up tests
+ * above, this compiles for every target so the same report can be
+ * captured on an ESP32-C3 and an ESP32-C6 build of the same firmware
+ * and diffed per figure. Every measurement comes out as one CSV line
+ * prefixed with perf_report, so the output can be scraped off the
+ * terminal, same scheme as the bench command.
+ */
+
+#define PERF_PL_LEN         256
+#define PERF_FLASH_CHUNK    4096
+#define PERF_FLASH_TOTAL    (64 * 1024)
+
+// Keeps the compiler from discarding measured work.
+static volatile uint32_t perf_sink = 0;
+
+static uint8_t perf_framed[PERF_PL_LEN + 8];
+static unsigned int perf_framed_len = 0;
+
+static void perf_send_null(unsigned char *data, unsigned int len) {
+    (void)data; (void)len;
+}
+
+static void perf_send_capture(unsigned char *data, unsigned int len) {
+    if (len <= sizeof(perf_framed)) {
+        memcpy(perf_framed, data, len);
+        perf_framed_len = len;
+    }
+}
+
+static void perf_process_null(unsigned char *data, unsigned int len) {
+    (void)len;
+    perf_sink += data[0];
+}
+
+static float perf_mb_s(uint32_t bytes, uint32_t us) {
+    if (us == 0) {
+        return 0.0;
+    }
+    // Bytes per microsecond is MB/s.
+    return (float)bytes / (float)us;
+}
+
+// CPU-side packet framing and parsing throughput. This bounds what any
+// transport can move regardless of its own line rate, so the same
+// figure on both chips separates protocol-stack gains from radio and
+// driver gains.
+static void perf_packet(void) {
+    const uint32_t iters = 500;
+
+    PACKET_STATE_t *st = calloc(1, sizeof(PACKET_STATE_t));
+    uint8_t *pl = malloc(PERF_PL_LEN);
+    if (!st || !pl) {
+        free(st); free(pl);
+        commands_printf("perf_report,packet,error=no_mem");
+        return;
+    }
+
+    for (int i = 0;i < PERF_PL_LEN;i++) {
+        pl[i] = (uint8_t)i;
+    }
+
+    packet_init(perf_send_null, perf_process_null, st);
+
+    int64_t t_start = esp_timer_get_time();
+    for (uint32_t i = 0;i < iters;i++) {
+        packet_send_packet(pl, PERF_PL_LEN, st);
+    }
+    uint32_t enc_us = (uint32_t)(esp_timer_get_time() - t_start);
+
+    packet_init(perf_send_capture, perf_process_null, st);
+    perf_framed_len = 0;
+    packet_send_packet(pl, PERF_PL_LEN, st);
+
+    uint32_t dec_us = 0;
+    if (perf_framed_len > 0) {
+        t_start = esp_timer_get_time();
+        for (uint32_t i = 0;i < iters;i++) {
+            packet_process_buffer(perf_framed, perf_framed_len, st);
+        }
+        dec_us = (uint32_t)(esp_timer_get_time() - t_start);
+    }
+
+    commands_printf("perf_report,packet,pl_len=%d,encode_mb_s=%.2f,decode_mb_s=%.2f",
+            PERF_PL_LEN,
+            (double)perf_mb_s(iters * PERF_PL_LEN, enc_us),
+            (double)perf_mb_s(iters * perf_framed_len, dec_us));
+
+    packet_release_buffers(st);
+    free(st);
+    free(pl);
+}
+
+// Live per-transport throughput from the running stats counters. These
+// are zero on an idle bench; capture the report while the host pulls
+// data to get real line-rate figures.
+static void perf_transports(void) {
+    usb_stats_t usb;
+    comm_usb_stats_get(&usb);
+    commands_printf("perf_report,usb,rx_bytes_s=%lu,tx_bytes_s=%lu",
+            usb.rx_bytes_sec, usb.tx_bytes_sec);
+
+    can_stats_t can;
+    comm_can_stats_get(&can);
+    commands_printf("perf_report,can,rx_frames_s=%lu,tx_frames_s=%lu,bus_load=%.1f,rx_missed=%lu,rx_ring_drops=%lu",
+            can.rx_frames_sec, can.tx_frames_sec, (double)can.bus_load,
+            can.rx_missed, can.rx_ring_drops);
+}
+
+// CAN RX saturation point: how many status frames per second the decode
+// path handles versus how many an 8-byte extended frame bus can carry
+// at the configured baud rate. Headroom below 1.0 means the receiver
+// drops frames before the bus is full.
+static void perf_can_decode(void) {
+    uint32_t dec_fps = comm_can_decode_bench(2000);
+
+    // An extended data frame with 8 payload bytes is about 130 bits on
+    // the wire including average stuffing.
+    int kbits = comm_can_baud_to_kbits(backup.config.can_baud_rate);
+    uint32_t wire_fps = (uint32_t)kbits * 1000 / 130;
+
+    commands_printf("perf_report,can_decode,frames_s=%lu,wire_max_s=%lu,headroom=%.2f",
+            dec_fps, wire_fps,
+            wire_fps > 0 ? (double)dec_fps / (double)wire_fps : 0.0);
+}
+
+// LispBM throughput as function calls per second of a tail-recursive
+// counting loop, including evaluator scheduling. Core-only program so
+// it runs regardless of which dynamic libraries the image started with.
+static void perf_lbm(void) {
+    const uint32_t calls = 10000;
+    const char *prog =
+            "(define perf-f (lambda (n acc) "
+            "(if (= n 0) acc (perf-f (- n 1) (+ acc n))))) "
+            "(perf-f 10000 0)";
+
+    int64_t t_start = esp_timer_get_time();
+    bool ok = lispif_eval_sync(prog, 10000);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+    if (ok && us > 0) {
+        commands_printf("perf_report,lbm,calls_s=%lu",
+                (uint32_t)(((uint64_t)calls * 1000000) / us));
+    } else {
+        commands_printf("perf_report,lbm,skipped=not_running");
+    }
+}
+
+// Display throughput delegates to the driver benchmark scenes, which
+// print their own fps lines. Skipped when no driver is loaded.
+static void perf_display(void) {
+    if (!lispif_disp_benchmark(128, 128)) {
+        commands_printf("perf_report,display,skipped=no_driver");
+    }
+}
+
+// Flash read goes through flash_helper_code_data, so on a healthy
+// build it measures the memory-mapped fast path. The write measurement
+// erases and overwrites the start of the QML partition, so it only
+// runs when asked for explicitly.
+static void perf_flash(bool write_test) {
+    uint8_t *buf = malloc(PERF_FLASH_CHUNK);
+    if (!buf) {
+        commands_printf("perf_report,flash,error=no_mem");
+        return;
+    }
+
+    int64_t t_start = esp_timer_get_time();
+    bool read_ok = true;
+    for (uint32_t off = 0;off < PERF_FLASH_TOTAL;off += PERF_FLASH_CHUNK) {
+        if (!flash_helper_code_data(CODE_IND_QML, off, buf, PERF_FLASH_CHUNK)) {
+            read_ok = false;
+            break;
+        }
+        perf_sink += buf[0];
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+
+    if (read_ok) {
+        commands_printf("perf_report,flash_read,mb_s=%.2f",
+                (double)perf_mb_s(PERF_FLASH_TOTAL, us));
+    } else {
+        commands_printf("perf_report,flash_read,error=read_failed");
+    }
+
+    if (write_test) {
+        for (int i = 0;i < PERF_FLASH_CHUNK;i++) {
+            buf[i] = (uint8_t)i;
+        }
+
+        t_start = esp_timer_get_time();
+        bool write_ok = flash_helper_erase_code(CODE_IND_QML, PERF_FLASH_TOTAL);
+        uint32_t erase_us = (uint32_t)(esp_timer_get_time() - t_start);
+
+        t_start = esp_timer_get_time();
+        for (uint32_t off = 0;write_ok && off < PERF_FLASH_TOTAL;off += PERF_FLASH_CHUNK) {
+            write_ok = flash_helper_write_code(CODE_IND_QML, off, buf,
+                    PERF_FLASH_CHUNK, 0);
+        }
+        us = (uint32_t)(esp_timer_get_time() - t_start);
+
+        if (write_ok) {
+            commands_printf("perf_report,flash_write,erase_ms=%lu,mb_s=%.2f",
+                    erase_us / 1000, (double)perf_mb_s(PERF_FLASH_TOTAL, us));
+        } else {
+            commands_printf("perf_report,flash_write,error=write_failed");
+        }
+    } else {
+        commands_printf("perf_report,flash_write,skipped=keeps_qml_data");
+    }
+
+    free(buf);
+}
+
+void test_perf_report(int argc, const char **argv) {
+    bool write_flash = argc >= 2 && strcmp(argv[1], "write_flash") == 0;
+
+    commands_printf("perf_report,target,chip=%s,fw=%d.%02d",
+            CONFIG_IDF_TARGET, FW_VERSION_MAJOR, FW_VERSION_MINOR);
+
+    perf_packet();
+    perf_transports();
+    perf_can_decode();
+    perf_lbm();
+    perf_display();
+    perf_flash(write_flash);
+
+    commands_printf("perf_report,done");
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+/*
+	Copyright 2024 Benjamin Vedder	benjamin@vedder.se
+
+	This file is part of the VESC firmware.
+
+	The VESC firmware is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The VESC firmware is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    */
+
+#ifndef MAIN_TEST_C6_INTEGRATION_H_
+#define MAIN_TEST_C6_INTEGRATION_H_
+
+// ESP32-C6 bring-up tests. Compiled to empty stubs on other targets.
+void test_c6_integration_basic(void);
+void test_c6_integration_stress(void);
+void test_c6_integration_performance(void);
+void test_c6_integration_comprehensive(void);
+
+// Cross-chip performance validation report, available on every target.
+// Run from the terminal with the perf_report command.
+void test_perf_report(int argc, const char **argv);
+
+#endif /* MAIN_TEST_C6_INTEGRATION_H_ */
@@ -54,6 +54,8 @@ typedef struct {
 
 // Private variables
 static bool m_print_next_nav_sol = false;
+static bool m_print_next_nav_pvt = false;
+static bool m_print_next_nav_dop = false;
 static bool m_print_next_relposned = false;
 static bool m_print_next_rawx = false;
 static bool m_print_next_svin = false;
@@ -71,6 +73,7 @@ static volatile int m_uart_num = 0;
 
 // Private functions
 static void proc_byte(uint8_t ch);
+static void proc_bytes(uint8_t *data, int len);
 static void reset_decoder_state(void);
 static void ubx_terminal_cmd_poll(int argc, const char **argv);
 static void ubx_encode_send(uint8_t class, uint8_t id, uint8_t *msg, int len);
@@ -79,6 +82,8 @@ static int wait_ack_nak(int timeout_ms);
 // Decode functions
 static void ubx_decode(uint8_t class, uint8_t id, uint8_t *msg, int len);
 static void ubx_decode_nav_sol(uint8_t *msg, int len);
+static void ubx_decode_nav_pvt(uint8_t *msg, int len);
+static void ubx_decode_nav_dop(uint8_t *msg, int len);
 static void ubx_decode_relposned(uint8_t *msg, int len);
 static void ubx_decode_svin(uint8_t *msg, int len);
 static void ubx_decode_ack(uint8_t *msg, int len);
@@ -116,6 +121,8 @@ static void ubx_put_R8(uint8_t *msg, int *ind, double data);
 
 // Callbacks
 static void(*rx_nav_sol)(ubx_nav_sol *sol) = 0;
+static void(*rx_nav_pvt)(ubx_nav_pvt *pvt) = 0;
+static void(*rx_nav_dop)(ubx_nav_dop *dop) = 0;
 static void(*rx_relposned)(ubx_nav_relposned *pos) = 0;
 static void(*rx_rawx)(ubx_rxm_rawx *pos) = 0;
 static void(*rx_svin)(ubx_nav_svin *svin) = 0;
@@ -130,10 +137,10 @@ static void rx_task(void *arg) {
 			break;
 		}
 
-		uint8_t c;
-		int res = uart_read_bytes(m_uart_num, &c, 1, 10);
-		if (res == 1) {
-			proc_byte(c);
+		uint8_t buf[128];
+		int res = uart_read_bytes(m_uart_num, buf, sizeof(buf), 10);
+		if (res > 0) {
+			proc_bytes(buf, res);
 		}
 	}
 
@@ -141,7 +148,7 @@ static void rx_task(void *arg) {
 	vTaskDelete(NULL);
 }
 
-bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_tx) {
+bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_tx, bool ubx_only) {
 	m_init_ok = false;
 
 	if (!sem_init_done) {
@@ -209,7 +216,7 @@ bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_
 	uart.in_rtcm2 = false;
 	uart.in_rtcm3 = false;
 	uart.out_ubx = true;
-	uart.out_nmea = true;
+	uart.out_nmea = !ubx_only;
 	uart.out_rtcm3 = false;
 
 	bool baud_ok = false;
@@ -352,9 +359,21 @@ bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_
 		ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_SVIN, 0);
 		ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_SAT, 0);
 
-		ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GGA, 1);
-		ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GSV, 1);
-		ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_RMC, 1);
+		if (ubx_only) {
+			ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_PVT, 1);
+			ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_DOP, 1);
+
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GGA, 0);
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GSV, 0);
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_RMC, 0);
+		} else {
+			ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_PVT, 0);
+			ublox_cfg_msg(UBX_CLASS_NAV, UBX_NAV_DOP, 0);
+
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GGA, 1);
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GSV, 1);
+			ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_RMC, 1);
+		}
 
 		ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GLL, 0);
 		ublox_cfg_msg(UBX_CLASS_NMEA, UBX_NMEA_GSA, 0);
@@ -409,14 +428,26 @@ bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_
 			return false;
 		}
 
-		unsigned char buffer[90];
+		unsigned char buffer[110];
 		int ind = 0;
 
-		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GGA_UART1, 1);
-		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GSV_UART1, 1);
-		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_RMC_UART1, 1);
+		if (ubx_only) {
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GGA_UART1, 0);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GSV_UART1, 0);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_RMC_UART1, 0);
 
-		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_SAT_UART1, 1);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_SAT_UART1, 0);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_PVT_UART1, 1);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_DOP_UART1, 1);
+		} else {
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GGA_UART1, 1);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GSV_UART1, 1);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_RMC_UART1, 1);
+
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_SAT_UART1, 1);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_PVT_UART1, 0);
+			ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_UBX_NAV_DOP_UART1, 0);
+		}
 
 		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_DTM_UART1, 0);
 		ublox_cfg_append_u1(buffer, &ind, CFG_MSGOUT_NMEA_ID_GBS_UART1, 0);
@@ -438,6 +469,8 @@ bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_
 			"ubx_poll",
 			"Poll one of the ubx protocol messages. Supported messages:\n"
 			"  UBX_NAV_SOL - Position solution\n"
+			"  UBX_NAV_PVT - Position, velocity and time solution\n"
+			"  UBX_NAV_DOP - Dilution of precision\n"
 			"  UBX_NAV_RELPOSNED - Relative position to base in NED frame\n"
 			"  UBX_NAV_SVIN - survey-in data\n"
 			"  UBX_RXM_RAWX - raw data\n"
@@ -477,6 +510,14 @@ void ublox_set_rx_callback_nav_sol(void(*func)(ubx_nav_sol *sol)) {
 	rx_nav_sol = func;
 }
 
+void ublox_set_rx_callback_nav_pvt(void(*func)(ubx_nav_pvt *pvt)) {
+	rx_nav_pvt = func;
+}
+
+void ublox_set_rx_callback_nav_dop(void(*func)(ubx_nav_dop *dop)) {
+	rx_nav_dop = func;
+}
+
 void ublox_set_rx_callback_relposned(void(*func)(ubx_nav_relposned *pos)) {
 	rx_relposned = func;
 }
@@ -1079,6 +1120,61 @@ static void proc_byte(uint8_t ch) {
 	}
 }
 
+/*
+ * Process a whole received buffer at once. Sync, header and checksum bytes
+ * still go through proc_byte, but the two spans that make up almost all of
+ * the traffic are handled in bulk: UBX payloads are memcpy:d into the frame
+ * buffer with the checksum updated over the span, and NMEA lines are copied
+ * up to the next newline. That makes the parsing cost proportional to the
+ * number of messages rather than the number of bytes.
+ */
+static void proc_bytes(uint8_t *data, int len) {
+	int i = 0;
+
+	while (i < len) {
+		// Inside a UBX payload; copy as much as the buffer holds in one go.
+		if (m_decoder_state.line_pos == 0 && m_decoder_state.ubx_pos >= 6 &&
+				(m_decoder_state.ubx_pos - 6) < m_decoder_state.ubx_len) {
+			int n = m_decoder_state.ubx_len - (m_decoder_state.ubx_pos - 6);
+			if (n > (len - i)) {
+				n = len - i;
+			}
+
+			memcpy(m_decoder_state.ubx + m_decoder_state.ubx_pos - 6, data + i, n);
+			for (int j = 0;j < n;j++) {
+				m_decoder_state.ubx_ck_a += data[i + j];
+				m_decoder_state.ubx_ck_b += m_decoder_state.ubx_ck_a;
+			}
+			m_decoder_state.ubx_pos += n;
+			i += n;
+			continue;
+		}
+
+		// Inside a NMEA line; copy up to and including the next newline when
+		// it fits in the line buffer. The byte-wise path handles the rare
+		// wrap-around case.
+		if (m_decoder_state.line_pos > 0) {
+			uint8_t *nl = memchr(data + i, '\n', len - i);
+			int n = (nl ? (int)(nl - data) + 1 : len) - i;
+
+			if ((m_decoder_state.line_pos + n) < LINE_BUFFER_SIZE) {
+				memcpy(m_decoder_state.line + m_decoder_state.line_pos, data + i, n);
+				m_decoder_state.line_pos += n;
+				i += n;
+
+				if (nl) {
+					m_decoder_state.line[m_decoder_state.line_pos] = '\0';
+					m_decoder_state.line_pos = 0;
+					nmea_decode_string((const char*)m_decoder_state.line);
+				}
+				continue;
+			}
+		}
+
+		proc_byte(data[i++]);
+	}
+}
+
 static void reset_decoder_state(void) {
 	memset(&m_decoder_state, 0, sizeof(decoder_state));
 }
@@ -1089,6 +1185,14 @@ static void ubx_terminal_cmd_poll(int argc, const char **argv) {
 			m_print_next_nav_sol = true;
 			ublox_poll(UBX_CLASS_NAV, UBX_NAV_SOL);
 			commands_printf("OK\n");
+		} else if (strcmp(argv[1], "UBX_NAV_PVT") == 0) {
+			m_print_next_nav_pvt = true;
+			ublox_poll(UBX_CLASS_NAV, UBX_NAV_PVT);
+			commands_printf("OK\n");
+		} else if (strcmp(argv[1], "UBX_NAV_DOP") == 0) {
+			m_print_next_nav_dop = true;
+			ublox_poll(UBX_CLASS_NAV, UBX_NAV_DOP);
+			commands_printf("OK\n");
 		} else if (strcmp(argv[1], "UBX_NAV_RELPOSNED") == 0) {
 			m_print_next_relposned = true;
 			ublox_poll(UBX_CLASS_NAV, UBX_NAV_RELPOSNED);
@@ -1202,6 +1306,12 @@ static void ubx_decode(uint8_t class, uint8_t id, uint8_t *msg, int len) {
 		case UBX_NAV_SOL:
 			ubx_decode_nav_sol(msg, len);
 			break;
+		case UBX_NAV_PVT:
+			ubx_decode_nav_pvt(msg, len);
+			break;
+		case UBX_NAV_DOP:
+			ubx_decode_nav_dop(msg, len);
+			break;
 		case UBX_NAV_RELPOSNED:
 			ubx_decode_relposned(msg, len);
 			break;
@@ -1337,6 +1447,180 @@ static void ubx_decode_nav_sol(uint8_t *msg, int len) {
 	}
 }
 
+static void ubx_decode_nav_pvt(uint8_t *msg, int len) {
+	(void)len;
+
+	static ubx_nav_pvt pvt;
+	int ind = 0;
+	uint8_t valid;
+	uint8_t flags;
+
+	pvt.i_tow = ubx_get_U4(msg, &ind); // 0
+	pvt.year = ubx_get_U2(msg, &ind); // 4
+	pvt.month = ubx_get_U1(msg, &ind); // 6
+	pvt.day = ubx_get_U1(msg, &ind); // 7
+	pvt.hour = ubx_get_U1(msg, &ind); // 8
+	pvt.min = ubx_get_U1(msg, &ind); // 9
+	pvt.second = ubx_get_U1(msg, &ind); // 10
+	valid = ubx_get_X1(msg, &ind); // 11
+	pvt.valid_date = valid & 0x01;
+	pvt.valid_time = valid & 0x02;
+	ind += 4; // t_acc 12
+	pvt.nano = ubx_get_I4(msg, &ind); // 16
+	pvt.fix_type = ubx_get_U1(msg, &ind); // 20
+	flags = ubx_get_X1(msg, &ind); // 21
+	pvt.gnss_fix_ok = flags & 0x01;
+	pvt.diffsoln = flags & 0x02;
+	pvt.carr_soln = (flags >> 6) & 0x03;
+	ind += 1; // flags2 22
+	pvt.num_sv = ubx_get_U1(msg, &ind); // 23
+	pvt.lon = (double)ubx_get_I4(msg, &ind) / D(10000000.0); // 24
+	pvt.lat = (double)ubx_get_I4(msg, &ind) / D(10000000.0); // 28
+	pvt.height = (float)ubx_get_I4(msg, &ind) / 1000.0; // 32
+	pvt.h_msl = (float)ubx_get_I4(msg, &ind) / 1000.0; // 36
+	pvt.h_acc = (float)ubx_get_U4(msg, &ind) / 1000.0; // 40
+	pvt.v_acc = (float)ubx_get_U4(msg, &ind) / 1000.0; // 44
+	pvt.vel_n = (float)ubx_get_I4(msg, &ind) / 1000.0; // 48
+	pvt.vel_e = (float)ubx_get_I4(msg, &ind) / 1000.0; // 52
+	pvt.vel_d = (float)ubx_get_I4(msg, &ind) / 1000.0; // 56
+	pvt.g_speed = (float)ubx_get_I4(msg, &ind) / 1000.0; // 60
+	pvt.head_mot = (float)ubx_get_I4(msg, &ind) / 100000.0; // 64
+	pvt.s_acc = (float)ubx_get_U4(msg, &ind) / 1000.0; // 68
+	pvt.head_acc = (float)ubx_get_U4(msg, &ind) / 100000.0; // 72
+	pvt.p_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 76
+
+	// Feed the shared nmea state so everything that consumes GGA/RMC
+	// data keeps working unchanged, just at the higher update rate.
+	nmea_state_t *s = nmea_get_state();
+
+	s->gga.lat = pvt.lat;
+	s->gga.lon = pvt.lon;
+	s->gga.height = pvt.h_msl;
+	s->gga.n_sat = pvt.num_sv;
+
+	// Map to the NMEA GGA fix quality enumeration.
+	if (!pvt.gnss_fix_ok) {
+		s->gga.fix_type = 0;
+	} else if (pvt.carr_soln == 2) {
+		s->gga.fix_type = 4;
+	} else if (pvt.carr_soln == 1) {
+		s->gga.fix_type = 5;
+	} else if (pvt.diffsoln) {
+		s->gga.fix_type = 2;
+	} else {
+		s->gga.fix_type = 1;
+	}
+
+	int ms = pvt.nano / 1000000;
+	if (ms < 0) {
+		ms = 0;
+	}
+
+	s->gga.ms_today = (int)pvt.hour * 3600000 + (int)pvt.min * 60000 +
+			(int)pvt.second * 1000 + ms;
+	s->gga.update_time = xTaskGetTickCount();
+	s->gga_cnt++;
+
+	s->rmc.hh = pvt.hour;
+	s->rmc.mm = pvt.min;
+	s->rmc.ss = pvt.second;
+	s->rmc.ms = ms;
+	s->rmc.yy = pvt.year;
+	s->rmc.mo = pvt.month;
+	s->rmc.dd = pvt.day;
+	s->rmc.speed = pvt.g_speed;
+	s->rmc.update_time = xTaskGetTickCount();
+	s->rmc_cnt++;
+
+	nmea_update_derived();
+
+	if (rx_nav_pvt) {
+		rx_nav_pvt(&pvt);
+	}
+
+	if (m_print_next_nav_pvt) {
+		m_print_next_nav_pvt = false;
+		commands_printf(
+				"NAV_PVT RX\n"
+				"num_sv: %d\n"
+				"i_tow: %d ms\n"
+				"fix: %d\n"
+				"Lat: %.7f\n"
+				"Lon: %.7f\n"
+				"Height: %.3f m\n"
+				"Height MSL: %.3f m\n"
+				"h_acc: %.3f m\n"
+				"v_acc: %.3f m\n"
+				"Speed: %.3f m/s\n"
+				"s_acc: %.3f m/s\n"
+				"Heading: %.2f deg\n"
+				"p_dop: %.2f\n"
+				"Fix OK: %d\n"
+				"Diff Soln: %d\n"
+				"Carr Soln: %d\n",
+				pvt.num_sv,
+				pvt.i_tow,
+				pvt.fix_type,
+				pvt.lat,
+				pvt.lon,
+				(double)pvt.height,
+				(double)pvt.h_msl,
+				(double)pvt.h_acc,
+				(double)pvt.v_acc,
+				(double)pvt.g_speed,
+				(double)pvt.s_acc,
+				(double)pvt.head_mot,
+				(double)pvt.p_dop,
+				pvt.gnss_fix_ok,
+				pvt.diffsoln,
+				pvt.carr_soln);
+	}
+}
+
+static void ubx_decode_nav_dop(uint8_t *msg, int len) {
+	(void)len;
+
+	static ubx_nav_dop dop;
+	int ind = 0;
+
+	dop.i_tow = ubx_get_U4(msg, &ind); // 0
+	dop.g_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 4
+	dop.p_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 6
+	dop.t_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 8
+	dop.v_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 10
+	dop.h_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 12
+	dop.n_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 14
+	dop.e_dop = (float)ubx_get_U2(msg, &ind) * 0.01; // 16
+
+	nmea_get_state()->gga.h_dop = dop.h_dop;
+
+	if (rx_nav_dop) {
+		rx_nav_dop(&dop);
+	}
+
+	if (m_print_next_nav_dop) {
+		m_print_next_nav_dop = false;
+		commands_printf(
+				"NAV_DOP RX\n"
+				"i_tow: %d ms\n"
+				"g_dop: %.2f\n"
+				"p_dop: %.2f\n"
+				"t_dop: %.2f\n"
+				"v_dop: %.2f\n"
+				"h_dop: %.2f\n"
+				"n_dop: %.2f\n"
+				"e_dop: %.2f\n",
+				dop.i_tow,
+				(double)dop.g_dop,
+				(double)dop.p_dop,
+				(double)dop.t_dop,
+				(double)dop.v_dop,
+				(double)dop.h_dop,
+				(double)dop.n_dop,
+				(double)dop.e_dop);
+	}
+}
+
 static void ubx_decode_relposned(uint8_t *msg, int len) {
 	(void)len;
 
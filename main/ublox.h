@@ -96,6 +96,54 @@ typedef struct {
 	uint8_t num_sv; // Number of SVs used in Nav Solution
 } ubx_nav_sol;
 
+typedef struct {
+	uint32_t i_tow; // GPS time of week of the navigation epoch
+	uint16_t year; // Year (UTC)
+	uint8_t month; // Month, range 1..12 (UTC)
+	uint8_t day; // Day of month, range 1..31 (UTC)
+	uint8_t hour; // Hour of day, range 0..23 (UTC)
+	uint8_t min; // Minute of hour, range 0..59 (UTC)
+	uint8_t second; // Seconds of minute, range 0..60 (UTC)
+	bool valid_date; // Valid UTC date
+	bool valid_time; // Valid UTC time of day
+	int32_t nano; // Fraction of second (range +/-1e9 ns)
+
+	/*
+	 * GNSSfix Type, same enumeration as gps_fix in ubx_nav_sol
+	 */
+	uint8_t fix_type;
+
+	bool gnss_fix_ok; // Fix within limits (e.g. DOP & accuracy)
+	bool diffsoln; // Differential corrections applied
+	uint8_t carr_soln; // Carrier phase solution. 0: none, 1: float, 2: fixed
+	uint8_t num_sv; // Number of SVs used in Nav Solution
+	double lon; // Longitude, degrees
+	double lat; // Latitude, degrees
+	float height; // Height above ellipsoid
+	float h_msl; // Height above mean sea level
+	float h_acc; // Horizontal accuracy estimate
+	float v_acc; // Vertical accuracy estimate
+	float vel_n; // NED north velocity
+	float vel_e; // NED east velocity
+	float vel_d; // NED down velocity
+	float g_speed; // Ground speed (2D)
+	float head_mot; // Heading of motion (2D), degrees
+	float s_acc; // Speed accuracy estimate
+	float head_acc; // Heading accuracy estimate, degrees
+	float p_dop; // Position DOP
+} ubx_nav_pvt;
+
+typedef struct {
+	uint32_t i_tow; // GPS time of week of the navigation epoch
+	float g_dop; // Geometric DOP
+	float p_dop; // Position DOP
+	float t_dop; // Time DOP
+	float v_dop; // Vertical DOP
+	float h_dop; // Horizontal DOP
+	float n_dop; // Northing DOP
+	float e_dop; // Easting DOP
+} ubx_nav_dop;
+
 typedef struct {
     uint8_t gnss_id; // 0: GPS, 1: SBAS, 2: GAL, 3: BDS, 5: QZSS, 6: GLO
     uint8_t sv_id;
@@ -435,11 +483,22 @@ typedef struct {
 } ubx_cfg_nmea;
 
 // Functions
-bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_tx);
+
+/*
+ * With ubx_only the receiver is configured for binary UBX output only,
+ * emitting just NAV-PVT and NAV-DOP. That carries everything the NMEA
+ * GGA/GSV/RMC set provided in a fraction of the bytes and parse time,
+ * so rate_ms can be lowered to 100 (10 Hz) without saturating the
+ * serial link. The decoded PVT feeds the same nmea state the NMEA
+ * path fills, so position consumers work unchanged.
+ */
+bool ublox_init(bool print, uint16_t rate_ms, int num_uart, int pin_rx, int pin_tx, bool ubx_only);
 void ublox_stop(int num_uart);
 bool ublox_init_ok(void);
 void ublox_send(unsigned char *data, unsigned int len);
 void ublox_set_rx_callback_nav_sol(void(*func)(ubx_nav_sol *sol));
+void ublox_set_rx_callback_nav_pvt(void(*func)(ubx_nav_pvt *pvt));
+void ublox_set_rx_callback_nav_dop(void(*func)(ubx_nav_dop *dop));
 void ublox_set_rx_callback_relposned(void(*func)(ubx_nav_relposned *pos));
 void ublox_set_rx_callback_rawx(void(*func)(ubx_rxm_rawx *rawx));
 void ublox_set_rx_callback_svin(void(*func)(ubx_nav_svin *svin));
@@ -490,6 +549,8 @@ void ublox_cfg_append_u1(unsigned char *buffer, int *ind, uint32_t key, uint8_t
 
 // Navigation (NAV) messages
 #define UBX_NAV_SOL						0x06
+#define UBX_NAV_PVT						0x07
+#define UBX_NAV_DOP						0x04
 #define UBX_NAV_RELPOSNED				0x3C
 #define UBX_NAV_SVIN					0x3B
 #define UBX_NAV_SAT 					0x35
@@ -560,6 +621,8 @@ void ublox_cfg_append_u1(unsigned char *buffer, int *ind, uint32_t key, uint8_t
 #define CFG_MSGOUT_UBX_NAV_VELECEF_UART1	0x2091003e
 #define CFG_MSGOUT_UBX_NAV_VELNED_UART1		0x20910043
 #define CFG_MSGOUT_UBX_NAV_SAT_UART1		0x20910016
+#define CFG_MSGOUT_UBX_NAV_PVT_UART1		0x20910007
+#define CFG_MSGOUT_UBX_NAV_DOP_UART1		0x20910039
 
 // RTCM3 messages
 #define UBX_RTCM3_1005					0x05 // Stationary RTK reference station ARP
@@ -31,6 +31,7 @@
 #include "esp_netif_types.h"
 #include "esp_event_base.h"
 #include "errno.h"
+#include "sys/uio.h"
 #include "lwip/api.h"
 
 #include "eval_cps.h"
@@ -90,6 +91,7 @@ static bool register_symbols(void) {
 	res = res && lbm_add_symbol_const("connecting", &symbol_connecting);
 	res = res && lbm_add_symbol_const("disconnected", &symbol_disconnected);
 	res = res && lbm_add_symbol_const("socket-error", &symbol_socket_error);
+	res = res && lbm_add_symbol_const("connect-error", &symbol_connect_error);
 	res = res && lbm_add_symbol_const("wait", &symbol_wait);
 	res = res && lbm_add_symbol_const("no-wait", &symbol_no_wait);
 
@@ -702,6 +704,68 @@ static lbm_value ext_wifi_max_tx_power(lbm_value *args, lbm_uint argn) {
 	return lbm_enc_i(new_power);
 }
 
+/**
+ * signature: (wifi-link-quality)
+ * -> (rssi tx-cnt tx-retries tx-fails block-max-us scale)
+ *
+ * Get the current WiFi link-quality statistics, sampled once per
+ * second by the wifi module. scale is the congestion controller output
+ * in [0.25, 1.0]; scripts streaming telemetry at a fixed rate can
+ * multiply their rate by it to back off before the link saturates at
+ * the edge of range.
+ */
+static lbm_value ext_wifi_link_quality(lbm_value *args, lbm_uint argn) {
+	(void)args;
+	(void)argn;
+
+	if (!wifi_precheck(PRECHECK_MODE_NOT_DISABLED)) {
+		return ENC_SYM_EERROR;
+	}
+
+	comm_wifi_link_stats stats;
+	comm_wifi_link_stats_get(&stats);
+
+	lbm_value res = ENC_SYM_NIL;
+	res = lbm_cons(lbm_enc_float(stats.scale), res);
+	res = lbm_cons(lbm_enc_u32(stats.tx_block_max_us), res);
+	res = lbm_cons(lbm_enc_u32(stats.tx_fails), res);
+	res = lbm_cons(lbm_enc_u32(stats.tx_retries), res);
+	res = lbm_cons(lbm_enc_u32(stats.tx_cnt), res);
+	res = lbm_cons(lbm_enc_i(stats.rssi), res);
+	return res;
+}
+
+/**
+ * signature: (wifi-link-rate-ctrl [enable:bool]) -> bool
+ *
+ * Set whether the wifi congestion controller may stretch the TX
+ * coalescing flush period under congestion, trading telemetry latency
+ * for fewer, larger segments. Leave out the argument to query the
+ * current value without modifying it.
+ *
+ * @return The previous setting, or the current if enable wasn't
+ * passed.
+ */
+static lbm_value ext_wifi_link_rate_ctrl(lbm_value *args, lbm_uint argn) {
+	if (!wifi_precheck(PRECHECK_MODE_NOT_DISABLED)) {
+		return ENC_SYM_EERROR;
+	}
+
+	bool current_value = comm_wifi_link_rate_ctrl_get();
+
+	if (argn == 0) {
+		return lbm_enc_bool(current_value);
+	}
+
+	if (!lbm_is_bool(args[0])) {
+		return ENC_SYM_TERROR;
+	}
+
+	comm_wifi_link_rate_ctrl_set(lbm_dec_bool(args[0]));
+
+	return lbm_enc_bool(current_value);
+}
+
 typedef struct {
 	lbm_cid id;
 	wifi_ftm_initiator_cfg_t cfg;
@@ -848,6 +912,21 @@ static lbm_value ext_debug_network_test(lbm_value *args, lbm_uint argn) {
 static int custom_sockets[CUSTOM_SOCKET_COUNT];
 static int custom_socket_now = 0;
 
+static void custom_socket_set_options(int sock) {
+	// TODO: Add keep alive configuration options.
+	int keep_alive    = true;
+	int keep_idle     = 5;
+	int keep_interval = 5;
+	int keep_count    = 3;
+	int no_delay      = true;
+	// TODO: error checking?
+	setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keep_alive, sizeof(int));
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keep_idle, sizeof(int));
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keep_interval, sizeof(int));
+	setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keep_count, sizeof(int));
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
+}
+
 static bool custom_socket_valid(int socket) {
 	if (socket < 0) {
 		return false;
@@ -950,19 +1029,7 @@ static lbm_value ext_tcp_connect(lbm_value *args, lbm_uint argn) {
 
 
 	custom_sockets[custom_socket_now++] = sock;
-
-	// TODO: Add keep alive configuration options.
-	int keep_alive    = true;
-	int keep_idle     = 5;
-	int keep_interval = 5;
-	int keep_count    = 3;
-	int no_delay      = true;
-	// TODO: error checking?
-	setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keep_alive, sizeof(int));
-	setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keep_idle, sizeof(int));
-	setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keep_interval, sizeof(int));
-	setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keep_count, sizeof(int));
-	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(int));
+	custom_socket_set_options(sock);
 
 	return lbm_enc_i(sock);
 }
@@ -1144,6 +1211,79 @@ static lbm_value ext_tcp_send(lbm_value *args, lbm_uint argn) {
 	return ENC_SYM_TRUE;
 }
 
+/**
+ * signature: (tcp-send-batch socket:number segments:list) -> bool
+ *
+ * Scatter-gather variant of tcp-send. Segments is a list of byte
+ * arrays that are handed to the stack in a single writev call, so
+ * scripts assembling protocol messages from parts avoid both the
+ * concatenation allocation and the per-segment send cost.
+ */
+static lbm_value ext_tcp_send_batch(lbm_value *args, lbm_uint argn) {
+	if (!wifi_precheck(PRECHECK_MODE_STATION_ONLY)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_check_argn(argn, 2)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_is_number(args[0]) || !lbm_is_list(args[1])) {
+		return ENC_SYM_TERROR;
+	}
+
+	int sock = lbm_dec_as_i32(args[0]);
+
+	int num = 0;
+	for (lbm_value curr = args[1]; lbm_is_cons(curr); curr = lbm_cdr(curr)) {
+		if (!lbm_is_array_r(lbm_car(curr))) {
+			return ENC_SYM_TERROR;
+		}
+		num++;
+	}
+
+	if (num == 0) {
+		return ENC_SYM_TRUE;
+	}
+
+	struct iovec *iov = lbm_malloc((lbm_uint)num * sizeof(struct iovec));
+	if (!iov) {
+		return ENC_SYM_MERROR;
+	}
+
+	int i = 0;
+	for (lbm_value curr = args[1]; lbm_is_cons(curr); curr = lbm_cdr(curr)) {
+		const lbm_array_header_t *array = lbm_dec_array_header(lbm_car(curr));
+		if (!array || !array->data) {
+			// Should be impossible.
+			lbm_free(iov);
+			return ENC_SYM_FATAL_ERROR;
+		}
+		iov[i].iov_base = array->data;
+		iov[i].iov_len  = (size_t)array->size;
+		i++;
+	}
+
+	ssize_t len = writev(sock, iov, num);
+	lbm_free(iov);
+
+	if (len == -1) {
+		// Same errno mapping as tcp-send.
+		switch (errno) {
+			case ECONNABORTED:
+			case ECONNRESET:
+			case ENOTCONN: {
+				return ENC_SYM(symbol_disconnected);
+			}
+			default: {
+				return ENC_SYM_NIL;
+			}
+		}
+	}
+
+	return ENC_SYM_TRUE;
+}
+
 typedef struct {
 	lbm_cid return_cid;
 	int socket;
@@ -1546,6 +1686,388 @@ static lbm_value ext_tcp_recv_to_char(lbm_value *args, lbm_uint argn) {
 	}
 }
 
+/*
+ * Asynchronous socket operations. These return immediately and deliver
+ * their result through the LBM event system (event-tcp-connect and
+ * event-tcp-recv must be enabled with event-enable), so one context
+ * can multiplex several connections without blocking in recv loops.
+ * Pending receives are polled by a single shared task that exits when
+ * no operation is in flight; connects get a short-lived task each
+ * since the DNS lookup blocks.
+ */
+#define ASYNC_CONNECT_SLOTS		3
+#define ASYNC_HOST_MAX_LEN		63
+
+static char *error_event_connect_disabled =
+	"The event-tcp-connect event is not enabled.";
+static char *error_event_recv_disabled =
+	"The event-tcp-recv event is not enabled.";
+
+typedef struct {
+	volatile bool used;
+	int id;
+	char host[ASYNC_HOST_MAX_LEN + 1];
+	uint16_t port;
+} async_connect_op;
+
+typedef struct {
+	volatile bool used;
+	int socket;
+	size_t max_len;
+	float timeout;
+	int start_tick;
+} async_recv_op;
+
+static async_connect_op async_connect_ops[ASYNC_CONNECT_SLOTS];
+static async_recv_op async_recv_ops[CUSTOM_SOCKET_COUNT];
+static volatile bool async_recv_task_running = false;
+static int async_connect_id_next = 0;
+
+// produces (event-tcp-connect id socket|error-symbol)
+static void send_tcp_connect_event(int id, int sock, lbm_uint error_sym) {
+	if (!event_tcp_connect_en) {
+		return;
+	}
+
+	lbm_flat_value_t flat;
+	if (!lbm_start_flatten(&flat, 50)) {
+		return;
+	}
+
+	f_cons(&flat);
+	f_sym(&flat, sym_event_tcp_connect);
+
+	f_cons(&flat);
+	f_i(&flat, id);
+
+	f_cons(&flat);
+	if (sock >= 0) {
+		f_i(&flat, sock);
+	} else {
+		f_sym(&flat, error_sym);
+	}
+
+	f_sym(&flat, SYM_NIL);
+
+	if (!lbm_event(&flat)) {
+		lbm_free(flat.buf);
+	}
+}
+
+// produces (event-tcp-recv socket data|'no-data|'disconnected|nil)
+static void send_tcp_recv_event(
+	int sock, uint8_t *data, unsigned int len, lbm_uint sym
+) {
+	if (!event_tcp_recv_en) {
+		return;
+	}
+
+	lbm_flat_value_t flat;
+	if (!lbm_start_flatten(&flat, 40 + len)) {
+		return;
+	}
+
+	f_cons(&flat);
+	f_sym(&flat, sym_event_tcp_recv);
+
+	f_cons(&flat);
+	f_i(&flat, sock);
+
+	f_cons(&flat);
+	if (data != NULL) {
+		f_lbm_array(&flat, len, data);
+	} else {
+		f_sym(&flat, sym);
+	}
+
+	f_sym(&flat, SYM_NIL);
+
+	if (!lbm_event(&flat)) {
+		lbm_free(flat.buf);
+	}
+}
+
+static void async_connect_task(void *arg) {
+	async_connect_op *op = (async_connect_op *)arg;
+
+	ip_addr_t ip_addr;
+	if (netconn_gethostbyname(op->host, &ip_addr) != ERR_OK) {
+		send_tcp_connect_event(op->id, -1, symbol_unknown_host);
+		goto connect_cleanup;
+	}
+
+	{
+		struct sockaddr_in addr = create_sockaddr_in(ip_addr, op->port);
+
+		int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+		if (sock < 0) {
+			send_tcp_connect_event(op->id, -1, symbol_socket_error);
+			goto connect_cleanup;
+		}
+
+		if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+			shutdown(sock, 0);
+			close(sock);
+			send_tcp_connect_event(op->id, -1, symbol_connect_error);
+			goto connect_cleanup;
+		}
+
+		if (custom_socket_now >= CUSTOM_SOCKET_COUNT) {
+			shutdown(sock, 0);
+			close(sock);
+			send_tcp_connect_event(op->id, -1, symbol_socket_error);
+			goto connect_cleanup;
+		}
+
+		custom_sockets[custom_socket_now++] = sock;
+		custom_socket_set_options(sock);
+
+		send_tcp_connect_event(op->id, sock, 0);
+	}
+
+connect_cleanup:
+
+	op->used = false;
+	vTaskDelete(NULL);
+}
+
+static void async_recv_poll_task(void *arg) {
+	(void)arg;
+
+	for (;;) {
+		bool any = false;
+
+		for (int i = 0;i < CUSTOM_SOCKET_COUNT;i++) {
+			async_recv_op *op = &async_recv_ops[i];
+			if (!op->used) {
+				continue;
+			}
+			any = true;
+
+			char peek;
+			ssize_t res = recv(op->socket, &peek, 1, MSG_DONTWAIT | MSG_PEEK);
+
+			if (res < 0) {
+				switch (errno) {
+					case EWOULDBLOCK: {
+						if (UTILS_AGE_S(op->start_tick) > op->timeout) {
+							send_tcp_recv_event(op->socket, NULL, 0, symbol_no_data);
+							op->used = false;
+						}
+						continue;
+					}
+					case ECONNRESET:
+					case ECONNABORTED:
+					case ENOTCONN: {
+						send_tcp_recv_event(
+							op->socket, NULL, 0, symbol_disconnected
+						);
+						op->used = false;
+						continue;
+					}
+					default: {
+						send_tcp_recv_event(op->socket, NULL, 0, SYM_NIL);
+						op->used = false;
+						continue;
+					}
+				}
+			} else if (res == 0) {
+				send_tcp_recv_event(op->socket, NULL, 0, symbol_disconnected);
+				op->used = false;
+				continue;
+			}
+
+			uint8_t *buffer = malloc(op->max_len);
+			if (buffer == NULL) {
+				send_tcp_recv_event(op->socket, NULL, 0, SYM_NIL);
+				op->used = false;
+				continue;
+			}
+
+			ssize_t len = recv(op->socket, buffer, op->max_len, MSG_DONTWAIT);
+			if (len > 0) {
+				send_tcp_recv_event(op->socket, buffer, len, 0);
+			} else {
+				send_tcp_recv_event(op->socket, NULL, 0, SYM_NIL);
+			}
+			free(buffer);
+			op->used = false;
+		}
+
+		if (!any) {
+			async_recv_task_running = false;
+
+			// An operation can have been registered between the scan and
+			// clearing the flag. Re-claim the task if nobody spawned a
+			// new one for it yet.
+			for (int i = 0;i < CUSTOM_SOCKET_COUNT;i++) {
+				if (async_recv_ops[i].used && !async_recv_task_running) {
+					async_recv_task_running = true;
+					any = true;
+					break;
+				}
+			}
+
+			if (!any) {
+				vTaskDelete(NULL);
+			}
+		}
+
+		vTaskDelay(1);
+	}
+}
+
+/**
+ * signature: (tcp-connect-async dest:str port:number) -> number
+ *
+ * Start connecting to the specified destination without blocking the
+ * current context. The result is delivered as the event
+ * (event-tcp-connect id socket), where id is the number returned by
+ * this call and socket is the socket number on success or one of the
+ * symbols 'unknown-host, 'socket-error or 'connect-error on failure.
+ * The event-tcp-connect event must be enabled first.
+ *
+ * @param dest The hostname/IPv4 address to connect to as a string.
+ * @param port The port of the host to connect to.
+ * @return An id number identifying this connection attempt in the
+ * delivered event.
+ */
+static lbm_value ext_tcp_connect_async(lbm_value *args, lbm_uint argn) {
+	if (!wifi_precheck(PRECHECK_MODE_STATION_ONLY)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_check_argn(argn, 2)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_is_array_r(args[0]) || !lbm_is_number(args[1])) {
+		return ENC_SYM_TERROR;
+	}
+
+	if (!event_tcp_connect_en) {
+		lbm_set_error_reason(error_event_connect_disabled);
+		return ENC_SYM_EERROR;
+	}
+
+	const char *host = lbm_dec_str(args[0]);
+	if (!host || strlen(host) > ASYNC_HOST_MAX_LEN) {
+		lbm_set_error_reason("Too long hostname, max: 63 chars.");
+		return ENC_SYM_EERROR;
+	}
+
+	async_connect_op *op = NULL;
+	for (int i = 0;i < ASYNC_CONNECT_SLOTS;i++) {
+		if (!async_connect_ops[i].used) {
+			op = &async_connect_ops[i];
+			break;
+		}
+	}
+
+	if (op == NULL) {
+		lbm_set_error_reason("Too many connects in progress.");
+		return ENC_SYM_EERROR;
+	}
+
+	op->id = async_connect_id_next++;
+	strcpy(op->host, host);
+	op->port = lbm_dec_as_u32(args[1]);
+	op->used = true;
+
+	xTaskCreatePinnedToCore(
+		async_connect_task, "lbm_sockets", 2560, op, 3, NULL, tskNO_AFFINITY
+	);
+
+	return lbm_enc_i(op->id);
+}
+
+/**
+ * signature: (tcp-recv-async socket:number max-len:number
+ * [timeout:number]) -> bool
+ *
+ * Start receiving on the socket without blocking the current context.
+ * The result is delivered as the event (event-tcp-recv socket data),
+ * where data is a byte array with the received data, 'no-data when
+ * the timeout passed without data, 'disconnected when the remote has
+ * closed the connection or nil on other errors. The event-tcp-recv
+ * event must be enabled first. One receive can be in flight per
+ * socket.
+ *
+ * @param socket The socket to receive data over. Should have been
+ * created using tcp-connect or tcp-connect-async.
+ * @param max_len The amount of bytes to receive at most.
+ * @param timeout [optional] The amount of seconds to wait for data at
+ * least. (Default: 1.0)
+ * @return true when the receive was registered, or nil when the
+ * provided socket didn't exist.
+ */
+static lbm_value ext_tcp_recv_async(lbm_value *args, lbm_uint argn) {
+	if (!wifi_precheck(PRECHECK_MODE_STATION_ONLY)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_check_argn_range(argn, 2, 3)) {
+		return ENC_SYM_EERROR;
+	}
+
+	if (!lbm_is_number(args[0]) || !lbm_is_number(args[1])) {
+		return ENC_SYM_TERROR;
+	}
+
+	if (!event_tcp_recv_en) {
+		lbm_set_error_reason(error_event_recv_disabled);
+		return ENC_SYM_EERROR;
+	}
+
+	int sock       = lbm_dec_as_i32(args[0]);
+	size_t max_len = lbm_dec_as_u32(args[1]);
+
+	float timeout_secs = 1.0;
+	if (argn >= 3) {
+		if (!lbm_is_number(args[2])) {
+			return ENC_SYM_TERROR;
+		}
+		timeout_secs = lbm_dec_as_float(args[2]);
+	}
+
+	if (!custom_socket_valid(sock)) {
+		return ENC_SYM_NIL;
+	}
+
+	async_recv_op *op = NULL;
+	for (int i = 0;i < CUSTOM_SOCKET_COUNT;i++) {
+		if (async_recv_ops[i].used) {
+			if (async_recv_ops[i].socket == sock) {
+				lbm_set_error_reason("Receive already in progress on socket.");
+				return ENC_SYM_EERROR;
+			}
+		} else if (op == NULL) {
+			op = &async_recv_ops[i];
+		}
+	}
+
+	if (op == NULL) {
+		lbm_set_error_reason("Too many receives in progress.");
+		return ENC_SYM_EERROR;
+	}
+
+	op->socket = sock;
+	op->max_len = max_len;
+	op->timeout = timeout_secs;
+	op->start_tick = xTaskGetTickCount();
+	op->used = true;
+
+	if (!async_recv_task_running) {
+		async_recv_task_running = true;
+		xTaskCreatePinnedToCore(
+			async_recv_poll_task, "lbm_sockets", 2048, NULL, 3, NULL,
+			tskNO_AFFINITY
+		);
+	}
+
+	return ENC_SYM_TRUE;
+}
+
 void lispif_load_wifi_extensions(void) {
 	if (!init_done) {
 		comm_wifi_set_event_listener(event_listener);
@@ -1569,6 +2091,10 @@ void lispif_load_wifi_extensions(void) {
 
 	custom_socket_now = 0;
 
+	for (int i = 0;i < CUSTOM_SOCKET_COUNT;i++) {
+		async_recv_ops[i].used = false;
+	}
+
 	register_symbols();
 
 	lbm_add_extension("wifi-scan-networks", ext_wifi_scan_networks);
@@ -1577,6 +2103,8 @@ void lispif_load_wifi_extensions(void) {
 	lbm_add_extension("wifi-disconnect", ext_wifi_disconnect);
 	lbm_add_extension("wifi-status", ext_wifi_status);
 	lbm_add_extension("wifi-max-tx-power", ext_wifi_max_tx_power);
+	lbm_add_extension("wifi-link-quality", ext_wifi_link_quality);
+	lbm_add_extension("wifi-link-rate-ctrl", ext_wifi_link_rate_ctrl);
 	lbm_add_extension("wifi-auto-reconnect", ext_wifi_auto_reconnect);
 	lbm_add_extension("wifi-ftm-measure", ext_wifi_ftm_measure);
 	lbm_add_extension("debug-network-test", ext_debug_network_test);
@@ -1584,6 +2112,9 @@ void lispif_load_wifi_extensions(void) {
 	lbm_add_extension("tcp-close", ext_tcp_close);
 	lbm_add_extension("tcp-status", ext_tcp_status);
 	lbm_add_extension("tcp-send", ext_tcp_send);
+	lbm_add_extension("tcp-send-batch", ext_tcp_send_batch);
 	lbm_add_extension("tcp-recv", ext_tcp_recv);
 	lbm_add_extension("tcp-recv-to-char", ext_tcp_recv_to_char);
+	lbm_add_extension("tcp-connect-async", ext_tcp_connect_async);
+	lbm_add_extension("tcp-recv-async", ext_tcp_recv_async);
 }
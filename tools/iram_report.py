@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+IRAM Placement Report
+Checks the linker map of a finished build and reports where the
+hot-path symbols selected in "VESC Express -> IRAM placement" actually
+ended up (IRAM, DRAM or flash), so placement regressions are caught
+instead of assumed.
+
+Usage: python tools/iram_report.py [build/vesc_express.map]
+"""
+
+import re
+import sys
+from pathlib import Path
+
+# Symbols the linker fragment (main/linker.lf) is expected to move, by
+# Kconfig option.
+WATCHED = {
+    "VESC_IRAM_PACKET": ["packet_process_byte", "packet_send_packet", "packet_init"],
+    "VESC_IRAM_CRC": ["crc16", "crc32_with_init", "crc16_tabs", "crc32_tabs"],
+    "VESC_IRAM_LBM_EVAL": ["lbm_run_eval"],
+}
+
+REGIONS = [
+    # (name, start, end) for ESP32-C6; HP SRAM is a single address space,
+    # the distinction that matters is SRAM vs flash-mapped.
+    ("SRAM (IRAM/DRAM)", 0x40800000, 0x40880000),
+    ("flash (cached)", 0x42000000, 0x43000000),
+    ("flash (rodata)", 0x3C000000, 0x3D000000),
+]
+
+
+def region_of(addr):
+    for name, start, end in REGIONS:
+        if start <= addr < end:
+            return name
+    return "unknown (0x%08x)" % addr
+
+
+def parse_map(path):
+    """Return {symbol: address} for all symbols in the map file."""
+    symbols = {}
+    sym_re = re.compile(r"^\s+0x([0-9a-fA-F]{8,16})\s+(\w+)\s*$")
+    for line in path.open(errors="replace"):
+        m = sym_re.match(line)
+        if m:
+            symbols.setdefault(m.group(2), int(m.group(1), 16))
+    return symbols
+
+
+def main():
+    map_path = Path(sys.argv[1] if len(sys.argv) > 1 else "build/vesc_express.map")
+    if not map_path.exists():
+        print(f"Map file not found: {map_path}")
+        print("Build first (idf.py build), or pass the map file path.")
+        return 1
+
+    symbols = parse_map(map_path)
+
+    print(f"IRAM placement report for {map_path}\n")
+    for option, syms in WATCHED.items():
+        print(f"{option}:")
+        for sym in syms:
+            if sym in symbols:
+                print(f"  {sym:24s} {region_of(symbols[sym])}")
+            else:
+                print(f"  {sym:24s} not in map (renamed or not linked)")
+        print()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())